@@ -114,6 +114,10 @@ void ads1256_send_cmd(uint8_t cmd);
 void ads1256_set_channel(uint8_t ch);
 uint8_t ads1256_read_register(uint8_t reg);
 void ads1256_write_register(uint8_t reg, uint8_t val);
+void ads1256_write_registers(uint8_t reg, const uint8_t *p_val, uint8_t num);
+int32_t ads1256_read_data(void);
+int32_t ads1256_read_next(uint8_t mux, uint8_t adcon);
+int ads1256_wait_drdy(void);
 int ads1256_read_chip_id(void);
 
 #endif
@@ -27,7 +27,9 @@
   #define LOW 0
 #endif
 
-/* SPI */
+/* SPI -- spidev, or "mcspi0" for the McSPI0 registers driven from
+ * userspace (the controller behind /dev/spidev1.0, P9_17/18/21/22) */
+#define SPI_DEVICE          "/dev/spidev1.0"
 #define SPI_CLOCK_FREQ_HZ   2000000
 #define SPI_CLOCK_MODE      1
 #define SPI_ENDIANNESS      MSB_FIRST
@@ -0,0 +1,101 @@
+#ifndef _METRICS_H
+#define _METRICS_H
+/***********************************************************************
+ * INCLUDES
+ **/
+#include <stdio.h>
+#include <stdint.h>
+
+/***********************************************************************
+ * DEFINES
+ **/
+#define METRIC_COUNTER_TYPE     0
+#define METRIC_GAUGE_TYPE       1
+#define METRIC_HISTOGRAM_TYPE   2
+
+#define METRIC_MAX_BUCKETS      16
+
+/***********************************************************************
+ * MACROS
+ **/
+/* Metrics are defined once, at file scope, and are registered before
+ * main(). Updates are relaxed atomics, with no locks: they can't stall
+ * the capture, and a scrape reads them while it goes on.
+ *   METRIC_COUNTER(DRDY_TIMEOUTS, "ads1256_drdy_timeouts_total", "...");
+ *   metric_inc(&DRDY_TIMEOUTS);
+ * Histograms take integer observations and their upper bounds in the
+ * same unit, and 'unit' converts them for the output (1e-9: ns taken,
+ * seconds shown). */
+#define METRIC_COUNTER(var, name, help) \
+  METRIC_DEFINE(var, name, help, METRIC_COUNTER_TYPE, 1, NULL, 0)
+
+#define METRIC_GAUGE(var, name, help) \
+  METRIC_DEFINE(var, name, help, METRIC_GAUGE_TYPE, 1, NULL, 0)
+
+#define METRIC_HISTOGRAM(var, name, help, unit, ...) \
+  static const uint64_t var##_BOUNDS[] = {__VA_ARGS__}; \
+  METRIC_DEFINE(var, name, help, METRIC_HISTOGRAM_TYPE, unit, var##_BOUNDS, \
+                sizeof(var##_BOUNDS) / sizeof(uint64_t))
+
+#define METRIC_DEFINE(var, name, help, type, unit, p_bounds, num_bounds) \
+  static metric_t var = {name, help, type, unit, p_bounds, num_bounds, 0, {0}, NULL}; \
+  static void __attribute__((constructor)) var##_register(void) \
+  { \
+    metric_register(&var); \
+  }
+
+/***********************************************************************
+ * TYPEDEFS
+ **/
+typedef struct metric_t
+{
+  const char      *name;
+  const char      *help;
+  int              type;          /* METRIC_..._TYPE */
+  double           unit;
+  const uint64_t  *p_bounds;      /* Histogram upper bounds, increasing */
+  uint32_t         num_bounds;    /* Up to METRIC_MAX_BUCKETS */
+  uint64_t         value;         /* Counter, gauge (double bits), histogram sum */
+  uint64_t         bucket[METRIC_MAX_BUCKETS + 1];  /* Observations per bucket, the last +Inf */
+  struct metric_t *p_next;
+} metric_t;
+
+/***********************************************************************
+ * FUNCTIONS
+ **/
+void metric_register(metric_t *p_metric);
+void metric_observe(metric_t *p_metric, uint64_t value);
+void metric_set(metric_t *p_metric, double value);
+int  metrics_write(FILE *fp);
+int  metrics_serve(const char *addr);
+
+/***********************************************************************
+ * @fn      metric_add
+ *
+ * @brief   Counter += n.
+ *
+ * @param   p_metric
+ *          n
+ *
+ * @return  void
+ **/
+static inline void metric_add(metric_t *p_metric, uint64_t n)
+{
+  __atomic_fetch_add(&p_metric->value, n, __ATOMIC_RELAXED);
+}
+
+/***********************************************************************
+ * @fn      metric_inc
+ *
+ * @brief
+ *
+ * @param   p_metric
+ *
+ * @return  void
+ **/
+static inline void metric_inc(metric_t *p_metric)
+{
+  __atomic_fetch_add(&p_metric->value, 1, __ATOMIC_RELAXED);
+}
+
+#endif
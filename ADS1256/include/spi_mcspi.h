@@ -0,0 +1,93 @@
+#ifndef _SPI_MCSPI_H
+#define _SPI_MCSPI_H
+/***********************************************************************
+ * INCLUDES
+ **/
+#include <stdint.h>
+#include "spi_interface.h"
+
+/***********************************************************************
+ * DEFINES
+ **/
+/* Device names of the register-level backend, for spi_open() */
+#define MCSPI_DEVICE_PREFIX "mcspi"   /* "mcspi0" or "mcspi1" */
+
+/* McSPI registers (AM335x TRM, chapter 24), also decoded by the
+ * register model (mcspi_model.c) */
+#define MCSPI_FCLK_HZ         48000000    /* Divided for SCLK */
+
+/* Registers */
+#define MCSPI_SYSCONFIG       0x110
+#define MCSPI_SYSSTATUS       0x114
+#define MCSPI_IRQSTATUS       0x118
+#define MCSPI_MODULCTRL       0x128
+#define MCSPI_CH0CONF         0x12C
+#define MCSPI_CH0STAT         0x130
+#define MCSPI_CH0CTRL         0x134
+#define MCSPI_TX0             0x138
+#define MCSPI_RX0             0x13C
+#define MCSPI_XFERLEVEL       0x17C
+
+/* SYSCONFIG: soft reset, no idle, clocks kept on */
+#define SYSCONFIG_SOFTRESET   (1 << 1)
+#define SYSCONFIG_NO_IDLE     ((1 << 3) | (3 << 8))
+#define SYSSTATUS_RESETDONE   (1 << 0)
+
+/* MODULCTRL: single channel master, SPIEN used as chip select */
+#define MODULCTRL_SINGLE      (1 << 0)
+
+/* CH0CONF */
+#define CHCONF_PHA            (1 << 0)
+#define CHCONF_POL            (1 << 1)
+#define CHCONF_CLKD(d)        (((d) & 0x0F) << 2)
+#define CHCONF_EPOL           (1 << 6)     /* SPIEN active low */
+#define CHCONF_WL(bits)       ((((bits) - 1) & 0x1F) << 7)
+#define CHCONF_DPE0           (1 << 16)    /* D0 is MISO, D1 is MOSI */
+#define CHCONF_TURBO          (1 << 19)
+#define CHCONF_FORCE          (1 << 20)    /* SPIEN asserted */
+#define CHCONF_FFEW           (1 << 27)
+#define CHCONF_FFER           (1 << 28)
+#define CHCONF_CLKG           (1 << 29)    /* Divider of one clock granularity */
+
+/* CH0STAT */
+#define CHSTAT_TXFFF          (1 << 4)
+#define CHSTAT_RXFFE          (1 << 5)
+
+/* CH0CTRL */
+#define CHCTRL_EN             (1 << 0)
+#define CHCTRL_EXTCLK(d)      (((d) & 0xFF) << 8)
+
+/* TX and RX FIFOs: 64 bytes split between both */
+#define MCSPI_FIFO_BYTES      32
+
+/***********************************************************************
+ * FUNCTIONS
+ **/
+int mcspi_open(const char *spi_device);
+int mcspi_is_open(int fd);
+int mcspi_close(int fd);
+int mcspi_transfer(int fd, void *tx_buf, void *rx_buf, uint32_t num_words, uint32_t delay_us);
+int mcspi_set_config(int fd, spi_config_t *p_spi_config);
+
+/* Register access when built with MCSPI_MODEL: provided by the register
+ * model (mcspi_model.c), so the backend runs without the AM335x */
+#ifdef MCSPI_MODEL
+/* What the model saw since the last mcspi_model_stat() */
+typedef struct mcspi_model_stat_t
+{
+  uint32_t words;           /* Shifted on the bus */
+  uint32_t overruns;        /* TX written while full, RX lost while full */
+  uint32_t underruns;       /* RX read while empty */
+  uint32_t idle_words;      /* Shifted with the channel off or SPIEN released */
+  uint32_t max_tx_level;    /* FIFO levels, words */
+  uint32_t max_rx_level;
+  uint32_t depth;           /* FIFO size of the last word length, words */
+} mcspi_model_stat_t;
+
+uint32_t mcspi_model_read(uint32_t offset);
+void     mcspi_model_write(uint32_t offset, uint32_t value);
+void     mcspi_model_set_latency(uint32_t polls);
+void     mcspi_model_stat(mcspi_model_stat_t *p_stat);
+#endif
+
+#endif
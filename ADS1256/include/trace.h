@@ -0,0 +1,51 @@
+#ifndef _TRACE_H
+#define _TRACE_H
+/***********************************************************************
+ * INCLUDES
+ **/
+#include <stdint.h>
+
+/***********************************************************************
+ * MACROS
+ **/
+/* Tracepoints, compiled in only with -DTRACE ('make TRACE=1'), and to
+ * nothing otherwise. A span is TRACE_BEGIN("name") ... TRACE_END() on
+ * one thread, nested up to TRACE_DEPTH deep, and the name a string
+ * literal. Spans go to a ring of the thread, the last TRACE_EVENTS of
+ * them kept. With -DTRACE_SAMPLE=N ('make TRACE=1 TRACE_SAMPLE=N') one
+ * outermost span in N is kept, with every span inside it; the others
+ * cost a counter. The rings are written as Chrome trace JSON (Perfetto,
+ * chrome://tracing) at exit and on SIGUSR2. */
+#ifdef TRACE
+#define TRACE_SETUP(file_name)  trace_setup(file_name)
+#define TRACE_BEGIN(name)       trace_begin(name)
+#define TRACE_END()             trace_end()
+#define TRACE_DUMP(file_name)   trace_dump(file_name)
+#else
+#define TRACE_SETUP(file_name)  do { } while ( 0 )
+#define TRACE_BEGIN(name)       do { } while ( 0 )
+#define TRACE_END()             do { } while ( 0 )
+#define TRACE_DUMP(file_name)   do { } while ( 0 )
+#endif
+
+/***********************************************************************
+ * DEFINES
+ **/
+#define TRACE_EVENTS        (1 << 15)   /* Spans kept per thread */
+#define TRACE_DEPTH         16
+
+#ifndef TRACE_SAMPLE
+#define TRACE_SAMPLE        1
+#endif
+
+/***********************************************************************
+ * FUNCTIONS
+ **/
+#ifdef TRACE
+int  trace_setup(const char *file_name);
+void trace_begin(const char *name);
+void trace_end(void);
+int  trace_dump(const char *file_name);
+#endif
+
+#endif
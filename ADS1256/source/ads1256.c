@@ -5,14 +5,27 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <unistd.h>
+#include <time.h>
 #include "conf.h"
 #include "ads1256.h"
 #include "gpio_interface.h"
 #include "spi_interface.h"
+#include "trace.h"
+#include "metrics.h"
 
 /***********************************************************************
  * DEFINES
  **/
+/* Datasheet waits in CLKIN periods (7.68 MHz), rounded up to us. spidev
+ * hid them behind the syscall latency, the McSPI backend does not */
+#define ADS1256_CLKIN_HZ      7680000
+#define ADS1256_TCLKIN_US(n)  (((n) * 1000000 + ADS1256_CLKIN_HZ - 1) / ADS1256_CLKIN_HZ)
+#define ADS1256_T6_US         ADS1256_TCLKIN_US(50)   /* RDATA/RREG to the first data SCLK */
+#define ADS1256_T11_US        ADS1256_TCLKIN_US(24)   /* SYNC to WAKEUP */
+#define ADS1256_WAKEUP_US     50                      /* WAKEUP to RDATA */
+
+/* Below this ads1256_us_delay() spins: usleep() takes tens of us more */
+#define SPIN_DELAY_MAX_US     100
 
 /***********************************************************************
  * MACROS
@@ -23,13 +36,16 @@
 /***********************************************************************
  * GLOBALS
  **/
+/* Counted in polls, not time: the clock would cost more than a poll */
+METRIC_HISTOGRAM(DRDY_POLLS, "ads1256_drdy_polls", "DRDY polls before a conversion was ready", 1,
+                 1, 4, 16, 64, 256, 1024, 4096, 16384, 65536, 262144);
+METRIC_COUNTER(DRDY_TIMEOUTS, "ads1256_drdy_timeouts_total", "DRDY waits timed out");
 
 /***********************************************************************
  * PRIVATE FUNCTIONS PROTOTYPES
  **/
 void ads1256_spi_transfer(uint8_t *tx_buf, uint8_t *rx_buf, uint8_t len);
 void ads1256_set_cs(uint8_t value);
-int ads1256_wait_drdy(void);
 uint8_t ads1256_drdy_state(void);
 void ads1256_hard_reset(void);
 void ads1256_soft_reset(void);
@@ -59,16 +75,18 @@ int32_t ads1256_read_channel(uint8_t ch)
 
   /* Send Sync Command */
   ads1256_send_cmd(ADS1256_CMD_SYNC);
+  ads1256_us_delay(ADS1256_T11_US);
 
   /* Send Wake Up Command */
   ads1256_send_cmd(ADS1256_CMD_WAKEUP);
-  ads1256_us_delay(50);
+  ads1256_us_delay(ADS1256_WAKEUP_US);
 
   /* Select ADS1256 for SPI Communication */
   ads1256_set_cs(LOW);
 
   /* Send Read Data command */
   ads1256_spi_transfer(&read_data_cmd, NULL, 1);
+  ads1256_us_delay(ADS1256_T6_US);
 
   /* Read 3 Bytes */
   ads1256_spi_transfer(NULL, rx_buf, 3);
@@ -188,6 +206,7 @@ uint8_t ads1256_read_register(uint8_t reg)
   tx_buf[0] = ADS1256_CMD_RREG | reg;
   tx_buf[1] = 0;
   ads1256_spi_transfer(tx_buf, NULL, 2);
+  ads1256_us_delay(ADS1256_T6_US);
 
   /* Read data */
   ads1256_spi_transfer(NULL, &reg_data, 1);
@@ -230,6 +249,127 @@ void ads1256_write_register(uint8_t reg, uint8_t val)
   ads1256_set_cs(HIGH);
 }
 
+/***********************************************************************
+ * @fn      ads1256_write_registers
+ *
+ * @brief   Write consecutive registers with a single WREG
+ *
+ * @param   reg - First register
+ *          p_val
+ *          num - 1:11
+ *
+ * @return  none
+ */
+void ads1256_write_registers(uint8_t reg, const uint8_t *p_val, uint8_t num)
+{
+  uint8_t tx_buf[13];
+  uint8_t i = 0;
+
+  if ( num == 0 || num > 11 )
+  {
+    return;
+  }
+
+  /* Fill buf */
+  tx_buf[0] = ADS1256_CMD_WREG | reg; // Write command register
+  tx_buf[1] = num - 1;                // Number of registers to write (N-1)
+  for ( i = 0; i < num; i++ )
+  {
+    tx_buf[2 + i] = p_val[i];
+  }
+
+  /* Wait DRDY Signal */
+  ads1256_wait_drdy();
+
+  /* Select ADS1256 for SPI Communication */
+  ads1256_set_cs(LOW);
+
+  /* Send data */
+  ads1256_spi_transfer(tx_buf, NULL, num + 2);
+
+  /* Finish SPI Communication */
+  ads1256_set_cs(HIGH);
+}
+
+/***********************************************************************
+ * @fn      ads1256_read_data
+ *
+ * @brief   Read the last conversion (RDATA), the caller waits for DRDY
+ *
+ * @param   none
+ *
+ * @return  Code, sign extended
+ */
+int32_t ads1256_read_data(void)
+{
+  uint8_t  read_data_cmd = ADS1256_CMD_RDATA;
+  uint32_t result = 0;
+  uint8_t  rx_buf[3] = {0,0,0};
+
+  /* Select ADS1256 for SPI Communication */
+  ads1256_set_cs(LOW);
+
+  /* Send Read Data command, then read 3 Bytes */
+  ads1256_spi_transfer(&read_data_cmd, NULL, 1);
+  ads1256_us_delay(ADS1256_T6_US);
+  ads1256_spi_transfer(NULL, rx_buf, 3);
+
+  /* Finish SPI Communication */
+  ads1256_set_cs(HIGH);
+
+  /* Parse result */
+  result = ((uint32_t)rx_buf[0] << 16) & 0x00FF0000;
+  result |= ((uint32_t)rx_buf[1] << 8);
+  result |= rx_buf[2];
+
+  /* Extend a signed number*/
+  if (result & 0x800000)
+  {
+    result |= 0xFF000000;
+  }
+
+  return (int32_t)result;
+}
+
+/***********************************************************************
+ * @fn      ads1256_read_next
+ *
+ * @brief   Cycle through channels (datasheet Figure 19): once DRDY is
+ *          low, select the next channel, restart the conversion and read
+ *          the one just completed on the current channel
+ *
+ * @param   mux - Next channel
+ *          adcon - Its PGA
+ *
+ * @return  Code of the current channel, sign extended
+ */
+int32_t ads1256_read_next(uint8_t mux, uint8_t adcon)
+{
+  uint8_t tx_buf[4];
+
+  tx_buf[0] = ADS1256_CMD_WREG | ADS1256_REG_MUX;
+  tx_buf[1] = 1;
+  tx_buf[2] = mux;
+  tx_buf[3] = adcon;
+
+  /* Select ADS1256 for SPI Communication */
+  ads1256_set_cs(LOW);
+
+  /* MUX and ADCON of the next channel */
+  ads1256_spi_transfer(tx_buf, NULL, 4);
+
+  /* Finish SPI Communication */
+  ads1256_set_cs(HIGH);
+
+  /* Restart the conversion on the new channel */
+  ads1256_send_cmd(ADS1256_CMD_SYNC);
+  ads1256_us_delay(ADS1256_T11_US);
+  ads1256_send_cmd(ADS1256_CMD_WAKEUP);
+  ads1256_us_delay(ADS1256_WAKEUP_US);
+
+  return ads1256_read_data();
+}
+
 /***********************************************************************
  * @fn      ads1256_read_chip_id
  *
@@ -276,7 +416,9 @@ void ads1256_spi_transfer(uint8_t *tx_buf, uint8_t *rx_buf, uint8_t len)
  */
 void ads1256_set_cs(uint8_t value)
 {
+  TRACE_BEGIN("ads1256_set_cs");
   gpio_write(ADS1256_CS_GPIO, value);
+  TRACE_END();
 }
 
 /***********************************************************************
@@ -292,6 +434,7 @@ int ads1256_wait_drdy(void)
 {
   uint32_t i;
 
+  TRACE_BEGIN("ads1256_wait_drdy");
   for (i = 0; i < 400000; i++)
   {
     if ( ads1256_drdy_state() == LOW )
@@ -299,8 +442,11 @@ int ads1256_wait_drdy(void)
       break;
     }
   }
+  TRACE_END();
+  metric_observe(&DRDY_POLLS, i + 1);
   if (i >= 400000)
   {
+    metric_inc(&DRDY_TIMEOUTS);
     printf("ads1256_wait_drdy() Time Out ...\r\n");
     return -1;
   }
@@ -362,7 +508,8 @@ void ads1256_soft_reset(void)
 /***********************************************************************
  * @fn      ads1256_us_delay
  *
- * @brief
+ * @brief   Short delays (the datasheet waits) spin on the monotonic
+ *          clock, longer ones sleep
  *
  * @param   us
  *
@@ -370,7 +517,19 @@ void ads1256_soft_reset(void)
  */
 void ads1256_us_delay(uint32_t us)
 {
-  US_DELAY(us);
+  struct timespec t0, t;
+
+  if ( us >= SPIN_DELAY_MAX_US )
+  {
+    US_DELAY(us);
+    return;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  do
+  {
+    clock_gettime(CLOCK_MONOTONIC, &t);
+  } while ( (t.tv_sec - t0.tv_sec) * 1000000000L + (t.tv_nsec - t0.tv_nsec) < (long)us * 1000 );
 }
 
 /***********************************************************************
@@ -12,6 +12,7 @@
 #include "gpio_interface.h"
 #include "spi_interface.h"
 #include "ads1256.h"
+#include "trace.h"
 
 /***********************************************************************
  * DEFINES
@@ -31,7 +32,7 @@ void signal_handler(int signal);
 int install_signal(void *signal_handler);
 
 /* SPI */
-int init_spi(void);
+int init_spi(char *spi_device);
 
 /***********************************************************************
  * MAIN
@@ -47,6 +48,8 @@ int init_spi(void);
  */
 int main(int argc, char *argv[])
 {
+  TRACE_SETUP("ads1256_trace.json");
+
   /* Install Signals */
   if ( install_signal(&signal_handler) < 0 )
   {
@@ -54,7 +57,7 @@ int main(int argc, char *argv[])
   }
 
   /* Init SPI Bus */
-  SPI_FD = init_spi();
+  SPI_FD = init_spi((argc >= 2) ? argv[1] : SPI_DEVICE);
   if ( SPI_FD < 0 )
   {
     exit(-1);
@@ -68,10 +71,12 @@ int main(int argc, char *argv[])
   {
     double volt[3] = {0,0,0};
     int i = 0;
+    TRACE_BEGIN("read_channels");
     for ( i = 0; i < 3; i++ )
     {
       volt[i] = ads1256_read_channel(i) * 5.0 / 8388608.0;
     }
+    TRACE_END();
     printf("Ch0: %f V   Ch1: %f V   Ch2: %f\n", volt[0], volt[1], volt[2]);
     usleep(500000);
   }
@@ -131,14 +136,14 @@ int install_signal(void *signal_handler)
  *
  * @brief
  *
- * @param   void
+ * @param   spi_device - spidev path or McSPI backend name
  *
  * @return  void
  **/
-int init_spi(void)
+int init_spi(char *spi_device)
 {
   /* Open SPI */
-  int fd = spi_open("/dev/spidev1.0");
+  int fd = spi_open(spi_device);
   if ( fd < 0 )
   {
     return -1;
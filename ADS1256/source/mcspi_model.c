@@ -0,0 +1,292 @@
+/***********************************************************************
+ * INCLUDES
+ **/
+#include <string.h>
+#include "spi_mcspi.h"
+
+/***********************************************************************
+ * DEFINES
+ **/
+#define MODEL_REGS        (0x200 / 4)
+
+/* Both FIFOs together, split in two with FFEW and FFER */
+#define MODEL_FIFO_BYTES  (2 * MCSPI_FIFO_BYTES)
+
+/***********************************************************************
+ * TYPEDEFS
+ **/
+typedef struct model_fifo_t
+{
+  uint32_t word[MODEL_FIFO_BYTES];
+  uint32_t head;
+  uint32_t level;
+} model_fifo_t;
+
+/***********************************************************************
+ * GLOBALS
+ **/
+static uint32_t REGS[MODEL_REGS];
+static model_fifo_t TX_FIFO;
+static model_fifo_t RX_FIFO;
+static mcspi_model_stat_t STAT;
+
+/* CH0STAT polls per word shifted, 0: clock stopped */
+static uint32_t LATENCY = 1;
+static uint32_t POLLS = 0;
+
+/***********************************************************************
+ * PRIVATE FUNCTIONS PROTOTYPES
+ **/
+uint32_t model_word_mask(void);
+uint32_t model_depth(void);
+int      model_push(model_fifo_t *p_fifo, uint32_t word);
+uint32_t model_pop(model_fifo_t *p_fifo);
+void     model_shift(void);
+
+/***********************************************************************
+ * FUNCTIONS
+ **/
+/***********************************************************************
+ * @fn      mcspi_model_read
+ *
+ * @brief   Register read. Each CH0STAT read is a tick of the bus: one
+ *          word every 'LATENCY' polls is shifted from the TX FIFO to the
+ *          RX FIFO, as the slave's answer, the complement of the word.
+ *
+ * @param   offset - Register offset in the McSPI block
+ *
+ * @return  Register value
+ */
+uint32_t mcspi_model_read(uint32_t offset)
+{
+  uint32_t stat = 0;
+
+  switch ( offset )
+  {
+    case MCSPI_CH0STAT:
+      model_shift();
+      stat = (TX_FIFO.level >= model_depth()) ? CHSTAT_TXFFF : 0;
+      stat |= (RX_FIFO.level == 0) ? CHSTAT_RXFFE : 0;
+      return stat;
+
+    case MCSPI_RX0:
+      if ( RX_FIFO.level == 0 )
+      {
+        STAT.underruns++;
+        return 0;
+      }
+      return model_pop(&RX_FIFO);
+
+    default:
+      return (offset / 4 < MODEL_REGS) ? REGS[offset / 4] : 0;
+  }
+}
+
+/***********************************************************************
+ * @fn      mcspi_model_write
+ *
+ * @brief   Register write. A soft reset clears the registers and both
+ *          FIFOs, TX0 queues a word for the bus.
+ *
+ * @param   offset - Register offset in the McSPI block
+ *          value -
+ *
+ * @return
+ */
+void mcspi_model_write(uint32_t offset, uint32_t value)
+{
+  switch ( offset )
+  {
+    case MCSPI_SYSCONFIG:
+      if ( value & SYSCONFIG_SOFTRESET )
+      {
+        memset(REGS, 0, sizeof(REGS));
+        memset(&TX_FIFO, 0, sizeof(model_fifo_t));
+        memset(&RX_FIFO, 0, sizeof(model_fifo_t));
+        REGS[MCSPI_SYSSTATUS / 4] = SYSSTATUS_RESETDONE;
+        value &= ~SYSCONFIG_SOFTRESET;
+      }
+      REGS[offset / 4] = value;
+      break;
+
+    case MCSPI_TX0:
+      if ( model_push(&TX_FIFO, value & model_word_mask()) < 0 )
+      {
+        STAT.overruns++;
+      }
+      break;
+
+    case MCSPI_SYSSTATUS:
+    case MCSPI_CH0STAT:
+    case MCSPI_RX0:
+      break;
+
+    default:
+      if ( offset / 4 < MODEL_REGS )
+      {
+        REGS[offset / 4] = value;
+      }
+      break;
+  }
+}
+
+/***********************************************************************
+ * @fn      mcspi_model_set_latency
+ *
+ * @brief   Bus speed against the CPU: a slow bus fills the TX FIFO, a
+ *          stopped one (0) never answers.
+ *
+ * @param   polls - CH0STAT reads per word shifted
+ *
+ * @return
+ */
+void mcspi_model_set_latency(uint32_t polls)
+{
+  LATENCY = polls;
+  POLLS = 0;
+}
+
+/***********************************************************************
+ * @fn      mcspi_model_stat
+ *
+ * @brief   Copy and clear the counters.
+ *
+ * @param   p_stat -
+ *
+ * @return
+ */
+void mcspi_model_stat(mcspi_model_stat_t *p_stat)
+{
+  STAT.depth = model_depth();
+  *p_stat = STAT;
+  memset(&STAT, 0, sizeof(mcspi_model_stat_t));
+}
+
+/***********************************************************************
+ * PRIVATE FUNCTIONS
+ **/
+/***********************************************************************
+ * @fn      model_word_mask
+ *
+ * @brief
+ *
+ * @param   void
+ *
+ * @return  Bits of a word of the CH0CONF word length
+ */
+uint32_t model_word_mask(void)
+{
+  uint32_t bits = ((REGS[MCSPI_CH0CONF / 4] >> 7) & 0x1F) + 1;
+
+  return (bits == 32) ? 0xFFFFFFFF : ((1u << bits) - 1);
+}
+
+/***********************************************************************
+ * @fn      model_depth
+ *
+ * @brief   Words held by each FIFO: the 64 bytes are split when both
+ *          are enabled, a disabled FIFO is a single word buffer.
+ *
+ * @param   void
+ *
+ * @return  Depth in words
+ */
+uint32_t model_depth(void)
+{
+  uint32_t chconf = REGS[MCSPI_CH0CONF / 4];
+  uint32_t bits = ((chconf >> 7) & 0x1F) + 1;
+  uint32_t word_bytes = (bits <= 8) ? 1 : (bits <= 16) ? 2 : 4;
+
+  if ( !(chconf & (CHCONF_FFEW | CHCONF_FFER)) )
+  {
+    return 1;
+  }
+
+  return (((chconf & CHCONF_FFEW) && (chconf & CHCONF_FFER)) ? MCSPI_FIFO_BYTES : MODEL_FIFO_BYTES) / word_bytes;
+}
+
+/***********************************************************************
+ * @fn      model_push
+ *
+ * @brief
+ *
+ * @param   p_fifo -
+ *          word -
+ *
+ * @return  -1 if full, the word is lost
+ */
+int model_push(model_fifo_t *p_fifo, uint32_t word)
+{
+  uint32_t depth = model_depth();
+
+  if ( p_fifo->level >= depth )
+  {
+    return -1;
+  }
+
+  p_fifo->word[(p_fifo->head + p_fifo->level) % MODEL_FIFO_BYTES] = word;
+  p_fifo->level++;
+
+  if ( p_fifo == &TX_FIFO && p_fifo->level > STAT.max_tx_level )
+  {
+    STAT.max_tx_level = p_fifo->level;
+  }
+  if ( p_fifo == &RX_FIFO && p_fifo->level > STAT.max_rx_level )
+  {
+    STAT.max_rx_level = p_fifo->level;
+  }
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      model_pop
+ *
+ * @brief
+ *
+ * @param   p_fifo - Not empty
+ *
+ * @return  Oldest word
+ */
+uint32_t model_pop(model_fifo_t *p_fifo)
+{
+  uint32_t word = p_fifo->word[p_fifo->head];
+
+  p_fifo->head = (p_fifo->head + 1) % MODEL_FIFO_BYTES;
+  p_fifo->level--;
+
+  return word;
+}
+
+/***********************************************************************
+ * @fn      model_shift
+ *
+ * @brief   One bus tick. A word shifted while the channel is off or
+ *          SPIEN is released would have been lost by a real slave.
+ *
+ * @param   void
+ *
+ * @return
+ */
+void model_shift(void)
+{
+  uint32_t word = 0;
+
+  if ( LATENCY == 0 || TX_FIFO.level == 0 || ++POLLS < LATENCY )
+  {
+    return;
+  }
+  POLLS = 0;
+
+  word = model_pop(&TX_FIFO);
+  STAT.words++;
+  if ( !(REGS[MCSPI_CH0CTRL / 4] & CHCTRL_EN) || !(REGS[MCSPI_CH0CONF / 4] & CHCONF_FORCE) )
+  {
+    STAT.idle_words++;
+  }
+
+  if ( model_push(&RX_FIFO, ~word & model_word_mask()) < 0 )
+  {
+    STAT.overruns++;
+  }
+}
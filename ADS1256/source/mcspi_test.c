@@ -0,0 +1,331 @@
+/***********************************************************************
+ * INCLUDES
+ **/
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include "conf.h"
+#include "spi_interface.h"
+#include "spi_mcspi.h"
+
+/***********************************************************************
+ * DEFINES
+ **/
+#define GUARD_BYTE  0xA5
+
+/***********************************************************************
+ * TYPEDEFS
+ **/
+/* A configuration and the registers it must produce */
+typedef struct config_case_t
+{
+  spi_config_t config;
+  uint32_t     chconf;
+  uint32_t     chctrl;
+} config_case_t;
+
+/***********************************************************************
+ * GLOBALS
+ **/
+static const config_case_t CONFIG_CASES[] =
+{
+  /* ADS1256 (conf.h): 48 MHz / 24, mode 1, SPIEN active low */
+  {{SPI_CLOCK_FREQ_HZ, SPI_CLOCK_MODE, MSB_FIRST, SPI_BITS_PER_WORD, SPI_CS_ACT_MODE}, 0x380903DD, 0x00000100},
+  {{48000000, 0, MSB_FIRST,  8, LOW},  0x380903C0, 0x00000000},
+  {{16000000, 2, MSB_FIRST, 16, HIGH}, 0x3809078A, 0x00000000},
+  {{ 7000000, 0, MSB_FIRST, 12, LOW},  0x380905D8, 0x00000000},
+  {{       1, 3, MSB_FIRST, 32, LOW},  0x38090FFF, 0x0000FF00},
+};
+
+static const uint8_t WORD_BITS[] = {8, 12, 16, 32};
+static const uint32_t LATENCIES[] = {1, 40};
+
+static int FAILURES = 0;
+
+/***********************************************************************
+ * LOCAL FUNCTIONS PROTOTYPES
+ **/
+void check(int ok, const char *p_what, ...);
+void test_config(int fd);
+void test_divider(int fd);
+void test_transfer(int fd, uint8_t bits, uint32_t latency, uint32_t num_words, int tx, int rx);
+void test_timeout(int fd);
+
+/***********************************************************************
+ * MAIN
+ **/
+/***********************************************************************
+ * @fn      main
+ *
+ * @brief   The McSPI backend against the register model: CHCONF and
+ *          divider values, and transfers of every length around the
+ *          FIFO size with fast and slow buses, 8 to 32 bit words and
+ *          NULL buffers, without FIFO overrun or underrun.
+ *
+ * @param   void
+ *
+ * @return  0 if every check passed
+ */
+int main(void)
+{
+  uint32_t sizes[8];
+  uint32_t word_bytes = 0;
+  uint32_t depth = 0;
+  uint32_t i = 0;
+  uint32_t j = 0;
+  uint32_t n = 0;
+  int fd = 0;
+
+  fd = spi_open(MCSPI_DEVICE_PREFIX "0");
+  if ( fd < 0 )
+  {
+    return 1;
+  }
+
+  test_config(fd);
+  test_divider(fd);
+
+  for ( i = 0; i < sizeof(WORD_BITS) / sizeof(WORD_BITS[0]); i++ )
+  {
+    word_bytes = (WORD_BITS[i] <= 8) ? 1 : (WORD_BITS[i] <= 16) ? 2 : 4;
+    depth = MCSPI_FIFO_BYTES / word_bytes;
+    sizes[0] = 1;
+    sizes[1] = 3;
+    sizes[2] = depth - 1;
+    sizes[3] = depth;
+    sizes[4] = depth + 1;
+    sizes[5] = 2 * depth + 1;
+    sizes[6] = 1000;
+    sizes[7] = SPI_MAX_DATA / word_bytes;
+
+    for ( j = 0; j < sizeof(LATENCIES) / sizeof(LATENCIES[0]); j++ )
+    {
+      for ( n = 0; n < sizeof(sizes) / sizeof(sizes[0]); n++ )
+      {
+        test_transfer(fd, WORD_BITS[i], LATENCIES[j], sizes[n], 1, 1);
+        test_transfer(fd, WORD_BITS[i], LATENCIES[j], sizes[n], 0, 1);
+        test_transfer(fd, WORD_BITS[i], LATENCIES[j], sizes[n], 1, 0);
+      }
+    }
+  }
+
+  /* Longer than SPI_MAX_DATA: cut, as spidev */
+  test_transfer(fd, 8, 1, SPI_MAX_DATA + 100, 1, 1);
+
+  test_timeout(fd);
+
+  spi_close(fd);
+
+  printf("%s: %d failure(s)\n", FAILURES ? "FAIL" : "PASS", FAILURES);
+
+  return FAILURES ? 1 : 0;
+}
+
+/***********************************************************************
+ * LOCAL FUNCTIONS
+ **/
+/***********************************************************************
+ * @fn      check
+ *
+ * @brief   Report a failed check.
+ *
+ * @param   ok -
+ *          p_what - printf format of the check
+ *
+ * @return
+ */
+void check(int ok, const char *p_what, ...)
+{
+  va_list args;
+
+  if ( ok )
+  {
+    return;
+  }
+
+  va_start(args, p_what);
+  fprintf(stderr, "FAIL: ");
+  vfprintf(stderr, p_what, args);
+  fprintf(stderr, "\n");
+  va_end(args);
+
+  FAILURES++;
+}
+
+/***********************************************************************
+ * @fn      test_config
+ *
+ * @brief   CH0CONF and CH0CTRL of known configurations, bit by bit
+ *          against the TRM layout; unsupported ones are refused.
+ *
+ * @param   fd - SPI file descriptor
+ *
+ * @return
+ */
+void test_config(int fd)
+{
+  spi_config_t config = {1000000, 0, LSB_FIRST, 8, LOW};
+  uint32_t i = 0;
+
+  for ( i = 0; i < sizeof(CONFIG_CASES) / sizeof(CONFIG_CASES[0]); i++ )
+  {
+    config = CONFIG_CASES[i].config;
+    check(spi_set_config(fd, &config) == 0, "config %u refused", i);
+    check(mcspi_model_read(MCSPI_CH0CONF) == CONFIG_CASES[i].chconf, "config %u: CH0CONF 0x%08X, expected 0x%08X",
+          i, mcspi_model_read(MCSPI_CH0CONF), CONFIG_CASES[i].chconf);
+    check(mcspi_model_read(MCSPI_CH0CTRL) == CONFIG_CASES[i].chctrl, "config %u: CH0CTRL 0x%08X, expected 0x%08X",
+          i, mcspi_model_read(MCSPI_CH0CTRL), CONFIG_CASES[i].chctrl);
+  }
+
+  config.endianess = LSB_FIRST;
+  check(spi_set_config(fd, &config) < 0, "LSB first accepted");
+  config.endianess = MSB_FIRST;
+  config.bits_per_word = 3;
+  check(spi_set_config(fd, &config) < 0, "3 bit words accepted");
+  config.bits_per_word = 8;
+  config.clk_freq = 0;
+  check(spi_set_config(fd, &config) < 0, "0 Hz accepted");
+}
+
+/***********************************************************************
+ * @fn      test_divider
+ *
+ * @brief   SCLK decoded from CLKD and EXTCLK: the highest at or below
+ *          the requested clock, down to the 4096 divider.
+ *
+ * @param   fd - SPI file descriptor
+ *
+ * @return
+ */
+void test_divider(int fd)
+{
+  spi_config_t config = {0, 0, MSB_FIRST, 8, LOW};
+  uint32_t chconf = 0;
+  uint32_t div = 0;
+  uint32_t freq = 0;
+
+  for ( freq = 1000; freq <= 60000000; freq += freq / 7 + 1 )
+  {
+    config.clk_freq = freq;
+    spi_set_config(fd, &config);
+
+    chconf = mcspi_model_read(MCSPI_CH0CONF);
+    check(chconf & CHCONF_CLKG, "%u Hz: no one clock granularity", freq);
+    div = ((((mcspi_model_read(MCSPI_CH0CTRL) >> 8) & 0xFF) << 4) | ((chconf >> 2) & 0x0F)) + 1;
+
+    check((uint64_t)freq * div >= MCSPI_FCLK_HZ || div == 4096, "%u Hz: SCLK %u Hz above", freq, MCSPI_FCLK_HZ / div);
+    check(div == 1 || (uint64_t)freq * (div - 1) < MCSPI_FCLK_HZ, "%u Hz: divider %u not the smallest", freq, div);
+  }
+}
+
+/***********************************************************************
+ * @fn      test_transfer
+ *
+ * @brief   One transfer: every word shifted once with SPIEN asserted,
+ *          the slave's answer (the complement) in place and nothing
+ *          written past it, no FIFO overrun or underrun. A bus slower
+ *          than the CPU must fill the TX FIFO without overflowing it.
+ *
+ * @param   fd - SPI file descriptor
+ *          bits - Word length
+ *          latency - Model polls per word
+ *          num_words -
+ *          tx - 0: NULL transmit buffer
+ *          rx - 0: NULL receive buffer
+ *
+ * @return
+ */
+void test_transfer(int fd, uint8_t bits, uint32_t latency, uint32_t num_words, int tx, int rx)
+{
+  static uint8_t tx_buf[SPI_MAX_DATA + 512];
+  static uint8_t rx_buf[SPI_MAX_DATA + 512];
+  spi_config_t config = {SPI_CLOCK_FREQ_HZ, SPI_CLOCK_MODE, MSB_FIRST, bits, LOW};
+  uint32_t word_bytes = (bits <= 8) ? 1 : (bits <= 16) ? 2 : 4;
+  uint32_t mask = (bits == 32) ? 0xFFFFFFFF : ((1u << bits) - 1);
+  uint32_t words = num_words;
+  uint32_t tx_word = 0;
+  uint32_t rx_word = 0;
+  uint32_t i = 0;
+  mcspi_model_stat_t stat;
+  int bad = 0;
+  int res = 0;
+
+  if ( words * word_bytes > SPI_MAX_DATA )
+  {
+    words = SPI_MAX_DATA / word_bytes;
+  }
+
+  for ( i = 0; i < sizeof(tx_buf); i++ )
+  {
+    tx_buf[i] = (uint8_t)(rand() >> 7);
+  }
+  memset(rx_buf, GUARD_BYTE, sizeof(rx_buf));
+
+  spi_set_config(fd, &config);
+  mcspi_model_set_latency(latency);
+  mcspi_model_stat(&stat);
+
+  res = spi_transfer(fd, tx ? tx_buf : NULL, rx ? rx_buf : NULL, num_words);
+  mcspi_model_stat(&stat);
+
+  check(res == (int)(words * word_bytes), "%u bit, %u words, latency %u, tx %d rx %d: returned %d",
+        bits, num_words, latency, tx, rx, res);
+  check(stat.words == words, "%u bit, %u words, latency %u: %u words shifted", bits, num_words, latency, stat.words);
+  check(stat.overruns == 0 && stat.underruns == 0, "%u bit, %u words, latency %u: %u overruns, %u underruns",
+        bits, num_words, latency, stat.overruns, stat.underruns);
+  check(stat.idle_words == 0, "%u bit, %u words: %u words without SPIEN", bits, num_words, stat.idle_words);
+  check(stat.depth == MCSPI_FIFO_BYTES / word_bytes, "%u bit: FIFO of %u words", bits, stat.depth);
+  if ( latency > 1 && words > stat.depth )
+  {
+    check(stat.max_tx_level == stat.depth, "%u bit, %u words, latency %u: TX FIFO never full (%u of %u)",
+          bits, num_words, latency, stat.max_tx_level, stat.depth);
+  }
+
+  if ( rx )
+  {
+    for ( i = 0; i < words && !bad; i++ )
+    {
+      tx_word = 0;
+      rx_word = 0;
+      if ( tx )
+      {
+        memcpy(&tx_word, tx_buf + i * word_bytes, word_bytes);
+      }
+      memcpy(&rx_word, rx_buf + i * word_bytes, word_bytes);
+      bad = (rx_word != (~tx_word & mask));
+      check(!bad, "%u bit, %u words, tx %d: word %u is 0x%X, expected 0x%X",
+            bits, num_words, tx, i, rx_word, ~tx_word & mask);
+    }
+    for ( i = words * word_bytes; i < sizeof(rx_buf) && !bad; i++ )
+    {
+      bad = (rx_buf[i] != GUARD_BYTE);
+      check(!bad, "%u bit, %u words: written past the transfer at byte %u", bits, num_words, i);
+    }
+  }
+
+  check(!(mcspi_model_read(MCSPI_CH0CONF) & CHCONF_FORCE) && !(mcspi_model_read(MCSPI_CH0CTRL) & CHCTRL_EN),
+        "%u bit, %u words: SPIEN or channel left on", bits, num_words);
+}
+
+/***********************************************************************
+ * @fn      test_timeout
+ *
+ * @brief   A stopped bus: the transfer gives up and releases SPIEN.
+ *
+ * @param   fd - SPI file descriptor
+ *
+ * @return
+ */
+void test_timeout(int fd)
+{
+  spi_config_t config = {SPI_CLOCK_FREQ_HZ, SPI_CLOCK_MODE, MSB_FIRST, 8, LOW};
+  uint8_t buf[3] = {0};
+
+  spi_set_config(fd, &config);
+  mcspi_model_set_latency(0);
+
+  check(spi_transfer(fd, buf, buf, sizeof(buf)) < 0, "stopped bus: transfer did not time out");
+  check(!(mcspi_model_read(MCSPI_CH0CONF) & CHCONF_FORCE) && !(mcspi_model_read(MCSPI_CH0CTRL) & CHCTRL_EN),
+        "stopped bus: SPIEN or channel left on");
+}
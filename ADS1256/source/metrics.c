@@ -0,0 +1,375 @@
+/***********************************************************************
+ * INCLUDES
+ **/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include "metrics.h"
+
+/***********************************************************************
+ * DEFINES
+ **/
+#define METRICS_HOST        "127.0.0.1"   /* Of "PORT" */
+#define METRICS_REQUEST_LEN 1024
+#define METRICS_TIMEOUT_S   1             /* For the request of a client */
+#define METRICS_RETRY_US    100000        /* After a failed accept() */
+
+/***********************************************************************
+ * GLOBALS
+ **/
+static metric_t *METRICS = NULL;
+static int METRICS_FD = -1;
+
+/***********************************************************************
+ * PRIVATE FUNCTIONS PROTOTYPES
+ **/
+static int   metrics_listen(const char *addr);
+static void *metrics_main(void *p_arg);
+static void  metrics_reply(int fd);
+static double metric_gauge(const metric_t *p_metric);
+
+/***********************************************************************
+ * FUNCTIONS
+ **/
+/***********************************************************************
+ * @fn      metric_register
+ *
+ * @brief   Add a metric to the output, from METRIC_...() before main().
+ *
+ * @param   p_metric
+ *
+ * @return  void
+ **/
+void metric_register(metric_t *p_metric)
+{
+  metric_t **pp = &METRICS;
+
+  /* Kept sorted by name */
+  while ( *pp != NULL && strcmp((*pp)->name, p_metric->name) < 0 )
+  {
+    pp = &(*pp)->p_next;
+  }
+  p_metric->p_next = *pp;
+  *pp = p_metric;
+}
+
+/***********************************************************************
+ * @fn      metric_observe
+ *
+ * @brief   Histogram observation.
+ *
+ * @param   p_metric
+ *          value - In the unit of the bounds
+ *
+ * @return  void
+ **/
+void metric_observe(metric_t *p_metric, uint64_t value)
+{
+  uint32_t i = 0;
+
+  while ( i < p_metric->num_bounds && value > p_metric->p_bounds[i] )
+  {
+    i++;
+  }
+  __atomic_fetch_add(&p_metric->bucket[i], 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&p_metric->value, value, __ATOMIC_RELAXED);
+}
+
+/***********************************************************************
+ * @fn      metric_set
+ *
+ * @brief   Gauge value.
+ *
+ * @param   p_metric
+ *          value
+ *
+ * @return  void
+ **/
+void metric_set(metric_t *p_metric, double value)
+{
+  uint64_t bits = 0;
+
+  memcpy(&bits, &value, sizeof(bits));
+  __atomic_store_n(&p_metric->value, bits, __ATOMIC_RELAXED);
+}
+
+/***********************************************************************
+ * @fn      metrics_write
+ *
+ * @brief   Every metric, in the Prometheus text format. Histogram
+ *          counts are summed from the buckets read, so they agree even
+ *          while observations go on.
+ *
+ * @param   fp
+ *
+ * @return  0, -1 on error
+ **/
+int metrics_write(FILE *fp)
+{
+  static const char *TYPES[] = {"counter", "gauge", "histogram"};
+  const metric_t *p = NULL;
+  uint64_t count = 0;
+  uint32_t i = 0;
+
+  for ( p = METRICS; p != NULL; p = p->p_next )
+  {
+    fprintf(fp, "# HELP %s %s\n# TYPE %s %s\n", p->name, p->help, p->name, TYPES[p->type]);
+    if ( p->type == METRIC_COUNTER_TYPE )
+    {
+      fprintf(fp, "%s %llu\n", p->name, (unsigned long long)__atomic_load_n(&p->value, __ATOMIC_RELAXED));
+    }
+    else if ( p->type == METRIC_GAUGE_TYPE )
+    {
+      fprintf(fp, "%s %.9g\n", p->name, metric_gauge(p));
+    }
+    else
+    {
+      count = 0;
+      for ( i = 0; i <= p->num_bounds; i++ )
+      {
+        count += __atomic_load_n(&p->bucket[i], __ATOMIC_RELAXED);
+        if ( i < p->num_bounds )
+        {
+          fprintf(fp, "%s_bucket{le=\"%.9g\"} %llu\n", p->name, p->p_bounds[i] * p->unit, (unsigned long long)count);
+        }
+      }
+      fprintf(fp, "%s_bucket{le=\"+Inf\"} %llu\n", p->name, (unsigned long long)count);
+      fprintf(fp, "%s_sum %.9g\n", p->name, __atomic_load_n(&p->value, __ATOMIC_RELAXED) * p->unit);
+      fprintf(fp, "%s_count %llu\n", p->name, (unsigned long long)count);
+    }
+  }
+
+  return ferror(fp) ? -1 : 0;
+}
+
+/***********************************************************************
+ * @fn      metrics_serve
+ *
+ * @brief   Serve the metrics from a thread, to Prometheus (HTTP GET) or
+ *          to anything that sends a line. Call once.
+ *
+ * @param   addr - "[HOST:]PORT" (host 127.0.0.1 by default) or the
+ *                 path of a Unix socket
+ *
+ * @return  0, -1 on error
+ **/
+int metrics_serve(const char *addr)
+{
+  pthread_attr_t attr;
+  pthread_t thread;
+
+  METRICS_FD = metrics_listen(addr);
+  if ( METRICS_FD < 0 )
+  {
+    return -1;
+  }
+
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  if ( pthread_create(&thread, &attr, metrics_main, NULL) != 0 )
+  {
+    perror("pthread_create(metrics)");
+    pthread_attr_destroy(&attr);
+    close(METRICS_FD);
+    METRICS_FD = -1;
+    return -1;
+  }
+  pthread_attr_destroy(&attr);
+  printf("Metrics on %s\n", addr);
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      metrics_listen
+ *
+ * @brief
+ *
+ * @param   addr - As metrics_serve()
+ *
+ * @return  Listening descriptor, -1 on error
+ **/
+static int metrics_listen(const char *addr)
+{
+  struct addrinfo hints;
+  struct addrinfo *p_ai = NULL;
+  struct sockaddr_un sun;
+  char host[256];
+  const char *p_port = strrchr(addr, ':');
+  int one = 1;
+  int fd = -1;
+
+  if ( strchr(addr, '/') != NULL )
+  {
+    memset(&sun, 0, sizeof(sun));
+    sun.sun_family = AF_UNIX;
+    strncpy(sun.sun_path, addr, sizeof(sun.sun_path) - 1);
+    unlink(addr);
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if ( fd < 0 || bind(fd, (struct sockaddr *)&sun, sizeof(sun)) < 0 || listen(fd, 4) < 0 )
+    {
+      perror("bind(metrics)");
+      if ( fd >= 0 )
+      {
+        close(fd);
+      }
+      return -1;
+    }
+    return fd;
+  }
+
+  snprintf(host, sizeof(host), "%.*s", (p_port != NULL) ? (int)(p_port - addr) : 0, addr);
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family   = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags    = AI_PASSIVE;
+  if ( getaddrinfo((host[0] != '\0') ? host : METRICS_HOST, (p_port != NULL) ? p_port + 1 : addr, &hints,
+                   &p_ai) != 0 )
+  {
+    printf("Wrong metrics address %s.\n", addr);
+    return -1;
+  }
+  fd = socket(p_ai->ai_family, p_ai->ai_socktype, p_ai->ai_protocol);
+  if ( fd >= 0 )
+  {
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  }
+  if ( fd < 0 || bind(fd, p_ai->ai_addr, p_ai->ai_addrlen) < 0 || listen(fd, 4) < 0 )
+  {
+    perror("bind(metrics)");
+    if ( fd >= 0 )
+    {
+      close(fd);
+    }
+    freeaddrinfo(p_ai);
+    return -1;
+  }
+  freeaddrinfo(p_ai);
+
+  return fd;
+}
+
+/***********************************************************************
+ * @fn      metrics_main
+ *
+ * @brief   Metrics thread: one scrape per connection.
+ *
+ * @param   p_arg
+ *
+ * @return  NULL
+ **/
+static void *metrics_main(void *p_arg)
+{
+  struct timeval tv = {METRICS_TIMEOUT_S, 0};
+  int fd = -1;
+
+  for ( ;; )
+  {
+    fd = accept(METRICS_FD, NULL, NULL);
+    if ( fd < 0 )
+    {
+      usleep(METRICS_RETRY_US);
+      continue;
+    }
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    metrics_reply(fd);
+    close(fd);
+  }
+
+  return NULL;
+}
+
+/***********************************************************************
+ * @fn      metrics_reply
+ *
+ * @brief   Answer one request: "GET ..." gets an HTTP response, any
+ *          other line just the metrics.
+ *
+ * @param   fd
+ *
+ * @return  void
+ **/
+static void metrics_reply(int fd)
+{
+  char req[METRICS_REQUEST_LEN];
+  char head[128];
+  char *p_body = NULL;
+  size_t body_len = 0;
+  size_t len = 0;
+  ssize_t n = 0;
+  int http = 0;
+  FILE *fp = NULL;
+
+  /* The request line, and the headers of an HTTP one */
+  while ( len < sizeof(req) - 1 )
+  {
+    n = read(fd, req + len, sizeof(req) - 1 - len);
+    if ( n <= 0 )
+    {
+      break;
+    }
+    len += n;
+    req[len] = '\0';
+    http = (strncmp(req, "GET ", 4) == 0);
+    if ( (!http && strchr(req, '\n') != NULL) ||
+         (http && (strstr(req, "\r\n\r\n") != NULL || strstr(req, "\n\n") != NULL)) )
+    {
+      break;
+    }
+  }
+
+  fp = open_memstream(&p_body, &body_len);
+  if ( fp == NULL )
+  {
+    return;
+  }
+  metrics_write(fp);
+  fclose(fp);
+
+  if ( http )
+  {
+    n = snprintf(head, sizeof(head), "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                 "Content-Length: %zu\r\nConnection: close\r\n\r\n", body_len);
+    if ( send(fd, head, n, MSG_NOSIGNAL) != n )
+    {
+      free(p_body);
+      return;
+    }
+  }
+  for ( len = 0; len < body_len; len += n )
+  {
+    n = send(fd, p_body + len, body_len - len, MSG_NOSIGNAL);
+    if ( n <= 0 )
+    {
+      break;
+    }
+  }
+  free(p_body);
+}
+
+/***********************************************************************
+ * @fn      metric_gauge
+ *
+ * @brief
+ *
+ * @param   p_metric
+ *
+ * @return  Gauge value
+ **/
+static double metric_gauge(const metric_t *p_metric)
+{
+  uint64_t bits = __atomic_load_n(&p_metric->value, __ATOMIC_RELAXED);
+  double value = 0;
+
+  memcpy(&value, &bits, sizeof(value));
+
+  return value;
+}
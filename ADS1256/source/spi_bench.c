@@ -0,0 +1,95 @@
+/***********************************************************************
+ * INCLUDES
+ **/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "conf.h"
+#include "spi_interface.h"
+
+/***********************************************************************
+ * DEFINES
+ **/
+#define DEF_LOOPS   1000
+
+/***********************************************************************
+ * GLOBALS
+ **/
+static const uint32_t SIZES[] = {1, 3, SPI_MAX_DATA};
+
+/***********************************************************************
+ * MAIN
+ **/
+/***********************************************************************
+ * @fn      main
+ *
+ * @brief   Time spi_transfer() for 1, 3 (one ADS1256 sample) and 4096
+ *          bytes on a spidev device or the McSPI backend, e.g.
+ *          'spi_bench /dev/spidev1.0' against 'spi_bench mcspi0'.
+ *
+ * @param   [DEVICE [LOOPS]]
+ *
+ * @return
+ */
+int main(int argc, char *argv[])
+{
+  static uint8_t tx_buf[SPI_MAX_DATA];
+  static uint8_t rx_buf[SPI_MAX_DATA];
+  char *spi_device = (argc >= 2) ? argv[1] : SPI_DEVICE;
+  uint32_t loops = (argc >= 3) ? (uint32_t)atoi(argv[2]) : DEF_LOOPS;
+  spi_config_t spi_config;
+  struct timespec t0, t1;
+  uint32_t i = 0;
+  uint32_t n = 0;
+  int fd = 0;
+
+  fd = spi_open(spi_device);
+  if ( fd < 0 )
+  {
+    return -1;
+  }
+
+  memset(&spi_config, 0, sizeof(spi_config_t));
+  spi_config.clk_freq       = SPI_CLOCK_FREQ_HZ;
+  spi_config.clk_mode       = SPI_CLOCK_MODE;
+  spi_config.endianess      = SPI_ENDIANNESS;
+  spi_config.bits_per_word  = SPI_BITS_PER_WORD;
+  spi_config.cs_active_mode = SPI_CS_ACT_MODE;
+  if ( spi_set_config(fd, &spi_config) < 0 )
+  {
+    spi_close(fd);
+    return -1;
+  }
+
+  for ( i = 0; i < SPI_MAX_DATA; i++ )
+  {
+    tx_buf[i] = (uint8_t)i;
+  }
+
+  printf("%s, SCLK %u Hz, %u transfers per size\n", spi_device, SPI_CLOCK_FREQ_HZ, loops);
+  for ( i = 0; i < sizeof(SIZES) / sizeof(SIZES[0]); i++ )
+  {
+    double us = 0;
+    double wire_us = SIZES[i] * 8 * 1e6 / SPI_CLOCK_FREQ_HZ;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for ( n = 0; n < loops; n++ )
+    {
+      if ( spi_transfer(fd, tx_buf, rx_buf, SIZES[i]) < 0 )
+      {
+        spi_close(fd);
+        return -1;
+      }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    us = ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / 1e3 / loops;
+    printf("%5u bytes: %10.2f us per transfer (%.2f us on the wire, %.2f us overhead)\n",
+           SIZES[i], us, wire_us, us - wire_us);
+  }
+
+  spi_close(fd);
+
+  return 0;
+}
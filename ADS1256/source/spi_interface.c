@@ -10,6 +10,9 @@
 #include <linux/types.h>
 #include <linux/spi/spidev.h>
 #include "spi_interface.h"
+#include "spi_mcspi.h"
+#include "trace.h"
+#include "metrics.h"
 
 /***********************************************************************
  * DEFINES
@@ -35,6 +38,9 @@
 /***********************************************************************
  * GLOBALS
  **/
+METRIC_COUNTER(SPI_TRANSFERS, "spi_transfers_total", "SPI transfers");
+METRIC_COUNTER(SPI_BYTES, "spi_transfer_bytes_total", "Bytes moved by SPI transfers");
+METRIC_COUNTER(SPI_ERRORS, "spi_transfer_errors_total", "SPI transfers failed");
 
 /***********************************************************************
  * PRIVATE FUNCTIONS PROTOTYPES
@@ -60,7 +66,8 @@ uint8_t spi_parse_mode(int fd, uint8_t cs_active_mode, uint8_t clk_mode);
 /***********************************************************************
  * @fn      spi_open
  *
- * @brief
+ * @brief   spidev device, or "mcspi0"/"mcspi1" for the McSPI registers
+ *          driven from userspace (see spi_mcspi.c)
  *
  * @param   spi_device - SPI device path (string)
  *
@@ -69,6 +76,12 @@ uint8_t spi_parse_mode(int fd, uint8_t cs_active_mode, uint8_t clk_mode);
 int spi_open(char *spi_device)
 {
   int fd = 0;
+
+  if ( strncmp(spi_device, MCSPI_DEVICE_PREFIX, strlen(MCSPI_DEVICE_PREFIX)) == 0 )
+  {
+    return mcspi_open(spi_device);
+  }
+
   fd = open(spi_device, O_RDWR);
   if ( fd < 0 )
   {
@@ -92,6 +105,11 @@ int spi_open(char *spi_device)
  */
 int spi_close(int fd)
 {
+  if ( mcspi_is_open(fd) )
+  {
+    return mcspi_close(fd);
+  }
+
   return close(fd);
 }
 
@@ -113,6 +131,11 @@ int spi_transfer_delay(int fd, void *tx_buf, void *rx_buf, uint32_t num_words, u
   uint32_t buf_size = 0;
   uint8_t  bits_per_word = 0;
 
+  if ( mcspi_is_open(fd) )
+  {
+    return mcspi_transfer(fd, tx_buf, rx_buf, num_words, delay_us);
+  }
+
   /* Get Word Size (in bits) */
   if ( spi_get_bits_per_word(fd, &bits_per_word) < 0 )
   {
@@ -164,7 +187,23 @@ int spi_transfer_delay(int fd, void *tx_buf, void *rx_buf, uint32_t num_words, u
  */
 int spi_transfer(int fd, void *tx_buf, void *rx_buf, uint32_t num_words)
 {
-  return spi_transfer_delay(fd, tx_buf, rx_buf, num_words, 0);
+  int res = 0;
+
+  TRACE_BEGIN("spi_transfer");
+  res = spi_transfer_delay(fd, tx_buf, rx_buf, num_words, 0);
+  TRACE_END();
+
+  metric_inc(&SPI_TRANSFERS);
+  if ( res < 0 )
+  {
+    metric_inc(&SPI_ERRORS);
+  }
+  else
+  {
+    metric_add(&SPI_BYTES, res);
+  }
+
+  return res;
 }
 
 /***********************************************************************
@@ -179,6 +218,11 @@ int spi_transfer(int fd, void *tx_buf, void *rx_buf, uint32_t num_words)
  */
 int spi_set_config(int fd, spi_config_t *p_spi_config)
 {
+  if ( mcspi_is_open(fd) )
+  {
+    return mcspi_set_config(fd, p_spi_config);
+  }
+
   if ( spi_set_clock_freq(fd, p_spi_config->clk_freq) < 0 )
   {
     return -1;
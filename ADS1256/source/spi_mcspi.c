@@ -0,0 +1,376 @@
+/***********************************************************************
+ * INCLUDES
+ **/
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include "spi_mcspi.h"
+
+/***********************************************************************
+ * DEFINES
+ **/
+#ifndef HIGH
+  #define HIGH 1
+#endif
+#ifndef LOW
+  #define LOW 0
+#endif
+
+/* AM335x McSPI register blocks (TRM, chapter 24) and their clocks */
+#define MCSPI0_ADDR           0x48030000
+#define MCSPI1_ADDR           0x481A0000
+#define MCSPI_MAP_SIZE        0x1000
+#define CM_PER_ADDR           0x44E00000
+#define CM_PER_SPI0_CLKCTRL   0x4C
+#define CM_PER_SPI1_CLKCTRL   0x50
+#define CM_MODULEMODE_ENABLE  0x02
+#define CM_IDLEST_MASK        0x00030000
+
+/* Status polls without progress before a transfer is given up */
+#define MCSPI_TIMEOUT_POLLS   1000000
+
+/***********************************************************************
+ * MACROS
+ **/
+#ifdef MCSPI_MODEL
+  #define MCSPI_READ(off)       mcspi_model_read(off)
+  #define MCSPI_WRITE(off, val) mcspi_model_write(off, val)
+#else
+  #define MCSPI_READ(off)       (*(volatile uint32_t *)(MCSPI.p_regs + (off)))
+  #define MCSPI_WRITE(off, val) (*(volatile uint32_t *)(MCSPI.p_regs + (off)) = (val))
+#endif
+
+/***********************************************************************
+ * TYPEDEFS
+ **/
+typedef struct mcspi_t
+{
+  int               fd;           /* /dev/mem, -1: closed */
+  volatile uint8_t *p_regs;
+  uint32_t          chconf;
+  uint8_t           bits_per_word;
+} mcspi_t;
+
+/***********************************************************************
+ * GLOBALS
+ **/
+static mcspi_t MCSPI = {-1, NULL, 0, 8};
+
+/***********************************************************************
+ * PRIVATE FUNCTIONS PROTOTYPES
+ **/
+int mcspi_enable_clock(int fd, int instance);
+int mcspi_reset(void);
+
+/***********************************************************************
+ * FUNCTIONS
+ **/
+/***********************************************************************
+ * @fn      mcspi_open
+ *
+ * @brief   Map a McSPI register block through /dev/mem. The kernel
+ *          driver (spidev/omap2_mcspi) must not be using the controller:
+ *          it is reset and driven from userspace.
+ *
+ * @param   spi_device - "mcspi0" or "mcspi1"
+ *
+ * @return  fd - SPI file descriptor
+ */
+int mcspi_open(const char *spi_device)
+{
+  int instance = spi_device[strlen(MCSPI_DEVICE_PREFIX)] - '0';
+  void *p_map = NULL;
+  int fd = 0;
+
+  if ( MCSPI.fd >= 0 || (instance != 0 && instance != 1) )
+  {
+    fprintf(stderr, "mcspi_open(%s): %s\n", spi_device, (MCSPI.fd >= 0) ? "already open" : "unknown device");
+    return -1;
+  }
+
+#ifdef MCSPI_MODEL
+  (void)p_map;
+  fd = open("/dev/null", O_RDWR);
+#else
+  fd = open("/dev/mem", O_RDWR | O_SYNC);
+#endif
+  if ( fd < 0 )
+  {
+    perror("open(\"/dev/mem\")");
+    return -1;
+  }
+
+#ifndef MCSPI_MODEL
+  if ( mcspi_enable_clock(fd, instance) < 0 )
+  {
+    close(fd);
+    return -1;
+  }
+
+  p_map = mmap(0, MCSPI_MAP_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, instance ? MCSPI1_ADDR : MCSPI0_ADDR);
+  if ( p_map == MAP_FAILED )
+  {
+    perror("mmap(McSPI)");
+    close(fd);
+    return -1;
+  }
+  MCSPI.p_regs = (volatile uint8_t *)p_map;
+#endif
+  MCSPI.fd = fd;
+
+  if ( mcspi_reset() < 0 )
+  {
+    mcspi_close(fd);
+    return -1;
+  }
+
+  return fd;
+}
+
+/***********************************************************************
+ * @fn      mcspi_is_open
+ *
+ * @brief
+ *
+ * @param   fd - SPI file descriptor
+ *
+ * @return  1 if 'fd' was returned by mcspi_open()
+ */
+int mcspi_is_open(int fd)
+{
+  return (fd >= 0 && fd == MCSPI.fd);
+}
+
+/***********************************************************************
+ * @fn      mcspi_close
+ *
+ * @brief
+ *
+ * @param   fd - SPI file descriptor
+ *
+ * @return
+ */
+int mcspi_close(int fd)
+{
+  if ( MCSPI.p_regs != NULL )
+  {
+    munmap((void *)MCSPI.p_regs, MCSPI_MAP_SIZE);
+    MCSPI.p_regs = NULL;
+  }
+  MCSPI.fd = -1;
+
+  return close(fd);
+}
+
+/***********************************************************************
+ * @fn      mcspi_transfer
+ *
+ * @brief   Full duplex transfer polling the FIFO status: TX is kept fed
+ *          while it is not full, no more than a FIFO ahead of RX, and RX
+ *          is drained while it is not empty. SPIEN stays asserted for the
+ *          whole transfer, as with spidev.
+ *
+ * @param   fd - SPI file descriptor
+ *          tx_buf - Pointer to transmit buffer (NULL: zeros)
+ *          rx_buf - Pointer to receive buffer (NULL: discarded)
+ *          num_words - Number of buffer words to transmit
+ *          delay_us - Delay after the last word, before SPIEN is released
+ *
+ * @return  Number of bytes, -1 on timeout
+ */
+int mcspi_transfer(int fd, void *tx_buf, void *rx_buf, uint32_t num_words, uint32_t delay_us)
+{
+  uint32_t word_bytes = (MCSPI.bits_per_word <= 8) ? 1 : (MCSPI.bits_per_word <= 16) ? 2 : 4;
+  uint32_t fifo_words = MCSPI_FIFO_BYTES / word_bytes;
+  uint32_t tx_n = 0;
+  uint32_t rx_n = 0;
+  uint32_t polls = 0;
+  uint32_t stat = 0;
+  uint32_t word = 0;
+  int res = 0;
+
+  if ( num_words * word_bytes > SPI_MAX_DATA )
+  {
+    num_words = SPI_MAX_DATA / word_bytes;
+  }
+
+  MCSPI_WRITE(MCSPI_CH0CONF, MCSPI.chconf | CHCONF_FORCE);
+  MCSPI_WRITE(MCSPI_CH0CTRL, MCSPI_READ(MCSPI_CH0CTRL) | CHCTRL_EN);
+
+  while ( rx_n < num_words )
+  {
+    stat = MCSPI_READ(MCSPI_CH0STAT);
+    polls++;
+
+    while ( tx_n < num_words && tx_n - rx_n < fifo_words && !(stat & CHSTAT_TXFFF) )
+    {
+      word = 0;
+      if ( tx_buf != NULL )
+      {
+        memcpy(&word, (uint8_t *)tx_buf + tx_n * word_bytes, word_bytes);
+      }
+      MCSPI_WRITE(MCSPI_TX0, word);
+      tx_n++;
+      polls = 0;
+      stat = MCSPI_READ(MCSPI_CH0STAT);
+    }
+
+    while ( rx_n < tx_n && !(stat & CHSTAT_RXFFE) )
+    {
+      word = MCSPI_READ(MCSPI_RX0);
+      if ( rx_buf != NULL )
+      {
+        memcpy((uint8_t *)rx_buf + rx_n * word_bytes, &word, word_bytes);
+      }
+      rx_n++;
+      polls = 0;
+      stat = MCSPI_READ(MCSPI_CH0STAT);
+    }
+
+    if ( polls > MCSPI_TIMEOUT_POLLS )
+    {
+      fprintf(stderr, "mcspi_transfer(): timeout, %u of %u words\n", rx_n, num_words);
+      res = -1;
+      break;
+    }
+  }
+
+  if ( delay_us > 0 )
+  {
+    usleep(delay_us);
+  }
+
+  MCSPI_WRITE(MCSPI_CH0CTRL, MCSPI_READ(MCSPI_CH0CTRL) & ~CHCTRL_EN);
+  MCSPI_WRITE(MCSPI_CH0CONF, MCSPI.chconf);
+
+  return (res < 0) ? -1 : (int)(num_words * word_bytes);
+}
+
+/***********************************************************************
+ * @fn      mcspi_set_config
+ *
+ * @brief   Clock, mode, word length and chip select polarity. The clock
+ *          is the highest at or below 'clk_freq' from the 48 MHz
+ *          functional clock (divider 1 - 4096). McSPI shifts MSB first
+ *          only.
+ *
+ * @param   fd - SPI file descriptor
+ *          p_spi_config -
+ *
+ * @return
+ */
+int mcspi_set_config(int fd, spi_config_t *p_spi_config)
+{
+  uint32_t div = 0;
+
+  if ( p_spi_config->endianess != MSB_FIRST || p_spi_config->bits_per_word < 4 ||
+       p_spi_config->bits_per_word > 32 || p_spi_config->clk_freq == 0 )
+  {
+    fprintf(stderr, "mcspi_set_config(): unsupported configuration\n");
+    return -1;
+  }
+
+  div = (MCSPI_FCLK_HZ + p_spi_config->clk_freq - 1) / p_spi_config->clk_freq;
+  div = (div < 1) ? 1 : (div > 4096) ? 4096 : div;
+
+  MCSPI.bits_per_word = p_spi_config->bits_per_word;
+  MCSPI.chconf = CHCONF_CLKG | CHCONF_CLKD(div - 1) | CHCONF_WL(p_spi_config->bits_per_word) |
+                 CHCONF_DPE0 | CHCONF_TURBO | CHCONF_FFEW | CHCONF_FFER;
+  if ( p_spi_config->clk_mode & 0x01 )
+  {
+    MCSPI.chconf |= CHCONF_PHA;
+  }
+  if ( p_spi_config->clk_mode & 0x02 )
+  {
+    MCSPI.chconf |= CHCONF_POL;
+  }
+  if ( p_spi_config->cs_active_mode == LOW )
+  {
+    MCSPI.chconf |= CHCONF_EPOL;
+  }
+
+  MCSPI_WRITE(MCSPI_CH0CTRL, CHCTRL_EXTCLK((div - 1) >> 4));
+  MCSPI_WRITE(MCSPI_CH0CONF, MCSPI.chconf);
+
+  return 0;
+}
+
+/***********************************************************************
+ * PRIVATE FUNCTIONS
+ **/
+/***********************************************************************
+ * @fn      mcspi_enable_clock
+ *
+ * @brief   The McSPI registers can't be accessed while its module clock
+ *          is gated (the kernel driver gates it when idle).
+ *
+ * @param   fd - /dev/mem
+ *          instance - 0 or 1
+ *
+ * @return
+ */
+int mcspi_enable_clock(int fd, int instance)
+{
+  volatile uint32_t *p_clkctrl = NULL;
+  void *p_map = NULL;
+  int polls = 0;
+
+  p_map = mmap(0, MCSPI_MAP_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, CM_PER_ADDR);
+  if ( p_map == MAP_FAILED )
+  {
+    perror("mmap(CM_PER)");
+    return -1;
+  }
+
+  p_clkctrl = (volatile uint32_t *)((uint8_t *)p_map + (instance ? CM_PER_SPI1_CLKCTRL : CM_PER_SPI0_CLKCTRL));
+  *p_clkctrl = CM_MODULEMODE_ENABLE;
+  while ( (*p_clkctrl & CM_IDLEST_MASK) != 0 && polls < MCSPI_TIMEOUT_POLLS )
+  {
+    polls++;
+  }
+  munmap(p_map, MCSPI_MAP_SIZE);
+
+  if ( polls == MCSPI_TIMEOUT_POLLS )
+  {
+    fprintf(stderr, "McSPI%d module clock not running\n", instance);
+    return -1;
+  }
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      mcspi_reset
+ *
+ * @brief   Soft reset, then single channel master with both FIFOs on
+ *          channel 0 and the default configuration (8 bits, mode 0).
+ *
+ * @param   void
+ *
+ * @return
+ */
+int mcspi_reset(void)
+{
+  spi_config_t spi_config = {1000000, 0, MSB_FIRST, 8, LOW};
+  int polls = 0;
+
+  MCSPI_WRITE(MCSPI_SYSCONFIG, SYSCONFIG_SOFTRESET);
+  while ( !(MCSPI_READ(MCSPI_SYSSTATUS) & SYSSTATUS_RESETDONE) )
+  {
+    if ( ++polls > MCSPI_TIMEOUT_POLLS )
+    {
+      fprintf(stderr, "McSPI reset timeout\n");
+      return -1;
+    }
+  }
+
+  MCSPI_WRITE(MCSPI_SYSCONFIG, SYSCONFIG_NO_IDLE);
+  MCSPI_WRITE(MCSPI_MODULCTRL, MODULCTRL_SINGLE);
+  MCSPI_WRITE(MCSPI_IRQSTATUS, 0xFFFFFFFF);
+  MCSPI_WRITE(MCSPI_XFERLEVEL, 0);
+
+  return mcspi_set_config(MCSPI.fd, &spi_config);
+}
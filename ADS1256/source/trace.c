@@ -0,0 +1,385 @@
+/***********************************************************************
+ * INCLUDES
+ **/
+/* Nothing without -DTRACE, see trace.h */
+#ifdef TRACE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/syscall.h>
+#include "trace.h"
+
+/***********************************************************************
+ * DEFINES
+ **/
+#define TRACE_FILE_LEN      256
+
+/***********************************************************************
+ * TYPEDEFS
+ **/
+typedef struct trace_span_t
+{
+  uint64_t    start;          /* CLOCK_MONOTONIC, ns */
+  uint32_t    dur;            /* ns */
+  uint32_t    tid;
+  const char *name;
+} trace_span_t;
+
+/* Ring of a thread. Only its thread writes it, and publishes each span
+ * by moving 'head'; the dumper copies the ring and keeps the spans the
+ * thread could not have reached meanwhile. Rings are never freed: the
+ * ring of a thread that ended goes to the next new thread. */
+typedef struct trace_buf_t
+{
+  struct trace_buf_t *p_next;
+  int          in_use;
+  uint32_t     tid;
+  uint32_t     head;            /* Spans written */
+  uint32_t     depth;
+  uint32_t     count;           /* Outermost spans begun */
+  int          sampled;         /* The current outermost span is kept */
+  uint64_t     start[TRACE_DEPTH];
+  const char  *name[TRACE_DEPTH];
+  trace_span_t span[TRACE_EVENTS];
+} trace_buf_t;
+
+/***********************************************************************
+ * GLOBALS
+ **/
+static trace_buf_t *TRACE_BUFS = NULL;
+static __thread trace_buf_t *TRACE_BUF = NULL;
+static pthread_key_t TRACE_KEY;
+static pthread_once_t TRACE_ONCE = PTHREAD_ONCE_INIT;
+static char TRACE_FILE[TRACE_FILE_LEN] = "trace.json";
+
+/***********************************************************************
+ * PRIVATE FUNCTIONS PROTOTYPES
+ **/
+static trace_buf_t *trace_attach(void);
+static void  trace_detach(void *p_arg);
+static void  trace_key_init(void);
+static void *trace_signal_main(void *p_arg);
+static void  trace_exit(void);
+static uint64_t trace_now(void);
+
+/***********************************************************************
+ * FUNCTIONS
+ **/
+/***********************************************************************
+ * @fn      trace_setup
+ *
+ * @brief   Write the spans to 'file_name' at exit and on SIGUSR2. Call
+ *          it before creating threads: they have to inherit SIGUSR2
+ *          blocked, so only the dump thread takes it.
+ *
+ * @param   file_name
+ *
+ * @return  0, -1 on error
+ **/
+int trace_setup(const char *file_name)
+{
+  pthread_attr_t attr;
+  pthread_t thread;
+  sigset_t set;
+
+  snprintf(TRACE_FILE, TRACE_FILE_LEN, "%s", file_name);
+
+  sigemptyset(&set);
+  sigaddset(&set, SIGUSR2);
+  pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  if ( pthread_create(&thread, &attr, trace_signal_main, NULL) != 0 )
+  {
+    perror("pthread_create(trace)");
+    pthread_attr_destroy(&attr);
+    return -1;
+  }
+  pthread_attr_destroy(&attr);
+  atexit(trace_exit);
+
+  printf("Tracing one span in %d to %s, 'kill -USR2 %d' writes it now\n", TRACE_SAMPLE, TRACE_FILE, getpid());
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      trace_begin
+ *
+ * @brief   Start a span of the calling thread.
+ *
+ * @param   name - String literal
+ *
+ * @return  void
+ **/
+void trace_begin(const char *name)
+{
+  trace_buf_t *p_buf = TRACE_BUF;
+
+  if ( p_buf == NULL && (p_buf = trace_attach()) == NULL )
+  {
+    return;
+  }
+
+  if ( p_buf->depth == 0 )
+  {
+    p_buf->sampled = (p_buf->count++ % TRACE_SAMPLE == 0);
+  }
+  if ( p_buf->sampled && p_buf->depth < TRACE_DEPTH )
+  {
+    p_buf->name[p_buf->depth]  = name;
+    p_buf->start[p_buf->depth] = trace_now();
+  }
+  p_buf->depth++;
+}
+
+/***********************************************************************
+ * @fn      trace_end
+ *
+ * @brief   End the innermost span of the calling thread.
+ *
+ * @param   void
+ *
+ * @return  void
+ **/
+void trace_end(void)
+{
+  trace_buf_t *p_buf = TRACE_BUF;
+  trace_span_t *p_span = NULL;
+  uint64_t dur = 0;
+
+  if ( p_buf == NULL || p_buf->depth == 0 )
+  {
+    return;
+  }
+
+  p_buf->depth--;
+  if ( !p_buf->sampled || p_buf->depth >= TRACE_DEPTH )
+  {
+    return;
+  }
+
+  dur    = trace_now() - p_buf->start[p_buf->depth];
+  p_span = &p_buf->span[p_buf->head % TRACE_EVENTS];
+  p_span->start = p_buf->start[p_buf->depth];
+  p_span->dur   = (dur > UINT32_MAX) ? UINT32_MAX : (uint32_t)dur;
+  p_span->tid   = p_buf->tid;
+  p_span->name  = p_buf->name[p_buf->depth];
+  __atomic_store_n(&p_buf->head, p_buf->head + 1, __ATOMIC_RELEASE);
+}
+
+/***********************************************************************
+ * @fn      trace_dump
+ *
+ * @brief   Write the spans kept, as Chrome trace JSON. Threads go on
+ *          tracing meanwhile.
+ *
+ * @param   file_name
+ *
+ * @return  Spans written, -1 on error
+ **/
+int trace_dump(const char *file_name)
+{
+  trace_span_t *p_copy = malloc(TRACE_EVENTS * sizeof(trace_span_t));
+  trace_buf_t *p_buf = NULL;
+  FILE *fp = NULL;
+  uint32_t head = 0;
+  uint32_t first = 0;
+  uint32_t valid = 0;
+  uint32_t i = 0;
+  int count = 0;
+  int pid = getpid();
+
+  fp = (p_copy != NULL) ? fopen(file_name, "w") : NULL;
+  if ( fp == NULL )
+  {
+    perror("fopen(trace)");
+    free(p_copy);
+    return -1;
+  }
+
+  fprintf(fp, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+  for ( p_buf = __atomic_load_n(&TRACE_BUFS, __ATOMIC_ACQUIRE); p_buf != NULL; p_buf = p_buf->p_next )
+  {
+    head  = __atomic_load_n(&p_buf->head, __ATOMIC_ACQUIRE);
+    first = (head > TRACE_EVENTS) ? head - TRACE_EVENTS : 0;
+    for ( i = first; i != head; i++ )
+    {
+      p_copy[i % TRACE_EVENTS] = p_buf->span[i % TRACE_EVENTS];
+    }
+
+    /* Spans the thread may have been rewriting while they were copied */
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    valid = __atomic_load_n(&p_buf->head, __ATOMIC_RELAXED);
+    valid = (valid - first >= TRACE_EVENTS) ? valid - TRACE_EVENTS + 1 : first;
+
+    for ( i = valid; (int32_t)(head - i) > 0; i++ )
+    {
+      trace_span_t *p_span = &p_copy[i % TRACE_EVENTS];
+
+      fprintf(fp, "%s\n{\"name\":\"%s\",\"cat\":\"acq\",\"ph\":\"X\",\"pid\":%d,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+              (count == 0) ? "" : ",", p_span->name, pid, p_span->tid, p_span->start / 1e3, p_span->dur / 1e3);
+      count++;
+    }
+  }
+  fprintf(fp, "\n]}\n");
+
+  free(p_copy);
+  if ( fclose(fp) != 0 )
+  {
+    perror("fclose(trace)");
+    return -1;
+  }
+
+  return count;
+}
+
+/***********************************************************************
+ * @fn      trace_attach
+ *
+ * @brief   Ring of the calling thread, at its first span.
+ *
+ * @param   void
+ *
+ * @return  Ring or NULL
+ **/
+static trace_buf_t *trace_attach(void)
+{
+  trace_buf_t *p_buf = NULL;
+  int free_ring = 0;
+
+  pthread_once(&TRACE_ONCE, trace_key_init);
+
+  for ( p_buf = __atomic_load_n(&TRACE_BUFS, __ATOMIC_ACQUIRE); p_buf != NULL; p_buf = p_buf->p_next )
+  {
+    free_ring = 0;
+    if ( __atomic_compare_exchange_n(&p_buf->in_use, &free_ring, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED) )
+    {
+      break;
+    }
+  }
+
+  if ( p_buf == NULL )
+  {
+    p_buf = calloc(1, sizeof(trace_buf_t));
+    if ( p_buf == NULL )
+    {
+      return NULL;
+    }
+    p_buf->in_use = 1;
+    p_buf->p_next = __atomic_load_n(&TRACE_BUFS, __ATOMIC_RELAXED);
+    while ( !__atomic_compare_exchange_n(&TRACE_BUFS, &p_buf->p_next, p_buf, 1, __ATOMIC_RELEASE,
+                                         __ATOMIC_RELAXED) );
+  }
+
+  p_buf->tid   = syscall(SYS_gettid);
+  p_buf->depth = 0;
+  p_buf->count = 0;
+  pthread_setspecific(TRACE_KEY, p_buf);
+  TRACE_BUF = p_buf;
+
+  return p_buf;
+}
+
+/***********************************************************************
+ * @fn      trace_detach
+ *
+ * @brief   The thread ended, its ring may go to another.
+ *
+ * @param   p_arg - Ring
+ *
+ * @return  void
+ **/
+static void trace_detach(void *p_arg)
+{
+  trace_buf_t *p_buf = (trace_buf_t *)p_arg;
+
+  __atomic_store_n(&p_buf->in_use, 0, __ATOMIC_RELEASE);
+}
+
+/***********************************************************************
+ * @fn      trace_key_init
+ *
+ * @brief
+ *
+ * @param   void
+ *
+ * @return  void
+ **/
+static void trace_key_init(void)
+{
+  pthread_key_create(&TRACE_KEY, trace_detach);
+}
+
+/***********************************************************************
+ * @fn      trace_signal_main
+ *
+ * @brief   Dump thread: writes the trace on each SIGUSR2.
+ *
+ * @param   p_arg
+ *
+ * @return  NULL
+ **/
+static void *trace_signal_main(void *p_arg)
+{
+  sigset_t set;
+  int sig = 0;
+  int count = 0;
+
+  sigemptyset(&set);
+  sigaddset(&set, SIGUSR2);
+  for ( ;; )
+  {
+    if ( sigwait(&set, &sig) == 0 && (count = trace_dump(TRACE_FILE)) >= 0 )
+    {
+      printf("%d spans written to %s\n", count, TRACE_FILE);
+    }
+  }
+
+  return NULL;
+}
+
+/***********************************************************************
+ * @fn      trace_exit
+ *
+ * @brief
+ *
+ * @param   void
+ *
+ * @return  void
+ **/
+static void trace_exit(void)
+{
+  int count = trace_dump(TRACE_FILE);
+
+  if ( count >= 0 )
+  {
+    printf("%d spans written to %s\n", count, TRACE_FILE);
+  }
+}
+
+/***********************************************************************
+ * @fn      trace_now
+ *
+ * @brief
+ *
+ * @param   void
+ *
+ * @return  CLOCK_MONOTONIC, ns
+ **/
+static uint64_t trace_now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+#endif
@@ -7,41 +7,108 @@
 #include <stdint.h>
 #include <unistd.h>
 #include <signal.h>
-#include <fcntl.h>
-#include <sys/types.h>
-#include <sys/mman.h>
-#include <prussdrv.h>
-#include <pruss_intc_mapping.h>
+#include <time.h>
+#include "acq.h"
 
 /***********************************************************************
  * DEFINES
  **/
-#define DEF_SMP_RATE   1000
-#define SAMPLE_SIZE    2
+#define DEF_BLOCK_LEN  1000
 #define ADC_FIFO0_LEN  50
-#define PRU_NUM        0
+#define ADC_TOP_RATE   1600000
+
+/* Daemon */
+#define DAEMON_SOCKET  "/tmp/host_adc.sock"
+#define MSG_MAX_LEN    256
+
+/* Reduction factor limit, 2^16 */
+#define REDUCE_MAX_SHIFT  16
+
+/* Packed pair, 2 samples in 3 bytes */
+#define PACKED_PAIR_SIZE  3
+
+/* Unpacker benchmark: pool sized buffer, run for about a second */
+#define BENCH_SAMPLES     (1 << 21)
+#define BENCH_TIME        1.0
+
+/***********************************************************************
+ * GLOBALS
+ **/
+static volatile int STOP = 0;
 
 /***********************************************************************
  * LOCAL FUNCTIONS PROTOTYPES
  **/
-/* Signals */
 void signal_handler(int signal);
 int  install_signal(void *signal_handler);
+int  unpack_benchmark(void);
+uint32_t capture_samples(acq_source_t *p_src, char *channel, char *rate, char *duration);
 
-/* Misc */
-int check_sample_rate(uint32_t smps);
-
-/* PRU */
-int get_pru_shared_mem_info(uint32_t *p_addr, uint32_t *p_size);
-
-/* Output data file */
-int parse_rcv_data_to_file(char *file_name, uint32_t shr_mem_addr, uint32_t num_samples, uint32_t sample_size);
+/* Daemon */
+int  daemon_run(acq_source_t *p_src);
+int  daemon_capture(acq_source_t *p_src, int client_fd, int listen_fd, uint32_t num_samples, char *file_name,
+                    char *reply, size_t len);
 
 /***********************************************************************
  * MAIN
  **/
 int main(int argc, char *argv[])
 {
+  acq_source_t *p_src = NULL;
+  acq_sink_t *p_sink = NULL;
+  char *trig_spec = NULL;
+  char *reduce_spec = NULL;
+  char *pack_opt = NULL;
+  char *split_opt = NULL;
+  uint32_t num_samples = 0;
+  uint32_t block_len = 0;
+  int n = 0;
+
+  /* Client mode: talk to a running daemon, no PRU access needed */
+  if ( argc >= 3 && strcmp(argv[1], "-c") == 0 )
+  {
+    return (acq_client_run(DAEMON_SOCKET, argc - 2, &argv[2]) < 0) ? -1 : 0;
+  }
+
+  /* Unpacker throughput, no PRU access needed */
+  if ( argc == 2 && strcmp(argv[1], "-b") == 0 )
+  {
+    return unpack_benchmark();
+  }
+
+  /* Trigger/reduction/packing/split modes: drop the options, keep the program name */
+  while ( argc >= 3 && (strcmp(argv[1], "-t") == 0 || strcmp(argv[1], "-r") == 0 || strcmp(argv[1], "-p") == 0 ||
+                        strcmp(argv[1], "-s") == 0) )
+  {
+    if ( argv[1][1] == 'p' || argv[1][1] == 's' )
+    {
+      if ( argv[1][1] == 'p' )
+      {
+        pack_opt = argv[1];
+      }
+      else
+      {
+        split_opt = argv[1];
+      }
+      argv[1]  = argv[0];
+      argc--;
+      argv++;
+      continue;
+    }
+
+    if ( argv[1][1] == 't' )
+    {
+      trig_spec = argv[2];
+    }
+    else
+    {
+      reduce_spec = argv[2];
+    }
+    argv[2] = argv[0];
+    argc -= 2;
+    argv += 2;
+  }
+
   /* Test user */
   if ( getuid() != 0 )
   {
@@ -50,106 +117,113 @@ int main(int argc, char *argv[])
   }
 
   /* Test input parameters */
-  if ( argc != 4 )
+  if ( ((argc != 4 && argc != 5) &&
+        !(argc == 2 && strcmp(argv[1], "-d") == 0 && trig_spec == NULL && reduce_spec == NULL && pack_opt == NULL &&
+          split_opt == NULL)) ||
+       ((trig_spec != NULL) + (reduce_spec != NULL) + (pack_opt != NULL) + (split_opt != NULL) > 1) )
   {
     printf("Wrong parameters.\n");
-    printf("Usage: %s <CHANNEL> <SAMPLE_RATE_HZ> <DURATION_SEC>\n\n", argv[0]);
+    printf("Usage: %s <CHANNEL> <SAMPLE_RATE_HZ> <DURATION_SEC> [BLOCK_SAMPLES]\n", argv[0]);
+    printf("       %s -t <TRIGGER> <CHANNEL> <SAMPLE_RATE_HZ> <DURATION_SEC>\n", argv[0]);
+    printf("       %s -r <REDUCTION> <CHANNEL> <SAMPLE_RATE_HZ> <DURATION_SEC> [BLOCK_SAMPLES]\n", argv[0]);
+    printf("       %s -p <CHANNEL> <SAMPLE_RATE_HZ> <DURATION_SEC> [BLOCK_SAMPLES]\n", argv[0]);
+    printf("       %s -s <CHANNEL> <SAMPLE_RATE_HZ> <DURATION_SEC> [BLOCK_SAMPLES]\n", argv[0]);
+    printf("       %s -b\n", argv[0]);
+    printf("       %s -d\n", argv[0]);
+    printf("       %s -c <start CHANNEL SAMPLE_RATE_HZ DURATION_SEC [FILE] | stop | status | quit>\n\n", argv[0]);
+    printf("\t-d: Daemon, keeps the PRU program loaded and waits commands on %s\n", DAEMON_SOCKET);
+    printf("\t-c: Send a command to the daemon\n\n");
+    printf("\tBLOCK_SAMPLES: samples written to file per PRU event (default %d, multiple of %d)\n",
+           DEF_BLOCK_LEN, ADC_FIFO0_LEN);
+    printf("\t               block times go to data_timestamps.txt\n\n");
+    printf("\t-t: Save only windows around trigger events for DURATION_SEC, the pool\n");
+    printf("\t    holds the windows not read yet. Window list goes to data_windows.txt\n");
+    printf("\t    TRIGGER: rise:LEVEL:PRE:POST | fall:LEVEL:PRE:POST | window:LOW:HIGH:PRE:POST\n");
+    printf("\t    LEVEL/LOW/HIGH: 0-4095, PRE/POST: samples (multiple of %d)\n\n", ADC_FIFO0_LEN);
+    printf("\t-r: Save one record per N samples, reduced by the PRU at the full rate\n");
+    printf("\t    REDUCTION: mean:N (index, mean) | env:N (index, min, max, mean)\n");
+    printf("\t    N: power of 2, 2-%u\n\n", 1u << REDUCE_MAX_SHIFT);
+    printf("\t-p: Packed samples, 2 in 3 bytes: the pool holds 33%% more time\n");
+    printf("\t-s: Split, PRU0 samples and PRU1 moves the samples to the pool in bursts\n");
+    printf("\t-b: Measure the unpacker throughput\n\n");
     printf("\tChannels: 0-6 (Just one channel allowed!)\n\n");
     printf("\tSample rates (Hz): 1600000,  800000, 400000,\n");
     printf("\t                    200000,  100000,  50000,\n");
-    printf("\t                     20000,   10000,   5000,\n"); 
+    printf("\t                     20000,   10000,   5000,\n");
     printf("\t                      2000,    1000,    500,\n");
     printf("\t                       200,     100\n\n");
     exit(EXIT_FAILURE);
   }
 
-  /* Get shared memory info */
-  uint32_t shr_mem_addr = 0;
-  uint32_t shr_mem_size = 0;
-  if ( get_pru_shared_mem_info(&shr_mem_addr, &shr_mem_size) < 0 )
+  p_src = src_pru_adc_create();
+  if ( p_src == NULL )
   {
+    perror("src_pru_adc_create()");
     return -1;
   }
 
-  /* Parse channel */
-  uint32_t channel = atoi(argv[1]);
-  if ( channel > 6 )
+  if ( (trig_spec != NULL && acq_set(p_src, "trigger", trig_spec) < 0) ||
+       (reduce_spec != NULL && acq_set(p_src, "reduce", reduce_spec) < 0) ||
+       (pack_opt != NULL && acq_set(p_src, "packed", "1") < 0) ||
+       (split_opt != NULL && acq_set(p_src, "split", "1") < 0) )
   {
-    printf("Channel doesn't exist. Sampling CH0 (Default)\n");
-    channel = 0;
+    acq_close(p_src);
+    return -1;
   }
-  uint32_t ch_cfg_code = (channel << 19) | (channel << 15) | 0x00000001;
-  
-  /* Parse sample rate */
-  uint32_t sample_rate = atoi(argv[2]);
-  if ( check_sample_rate(sample_rate) < 0 )
+
+  /* Install signal */
+  install_signal(&signal_handler);
+
+  /* Find the pool and load the PRU programs, they wait for commands */
+  if ( acq_open(p_src) < 0 )
   {
-    printf("Sample rate not supported. Sampling at %d Hz (Default)\n\n", DEF_SMP_RATE);
-    sample_rate = DEF_SMP_RATE;
+    acq_close(p_src);
+    return -1;
   }
-  uint32_t clk_div = (1600000/sample_rate) - 1;
-    
-  /* Parse acquiring duration */
-  float acquisition_time = atof(argv[3]);
-  float max_time = (float)(shr_mem_size / SAMPLE_SIZE) / sample_rate;
-  if ( acquisition_time > max_time )
+
+  if ( argc == 2 )
   {
-    printf("Shared memory not enough for specified acquiring duration.");
-    printf("Acquiring for %.2f seconds.\n\n", max_time);
-    acquisition_time = max_time;
+    int res = daemon_run(p_src);
+    acq_close(p_src);
+    return res;
   }
 
-  /* Number of samples */
-  uint32_t num_samples = acquisition_time * sample_rate;
-  uint32_t num_loops   = num_samples / ADC_FIFO0_LEN;
+  /* Single capture, saved block by block while sampling */
+  num_samples = capture_samples(p_src, argv[1], argv[2], argv[3]);
+  block_len   = (argc == 5) ? atoi(argv[4]) : DEF_BLOCK_LEN;
 
-  /* Install signal */
-  install_signal(&signal_handler);
+  p_sink = sink_text_create("data_samples.txt", (trig_spec != NULL) ? "data_windows.txt" : "data_timestamps.txt", 0);
+  if ( p_sink == NULL )
+  {
+    perror("sink_text_create()");
+    acq_close(p_src);
+    return -1;
+  }
 
-  /* Initialize struct used by prussdrv_pruintc_intc */
-  tpruss_intc_initdata pruss_intc_initdata = PRUSS_INTC_INITDATA;
-
-  /* Allocate and initialize memory */
-  prussdrv_init();
-  prussdrv_open(PRU_EVTOUT_0);
-
-  /* Data to pass to PRU0 */
-  uint32_t pru0_data[10];
-  pru0_data[0] = shr_mem_addr;
-  pru0_data[1] = clk_div;
-  pru0_data[2] = num_loops;
-  pru0_data[3] = ch_cfg_code;
-  pru0_data[4] = ADC_FIFO0_LEN;
-  prussdrv_pru_write_memory(PRUSS0_PRU0_DATARAM, 0, pru0_data, 5 * sizeof(uint32_t));
-
-  /* Map PRU's interrupts */
-  prussdrv_pruintc_init(&pruss_intc_initdata);
-
-  /* Print settings */
-  printf("Sampling settings:\n");
-  printf("\tSample rate:   %d Hz\n", sample_rate);
-  printf("\tTime:          %f seg\n", acquisition_time);
-  printf("\tSample size:   %d bytes\n", SAMPLE_SIZE);
-  printf("\tTotal samples: %d\n", num_samples);
   printf("Collecting...\n");
-  
-  /* Load and execute the PRU program on the PRU */
-  prussdrv_exec_program (PRU_NUM, "./pru_adc.bin");
-
-  /* Wait for event completion from PRU, returns the PRU_EVTOUT_0 number */
-  prussdrv_pru_wait_event(PRU_EVTOUT_0);
-  printf("Done!\n");
-
-  /* Save received data into a file */
-  printf("Saving file...\n");
-  parse_rcv_data_to_file("data_samples.txt", shr_mem_addr, num_samples, SAMPLE_SIZE);
-  printf("ok!\n\n");
+  n = acq_run(p_src, &p_sink, 1, num_samples, block_len, &STOP);
+  if ( n >= 0 )
+  {
+    if ( trig_spec != NULL )
+    {
+      printf("Done! %u windows, %llu samples saved.\n\n", p_src->stats.blocks,
+             (unsigned long long)sink_text_values(p_sink));
+    }
+    else if ( reduce_spec != NULL )
+    {
+      printf("Done! %d samples reduced to %llu records.\n\n", n, (unsigned long long)sink_text_values(p_sink));
+    }
+    else
+    {
+      printf("Done! %d samples saved.\n\n", n);
+    }
+  }
 
-  /* Disable PRU and close memory mappings */
-  prussdrv_pru_disable(PRU_NUM);
-  prussdrv_exit();
+  /* Stop PRU program and close memory mappings */
+  acq_close(p_src);
+  acq_sink_destroy(p_sink);
 
-  return 0;
+  return (n < 0) ? -1 : 0;
 }
 
 /***********************************************************************
@@ -158,7 +232,7 @@ int main(int argc, char *argv[])
 /***********************************************************************
  * @fn      signal_handler
  *
- * @brief
+ * @brief   SIGINT ends the capture, the blocks taken are still saved.
  *
  * @param   signal
  *
@@ -168,7 +242,7 @@ void signal_handler(int signal)
 {
   if ( signal == SIGINT )
   {
-    exit(-1);
+    STOP = 1;
   }
 }
 
@@ -185,8 +259,8 @@ int install_signal(void *signal_handler)
 {
   struct sigaction sig_cb;
 
+  memset(&sig_cb, 0, sizeof(sig_cb));
   sig_cb.sa_handler = signal_handler;
-  sig_cb.sa_flags   = SA_NOMASK;
   if ( sigaction(SIGINT, &sig_cb, NULL) )
   {
     perror("sigaction(SIGINT)");
@@ -197,154 +271,198 @@ int install_signal(void *signal_handler)
 }
 
 /***********************************************************************
- * @fn      check_sample_rate
+ * @fn      capture_samples
  *
- * @brief
+ * @brief   Apply the channel and sample rate from the user arguments
+ *          and turn the duration into samples at that rate.
  *
- * @param   smps
+ * @param   p_src
+ *          channel
+ *          rate
+ *          duration
  *
- * @return
+ * @return  Samples to capture
  **/
-int check_sample_rate(uint32_t smps)
+uint32_t capture_samples(acq_source_t *p_src, char *channel, char *rate, char *duration)
 {
-  if ( smps == 100    || smps == 200    || smps == 500    || 
-       smps == 1000   || smps == 2000   || smps == 5000   ||
-       smps == 10000  || smps == 20000  || smps == 50000  ||
-       smps == 100000 || smps == 200000 || smps == 400000 ||
-       smps == 800000 || smps == 1600000
-     )
-  {
-    return 0;
-  }
-  
-  return -1;
+  acq_option_t opt[2] = {{"channel", channel}, {"rate", rate}};
+  float acquisition_time = atof(duration);
+
+  /* Out of range values fall back to the defaults, with a message */
+  acq_configure(p_src, opt, 2);
+
+  return acquisition_time * (float)p_src->fmt.sample_rate;
 }
 
 /***********************************************************************
- * @fn      get_pru_shared_mem_info
+ * @fn      unpack_benchmark
  *
- * @brief   Read map1 files and loads size and address of shared mem.
+ * @brief   Unpack a pool sized buffer for about a second, check the
+ *          result and report the rate against the top ADC rate.
  *
- * @param   p_addr
- *          p_size
+ * @param   void
  *
- * @return
+ * @return  0 if the unpacker keeps up with 1600000 Hz
  **/
-int get_pru_shared_mem_info(uint32_t *p_addr, uint32_t *p_size)
+int unpack_benchmark(void)
 {
-  const char MMAP1_ADDR_FILE_DIR[] = "/sys/class/uio/uio0/maps/map1/addr";
-  const char MMAP1_SIZE_FILE_DIR[] = "/sys/class/uio/uio0/maps/map1/size";
-  uint32_t val = 0;
-  FILE *fp = NULL;
-
-  /* Read addr file */
-  fp = fopen(MMAP1_ADDR_FILE_DIR, "rt");
-  if ( fscanf(fp, "%x", &val) < 0 )
+  uint8_t *p_src = malloc(BENCH_SAMPLES / 2 * PACKED_PAIR_SIZE);
+  uint16_t *p_dst = malloc(BENCH_SAMPLES * sizeof(uint16_t));
+  struct timespec t0;
+  struct timespec t1;
+  uint64_t samples = 0;
+  double rate = 0;
+  uint32_t i = 0;
+
+  if ( p_src == NULL || p_dst == NULL )
   {
-    perror("fscanf(\"/sys/class/uio/uio0/maps/map1/addr)\"");
-    fclose(fp);
+    perror("malloc(benchmark)");
+    free(p_src);
+    free(p_dst);
     return -1;
   }
-  fclose(fp);
-  *p_addr = val;
 
-  /* Read size file */
-  fp = fopen(MMAP1_SIZE_FILE_DIR, "rt");
-  if ( fscanf(fp, "%x", &val) < 0 )
+  /* Pairs a | b << 12 with a known sequence */
+  for ( i = 0; i < BENCH_SAMPLES; i += 2 )
   {
-    perror("fscanf(/sys/class/uio/uio0/maps/map1/size)");
-    fclose(fp);
-    return -1;
+    uint32_t pair = (i & 0xFFF) | (((i + 1) & 0xFFF) << 12);
+    p_src[i / 2 * PACKED_PAIR_SIZE + 0] = pair;
+    p_src[i / 2 * PACKED_PAIR_SIZE + 1] = pair >> 8;
+    p_src[i / 2 * PACKED_PAIR_SIZE + 2] = pair >> 16;
   }
-  fclose(fp);
-  *p_size = val;
 
-  return 0;
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  do
+  {
+    acq_unpack_u12(p_src, p_dst, BENCH_SAMPLES);
+    samples += BENCH_SAMPLES;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+  } while ( timespec_diff(&t1, &t0) < BENCH_TIME );
+
+  for ( i = 0; i < BENCH_SAMPLES; i++ )
+  {
+    if ( p_dst[i] != (i & 0xFFF) )
+    {
+      printf("Unpacker error at sample %u: %u\n", i, p_dst[i]);
+      free(p_src);
+      free(p_dst);
+      return -1;
+    }
+  }
+
+  rate = samples / timespec_diff(&t1, &t0);
+  printf("Unpacker%s: %.1f Msamples/s, %.1fx the top ADC rate\n",
+#if defined(__ARM_NEON)
+         " (NEON)",
+#else
+         "",
+#endif
+         rate / 1e6, rate / ADC_TOP_RATE);
+
+  free(p_src);
+  free(p_dst);
+
+  return (rate >= ADC_TOP_RATE) ? 0 : -1;
 }
 
 /***********************************************************************
- * @fn      parse_rcv_data_to_file
+ * @fn      daemon_run
  *
- * @brief
+ * @brief   Serve capture commands from a local socket. One command per
+ *          connection, one text line, answered with "ok ..." or "error ...".
  *
- * @param   file_name
- *          shr_mem_addr
- *          num_samples
+ * @param   p_src
  *
  * @return
  **/
-int parse_rcv_data_to_file(char *file_name, uint32_t shr_mem_addr, uint32_t num_samples, uint32_t sample_size)
+int daemon_run(acq_source_t *p_src)
 {
-  const uint32_t MAP_SIZE = 0x0FFFFFFF;
-  const uint32_t MAP_MASK = (MAP_SIZE - 1);
-
-  uint32_t sample = 0;
-  off_t offset = shr_mem_addr;
-  void *p_addr_idx = NULL;
-  void *p_map_addr = NULL;
-  int fd = 0;
-
-  /* Open mem device */
-  fd = open("/dev/mem", O_RDWR | O_SYNC);
-  if ( fd < 0 )
+  char msg[MSG_MAX_LEN];
+  char reply[MSG_MAX_LEN];
+  char *arg[6];
+  int listen_fd = 0;
+  int client_fd = 0;
+  int quit = 0;
+  int n = 0;
+
+  listen_fd = acq_daemon_listen(DAEMON_SOCKET);
+  if ( listen_fd < 0 )
   {
-    perror("open(\"/dev/mem\")");
     return -1;
   }
 
-  p_map_addr = mmap(0, MAP_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, offset & ~MAP_MASK);
-  if( p_map_addr == (void *) - 1 )
+  while ( !quit )
   {
-    perror("mmap()");
-    close(fd);
-    return -1;
-  }
+    client_fd = acq_daemon_accept(listen_fd, msg, sizeof(msg), arg, 6, &n);
+    if ( client_fd < 0 )
+    {
+      continue;
+    }
 
-  /* Open data file */
-  FILE *fp = NULL;
-  fp = fopen(file_name, "wb");
-  if ( fp != NULL )
-  {
-    /* Store data into file */
-    int i = 0;
-    for ( i = 0; i < num_samples; i++ )
+    if ( n >= 4 && strcmp(arg[0], "start") == 0 )
     {
-      p_addr_idx = p_map_addr + (offset & MAP_MASK);
-      if ( sample_size == 1 )
-      {
-        sample = *((uint8_t *)p_addr_idx);
-      }
-      else if ( sample_size == 2 )
-      {
-        sample = *((uint16_t *)p_addr_idx);
-      }
-      else
-      {
-        sample = *((uint32_t *)p_addr_idx);
-        sample_size = sizeof(uint32_t);
-      }
-      fprintf(fp, "%u\t%u\n", i, sample);
-      offset += sample_size;
+      daemon_capture(p_src, client_fd, listen_fd, capture_samples(p_src, arg[1], arg[2], arg[3]),
+                     (n >= 5) ? arg[4] : "data_samples.txt", reply, sizeof(reply));
+    }
+    else if ( n >= 1 && (strcmp(arg[0], "stop") == 0 || strcmp(arg[0], "status") == 0) )
+    {
+      snprintf(reply, sizeof(reply), "ok idle\n");
+    }
+    else if ( n >= 1 && strcmp(arg[0], "quit") == 0 )
+    {
+      snprintf(reply, sizeof(reply), "ok\n");
+      quit = 1;
+    }
+    else
+    {
+      snprintf(reply, sizeof(reply), "error unknown command\n");
     }
 
-    /* Close file */
-    fclose(fp);
+    acq_daemon_reply(client_fd, reply);
   }
-  else
+
+  acq_daemon_close(listen_fd, DAEMON_SOCKET);
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      daemon_capture
+ *
+ * @brief   Run one capture, saved block by block while sampling. While
+ *          it runs, 'stop' from the requesting client (or its hang up)
+ *          or from a new connection ends it early.
+ *
+ * @param   p_src
+ *          client_fd
+ *          listen_fd
+ *          num_samples
+ *          file_name
+ *          reply
+ *          len
+ *
+ * @return
+ **/
+int daemon_capture(acq_source_t *p_src, int client_fd, int listen_fd, uint32_t num_samples, char *file_name,
+                   char *reply, size_t len)
+{
+  acq_sink_t *p_sink = sink_text_create(file_name, NULL, 0);
+  int samples = -1;
+
+  if ( p_sink != NULL )
   {
-    perror("fopen(data_file)");
+    samples = acq_daemon_capture(p_src, &p_sink, 1, num_samples, DEF_BLOCK_LEN, listen_fd, client_fd);
+    acq_sink_destroy(p_sink);
   }
 
-  /* Unmap memory */
-  if ( munmap(p_map_addr, MAP_SIZE) == -1 )
+  if ( samples < 0 )
   {
-    perror("munmap()");
-    close(fd);
+    snprintf(reply, len, "error saving %s\n", file_name);
     return -1;
   }
 
-  /* Close descriptor */
-  close(fd);
+  snprintf(reply, len, "ok %s %d %s %u\n", p_src->stats.stopped ? "stopped" : "done", samples, file_name,
+           p_src->stats.lost_samples);
 
   return 0;
 }
@@ -6,6 +6,93 @@
 ; Pin P9_29 (DEBUG_PIN) is used to check the sampling period as debug.
 ; Each period of signal DEBUG_PIN indicates the sampling of 2*FIFO0_LEN samples.
 ;
+; The program stays resident: after boot it idles polling a command word in
+; PRU Data RAM. The host writes the parameters and then CMD_START; every
+; capture ends with a PRU_EVTOUT_0 event and the PRU goes back to idle.
+;
+; With a block length set, PRU_EVTOUT_0 is also raised after each block of
+; 'Block loops' FIFO0 reads and the block sequence counter is published.
+; With 'Ring blocks' set the pool is used as a ring of that many blocks.
+; A number of loops of 0 runs until a STOP command.
+;
+; Each block is stamped with the PRU cycle counter (restarted when the ADC
+; is turned on) extended to 64 bits: the counter saturates, so once it
+; passes 2^31 it is folded into a 64-bit base and restarted. The stamps go
+; to a ring of 32 entries {cycles lo, cycles hi, block seq, status} in Data
+; RAM, written with a single SBBO.
+;
+; With a reduction mode set the samples are reduced in registers and only
+; one record per 2^shift samples is stored: the mean (2 bytes) or the
+; envelope {min, max, mean, 0} (8 bytes, one SBBO). Blocks must hold a
+; whole number of records.
+;
+; With packing set (plain sampling only) each pair of 12-bit samples is
+; stored in 3 bytes, a | b << 12, with one SBBO: 4 pairs make 8 samples in
+; 12 bytes. FIFO0 length must be even.
+;
+; With a trigger mode set only the samples around each trigger reach the
+; pool. The pool is a ring of window slots: a 16 bytes header, the
+; pre-trigger loops and the post-trigger loops. While armed the FIFO0
+; reads go round the pre-trigger part of the current slot; the read that
+; holds the trigger ends it, the header {trigger cycles lo, hi, oldest
+; pre-trigger loop, trigger sample in its read} is stored and the
+; post-trigger loops follow. A full window is handed to the host as a
+; block (stamp, sequence, event) and the next slot is armed once its
+; pre-trigger part is full again. 'Number of loops' counts windows then.
+;
+; With split set (plain sampling only) PRU0 just samples: each FIFO0 read
+; goes to a ring in PRU shared RAM and the bytes written are published
+; there. PRU1 (pru_adc_writer.p) moves them to the pool in bursts, raises
+; the block events and publishes the block sequence instead of PRU0. PRU0
+; waits while the ring is full, and at the end of capture until PRU1 has
+; moved everything, so the host sees the same blocks and events.
+;
+; Every FIFO0 read first collects the overrun/underflow events seen since
+; the last one (and clears just those) and waits for at least FIFO0 length
+; samples, so a late read catches up instead of waiting forever. The stamp
+; status of a block is lost samples | events << 16 | FIFO0 peak << 24.
+; After an overrun the lost samples are the samples due in the block time
+; ('Sample cycles' each, rounded) minus the ones read and left in FIFO0;
+; stamps must be less than 2^32 cycles apart. Windows carry the events
+; and peak only, a window is not contiguous in time.
+;
+; PRU Data RAM:
+;   0x00  Pool RAM address       (host)
+;   0x04  Clock div              (host)
+;   0x08  Number of loops        (host, trigger: windows)
+;   0x0C  Channel config         (host)
+;   0x10  FIFO0 length           (host)
+;   0x14  Command                (host writes, PRU clears when accepted)
+;   0x18  Status                 (PRU)
+;   0x1C  Loops done             (PRU)
+;   0x20  Block loops            (host, 0: no block events)
+;   0x24  Ring blocks            (host, 0: linear pool)
+;   0x28  Block sequence         (PRU)
+;   0x2C  End of capture cycles  (PRU, 64 bits)
+;   0x34  Trigger mode           (host, 0: off)
+;   0x38  Trigger levels         (host, low | high << 16)
+;   0x3C  Pre-trigger loops      (host, >= 1, counts the trigger read)
+;   0x40  Post-trigger loops     (host)
+;   0x44  Pre-trigger bytes      (host, 16 + pre loops * FIFO0 len * 2)
+;   0x48  Window slot bytes      (host, pre bytes + post loops * FIFO0 len * 2)
+;   0x4C  Reduction mode         (host, 0: off)
+;   0x50  Reduction shift        (host, 2^shift samples per record, 1 - 16)
+;   0x54  Packing                (host, 0: 2 bytes per sample, 1: 2 samples in 3 bytes)
+;   0x58  Sample cycles          (host, PRU cycles per sample)
+;   0x5C  Lost samples           (PRU, whole capture)
+;   0x60  FIFO0 events           (PRU, overrun/underflow bits seen in the capture)
+;   0x64  End of capture status  (PRU, stamp status of the samples after the last block)
+;   0x68  Last stamp             (PRU, cycles lo, FIFO0 count, loops done)
+;   0x74  Split                  (host, 0: PRU0 stores, 1: PRU1 stores from shared RAM)
+;   0x100 Block stamps ring      (PRU, 32 x 16 bytes)
+;
+; PRU shared RAM (split):
+;   0x10000 Samples ring         (PRU0, 8 KB)
+;   0x12000 Bytes written        (PRU0, free running, cleared by PRU1 at boot)
+;   0x12004 Bytes moved          (PRU1, free running)
+;   0x12008 Capture counter      (PRU0, starts PRU1)
+;   0x1200C Ring peak fill       (PRU1, bytes)
+;
 
 // --------------------------------------------------------------------
 // Defines
@@ -17,6 +104,7 @@
 #define ADC_BASE_ADDR     0x44E0D000
 #define ADC_FIFO0_ADDR    0x44E0D100
 #define ADC_FIFO1_ADDR    0x44E0D200
+#define IRQSTAT_RAW       0x24
 #define IRQSTAT           0x28
 #define IRQSET            0x2C
 #define IRQCLR            0x30
@@ -28,6 +116,98 @@
 #define FIFO0_CNT         0xE4
 #define FIFO0_THLD        0xE8
 
+; PRU Data RAM offsets
+#define PRU_DATA_RAM      0x00000000
+#define PARAM_POOL_ADDR   0x00
+#define PARAM_CLK_DIV     0x04
+#define PARAM_NUM_LOOPS   0x08
+#define PARAM_CH_CFG      0x0C
+#define PARAM_FIFO0_LEN   0x10
+#define PARAM_CMD         0x14
+#define PARAM_STATUS      0x18
+#define PARAM_LOOPS_DONE  0x1C
+#define PARAM_BLOCK_LOOPS 0x20
+#define PARAM_RING_BLOCKS 0x24
+#define PARAM_BLOCK_SEQ   0x28
+#define PARAM_END_CYCLES  0x2C
+#define PARAM_TRIG_MODE   0x34
+#define PARAM_TRIG_LEVEL  0x38
+#define PARAM_PRE_LOOPS   0x3C
+#define PARAM_POST_LOOPS  0x40
+#define PARAM_PRE_BYTES   0x44
+#define PARAM_SLOT_BYTES  0x48
+#define PARAM_REDUCE_MODE 0x4C
+#define PARAM_REDUCE_SHIFT 0x50
+#define PARAM_PACK        0x54
+#define PARAM_SAMPLE_CYCLES 0x58
+#define PARAM_LOST_SAMPLES 0x5C
+#define PARAM_FIFO_EVENTS 0x60
+#define PARAM_END_STATUS  0x64
+#define PARAM_LAST_STAMP  0x68
+#define PARAM_LAST_COUNT  0x6C
+#define PARAM_LAST_LOOPS  0x70
+#define PARAM_SPLIT       0x74
+#define STAMP_RING_ADDR   0x100
+#define STAMP_RING_MASK   31
+
+; PRU shared RAM: samples ring handed to PRU1 and its control words
+#define SPLIT_RING_ADDR   0x00010000
+#define SPLIT_RING_SIZE   0x2000
+#define SPLIT_RING_MASK   0x1FFF
+#define SPLIT_CTRL_ADDR   0x00012000
+#define SPLIT_WR          0x00
+#define SPLIT_RD          0x04
+#define SPLIT_GEN         0x08
+#define SPLIT_PEAK        0x0C
+
+; PRU0 Control Registers -- AM335x TRM, Chapter: 'PRU_ICSS'
+#define PRU0_CTRL_ADDR    0x00022000
+#define PRU_CTRL          0x00
+#define PRU_CYCLE         0x0C
+#define CTRL_CTR_EN       3
+
+; Cycle counter bit that triggers the fold into the 64-bit base, and the
+; cycles the counter misses while it is stopped to be restarted
+#ifndef CYCLE_FOLD_BIT
+#define CYCLE_FOLD_BIT    31
+#endif
+#define CYCLE_FOLD_LOST   13
+
+; FIFO0 error events -- IRQSTATUS bits
+#define FIFO0_OVERRUN     3
+#define FIFO0_UNDERFLOW   4
+#define FIFO0_EVENTS_MASK 0x18
+
+; Trigger modes
+#define TRIG_OFF          0
+#define TRIG_RISING       1     ; Previous sample below low level, sample at or above
+#define TRIG_FALLING      2     ; Previous sample above low level, sample at or below
+#define TRIG_WINDOW       3     ; Sample below low level or above high level
+
+; Trigger states
+#define TRIG_FILLING      0     ; Pre-trigger loops not full yet
+#define TRIG_ARMED        1     ; Looking for the trigger
+#define TRIG_FIRED        2     ; Trigger found in the current read
+#define TRIG_POSTING      3     ; Storing post-trigger loops
+#define WIN_HEADER_LEN    16
+
+; Reduction modes
+#define REDUCE_OFF        0
+#define REDUCE_MEAN       1     ; Mean of each record samples
+#define REDUCE_ENVELOPE   2     ; Min, max and mean of each record samples
+
+; Host commands
+#define CMD_NONE          0
+#define CMD_START         1
+#define CMD_STOP          2
+#define CMD_EXIT          3
+
+; Status
+#define STATUS_IDLE       0
+#define STATUS_RUNNING    1
+#define STATUS_DONE       2
+#define STATUS_STOPPED    3
+
 ; Registers used in code
 #define AUX_REG1        r1      ; Temp1
 #define AUX_REG2        r2      ; Temp2
@@ -38,11 +218,58 @@
 #define ADC_BASE        r7      ; ADC base address
 #define CH_CFG          r8      ; Channel register config
 #define FIFO0_LEN       r9      ; FIFO0 buffer length
+#define PARAM_BASE      r10     ; PRU Data RAM address
+#define CMD_REG         r11     ; Last command read from host
+#define LOOPS_DONE      r12     ; Loops performed
+#define BLOCK_LOOPS     r13     ; Loops per block
+#define BLOCK_CNT       r14     ; Loops left in current block
+#define BLOCK_SEQ       r15     ; Blocks completed
+#define RING_BLOCKS     r16     ; Blocks in the pool ring
+#define RING_CNT        r17     ; Blocks left before the ring wraps
+#define POOL_BASE       r18     ; Pool RAM start address
+#define CTRL_BASE       r19     ; PRU0 Control Registers address
+#define CYC_BASE_LO     r21     ; Cycles folded out of the counter (64 bits)
+#define CYC_BASE_HI     r22     ;
+#define STAMP_RING      r23     ; Block stamps ring address
+#define STAMP_LO        r24     ; Block stamp entry: r24 - r27
+#define STAMP_HI        r25     ;
+#define STAMP_SEQ       r26     ;
+#define STAMP_STATUS    r27     ;
+
+; Trigger mode, reusing registers of the setup (r6, r8) and free ones
+#define TRIG_PREV       r0.w0   ; Previous sample
+#define TRIG_MODE       r0.b2   ;
+#define TRIG_STATE      r0.b3   ;
+#define PRE_IDX         r6.w0   ; Pre-trigger loop being written
+#define PRE_LOOPS       r6.w2   ; Pre-trigger loops
+#define SLOT_BASE       r8      ; Current window slot address
+#define TRIG_LO         r28.w0  ; Trigger levels
+#define TRIG_HI         r28.w2  ;
+
+; Reduction, plain sampling only (same registers as the trigger mode).
+; ACC_MIN/ACC_MAX and AUX_REG1 (mean) are stored together as a record.
+#define ACC_MIN         r0.w0   ; Record accumulators
+#define ACC_MAX         r0.w2   ;
+#define ACC_SUM         r28     ;
+#define ACC_CNT         r6      ; Samples left in the record
+#define REDUCE_MODE     r8.b0   ;
+#define REDUCE_SHIFT    r8.b1   ;
+#define PACK_MODE       r8.b2   ; Pairs of samples in 3 bytes
+#define PACK_REG        r28     ;
+#define SPLIT_MODE      r8.b3   ; Samples handed to PRU1
+#define SPLIT_BYTES     r0      ; Bytes written to the shared ring
+#define SPLIT_END       r28     ; Shared ring end, control words base
 
 ; Debug
 #define DEBUG_CLK       r30.t1
 #define DBG_PIN_STATE   r20
 
+; FIFO0 events and peak count of the block, next to the debug pin state
+#define FIFO_EVENTS     r20.b1
+#define FIFO_PEAK       r20.b2
+#define OVERRUN_SEEN    r20.t11 ; FIFO_EVENTS bit FIFO0_OVERRUN
+#define DIV_BITS        r29.b0  ; Lost samples division (r29.w2: CALL)
+
 // --------------------------------------------------------------------
 // Macros
 // --------------------------------------------------------------------
@@ -63,6 +290,14 @@ DBG_LOW:                    ;
 FINISH:                     ;
 .endm
 
+; FIFO0 events since the last read, cleared one by one
+.macro FIFO0_CHECK
+  LBBO  AUX_REG1,    ADC_BASE, IRQSTAT_RAW, 4
+  SBBO  AUX_REG1,    ADC_BASE, IRQSTAT, 4
+  AND   AUX_REG1.b0, AUX_REG1.b0, FIFO0_EVENTS_MASK
+  OR    FIFO_EVENTS, FIFO_EVENTS, AUX_REG1.b0
+.endm
+
 // --------------------------------------------------------------------
 // MAIN
 // --------------------------------------------------------------------
@@ -72,26 +307,41 @@ START:
 	CLR   r0, r0, 4       ; clear bit 4 (STANDBY_INIT)
 	SBCO  r0, C4, 4, 4    ; store the modified r0 back at the load addr
 
-  ; Load input parameters
-  MOV   AUX_REG1,    0x00000000       ; AUX_REG1 points to RAM Data Address
-  LBBO  POOLRAM_PTR, AUX_REG1,  0, 4  ; Load Pool RAM Memory Address
-  LBBO  DIV_CLK,     AUX_REG1,  4, 4  ; Load Clk div number
-  LBBO  LOOP_NUM,    AUX_REG1,  8, 4  ; Load Number of Samples
-  LBBO  CH_CFG,      AUX_REG1, 12, 4  ; Load Ch Cfg code
-  LBBO  FIFO0_LEN,   AUX_REG1, 16, 4  ; Load fifo0 buffer len
+  MOV   PARAM_BASE, PRU_DATA_RAM          ; PARAM_BASE points to RAM Data Address
+  MOV   AUX_REG1,   STATUS_IDLE
+  SBBO  AUX_REG1,   PARAM_BASE, PARAM_STATUS, 4
 
 ; ---------------------------------------------------------------------
-; Clear Shared Mem
+; Idle -- Wait for a host command
 ; ---------------------------------------------------------------------
-  MOV   AUX_REG1,    0x0000           ; Aux1 holds Null Value
-  MOV   AUX_REG2,    LOOP_NUM         ; Aux2 holds sample number  (temporarily)
-  MOV   AUX_REG3,    POOLRAM_PTR      ; Aux3 points to shared mem (temporarily)
+IDLE:
+  LBBO  CMD_REG, PARAM_BASE, PARAM_CMD, 4 ; Poll command word
+  QBEQ  IDLE,    CMD_REG, CMD_NONE        ;
+  QBEQ  EXIT,    CMD_REG, CMD_EXIT        ;
+
+  ; Accept the command
+  MOV   AUX_REG1, CMD_NONE                ;
+  SBBO  AUX_REG1, PARAM_BASE, PARAM_CMD, 4
+  QBNE  IDLE,     CMD_REG, CMD_START      ; STOP while idle: nothing to do
+
+  MOV   AUX_REG1, STATUS_RUNNING          ;
+  SBBO  AUX_REG1, PARAM_BASE, PARAM_STATUS, 4
+
+  ; Load input parameters
+  LBBO  POOLRAM_PTR, PARAM_BASE, PARAM_POOL_ADDR, 4  ; Load Pool RAM Memory Address
+  LBBO  DIV_CLK,     PARAM_BASE, PARAM_CLK_DIV,   4  ; Load Clk div number
+  LBBO  LOOP_NUM,    PARAM_BASE, PARAM_NUM_LOOPS, 4  ; Load Number of Samples
+  LBBO  CH_CFG,      PARAM_BASE, PARAM_CH_CFG,    4  ; Load Ch Cfg code
+  LBBO  FIFO0_LEN,   PARAM_BASE, PARAM_FIFO0_LEN, 4  ; Load fifo0 buffer len
+  LBBO  BLOCK_LOOPS, PARAM_BASE, PARAM_BLOCK_LOOPS, 4  ; Load loops per block
+  LBBO  RING_BLOCKS, PARAM_BASE, PARAM_RING_BLOCKS, 4  ; Load blocks in ring
 
-CLR_SHR_MEM:
-  SBBO  AUX_REG1,    AUX_REG3, 0, 2   ; Store null data into Shared RAM
-  ADD   AUX_REG3,    AUX_REG3, 2      ; Increase pointer by SAMPLE_SIZE
-  SUB   AUX_REG2,    AUX_REG2, 1      ; Decrement loop counter
-  QBNE  CLR_SHR_MEM, AUX_REG2, 0      ;
+  MOV   POOL_BASE,   POOLRAM_PTR
+  MOV   LOOPS_DONE,  0
+  MOV   BLOCK_CNT,   BLOCK_LOOPS
+  MOV   BLOCK_SEQ,   0
+  MOV   RING_CNT,    RING_BLOCKS
+  SBBO  BLOCK_SEQ,   PARAM_BASE, PARAM_BLOCK_SEQ, 4
 
 ; ---------------------------------------------------------------------
 ; ADC Config
@@ -104,6 +354,15 @@ ADC_CONFIG:
   CLR   AUX_REG1.t0                         ; Clear BIT0 of Ctrl Register (Turn off ADC)
 	SBBO  AUX_REG1, ADC_BASE, CTRL, 4         ;
 
+  ; Drain samples left in FIFO0 by a previous capture
+FLUSH_FIFO:
+  LBBO  AUX_REG1, ADC_BASE, FIFO0_CNT, 4    ;
+  QBEQ  ADC_SETUP, AUX_REG1, 0              ;
+  MOV   AUX_REG2, ADC_FIFO0_ADDR            ;
+  LBBO  AUX_REG3, AUX_REG2, 0, 4            ; Discard one sample
+  QBA   FLUSH_FIFO                          ;
+
+ADC_SETUP:
   ; Clear Interrupt flags
   MOV   AUX_REG1, 0x000000FF                ; Mask interrputs flags
   SBBO  AUX_REG1, ADC_BASE, IRQSTAT, 4      ;
@@ -140,23 +399,76 @@ ADC_CONFIG:
   CLR   DEBUG_CLK         ; Starts with debug pin LOW
   MOV   DBG_PIN_STATE, 0  ; Dbg pin state: LOW
 
+  ; Restart the cycle counter (CYCLE is writable only while disabled)
+  MOV   CTRL_BASE, PRU0_CTRL_ADDR
+  LBBO  AUX_REG1,  CTRL_BASE, PRU_CTRL, 4
+  CLR   AUX_REG1,  AUX_REG1, CTRL_CTR_EN
+  SBBO  AUX_REG1,  CTRL_BASE, PRU_CTRL, 4
+  MOV   AUX_REG2,  0
+  SBBO  AUX_REG2,  CTRL_BASE, PRU_CYCLE, 4
+  SET   AUX_REG1,  AUX_REG1, CTRL_CTR_EN
+  SBBO  AUX_REG1,  CTRL_BASE, PRU_CTRL, 4
+  MOV   CYC_BASE_LO,  0
+  MOV   CYC_BASE_HI,  0
+  MOV   STAMP_RING,   STAMP_RING_ADDR
+  MOV   STAMP_STATUS, 0
+
+  ; Loss accounting starts with the counter: nothing lost, FIFO0 empty
+  ZERO  &AUX_REG1,    12
+  SBBO  AUX_REG1,     PARAM_BASE, PARAM_LOST_SAMPLES, 8
+  SBBO  AUX_REG1,     PARAM_BASE, PARAM_LAST_STAMP, 12
+
+  LBBO  AUX_REG1,  PARAM_BASE, PARAM_TRIG_MODE, 4
+  QBNE  TRIG_START, AUX_REG1, TRIG_OFF
+
+  ; Reduction setup, records start with the capture
+  LBBO  AUX_REG1,     PARAM_BASE, PARAM_REDUCE_MODE, 4
+  MOV   REDUCE_MODE,  AUX_REG1.b0
+  LBBO  AUX_REG1,     PARAM_BASE, PARAM_REDUCE_SHIFT, 4
+  MOV   REDUCE_SHIFT, AUX_REG1.b0
+  LBBO  AUX_REG1,     PARAM_BASE, PARAM_PACK, 4
+  MOV   PACK_MODE,    AUX_REG1.b0
+  MOV   ACC_SUM,      0
+  MOV   ACC_MIN,      0xFFFF
+  MOV   ACC_MAX,      0
+  MOV   ACC_CNT,      1
+  LSL   ACC_CNT,      ACC_CNT, REDUCE_SHIFT
+
+  ; Split setup: a new capture for PRU1, the shared ring (drained by the
+  ; last one) goes on where it is
+  LBBO  AUX_REG1,     PARAM_BASE, PARAM_SPLIT, 4
+  MOV   SPLIT_MODE,   AUX_REG1.b0
+  QBEQ  SAMPLING,     SPLIT_MODE, 0
+  MOV   SPLIT_END,    SPLIT_CTRL_ADDR
+  LBBO  AUX_REG1,     SPLIT_END, SPLIT_GEN, 4
+  ADD   AUX_REG1,     AUX_REG1, 1
+  SBBO  AUX_REG1,     SPLIT_END, SPLIT_GEN, 4
+  LBBO  SPLIT_BYTES,  SPLIT_END, SPLIT_RD, 4
+  MOV   POOLRAM_PTR,  SPLIT_RING_MASK
+  AND   POOLRAM_PTR,  POOLRAM_PTR, SPLIT_BYTES
+  MOV   AUX_REG1,     SPLIT_RING_ADDR
+  OR    POOLRAM_PTR,  POOLRAM_PTR, AUX_REG1
+
 ; ---------------------------------------------------------------------
 ; Loop Sampling
 ; ---------------------------------------------------------------------
 SAMPLING:
   DEBUG_ON ; Dbg pin is toogle here
 
-  ; Clear Interrupt flags
-  MOV   AUX_REG1,  0xFF
-  SBBO  AUX_REG1,  ADC_BASE, IRQSTAT, 4
+  ; Collect and clear Interrupt flags
+  FIFO0_CHECK
 
-  ; Check FIFO0 counter before copy data
+  ; Check FIFO0 counter before copy data, a late read starts at once
 ADC_COUNT:
   LBBO  AUX_REG1,  ADC_BASE, FIFO0_CNT, 4
-  QBNE  ADC_COUNT, AUX_REG1, FIFO0_LEN
+  QBGT  ADC_COUNT, AUX_REG1, FIFO0_LEN
+  MAX   FIFO_PEAK, FIFO_PEAK, AUX_REG1.b0
 
   ; Copy FIFO0 data to Shared Memory Space
   MOV   AUX_REG3,    FIFO0_LEN
+  QBNE  REDUCE_DATA, REDUCE_MODE, REDUCE_OFF
+  QBNE  PACK_DATA,   PACK_MODE, 0
+  QBNE  SPLIT_DATA,  SPLIT_MODE, 0
 COPY_DATA:
   MOV   AUX_REG1,    ADC_FIFO0_ADDR
   LBBO  AUX_REG2,    AUX_REG1,      0, 2  ; Load FIFO0 data into Aux3
@@ -165,10 +477,382 @@ COPY_DATA:
 
   SUB   AUX_REG3,    AUX_REG3, 1  ; Decrement FIFO0 counter samples
   QBNE  COPY_DATA,   AUX_REG3, 0  ; Stop if FIFO0 counter samples == 0
+  QBA   LOOP_END
+
+  ; Pack FIFO0 data, two samples in 3 bytes
+PACK_DATA:
+  MOV   AUX_REG1,    ADC_FIFO0_ADDR
+  LBBO  AUX_REG2,    AUX_REG1,    0, 4      ; a
+  LBBO  PACK_REG,    AUX_REG1,    0, 4      ; b
+  LSL   PACK_REG,    PACK_REG.w0, 12
+  OR    PACK_REG,    PACK_REG,    AUX_REG2.w0
+  SBBO  PACK_REG,    POOLRAM_PTR, 0, 3
+  ADD   POOLRAM_PTR, POOLRAM_PTR, 3
+  SUB   AUX_REG3,    AUX_REG3, 2
+  QBNE  PACK_DATA,   AUX_REG3, 0
+  QBA   LOOP_END
+
+  ; Hand FIFO0 data to PRU1, waiting while the shared ring is full
+SPLIT_DATA:
+  LBBO  AUX_REG1,    SPLIT_END,   SPLIT_RD, 4
+  SUB   AUX_REG1,    SPLIT_BYTES, AUX_REG1    ; Ring fill
+  ADD   AUX_REG1,    AUX_REG1,    FIFO0_LEN
+  ADD   AUX_REG1,    AUX_REG1,    FIFO0_LEN
+  MOV   AUX_REG2,    SPLIT_RING_SIZE
+  QBLT  SPLIT_DATA,  AUX_REG1,    AUX_REG2
+  MOV   AUX_REG1,    ADC_FIFO0_ADDR
+SPLIT_COPY:
+  LBBO  AUX_REG2,    AUX_REG1,    0, 2
+  SBBO  AUX_REG2,    POOLRAM_PTR, 0, 2
+  ADD   POOLRAM_PTR, POOLRAM_PTR, 2
+  QBNE  SPLIT_NEXT,  POOLRAM_PTR, SPLIT_END
+  MOV   POOLRAM_PTR, SPLIT_RING_ADDR
+SPLIT_NEXT:
+  SUB   AUX_REG3,    AUX_REG3, 1
+  QBNE  SPLIT_COPY,  AUX_REG3, 0
+  ADD   SPLIT_BYTES, SPLIT_BYTES, FIFO0_LEN
+  ADD   SPLIT_BYTES, SPLIT_BYTES, FIFO0_LEN
+  SBBO  SPLIT_BYTES, SPLIT_END,   SPLIT_WR, 4
+  QBA   LOOP_END
+
+  ; Reduce FIFO0 data, one record per 2^shift samples
+REDUCE_DATA:
+  MOV   AUX_REG1,    ADC_FIFO0_ADDR
+  LBBO  AUX_REG2,    AUX_REG1,    0, 2
+  ADD   ACC_SUM,     ACC_SUM,     AUX_REG2.w0
+  MIN   ACC_MIN,     ACC_MIN,     AUX_REG2.w0
+  MAX   ACC_MAX,     ACC_MAX,     AUX_REG2.w0
+  SUB   ACC_CNT,     ACC_CNT,     1
+  QBNE  REDUCE_NEXT, ACC_CNT,     0
+
+  LSR   AUX_REG1,    ACC_SUM,     REDUCE_SHIFT  ; Mean
+  QBEQ  REDUCE_ENV,  REDUCE_MODE, REDUCE_ENVELOPE
+  SBBO  AUX_REG1,    POOLRAM_PTR, 0, 2
+  ADD   POOLRAM_PTR, POOLRAM_PTR, 2
+  QBA   REDUCE_RESET
+REDUCE_ENV:
+  SBBO  ACC_MIN,     POOLRAM_PTR, 0, 8          ; {min, max} {mean, 0}
+  ADD   POOLRAM_PTR, POOLRAM_PTR, 8
+REDUCE_RESET:
+  MOV   ACC_SUM,     0
+  MOV   ACC_MIN,     0xFFFF
+  MOV   ACC_MAX,     0
+  MOV   ACC_CNT,     1
+  LSL   ACC_CNT,     ACC_CNT, REDUCE_SHIFT
+REDUCE_NEXT:
+  SUB   AUX_REG3,    AUX_REG3, 1
+  QBNE  REDUCE_DATA, AUX_REG3, 0
+
+LOOP_END:
+  ADD   LOOPS_DONE, LOOPS_DONE, 1 ; Increment loops counter
 
-  SUB   LOOP_NUM,  LOOP_NUM, 1    ; Decrement loops counter
-  QBNE  SAMPLING,  LOOP_NUM, 0    ; Finish if loops counter == 0
+  ; Block completed: publish its sequence number and notify host
+  QBEQ  BLOCK_END,   BLOCK_LOOPS, 0
+  SUB   BLOCK_CNT,   BLOCK_CNT, 1
+  QBNE  BLOCK_END,   BLOCK_CNT, 0
+  MOV   BLOCK_CNT,   BLOCK_LOOPS
 
-END:
+  ; Block stamp: 64-bit cycles, one store into the stamps ring
+  LBBO  AUX_REG1,    CTRL_BASE, PRU_CYCLE, 4
+  ADD   STAMP_LO,    CYC_BASE_LO, AUX_REG1
+  ADC   STAMP_HI,    CYC_BASE_HI, 0
+  CALL  LOST_SAMPLES
+  MOV   STAMP_SEQ,   BLOCK_SEQ
+  AND   AUX_REG2,    BLOCK_SEQ, STAMP_RING_MASK
+  LSL   AUX_REG2,    AUX_REG2, 4
+  ADD   AUX_REG2,    AUX_REG2, STAMP_RING
+  SBBO  STAMP_LO,    AUX_REG2, 0, 16
+
+  ADD   BLOCK_SEQ,   BLOCK_SEQ, 1
+  QBNE  BLOCK_END,   SPLIT_MODE, 0            ; Split: PRU1 hands the block over
+  SBBO  BLOCK_SEQ,   PARAM_BASE, PARAM_BLOCK_SEQ, 4
+  MOV   r31.b0, PRU0_R31_VEC_VALID | PRU_EVTOUT_0
+
+  ; Pool used as a ring of blocks
+  QBEQ  BLOCK_END,   RING_BLOCKS, 0
+  SUB   RING_CNT,    RING_CNT, 1
+  QBNE  BLOCK_END,   RING_CNT, 0
+  MOV   RING_CNT,    RING_BLOCKS
+  MOV   POOLRAM_PTR, POOL_BASE
+BLOCK_END:
+  CALL  CYCLE_FOLD
+
+  QBEQ  CAPTURE_DONE, LOOPS_DONE, LOOP_NUM ; Finish if all loops done
+
+  ; Any host command (STOP/EXIT) ends the capture early
+  LBBO  CMD_REG,   PARAM_BASE, PARAM_CMD, 4
+  QBEQ  SAMPLING,  CMD_REG, CMD_NONE
+  MOV   AUX_REG3,  STATUS_STOPPED
+  QBA   CAPTURE_END
+
+; ---------------------------------------------------------------------
+; Trigger Sampling -- Only windows around triggers reach the pool
+; ---------------------------------------------------------------------
+TRIG_START:
+  MOV   TRIG_MODE,   AUX_REG1.b0
+  LBBO  TRIG_LO,     PARAM_BASE, PARAM_TRIG_LEVEL, 4  ; Low and high levels
+  LBBO  AUX_REG1,    PARAM_BASE, PARAM_PRE_LOOPS,  4
+  MOV   PRE_LOOPS,   AUX_REG1.w0
+  LBBO  BLOCK_LOOPS, PARAM_BASE, PARAM_POST_LOOPS, 4  ; Block loops: post-trigger loops
+  MOV   SLOT_BASE,   POOL_BASE
+
+TRIG_ARM:
+  ADD   POOLRAM_PTR, SLOT_BASE, WIN_HEADER_LEN
+  MOV   PRE_IDX,     0
+  MOV   BLOCK_CNT,   0                    ; Block count: pre-trigger loops filled
+  MOV   TRIG_STATE,  TRIG_FILLING
+
+TRIG_SAMPLING:
+  ; Collect and clear Interrupt flags
+  FIFO0_CHECK
+
+TRIG_COUNT:
+  LBBO  AUX_REG1,   ADC_BASE, FIFO0_CNT, 4
+  QBGT  TRIG_COUNT, AUX_REG1, FIFO0_LEN
+  MAX   FIFO_PEAK,  FIFO_PEAK, AUX_REG1.b0
+
+  ; Copy FIFO0 data and look for the trigger while armed
+  MOV   AUX_REG3,    FIFO0_LEN
+TRIG_COPY:
+  MOV   AUX_REG1,    ADC_FIFO0_ADDR
+  LBBO  AUX_REG2,    AUX_REG1,      0, 2
+  SBBO  AUX_REG2,    POOLRAM_PTR,   0, 2
+  ADD   POOLRAM_PTR, POOLRAM_PTR,   2
+
+  QBNE  TRIG_NEXT,   TRIG_STATE, TRIG_ARMED
+  QBEQ  TRIG_FALL,   TRIG_MODE,  TRIG_FALLING
+  QBEQ  TRIG_OUT,    TRIG_MODE,  TRIG_WINDOW
+  QBLE  TRIG_NEXT,   TRIG_PREV,  TRIG_LO      ; Rising: previous below level
+  QBGT  TRIG_NEXT,   AUX_REG2.w0, TRIG_LO     ;   and sample at or above
+  QBA   TRIG_FIRE
+TRIG_FALL:
+  QBGE  TRIG_NEXT,   TRIG_PREV,  TRIG_LO      ; Falling: previous above level
+  QBLT  TRIG_NEXT,   AUX_REG2.w0, TRIG_LO     ;   and sample at or below
+  QBA   TRIG_FIRE
+TRIG_OUT:
+  QBGT  TRIG_FIRE,   AUX_REG2.w0, TRIG_LO     ; Window: sample below low level
+  QBGE  TRIG_NEXT,   AUX_REG2.w0, TRIG_HI     ;   or above high level
+TRIG_FIRE:
+  SUB   STAMP_STATUS, FIFO0_LEN, AUX_REG3     ; Trigger sample in this read
+  MOV   TRIG_STATE,  TRIG_FIRED
+TRIG_NEXT:
+  MOV   TRIG_PREV,   AUX_REG2.w0
+
+  SUB   AUX_REG3,    AUX_REG3, 1
+  QBNE  TRIG_COPY,   AUX_REG3, 0
+
+  ADD   LOOPS_DONE,  LOOPS_DONE, 1
+  QBEQ  TRIG_POST,   TRIG_STATE, TRIG_POSTING
+  QBEQ  TRIG_HEADER, TRIG_STATE, TRIG_FIRED
+
+  ; Pre-trigger loops go round their part of the slot
+  ADD   PRE_IDX,     PRE_IDX, 1
+  QBNE  TRIG_FILL,   PRE_IDX, PRE_LOOPS
+  MOV   PRE_IDX,     0
+  ADD   POOLRAM_PTR, SLOT_BASE, WIN_HEADER_LEN
+TRIG_FILL:
+  QBEQ  TRIG_CHECK,  TRIG_STATE, TRIG_ARMED
+  ADD   BLOCK_CNT,   BLOCK_CNT, 1
+  QBNE  TRIG_CHECK,  BLOCK_CNT, PRE_LOOPS
+  MOV   TRIG_STATE,  TRIG_ARMED
+  QBA   TRIG_CHECK
+
+TRIG_HEADER:
+  ; Window header: trigger read cycles, oldest pre-trigger loop and
+  ; trigger sample, in one store at the start of the slot
+  ADD   STAMP_SEQ,   PRE_IDX, 1
+  QBNE  TRIG_STAMP,  STAMP_SEQ, PRE_LOOPS
+  MOV   STAMP_SEQ,   0
+TRIG_STAMP:
+  LBBO  AUX_REG1,    CTRL_BASE, PRU_CYCLE, 4
+  ADD   STAMP_LO,    CYC_BASE_LO, AUX_REG1
+  ADC   STAMP_HI,    CYC_BASE_HI, 0
+  SBBO  STAMP_LO,    SLOT_BASE, 0, 16
+  MOV   STAMP_STATUS, 0
+
+  ; Post-trigger loops follow the pre-trigger ones
+  LBBO  AUX_REG1,    PARAM_BASE, PARAM_PRE_BYTES, 4
+  ADD   POOLRAM_PTR, SLOT_BASE, AUX_REG1
+  MOV   BLOCK_CNT,   BLOCK_LOOPS
+  MOV   TRIG_STATE,  TRIG_POSTING
+  QBEQ  TRIG_WINDOW_END, BLOCK_CNT, 0
+  QBA   TRIG_CHECK
+
+TRIG_POST:
+  SUB   BLOCK_CNT,   BLOCK_CNT, 1
+  QBNE  TRIG_CHECK,  BLOCK_CNT, 0
+
+TRIG_WINDOW_END:
+  ; Window completed: stamp it and notify host as a block
+  LBBO  AUX_REG1,    CTRL_BASE, PRU_CYCLE, 4
+  ADD   STAMP_LO,    CYC_BASE_LO, AUX_REG1
+  ADC   STAMP_HI,    CYC_BASE_HI, 0
+  MOV   STAMP_STATUS, 0
+  CALL  FIFO_STATUS
+  MOV   STAMP_SEQ,   BLOCK_SEQ
+  AND   AUX_REG2,    BLOCK_SEQ, STAMP_RING_MASK
+  LSL   AUX_REG2,    AUX_REG2, 4
+  ADD   AUX_REG2,    AUX_REG2, STAMP_RING
+  SBBO  STAMP_LO,    AUX_REG2, 0, 16
+
+  ADD   BLOCK_SEQ,   BLOCK_SEQ, 1
+  SBBO  BLOCK_SEQ,   PARAM_BASE, PARAM_BLOCK_SEQ, 4
+  MOV   r31.b0, PRU0_R31_VEC_VALID | PRU_EVTOUT_0
+
+  ; Next slot of the ring, armed again
+  LBBO  AUX_REG1,    PARAM_BASE, PARAM_SLOT_BYTES, 4
+  ADD   SLOT_BASE,   SLOT_BASE, AUX_REG1
+  SUB   RING_CNT,    RING_CNT, 1
+  QBNE  TRIG_REARM,  RING_CNT, 0
+  MOV   RING_CNT,    RING_BLOCKS
+  MOV   SLOT_BASE,   POOL_BASE
+TRIG_REARM:
+  ADD   POOLRAM_PTR, SLOT_BASE, WIN_HEADER_LEN
+  MOV   PRE_IDX,     0
+  MOV   BLOCK_CNT,   0
+  MOV   TRIG_STATE,  TRIG_FILLING
+  QBEQ  CAPTURE_DONE, BLOCK_SEQ, LOOP_NUM  ; Finish if all windows done
+
+TRIG_CHECK:
+  CALL  CYCLE_FOLD
+
+  LBBO  CMD_REG,       PARAM_BASE, PARAM_CMD, 4
+  QBEQ  TRIG_SAMPLING, CMD_REG, CMD_NONE
+  MOV   AUX_REG3,      STATUS_STOPPED
+  QBA   CAPTURE_END
+
+CAPTURE_DONE:
+  MOV   AUX_REG3,  STATUS_DONE
+
+CAPTURE_END:
+  MOV   CMD_REG,  AUX_REG3                  ; Status, kept across the calls below
+
+  ; End stamp and losses, with the samples left in FIFO0 still counted
+  LBBO  AUX_REG1, CTRL_BASE, PRU_CYCLE, 4
+  ADD   STAMP_LO, CYC_BASE_LO, AUX_REG1
+  ADC   STAMP_HI, CYC_BASE_HI, 0
+  SBBO  STAMP_LO, PARAM_BASE, PARAM_END_CYCLES, 8
+
+  MOV   STAMP_STATUS, 0
+  LBBO  AUX_REG1, PARAM_BASE, PARAM_TRIG_MODE, 4
+  QBNE  CAPTURE_TRIG, AUX_REG1, TRIG_OFF
+  CALL  LOST_SAMPLES                        ; Samples after the last block
+  QBEQ  CAPTURE_STATUS, SPLIT_MODE, 0
+
+  ; Split: wait for PRU1 to move the shared ring to the pool
+SPLIT_DRAIN:
+  LBBO  AUX_REG1, SPLIT_END, SPLIT_RD, 4
+  QBNE  SPLIT_DRAIN, AUX_REG1, SPLIT_BYTES
+  QBA   CAPTURE_STATUS
+CAPTURE_TRIG:
+  CALL  FIFO_STATUS
+CAPTURE_STATUS:
+  SBBO  STAMP_STATUS, PARAM_BASE, PARAM_END_STATUS, 4
+
+  ; Turn off ADC Module
+  LBBO  AUX_REG1, ADC_BASE, CTRL, 4         ;
+  CLR   AUX_REG1.t0                         ;
+  SBBO  AUX_REG1, ADC_BASE, CTRL, 4         ;
+
+  ; Publish loops done and status, then notify host
+  SBBO  LOOPS_DONE, PARAM_BASE, PARAM_LOOPS_DONE, 4
+  SBBO  CMD_REG,  PARAM_BASE, PARAM_STATUS, 4
+  MOV   r31.b0, PRU0_R31_VEC_VALID | PRU_EVTOUT_0
+  QBA   IDLE
+
+EXIT:
+  MOV   AUX_REG1, CMD_NONE                  ;
+  SBBO  AUX_REG1, PARAM_BASE, PARAM_CMD, 4  ;
   MOV   r31.b0, PRU0_R31_VEC_VALID | PRU_EVTOUT_0
   HALT
+
+; ---------------------------------------------------------------------
+; Fold the cycle counter into the 64-bit base before it saturates
+; ---------------------------------------------------------------------
+CYCLE_FOLD:
+  LBBO  AUX_REG1,    CTRL_BASE, PRU_CYCLE, 4
+  QBBC  FOLD_END,    AUX_REG1, CYCLE_FOLD_BIT
+  LBBO  AUX_REG2,    CTRL_BASE, PRU_CTRL, 4
+  CLR   AUX_REG2,    AUX_REG2, CTRL_CTR_EN
+  SBBO  AUX_REG2,    CTRL_BASE, PRU_CTRL, 4   ; Counter stopped
+  LBBO  AUX_REG1,    CTRL_BASE, PRU_CYCLE, 4
+  ADD   AUX_REG1,    AUX_REG1, CYCLE_FOLD_LOST
+  ADD   CYC_BASE_LO, CYC_BASE_LO, AUX_REG1
+  ADC   CYC_BASE_HI, CYC_BASE_HI, 0
+  MOV   AUX_REG1,    0
+  SBBO  AUX_REG1,    CTRL_BASE, PRU_CYCLE, 4
+  SET   AUX_REG2,    AUX_REG2, CTRL_CTR_EN
+  SBBO  AUX_REG2,    CTRL_BASE, PRU_CTRL, 4   ; Counter running
+FOLD_END:
+  RET
+
+; ---------------------------------------------------------------------
+; Stamp status of the samples since the last stamp (STAMP_LO): after an
+; overrun, lost = round(cycles / sample cycles) - (loops * FIFO0 length
+; + FIFO0 count now - FIFO0 count then). Uses r1 - r3, STAMP_SEQ.
+; ---------------------------------------------------------------------
+LOST_SAMPLES:
+  LBBO  STAMP_SEQ,    ADC_BASE, FIFO0_CNT, 4
+  LBBO  AUX_REG1,     PARAM_BASE, PARAM_LAST_STAMP, 12  ; Cycles, count, loops
+  SBBO  STAMP_LO,     PARAM_BASE, PARAM_LAST_STAMP, 4
+  SBBO  STAMP_SEQ,    PARAM_BASE, PARAM_LAST_COUNT, 4
+  SBBO  LOOPS_DONE,   PARAM_BASE, PARAM_LAST_LOOPS, 4
+  MOV   STAMP_STATUS, 0
+  QBBC  FIFO_STATUS,  OVERRUN_SEEN
+
+  ; Samples accounted for: read and left in FIFO0
+  SUB   STAMP_SEQ,    STAMP_SEQ, AUX_REG2
+  SUB   AUX_REG3,     LOOPS_DONE, AUX_REG3
+LOST_READ:
+  QBEQ  LOST_DIV,     AUX_REG3, 0
+  ADD   STAMP_SEQ,    STAMP_SEQ, FIFO0_LEN
+  SUB   AUX_REG3,     AUX_REG3, 1
+  QBA   LOST_READ
+
+  ; Samples due: cycles / sample cycles, rounded, by shift and subtract
+LOST_DIV:
+  SUB   AUX_REG1,     STAMP_LO, AUX_REG1
+  LBBO  AUX_REG2,     PARAM_BASE, PARAM_SAMPLE_CYCLES, 4
+  LSR   AUX_REG3,     AUX_REG2, 1
+  ADD   AUX_REG1,     AUX_REG1, AUX_REG3
+  MOV   AUX_REG3,     0                   ; Remainder
+  MOV   DIV_BITS,     32
+LOST_DIV_BIT:
+  LSL   AUX_REG3,     AUX_REG3, 1
+  QBBC  LOST_DIV_SHIFT, AUX_REG1, 31
+  OR    AUX_REG3,     AUX_REG3, 1
+LOST_DIV_SHIFT:
+  LSL   AUX_REG1,     AUX_REG1, 1
+  LSL   STAMP_STATUS, STAMP_STATUS, 1
+  QBGT  LOST_DIV_NEXT, AUX_REG3, AUX_REG2
+  SUB   AUX_REG3,     AUX_REG3, AUX_REG2
+  OR    STAMP_STATUS, STAMP_STATUS, 1
+LOST_DIV_NEXT:
+  SUB   DIV_BITS,     DIV_BITS, 1
+  QBNE  LOST_DIV_BIT, DIV_BITS, 0
+
+  ; Lost: due - accounted for, added to the capture total
+  QBGE  LOST_NONE,    STAMP_STATUS, STAMP_SEQ
+  SUB   STAMP_STATUS, STAMP_STATUS, STAMP_SEQ
+  LBBO  AUX_REG1,     PARAM_BASE, PARAM_LOST_SAMPLES, 4
+  ADD   AUX_REG1,     AUX_REG1, STAMP_STATUS
+  SBBO  AUX_REG1,     PARAM_BASE, PARAM_LOST_SAMPLES, 4
+  MOV   AUX_REG1,     0xFFFF
+  MIN   STAMP_STATUS, STAMP_STATUS, AUX_REG1
+  QBA   FIFO_STATUS
+LOST_NONE:
+  MOV   STAMP_STATUS, 0
+
+; ---------------------------------------------------------------------
+; FIFO0 events and peak into the stamp status and the capture events,
+; then restart them. Uses r1.
+; ---------------------------------------------------------------------
+FIFO_STATUS:
+  MOV   STAMP_STATUS.b2, FIFO_EVENTS
+  MOV   STAMP_STATUS.b3, FIFO_PEAK
+  LBBO  AUX_REG1,     PARAM_BASE, PARAM_FIFO_EVENTS, 4
+  OR    AUX_REG1,     AUX_REG1, FIFO_EVENTS
+  SBBO  AUX_REG1,     PARAM_BASE, PARAM_FIFO_EVENTS, 4
+  MOV   FIFO_EVENTS,  0
+  MOV   FIFO_PEAK,    0
+  RET
@@ -0,0 +1,177 @@
+; PRU1 program: moves the samples of a split capture from PRU shared RAM
+; to the Pool RAM (DDR), so PRU0 (pru_adc.p) only samples.
+;
+; PRU0 writes each FIFO0 read to an 8 KB ring in shared RAM and publishes
+; the bytes written. This program moves whatever is there in bursts of up
+; to 64 bytes (one LBBO into r12 - r27, one SBBO to the pool) and
+; publishes the bytes moved, so PRU0 knows the free space and when the
+; capture is drained. Bursts stop at the ring end and at block ends.
+;
+; The capture parameters are read from PRU0 Data RAM when PRU0 bumps the
+; capture counter. With block loops set, each block that reached the pool
+; is handed to the host as PRU0 would: block sequence published in PRU0
+; Data RAM and PRU_EVTOUT_0. The pool ring wraps after 'Ring blocks'.
+; PRU0 keeps stamping the blocks, the stamps land before the sequence.
+;
+; The byte counts run free across captures, a new one starts where the
+; last one was drained. The bytes written are read before the capture
+; counter, so data of a new capture is never moved with the old
+; parameters.
+;
+; PRU shared RAM -- must match pru_adc.p:
+;   0x10000 Samples ring         (PRU0, 8 KB)
+;   0x12000 Bytes written        (PRU0, free running, cleared by PRU1 at boot)
+;   0x12004 Bytes moved          (PRU1, free running)
+;   0x12008 Capture counter      (PRU0, starts PRU1)
+;   0x1200C Ring peak fill       (PRU1, bytes)
+;
+
+// --------------------------------------------------------------------
+// Defines
+// --------------------------------------------------------------------
+#define PRU1_R31_VEC_VALID  32  ; allows notification of programs end
+#define PRU_EVTOUT_0        3   ; the event number that is sent back
+
+; PRU0 Data RAM, as seen from PRU1, and its offsets
+#define PRU0_DATA_RAM     0x00002000
+#define PARAM_POOL_ADDR   0x00
+#define PARAM_FIFO0_LEN   0x10
+#define PARAM_BLOCK_LOOPS 0x20
+#define PARAM_RING_BLOCKS 0x24
+#define PARAM_BLOCK_SEQ   0x28
+
+; PRU shared RAM
+#define SPLIT_RING_MASK   0x1FFF  ; Ring offset of a byte count
+#define SPLIT_RING_SIZE   0x2000
+#define SPLIT_RING_BIT    16      ; Ring address: offset | 0x10000
+#define SPLIT_CTRL_ADDR   0x00012000
+#define SPLIT_WR          0x00
+#define SPLIT_RD          0x04
+#define SPLIT_GEN         0x08
+#define SPLIT_PEAK        0x0C
+#define BURST_MAX         64
+
+; Registers used in code
+#define BURST_LEN       r0.b0   ; Bytes in the current burst
+#define RING_PEAK       r0.w2   ; Ring peak fill
+#define AUX_REG1        r1      ; Temp1
+#define AUX_REG2        r2      ; Temp2
+#define AUX_REG3        r3      ; Temp3
+#define CTRL_BASE       r4      ; Shared RAM control words address
+#define CAPTURE_GEN     r5      ; Capture counter of the current capture
+#define BYTES_MOVED     r6      ; Bytes moved to the pool
+#define POOLRAM_PTR     r7      ; Pool RAM Address pointer
+#define POOL_BASE       r8      ; Pool RAM start address
+#define BLOCK_BYTES     r9      ; Bytes per block (0: no block events)
+#define BLOCK_LEFT      r10     ; Bytes left in current block
+#define BLOCK_SEQ       r11     ; Blocks completed
+#define BURST_BUF       r12     ; Burst buffer: r12 - r27
+#define RING_BLOCKS     r28     ; Blocks in the pool ring
+#define RING_CNT        r29     ; Blocks left before the ring wraps
+
+// --------------------------------------------------------------------
+// MAIN
+// --------------------------------------------------------------------
+.origin         0         ; start of program in PRU memory
+.entrypoint     START     ; program entry point
+
+START:
+  ; Enable the OCP master port -- allows transfer of data to Linux userspace
+  LBCO  r0, C4, 4, 4    ; load SYSCFG reg into r0 (use c4 const addr)
+  CLR   r0, r0, 4       ; clear bit 4 (STANDBY_INIT)
+  SBCO  r0, C4, 4, 4    ; store the modified r0 back at the load addr
+
+  ; Empty shared ring
+  MOV   CTRL_BASE,   SPLIT_CTRL_ADDR
+  MOV   BYTES_MOVED, 0
+  SBBO  BYTES_MOVED, CTRL_BASE, SPLIT_WR, 4
+  SBBO  BYTES_MOVED, CTRL_BASE, SPLIT_RD, 4
+  LBBO  CAPTURE_GEN, CTRL_BASE, SPLIT_GEN, 4
+
+; ---------------------------------------------------------------------
+; Idle -- Wait for PRU0 to start a split capture
+; ---------------------------------------------------------------------
+IDLE:
+  LBBO  AUX_REG1,    CTRL_BASE, SPLIT_GEN, 4
+  QBEQ  IDLE,        AUX_REG1, CAPTURE_GEN
+
+NEW_CAPTURE:
+  MOV   CAPTURE_GEN, AUX_REG1
+
+  ; Load capture parameters from PRU0 Data RAM
+  MOV   AUX_REG3,    PRU0_DATA_RAM
+  LBBO  POOL_BASE,   AUX_REG3, PARAM_POOL_ADDR,   4
+  LBBO  AUX_REG1,    AUX_REG3, PARAM_FIFO0_LEN,   4
+  LBBO  AUX_REG2,    AUX_REG3, PARAM_BLOCK_LOOPS, 4
+  LBBO  RING_BLOCKS, AUX_REG3, PARAM_RING_BLOCKS, 4
+
+  ; Block bytes: block loops * FIFO0 length * 2
+  LSL   AUX_REG1,    AUX_REG1, 1
+  MOV   BLOCK_BYTES, 0
+BLOCK_SIZE:
+  QBEQ  BLOCK_SIZE_END, AUX_REG2, 0
+  ADD   BLOCK_BYTES, BLOCK_BYTES, AUX_REG1
+  SUB   AUX_REG2,    AUX_REG2, 1
+  QBA   BLOCK_SIZE
+BLOCK_SIZE_END:
+
+  MOV   POOLRAM_PTR, POOL_BASE
+  MOV   BLOCK_LEFT,  BLOCK_BYTES
+  MOV   BLOCK_SEQ,   0
+  MOV   RING_CNT,    RING_BLOCKS
+  MOV   RING_PEAK,   0
+  SBBO  RING_PEAK,   CTRL_BASE, SPLIT_PEAK, 2
+
+; ---------------------------------------------------------------------
+; Move Loop -- Shared RAM ring to Pool RAM, one burst at a time
+; ---------------------------------------------------------------------
+MOVE:
+  LBBO  AUX_REG2,    CTRL_BASE, SPLIT_WR, 4
+  LBBO  AUX_REG1,    CTRL_BASE, SPLIT_GEN, 4
+  QBNE  NEW_CAPTURE, AUX_REG1, CAPTURE_GEN    ; Restarted by PRU0
+
+  SUB   AUX_REG1,    AUX_REG2, BYTES_MOVED    ; Ring fill
+  QBEQ  MOVE,        AUX_REG1, 0
+  QBLE  BURST_SIZE,  RING_PEAK, AUX_REG1.w0
+  MOV   RING_PEAK,   AUX_REG1.w0
+  SBBO  RING_PEAK,   CTRL_BASE, SPLIT_PEAK, 2
+
+  ; Burst: fill, up to BURST_MAX, the ring end and the block end
+BURST_SIZE:
+  MIN   AUX_REG1,    AUX_REG1, BURST_MAX
+  MOV   AUX_REG2,    SPLIT_RING_MASK
+  AND   AUX_REG2,    AUX_REG2, BYTES_MOVED    ; Ring offset
+  MOV   AUX_REG3,    SPLIT_RING_SIZE
+  SUB   AUX_REG3,    AUX_REG3, AUX_REG2
+  MIN   AUX_REG1,    AUX_REG1, AUX_REG3
+  SET   AUX_REG2,    AUX_REG2, SPLIT_RING_BIT
+  QBEQ  BURST_COPY,  BLOCK_BYTES, 0
+  MIN   AUX_REG1,    AUX_REG1, BLOCK_LEFT
+
+BURST_COPY:
+  MOV   BURST_LEN,   AUX_REG1.b0
+  LBBO  BURST_BUF,   AUX_REG2, 0, b0
+  SBBO  BURST_BUF,   POOLRAM_PTR, 0, b0
+  ADD   POOLRAM_PTR, POOLRAM_PTR, AUX_REG1
+  ADD   BYTES_MOVED, BYTES_MOVED, AUX_REG1
+
+  ; Block completed in the pool: publish its sequence number and notify host
+  QBEQ  BURST_END,   BLOCK_BYTES, 0
+  SUB   BLOCK_LEFT,  BLOCK_LEFT, AUX_REG1
+  QBNE  BURST_END,   BLOCK_LEFT, 0
+  MOV   BLOCK_LEFT,  BLOCK_BYTES
+  ADD   BLOCK_SEQ,   BLOCK_SEQ, 1
+  MOV   AUX_REG3,    PRU0_DATA_RAM
+  SBBO  BLOCK_SEQ,   AUX_REG3, PARAM_BLOCK_SEQ, 4
+  MOV   r31.b0, PRU1_R31_VEC_VALID | PRU_EVTOUT_0
+
+  ; Pool used as a ring of blocks
+  QBEQ  BURST_END,   RING_BLOCKS, 0
+  SUB   RING_CNT,    RING_CNT, 1
+  QBNE  BURST_END,   RING_CNT, 0
+  MOV   RING_CNT,    RING_BLOCKS
+  MOV   POOLRAM_PTR, POOL_BASE
+
+BURST_END:
+  SBBO  BYTES_MOVED, CTRL_BASE, SPLIT_RD, 4
+  QBA   MOVE
@@ -0,0 +1,238 @@
+#ifndef _ACQ_H
+#define _ACQ_H
+/***********************************************************************
+ * INCLUDES
+ **/
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+/***********************************************************************
+ * DEFINES
+ **/
+#define ACQ_MAX_STREAMS     2     /* Converters sampled in lockstep */
+#define ACQ_MAX_CHANNELS    16    /* Channels cycled through by a converter */
+#define ACQ_MAX_OPTIONS     16
+
+/* Record encodings, as the source stores them */
+#define ACQ_ENC_U16         0     /* One code per 16-bit word */
+#define ACQ_ENC_U12_PAIR    1     /* Two 12-bit codes in 3 bytes, a | b << 12 */
+#define ACQ_ENC_U16_ENV     2     /* Envelope record {min, max, mean, reserved} */
+#define ACQ_ENC_S24_TAGGED  3     /* Signed 24-bit code, channel index in the top byte */
+#define ACQ_ENC_S24_PACKED  4     /* Signed 24-bit code in 3 bytes, little endian */
+
+/* acq_read_block() results */
+#define ACQ_READ_END        0     /* Capture over, every block was read */
+#define ACQ_READ_BLOCK      1     /* A block was filled in */
+#define ACQ_READ_AGAIN      2     /* No block within the timeout */
+
+/* Block flags */
+#define ACQ_BLOCK_STAMPED   0x01  /* 'cycles' and 'real' are valid */
+#define ACQ_BLOCK_WINDOW    0x02  /* Trigger window, 'trig_index' is valid */
+
+/* Block status: samples lost in the block and device events */
+#define ACQ_STATUS_LOST(s)    ((s) & 0xFFFF)
+#define ACQ_STATUS_EVENTS(s)  (((s) >> 16) & 0xFF)
+#define ACQ_STATUS_PEAK(s)    ((s) >> 24)
+
+/* File writes */
+#define ACQ_IO_URING        0     /* io_uring, or the thread where the kernel lacks it */
+#define ACQ_IO_THREAD       1     /* pwrite() in a writer thread */
+
+/***********************************************************************
+ * TYPEDEFS
+ **/
+/* Layout of the records a source delivers. Streams (converters) are
+ * interleaved value by value on output, and each stream cycles through
+ * its channels value by value. */
+typedef struct acq_format_t
+{
+  uint32_t encoding;          /* ACQ_ENC_... */
+  uint32_t record_size;       /* Bytes per record */
+  uint32_t record_values;     /* Values per record (2: pairs) */
+  uint32_t decimation;        /* Samples per value (reduction), 1: every sample */
+  uint32_t num_streams;
+  uint32_t num_channels[ACQ_MAX_STREAMS];         /* 0 or 1: a single channel */
+  double   lsb[ACQ_MAX_STREAMS][ACQ_MAX_CHANNELS];  /* Volts per code, 0: unknown */
+  double   sample_rate;       /* Samples per second of a stream */
+  double   clock_hz;          /* Clock of the block stamps */
+} acq_format_t;
+
+/* A block of records, in place in the source buffer (no copies). It stays
+ * valid until the next acq_read_block() on its source; the source may
+ * overwrite it earlier only if the reader falls a whole ring behind. */
+typedef struct acq_block_t
+{
+  const uint8_t  *p_data[ACQ_MAX_STREAMS];  /* Records of each stream */
+  uint32_t        num_records;              /* Of each stream */
+  uint32_t        seq;
+  uint32_t        flags;                    /* ACQ_BLOCK_... */
+  uint32_t        status;                   /* ACQ_STATUS_... */
+  uint32_t        trig_index;               /* Window: value of the trigger */
+  uint64_t        cycles;                   /* Device clock at the last sample */
+  struct timespec real;                     /* CLOCK_REALTIME of 'cycles' */
+} acq_block_t;
+
+/* Of the current or last capture */
+typedef struct acq_stats_t
+{
+  uint64_t samples;           /* Delivered, of each stream */
+  uint32_t blocks;            /* Delivered */
+  uint32_t lost_blocks;       /* Overwritten before being read */
+  uint32_t lost_samples;      /* Dropped by the device */
+  uint32_t gaps;
+  int      stopped;           /* Ended by acq_stop() */
+  double   seconds;           /* Length by the device clock */
+} acq_stats_t;
+
+/* Of a file sink, for the last capture */
+typedef struct acq_write_stats_t
+{
+  const char *io;             /* "io_uring" or "thread" */
+  int      direct;            /* Written with O_DIRECT */
+  uint64_t bytes;
+  double   seconds;           /* First write to the last one done */
+  uint32_t num_bufs;
+  uint32_t max_depth;         /* Most buffers in flight */
+  uint32_t waits;             /* Times the capture waited for a buffer */
+  double   wait_seconds;
+} acq_write_stats_t;
+
+/* Least squares fit of host CLOCK_MONOTONIC against the device clock,
+ * anchored to CLOCK_REALTIME at capture start. */
+typedef struct clock_fit_t
+{
+  struct timespec mono0;
+  struct timespec real0;
+  double   clock_hz;
+  uint32_t n;
+  double   sx;
+  double   sy;
+  double   sxx;
+  double   sxy;
+} clock_fit_t;
+
+/* Count, mean, sum of squared deviations, extremes: of a window of
+ * codes, or of a part of it to be merged */
+typedef struct acq_summary_t
+{
+  uint64_t n;
+  double   mean;
+  double   m2;
+  int32_t  min;
+  int32_t  max;
+} acq_summary_t;
+
+typedef struct acq_option_t
+{
+  const char *key;
+  const char *value;
+} acq_option_t;
+
+/* A converter and its driver. Settings are staged by configure() before
+ * open() and applied at once after it; start() writes the capture and
+ * read_block() hands out each block as soon as it is complete. */
+typedef struct acq_source_t
+{
+  const char   *name;
+  void         *ctx;
+  acq_format_t  fmt;          /* Of the configured capture */
+  acq_stats_t   stats;
+  int  (*open)(struct acq_source_t *p_src);
+  int  (*configure)(struct acq_source_t *p_src, const acq_option_t *p_opt, uint32_t num_opts);
+  int  (*start)(struct acq_source_t *p_src, uint32_t num_samples, uint32_t block_len);
+  int  (*read_block)(struct acq_source_t *p_src, acq_block_t *p_block, int timeout_ms);
+  void (*stop)(struct acq_source_t *p_src);
+  int  (*event_fd)(struct acq_source_t *p_src);   /* Readable when blocks are due, -1: none */
+  void (*close)(struct acq_source_t *p_src);
+} acq_source_t;
+
+/* Consumer of the blocks of any source. A processing stage is a sink
+ * that hands its own blocks on to another sink. */
+typedef struct acq_sink_t
+{
+  const char *name;
+  void       *ctx;
+  int  (*open)(struct acq_sink_t *p_sink, const acq_format_t *p_fmt);
+  int  (*write)(struct acq_sink_t *p_sink, const acq_block_t *p_block);
+  int  (*close)(struct acq_sink_t *p_sink);
+  void (*destroy)(struct acq_sink_t *p_sink);
+} acq_sink_t;
+
+/***********************************************************************
+ * FUNCTIONS
+ **/
+/* Sources */
+int  acq_open(acq_source_t *p_src);
+int  acq_configure(acq_source_t *p_src, const acq_option_t *p_opt, uint32_t num_opts);
+int  acq_set(acq_source_t *p_src, const char *key, const char *value);
+int  acq_start(acq_source_t *p_src, uint32_t num_samples, uint32_t block_len);
+int  acq_read_block(acq_source_t *p_src, acq_block_t *p_block, int timeout_ms);
+void acq_stop(acq_source_t *p_src);
+int  acq_event_fd(acq_source_t *p_src);
+void acq_close(acq_source_t *p_src);
+int  acq_parse_option(char *arg, acq_option_t *p_opt);
+
+acq_source_t *src_pru_adc_create(void);
+acq_source_t *src_pru_ads1256_create(void);
+acq_source_t *src_ads1256_create(void);
+acq_source_t *src_file_create(void);
+acq_source_t *src_shm_create(void);
+
+/* Sinks */
+int  acq_sink_open(acq_sink_t **pp_sink, uint32_t num_sinks, const acq_format_t *p_fmt);
+int  acq_sink_write(acq_sink_t **pp_sink, uint32_t num_sinks, const acq_block_t *p_block);
+int  acq_sink_close(acq_sink_t **pp_sink, uint32_t num_sinks);
+void acq_sink_destroy(acq_sink_t *p_sink);
+
+acq_sink_t *sink_text_create(const char *file_name, const char *times_name, int volts);
+uint64_t    sink_text_values(acq_sink_t *p_sink);
+acq_sink_t *sink_codec_create(const char *file_name);
+int         sink_codec_configure(acq_sink_t *p_sink, const acq_option_t *p_opt, uint32_t num_opts);
+double      sink_codec_ratio(acq_sink_t *p_sink);
+void        sink_codec_stats(acq_sink_t *p_sink, acq_write_stats_t *p_stats);
+acq_sink_t *sink_shm_create(const char *name);
+int         sink_shm_configure(acq_sink_t *p_sink, const acq_option_t *p_opt, uint32_t num_opts);
+uint32_t    sink_shm_dropped(acq_sink_t *p_sink);
+acq_sink_t *sink_stats_create(const char *file_name, int volts);
+int         sink_stats_configure(acq_sink_t *p_sink, const acq_option_t *p_opt, uint32_t num_opts);
+acq_sink_t *sink_spectrum_create(const char *file_name, int volts);
+int         sink_spectrum_configure(acq_sink_t *p_sink, const acq_option_t *p_opt, uint32_t num_opts);
+
+/* Capture: source to sinks */
+int acq_run(acq_source_t *p_src, acq_sink_t **pp_sink, uint32_t num_sinks, uint32_t num_samples,
+            uint32_t block_len, volatile int *p_stop);
+
+/* Records to values */
+void acq_decode(const acq_format_t *p_fmt, uint32_t stream, const uint8_t *p_data, uint64_t first,
+                uint32_t num_values, int32_t *p_code, uint8_t *p_chan);
+void acq_to_volts(const acq_format_t *p_fmt, uint32_t stream, const int32_t *p_code, const uint8_t *p_chan,
+                  float *p_volts, uint32_t num_values);
+void acq_unpack_s24(const uint8_t *p_src, int32_t *p_dst, uint32_t num_values);
+void acq_unpack_u12(const uint8_t *p_src, uint16_t *p_dst, uint32_t num_values);
+
+/* Window statistics */
+void   acq_summary_reset(acq_summary_t *p_sum);
+void   acq_summary_add(acq_summary_t *p_sum, const int32_t *p_code, uint32_t num_values);
+void   acq_summary_merge(acq_summary_t *p_dst, const acq_summary_t *p_src);
+double acq_summary_std(const acq_summary_t *p_sum);
+double acq_summary_rms(const acq_summary_t *p_sum);
+
+/* Clock */
+double timespec_diff(const struct timespec *p_a, const struct timespec *p_b);
+void   clock_fit_init(clock_fit_t *p_fit, double clock_hz);
+void   clock_fit_add(clock_fit_t *p_fit, uint64_t cycles);
+void   clock_fit_eval(const clock_fit_t *p_fit, double *p_slope, double *p_offset);
+void   clock_fit_realtime(const clock_fit_t *p_fit, uint64_t cycles, struct timespec *p_ts);
+
+/* Command socket of the daemons */
+int  acq_daemon_listen(const char *path);
+int  acq_daemon_accept(int listen_fd, char *msg, size_t len, char **arg, int max_args, int *p_nargs);
+void acq_daemon_reply(int client_fd, const char *reply);
+void acq_daemon_close(int listen_fd, const char *path);
+int  acq_daemon_capture(acq_source_t *p_src, acq_sink_t **pp_sink, uint32_t num_sinks, uint32_t num_samples,
+                        uint32_t block_len, int listen_fd, int client_fd);
+int  acq_client_run(const char *path, int argc, char *argv[]);
+int  read_line(int fd, char *buf, size_t len);
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef _ACQ_ADS1256_H
+#define _ACQ_ADS1256_H
+/***********************************************************************
+ * INCLUDES
+ **/
+#include <stdint.h>
+
+/***********************************************************************
+ * DEFINES
+ **/
+/* Channel list entries: MUX register and PGA */
+#define ADS_CHAN_MAX        16
+#define ADS_AINCOM          8
+#define ADS_MUX(p, n)       (((p) << 4) | (n))
+#define CHAN_ENTRY(mux, pga)  ((mux) | ((pga) << 8))
+#define CHAN_MUX(e)         ((uint8_t)(e))
+#define CHAN_PGA(e)         (((e) >> 8) & 0x07)
+
+#define ADS_STATUS_BUFEN    0x02
+#define ADS_DRATE_30K       0xF0
+
+/* Volts per code, VREF 2.5 V (ADS1256 boards of this repo) */
+#define ADS_VREF            2.5
+#define ADS_LSB(pga)        (2 * ADS_VREF / (1 << (pga)) / 8388607)
+
+/***********************************************************************
+ * TYPEDEFS
+ **/
+/* ADS1256 registers written at startup and on reconfigure */
+typedef struct ads_config_t
+{
+  uint8_t status;
+  uint8_t mux;
+  uint8_t adcon;
+  uint8_t drate;
+  uint8_t io;
+  uint8_t cal;      /* Calibration command, 0: none */
+} ads_config_t;
+
+/***********************************************************************
+ * FUNCTIONS
+ **/
+int    ads_parse_channels(const char *arg, uint32_t *p_list);
+int    ads_parse_data_rate(const char *arg, uint8_t *p_drate);
+int    ads_parse_calibration(const char *arg, uint8_t *p_cal);
+double ads_data_rate(uint8_t drate);
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef _ACQ_CODEC_H
+#define _ACQ_CODEC_H
+/***********************************************************************
+ * INCLUDES
+ **/
+#include <stdio.h>
+#include <stdint.h>
+#include "acq.h"
+
+/***********************************************************************
+ * DEFINES
+ **/
+/* Recorded capture file: header, blocks, then the index of the blocks */
+#define ACQ_FILE_MAGIC      0x315A4341    /* "ACZ1" */
+#define ACQ_FILE_BLOCK      0x425A4341    /* "ACZB" */
+#define ACQ_FILE_INDEX      0x495A4341    /* "ACZI" */
+
+/* Block header flags, beside the ACQ_BLOCK_... of the block */
+#define ACQ_FILE_RAW        0x100         /* Records as the source stored them */
+
+/***********************************************************************
+ * TYPEDEFS
+ **/
+/* Fields in host order (little endian on the BeagleBone) */
+typedef struct acq_file_header_t
+{
+  uint32_t magic;
+  uint32_t encoding;
+  uint32_t record_size;
+  uint32_t record_values;
+  uint32_t decimation;
+  uint32_t num_streams;
+  uint32_t num_channels[ACQ_MAX_STREAMS];
+  double   sample_rate;
+  double   clock_hz;
+  double   lsb[ACQ_MAX_STREAMS][ACQ_MAX_CHANNELS];
+} acq_file_header_t;
+
+/* Before the data of each block, compressed or raw */
+typedef struct acq_file_block_t
+{
+  uint32_t magic;
+  uint32_t bytes;             /* Data after this header */
+  uint32_t num_records;
+  uint32_t seq;
+  uint32_t flags;             /* ACQ_BLOCK_..., ACQ_FILE_RAW */
+  uint32_t status;
+  uint32_t trig_index;
+  uint32_t reserved;
+  uint64_t cycles;
+  int64_t  real_sec;
+  int64_t  real_nsec;
+} acq_file_block_t;
+
+/* Last bytes of a file closed cleanly: where the block offsets are */
+typedef struct acq_file_index_t
+{
+  uint64_t offset;
+  uint32_t num_blocks;
+  uint32_t magic;
+} acq_file_index_t;
+
+/* Any block of a recorded capture, by its position in the file */
+typedef struct acq_reader_t
+{
+  FILE        *fp;
+  acq_format_t fmt;
+  uint32_t     num_blocks;
+  uint64_t    *p_offset;      /* Block headers */
+  uint8_t     *p_buf;         /* Data of the block read */
+  uint32_t     buf_size;
+  uint8_t     *p_records[ACQ_MAX_STREAMS];
+  uint32_t     max_records;
+} acq_reader_t;
+
+/***********************************************************************
+ * FUNCTIONS
+ **/
+/* Block codec */
+uint32_t acq_codec_bound(const acq_format_t *p_fmt, uint32_t num_records);
+uint32_t acq_codec_encode(const acq_format_t *p_fmt, const acq_block_t *p_block, uint8_t *p_out);
+int      acq_codec_decode(const acq_format_t *p_fmt, const uint8_t *p_in, uint32_t len, uint32_t num_records,
+                          uint8_t **pp_data);
+
+/* Recorded file */
+acq_reader_t *acq_reader_open(const char *file_name);
+int  acq_reader_read(acq_reader_t *p_rd, uint32_t index, acq_block_t *p_block);
+void acq_reader_close(acq_reader_t *p_rd);
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef _ACQ_FFT_H
+#define _ACQ_FFT_H
+/***********************************************************************
+ * INCLUDES
+ **/
+#include <stdint.h>
+
+/***********************************************************************
+ * DEFINES
+ **/
+/* Sizes of a real FFT, powers of 2 */
+#define ACQ_FFT_MIN_SIZE    32
+#define ACQ_FFT_MAX_SIZE    65536
+
+/***********************************************************************
+ * TYPEDEFS
+ **/
+/* Twiddles and work buffers of one size */
+typedef struct acq_fft_t acq_fft_t;
+
+/* One frequency: the DFT at it, over any number of values. Double, as
+ * the resonator runs over whole frames of samples */
+typedef struct acq_goertzel_t
+{
+  double   coeff;             /* 2 cos(w) */
+  double   s1;
+  double   s2;
+  uint64_t n;
+} acq_goertzel_t;
+
+/***********************************************************************
+ * FUNCTIONS
+ **/
+acq_fft_t *acq_fft_create(uint32_t size);
+void       acq_fft_destroy(acq_fft_t *p_fft);
+uint32_t   acq_fft_size(const acq_fft_t *p_fft);
+void       acq_fft_real(acq_fft_t *p_fft, const float *p_in, const float *p_window, float *p_re, float *p_im);
+
+void   acq_goertzel_init(acq_goertzel_t *p_gz, double freq);
+void   acq_goertzel_add(acq_goertzel_t *p_gz, const float *p_in, uint32_t num_values);
+double acq_goertzel_amplitude(const acq_goertzel_t *p_gz);
+
+#endif
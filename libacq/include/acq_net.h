@@ -0,0 +1,71 @@
+#ifndef _ACQ_NET_H
+#define _ACQ_NET_H
+/***********************************************************************
+ * INCLUDES
+ **/
+#include <stdint.h>
+#include "acq.h"
+
+/***********************************************************************
+ * DEFINES
+ **/
+#define ACQ_NET_MAGIC       0x4E514341    /* "ACQN" */
+#define ACQ_NET_FRAME       0x46514341    /* "ACQF" */
+#define ACQ_NET_VERSION     1
+#define ACQ_NET_PORT        7450
+#define ACQ_NET_SOCKET      "/tmp/acq_stream.sock"
+#define ACQ_NET_LINE_LEN    256
+
+/***********************************************************************
+ * TYPEDEFS
+ **/
+/* A subscriber connects and sends one line of options, separated by
+ * spaces (an empty line takes the blocks as published):
+ *   channels=LIST          Channels to keep, "0,2-3"; the second stream's
+ *                          channels are numbered after the first's
+ *   decimate=N             Keep one value in N of each channel
+ *   from=now|oldest        First block
+ * The server answers "ok\n" or "error ...\n", then the hello and one
+ * frame per block. With channels or decimate the frames hold a single
+ * stream of ACQ_ENC_S24_TAGGED records, as the hello's format says. */
+typedef struct acq_net_hello_t
+{
+  uint32_t     magic;         /* ACQ_NET_MAGIC */
+  uint32_t     version;
+  uint32_t     reserved[2];
+  acq_format_t fmt;           /* Of the frames of this subscriber */
+} acq_net_hello_t;
+
+/* Fields in host order, then 'bytes' of records, streams one after the
+ * other */
+typedef struct acq_net_frame_t
+{
+  uint32_t magic;             /* ACQ_NET_FRAME */
+  uint32_t bytes;
+  uint32_t num_records;       /* Of each stream */
+  uint32_t seq;
+  uint32_t flags;
+  uint32_t status;
+  uint32_t trig_index;
+  uint32_t lost;              /* Blocks this subscriber missed since the last frame,
+                                 the last frame too if its records were overwritten
+                                 while they were sent */
+  uint64_t cycles;
+  int64_t  real_sec;
+  int64_t  real_nsec;
+} acq_net_frame_t;
+
+typedef struct acq_server_t acq_server_t;
+
+/***********************************************************************
+ * FUNCTIONS
+ **/
+acq_server_t *acq_server_open(const char *shm_name, const char *unix_path, int tcp_port);
+int           acq_server_run(acq_server_t *p_srv, volatile int *p_stop);
+void          acq_server_close(acq_server_t *p_srv);
+
+int acq_net_connect(const char *unix_path, const char *host, int tcp_port);
+int acq_net_subscribe(int fd, const char *options, acq_net_hello_t *p_hello);
+int acq_net_read_frame(int fd, acq_net_frame_t *p_frame, uint8_t *p_data, uint32_t max_bytes);
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef _ACQ_PRU_H
+#define _ACQ_PRU_H
+/***********************************************************************
+ * INCLUDES
+ **/
+#include <stdint.h>
+#include "acq.h"
+
+/***********************************************************************
+ * DEFINES
+ **/
+#define PRU_CLK_HZ          200000000
+
+/* uio_pruss extram_pool (config_pru_pool_ram.sh) */
+#define MMAP1_ADDR_FILE_DIR "/sys/class/uio/uio0/maps/map1/addr"
+#define MMAP1_SIZE_FILE_DIR "/sys/class/uio/uio0/maps/map1/size"
+
+/* Stamps ring in PRU0 Data RAM, one entry per block */
+#define STAMP_RING_LEN      32
+#define STAMP_WORDS         4
+#define STAMP_CYC_LO        0
+#define STAMP_CYC_HI        1
+#define STAMP_SEQ           2
+#define STAMP_STATUS        3
+
+/* Stamps further apart than this many block periods: samples missed */
+#define GAP_FACTOR          1.5
+
+/***********************************************************************
+ * TYPEDEFS
+ **/
+/* The pool as a ring of blocks filled by the PRU: which blocks the host
+ * has yet to read, their stamps, and the rate and gaps they show. */
+typedef struct pru_ring_t
+{
+  volatile uint32_t *p_stamps;  /* Stamps ring */
+  uint32_t ring_blocks;
+  uint32_t block_len;           /* Samples per block */
+  double   block_cycles;        /* Nominal, 0: measured average */
+  uint32_t seq;                 /* Next block to read */
+  uint32_t last;                /* Blocks completed by the PRU */
+  uint32_t lost;                /* Blocks overwritten before being read */
+  clock_fit_t fit;
+  uint64_t prev_cycles;
+  uint32_t prev_seq;
+  uint32_t stamps;
+  uint32_t gaps;
+  uint64_t rate_cycles;
+  uint64_t rate_samples;
+  uint32_t rate_blocks;
+} pru_ring_t;
+
+/***********************************************************************
+ * FUNCTIONS
+ **/
+/* Pool and events */
+int  get_pru_shared_mem_info(uint32_t *p_addr, uint32_t *p_size);
+void pru_ack_event(void);
+int  pru_wait_event(int timeout_ms);
+int  pru_read_stamp(volatile uint32_t *p_stamps, uint32_t seq, uint64_t *p_cycles, uint32_t *p_status);
+
+/* Ring of blocks */
+void pru_ring_init(pru_ring_t *p_ring, volatile uint32_t *p_stamps, uint32_t ring_blocks, uint32_t block_len,
+                   double block_cycles);
+void pru_ring_update(pru_ring_t *p_ring, uint32_t last);
+int  pru_ring_next(pru_ring_t *p_ring, acq_block_t *p_block);
+void pru_ring_report(const pru_ring_t *p_ring, double sample_rate);
+
+
+#endif
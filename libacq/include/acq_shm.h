@@ -0,0 +1,66 @@
+#ifndef _ACQ_SHM_H
+#define _ACQ_SHM_H
+/***********************************************************************
+ * INCLUDES
+ **/
+#include <stdint.h>
+#include "acq.h"
+
+/***********************************************************************
+ * DEFINES
+ **/
+#define ACQ_SHM_MAGIC       0x53514341    /* "ACQS" */
+#define ACQ_SHM_VERSION     1
+
+/* Segment states */
+#define ACQ_SHM_RUNNING     1             /* Blocks are being published */
+#define ACQ_SHM_DONE        2             /* Capture over, or segment replaced */
+
+#define ACQ_SHM_REWRITING   UINT64_MAX    /* Slot 'seq' while it's rewritten */
+
+/* Default layout */
+#define ACQ_SHM_SLOTS       4096
+#define ACQ_SHM_DATA_SIZE   (8 << 20)
+
+/***********************************************************************
+ * TYPEDEFS
+ **/
+/* Start of the segment, then the slots, then the record area. Only the
+ * producer writes; readers map it read-only. 'write_seq' counts the
+ * blocks published, block n being in slot n % num_slots, and its
+ * records at 'pos' % data_size in the area (never split at the end).
+ * 'write_pos' is the end of the records taken so far: a block is
+ * overwritten once write_pos - pos > data_size. */
+typedef struct acq_shm_header_t
+{
+  uint32_t     magic;
+  uint32_t     version;
+  uint32_t     state;           /* ACQ_SHM_... */
+  uint32_t     capture;         /* Of the producer, bumped at every open */
+  uint32_t     num_slots;
+  uint32_t     data_size;
+  uint32_t     slots_offset;    /* From the start of the segment */
+  uint32_t     data_offset;
+  acq_format_t fmt;
+  uint64_t     write_seq;
+  uint64_t     write_pos;
+  uint32_t     futex;           /* Changes with write_seq and state, readers wait on it */
+  uint32_t     reserved;
+} acq_shm_header_t;
+
+typedef struct acq_shm_slot_t
+{
+  uint64_t seq;                 /* Block in the slot, ACQ_SHM_REWRITING */
+  uint64_t pos;                 /* Of the records, streams one after the other */
+  uint64_t cycles;
+  int64_t  real_sec;
+  int64_t  real_nsec;
+  uint32_t bytes;
+  uint32_t num_records;
+  uint32_t block_seq;
+  uint32_t flags;
+  uint32_t status;
+  uint32_t trig_index;
+} acq_shm_slot_t;
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef _ACQ_WRITER_H
+#define _ACQ_WRITER_H
+/***********************************************************************
+ * INCLUDES
+ **/
+#include <stdint.h>
+#include "acq.h"
+
+/***********************************************************************
+ * DEFINES
+ **/
+#define ACQ_WRITER_MAX_BUFS   64
+#define ACQ_WRITER_ALIGN      4096        /* O_DIRECT buffers, lengths and offsets */
+
+/* Default settings */
+#define ACQ_WRITER_BUF_SIZE   (1 << 20)
+#define ACQ_WRITER_NUM_BUFS   4
+#define ACQ_WRITER_PREALLOC   (64 << 20)  /* Reserved ahead of the writes */
+
+/***********************************************************************
+ * TYPEDEFS
+ **/
+typedef struct acq_writer_cfg_t
+{
+  uint32_t buf_size;          /* Bytes, ACQ_WRITER_ALIGN multiple */
+  uint32_t num_bufs;          /* 2 to ACQ_WRITER_MAX_BUFS */
+  uint32_t io;                /* ACQ_IO_... */
+  int      direct;            /* O_DIRECT, when the file system has it */
+  uint32_t prealloc;          /* fallocate() step in bytes, 0: none */
+} acq_writer_cfg_t;
+
+typedef struct acq_writer_t acq_writer_t;
+
+/***********************************************************************
+ * FUNCTIONS
+ **/
+void          acq_writer_defaults(acq_writer_cfg_t *p_cfg);
+acq_writer_t *acq_writer_open(const char *file_name, const acq_writer_cfg_t *p_cfg);
+int           acq_writer_put(acq_writer_t *p_wr, const void *p_data, uint32_t len);
+int           acq_writer_close(acq_writer_t *p_wr, acq_write_stats_t *p_stats);
+
+#endif
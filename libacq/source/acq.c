@@ -0,0 +1,397 @@
+/***********************************************************************
+ * INCLUDES
+ **/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include "acq.h"
+#include "trace.h"
+#include "metrics.h"
+
+/***********************************************************************
+ * DEFINES
+ **/
+#define RUN_POLL_MS   100   /* Stop flag checked at least this often */
+
+/***********************************************************************
+ * GLOBALS
+ **/
+/* Of every source read in the process */
+METRIC_COUNTER(ACQ_BLOCKS, "acq_blocks_total", "Blocks read");
+METRIC_COUNTER(ACQ_SAMPLES, "acq_samples_total", "Samples read, of each stream");
+METRIC_COUNTER(ACQ_LOST_BLOCKS, "acq_lost_blocks_total", "Blocks overwritten before being read");
+METRIC_COUNTER(ACQ_LOST_SAMPLES, "acq_lost_samples_total", "Samples dropped by the device");
+METRIC_COUNTER(ACQ_GAPS, "acq_gaps_total", "Gaps in the device clock");
+METRIC_HISTOGRAM(ACQ_BLOCK_LATENCY, "acq_block_latency_seconds", "From the last sample of a block to its read",
+                 1e-9, 100000, 250000, 500000, 1000000, 2500000, 5000000, 10000000, 25000000, 50000000,
+                 100000000, 250000000, 500000000, 1000000000);
+
+/***********************************************************************
+ * FUNCTIONS
+ **/
+/***********************************************************************
+ * @fn      acq_open
+ *
+ * @brief   Take the device and apply the staged settings.
+ *
+ * @param   p_src
+ *
+ * @return  0, -1 on error
+ **/
+int acq_open(acq_source_t *p_src)
+{
+  memset(&p_src->stats, 0, sizeof(acq_stats_t));
+
+  return p_src->open(p_src);
+}
+
+/***********************************************************************
+ * @fn      acq_configure
+ *
+ * @brief   Stage or apply settings, all of them or none.
+ *
+ * @param   p_src
+ *          p_opt
+ *          num_opts
+ *
+ * @return  0, -1 if a key or value is invalid or the device refused them
+ **/
+int acq_configure(acq_source_t *p_src, const acq_option_t *p_opt, uint32_t num_opts)
+{
+  return p_src->configure(p_src, p_opt, num_opts);
+}
+
+/***********************************************************************
+ * @fn      acq_set
+ *
+ * @brief   acq_configure() of a single setting.
+ *
+ * @param   p_src
+ *          key
+ *          value
+ *
+ * @return  0, -1 on error
+ **/
+int acq_set(acq_source_t *p_src, const char *key, const char *value)
+{
+  acq_option_t opt;
+
+  opt.key   = key;
+  opt.value = value;
+
+  return p_src->configure(p_src, &opt, 1);
+}
+
+/***********************************************************************
+ * @fn      acq_start
+ *
+ * @brief   Start a capture. p_src->fmt holds its format afterwards.
+ *
+ * @param   p_src
+ *          num_samples - Of each stream, the source may clamp it
+ *          block_len - Samples per block, the source may round it
+ *
+ * @return  0, -1 on error
+ **/
+int acq_start(acq_source_t *p_src, uint32_t num_samples, uint32_t block_len)
+{
+  memset(&p_src->stats, 0, sizeof(acq_stats_t));
+
+  return p_src->start(p_src, num_samples, block_len);
+}
+
+/***********************************************************************
+ * @fn      acq_read_block
+ *
+ * @brief   Next block of the running capture.
+ *
+ * @param   p_src
+ *          p_block
+ *          timeout_ms - < 0: wait for a block or the end
+ *
+ * @return  ACQ_READ_BLOCK, ACQ_READ_AGAIN, ACQ_READ_END, -1 on error
+ **/
+int acq_read_block(acq_source_t *p_src, acq_block_t *p_block, int timeout_ms)
+{
+  struct timespec now;
+  uint64_t samples = 0;
+  uint32_t lost_blocks = p_src->stats.lost_blocks;
+  uint32_t gaps = p_src->stats.gaps;
+  double latency = 0;
+  int res = 0;
+
+  TRACE_BEGIN("acq_read_block");
+  res = p_src->read_block(p_src, p_block, timeout_ms);
+  TRACE_END();
+
+  if ( res == ACQ_READ_BLOCK )
+  {
+    samples = (uint64_t)p_block->num_records * p_src->fmt.record_values * p_src->fmt.decimation;
+    p_src->stats.blocks++;
+    p_src->stats.samples += samples;
+    p_src->stats.lost_samples += ACQ_STATUS_LOST(p_block->status);
+
+    metric_inc(&ACQ_BLOCKS);
+    metric_add(&ACQ_SAMPLES, samples);
+    metric_add(&ACQ_LOST_SAMPLES, ACQ_STATUS_LOST(p_block->status));
+    if ( p_block->real.tv_sec != 0 )
+    {
+      clock_gettime(CLOCK_REALTIME, &now);
+      latency = timespec_diff(&now, &p_block->real);
+      metric_observe(&ACQ_BLOCK_LATENCY, (latency > 0) ? (uint64_t)(latency * 1e9) : 0);
+    }
+  }
+  metric_add(&ACQ_LOST_BLOCKS, p_src->stats.lost_blocks - lost_blocks);
+  metric_add(&ACQ_GAPS, p_src->stats.gaps - gaps);
+
+  return res;
+}
+
+/***********************************************************************
+ * @fn      acq_stop
+ *
+ * @brief   End the running capture early. Blocks taken so far are still
+ *          read, up to ACQ_READ_END.
+ *
+ * @param   p_src
+ *
+ * @return  void
+ **/
+void acq_stop(acq_source_t *p_src)
+{
+  p_src->stop(p_src);
+}
+
+/***********************************************************************
+ * @fn      acq_event_fd
+ *
+ * @brief   Descriptor to poll() along others while capturing.
+ *
+ * @param   p_src
+ *
+ * @return  Descriptor, -1 if the source has none: poll with a timeout
+ **/
+int acq_event_fd(acq_source_t *p_src)
+{
+  return (p_src->event_fd != NULL) ? p_src->event_fd(p_src) : -1;
+}
+
+/***********************************************************************
+ * @fn      acq_close
+ *
+ * @brief   Release the device and free the source.
+ *
+ * @param   p_src
+ *
+ * @return  void
+ **/
+void acq_close(acq_source_t *p_src)
+{
+  if ( p_src == NULL )
+  {
+    return;
+  }
+
+  p_src->close(p_src);
+  free(p_src->ctx);
+  free(p_src);
+}
+
+/***********************************************************************
+ * @fn      acq_parse_option
+ *
+ * @brief   Split "key=value" in place.
+ *
+ * @param   arg
+ *          p_opt
+ *
+ * @return  0, -1 without '='
+ **/
+int acq_parse_option(char *arg, acq_option_t *p_opt)
+{
+  char *p_eq = strchr(arg, '=');
+
+  if ( p_eq == NULL || p_eq == arg )
+  {
+    return -1;
+  }
+
+  *p_eq = '\0';
+  p_opt->key   = arg;
+  p_opt->value = p_eq + 1;
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      acq_sink_open
+ *
+ * @brief   Open every sink for a capture of format 'p_fmt'. On error the
+ *          sinks already open are closed again.
+ *
+ * @param   pp_sink
+ *          num_sinks
+ *          p_fmt
+ *
+ * @return  0, -1 on error
+ **/
+int acq_sink_open(acq_sink_t **pp_sink, uint32_t num_sinks, const acq_format_t *p_fmt)
+{
+  uint32_t i = 0;
+
+  for ( i = 0; i < num_sinks; i++ )
+  {
+    if ( pp_sink[i]->open != NULL && pp_sink[i]->open(pp_sink[i], p_fmt) < 0 )
+    {
+      acq_sink_close(pp_sink, i);
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      acq_sink_write
+ *
+ * @brief   Hand a block to every sink.
+ *
+ * @param   pp_sink
+ *          num_sinks
+ *          p_block
+ *
+ * @return  0, -1 if a sink failed (the others still got the block)
+ **/
+int acq_sink_write(acq_sink_t **pp_sink, uint32_t num_sinks, const acq_block_t *p_block)
+{
+  uint32_t i = 0;
+  int res = 0;
+
+  TRACE_BEGIN("acq_sink_write");
+  for ( i = 0; i < num_sinks; i++ )
+  {
+    TRACE_BEGIN(pp_sink[i]->name);
+    if ( pp_sink[i]->write(pp_sink[i], p_block) < 0 )
+    {
+      res = -1;
+    }
+    TRACE_END();
+  }
+  TRACE_END();
+
+  return res;
+}
+
+/***********************************************************************
+ * @fn      acq_sink_close
+ *
+ * @brief   End of capture for every sink.
+ *
+ * @param   pp_sink
+ *          num_sinks
+ *
+ * @return  0, -1 if a sink failed
+ **/
+int acq_sink_close(acq_sink_t **pp_sink, uint32_t num_sinks)
+{
+  uint32_t i = 0;
+  int res = 0;
+
+  for ( i = 0; i < num_sinks; i++ )
+  {
+    if ( pp_sink[i]->close != NULL && pp_sink[i]->close(pp_sink[i]) < 0 )
+    {
+      res = -1;
+    }
+  }
+
+  return res;
+}
+
+/***********************************************************************
+ * @fn      acq_sink_destroy
+ *
+ * @brief
+ *
+ * @param   p_sink
+ *
+ * @return  void
+ **/
+void acq_sink_destroy(acq_sink_t *p_sink)
+{
+  if ( p_sink == NULL )
+  {
+    return;
+  }
+
+  if ( p_sink->destroy != NULL )
+  {
+    p_sink->destroy(p_sink);
+  }
+  free(p_sink->ctx);
+  free(p_sink);
+}
+
+/***********************************************************************
+ * @fn      acq_run
+ *
+ * @brief   Run a capture and hand each block to the sinks as soon as the
+ *          source completes it. Setting '*p_stop' ends the capture
+ *          early, the blocks already taken are still written.
+ *
+ * @param   p_src - Open
+ *          pp_sink
+ *          num_sinks
+ *          num_samples
+ *          block_len
+ *          p_stop - NULL: run to the end
+ *
+ * @return  Samples delivered, -1 on error
+ **/
+int acq_run(acq_source_t *p_src, acq_sink_t **pp_sink, uint32_t num_sinks, uint32_t num_samples,
+            uint32_t block_len, volatile int *p_stop)
+{
+  acq_block_t block;
+  int stopping = 0;
+  int res = 0;
+
+  if ( acq_start(p_src, num_samples, block_len) < 0 )
+  {
+    return -1;
+  }
+
+  if ( acq_sink_open(pp_sink, num_sinks, &p_src->fmt) < 0 )
+  {
+    acq_stop(p_src);
+    while ( acq_read_block(p_src, &block, -1) > 0 );
+    return -1;
+  }
+
+  for ( ;; )
+  {
+    if ( !stopping && p_stop != NULL && *p_stop )
+    {
+      acq_stop(p_src);
+      stopping = 1;
+    }
+
+    res = acq_read_block(p_src, &block, (p_stop != NULL && !stopping) ? RUN_POLL_MS : -1);
+    if ( res == ACQ_READ_BLOCK )
+    {
+      acq_sink_write(pp_sink, num_sinks, &block);
+    }
+    else if ( res != ACQ_READ_AGAIN )
+    {
+      break;
+    }
+  }
+
+  if ( acq_sink_close(pp_sink, num_sinks) < 0 || res < 0 )
+  {
+    return -1;
+  }
+
+  return (int)p_src->stats.samples;
+}
@@ -0,0 +1,190 @@
+/***********************************************************************
+ * INCLUDES
+ **/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "acq_ads1256.h"
+
+/***********************************************************************
+ * GLOBALS
+ **/
+/* DRATE codes, datasheet Table 13 */
+static const struct { double sps; uint8_t code; } DRATES[] =
+{
+  {30000, 0xF0}, {15000, 0xE0}, {7500, 0xD0}, {3750, 0xC0}, {2000, 0xB0}, {1000, 0xA1},
+  {500, 0x92},   {100, 0x82},   {60, 0x72},   {50, 0x63},   {30, 0x53},   {25, 0x43},
+  {15, 0x33},    {10, 0x23},    {5, 0x13},    {2.5, 0x03}
+};
+
+/* Calibration commands */
+static const struct { const char *name; uint8_t cmd; } CALS[] =
+{
+  {"none", 0}, {"self", 0xF0}, {"offset", 0xF1}, {"gain", 0xF2}, {"sysoffset", 0xF3}, {"sysgain", 0xF4}
+};
+
+/***********************************************************************
+ * FUNCTIONS
+ **/
+/***********************************************************************
+ * @fn      ads_parse_channels
+ *
+ * @brief   Channel list "P[-N][:GAIN],..." into channel entries. P and N
+ *          are 0 - 7 (AINx) or 'c' (AINCOM), N defaults to AINCOM. GAIN
+ *          is the PGA, 1 - 64.
+ *
+ * @param   arg
+ *          p_list - ADS_CHAN_MAX entries, left alone if the list is invalid
+ *
+ * @return  Number of channels, -1 if the list is invalid
+ **/
+int ads_parse_channels(const char *arg, uint32_t *p_list)
+{
+  uint32_t list[ADS_CHAN_MAX];
+  int count = 0;
+  char *p = (char *)arg;
+
+  while ( *p != '\0' )
+  {
+    int ain[2] = {0, ADS_AINCOM};
+    int gain = 1;
+    int pga = 0;
+    int i = 0;
+
+    if ( count == ADS_CHAN_MAX )
+    {
+      return -1;
+    }
+
+    for ( i = 0; i < 2; i++ )
+    {
+      if ( *p >= '0' && *p <= '7' )
+      {
+        ain[i] = *p - '0';
+      }
+      else if ( *p == 'c' )
+      {
+        ain[i] = ADS_AINCOM;
+      }
+      else
+      {
+        return -1;
+      }
+      p++;
+      if ( *p != '-' || i == 1 )
+      {
+        break;
+      }
+      p++;
+    }
+
+    if ( *p == ':' )
+    {
+      gain = strtol(p + 1, &p, 10);
+    }
+    while ( (1 << pga) < gain && pga < 6 )
+    {
+      pga++;
+    }
+    if ( (1 << pga) != gain || ain[0] == ain[1] )
+    {
+      return -1;
+    }
+
+    list[count++] = CHAN_ENTRY(ADS_MUX(ain[0], ain[1]), pga);
+    if ( *p == ',' )
+    {
+      p++;
+    }
+    else if ( *p != '\0' )
+    {
+      return -1;
+    }
+  }
+
+  if ( count == 0 )
+  {
+    return -1;
+  }
+  memcpy(p_list, list, count * sizeof(uint32_t));
+
+  return count;
+}
+
+/***********************************************************************
+ * @fn      ads_parse_data_rate
+ *
+ * @brief   Data rate in SPS into a DRATE register code.
+ *
+ * @param   arg
+ *          p_drate
+ *
+ * @return  0, -1 if the rate is not one of the ADS1256 rates
+ **/
+int ads_parse_data_rate(const char *arg, uint8_t *p_drate)
+{
+  double sps = atof(arg);
+  size_t i = 0;
+
+  for ( i = 0; i < sizeof(DRATES) / sizeof(DRATES[0]); i++ )
+  {
+    if ( sps == DRATES[i].sps )
+    {
+      *p_drate = DRATES[i].code;
+      return 0;
+    }
+  }
+
+  return -1;
+}
+
+/***********************************************************************
+ * @fn      ads_parse_calibration
+ *
+ * @brief   Calibration name into a calibration command.
+ *
+ * @param   arg
+ *          p_cal
+ *
+ * @return  0, -1 if the name is unknown
+ **/
+int ads_parse_calibration(const char *arg, uint8_t *p_cal)
+{
+  size_t i = 0;
+
+  for ( i = 0; i < sizeof(CALS) / sizeof(CALS[0]); i++ )
+  {
+    if ( strcmp(arg, CALS[i].name) == 0 )
+    {
+      *p_cal = CALS[i].cmd;
+      return 0;
+    }
+  }
+
+  return -1;
+}
+
+/***********************************************************************
+ * @fn      ads_data_rate
+ *
+ * @brief   SPS of a DRATE register code.
+ *
+ * @param   drate
+ *
+ * @return  SPS, 0 if the code is not in the table
+ **/
+double ads_data_rate(uint8_t drate)
+{
+  size_t i = 0;
+
+  for ( i = 0; i < sizeof(DRATES) / sizeof(DRATES[0]); i++ )
+  {
+    if ( drate == DRATES[i].code )
+    {
+      return DRATES[i].sps;
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,377 @@
+/***********************************************************************
+ * INCLUDES
+ **/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <signal.h>
+#include "acq.h"
+#include "trace.h"
+#include "metrics.h"
+
+/***********************************************************************
+ * DEFINES
+ **/
+#define DEF_NUM_SAMPLES   10000
+#define DEF_BLOCK_LEN     1000
+#define DEF_DATA_FILE     "data_samples.txt"
+#define DEF_TIMES_FILE    "data_timestamps.txt"
+#define MAX_SINKS         5
+
+/***********************************************************************
+ * GLOBALS
+ **/
+static volatile int STOP = 0;
+
+/***********************************************************************
+ * LOCAL FUNCTIONS PROTOTYPES
+ **/
+void signal_handler(int signal);
+int  install_signal(void *signal_handler);
+void usage(const char *name);
+acq_source_t *source_create(const char *name);
+
+/***********************************************************************
+ * MAIN
+ **/
+int main(int argc, char *argv[])
+{
+  acq_option_t opt[ACQ_MAX_OPTIONS];
+  acq_option_t file_opt[ACQ_MAX_OPTIONS];
+  acq_option_t stats_opt[ACQ_MAX_OPTIONS];
+  acq_option_t spectrum_opt[ACQ_MAX_OPTIONS];
+  acq_write_stats_t ws;
+  acq_source_t *p_src = NULL;
+  acq_sink_t *p_sink[MAX_SINKS] = {NULL, NULL, NULL, NULL, NULL};
+  const char *src_name = NULL;
+  const char *codec_file = NULL;
+  const char *shm_name = NULL;
+  const char *stats_file = NULL;
+  const char *spectrum_file = NULL;
+  const char *metrics_addr = NULL;
+  const char *data_file = DEF_DATA_FILE;
+  const char *times_file = DEF_TIMES_FILE;
+  uint32_t num_samples = DEF_NUM_SAMPLES;
+  uint32_t block_len = DEF_BLOCK_LEN;
+  uint32_t num_opts = 0;
+  uint32_t num_file_opts = 0;
+  uint32_t num_stats_opts = 0;
+  uint32_t num_spectrum_opts = 0;
+  uint32_t num_sinks = 0;
+  uint32_t i = 0;
+  int volts = 0;
+  int res = 0;
+  int c = 0;
+
+  while ( (c = getopt(argc, argv, "s:o:n:b:f:T:z:O:P:S:W:F:G:m:V")) != -1 )
+  {
+    switch ( c )
+    {
+      case 's':
+        src_name = optarg;
+        break;
+      case 'o':
+        if ( num_opts == ACQ_MAX_OPTIONS || acq_parse_option(optarg, &opt[num_opts]) < 0 )
+        {
+          printf("Wrong option '%s'.\n", optarg);
+          return -1;
+        }
+        num_opts++;
+        break;
+      case 'n':
+        num_samples = strtoul(optarg, NULL, 10);
+        break;
+      case 'b':
+        block_len = strtoul(optarg, NULL, 10);
+        break;
+      case 'f':
+        data_file = optarg;
+        break;
+      case 'T':
+        times_file = (strcmp(optarg, "-") == 0) ? NULL : optarg;
+        break;
+      case 'z':
+        codec_file = optarg;
+        break;
+      case 'O':
+        if ( num_file_opts == ACQ_MAX_OPTIONS || acq_parse_option(optarg, &file_opt[num_file_opts]) < 0 )
+        {
+          printf("Wrong option '%s'.\n", optarg);
+          return -1;
+        }
+        num_file_opts++;
+        break;
+      case 'P':
+        shm_name = optarg;
+        break;
+      case 'S':
+        stats_file = optarg;
+        break;
+      case 'W':
+        if ( num_stats_opts == ACQ_MAX_OPTIONS || acq_parse_option(optarg, &stats_opt[num_stats_opts]) < 0 )
+        {
+          printf("Wrong option '%s'.\n", optarg);
+          return -1;
+        }
+        num_stats_opts++;
+        break;
+      case 'F':
+        spectrum_file = optarg;
+        break;
+      case 'G':
+        if ( num_spectrum_opts == ACQ_MAX_OPTIONS ||
+             acq_parse_option(optarg, &spectrum_opt[num_spectrum_opts]) < 0 )
+        {
+          printf("Wrong option '%s'.\n", optarg);
+          return -1;
+        }
+        num_spectrum_opts++;
+        break;
+      case 'm':
+        metrics_addr = optarg;
+        break;
+      case 'V':
+        volts = 1;
+        break;
+      default:
+        usage(argv[0]);
+        return -1;
+    }
+  }
+
+  if ( src_name == NULL || optind != argc || (codec_file == NULL && num_file_opts > 0) ||
+       (stats_file == NULL && num_stats_opts > 0) || (spectrum_file == NULL && num_spectrum_opts > 0) ||
+       (codec_file == NULL && shm_name == NULL && stats_file == NULL && spectrum_file == NULL &&
+        strcmp(data_file, "-") == 0) )
+  {
+    usage(argv[0]);
+    return -1;
+  }
+
+  p_src = source_create(src_name);
+  if ( p_src == NULL )
+  {
+    printf("Unknown source '%s'.\n", src_name);
+    return -1;
+  }
+
+  if ( acq_configure(p_src, opt, num_opts) < 0 )
+  {
+    printf("Invalid options for %s.\n", src_name);
+    acq_close(p_src);
+    return -1;
+  }
+
+  /* Compressed file first, its stats are printed; then text file,
+   * shared memory, statistics and spectra, any of them */
+  if ( codec_file != NULL )
+  {
+    p_sink[num_sinks++] = sink_codec_create(codec_file);
+    if ( p_sink[0] != NULL && sink_codec_configure(p_sink[0], file_opt, num_file_opts) < 0 )
+    {
+      printf("Invalid options for %s.\n", codec_file);
+      res = -1;
+    }
+  }
+  if ( strcmp(data_file, "-") != 0 )
+  {
+    p_sink[num_sinks++] = sink_text_create(data_file, times_file, volts);
+  }
+  if ( shm_name != NULL )
+  {
+    p_sink[num_sinks++] = sink_shm_create(shm_name);
+  }
+  if ( stats_file != NULL )
+  {
+    p_sink[num_sinks] = sink_stats_create(stats_file, volts);
+    if ( p_sink[num_sinks] != NULL && sink_stats_configure(p_sink[num_sinks], stats_opt, num_stats_opts) < 0 )
+    {
+      printf("Invalid options for %s.\n", stats_file);
+      res = -1;
+    }
+    num_sinks++;
+  }
+  if ( spectrum_file != NULL )
+  {
+    p_sink[num_sinks] = sink_spectrum_create(spectrum_file, volts);
+    if ( p_sink[num_sinks] != NULL &&
+         sink_spectrum_configure(p_sink[num_sinks], spectrum_opt, num_spectrum_opts) < 0 )
+    {
+      printf("Invalid options for %s.\n", spectrum_file);
+      res = -1;
+    }
+    num_sinks++;
+  }
+  for ( i = 0; i < num_sinks; i++ )
+  {
+    if ( p_sink[i] == NULL )
+    {
+      perror("sink_create()");
+      res = -1;
+    }
+  }
+  if ( res < 0 )
+  {
+    for ( i = 0; i < num_sinks; i++ )
+    {
+      acq_sink_destroy(p_sink[i]);
+    }
+    acq_close(p_src);
+    return -1;
+  }
+
+  install_signal(&signal_handler);
+  TRACE_SETUP("acq_trace.json");
+
+  if ( (metrics_addr != NULL && metrics_serve(metrics_addr) < 0) || acq_open(p_src) < 0 )
+  {
+    for ( i = 0; i < num_sinks; i++ )
+    {
+      acq_sink_destroy(p_sink[i]);
+    }
+    acq_close(p_src);
+    return -1;
+  }
+
+  printf("Collecting...\n");
+  res = acq_run(p_src, p_sink, num_sinks, num_samples, block_len, &STOP);
+  if ( res >= 0 )
+  {
+    printf("%s! %llu samples in %u blocks, %u blocks and %u samples lost.\n\n",
+           p_src->stats.stopped ? "Stopped" : "Done", (unsigned long long)p_src->stats.samples,
+           p_src->stats.blocks, p_src->stats.lost_blocks, p_src->stats.lost_samples);
+    if ( codec_file != NULL )
+    {
+      sink_codec_stats(p_sink[0], &ws);
+      printf("%s: compression %.2f, %.2f MB in %.2f s (%.2f MB/s), %s%s\n", codec_file,
+             sink_codec_ratio(p_sink[0]), ws.bytes / 1e6, ws.seconds,
+             (ws.seconds > 0) ? ws.bytes / ws.seconds / 1e6 : 0, ws.io, ws.direct ? " O_DIRECT" : "");
+      printf("%s: %u of %u buffers in flight at most, %u waits for a buffer (%.3f s)\n\n", codec_file,
+             ws.max_depth, ws.num_bufs, ws.waits, ws.wait_seconds);
+    }
+    if ( shm_name != NULL && sink_shm_dropped(p_sink[num_sinks - 1]) > 0 )
+    {
+      printf("%s: %u blocks larger than the shared memory, not published\n\n", shm_name,
+             sink_shm_dropped(p_sink[num_sinks - 1]));
+    }
+  }
+
+  acq_close(p_src);
+  for ( i = 0; i < num_sinks; i++ )
+  {
+    acq_sink_destroy(p_sink[i]);
+  }
+
+  return (res < 0) ? -1 : 0;
+}
+
+/***********************************************************************
+ * LOCAL FUNCTIONS
+ **/
+/***********************************************************************
+ * @fn      signal_handler
+ *
+ * @brief   SIGINT ends the capture, the blocks taken are still saved.
+ *
+ * @param   signal
+ *
+ * @return  void
+ **/
+void signal_handler(int signal)
+{
+  if ( signal == SIGINT )
+  {
+    STOP = 1;
+  }
+}
+
+/***********************************************************************
+ * @fn      install_signal
+ *
+ * @brief
+ *
+ * @param   void
+ *
+ * @return  void
+ **/
+int install_signal(void *signal_handler)
+{
+  struct sigaction sig_cb;
+
+  memset(&sig_cb, 0, sizeof(sig_cb));
+  sig_cb.sa_handler = signal_handler;
+  if ( sigaction(SIGINT, &sig_cb, NULL) )
+  {
+    perror("sigaction(SIGINT)");
+    return -1;
+  }
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      usage
+ *
+ * @brief
+ *
+ * @param   name
+ *
+ * @return  void
+ **/
+void usage(const char *name)
+{
+  printf("Usage: %s -s <SOURCE> [-o KEY=VALUE]... [-n SAMPLES] [-b BLOCK_SAMPLES] [-f FILE] [-T TIMES_FILE] [-z FILE [-O KEY=VALUE]...] [-P NAME] [-S FILE [-W KEY=VALUE]...] [-F FILE [-G KEY=VALUE]...] [-m ADDR] [-V]\n\n",
+         name);
+  printf("\t-s: pru_adc | pru_ads1256 | ads1256 | file | shm\n");
+  printf("\t-o: Source setting, see libacq/README.md\n");
+  printf("\t-n: Samples of each converter (default %d, 0: until Ctrl-C)\n", DEF_NUM_SAMPLES);
+  printf("\t-b: Samples per block (default %d)\n", DEF_BLOCK_LEN);
+  printf("\t-f: Data file (default %s, '-': none)\n", DEF_DATA_FILE);
+  printf("\t-T: Block times file (default %s, '-': none)\n", DEF_TIMES_FILE);
+  printf("\t-z: Compressed capture file too, replayed with '-s file -o file=FILE'\n");
+  printf("\t-O: Setting of the -z file (code, buffer, depth, io, direct, prealloc)\n");
+  printf("\t-P: Publish the blocks in shared memory, read with '-s shm -o name=NAME'\n");
+  printf("\t-S: Statistics of each channel per window (mean, std, RMS, min, max, peak to peak)\n");
+  printf("\t-W: Setting of the -S file (window, hop, rate)\n");
+  printf("\t-F: Spectra of each channel per frame (Welch FFT, Goertzel tones)\n");
+  printf("\t-G: Setting of the -F file (size, overlap, frame, tones, rate)\n");
+  printf("\t-m: Metrics for Prometheus on [HOST:]PORT (host 127.0.0.1) or a Unix socket path\n");
+  printf("\t-V: Values in volts\n\n");
+}
+
+/***********************************************************************
+ * @fn      source_create
+ *
+ * @brief
+ *
+ * @param   name
+ *
+ * @return  Source or NULL
+ **/
+acq_source_t *source_create(const char *name)
+{
+  if ( strcmp(name, "pru_adc") == 0 )
+  {
+    return src_pru_adc_create();
+  }
+  else if ( strcmp(name, "pru_ads1256") == 0 )
+  {
+    return src_pru_ads1256_create();
+  }
+  else if ( strcmp(name, "ads1256") == 0 )
+  {
+    return src_ads1256_create();
+  }
+  else if ( strcmp(name, "file") == 0 )
+  {
+    return src_file_create();
+  }
+  else if ( strcmp(name, "shm") == 0 )
+  {
+    return src_shm_create();
+  }
+
+  return NULL;
+}
@@ -0,0 +1,129 @@
+/***********************************************************************
+ * INCLUDES
+ **/
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include "acq.h"
+
+/***********************************************************************
+ * FUNCTIONS
+ **/
+/***********************************************************************
+ * @fn      timespec_diff
+ *
+ * @brief
+ *
+ * @param   p_a
+ *          p_b
+ *
+ * @return  a - b in seconds
+ **/
+double timespec_diff(const struct timespec *p_a, const struct timespec *p_b)
+{
+  return (double)(p_a->tv_sec - p_b->tv_sec) + (double)(p_a->tv_nsec - p_b->tv_nsec) * 1e-9;
+}
+
+/***********************************************************************
+ * @fn      clock_fit_init
+ *
+ * @brief   Reset the fit and take the host clocks anchor.
+ *
+ * @param   p_fit
+ *          clock_hz - Device clock
+ *
+ * @return  void
+ **/
+void clock_fit_init(clock_fit_t *p_fit, double clock_hz)
+{
+  memset(p_fit, 0, sizeof(clock_fit_t));
+  p_fit->clock_hz = clock_hz;
+  clock_gettime(CLOCK_MONOTONIC, &p_fit->mono0);
+  clock_gettime(CLOCK_REALTIME, &p_fit->real0);
+}
+
+/***********************************************************************
+ * @fn      clock_fit_add
+ *
+ * @brief   Add a point: device time of a stamp against host time now.
+ *
+ * @param   p_fit
+ *          cycles - Device clock of a block stamped just before now
+ *
+ * @return  void
+ **/
+void clock_fit_add(clock_fit_t *p_fit, uint64_t cycles)
+{
+  struct timespec now;
+  double x = (double)cycles / p_fit->clock_hz;
+  double y = 0;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  y = timespec_diff(&now, &p_fit->mono0);
+
+  p_fit->n++;
+  p_fit->sx  += x;
+  p_fit->sy  += y;
+  p_fit->sxx += x * x;
+  p_fit->sxy += x * y;
+}
+
+/***********************************************************************
+ * @fn      clock_fit_eval
+ *
+ * @brief   Host seconds = offset + slope * device seconds. Nominal slope
+ *          until there are two points.
+ *
+ * @param   p_fit
+ *          p_slope
+ *          p_offset
+ *
+ * @return  void
+ **/
+void clock_fit_eval(const clock_fit_t *p_fit, double *p_slope, double *p_offset)
+{
+  double den = p_fit->n * p_fit->sxx - p_fit->sx * p_fit->sx;
+
+  *p_slope  = 1.0;
+  *p_offset = 0.0;
+  if ( p_fit->n == 0 )
+  {
+    return;
+  }
+
+  if ( p_fit->n > 1 && den > 0 )
+  {
+    *p_slope = (p_fit->n * p_fit->sxy - p_fit->sx * p_fit->sy) / den;
+  }
+  *p_offset = (p_fit->sy - *p_slope * p_fit->sx) / p_fit->n;
+}
+
+/***********************************************************************
+ * @fn      clock_fit_realtime
+ *
+ * @brief   Wall clock time of a device clock stamp.
+ *
+ * @param   p_fit
+ *          cycles
+ *          p_ts
+ *
+ * @return  void
+ **/
+void clock_fit_realtime(const clock_fit_t *p_fit, uint64_t cycles, struct timespec *p_ts)
+{
+  double slope = 0;
+  double offset = 0;
+  int64_t ns = 0;
+
+  clock_fit_eval(p_fit, &slope, &offset);
+  ns = (int64_t)((offset + slope * (double)cycles / p_fit->clock_hz) * 1e9) + p_fit->real0.tv_nsec;
+
+  p_ts->tv_sec  = p_fit->real0.tv_sec + ns / 1000000000;
+  p_ts->tv_nsec = ns % 1000000000;
+  if ( p_ts->tv_nsec < 0 )
+  {
+    p_ts->tv_sec--;
+    p_ts->tv_nsec += 1000000000;
+  }
+}
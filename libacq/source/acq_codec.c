@@ -0,0 +1,656 @@
+/***********************************************************************
+ * INCLUDES
+ **/
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include "acq.h"
+#include "acq_codec.h"
+
+/***********************************************************************
+ * DEFINES
+ **/
+/* Values of a lane are predicted chunk by chunk, and their residuals
+ * share a bit width or a Rice parameter frame by frame */
+#define CODEC_CHUNK         1024
+#define CODEC_FRAME         64
+#define CODEC_HISTORY       (2 * ACQ_MAX_CHANNELS)
+
+/* Chunk predictors, from the values one and two channel cycles back */
+#define PRED_NONE           0
+#define PRED_DELTA          1     /* x[i - s] */
+#define PRED_LINEAR         2     /* 2 x[i - s] - x[i - 2s] */
+
+/* Frame header: mode bit and 5-bit width or parameter */
+#define FRAME_PACK          0
+#define FRAME_RICE          1
+
+/* Rice quotients from here on: escape and the residual whole */
+#define RICE_ESCAPE         24
+
+#define PACKED_PAIR_SIZE    3
+#define PACKED_S24_SIZE     3
+#define ENV_RECORD_SIZE     8
+
+#define ZIGZAG(r)           (((uint32_t)(r) << 1) ^ (uint32_t)((int32_t)(r) >> 31))
+#define UNZIGZAG(z)         (((z) >> 1) ^ (0 - ((z) & 1)))
+
+/***********************************************************************
+ * TYPEDEFS
+ **/
+/* LSB first, flushed 32 bits at a time */
+typedef struct bit_writer_t
+{
+  uint8_t *p;
+  uint64_t acc;
+  uint32_t n;
+} bit_writer_t;
+
+/* Keeps more than 56 bits ready, zeros past the end are counted */
+typedef struct bit_reader_t
+{
+  const uint8_t *p;
+  const uint8_t *p_end;
+  uint64_t acc;
+  uint32_t n;
+  uint32_t pad;
+} bit_reader_t;
+
+/***********************************************************************
+ * PRIVATE FUNCTIONS PROTOTYPES
+ **/
+static uint32_t codec_lanes(const acq_format_t *p_fmt);
+static void lane_get(const acq_format_t *p_fmt, const uint8_t *p_data, uint32_t lane, uint32_t first, uint32_t len,
+                     int32_t *p_x);
+static void lane_put(const acq_format_t *p_fmt, uint8_t *p_data, uint32_t lane, uint32_t first, uint32_t len,
+                     const int32_t *p_x);
+static void encode_chunk(bit_writer_t *p_wr, const int32_t *p_x, uint32_t len, uint32_t stride);
+static void encode_frame(bit_writer_t *p_wr, const uint32_t *p_z, uint32_t len);
+static void decode_chunk(bit_reader_t *p_rd, int32_t *p_x, uint32_t len, uint32_t stride);
+static inline void bits_put(bit_writer_t *p_wr, uint32_t value, uint32_t num_bits);
+static inline void bits_flush(bit_writer_t *p_wr);
+static inline void bits_fill(bit_reader_t *p_rd);
+static inline uint32_t bits_get(bit_reader_t *p_rd, uint32_t num_bits);
+
+/***********************************************************************
+ * FUNCTIONS
+ **/
+/***********************************************************************
+ * @fn      acq_codec_bound
+ *
+ * @brief   Largest acq_codec_encode() output for a block.
+ *
+ * @param   p_fmt
+ *          num_records - Of each stream
+ *
+ * @return  Bytes
+ **/
+uint32_t acq_codec_bound(const acq_format_t *p_fmt, uint32_t num_records)
+{
+  uint32_t streams = (p_fmt->num_streams > 1) ? p_fmt->num_streams : 1;
+  uint32_t values = (p_fmt->encoding == ACQ_ENC_U12_PAIR) ? 2 * num_records : num_records;
+
+  /* Escaped residuals take 56 bits, headers round up */
+  return streams * codec_lanes(p_fmt) * (values * 7 + values / CODEC_FRAME + values / CODEC_CHUNK + 2) + 8;
+}
+
+/***********************************************************************
+ * @fn      acq_codec_encode
+ *
+ * @brief   Lossless compression of the records of a block, every stream.
+ *          Each record field is a lane (code, channel index, envelope
+ *          min/max/mean) predicted from the same channel one or two
+ *          cycles back: none, delta or linear, whichever leaves the
+ *          smallest residuals in each chunk. Residuals are zigzagged and
+ *          bit packed or Rice coded, whichever is shorter, 64 at a time.
+ *          Blocks don't depend on each other.
+ *
+ * @param   p_fmt
+ *          p_block
+ *          p_out - acq_codec_bound() bytes
+ *
+ * @return  Bytes written, 0 if the encoding can't be compressed
+ **/
+uint32_t acq_codec_encode(const acq_format_t *p_fmt, const acq_block_t *p_block, uint8_t *p_out)
+{
+  int32_t hist[CODEC_HISTORY + CODEC_CHUNK];
+  int32_t *p_x = hist + CODEC_HISTORY;
+  uint32_t streams = (p_fmt->num_streams > 1) ? p_fmt->num_streams : 1;
+  uint32_t lanes = codec_lanes(p_fmt);
+  uint32_t values = (p_fmt->encoding == ACQ_ENC_U12_PAIR) ? 2 * p_block->num_records : p_block->num_records;
+  bit_writer_t wr = {p_out, 0, 0};
+  uint32_t stride = 0;
+  uint32_t len = 0;
+  uint32_t a = 0;
+  uint32_t l = 0;
+  uint32_t n = 0;
+
+  if ( lanes == 0 )
+  {
+    return 0;
+  }
+
+  for ( a = 0; a < streams; a++ )
+  {
+    stride = (p_fmt->num_channels[a] > 1) ? p_fmt->num_channels[a] : 1;
+    for ( l = 0; l < lanes; l++ )
+    {
+      memset(hist, 0, CODEC_HISTORY * sizeof(int32_t));
+      for ( n = 0; n < values; n += len )
+      {
+        len = (values - n > CODEC_CHUNK) ? CODEC_CHUNK : values - n;
+        lane_get(p_fmt, p_block->p_data[a], l, n, len, p_x);
+        encode_chunk(&wr, p_x, len, stride);
+        memmove(p_x - 2 * stride, p_x + len - 2 * stride, 2 * stride * sizeof(int32_t));
+      }
+    }
+  }
+  bits_flush(&wr);
+
+  return wr.p - p_out;
+}
+
+/***********************************************************************
+ * @fn      acq_codec_decode
+ *
+ * @brief   Records of every stream back from acq_codec_encode(), byte
+ *          for byte.
+ *
+ * @param   p_fmt
+ *          p_in
+ *          len
+ *          num_records - Of each stream
+ *          pp_data - Records of each stream, num_records * record_size
+ *
+ * @return  0, -1 if the data is short or the encoding unknown
+ **/
+int acq_codec_decode(const acq_format_t *p_fmt, const uint8_t *p_in, uint32_t len, uint32_t num_records,
+                     uint8_t **pp_data)
+{
+  int32_t hist[CODEC_HISTORY + CODEC_CHUNK];
+  int32_t *p_x = hist + CODEC_HISTORY;
+  uint32_t streams = (p_fmt->num_streams > 1) ? p_fmt->num_streams : 1;
+  uint32_t lanes = codec_lanes(p_fmt);
+  uint32_t values = (p_fmt->encoding == ACQ_ENC_U12_PAIR) ? 2 * num_records : num_records;
+  bit_reader_t rd = {p_in, p_in + len, 0, 0, 0};
+  uint32_t stride = 0;
+  uint32_t chunk = 0;
+  uint32_t a = 0;
+  uint32_t l = 0;
+  uint32_t n = 0;
+
+  if ( lanes == 0 )
+  {
+    return -1;
+  }
+
+  for ( a = 0; a < streams; a++ )
+  {
+    stride = (p_fmt->num_channels[a] > 1) ? p_fmt->num_channels[a] : 1;
+    for ( l = 0; l < lanes; l++ )
+    {
+      memset(hist, 0, CODEC_HISTORY * sizeof(int32_t));
+      for ( n = 0; n < values; n += chunk )
+      {
+        chunk = (values - n > CODEC_CHUNK) ? CODEC_CHUNK : values - n;
+        decode_chunk(&rd, p_x, chunk, stride);
+        lane_put(p_fmt, pp_data[a], l, n, chunk, p_x);
+        memmove(p_x - 2 * stride, p_x + chunk - 2 * stride, 2 * stride * sizeof(int32_t));
+      }
+    }
+  }
+
+  /* Bits taken past the end of the data */
+  return (rd.pad * 8 > rd.n) ? -1 : 0;
+}
+
+/***********************************************************************
+ * @fn      codec_lanes
+ *
+ * @brief   Fields of a record coded apart.
+ *
+ * @param   p_fmt
+ *
+ * @return  Lanes, 0 if the record layout isn't known
+ **/
+static uint32_t codec_lanes(const acq_format_t *p_fmt)
+{
+  switch ( p_fmt->encoding )
+  {
+    case ACQ_ENC_U16:
+      return (p_fmt->record_size == sizeof(uint16_t)) ? 1 : 0;
+    case ACQ_ENC_U12_PAIR:
+      return (p_fmt->record_size == PACKED_PAIR_SIZE) ? 1 : 0;
+    case ACQ_ENC_U16_ENV:
+      return (p_fmt->record_size == ENV_RECORD_SIZE) ? 4 : 0;
+    case ACQ_ENC_S24_TAGGED:
+      return (p_fmt->record_size == sizeof(uint32_t)) ? 2 : 0;
+    case ACQ_ENC_S24_PACKED:
+      return (p_fmt->record_size == PACKED_S24_SIZE) ? 1 : 0;
+  }
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      lane_get
+ *
+ * @brief   Values of a lane from the records. Pairs are a lane of twice
+ *          the records; a tagged word is the code (lane 0) and the
+ *          channel index (lane 1); an envelope is min, max, mean and the
+ *          reserved word.
+ *
+ * @param   p_fmt
+ *          p_data - Records of the stream
+ *          lane
+ *          first - Value index
+ *          len
+ *          p_x
+ *
+ * @return  void
+ **/
+static void lane_get(const acq_format_t *p_fmt, const uint8_t *p_data, uint32_t lane, uint32_t first, uint32_t len,
+                     int32_t *p_x)
+{
+  uint16_t pairs[CODEC_CHUNK];
+  uint32_t i = 0;
+
+  switch ( p_fmt->encoding )
+  {
+    case ACQ_ENC_U16:
+      for ( i = 0; i < len; i++ )
+      {
+        const uint8_t *p = p_data + (first + i) * sizeof(uint16_t);
+        p_x[i] = p[0] | (p[1] << 8);
+      }
+      break;
+
+    case ACQ_ENC_U12_PAIR:
+      /* Chunks start on a pair and hold whole pairs */
+      acq_unpack_u12(p_data + first / 2 * PACKED_PAIR_SIZE, pairs, len);
+      for ( i = 0; i < len; i++ )
+      {
+        p_x[i] = pairs[i];
+      }
+      break;
+
+    case ACQ_ENC_U16_ENV:
+      for ( i = 0; i < len; i++ )
+      {
+        const uint8_t *p = p_data + (first + i) * ENV_RECORD_SIZE + lane * sizeof(uint16_t);
+        p_x[i] = p[0] | (p[1] << 8);
+      }
+      break;
+
+    case ACQ_ENC_S24_TAGGED:
+      for ( i = 0; i < len; i++ )
+      {
+        const uint8_t *p = p_data + (first + i) * sizeof(uint32_t);
+        p_x[i] = (lane == 0) ? (int32_t)((uint32_t)(p[0] | (p[1] << 8) | (p[2] << 16)) << 8) >> 8 : p[3];
+      }
+      break;
+
+    case ACQ_ENC_S24_PACKED:
+      for ( i = 0; i < len; i++ )
+      {
+        const uint8_t *p = p_data + (first + i) * PACKED_S24_SIZE;
+        p_x[i] = (int32_t)((uint32_t)(p[0] | (p[1] << 8) | (p[2] << 16)) << 8) >> 8;
+      }
+      break;
+  }
+}
+
+/***********************************************************************
+ * @fn      lane_put
+ *
+ * @brief   Values of a lane into the records, the other fields kept.
+ *
+ * @param   p_fmt
+ *          p_data
+ *          lane
+ *          first
+ *          len
+ *          p_x
+ *
+ * @return  void
+ **/
+static void lane_put(const acq_format_t *p_fmt, uint8_t *p_data, uint32_t lane, uint32_t first, uint32_t len,
+                     const int32_t *p_x)
+{
+  uint32_t i = 0;
+
+  switch ( p_fmt->encoding )
+  {
+    case ACQ_ENC_U16:
+      for ( i = 0; i < len; i++ )
+      {
+        uint8_t *p = p_data + (first + i) * sizeof(uint16_t);
+        p[0] = p_x[i];
+        p[1] = p_x[i] >> 8;
+      }
+      break;
+
+    case ACQ_ENC_U12_PAIR:
+      for ( i = 0; i + 1 < len; i += 2 )
+      {
+        uint8_t *p = p_data + (first + i) / 2 * PACKED_PAIR_SIZE;
+        p[0] = p_x[i];
+        p[1] = ((p_x[i] >> 8) & 0x0F) | (p_x[i + 1] << 4);
+        p[2] = p_x[i + 1] >> 4;
+      }
+      break;
+
+    case ACQ_ENC_U16_ENV:
+      for ( i = 0; i < len; i++ )
+      {
+        uint8_t *p = p_data + (first + i) * ENV_RECORD_SIZE + lane * sizeof(uint16_t);
+        p[0] = p_x[i];
+        p[1] = p_x[i] >> 8;
+      }
+      break;
+
+    case ACQ_ENC_S24_TAGGED:
+      for ( i = 0; i < len; i++ )
+      {
+        uint8_t *p = p_data + (first + i) * sizeof(uint32_t);
+        if ( lane == 0 )
+        {
+          p[0] = p_x[i];
+          p[1] = p_x[i] >> 8;
+          p[2] = p_x[i] >> 16;
+        }
+        else
+        {
+          p[3] = p_x[i];
+        }
+      }
+      break;
+
+    case ACQ_ENC_S24_PACKED:
+      for ( i = 0; i < len; i++ )
+      {
+        uint8_t *p = p_data + (first + i) * PACKED_S24_SIZE;
+        p[0] = p_x[i];
+        p[1] = p_x[i] >> 8;
+        p[2] = p_x[i] >> 16;
+      }
+      break;
+  }
+}
+
+/***********************************************************************
+ * @fn      encode_chunk
+ *
+ * @brief   Pick the predictor with the smallest residuals, then code
+ *          them frame by frame. Sums wrap like the decoder's, so any
+ *          32-bit value comes back.
+ *
+ * @param   p_wr
+ *          p_x - Values, the two channel cycles before them readable
+ *          len
+ *          stride - Channels cycled through
+ *
+ * @return  void
+ **/
+static void encode_chunk(bit_writer_t *p_wr, const int32_t *p_x, uint32_t len, uint32_t stride)
+{
+  uint32_t z[CODEC_CHUNK];
+  uint64_t cost[3] = {0, 0, 0};
+  uint32_t pred = PRED_NONE;
+  uint32_t i = 0;
+
+  for ( i = 0; i < len; i++ )
+  {
+    uint32_t x  = p_x[i];
+    uint32_t x1 = p_x[(int32_t)i - (int32_t)stride];
+    uint32_t x2 = p_x[(int32_t)i - 2 * (int32_t)stride];
+
+    cost[PRED_NONE]   += ZIGZAG(x);
+    cost[PRED_DELTA]  += ZIGZAG(x - x1);
+    cost[PRED_LINEAR] += ZIGZAG(x - 2 * x1 + x2);
+  }
+  if ( cost[PRED_DELTA] < cost[pred] )
+  {
+    pred = PRED_DELTA;
+  }
+  if ( cost[PRED_LINEAR] < cost[pred] )
+  {
+    pred = PRED_LINEAR;
+  }
+
+  for ( i = 0; i < len; i++ )
+  {
+    uint32_t x  = p_x[i];
+    uint32_t x1 = p_x[(int32_t)i - (int32_t)stride];
+    uint32_t x2 = p_x[(int32_t)i - 2 * (int32_t)stride];
+
+    z[i] = (pred == PRED_NONE) ? ZIGZAG(x) : (pred == PRED_DELTA) ? ZIGZAG(x - x1) : ZIGZAG(x - 2 * x1 + x2);
+  }
+
+  bits_put(p_wr, pred, 2);
+  for ( i = 0; i < len; i += CODEC_FRAME )
+  {
+    encode_frame(p_wr, z + i, (len - i > CODEC_FRAME) ? CODEC_FRAME : len - i);
+  }
+}
+
+/***********************************************************************
+ * @fn      encode_frame
+ *
+ * @brief   Residuals packed to the width of the largest, or Rice coded
+ *          with the parameter of their mean when that is shorter.
+ *
+ * @param   p_wr
+ *          p_z - Zigzagged residuals
+ *          len
+ *
+ * @return  void
+ **/
+static void encode_frame(bit_writer_t *p_wr, const uint32_t *p_z, uint32_t len)
+{
+  uint64_t sum = 0;
+  uint64_t rice_bits = 0;
+  uint32_t all = 0;
+  uint32_t mean = 0;
+  uint32_t width = 0;
+  uint32_t k = 0;
+  uint32_t q = 0;
+  uint32_t i = 0;
+
+  for ( i = 0; i < len; i++ )
+  {
+    all |= p_z[i];
+    sum += p_z[i];
+  }
+  width = (all != 0) ? 32 - __builtin_clz(all) : 0;
+  mean  = sum / len;
+  k     = (mean != 0) ? 31 - __builtin_clz(mean) : 0;
+
+  for ( i = 0; i < len; i++ )
+  {
+    q = p_z[i] >> k;
+    rice_bits += (q < RICE_ESCAPE) ? q + 1 + k : RICE_ESCAPE + 32;
+  }
+
+  if ( width < 32 && (uint64_t)width * len <= rice_bits )
+  {
+    bits_put(p_wr, FRAME_PACK | (width << 1), 6);
+    for ( i = 0; i < len; i++ )
+    {
+      bits_put(p_wr, p_z[i], width);
+    }
+    return;
+  }
+
+  bits_put(p_wr, FRAME_RICE | (k << 1), 6);
+  for ( i = 0; i < len; i++ )
+  {
+    q = p_z[i] >> k;
+    if ( q < RICE_ESCAPE )
+    {
+      bits_put(p_wr, (1u << q) - 1, q + 1);
+      bits_put(p_wr, p_z[i] & ((1u << k) - 1), k);
+    }
+    else
+    {
+      bits_put(p_wr, (1u << RICE_ESCAPE) - 1, RICE_ESCAPE);
+      bits_put(p_wr, p_z[i], 32);
+    }
+  }
+}
+
+/***********************************************************************
+ * @fn      decode_chunk
+ *
+ * @brief
+ *
+ * @param   p_rd
+ *          p_x - Values, the two channel cycles before them hold the
+ *                previous ones
+ *          len
+ *          stride
+ *
+ * @return  void
+ **/
+static void decode_chunk(bit_reader_t *p_rd, int32_t *p_x, uint32_t len, uint32_t stride)
+{
+  uint32_t pred = bits_get(p_rd, 2);
+  uint32_t header = 0;
+  uint32_t param = 0;
+  uint32_t frame = 0;
+  uint32_t z = 0;
+  uint32_t q = 0;
+  uint32_t i = 0;
+  uint32_t j = 0;
+
+  for ( i = 0; i < len; i += frame )
+  {
+    frame  = (len - i > CODEC_FRAME) ? CODEC_FRAME : len - i;
+    header = bits_get(p_rd, 6);
+    param  = header >> 1;
+
+    for ( j = i; j < i + frame; j++ )
+    {
+      uint32_t x1 = p_x[(int32_t)j - (int32_t)stride];
+      uint32_t x2 = p_x[(int32_t)j - 2 * (int32_t)stride];
+
+      if ( (header & 1) == FRAME_PACK )
+      {
+        z = bits_get(p_rd, param);
+      }
+      else
+      {
+        bits_fill(p_rd);
+        q = __builtin_ctzll(~p_rd->acc);
+        if ( q >= RICE_ESCAPE )
+        {
+          p_rd->acc >>= RICE_ESCAPE;
+          p_rd->n    -= RICE_ESCAPE;
+          z = bits_get(p_rd, 32);
+        }
+        else
+        {
+          p_rd->acc >>= q + 1;
+          p_rd->n    -= q + 1;
+          z = (q << param) | bits_get(p_rd, param);
+        }
+      }
+
+      z = UNZIGZAG(z);
+      p_x[j] = (pred == PRED_NONE) ? z : (pred == PRED_DELTA) ? z + x1 : z + 2 * x1 - x2;
+    }
+  }
+}
+
+/***********************************************************************
+ * @fn      bits_put
+ *
+ * @brief   Append the low bits of a value, 32 at most.
+ *
+ * @param   p_wr
+ *          value - No bits set above num_bits
+ *          num_bits
+ *
+ * @return  void
+ **/
+static inline void bits_put(bit_writer_t *p_wr, uint32_t value, uint32_t num_bits)
+{
+  p_wr->acc |= (uint64_t)value << p_wr->n;
+  p_wr->n   += num_bits;
+  if ( p_wr->n >= 32 )
+  {
+    p_wr->p[0] = p_wr->acc;
+    p_wr->p[1] = p_wr->acc >> 8;
+    p_wr->p[2] = p_wr->acc >> 16;
+    p_wr->p[3] = p_wr->acc >> 24;
+    p_wr->p   += 4;
+    p_wr->acc >>= 32;
+    p_wr->n   -= 32;
+  }
+}
+
+/***********************************************************************
+ * @fn      bits_flush
+ *
+ * @brief   Write out the last bits, the byte padded with zeros.
+ *
+ * @param   p_wr
+ *
+ * @return  void
+ **/
+static inline void bits_flush(bit_writer_t *p_wr)
+{
+  while ( p_wr->n > 0 )
+  {
+    *p_wr->p++ = p_wr->acc;
+    p_wr->acc >>= 8;
+    p_wr->n = (p_wr->n > 8) ? p_wr->n - 8 : 0;
+  }
+}
+
+/***********************************************************************
+ * @fn      bits_fill
+ *
+ * @brief   Top up to more than 56 bits, zeros past the end of the data.
+ *
+ * @param   p_rd
+ *
+ * @return  void
+ **/
+static inline void bits_fill(bit_reader_t *p_rd)
+{
+  while ( p_rd->n <= 56 )
+  {
+    if ( p_rd->p < p_rd->p_end )
+    {
+      p_rd->acc |= (uint64_t)*p_rd->p++ << p_rd->n;
+    }
+    else
+    {
+      p_rd->pad++;
+    }
+    p_rd->n += 8;
+  }
+}
+
+/***********************************************************************
+ * @fn      bits_get
+ *
+ * @brief   Take the next bits, 32 at most.
+ *
+ * @param   p_rd
+ *          num_bits
+ *
+ * @return  Value
+ **/
+static inline uint32_t bits_get(bit_reader_t *p_rd, uint32_t num_bits)
+{
+  uint32_t value = 0;
+
+  bits_fill(p_rd);
+  value = p_rd->acc & (((uint64_t)1 << num_bits) - 1);
+  p_rd->acc >>= num_bits;
+  p_rd->n    -= num_bits;
+
+  return value;
+}
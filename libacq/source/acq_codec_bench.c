@@ -0,0 +1,704 @@
+/***********************************************************************
+ * INCLUDES
+ **/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include "acq.h"
+#include "acq_codec.h"
+
+/***********************************************************************
+ * DEFINES
+ **/
+#define BENCH_RECORDS     (1 << 20)
+#define BENCH_BLOCK       1000
+#define BENCH_TIME        1.0
+#define ADC_TOP_RATE      1600000
+#define LINE_MAX_LEN      256
+
+/***********************************************************************
+ * TYPEDEFS
+ **/
+/* Records of every stream, as a source delivers them */
+typedef struct bench_data_t
+{
+  const char  *name;
+  acq_format_t fmt;
+  uint8_t     *p_data[ACQ_MAX_STREAMS];
+  uint32_t     num_records;
+  long         text_bytes;    /* Of a recorded text file, 0: synthetic */
+} bench_data_t;
+
+/***********************************************************************
+ * GLOBALS
+ **/
+static uint32_t SEED = 2463534242u;
+
+/***********************************************************************
+ * LOCAL FUNCTIONS PROTOTYPES
+ **/
+int  bench_run(bench_data_t *p_data);
+int  bench_alloc(bench_data_t *p_data, uint32_t num_records);
+void bench_free(bench_data_t *p_data);
+void make_adc(bench_data_t *p_data, const char *name, uint32_t encoding, int noise_only);
+void make_ads(bench_data_t *p_data, const char *name, uint32_t encoding, uint32_t streams, uint32_t channels);
+int  load_capture(bench_data_t *p_data, const char *file_name);
+int  load_text(bench_data_t *p_data, const char *file_name);
+int32_t noise(int32_t amplitude);
+uint32_t adc_code(uint32_t n);
+void put_le(uint8_t *p, uint32_t value, uint32_t bytes);
+
+/***********************************************************************
+ * MAIN
+ **/
+int main(int argc, char *argv[])
+{
+  bench_data_t data;
+  int res = 0;
+  int i = 0;
+
+  if ( argc >= 2 && argv[1][0] == '-' )
+  {
+    printf("Usage: %s [FILE]...\n\n", argv[0]);
+    printf("\tCompression and speed of the block codec on synthetic captures of\n");
+    printf("\teach encoding, then on the FILEs: capture files (-z) or data files\n");
+    printf("\tsaved as codes (index [channel] value, or index min max mean)\n\n");
+    return -1;
+  }
+
+  printf("%-18s %7s %9s %11s %9s %11s\n", "", "ratio", "enc MB/s", "enc Msmp/s", "dec MB/s", "dec Msmp/s");
+
+  make_adc(&data, "pru_adc", ACQ_ENC_U16, 0);
+  res |= bench_run(&data);
+  make_adc(&data, "pru_adc packed", ACQ_ENC_U12_PAIR, 0);
+  res |= bench_run(&data);
+  make_adc(&data, "pru_adc env:64", ACQ_ENC_U16_ENV, 0);
+  res |= bench_run(&data);
+  make_adc(&data, "pru_adc noise", ACQ_ENC_U16, 1);
+  res |= bench_run(&data);
+  make_ads(&data, "ads1256", ACQ_ENC_S24_TAGGED, 1, 1);
+  res |= bench_run(&data);
+  make_ads(&data, "ads1256 4 ch", ACQ_ENC_S24_TAGGED, 1, 4);
+  res |= bench_run(&data);
+  make_ads(&data, "ads1256 packed", ACQ_ENC_S24_PACKED, 1, 1);
+  res |= bench_run(&data);
+  make_ads(&data, "ads1256 dual 2 ch", ACQ_ENC_S24_TAGGED, 2, 2);
+  res |= bench_run(&data);
+
+  for ( i = 1; i < argc; i++ )
+  {
+    memset(&data, 0, sizeof(data));
+    data.name = argv[i];
+    if ( load_capture(&data, argv[i]) < 0 && load_text(&data, argv[i]) < 0 )
+    {
+      printf("%s: no samples read.\n", argv[i]);
+      res = -1;
+      continue;
+    }
+    res |= bench_run(&data);
+  }
+
+  return (res < 0) ? -1 : 0;
+}
+
+/***********************************************************************
+ * LOCAL FUNCTIONS
+ **/
+/***********************************************************************
+ * @fn      bench_run
+ *
+ * @brief   Code the records block by block for about a second, decode
+ *          them for about a second, check they came back byte for byte
+ *          and print the ratio and rates. Samples count every stream.
+ *
+ * @param   p_data - Records, freed on return
+ *
+ * @return  0 if both ways keep up with 1600000 samples/s, -1 otherwise
+ **/
+int bench_run(bench_data_t *p_data)
+{
+  acq_format_t *p_fmt = &p_data->fmt;
+  uint32_t streams = (p_fmt->num_streams > 1) ? p_fmt->num_streams : 1;
+  uint32_t num_blocks = (p_data->num_records + BENCH_BLOCK - 1) / BENCH_BLOCK;
+  uint32_t bound = acq_codec_bound(p_fmt, BENCH_BLOCK);
+  uint64_t raw_bytes = (uint64_t)p_data->num_records * p_fmt->record_size * streams;
+  uint64_t samples = (uint64_t)p_data->num_records * p_fmt->record_values * streams;
+  uint8_t *p_out = malloc((uint64_t)num_blocks * bound);
+  uint32_t *p_len = malloc(num_blocks * sizeof(uint32_t));
+  uint8_t *p_dec[ACQ_MAX_STREAMS] = {NULL, NULL};
+  acq_block_t block;
+  struct timespec t0;
+  struct timespec t1;
+  uint64_t coded = 0;
+  double enc_time = 0;
+  double dec_time = 0;
+  uint32_t enc_loops = 0;
+  uint32_t dec_loops = 0;
+  uint32_t b = 0;
+  uint32_t a = 0;
+  int res = 0;
+
+  for ( a = 0; a < streams; a++ )
+  {
+    p_dec[a] = malloc((uint64_t)p_data->num_records * p_fmt->record_size);
+  }
+  if ( p_out == NULL || p_len == NULL || p_dec[0] == NULL || (streams > 1 && p_dec[1] == NULL) )
+  {
+    perror("malloc(bench)");
+    res = -1;
+    goto end;
+  }
+
+  memset(&block, 0, sizeof(block));
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  do
+  {
+    coded = 0;
+    for ( b = 0; b < num_blocks; b++ )
+    {
+      block.num_records = (p_data->num_records - b * BENCH_BLOCK > BENCH_BLOCK) ? BENCH_BLOCK :
+                          p_data->num_records - b * BENCH_BLOCK;
+      for ( a = 0; a < streams; a++ )
+      {
+        block.p_data[a] = p_data->p_data[a] + (uint64_t)b * BENCH_BLOCK * p_fmt->record_size;
+      }
+      p_len[b] = acq_codec_encode(p_fmt, &block, p_out + (uint64_t)b * bound);
+      coded += p_len[b];
+    }
+    enc_loops++;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    enc_time = timespec_diff(&t1, &t0);
+  } while ( enc_time < BENCH_TIME );
+
+  if ( coded == 0 )
+  {
+    printf("%-18s encoding %u can't be compressed\n", p_data->name, p_fmt->encoding);
+    res = -1;
+    goto end;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  do
+  {
+    for ( b = 0; b < num_blocks; b++ )
+    {
+      uint8_t *p_rec[ACQ_MAX_STREAMS] = {NULL, NULL};
+      uint32_t len = (p_data->num_records - b * BENCH_BLOCK > BENCH_BLOCK) ? BENCH_BLOCK :
+                     p_data->num_records - b * BENCH_BLOCK;
+
+      for ( a = 0; a < streams; a++ )
+      {
+        p_rec[a] = p_dec[a] + (uint64_t)b * BENCH_BLOCK * p_fmt->record_size;
+      }
+      if ( acq_codec_decode(p_fmt, p_out + (uint64_t)b * bound, p_len[b], len, p_rec) < 0 )
+      {
+        printf("%-18s block %u doesn't decode\n", p_data->name, b);
+        res = -1;
+        goto end;
+      }
+    }
+    dec_loops++;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    dec_time = timespec_diff(&t1, &t0);
+  } while ( dec_time < BENCH_TIME );
+
+  for ( a = 0; a < streams; a++ )
+  {
+    if ( memcmp(p_dec[a], p_data->p_data[a], (uint64_t)p_data->num_records * p_fmt->record_size) != 0 )
+    {
+      printf("%-18s stream %u doesn't decode to its records\n", p_data->name, a);
+      res = -1;
+      goto end;
+    }
+  }
+
+  printf("%-18s %6.2fx %9.1f %11.2f %9.1f %11.2f", p_data->name, (double)raw_bytes / coded,
+         raw_bytes * enc_loops / enc_time / 1e6, samples * enc_loops / enc_time / 1e6,
+         raw_bytes * dec_loops / dec_time / 1e6, samples * dec_loops / dec_time / 1e6);
+  if ( p_data->text_bytes > 0 )
+  {
+    printf("  (text file %.1fx)", (double)p_data->text_bytes / coded);
+  }
+  printf("\n");
+
+  if ( samples * enc_loops / enc_time < ADC_TOP_RATE || samples * dec_loops / dec_time < ADC_TOP_RATE )
+  {
+    res = -1;
+  }
+
+end:
+  for ( a = 0; a < ACQ_MAX_STREAMS; a++ )
+  {
+    free(p_dec[a]);
+  }
+  free(p_len);
+  free(p_out);
+  bench_free(p_data);
+
+  return res;
+}
+
+/***********************************************************************
+ * @fn      bench_alloc
+ *
+ * @brief
+ *
+ * @param   p_data - Format set
+ *          num_records - Of each stream
+ *
+ * @return  0, -1 out of memory
+ **/
+int bench_alloc(bench_data_t *p_data, uint32_t num_records)
+{
+  uint32_t streams = (p_data->fmt.num_streams > 1) ? p_data->fmt.num_streams : 1;
+  uint32_t a = 0;
+
+  p_data->num_records = num_records;
+  for ( a = 0; a < streams; a++ )
+  {
+    p_data->p_data[a] = calloc(num_records, p_data->fmt.record_size);
+    if ( p_data->p_data[a] == NULL )
+    {
+      perror("malloc(bench)");
+      bench_free(p_data);
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      bench_free
+ *
+ * @brief
+ *
+ * @param   p_data
+ *
+ * @return  void
+ **/
+void bench_free(bench_data_t *p_data)
+{
+  uint32_t a = 0;
+
+  for ( a = 0; a < ACQ_MAX_STREAMS; a++ )
+  {
+    free(p_data->p_data[a]);
+    p_data->p_data[a] = NULL;
+  }
+  p_data->num_records = 0;
+}
+
+/***********************************************************************
+ * @fn      make_adc
+ *
+ * @brief   AM335x ADC at 1600000 Hz: a 1 kHz tone over most of the
+ *          12-bit range with a few codes of noise, or white noise.
+ *
+ * @param   p_data
+ *          name
+ *          encoding - ACQ_ENC_U16, ACQ_ENC_U12_PAIR or ACQ_ENC_U16_ENV
+ *          noise_only
+ *
+ * @return  void
+ **/
+void make_adc(bench_data_t *p_data, const char *name, uint32_t encoding, int noise_only)
+{
+  uint32_t values = 0;
+  uint32_t n = 0;
+  uint32_t i = 0;
+
+  memset(p_data, 0, sizeof(bench_data_t));
+  p_data->name              = name;
+  p_data->fmt.encoding      = encoding;
+  p_data->fmt.record_size   = sizeof(uint16_t);
+  p_data->fmt.record_values = 1;
+  p_data->fmt.decimation    = 1;
+  p_data->fmt.num_streams   = 1;
+  p_data->fmt.sample_rate   = ADC_TOP_RATE;
+  if ( encoding == ACQ_ENC_U12_PAIR )
+  {
+    p_data->fmt.record_size   = 3;
+    p_data->fmt.record_values = 2;
+  }
+  else if ( encoding == ACQ_ENC_U16_ENV )
+  {
+    p_data->fmt.record_size = 4 * sizeof(uint16_t);
+    p_data->fmt.decimation  = 64;
+  }
+
+  if ( bench_alloc(p_data, BENCH_RECORDS) < 0 )
+  {
+    return;
+  }
+
+  for ( n = 0; n < BENCH_RECORDS; n++ )
+  {
+    uint8_t *p = p_data->p_data[0] + n * p_data->fmt.record_size;
+
+    if ( encoding == ACQ_ENC_U12_PAIR )
+    {
+      put_le(p, adc_code(2 * n) | (adc_code(2 * n + 1) << 12), 3);
+    }
+    else if ( encoding == ACQ_ENC_U16_ENV )
+    {
+      uint32_t min = 4095;
+      uint32_t max = 0;
+      uint32_t sum = 0;
+
+      for ( i = 0; i < 64; i++ )
+      {
+        uint32_t code = adc_code(64 * n + i);
+        min  = (code < min) ? code : min;
+        max  = (code > max) ? code : max;
+        sum += code;
+      }
+      put_le(p, min, 2);
+      put_le(p + 2, max, 2);
+      put_le(p + 4, sum / 64, 2);
+    }
+    else
+    {
+      values = noise_only ? (noise(2048) + 2048) & 0xFFF : adc_code(n);
+      put_le(p, values, 2);
+    }
+  }
+}
+
+/***********************************************************************
+ * @fn      make_ads
+ *
+ * @brief   ADS1256 at 30000 SPS: a tone per channel at a different level
+ *          and frequency, with some tens of codes of noise.
+ *
+ * @param   p_data
+ *          name
+ *          encoding - ACQ_ENC_S24_TAGGED or ACQ_ENC_S24_PACKED
+ *          streams
+ *          channels - Cycled through by each stream
+ *
+ * @return  void
+ **/
+void make_ads(bench_data_t *p_data, const char *name, uint32_t encoding, uint32_t streams, uint32_t channels)
+{
+  uint32_t a = 0;
+  uint32_t n = 0;
+
+  memset(p_data, 0, sizeof(bench_data_t));
+  p_data->name              = name;
+  p_data->fmt.encoding      = encoding;
+  p_data->fmt.record_size   = (encoding == ACQ_ENC_S24_PACKED) ? 3 : sizeof(uint32_t);
+  p_data->fmt.record_values = 1;
+  p_data->fmt.decimation    = 1;
+  p_data->fmt.num_streams   = streams;
+  p_data->fmt.sample_rate   = 30000.0 / channels;
+  for ( a = 0; a < streams; a++ )
+  {
+    p_data->fmt.num_channels[a] = channels;
+  }
+
+  if ( bench_alloc(p_data, BENCH_RECORDS) < 0 )
+  {
+    return;
+  }
+
+  for ( a = 0; a < streams; a++ )
+  {
+    for ( n = 0; n < BENCH_RECORDS; n++ )
+    {
+      uint32_t chan = n % channels;
+      double t = (double)(n / channels) / p_data->fmt.sample_rate;
+      int32_t code = 400000 * (chan + 1) * sin(2 * M_PI * 50 * (chan + a + 1) * t) + noise(40);
+      uint8_t *p = p_data->p_data[a] + n * p_data->fmt.record_size;
+
+      put_le(p, code & 0xFFFFFF, 3);
+      if ( encoding == ACQ_ENC_S24_TAGGED )
+      {
+        p[3] = chan;
+      }
+    }
+  }
+}
+
+/***********************************************************************
+ * @fn      load_capture
+ *
+ * @brief   Every block of a capture file, its records joined.
+ *
+ * @param   p_data
+ *          file_name
+ *
+ * @return  0, -1 if it isn't a capture file
+ **/
+int load_capture(bench_data_t *p_data, const char *file_name)
+{
+  acq_reader_t *p_rd = NULL;
+  acq_block_t block;
+  uint64_t records = 0;
+  uint32_t streams = 0;
+  uint32_t pos = 0;
+  uint32_t a = 0;
+  uint32_t b = 0;
+  FILE *fp = fopen(file_name, "rb");
+  uint32_t magic = 0;
+
+  /* Text files are tried next, quietly */
+  if ( fp == NULL || fread(&magic, sizeof(magic), 1, fp) != 1 || magic != ACQ_FILE_MAGIC )
+  {
+    if ( fp != NULL )
+    {
+      fclose(fp);
+    }
+    return -1;
+  }
+  fclose(fp);
+
+  p_rd = acq_reader_open(file_name);
+  if ( p_rd == NULL )
+  {
+    return -1;
+  }
+
+  for ( b = 0; b < p_rd->num_blocks; b++ )
+  {
+    if ( acq_reader_read(p_rd, b, &block) == 0 )
+    {
+      records += block.num_records;
+    }
+  }
+
+  p_data->fmt = p_rd->fmt;
+  streams = (p_data->fmt.num_streams > 1) ? p_data->fmt.num_streams : 1;
+  if ( records == 0 || records > UINT32_MAX || bench_alloc(p_data, records) < 0 )
+  {
+    acq_reader_close(p_rd);
+    return -1;
+  }
+
+  for ( b = 0; b < p_rd->num_blocks; b++ )
+  {
+    if ( acq_reader_read(p_rd, b, &block) < 0 )
+    {
+      continue;
+    }
+    for ( a = 0; a < streams; a++ )
+    {
+      memcpy(p_data->p_data[a] + (uint64_t)pos * p_data->fmt.record_size, block.p_data[a],
+             block.num_records * p_data->fmt.record_size);
+    }
+    pos += block.num_records;
+  }
+  acq_reader_close(p_rd);
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      load_text
+ *
+ * @brief   Data file of the host programs, values saved as codes.
+ *          'index value' lines become 16-bit records, or signed 24-bit
+ *          when a value doesn't fit; 'index channel value' lines tagged
+ *          24-bit records; 'index min max mean' envelopes. Gap lines
+ *          are skipped.
+ *
+ * @param   p_data
+ *          file_name
+ *
+ * @return  0, -1 if there are no samples or they aren't codes
+ **/
+int load_text(bench_data_t *p_data, const char *file_name)
+{
+  FILE *fp = fopen(file_name, "r");
+  char line[LINE_MAX_LEN];
+  long field[4];
+  uint32_t num_fields = 0;
+  uint32_t lines = 0;
+  uint32_t n = 0;
+  long min = 0;
+  long max = 0;
+  long max_chan = 0;
+  int pass = 0;
+
+  if ( fp == NULL )
+  {
+    perror("fopen(data_file)");
+    return -1;
+  }
+
+  /* Count and find the layout, then fill in the records */
+  for ( pass = 0; pass < 2; pass++ )
+  {
+    rewind(fp);
+    n = 0;
+    while ( fgets(line, sizeof(line), fp) != NULL )
+    {
+      char *p = line;
+      char *p_end = NULL;
+      uint32_t k = 0;
+
+      if ( line[0] == '#' )
+      {
+        continue;
+      }
+      for ( k = 0; k < 4; k++ )
+      {
+        field[k] = strtol(p, &p_end, 10);
+        if ( p_end == p )
+        {
+          break;
+        }
+        p = p_end;
+      }
+      if ( *p != '\n' && *p != '\0' )
+      {
+        fclose(fp);
+        return -1;
+      }
+
+      if ( pass == 0 )
+      {
+        if ( lines == 0 )
+        {
+          num_fields = k;
+          min = max = field[k - 1];
+        }
+        if ( k != num_fields || k < 2 )
+        {
+          fclose(fp);
+          return -1;
+        }
+        min = (field[k - 1] < min) ? field[k - 1] : min;
+        max = (field[k - 1] > max) ? field[k - 1] : max;
+        max_chan = (k == 3 && field[1] > max_chan) ? field[1] : max_chan;
+        lines++;
+        continue;
+      }
+
+      if ( num_fields == 2 )
+      {
+        put_le(p_data->p_data[0] + n * p_data->fmt.record_size, field[1] & 0xFFFFFF, p_data->fmt.record_size);
+      }
+      else if ( num_fields == 3 )
+      {
+        put_le(p_data->p_data[0] + n * sizeof(uint32_t), (field[2] & 0xFFFFFF) | ((uint32_t)field[1] << 24), 4);
+      }
+      else
+      {
+        put_le(p_data->p_data[0] + n * 8, field[1], 2);
+        put_le(p_data->p_data[0] + n * 8 + 2, field[2], 2);
+        put_le(p_data->p_data[0] + n * 8 + 4, field[3], 2);
+      }
+      n++;
+    }
+
+    if ( pass == 0 )
+    {
+      if ( lines == 0 || max_chan >= ACQ_MAX_CHANNELS )
+      {
+        fclose(fp);
+        return -1;
+      }
+      p_data->fmt.record_values = 1;
+      p_data->fmt.decimation    = 1;
+      p_data->fmt.num_streams   = 1;
+      if ( num_fields == 2 && min >= 0 && max <= UINT16_MAX )
+      {
+        p_data->fmt.encoding    = ACQ_ENC_U16;
+        p_data->fmt.record_size = sizeof(uint16_t);
+      }
+      else if ( num_fields == 2 )
+      {
+        p_data->fmt.encoding    = ACQ_ENC_S24_PACKED;
+        p_data->fmt.record_size = 3;
+      }
+      else if ( num_fields == 3 )
+      {
+        p_data->fmt.encoding        = ACQ_ENC_S24_TAGGED;
+        p_data->fmt.record_size     = sizeof(uint32_t);
+        p_data->fmt.num_channels[0] = max_chan + 1;
+      }
+      else
+      {
+        p_data->fmt.encoding    = ACQ_ENC_U16_ENV;
+        p_data->fmt.record_size = 8;
+      }
+      if ( bench_alloc(p_data, lines) < 0 )
+      {
+        fclose(fp);
+        return -1;
+      }
+    }
+  }
+
+  fseek(fp, 0, SEEK_END);
+  p_data->text_bytes = ftell(fp);
+  fclose(fp);
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      noise
+ *
+ * @brief   Triangular noise from two xorshift draws.
+ *
+ * @param   amplitude
+ *
+ * @return  -amplitude to amplitude
+ **/
+int32_t noise(int32_t amplitude)
+{
+  int32_t sum = 0;
+  int i = 0;
+
+  for ( i = 0; i < 2; i++ )
+  {
+    SEED ^= SEED << 13;
+    SEED ^= SEED >> 17;
+    SEED ^= SEED << 5;
+    sum += (int32_t)(SEED % (amplitude + 1));
+  }
+
+  return sum - amplitude;
+}
+
+/***********************************************************************
+ * @fn      adc_code
+ *
+ * @brief
+ *
+ * @param   n - Sample index
+ *
+ * @return  12-bit code
+ **/
+uint32_t adc_code(uint32_t n)
+{
+  int32_t code = 2048 + 1500 * sin(2 * M_PI * 1000.0 * n / ADC_TOP_RATE) + noise(3);
+
+  return (code < 0) ? 0 : (code > 4095) ? 4095 : code;
+}
+
+/***********************************************************************
+ * @fn      put_le
+ *
+ * @brief
+ *
+ * @param   p
+ *          value
+ *          bytes
+ *
+ * @return  void
+ **/
+void put_le(uint8_t *p, uint32_t value, uint32_t bytes)
+{
+  uint32_t i = 0;
+
+  for ( i = 0; i < bytes; i++ )
+  {
+    p[i] = value >> (8 * i);
+  }
+}
@@ -0,0 +1,356 @@
+/***********************************************************************
+ * INCLUDES
+ **/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "acq.h"
+
+/***********************************************************************
+ * DEFINES
+ **/
+#define MSG_MAX_LEN       256
+#define DAEMON_POLL_MS    100   /* Sources without an event descriptor */
+
+/***********************************************************************
+ * FUNCTIONS
+ **/
+/***********************************************************************
+ * @fn      acq_daemon_listen
+ *
+ * @brief   Create the command socket of a daemon. One command per
+ *          connection, one text line, answered with "ok ..." or
+ *          "error ...".
+ *
+ * @param   path
+ *
+ * @return  Listening descriptor, -1 on error
+ **/
+int acq_daemon_listen(const char *path)
+{
+  struct sockaddr_un addr;
+  int listen_fd = 0;
+
+  listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if ( listen_fd < 0 )
+  {
+    perror("socket()");
+    return -1;
+  }
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+  unlink(path);
+
+  if ( bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 )
+  {
+    perror("bind()");
+    close(listen_fd);
+    return -1;
+  }
+
+  if ( listen(listen_fd, 4) < 0 )
+  {
+    perror("listen()");
+    close(listen_fd);
+    return -1;
+  }
+
+  printf("Waiting commands on %s\n", path);
+
+  return listen_fd;
+}
+
+/***********************************************************************
+ * @fn      acq_daemon_accept
+ *
+ * @brief   Wait for the next command and split it into arguments.
+ *
+ * @param   listen_fd
+ *          msg - Command line, the arguments point into it
+ *          len
+ *          arg
+ *          max_args
+ *          p_nargs
+ *
+ * @return  Client descriptor, to answer with acq_daemon_reply(), -1 if
+ *          the connection failed
+ **/
+int acq_daemon_accept(int listen_fd, char *msg, size_t len, char **arg, int max_args, int *p_nargs)
+{
+  int client_fd = 0;
+  int n = 0;
+
+  client_fd = accept(listen_fd, NULL, NULL);
+  if ( client_fd < 0 )
+  {
+    perror("accept()");
+    return -1;
+  }
+
+  if ( read_line(client_fd, msg, len) < 0 )
+  {
+    close(client_fd);
+    return -1;
+  }
+
+  /* Split arguments */
+  arg[n] = strtok(msg, " \t");
+  while ( arg[n] != NULL && n < max_args - 1 )
+  {
+    arg[++n] = strtok(NULL, " \t");
+  }
+  *p_nargs = n;
+
+  return client_fd;
+}
+
+/***********************************************************************
+ * @fn      acq_daemon_reply
+ *
+ * @brief   Answer a command and close its connection.
+ *
+ * @param   client_fd
+ *          reply - '\n' terminated
+ *
+ * @return  void
+ **/
+void acq_daemon_reply(int client_fd, const char *reply)
+{
+  send(client_fd, reply, strlen(reply), MSG_NOSIGNAL);
+  close(client_fd);
+}
+
+/***********************************************************************
+ * @fn      acq_daemon_close
+ *
+ * @brief
+ *
+ * @param   listen_fd
+ *          path
+ *
+ * @return  void
+ **/
+void acq_daemon_close(int listen_fd, const char *path)
+{
+  close(listen_fd);
+  unlink(path);
+}
+
+/***********************************************************************
+ * @fn      acq_daemon_capture
+ *
+ * @brief   Run one capture into the sinks. While it runs, 'stop' from
+ *          the requesting client (or its hang up) or from a new
+ *          connection ends it early; other commands are answered busy.
+ *
+ * @param   p_src
+ *          pp_sink
+ *          num_sinks
+ *          num_samples
+ *          block_len
+ *          listen_fd
+ *          client_fd
+ *
+ * @return  Samples delivered, -1 on error
+ **/
+int acq_daemon_capture(acq_source_t *p_src, acq_sink_t **pp_sink, uint32_t num_sinks, uint32_t num_samples,
+                       uint32_t block_len, int listen_fd, int client_fd)
+{
+  struct pollfd fds[3];
+  char msg[MSG_MAX_LEN];
+  acq_block_t block;
+  int res = 0;
+  int fd = 0;
+
+  if ( acq_start(p_src, num_samples, block_len) < 0 )
+  {
+    return -1;
+  }
+
+  if ( acq_sink_open(pp_sink, num_sinks, &p_src->fmt) < 0 )
+  {
+    acq_stop(p_src);
+    while ( acq_read_block(p_src, &block, -1) > 0 );
+    return -1;
+  }
+
+  fds[0].fd     = acq_event_fd(p_src);
+  fds[0].events = POLLIN;
+  fds[1].fd     = listen_fd;
+  fds[1].events = POLLIN;
+  fds[2].fd     = client_fd;
+  fds[2].events = POLLIN;
+
+  for ( ;; )
+  {
+    /* Blocks completed so far */
+    while ( (res = acq_read_block(p_src, &block, 0)) == ACQ_READ_BLOCK )
+    {
+      acq_sink_write(pp_sink, num_sinks, &block);
+    }
+    if ( res != ACQ_READ_AGAIN )
+    {
+      break;
+    }
+
+    if ( poll(fds, 3, (fds[0].fd < 0) ? DAEMON_POLL_MS : -1) < 0 )
+    {
+      perror("poll()");
+      acq_stop(p_src);
+      while ( (res = acq_read_block(p_src, &block, -1)) == ACQ_READ_BLOCK )
+      {
+        acq_sink_write(pp_sink, num_sinks, &block);
+      }
+      break;
+    }
+
+    /* Another client */
+    if ( fds[1].revents & POLLIN )
+    {
+      fd = accept(listen_fd, NULL, NULL);
+      if ( fd >= 0 )
+      {
+        const char *answer = "error busy\n";
+        if ( read_line(fd, msg, sizeof(msg)) >= 0 )
+        {
+          if ( strncmp(msg, "stop", 4) == 0 )
+          {
+            acq_stop(p_src);
+            answer = "ok stopping\n";
+          }
+          else if ( strncmp(msg, "status", 6) == 0 )
+          {
+            answer = "ok running\n";
+          }
+        }
+        acq_daemon_reply(fd, answer);
+      }
+    }
+
+    /* Requesting client sent 'stop' or hung up */
+    if ( fds[2].revents & (POLLIN | POLLHUP | POLLERR) )
+    {
+      if ( read_line(client_fd, msg, sizeof(msg)) < 0 || strncmp(msg, "stop", 4) == 0 )
+      {
+        acq_stop(p_src);
+      }
+      fds[2].fd = -1;
+    }
+  }
+
+  printf("%s: %llu samples in %.6f s\n", p_src->stats.stopped ? "Stopped" : "Done",
+         (unsigned long long)p_src->stats.samples, p_src->stats.seconds);
+
+  if ( acq_sink_close(pp_sink, num_sinks) < 0 || res < 0 )
+  {
+    return -1;
+  }
+
+  return (int)p_src->stats.samples;
+}
+
+/***********************************************************************
+ * @fn      acq_client_run
+ *
+ * @brief   Send a command line to a daemon and print its answer.
+ *
+ * @param   path
+ *          argc
+ *          argv
+ *
+ * @return  0 if the answer is "ok ...", -1 otherwise
+ **/
+int acq_client_run(const char *path, int argc, char *argv[])
+{
+  struct sockaddr_un addr;
+  char msg[MSG_MAX_LEN] = "";
+  char reply[MSG_MAX_LEN] = "";
+  int fd = 0;
+  int i = 0;
+
+  for ( i = 0; i < argc; i++ )
+  {
+    strncat(msg, argv[i], sizeof(msg) - strlen(msg) - 2);
+    strncat(msg, (i == argc - 1) ? "\n" : " ", sizeof(msg) - strlen(msg) - 1);
+  }
+
+  fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if ( fd < 0 )
+  {
+    perror("socket()");
+    return -1;
+  }
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+  if ( connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 )
+  {
+    fprintf(stderr, "connect(\"%s\"): ", path);
+    perror(NULL);
+    close(fd);
+    return -1;
+  }
+
+  /* Answer comes when the command completes */
+  if ( write(fd, msg, strlen(msg)) < 0 || read_line(fd, reply, sizeof(reply)) < 0 )
+  {
+    perror("daemon");
+    close(fd);
+    return -1;
+  }
+  close(fd);
+
+  printf("%s\n", reply);
+
+  return (strncmp(reply, "ok", 2) == 0) ? 0 : -1;
+}
+
+/***********************************************************************
+ * @fn      read_line
+ *
+ * @brief   Read a '\n' terminated line (terminator removed).
+ *
+ * @param   fd
+ *          buf
+ *          len
+ *
+ * @return  Line length, -1 on error or closed connection
+ **/
+int read_line(int fd, char *buf, size_t len)
+{
+  size_t n = 0;
+  char c = 0;
+
+  while ( n < len - 1 )
+  {
+    if ( read(fd, &c, 1) != 1 )
+    {
+      if ( n == 0 )
+      {
+        return -1;
+      }
+      break;
+    }
+    if ( c == '\n' )
+    {
+      break;
+    }
+    if ( c != '\r' )
+    {
+      buf[n++] = c;
+    }
+  }
+  buf[n] = '\0';
+
+  return (int)n;
+}
@@ -0,0 +1,519 @@
+/***********************************************************************
+ * INCLUDES
+ **/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+#include "acq_fft.h"
+
+/***********************************************************************
+ * TYPEDEFS
+ **/
+/* A real FFT of N is a complex one of M = N / 2 on the even values as
+ * real parts and the odd ones as imaginary parts, then split. The
+ * complex FFT is Stockham radix-4 (a radix-2 stage last where M is not
+ * a power of 4): every stage reads one buffer and writes the other in
+ * order, so there is no bit reversal and the inner loops run on 4
+ * consecutive values. Real and imaginary parts are kept in separate
+ * arrays, as NEON wants them. */
+typedef struct acq_fft_t
+{
+  uint32_t size;              /* N */
+  uint32_t half;              /* M */
+  float   *p_tw;              /* Per radix-4 stage of m = n / 4: w1, w2, w3, re and im, m each */
+  float   *p_split_re;        /* exp(-2 pi i k / N), k < M */
+  float   *p_split_im;
+  float   *p_re[2];           /* Stockham buffers */
+  float   *p_im[2];
+} acq_fft_t;
+
+/***********************************************************************
+ * PRIVATE FUNCTIONS PROTOTYPES
+ **/
+static void fft_load(acq_fft_t *p_fft, const float *p_in, const float *p_window);
+static void fft_radix4(uint32_t n, uint32_t s, const float *p_tw, const float *p_xr, const float *p_xi,
+                       float *p_yr, float *p_yi);
+static void fft_radix2(uint32_t s, const float *p_xr, const float *p_xi, float *p_yr, float *p_yi);
+static void fft_split(const acq_fft_t *p_fft, const float *p_zr, const float *p_zi, float *p_re, float *p_im);
+
+/***********************************************************************
+ * FUNCTIONS
+ **/
+/***********************************************************************
+ * @fn      acq_fft_create
+ *
+ * @brief   Twiddles are computed here, in double, once.
+ *
+ * @param   size - N, power of 2 from ACQ_FFT_MIN_SIZE to ACQ_FFT_MAX_SIZE
+ *
+ * @return  FFT or NULL
+ **/
+acq_fft_t *acq_fft_create(uint32_t size)
+{
+  acq_fft_t *p_fft = NULL;
+  float *p_tw = NULL;
+  uint32_t n = 0;
+  uint32_t m = 0;
+  uint32_t p = 0;
+  uint32_t k = 0;
+
+  if ( size < ACQ_FFT_MIN_SIZE || size > ACQ_FFT_MAX_SIZE || (size & (size - 1)) != 0 )
+  {
+    return NULL;
+  }
+
+  p_fft = calloc(1, sizeof(acq_fft_t));
+  if ( p_fft == NULL )
+  {
+    return NULL;
+  }
+  p_fft->size       = size;
+  p_fft->half       = size / 2;
+  p_fft->p_tw       = malloc(6 * p_fft->half * sizeof(float));
+  p_fft->p_split_re = malloc(p_fft->half * sizeof(float));
+  p_fft->p_split_im = malloc(p_fft->half * sizeof(float));
+  for ( k = 0; k < 2; k++ )
+  {
+    p_fft->p_re[k] = malloc(p_fft->half * sizeof(float));
+    p_fft->p_im[k] = malloc(p_fft->half * sizeof(float));
+  }
+  if ( p_fft->p_tw == NULL || p_fft->p_split_re == NULL || p_fft->p_split_im == NULL || p_fft->p_re[0] == NULL ||
+       p_fft->p_im[0] == NULL || p_fft->p_re[1] == NULL || p_fft->p_im[1] == NULL )
+  {
+    acq_fft_destroy(p_fft);
+    return NULL;
+  }
+
+  p_tw = p_fft->p_tw;
+  for ( n = p_fft->half; n >= 4; n /= 4 )
+  {
+    m = n / 4;
+    for ( p = 0; p < m; p++ )
+    {
+      for ( k = 1; k <= 3; k++ )
+      {
+        p_tw[(2 * k - 2) * m + p] = cos(2 * M_PI * k * p / n);
+        p_tw[(2 * k - 1) * m + p] = -sin(2 * M_PI * k * p / n);
+      }
+    }
+    p_tw += 6 * m;
+  }
+  for ( k = 0; k < p_fft->half; k++ )
+  {
+    p_fft->p_split_re[k] = cos(2 * M_PI * k / size);
+    p_fft->p_split_im[k] = -sin(2 * M_PI * k / size);
+  }
+
+  return p_fft;
+}
+
+/***********************************************************************
+ * @fn      acq_fft_destroy
+ *
+ * @brief
+ *
+ * @param   p_fft - Or NULL
+ *
+ * @return  void
+ **/
+void acq_fft_destroy(acq_fft_t *p_fft)
+{
+  uint32_t k = 0;
+
+  if ( p_fft == NULL )
+  {
+    return;
+  }
+  for ( k = 0; k < 2; k++ )
+  {
+    free(p_fft->p_re[k]);
+    free(p_fft->p_im[k]);
+  }
+  free(p_fft->p_split_re);
+  free(p_fft->p_split_im);
+  free(p_fft->p_tw);
+  free(p_fft);
+}
+
+/***********************************************************************
+ * @fn      acq_fft_size
+ *
+ * @brief
+ *
+ * @param   p_fft
+ *
+ * @return  N
+ **/
+uint32_t acq_fft_size(const acq_fft_t *p_fft)
+{
+  return p_fft->size;
+}
+
+/***********************************************************************
+ * @fn      acq_fft_real
+ *
+ * @brief   DFT of N real values: X[k] = sum x[n] w[n] exp(-2 pi i k n / N),
+ *          unscaled.
+ *
+ * @param   p_fft
+ *          p_in - N values
+ *          p_window - N weights, or NULL
+ *          p_re, p_im - X[0] to X[N / 2], N / 2 + 1 each
+ *
+ * @return  void
+ **/
+void acq_fft_real(acq_fft_t *p_fft, const float *p_in, const float *p_window, float *p_re, float *p_im)
+{
+  const float *p_tw = p_fft->p_tw;
+  uint32_t cur = 0;
+  uint32_t n = 0;
+  uint32_t s = 1;
+
+  fft_load(p_fft, p_in, p_window);
+  for ( n = p_fft->half; n >= 4; n /= 4 )
+  {
+    fft_radix4(n, s, p_tw, p_fft->p_re[cur], p_fft->p_im[cur], p_fft->p_re[cur ^ 1], p_fft->p_im[cur ^ 1]);
+    p_tw += 6 * (n / 4);
+    s *= 4;
+    cur ^= 1;
+  }
+  if ( n == 2 )
+  {
+    fft_radix2(s, p_fft->p_re[cur], p_fft->p_im[cur], p_fft->p_re[cur ^ 1], p_fft->p_im[cur ^ 1]);
+    cur ^= 1;
+  }
+  fft_split(p_fft, p_fft->p_re[cur], p_fft->p_im[cur], p_re, p_im);
+}
+
+/***********************************************************************
+ * @fn      acq_goertzel_init
+ *
+ * @brief
+ *
+ * @param   p_gz
+ *          freq - Cycles per value (Hz / values per second)
+ *
+ * @return  void
+ **/
+void acq_goertzel_init(acq_goertzel_t *p_gz, double freq)
+{
+  p_gz->coeff = 2 * cos(2 * M_PI * freq);
+  p_gz->s1    = 0;
+  p_gz->s2    = 0;
+  p_gz->n     = 0;
+}
+
+/***********************************************************************
+ * @fn      acq_goertzel_add
+ *
+ * @brief   Two multiplications and adds per value.
+ *
+ * @param   p_gz
+ *          p_in
+ *          num_values
+ *
+ * @return  void
+ **/
+void acq_goertzel_add(acq_goertzel_t *p_gz, const float *p_in, uint32_t num_values)
+{
+  double coeff = p_gz->coeff;
+  double s1 = p_gz->s1;
+  double s2 = p_gz->s2;
+  double s0 = 0;
+  uint32_t i = 0;
+
+  for ( i = 0; i < num_values; i++ )
+  {
+    s0 = p_in[i] + coeff * s1 - s2;
+    s2 = s1;
+    s1 = s0;
+  }
+  p_gz->s1 = s1;
+  p_gz->s2 = s2;
+  p_gz->n += num_values;
+}
+
+/***********************************************************************
+ * @fn      acq_goertzel_amplitude
+ *
+ * @brief   |X(f)| of the values so far: the phase of the last step does
+ *          not change it, so the frequency needs not fall on a bin.
+ *
+ * @param   p_gz
+ *
+ * @return  Amplitude of a sinusoid at the frequency: 2 |X(f)| / n
+ **/
+double acq_goertzel_amplitude(const acq_goertzel_t *p_gz)
+{
+  double power = p_gz->s1 * p_gz->s1 + p_gz->s2 * p_gz->s2 - p_gz->coeff * p_gz->s1 * p_gz->s2;
+
+  if ( p_gz->n == 0 )
+  {
+    return 0;
+  }
+
+  return 2 * sqrt((power > 0) ? power : 0) / p_gz->n;
+}
+
+/***********************************************************************
+ * @fn      fft_load
+ *
+ * @brief   Even values to the real parts, odd ones to the imaginary
+ *          parts, weighted.
+ *
+ * @param   p_fft
+ *          p_in
+ *          p_window - Or NULL
+ *
+ * @return  void
+ **/
+static void fft_load(acq_fft_t *p_fft, const float *p_in, const float *p_window)
+{
+  float *p_re = p_fft->p_re[0];
+  float *p_im = p_fft->p_im[0];
+  uint32_t k = 0;
+
+#if defined(__ARM_NEON)
+  for ( ; k + 4 <= p_fft->half; k += 4 )
+  {
+    float32x4x2_t v = vld2q_f32(p_in + 2 * k);
+
+    if ( p_window != NULL )
+    {
+      float32x4x2_t w = vld2q_f32(p_window + 2 * k);
+
+      v.val[0] = vmulq_f32(v.val[0], w.val[0]);
+      v.val[1] = vmulq_f32(v.val[1], w.val[1]);
+    }
+    vst1q_f32(p_re + k, v.val[0]);
+    vst1q_f32(p_im + k, v.val[1]);
+  }
+#endif
+
+  for ( ; k < p_fft->half; k++ )
+  {
+    p_re[k] = (p_window != NULL) ? p_in[2 * k] * p_window[2 * k] : p_in[2 * k];
+    p_im[k] = (p_window != NULL) ? p_in[2 * k + 1] * p_window[2 * k + 1] : p_in[2 * k + 1];
+  }
+}
+
+/***********************************************************************
+ * @fn      fft_radix4
+ *
+ * @brief   A Stockham radix-4 stage, decimation in frequency:
+ *          y[q + s (4p + k)] from x[q + s (p + k m)], m = n / 4. The
+ *          first stage (s = 1) goes 4 p at a time and interleaves its
+ *          outputs with vst4; the others go 4 q at a time.
+ *
+ * @param   n - Length of the transforms of the stage
+ *          s - Number of them (stride)
+ *          p_tw - w1, w2, w3 of the stage
+ *          p_xr, p_xi - In
+ *          p_yr, p_yi - Out
+ *
+ * @return  void
+ **/
+static void fft_radix4(uint32_t n, uint32_t s, const float *p_tw, const float *p_xr, const float *p_xi,
+                       float *p_yr, float *p_yi)
+{
+  uint32_t m = n / 4;
+  uint32_t p = 0;
+  uint32_t q = 0;
+
+#if defined(__ARM_NEON)
+  if ( s == 1 && m >= 4 )
+  {
+    for ( p = 0; p < m; p += 4 )
+    {
+      float32x4_t ar = vld1q_f32(p_xr + p),         ai = vld1q_f32(p_xi + p);
+      float32x4_t br = vld1q_f32(p_xr + p + m),     bi = vld1q_f32(p_xi + p + m);
+      float32x4_t cr = vld1q_f32(p_xr + p + 2 * m), ci = vld1q_f32(p_xi + p + 2 * m);
+      float32x4_t dr = vld1q_f32(p_xr + p + 3 * m), di = vld1q_f32(p_xi + p + 3 * m);
+      float32x4_t apcr = vaddq_f32(ar, cr), apci = vaddq_f32(ai, ci);
+      float32x4_t amcr = vsubq_f32(ar, cr), amci = vsubq_f32(ai, ci);
+      float32x4_t bpdr = vaddq_f32(br, dr), bpdi = vaddq_f32(bi, di);
+      float32x4_t bmdr = vsubq_f32(br, dr), bmdi = vsubq_f32(bi, di);
+      float32x4_t t1r = vaddq_f32(amcr, bmdi), t1i = vsubq_f32(amci, bmdr);
+      float32x4_t t2r = vsubq_f32(apcr, bpdr), t2i = vsubq_f32(apci, bpdi);
+      float32x4_t t3r = vsubq_f32(amcr, bmdi), t3i = vaddq_f32(amci, bmdr);
+      float32x4_t w1r = vld1q_f32(p_tw + p),         w1i = vld1q_f32(p_tw + m + p);
+      float32x4_t w2r = vld1q_f32(p_tw + 2 * m + p), w2i = vld1q_f32(p_tw + 3 * m + p);
+      float32x4_t w3r = vld1q_f32(p_tw + 4 * m + p), w3i = vld1q_f32(p_tw + 5 * m + p);
+      float32x4x4_t yr;
+      float32x4x4_t yi;
+
+      yr.val[0] = vaddq_f32(apcr, bpdr);
+      yi.val[0] = vaddq_f32(apci, bpdi);
+      yr.val[1] = vmlsq_f32(vmulq_f32(t1r, w1r), t1i, w1i);
+      yi.val[1] = vmlaq_f32(vmulq_f32(t1r, w1i), t1i, w1r);
+      yr.val[2] = vmlsq_f32(vmulq_f32(t2r, w2r), t2i, w2i);
+      yi.val[2] = vmlaq_f32(vmulq_f32(t2r, w2i), t2i, w2r);
+      yr.val[3] = vmlsq_f32(vmulq_f32(t3r, w3r), t3i, w3i);
+      yi.val[3] = vmlaq_f32(vmulq_f32(t3r, w3i), t3i, w3r);
+      vst4q_f32(p_yr + 4 * p, yr);
+      vst4q_f32(p_yi + 4 * p, yi);
+    }
+    return;
+  }
+#endif
+
+  for ( p = 0; p < m; p++ )
+  {
+    float w1r = p_tw[p], w1i = p_tw[m + p];
+    float w2r = p_tw[2 * m + p], w2i = p_tw[3 * m + p];
+    float w3r = p_tw[4 * m + p], w3i = p_tw[5 * m + p];
+    const float *p_ar = p_xr + s * p, *p_ai = p_xi + s * p;
+    const float *p_br = p_ar + s * m, *p_bi = p_ai + s * m;
+    const float *p_cr = p_br + s * m, *p_ci = p_bi + s * m;
+    const float *p_dr = p_cr + s * m, *p_di = p_ci + s * m;
+    float *p_y0r = p_yr + s * 4 * p, *p_y0i = p_yi + s * 4 * p;
+
+    q = 0;
+#if defined(__ARM_NEON)
+    for ( ; q + 4 <= s; q += 4 )
+    {
+      float32x4_t ar = vld1q_f32(p_ar + q), ai = vld1q_f32(p_ai + q);
+      float32x4_t br = vld1q_f32(p_br + q), bi = vld1q_f32(p_bi + q);
+      float32x4_t cr = vld1q_f32(p_cr + q), ci = vld1q_f32(p_ci + q);
+      float32x4_t dr = vld1q_f32(p_dr + q), di = vld1q_f32(p_di + q);
+      float32x4_t apcr = vaddq_f32(ar, cr), apci = vaddq_f32(ai, ci);
+      float32x4_t amcr = vsubq_f32(ar, cr), amci = vsubq_f32(ai, ci);
+      float32x4_t bpdr = vaddq_f32(br, dr), bpdi = vaddq_f32(bi, di);
+      float32x4_t bmdr = vsubq_f32(br, dr), bmdi = vsubq_f32(bi, di);
+      float32x4_t t1r = vaddq_f32(amcr, bmdi), t1i = vsubq_f32(amci, bmdr);
+      float32x4_t t2r = vsubq_f32(apcr, bpdr), t2i = vsubq_f32(apci, bpdi);
+      float32x4_t t3r = vsubq_f32(amcr, bmdi), t3i = vaddq_f32(amci, bmdr);
+
+      vst1q_f32(p_y0r + q, vaddq_f32(apcr, bpdr));
+      vst1q_f32(p_y0i + q, vaddq_f32(apci, bpdi));
+      vst1q_f32(p_y0r + s + q, vmlsq_n_f32(vmulq_n_f32(t1r, w1r), t1i, w1i));
+      vst1q_f32(p_y0i + s + q, vmlaq_n_f32(vmulq_n_f32(t1r, w1i), t1i, w1r));
+      vst1q_f32(p_y0r + 2 * s + q, vmlsq_n_f32(vmulq_n_f32(t2r, w2r), t2i, w2i));
+      vst1q_f32(p_y0i + 2 * s + q, vmlaq_n_f32(vmulq_n_f32(t2r, w2i), t2i, w2r));
+      vst1q_f32(p_y0r + 3 * s + q, vmlsq_n_f32(vmulq_n_f32(t3r, w3r), t3i, w3i));
+      vst1q_f32(p_y0i + 3 * s + q, vmlaq_n_f32(vmulq_n_f32(t3r, w3i), t3i, w3r));
+    }
+#endif
+    for ( ; q < s; q++ )
+    {
+      float apcr = p_ar[q] + p_cr[q], apci = p_ai[q] + p_ci[q];
+      float amcr = p_ar[q] - p_cr[q], amci = p_ai[q] - p_ci[q];
+      float bpdr = p_br[q] + p_dr[q], bpdi = p_bi[q] + p_di[q];
+      float bmdr = p_br[q] - p_dr[q], bmdi = p_bi[q] - p_di[q];
+      float t1r = amcr + bmdi, t1i = amci - bmdr;
+      float t2r = apcr - bpdr, t2i = apci - bpdi;
+      float t3r = amcr - bmdi, t3i = amci + bmdr;
+
+      p_y0r[q]         = apcr + bpdr;
+      p_y0i[q]         = apci + bpdi;
+      p_y0r[s + q]     = t1r * w1r - t1i * w1i;
+      p_y0i[s + q]     = t1r * w1i + t1i * w1r;
+      p_y0r[2 * s + q] = t2r * w2r - t2i * w2i;
+      p_y0i[2 * s + q] = t2r * w2i + t2i * w2r;
+      p_y0r[3 * s + q] = t3r * w3r - t3i * w3i;
+      p_y0i[3 * s + q] = t3r * w3i + t3i * w3r;
+    }
+  }
+}
+
+/***********************************************************************
+ * @fn      fft_radix2
+ *
+ * @brief   Last Stockham stage, of transforms of 2 (no twiddles).
+ *
+ * @param   s - Number of them, half the values
+ *          p_xr, p_xi - In
+ *          p_yr, p_yi - Out
+ *
+ * @return  void
+ **/
+static void fft_radix2(uint32_t s, const float *p_xr, const float *p_xi, float *p_yr, float *p_yi)
+{
+  uint32_t q = 0;
+
+#if defined(__ARM_NEON)
+  for ( ; q + 4 <= s; q += 4 )
+  {
+    float32x4_t ar = vld1q_f32(p_xr + q), ai = vld1q_f32(p_xi + q);
+    float32x4_t br = vld1q_f32(p_xr + s + q), bi = vld1q_f32(p_xi + s + q);
+
+    vst1q_f32(p_yr + q, vaddq_f32(ar, br));
+    vst1q_f32(p_yi + q, vaddq_f32(ai, bi));
+    vst1q_f32(p_yr + s + q, vsubq_f32(ar, br));
+    vst1q_f32(p_yi + s + q, vsubq_f32(ai, bi));
+  }
+#endif
+
+  for ( ; q < s; q++ )
+  {
+    float ar = p_xr[q], ai = p_xi[q];
+
+    p_yr[q]     = ar + p_xr[s + q];
+    p_yi[q]     = ai + p_xi[s + q];
+    p_yr[s + q] = ar - p_xr[s + q];
+    p_yi[s + q] = ai - p_xi[s + q];
+  }
+}
+
+/***********************************************************************
+ * @fn      fft_split
+ *
+ * @brief   The real spectrum from the complex one Z of M:
+ *          X[k] = E[k] + W^k O[k], E = (Z[k] + Z*[M - k]) / 2 and
+ *          O = -i (Z[k] - Z*[M - k]) / 2. NEON reverses Z[M - k] 4 at
+ *          a time.
+ *
+ * @param   p_fft
+ *          p_zr, p_zi - Z, M values
+ *          p_re, p_im - X, M + 1 values
+ *
+ * @return  void
+ **/
+static void fft_split(const acq_fft_t *p_fft, const float *p_zr, const float *p_zi, float *p_re, float *p_im)
+{
+  uint32_t half = p_fft->half;
+  uint32_t k = 1;
+
+  p_re[0]    = p_zr[0] + p_zi[0];
+  p_im[0]    = 0;
+  p_re[half] = p_zr[0] - p_zi[0];
+  p_im[half] = 0;
+
+#if defined(__ARM_NEON)
+  for ( ; k + 4 <= half; k += 4 )
+  {
+    float32x4_t zr = vld1q_f32(p_zr + k), zi = vld1q_f32(p_zi + k);
+    float32x4_t rr = vrev64q_f32(vld1q_f32(p_zr + half - k - 3));
+    float32x4_t ri = vrev64q_f32(vld1q_f32(p_zi + half - k - 3));
+    float32x4_t wr = vld1q_f32(p_fft->p_split_re + k), wi = vld1q_f32(p_fft->p_split_im + k);
+    float32x4_t even_r, even_i, odd_r, odd_i;
+
+    rr = vcombine_f32(vget_high_f32(rr), vget_low_f32(rr));
+    ri = vcombine_f32(vget_high_f32(ri), vget_low_f32(ri));
+    even_r = vmulq_n_f32(vaddq_f32(zr, rr), 0.5f);
+    even_i = vmulq_n_f32(vsubq_f32(zi, ri), 0.5f);
+    odd_r  = vmulq_n_f32(vaddq_f32(zi, ri), 0.5f);
+    odd_i  = vmulq_n_f32(vsubq_f32(rr, zr), 0.5f);
+    vst1q_f32(p_re + k, vmlsq_f32(vmlaq_f32(even_r, odd_r, wr), odd_i, wi));
+    vst1q_f32(p_im + k, vmlaq_f32(vmlaq_f32(even_i, odd_r, wi), odd_i, wr));
+  }
+#endif
+
+  for ( ; k < half; k++ )
+  {
+    float even_r = (p_zr[k] + p_zr[half - k]) * 0.5f;
+    float even_i = (p_zi[k] - p_zi[half - k]) * 0.5f;
+    float odd_r  = (p_zi[k] + p_zi[half - k]) * 0.5f;
+    float odd_i  = (p_zr[half - k] - p_zr[k]) * 0.5f;
+    float wr = p_fft->p_split_re[k];
+    float wi = p_fft->p_split_im[k];
+
+    p_re[k] = even_r + odd_r * wr - odd_i * wi;
+    p_im[k] = even_i + odd_r * wi + odd_i * wr;
+  }
+}
@@ -0,0 +1,483 @@
+/***********************************************************************
+ * INCLUDES
+ **/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include "acq.h"
+#include "acq_fft.h"
+
+/***********************************************************************
+ * DEFINES
+ **/
+#define BENCH_RECORDS     (1 << 20)
+#define BENCH_BLOCK       1000
+#define BENCH_TIME        0.5
+#define DFT_BINS          64        /* Bins of the DFT above 4096 values, timed and checked */
+#define MAX_ERROR         1e-5      /* Of the FFT, relative to the largest bin */
+#define NUM_TONES         4
+#define ADC_TOP_RATE      1600000
+#define NUM_CONFIGS       4
+
+/***********************************************************************
+ * TYPEDEFS
+ **/
+typedef struct bench_data_t
+{
+  const char  *name;
+  acq_format_t fmt;
+  uint8_t     *p_data;
+  uint32_t     num_records;
+} bench_data_t;
+
+/* Spectrum settings, as given to -G */
+typedef struct bench_config_t
+{
+  const char  *name;
+  acq_option_t opt[3];
+  uint32_t     num_opts;
+} bench_config_t;
+
+/***********************************************************************
+ * GLOBALS
+ **/
+static uint32_t SEED = 2463534242u;
+
+static const bench_config_t CONFIGS[NUM_CONFIGS] =
+{
+  {"1024 / 50%",  {{"size", "1024"}, {NULL, NULL}, {NULL, NULL}}, 1},
+  {"4096 / 75%",  {{"size", "4096"}, {"overlap", "75"}, {NULL, NULL}}, 2},
+  {"65536 / 50%", {{"size", "65536"}, {NULL, NULL}, {NULL, NULL}}, 1},
+  {"4 tones",     {{"size", "0"}, {"tones", "50,150,250,1000"}, {NULL, NULL}}, 2},
+};
+
+/***********************************************************************
+ * LOCAL FUNCTIONS PROTOTYPES
+ **/
+int    bench_fft(uint32_t size);
+int    bench_goertzel(void);
+int    bench_sink(bench_data_t *p_data);
+double bench_config(bench_data_t *p_data, const bench_config_t *p_config);
+void   make_adc(bench_data_t *p_data);
+void   make_ads(bench_data_t *p_data);
+void   make_signal(float *p_x, uint32_t num_values);
+int32_t noise(int32_t amplitude);
+double now_seconds(void);
+
+/***********************************************************************
+ * MAIN
+ **/
+int main(int argc, char *argv[])
+{
+  bench_data_t data;
+  uint32_t size = 0;
+  uint32_t i = 0;
+  int res = 0;
+
+  if ( argc >= 2 )
+  {
+    printf("Usage: %s\n\n", argv[0]);
+    printf("\tReal FFT of 256 to 65536 values against a naive DFT, the\n");
+    printf("\tGoertzel tones, then the spectrum sink on synthetic captures,\n");
+    printf("\tin millions of samples per second, per setting\n\n");
+    return -1;
+  }
+
+  printf("%-8s %12s %12s %12s %10s %12s\n", "values", "FFT us", "FFT Msmp/s", "DFT us", "speedup", "rel. error");
+  for ( size = 256; size <= ACQ_FFT_MAX_SIZE; size *= 2 )
+  {
+    res |= bench_fft(size);
+  }
+  printf("(*) DFT of %d bins, timed for all of them\n\n", DFT_BINS);
+
+  res |= bench_goertzel();
+
+  printf("\n%-14s", "Msmp/s");
+  for ( i = 0; i < NUM_CONFIGS; i++ )
+  {
+    printf(" %12s", CONFIGS[i].name);
+  }
+  printf("\n");
+
+  make_adc(&data);
+  res |= bench_sink(&data);
+  make_ads(&data);
+  res |= bench_sink(&data);
+
+  return (res < 0) ? -1 : 0;
+}
+
+/***********************************************************************
+ * LOCAL FUNCTIONS
+ **/
+/***********************************************************************
+ * @fn      bench_fft
+ *
+ * @brief   acq_fft_real() against the DFT summed in double with a table
+ *          of exp(-2 pi i j / N): time per transform and largest error.
+ *          Above 4096 values the DFT is only taken at DFT_BINS bins.
+ *
+ * @param   size
+ *
+ * @return  0, -1 if the FFT is off
+ **/
+int bench_fft(uint32_t size)
+{
+  acq_fft_t *p_fft = acq_fft_create(size);
+  uint32_t bins = size / 2 + 1;
+  uint32_t dft_bins = (size > 4096) ? DFT_BINS : bins;
+  float *p_x = malloc(size * sizeof(float));
+  float *p_re = malloc(bins * sizeof(float));
+  float *p_im = malloc(bins * sizeof(float));
+  double *p_cos = malloc(size * sizeof(double));
+  double *p_sin = malloc(size * sizeof(double));
+  double t0 = 0;
+  double t_fft = 0;
+  double t_dft = 0;
+  double error = 0;
+  double top = 0;
+  double re = 0;
+  double im = 0;
+  uint32_t rounds = 0;
+  uint32_t j = 0;
+  uint32_t k = 0;
+  uint32_t n = 0;
+  int res = 0;
+
+  if ( p_fft == NULL || p_x == NULL || p_re == NULL || p_im == NULL || p_cos == NULL || p_sin == NULL )
+  {
+    perror("malloc(bench)");
+    res = -1;
+    goto out;
+  }
+  make_signal(p_x, size);
+  for ( j = 0; j < size; j++ )
+  {
+    p_cos[j] = cos(2 * M_PI * j / size);
+    p_sin[j] = -sin(2 * M_PI * j / size);
+  }
+
+  t0 = now_seconds();
+  for ( rounds = 0; now_seconds() - t0 < BENCH_TIME; rounds++ )
+  {
+    acq_fft_real(p_fft, p_x, NULL, p_re, p_im);
+  }
+  t_fft = (now_seconds() - t0) / rounds;
+
+  t0 = now_seconds();
+  for ( j = 0; j < dft_bins; j++ )
+  {
+    k  = (uint64_t)j * (bins - 1) / ((dft_bins > 1) ? dft_bins - 1 : 1);
+    re = 0;
+    im = 0;
+    for ( n = 0; n < size; n++ )
+    {
+      re += p_x[n] * p_cos[(uint64_t)k * n % size];
+      im += p_x[n] * p_sin[(uint64_t)k * n % size];
+    }
+    error = (hypot(re - p_re[k], im - p_im[k]) > error) ? hypot(re - p_re[k], im - p_im[k]) : error;
+    top   = (hypot(re, im) > top) ? hypot(re, im) : top;
+  }
+  t_dft = (now_seconds() - t0) * bins / dft_bins;
+
+  error /= top;
+  printf("%-8u %12.1f %12.1f %11.0f%s %10.0f %12.2e\n", size, t_fft * 1e6, size / t_fft / 1e6, t_dft * 1e6,
+         (dft_bins < bins) ? "*" : " ", t_dft / t_fft, error);
+  res = (error < MAX_ERROR) ? 0 : -1;
+
+out:
+  acq_fft_destroy(p_fft);
+  free(p_x);
+  free(p_re);
+  free(p_im);
+  free(p_cos);
+  free(p_sin);
+
+  return res;
+}
+
+/***********************************************************************
+ * @fn      bench_goertzel
+ *
+ * @brief   A 50 Hz tone over a second of the ADC at its top rate, off
+ *          the bins of any FFT size: time per value and error of its
+ *          amplitude.
+ *
+ * @param   void
+ *
+ * @return  0, -1 if the amplitude is off
+ **/
+int bench_goertzel(void)
+{
+  float *p_x = malloc(ADC_TOP_RATE * sizeof(float));
+  acq_goertzel_t gz;
+  double amp = 0;
+  double t0 = 0;
+  double t = 0;
+  uint32_t rounds = 0;
+  uint32_t i = 0;
+
+  if ( p_x == NULL )
+  {
+    perror("malloc(bench)");
+    return -1;
+  }
+  for ( i = 0; i < ADC_TOP_RATE; i++ )
+  {
+    p_x[i] = 2048 + 1000 * cos(2 * M_PI * 50.0 * i / ADC_TOP_RATE + 0.7) + noise(3);
+  }
+
+  t0 = now_seconds();
+  for ( rounds = 0; now_seconds() - t0 < BENCH_TIME; rounds++ )
+  {
+    acq_goertzel_init(&gz, 50.0 / ADC_TOP_RATE);
+    acq_goertzel_add(&gz, p_x, ADC_TOP_RATE);
+  }
+  t   = (now_seconds() - t0) / rounds;
+  amp = acq_goertzel_amplitude(&gz);
+  free(p_x);
+
+  printf("Goertzel: %.2f ns per value per tone, 1000 at 50 Hz of 1600000 Hz: %.4f\n", t / ADC_TOP_RATE * 1e9,
+         amp);
+
+  return (fabs(amp - 1000) < 0.1) ? 0 : -1;
+}
+
+/***********************************************************************
+ * @fn      bench_sink
+ *
+ * @brief   The capture through the spectrum sink with each setting.
+ *
+ * @param   p_data - Records, freed on return
+ *
+ * @return  0 if every setting keeps up with the source, -1 otherwise
+ **/
+int bench_sink(bench_data_t *p_data)
+{
+  double rate = 0;
+  uint32_t i = 0;
+  int res = 0;
+
+  if ( p_data->num_records == 0 )
+  {
+    return -1;
+  }
+
+  printf("%-14s", p_data->name);
+  for ( i = 0; i < NUM_CONFIGS; i++ )
+  {
+    rate = bench_config(p_data, &CONFIGS[i]);
+    printf(" %12.1f", rate / 1e6);
+    if ( rate < p_data->fmt.sample_rate )
+    {
+      res = -1;
+    }
+  }
+  printf("%s\n", (res < 0) ? "  slower than the source" : "");
+  free(p_data->p_data);
+  p_data->p_data = NULL;
+
+  return res;
+}
+
+/***********************************************************************
+ * @fn      bench_config
+ *
+ * @brief   Blocks of the records to the sink, again and again for about
+ *          BENCH_TIME.
+ *
+ * @param   p_data
+ *          p_config
+ *
+ * @return  Samples per second, 0 on error
+ **/
+double bench_config(bench_data_t *p_data, const bench_config_t *p_config)
+{
+  acq_format_t *p_fmt = &p_data->fmt;
+  acq_sink_t *p_sink = sink_spectrum_create("/dev/null", 0);
+  acq_block_t block;
+  uint64_t samples = 0;
+  double t0 = 0;
+  double t = 0;
+  uint32_t n = 0;
+
+  if ( p_sink == NULL || sink_spectrum_configure(p_sink, p_config->opt, p_config->num_opts) < 0 ||
+       acq_sink_open(&p_sink, 1, p_fmt) < 0 )
+  {
+    acq_sink_destroy(p_sink);
+    return 0;
+  }
+
+  memset(&block, 0, sizeof(block));
+  t0 = now_seconds();
+  do
+  {
+    for ( n = 0; n < p_data->num_records; n += BENCH_BLOCK )
+    {
+      block.num_records = (p_data->num_records - n > BENCH_BLOCK) ? BENCH_BLOCK : p_data->num_records - n;
+      block.p_data[0]   = p_data->p_data + (size_t)n * p_fmt->record_size;
+      acq_sink_write(&p_sink, 1, &block);
+      block.seq++;
+    }
+    samples += p_data->num_records;
+    t = now_seconds() - t0;
+  } while ( t < BENCH_TIME );
+
+  acq_sink_close(&p_sink, 1);
+  acq_sink_destroy(p_sink);
+
+  return samples / t;
+}
+
+/***********************************************************************
+ * @fn      make_adc
+ *
+ * @brief   AM335x ADC at 1600000 Hz, 16-bit records: a 1 kHz tone and
+ *          its harmonics with a few codes of noise.
+ *
+ * @param   p_data
+ *
+ * @return  void
+ **/
+void make_adc(bench_data_t *p_data)
+{
+  uint16_t code = 0;
+  uint32_t n = 0;
+
+  memset(p_data, 0, sizeof(bench_data_t));
+  p_data->name              = "pru_adc";
+  p_data->fmt.encoding      = ACQ_ENC_U16;
+  p_data->fmt.record_size   = sizeof(uint16_t);
+  p_data->fmt.record_values = 1;
+  p_data->fmt.decimation    = 1;
+  p_data->fmt.num_streams   = 1;
+  p_data->fmt.sample_rate   = ADC_TOP_RATE;
+  p_data->p_data            = malloc((size_t)BENCH_RECORDS * p_data->fmt.record_size);
+  if ( p_data->p_data == NULL )
+  {
+    perror("malloc(bench)");
+    return;
+  }
+  p_data->num_records = BENCH_RECORDS;
+
+  for ( n = 0; n < BENCH_RECORDS; n++ )
+  {
+    code = 2048 + 1200 * sin(2 * M_PI * 1000.0 * n / ADC_TOP_RATE) + 200 * sin(2 * M_PI * 3000.0 * n / ADC_TOP_RATE) +
+           noise(3);
+    memcpy(p_data->p_data + n * sizeof(uint16_t), &code, sizeof(uint16_t));
+  }
+}
+
+/***********************************************************************
+ * @fn      make_ads
+ *
+ * @brief   ADS1256 at 30000 SPS cycled through 8 channels, packed
+ *          records: 50 Hz harmonics with noise.
+ *
+ * @param   p_data
+ *
+ * @return  void
+ **/
+void make_ads(bench_data_t *p_data)
+{
+  uint32_t chan = 0;
+  int32_t code = 0;
+  uint32_t n = 0;
+
+  memset(p_data, 0, sizeof(bench_data_t));
+  p_data->name                = "ads1256 8 ch";
+  p_data->fmt.encoding        = ACQ_ENC_S24_PACKED;
+  p_data->fmt.record_size     = 3;
+  p_data->fmt.record_values   = 1;
+  p_data->fmt.decimation      = 1;
+  p_data->fmt.num_streams     = 1;
+  p_data->fmt.num_channels[0] = 8;
+  p_data->fmt.sample_rate     = 30000.0;
+  p_data->p_data              = malloc((size_t)BENCH_RECORDS * p_data->fmt.record_size);
+  if ( p_data->p_data == NULL )
+  {
+    perror("malloc(bench)");
+    return;
+  }
+  p_data->num_records = BENCH_RECORDS;
+
+  for ( n = 0; n < BENCH_RECORDS; n++ )
+  {
+    chan = n % 8;
+    code = 400000 * (chan + 1) * sin(2 * M_PI * 50 * (chan + 1) * (double)(n / 8) / (30000.0 / 8)) + noise(40);
+    p_data->p_data[3 * n]     = code;
+    p_data->p_data[3 * n + 1] = code >> 8;
+    p_data->p_data[3 * n + 2] = code >> 16;
+  }
+}
+
+/***********************************************************************
+ * @fn      make_signal
+ *
+ * @brief   NUM_TONES tones over an offset, with noise.
+ *
+ * @param   p_x
+ *          num_values
+ *
+ * @return  void
+ **/
+void make_signal(float *p_x, uint32_t num_values)
+{
+  uint32_t n = 0;
+  uint32_t i = 0;
+
+  for ( n = 0; n < num_values; n++ )
+  {
+    p_x[n] = 2048 + noise(3);
+    for ( i = 1; i <= NUM_TONES; i++ )
+    {
+      p_x[n] += 1000.0 / i * sin(2 * M_PI * (17.3 * i) * n / num_values + i);
+    }
+  }
+}
+
+/***********************************************************************
+ * @fn      noise
+ *
+ * @brief   Triangular noise, xorshift32.
+ *
+ * @param   amplitude
+ *
+ * @return  -amplitude to amplitude
+ **/
+int32_t noise(int32_t amplitude)
+{
+  int32_t sum = 0;
+  int i = 0;
+
+  for ( i = 0; i < 2; i++ )
+  {
+    SEED ^= SEED << 13;
+    SEED ^= SEED >> 17;
+    SEED ^= SEED << 5;
+    sum += (int32_t)(SEED % (amplitude + 1));
+  }
+
+  return sum - amplitude;
+}
+
+/***********************************************************************
+ * @fn      now_seconds
+ *
+ * @brief
+ *
+ * @param   void
+ *
+ * @return  CLOCK_MONOTONIC, s
+ **/
+double now_seconds(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
@@ -0,0 +1,292 @@
+/***********************************************************************
+ * INCLUDES
+ **/
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+#include "acq.h"
+
+/***********************************************************************
+ * DEFINES
+ **/
+#define PACKED_PAIR_SIZE    3
+#define PACKED_S24_SIZE     3
+#define TAGGED_CHAN(s)      ((s) >> 24)
+#define TAGGED_DATA(s)      ((int32_t)((s) << 8) >> 8)
+#define DECODE_CHUNK        256
+
+/***********************************************************************
+ * PRIVATE FUNCTIONS PROTOTYPES
+ **/
+static void samples_to_volts(const int32_t *p_src, float *p_dst, uint32_t num_values, float lsb);
+
+/***********************************************************************
+ * FUNCTIONS
+ **/
+/***********************************************************************
+ * @fn      acq_decode
+ *
+ * @brief   Records of one stream, as the source stores them, to codes
+ *          and their channel index. Envelope records decode to their
+ *          mean. Untagged records take their channel from the order of
+ *          the stream's channel list.
+ *
+ * @param   p_fmt
+ *          stream
+ *          p_data - Record holding the first value
+ *          first - Index of the first value among those of 'stream'
+ *          num_values - Whole records
+ *          p_code
+ *          p_chan - NULL: not needed
+ *
+ * @return  void
+ **/
+void acq_decode(const acq_format_t *p_fmt, uint32_t stream, const uint8_t *p_data, uint64_t first,
+                uint32_t num_values, int32_t *p_code, uint8_t *p_chan)
+{
+  uint32_t num_channels = p_fmt->num_channels[stream];
+  uint16_t chunk[DECODE_CHUNK];
+  uint32_t i = 0;
+  uint32_t n = 0;
+
+  switch ( p_fmt->encoding )
+  {
+    case ACQ_ENC_U16:
+      for ( i = 0; i < num_values; i++ )
+      {
+        uint16_t v = 0;
+        memcpy(&v, p_data + i * sizeof(uint16_t), sizeof(v));
+        p_code[i] = v;
+      }
+      break;
+
+    case ACQ_ENC_U12_PAIR:
+      for ( n = 0; n < num_values; n += DECODE_CHUNK )
+      {
+        uint32_t len = (num_values - n > DECODE_CHUNK) ? DECODE_CHUNK : num_values - n;
+
+        acq_unpack_u12(p_data + n / 2 * PACKED_PAIR_SIZE, chunk, len);
+        for ( i = 0; i < len; i++ )
+        {
+          p_code[n + i] = chunk[i];
+        }
+      }
+      break;
+
+    case ACQ_ENC_U16_ENV:
+      for ( i = 0; i < num_values; i++ )
+      {
+        uint16_t rec[4];
+        memcpy(rec, p_data + i * sizeof(rec), sizeof(rec));
+        p_code[i] = rec[2];
+      }
+      break;
+
+    case ACQ_ENC_S24_TAGGED:
+      for ( i = 0; i < num_values; i++ )
+      {
+        uint32_t word = 0;
+        memcpy(&word, p_data + i * sizeof(uint32_t), sizeof(word));
+        p_code[i] = TAGGED_DATA(word);
+        if ( p_chan != NULL )
+        {
+          p_chan[i] = TAGGED_CHAN(word);
+        }
+      }
+      return;
+
+    case ACQ_ENC_S24_PACKED:
+      acq_unpack_s24(p_data, p_code, num_values);
+      break;
+  }
+
+  if ( p_chan == NULL )
+  {
+    return;
+  }
+  for ( i = 0; i < num_values; i++ )
+  {
+    p_chan[i] = (num_channels > 1) ? (first + i) % num_channels : 0;
+  }
+}
+
+/***********************************************************************
+ * @fn      acq_to_volts
+ *
+ * @brief   Codes of one stream to volts, with the LSB of their channel.
+ *
+ * @param   p_fmt
+ *          stream
+ *          p_code
+ *          p_chan
+ *          p_volts
+ *          num_values
+ *
+ * @return  void
+ **/
+void acq_to_volts(const acq_format_t *p_fmt, uint32_t stream, const int32_t *p_code, const uint8_t *p_chan,
+                  float *p_volts, uint32_t num_values)
+{
+  uint32_t i = 0;
+
+  if ( p_fmt->num_channels[stream] > 1 )
+  {
+    for ( i = 0; i < num_values; i++ )
+    {
+      p_volts[i] = p_code[i] * p_fmt->lsb[stream][p_chan[i] % ACQ_MAX_CHANNELS];
+    }
+    return;
+  }
+
+  samples_to_volts(p_code, p_volts, num_values, p_fmt->lsb[stream][0]);
+}
+
+/***********************************************************************
+ * @fn      acq_unpack_s24
+ *
+ * @brief   Packed 24-bit little endian samples to sign extended int32.
+ *          With NEON 16 samples per round (vld3q splits the low, middle
+ *          and high bytes, the high byte is widened signed), then 4
+ *          samples from 12 bytes with three word loads, then single
+ *          samples.
+ *
+ * @param   p_src
+ *          p_dst
+ *          num_values
+ *
+ * @return  void
+ **/
+void acq_unpack_s24(const uint8_t *p_src, int32_t *p_dst, uint32_t num_values)
+{
+  uint32_t i = 0;
+
+#if defined(__ARM_NEON)
+  for ( ; i + 16 <= num_values; i += 16 )
+  {
+    uint8x16x3_t b = vld3q_u8(p_src + i * PACKED_S24_SIZE);
+    uint16x8_t lo_l = vorrq_u16(vmovl_u8(vget_low_u8(b.val[0])), vshlq_n_u16(vmovl_u8(vget_low_u8(b.val[1])), 8));
+    uint16x8_t lo_h = vorrq_u16(vmovl_u8(vget_high_u8(b.val[0])), vshlq_n_u16(vmovl_u8(vget_high_u8(b.val[1])), 8));
+    int16x8_t  hi_l = vmovl_s8(vreinterpret_s8_u8(vget_low_u8(b.val[2])));
+    int16x8_t  hi_h = vmovl_s8(vreinterpret_s8_u8(vget_high_u8(b.val[2])));
+
+    vst1q_s32(p_dst + i + 0,  vorrq_s32(vshlq_n_s32(vmovl_s16(vget_low_s16(hi_l)), 16),
+                                        vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(lo_l)))));
+    vst1q_s32(p_dst + i + 4,  vorrq_s32(vshlq_n_s32(vmovl_s16(vget_high_s16(hi_l)), 16),
+                                        vreinterpretq_s32_u32(vmovl_u16(vget_high_u16(lo_l)))));
+    vst1q_s32(p_dst + i + 8,  vorrq_s32(vshlq_n_s32(vmovl_s16(vget_low_s16(hi_h)), 16),
+                                        vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(lo_h)))));
+    vst1q_s32(p_dst + i + 12, vorrq_s32(vshlq_n_s32(vmovl_s16(vget_high_s16(hi_h)), 16),
+                                        vreinterpretq_s32_u32(vmovl_u16(vget_high_u16(lo_h)))));
+  }
+#endif
+
+  for ( ; i + 4 <= num_values; i += 4 )
+  {
+    const uint8_t *p = p_src + i * PACKED_S24_SIZE;
+    uint32_t w[3];
+
+    memcpy(w, p, sizeof(w));
+    p_dst[i + 0] = (int32_t)(w[0] << 8) >> 8;
+    p_dst[i + 1] = (int32_t)((w[0] >> 16) | (w[1] << 16)) >> 8;
+    p_dst[i + 2] = (int32_t)((w[1] >> 8) | (w[2] << 24)) >> 8;
+    p_dst[i + 3] = (int32_t)w[2] >> 8;
+  }
+
+  for ( ; i < num_values; i++ )
+  {
+    const uint8_t *p = p_src + i * PACKED_S24_SIZE;
+
+    p_dst[i] = (int32_t)(((uint32_t)p[0] << 8) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 24)) >> 8;
+  }
+}
+
+/***********************************************************************
+ * @fn      acq_unpack_u12
+ *
+ * @brief   Unpack 12-bit samples stored in pairs of 3 bytes, a | b << 12.
+ *          With NEON 16 samples per round (vld3 splits the pair bytes,
+ *          vst2 interleaves the samples back), then 8 samples from 12
+ *          bytes with two word loads, then single pairs.
+ *
+ * @param   p_src
+ *          p_dst
+ *          num_values - Even
+ *
+ * @return  void
+ **/
+void acq_unpack_u12(const uint8_t *p_src, uint16_t *p_dst, uint32_t num_values)
+{
+  uint32_t i = 0;
+
+#if defined(__ARM_NEON)
+  const uint8x8_t low_nibble = vdup_n_u8(0x0F);
+
+  for ( ; i + 16 <= num_values; i += 16 )
+  {
+    uint8x8x3_t b = vld3_u8(p_src + i / 2 * PACKED_PAIR_SIZE);
+    uint16x8x2_t v;
+
+    v.val[0] = vorrq_u16(vmovl_u8(b.val[0]), vshlq_n_u16(vmovl_u8(vand_u8(b.val[1], low_nibble)), 8));
+    v.val[1] = vorrq_u16(vmovl_u8(vshr_n_u8(b.val[1], 4)), vshlq_n_u16(vmovl_u8(b.val[2]), 4));
+    vst2q_u16(p_dst + i, v);
+  }
+#endif
+
+  for ( ; i + 8 <= num_values; i += 8 )
+  {
+    const uint8_t *p = p_src + i / 2 * PACKED_PAIR_SIZE;
+    uint64_t lo = 0;
+    uint32_t hi = 0;
+
+    memcpy(&lo, p, sizeof(lo));
+    memcpy(&hi, p + sizeof(lo), sizeof(hi));
+    p_dst[i + 0] = lo & 0xFFF;
+    p_dst[i + 1] = (lo >> 12) & 0xFFF;
+    p_dst[i + 2] = (lo >> 24) & 0xFFF;
+    p_dst[i + 3] = (lo >> 36) & 0xFFF;
+    p_dst[i + 4] = (lo >> 48) & 0xFFF;
+    p_dst[i + 5] = ((lo >> 60) | (hi << 4)) & 0xFFF;
+    p_dst[i + 6] = (hi >> 8) & 0xFFF;
+    p_dst[i + 7] = (hi >> 20) & 0xFFF;
+  }
+
+  for ( ; i + 2 <= num_values; i += 2 )
+  {
+    const uint8_t *p = p_src + i / 2 * PACKED_PAIR_SIZE;
+
+    p_dst[i + 0] = p[0] | ((p[1] & 0x0F) << 8);
+    p_dst[i + 1] = (p[1] >> 4) | (p[2] << 4);
+  }
+}
+
+/***********************************************************************
+ * @fn      samples_to_volts
+ *
+ * @brief   Conversion codes to volts, 4 per round with NEON.
+ *
+ * @param   p_src
+ *          p_dst
+ *          num_values
+ *          lsb - Volts per code
+ *
+ * @return  void
+ **/
+static void samples_to_volts(const int32_t *p_src, float *p_dst, uint32_t num_values, float lsb)
+{
+  uint32_t i = 0;
+
+#if defined(__ARM_NEON)
+  for ( ; i + 4 <= num_values; i += 4 )
+  {
+    vst1q_f32(p_dst + i, vmulq_n_f32(vcvtq_f32_s32(vld1q_s32(p_src + i)), lsb));
+  }
+#endif
+
+  for ( ; i < num_values; i++ )
+  {
+    p_dst[i] = p_src[i] * lsb;
+  }
+}
@@ -0,0 +1,310 @@
+/***********************************************************************
+ * INCLUDES
+ **/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include "acq.h"
+#include "metrics.h"
+
+/***********************************************************************
+ * DEFINES
+ **/
+#define DEF_UPDATES       10000000
+#define DEF_THREADS       4
+#define MAX_THREADS       16
+#define SCRAPES           1000
+
+/* What each thread of a run does */
+#define OP_PLAIN          0         /* Non-atomic increment, for reference */
+#define OP_MUTEX          1         /* Increment under a mutex */
+#define OP_INC            2
+#define OP_INC_OWN        3         /* Each thread its own counter */
+#define OP_SET            4
+#define OP_OBSERVE        5
+
+/***********************************************************************
+ * TYPEDEFS
+ **/
+typedef struct bench_thread_t
+{
+  pthread_t thread;
+  int       op;
+  uint32_t  index;
+  uint64_t  updates;
+  double    seconds;
+} bench_thread_t;
+
+/***********************************************************************
+ * GLOBALS
+ **/
+METRIC_COUNTER(BENCH_COUNTER, "bench_updates_total", "Updates of the benchmark");
+METRIC_GAUGE(BENCH_GAUGE, "bench_value", "Gauge of the benchmark");
+METRIC_HISTOGRAM(BENCH_HISTOGRAM, "bench_latency_seconds", "Histogram of the benchmark", 1e-9,
+                 100000, 250000, 500000, 1000000, 2500000, 5000000, 10000000, 25000000, 50000000, 100000000);
+METRIC_COUNTER(BENCH_OWN0, "bench_own0_total", "Counter of thread 0");
+METRIC_COUNTER(BENCH_OWN1, "bench_own1_total", "Counter of thread 1");
+METRIC_COUNTER(BENCH_OWN2, "bench_own2_total", "Counter of thread 2");
+METRIC_COUNTER(BENCH_OWN3, "bench_own3_total", "Counter of thread 3");
+
+static metric_t *OWN[] = {&BENCH_OWN0, &BENCH_OWN1, &BENCH_OWN2, &BENCH_OWN3};
+static volatile uint64_t PLAIN = 0;
+static uint64_t LOCKED = 0;
+static pthread_mutex_t LOCK = PTHREAD_MUTEX_INITIALIZER;
+static int SCRAPING = 0;
+
+/***********************************************************************
+ * LOCAL FUNCTIONS PROTOTYPES
+ **/
+double bench_updates(int op, uint32_t num_threads, uint64_t updates);
+double bench_scrape(double *p_update_ns, size_t *p_bytes);
+void  *bench_main(void *p_arg);
+void  *bench_scrape_main(void *p_arg);
+double thread_seconds(void);
+
+/***********************************************************************
+ * MAIN
+ **/
+int main(int argc, char *argv[])
+{
+  uint64_t updates = DEF_UPDATES;
+  uint32_t num_threads = DEF_THREADS;
+  double update_ns = 0;
+  double scrape_us = 0;
+  size_t bytes = 0;
+  int c = 0;
+
+  while ( (c = getopt(argc, argv, "n:t:")) != -1 )
+  {
+    switch ( c )
+    {
+      case 'n':
+        updates = strtoull(optarg, NULL, 10);
+        break;
+      case 't':
+        num_threads = strtoul(optarg, NULL, 10);
+        break;
+      default:
+        printf("Usage: %s [-n UPDATES] [-t THREADS]\n\n", argv[0]);
+        printf("\t-n: Updates per thread (default %d)\n", DEF_UPDATES);
+        printf("\t-t: Threads updating at once (default %d, up to %d)\n\n", DEF_THREADS, MAX_THREADS);
+        return -1;
+    }
+  }
+  if ( updates == 0 || num_threads == 0 || num_threads > MAX_THREADS )
+  {
+    printf("Wrong -n or -t.\n");
+    return -1;
+  }
+
+  printf("%-32s %10s %10s\n", "ns per update", "1 thread", "threads");
+  printf("%-32s %10.2f %10.2f\n", "plain increment (reference)", bench_updates(OP_PLAIN, 1, updates),
+         bench_updates(OP_PLAIN, num_threads, updates));
+  printf("%-32s %10.2f %10.2f\n", "increment under a mutex", bench_updates(OP_MUTEX, 1, updates),
+         bench_updates(OP_MUTEX, num_threads, updates));
+  printf("%-32s %10.2f %10.2f\n", "metric_inc, shared counter", bench_updates(OP_INC, 1, updates),
+         bench_updates(OP_INC, num_threads, updates));
+  printf("%-32s %10.2f %10.2f\n", "metric_inc, counter per thread", bench_updates(OP_INC_OWN, 1, updates),
+         bench_updates(OP_INC_OWN, (num_threads < 4) ? num_threads : 4, updates));
+  printf("%-32s %10.2f %10.2f\n", "metric_set", bench_updates(OP_SET, 1, updates),
+         bench_updates(OP_SET, num_threads, updates));
+  printf("%-32s %10.2f %10.2f\n", "metric_observe", bench_updates(OP_OBSERVE, 1, updates),
+         bench_updates(OP_OBSERVE, num_threads, updates));
+
+  scrape_us = bench_scrape(&update_ns, &bytes);
+  printf("\nScrape: %.1f us for %zu bytes; metric_inc meanwhile %.2f ns\n", scrape_us, bytes, update_ns);
+
+  return 0;
+}
+
+/***********************************************************************
+ * LOCAL FUNCTIONS
+ **/
+/***********************************************************************
+ * @fn      bench_updates
+ *
+ * @brief   Threads updating at once, each 'updates' times. Each one
+ *          times itself by its CPU time, so the cost is the same on one
+ *          core (the BeagleBone) as on several.
+ *
+ * @param   op - OP_...
+ *          num_threads
+ *          updates
+ *
+ * @return  ns per update, the mean of the threads
+ **/
+double bench_updates(int op, uint32_t num_threads, uint64_t updates)
+{
+  bench_thread_t thread[MAX_THREADS];
+  double seconds = 0;
+  uint32_t i = 0;
+
+  for ( i = 0; i < num_threads; i++ )
+  {
+    thread[i].op      = op;
+    thread[i].index   = i;
+    thread[i].updates = updates;
+    thread[i].seconds = 0;
+    if ( pthread_create(&thread[i].thread, NULL, bench_main, &thread[i]) != 0 )
+    {
+      perror("pthread_create()");
+      exit(-1);
+    }
+  }
+  for ( i = 0; i < num_threads; i++ )
+  {
+    pthread_join(thread[i].thread, NULL);
+    seconds += thread[i].seconds;
+  }
+
+  return seconds / num_threads / updates * 1e9;
+}
+
+/***********************************************************************
+ * @fn      bench_scrape
+ *
+ * @brief   Scrapes in a row, as metrics_serve() does them, while a
+ *          thread goes on incrementing.
+ *
+ * @param   p_update_ns - ns per metric_inc meanwhile
+ *          p_bytes - Of a scrape
+ *
+ * @return  us per scrape
+ **/
+double bench_scrape(double *p_update_ns, size_t *p_bytes)
+{
+  bench_thread_t inc;
+  char *p_body = NULL;
+  size_t len = 0;
+  double t0 = 0;
+  double t1 = 0;
+  uint32_t i = 0;
+  FILE *fp = NULL;
+
+  memset(&inc, 0, sizeof(inc));
+  __atomic_store_n(&SCRAPING, 1, __ATOMIC_RELAXED);
+  if ( pthread_create(&inc.thread, NULL, bench_scrape_main, &inc) != 0 )
+  {
+    perror("pthread_create()");
+    exit(-1);
+  }
+
+  t0 = thread_seconds();
+  for ( i = 0; i < SCRAPES; i++ )
+  {
+    fp = open_memstream(&p_body, &len);
+    if ( fp == NULL )
+    {
+      perror("open_memstream()");
+      exit(-1);
+    }
+    metrics_write(fp);
+    fclose(fp);
+    free(p_body);
+  }
+  t1 = thread_seconds();
+
+  __atomic_store_n(&SCRAPING, 0, __ATOMIC_RELAXED);
+  pthread_join(inc.thread, NULL);
+  *p_update_ns = (inc.updates > 0) ? inc.seconds / inc.updates * 1e9 : 0;
+  *p_bytes     = len;
+
+  return (t1 - t0) / SCRAPES * 1e6;
+}
+
+/***********************************************************************
+ * @fn      bench_main
+ *
+ * @brief   Updating thread.
+ *
+ * @param   p_arg - Thread
+ *
+ * @return  NULL
+ **/
+void *bench_main(void *p_arg)
+{
+  bench_thread_t *p_thread = (bench_thread_t *)p_arg;
+  metric_t *p_own = OWN[p_thread->index % 4];
+  uint64_t n = 0;
+  double t0 = thread_seconds();
+
+  for ( n = 0; n < p_thread->updates; n++ )
+  {
+    switch ( p_thread->op )
+    {
+      case OP_PLAIN:
+        PLAIN++;
+        break;
+      case OP_MUTEX:
+        pthread_mutex_lock(&LOCK);
+        LOCKED++;
+        pthread_mutex_unlock(&LOCK);
+        break;
+      case OP_INC:
+        metric_inc(&BENCH_COUNTER);
+        break;
+      case OP_INC_OWN:
+        metric_inc(p_own);
+        break;
+      case OP_SET:
+        metric_set(&BENCH_GAUGE, (double)n);
+        break;
+      case OP_OBSERVE:
+        metric_observe(&BENCH_HISTOGRAM, (n & 0xFFFF) * 1000);
+        break;
+    }
+  }
+  p_thread->seconds = thread_seconds() - t0;
+
+  return NULL;
+}
+
+/***********************************************************************
+ * @fn      bench_scrape_main
+ *
+ * @brief   Incrementing thread, until the scrapes are over.
+ *
+ * @param   p_arg - Thread, 'updates' counted
+ *
+ * @return  NULL
+ **/
+void *bench_scrape_main(void *p_arg)
+{
+  bench_thread_t *p_thread = (bench_thread_t *)p_arg;
+  double t0 = thread_seconds();
+  uint32_t i = 0;
+
+  while ( __atomic_load_n(&SCRAPING, __ATOMIC_RELAXED) )
+  {
+    for ( i = 0; i < 1000; i++ )
+    {
+      metric_inc(&BENCH_COUNTER);
+    }
+    p_thread->updates += 1000;
+  }
+  p_thread->seconds = thread_seconds() - t0;
+
+  return NULL;
+}
+
+/***********************************************************************
+ * @fn      thread_seconds
+ *
+ * @brief
+ *
+ * @param   void
+ *
+ * @return  CPU time of the calling thread, s
+ **/
+double thread_seconds(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
@@ -0,0 +1,439 @@
+/***********************************************************************
+ * INCLUDES
+ **/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <signal.h>
+#include <pthread.h>
+#include <time.h>
+#include "acq.h"
+#include "acq_net.h"
+
+/***********************************************************************
+ * DEFINES
+ **/
+#define BENCH_SHM         "acq_net_bench"
+#define BENCH_SOCKET      "/tmp/acq_net_bench.sock"
+#define BENCH_PORT        7451
+#define DEF_RATE          1600000   /* pru_adc top rate */
+#define DEF_BLOCK         1000
+#define DEF_SECONDS       5
+#define DEF_CLIENTS       4
+#define MAX_CLIENTS       24
+#define SLOW_EVERY        10        /* Frames the slow client takes between naps */
+#define SLOW_NAP_MS       50
+#define MAX_FRAME         (1 << 20)
+
+/***********************************************************************
+ * TYPEDEFS
+ **/
+typedef struct client_t
+{
+  pthread_t   thread;
+  const char *name;
+  const char *options;      /* Line sent to the server */
+  int         tcp;
+  int         slow;
+  uint64_t    frames;
+  uint64_t    bytes;
+  uint64_t    lost;
+  uint64_t    bad;          /* Raw frames with records other than published */
+  uint32_t   *p_lat;        /* Microseconds from the block stamp to the frame read */
+  uint32_t    max_lat;
+  double      seconds;
+  int         res;
+} client_t;
+
+/***********************************************************************
+ * GLOBALS
+ **/
+static uint32_t BLOCK = DEF_BLOCK;
+
+/***********************************************************************
+ * LOCAL FUNCTIONS PROTOTYPES
+ **/
+void *server_thread(void *p_arg);
+void *client_thread(void *p_arg);
+int   produce(acq_sink_t *p_sink, double rate, uint32_t seconds);
+void  report(client_t *p_cl, uint32_t num_clients);
+int   cmp_u32(const void *p_a, const void *p_b);
+uint16_t ramp(uint64_t n);
+
+/***********************************************************************
+ * MAIN
+ **/
+int main(int argc, char *argv[])
+{
+  client_t client[MAX_CLIENTS];
+  acq_server_t *p_srv = NULL;
+  acq_sink_t *p_sink = NULL;
+  pthread_t server;
+  double rate = DEF_RATE;
+  uint32_t seconds = DEF_SECONDS;
+  uint32_t num_fast = DEF_CLIENTS;
+  uint32_t num_clients = 0;
+  uint32_t i = 0;
+  int res = 0;
+  int c = 0;
+
+  while ( (c = getopt(argc, argv, "r:b:d:c:")) != -1 )
+  {
+    switch ( c )
+    {
+      case 'r':
+        rate = atof(optarg);
+        break;
+      case 'b':
+        BLOCK = strtoul(optarg, NULL, 10);
+        break;
+      case 'd':
+        seconds = strtoul(optarg, NULL, 10);
+        break;
+      case 'c':
+        num_fast = strtoul(optarg, NULL, 10);
+        break;
+      default:
+        printf("Usage: %s [-r SAMPLES/S] [-b BLOCK_SAMPLES] [-d SECONDS] [-c CLIENTS]\n\n", argv[0]);
+        printf("\tPublishes a synthetic pru_adc capture and serves it to CLIENTS\n");
+        printf("\tsubscribers of the blocks as published (half Unix, half TCP),\n");
+        printf("\ttwo filtered ones and a slow one; prints their rates, missed\n");
+        printf("\tblocks and the latency from the block stamp to the frame read\n\n");
+        return -1;
+    }
+  }
+  if ( rate <= 0 || BLOCK == 0 || BLOCK * sizeof(uint16_t) > MAX_FRAME || seconds == 0 ||
+       num_fast + 3 > MAX_CLIENTS )
+  {
+    printf("Wrong settings.\n");
+    return -1;
+  }
+  signal(SIGPIPE, SIG_IGN);
+
+  /* Segment first, the server attaches to it */
+  p_sink = sink_shm_create(BENCH_SHM);
+  if ( p_sink == NULL )
+  {
+    return -1;
+  }
+  {
+    acq_format_t fmt;
+
+    memset(&fmt, 0, sizeof(fmt));
+    fmt.encoding        = ACQ_ENC_U16;
+    fmt.record_size     = sizeof(uint16_t);
+    fmt.record_values   = 1;
+    fmt.decimation      = 1;
+    fmt.num_streams     = 1;
+    fmt.num_channels[0] = 1;
+    fmt.lsb[0][0]       = 1.8 / 4096;
+    fmt.sample_rate     = rate;
+    fmt.clock_hz        = 1e9;
+    if ( acq_sink_open(&p_sink, 1, &fmt) < 0 )
+    {
+      acq_sink_destroy(p_sink);
+      return -1;
+    }
+  }
+
+  p_srv = acq_server_open(BENCH_SHM, BENCH_SOCKET, BENCH_PORT);
+  if ( p_srv == NULL || pthread_create(&server, NULL, server_thread, p_srv) != 0 )
+  {
+    if ( p_srv != NULL )
+    {
+      acq_server_close(p_srv);
+    }
+    acq_sink_close(&p_sink, 1);
+    acq_sink_destroy(p_sink);
+    return -1;
+  }
+
+  memset(client, 0, sizeof(client));
+  for ( i = 0; i < num_fast; i++ )
+  {
+    client[num_clients].name    = (i % 2) ? "raw tcp" : "raw unix";
+    client[num_clients].options = "";
+    client[num_clients++].tcp   = i % 2;
+  }
+  client[num_clients].name      = "decimate=16 unix";
+  client[num_clients++].options = "decimate=16";
+  client[num_clients].name      = "decimate=100 tcp";
+  client[num_clients].options   = "channels=0 decimate=100";
+  client[num_clients++].tcp     = 1;
+  client[num_clients].name      = "raw slow";
+  client[num_clients].options   = "";
+  client[num_clients++].slow    = 1;
+
+  for ( i = 0; i < num_clients; i++ )
+  {
+    client[i].p_lat = malloc(((uint64_t)(rate * seconds / BLOCK) + 16) * sizeof(uint32_t));
+    if ( client[i].p_lat == NULL || pthread_create(&client[i].thread, NULL, client_thread, &client[i]) != 0 )
+    {
+      client[i].res = -1;
+      num_clients = i;
+      res = -1;
+      break;
+    }
+  }
+
+  /* Subscribed once the server has taken their options */
+  usleep(300000);
+  printf("Publishing %.0f samples/s in blocks of %u for %u s to %u subscribers...\n\n", rate, BLOCK, seconds,
+         num_clients);
+  if ( res == 0 )
+  {
+    res = produce(p_sink, rate, seconds);
+  }
+  acq_sink_close(&p_sink, 1);
+
+  for ( i = 0; i < num_clients; i++ )
+  {
+    pthread_join(client[i].thread, NULL);
+  }
+  pthread_join(server, NULL);
+  acq_server_close(p_srv);
+  acq_sink_destroy(p_sink);
+
+  report(client, num_clients);
+  for ( i = 0; i < num_clients; i++ )
+  {
+    /* Only the slow client may miss blocks */
+    if ( client[i].res < 0 || client[i].bad != 0 || (!client[i].slow && client[i].lost != 0) ||
+         client[i].frames == 0 )
+    {
+      res = -1;
+    }
+    free(client[i].p_lat);
+  }
+
+  return (res < 0) ? -1 : 0;
+}
+
+/***********************************************************************
+ * LOCAL FUNCTIONS
+ **/
+/***********************************************************************
+ * @fn      server_thread
+ *
+ * @brief
+ *
+ * @param   p_arg - Server
+ *
+ * @return  NULL
+ **/
+void *server_thread(void *p_arg)
+{
+  acq_server_run((acq_server_t *)p_arg, NULL);
+
+  return NULL;
+}
+
+/***********************************************************************
+ * @fn      client_thread
+ *
+ * @brief   Subscriber: reads frames until the capture ends, checks the
+ *          raw ones and keeps the latency of each.
+ *
+ * @param   p_arg - Client
+ *
+ * @return  NULL
+ **/
+void *client_thread(void *p_arg)
+{
+  client_t *p_cl = (client_t *)p_arg;
+  acq_net_hello_t hello;
+  acq_net_frame_t frame;
+  struct timespec t0;
+  struct timespec now;
+  struct timespec stamp;
+  uint8_t *p_data = malloc(MAX_FRAME);
+  uint16_t first = 0;
+  uint16_t last = 0;
+  double lat = 0;
+  int fd = -1;
+  int res = 0;
+
+  fd = p_cl->tcp ? acq_net_connect(NULL, "localhost", BENCH_PORT) : acq_net_connect(BENCH_SOCKET, NULL, 0);
+  if ( p_data == NULL || fd < 0 || acq_net_subscribe(fd, p_cl->options, &hello) < 0 )
+  {
+    p_cl->res = -1;
+    free(p_data);
+    if ( fd >= 0 )
+    {
+      close(fd);
+    }
+    return NULL;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  while ( (res = acq_net_read_frame(fd, &frame, p_data, MAX_FRAME)) > 0 )
+  {
+    clock_gettime(CLOCK_REALTIME, &now);
+    stamp.tv_sec  = frame.real_sec;
+    stamp.tv_nsec = frame.real_nsec;
+    lat = timespec_diff(&now, &stamp) * 1e6;
+    p_cl->p_lat[p_cl->frames] = (lat < 0) ? 0 : (uint32_t)lat;
+    if ( p_cl->p_lat[p_cl->frames] > p_cl->max_lat )
+    {
+      p_cl->max_lat = p_cl->p_lat[p_cl->frames];
+    }
+    p_cl->frames++;
+    p_cl->bytes += sizeof(frame) + frame.bytes;
+    p_cl->lost  += frame.lost;
+
+    if ( hello.fmt.encoding == ACQ_ENC_U16 && frame.num_records > 0 )
+    {
+      memcpy(&first, p_data, sizeof(first));
+      memcpy(&last, p_data + frame.bytes - sizeof(last), sizeof(last));
+      if ( frame.bytes != frame.num_records * sizeof(uint16_t) || first != ramp((uint64_t)frame.seq * BLOCK) ||
+           last != ramp((uint64_t)frame.seq * BLOCK + frame.num_records - 1) )
+      {
+        p_cl->bad++;
+      }
+    }
+
+    if ( p_cl->slow && p_cl->frames % SLOW_EVERY == 0 )
+    {
+      usleep(SLOW_NAP_MS * 1000);
+    }
+  }
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  p_cl->seconds = timespec_diff(&now, &t0);
+  p_cl->res = res;
+
+  close(fd);
+  free(p_data);
+
+  return NULL;
+}
+
+/***********************************************************************
+ * @fn      produce
+ *
+ * @brief   Publish a ramp in blocks at the rate, stamped with the time
+ *          each block is due.
+ *
+ * @param   p_sink
+ *          rate
+ *          seconds
+ *
+ * @return  0, -1 on error
+ **/
+int produce(acq_sink_t *p_sink, double rate, uint32_t seconds)
+{
+  uint16_t *p_rec = malloc(BLOCK * sizeof(uint16_t));
+  uint64_t num_blocks = (uint64_t)(rate * seconds / BLOCK);
+  double period = BLOCK / rate;
+  acq_block_t block;
+  struct timespec start;
+  struct timespec due;
+  uint64_t b = 0;
+  uint32_t i = 0;
+  double t = 0;
+
+  if ( p_rec == NULL )
+  {
+    return -1;
+  }
+
+  memset(&block, 0, sizeof(block));
+  block.p_data[0]   = (const uint8_t *)p_rec;
+  block.num_records = BLOCK;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for ( b = 0; b < num_blocks; b++ )
+  {
+    t = (b + 1) * period;
+    due.tv_sec  = start.tv_sec + (time_t)t;
+    due.tv_nsec = start.tv_nsec + (long)((t - (time_t)t) * 1e9);
+    if ( due.tv_nsec >= 1000000000 )
+    {
+      due.tv_sec++;
+      due.tv_nsec -= 1000000000;
+    }
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL);
+
+    for ( i = 0; i < BLOCK; i++ )
+    {
+      p_rec[i] = ramp(b * BLOCK + i);
+    }
+    block.seq    = b;
+    block.cycles = (uint64_t)(t * 1e9);
+    clock_gettime(CLOCK_REALTIME, &block.real);
+    if ( acq_sink_write(&p_sink, 1, &block) < 0 )
+    {
+      free(p_rec);
+      return -1;
+    }
+  }
+  free(p_rec);
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      report
+ *
+ * @brief
+ *
+ * @param   p_cl
+ *          num_clients
+ *
+ * @return  void
+ **/
+void report(client_t *p_cl, uint32_t num_clients)
+{
+  uint32_t i = 0;
+  uint64_t n = 0;
+
+  printf("%-18s %8s %9s %7s %5s %8s %8s %8s %8s\n", "", "frames", "MB/s", "missed", "bad", "p50 us",
+         "p99 us", "p99.9 us", "max us");
+  for ( i = 0; i < num_clients; i++ )
+  {
+    n = p_cl[i].frames;
+    if ( n == 0 )
+    {
+      printf("%-18s %8s\n", p_cl[i].name, "failed");
+      continue;
+    }
+    qsort(p_cl[i].p_lat, n, sizeof(uint32_t), cmp_u32);
+    printf("%-18s %8llu %9.2f %7llu %5llu %8u %8u %8u %8u\n", p_cl[i].name, (unsigned long long)n,
+           (p_cl[i].seconds > 0) ? p_cl[i].bytes / p_cl[i].seconds / 1e6 : 0, (unsigned long long)p_cl[i].lost,
+           (unsigned long long)p_cl[i].bad, p_cl[i].p_lat[n / 2], p_cl[i].p_lat[n * 99 / 100],
+           p_cl[i].p_lat[n * 999 / 1000], p_cl[i].max_lat);
+  }
+  printf("\n");
+}
+
+/***********************************************************************
+ * @fn      cmp_u32
+ *
+ * @brief
+ *
+ * @param   p_a
+ *          p_b
+ *
+ * @return  qsort() order
+ **/
+int cmp_u32(const void *p_a, const void *p_b)
+{
+  uint32_t a = *(const uint32_t *)p_a;
+  uint32_t b = *(const uint32_t *)p_b;
+
+  return (a > b) - (a < b);
+}
+
+/***********************************************************************
+ * @fn      ramp
+ *
+ * @brief   12-bit code of sample n.
+ *
+ * @param   n
+ *
+ * @return  Code
+ **/
+uint16_t ramp(uint64_t n)
+{
+  return (uint16_t)((n * 7) & 0xFFF);
+}
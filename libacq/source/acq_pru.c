@@ -0,0 +1,318 @@
+/***********************************************************************
+ * INCLUDES
+ **/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <poll.h>
+#include <prussdrv.h>
+#include <pruss_intc_mapping.h>
+#include "acq_pru.h"
+#include "trace.h"
+#include "metrics.h"
+
+/***********************************************************************
+ * GLOBALS
+ **/
+METRIC_GAUGE(PRU_RING_BLOCKS, "acq_pru_ring_blocks", "Blocks in the PRU ring");
+METRIC_GAUGE(PRU_RING_PENDING, "acq_pru_ring_pending_blocks", "Blocks completed by the PRU and not read yet");
+
+/***********************************************************************
+ * FUNCTIONS
+ **/
+/***********************************************************************
+ * @fn      get_pru_shared_mem_info
+ *
+ * @brief   Read map1 files and loads size and address of shared mem.
+ *
+ * @param   p_addr
+ *          p_size
+ *
+ * @return
+ **/
+int get_pru_shared_mem_info(uint32_t *p_addr, uint32_t *p_size)
+{
+  unsigned int val = 0;
+  FILE *fp = NULL;
+
+  /* Read addr file */
+  fp = fopen(MMAP1_ADDR_FILE_DIR, "rt");
+  if ( fp == NULL || fscanf(fp, "%x", &val) < 0 )
+  {
+    perror("fscanf(\"" MMAP1_ADDR_FILE_DIR "\")");
+    if ( fp != NULL )
+    {
+      fclose(fp);
+    }
+    return -1;
+  }
+  fclose(fp);
+  *p_addr = val;
+
+  /* Read size file */
+  fp = fopen(MMAP1_SIZE_FILE_DIR, "rt");
+  if ( fp == NULL || fscanf(fp, "%x", &val) < 0 )
+  {
+    perror("fscanf(\"" MMAP1_SIZE_FILE_DIR "\")");
+    if ( fp != NULL )
+    {
+      fclose(fp);
+    }
+    return -1;
+  }
+  fclose(fp);
+  *p_size = val;
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      pru_ack_event
+ *
+ * @brief   Wait for a PRU event and re-arm it.
+ *
+ * @param   void
+ *
+ * @return  void
+ **/
+void pru_ack_event(void)
+{
+  TRACE_BEGIN("pru_ack_event");
+  prussdrv_pru_wait_event(PRU_EVTOUT_0);
+  prussdrv_pru_clear_event(PRU_EVTOUT_0, PRU0_ARM_INTERRUPT);
+  TRACE_END();
+}
+
+/***********************************************************************
+ * @fn      pru_wait_event
+ *
+ * @brief   Wait up to 'timeout_ms' for a PRU event and re-arm it.
+ *
+ * @param   timeout_ms - < 0: no timeout
+ *
+ * @return  1 if an event came, 0 on timeout
+ **/
+int pru_wait_event(int timeout_ms)
+{
+  struct pollfd pfd;
+  int res = 1;
+
+  if ( timeout_ms >= 0 )
+  {
+    TRACE_BEGIN("pru_wait_event");
+    pfd.fd     = prussdrv_pru_event_fd(PRU_EVTOUT_0);
+    pfd.events = POLLIN;
+    res = poll(&pfd, 1, timeout_ms);
+    TRACE_END();
+    if ( res <= 0 )
+    {
+      return 0;
+    }
+  }
+
+  pru_ack_event();
+
+  return 1;
+}
+
+/***********************************************************************
+ * @fn      pru_read_stamp
+ *
+ * @brief   Read a block stamp from the PRU stamps ring.
+ *
+ * @param   p_stamps - Stamps ring
+ *          seq - Block sequence
+ *          p_cycles - PRU cycles at the last sample of the block
+ *          p_status - Block status (ACQ_STATUS_...)
+ *
+ * @return  0 on success, -1 if the entry was already reused
+ **/
+int pru_read_stamp(volatile uint32_t *p_stamps, uint32_t seq, uint64_t *p_cycles, uint32_t *p_status)
+{
+  volatile uint32_t *p_entry = &p_stamps[(seq % STAMP_RING_LEN) * STAMP_WORDS];
+
+  if ( p_entry[STAMP_SEQ] != seq )
+  {
+    return -1;
+  }
+  *p_cycles = ((uint64_t)p_entry[STAMP_CYC_HI] << 32) | p_entry[STAMP_CYC_LO];
+  *p_status = p_entry[STAMP_STATUS];
+
+  /* Rewritten while reading */
+  if ( p_entry[STAMP_SEQ] != seq )
+  {
+    return -1;
+  }
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      pru_ring_init
+ *
+ * @brief   Start following a capture from its first block. The host
+ *          clock fit is anchored now.
+ *
+ * @param   p_ring
+ *          p_stamps - Stamps ring
+ *          ring_blocks - Blocks in the pool
+ *          block_len - Samples per block
+ *          block_cycles - Nominal PRU cycles per block, 0 when the
+ *                         device rate is not known exactly: gaps are
+ *                         checked against the average period so far
+ *
+ * @return  void
+ **/
+void pru_ring_init(pru_ring_t *p_ring, volatile uint32_t *p_stamps, uint32_t ring_blocks, uint32_t block_len,
+                   double block_cycles)
+{
+  memset(p_ring, 0, sizeof(pru_ring_t));
+  p_ring->p_stamps     = p_stamps;
+  p_ring->ring_blocks  = ring_blocks;
+  p_ring->block_len    = block_len;
+  p_ring->block_cycles = block_cycles;
+  clock_fit_init(&p_ring->fit, PRU_CLK_HZ);
+
+  metric_set(&PRU_RING_BLOCKS, ring_blocks);
+  metric_set(&PRU_RING_PENDING, 0);
+}
+
+/***********************************************************************
+ * @fn      pru_ring_update
+ *
+ * @brief   After a PRU event: pair the newest stamp with the host clock
+ *          and skip the blocks the PRU already overwrote.
+ *
+ * @param   p_ring
+ *          last - Blocks completed by the PRU
+ *
+ * @return  void
+ **/
+void pru_ring_update(pru_ring_t *p_ring, uint32_t last)
+{
+  uint64_t cycles = 0;
+  uint32_t status = 0;
+
+  p_ring->last = last;
+
+  /* The newest block was just stamped: pair it with the host clock */
+  if ( last != p_ring->seq && pru_read_stamp(p_ring->p_stamps, last - 1, &cycles, &status) == 0 )
+  {
+    clock_fit_add(&p_ring->fit, cycles);
+  }
+
+  /* Blocks already overwritten by the PRU */
+  if ( last - p_ring->seq >= p_ring->ring_blocks )
+  {
+    p_ring->lost += last - p_ring->seq - (p_ring->ring_blocks - 1);
+    p_ring->seq   = last - (p_ring->ring_blocks - 1);
+  }
+  metric_set(&PRU_RING_PENDING, last - p_ring->seq);
+}
+
+/***********************************************************************
+ * @fn      pru_ring_next
+ *
+ * @brief   Next block to read, with its stamp. Stamps further apart
+ *          than the blocks between them show samples missed; gaps are
+ *          left out of the measured rate.
+ *
+ * @param   p_ring
+ *          p_block - seq, flags, status and stamp filled in, the
+ *                    caller points p_data at ring slot seq % ring_blocks
+ *
+ * @return  1 if a block is ready, 0 if the host caught up
+ **/
+int pru_ring_next(pru_ring_t *p_ring, acq_block_t *p_block)
+{
+  uint32_t seq = p_ring->seq;
+  double expected = 0;
+
+  if ( seq == p_ring->last )
+  {
+    return 0;
+  }
+  p_ring->seq++;
+
+  p_block->seq    = seq;
+  p_block->flags  = 0;
+  p_block->status = 0;
+  if ( pru_read_stamp(p_ring->p_stamps, seq, &p_block->cycles, &p_block->status) < 0 )
+  {
+    return 1;
+  }
+  p_block->flags = ACQ_BLOCK_STAMPED;
+
+  /* The device may not keep up with its nominal rate: without one, gaps
+   * are checked against the average block period measured so far */
+  expected = p_ring->block_cycles;
+  if ( expected == 0 && p_ring->rate_blocks > 0 )
+  {
+    expected = (double)p_ring->rate_cycles / p_ring->rate_blocks;
+  }
+
+  if ( p_ring->stamps > 0 && expected > 0 &&
+       (p_block->cycles - p_ring->prev_cycles) > GAP_FACTOR * expected * (seq - p_ring->prev_seq) )
+  {
+    printf("Gap before block %u: %.6f s, expected %.6f s\n", seq,
+           (double)(p_block->cycles - p_ring->prev_cycles) / PRU_CLK_HZ, expected * (seq - p_ring->prev_seq) / PRU_CLK_HZ);
+    p_ring->gaps++;
+  }
+  else if ( p_ring->stamps > 0 )
+  {
+    p_ring->rate_cycles  += p_block->cycles - p_ring->prev_cycles;
+    p_ring->rate_samples += (uint64_t)(seq - p_ring->prev_seq) * p_ring->block_len + ACQ_STATUS_LOST(p_block->status);
+    p_ring->rate_blocks  += seq - p_ring->prev_seq;
+  }
+  p_ring->prev_cycles = p_block->cycles;
+  p_ring->prev_seq    = seq;
+  p_ring->stamps++;
+
+  clock_fit_realtime(&p_ring->fit, p_block->cycles, &p_block->real);
+
+  return 1;
+}
+
+/***********************************************************************
+ * @fn      pru_ring_report
+ *
+ * @brief   Blocks lost by the host, rate measured by the PRU clock and
+ *          PRU clock against host clock.
+ *
+ * @param   p_ring
+ *          sample_rate - Nominal, 0: not known exactly
+ *
+ * @return  void
+ **/
+void pru_ring_report(const pru_ring_t *p_ring, double sample_rate)
+{
+  double slope = 0;
+  double offset = 0;
+  double rate = 0;
+
+  if ( p_ring->lost > 0 )
+  {
+    printf("Host too slow: %u blocks overwritten before being read.\n", p_ring->lost);
+  }
+
+  if ( p_ring->rate_cycles > 0 )
+  {
+    rate = (double)p_ring->rate_samples * PRU_CLK_HZ / p_ring->rate_cycles;
+    if ( sample_rate > 0 )
+    {
+      printf("Measured sample rate: %.3f Hz (%+.1f ppm), %u gaps\n", rate, (rate / sample_rate - 1.0) * 1e6,
+             p_ring->gaps);
+    }
+    else
+    {
+      printf("Measured sample rate: %.3f Hz, %u gaps\n", rate, p_ring->gaps);
+    }
+  }
+
+  if ( p_ring->fit.n > 1 )
+  {
+    clock_fit_eval(&p_ring->fit, &slope, &offset);
+    printf("PRU clock drift against host: %+.1f ppm\n", (slope - 1.0) * 1e6);
+  }
+}
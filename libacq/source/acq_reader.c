@@ -0,0 +1,287 @@
+/***********************************************************************
+ * INCLUDES
+ **/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include "acq.h"
+#include "acq_codec.h"
+
+/***********************************************************************
+ * DEFINES
+ **/
+#define INDEX_MIN_BLOCKS    1024
+
+/***********************************************************************
+ * PRIVATE FUNCTIONS PROTOTYPES
+ **/
+static int reader_load_index(acq_reader_t *p_rd);
+static int reader_scan(acq_reader_t *p_rd);
+
+/***********************************************************************
+ * FUNCTIONS
+ **/
+/***********************************************************************
+ * @fn      acq_reader_open
+ *
+ * @brief   Open a file of sink_codec_create(). The block offsets come
+ *          from its index, or from walking the block headers when the
+ *          capture didn't close (the last block may be cut short).
+ *
+ * @param   file_name
+ *
+ * @return  Reader or NULL
+ **/
+acq_reader_t *acq_reader_open(const char *file_name)
+{
+  acq_reader_t *p_rd = calloc(1, sizeof(acq_reader_t));
+  acq_file_header_t header;
+
+  if ( p_rd == NULL )
+  {
+    return NULL;
+  }
+
+  p_rd->fp = fopen(file_name, "rb");
+  if ( p_rd->fp == NULL )
+  {
+    perror("fopen(codec_file)");
+    free(p_rd);
+    return NULL;
+  }
+
+  if ( fread(&header, sizeof(header), 1, p_rd->fp) != 1 || header.magic != ACQ_FILE_MAGIC ||
+       header.num_streams > ACQ_MAX_STREAMS || header.num_channels[0] > ACQ_MAX_CHANNELS ||
+       header.num_channels[1] > ACQ_MAX_CHANNELS )
+  {
+    printf("%s is not a capture file.\n", file_name);
+    acq_reader_close(p_rd);
+    return NULL;
+  }
+
+  p_rd->fmt.encoding      = header.encoding;
+  p_rd->fmt.record_size   = header.record_size;
+  p_rd->fmt.record_values = header.record_values;
+  p_rd->fmt.decimation    = header.decimation;
+  p_rd->fmt.num_streams   = header.num_streams;
+  p_rd->fmt.sample_rate   = header.sample_rate;
+  p_rd->fmt.clock_hz      = header.clock_hz;
+  memcpy(p_rd->fmt.num_channels, header.num_channels, sizeof(header.num_channels));
+  memcpy(p_rd->fmt.lsb, header.lsb, sizeof(header.lsb));
+
+  if ( reader_load_index(p_rd) < 0 && reader_scan(p_rd) < 0 )
+  {
+    acq_reader_close(p_rd);
+    return NULL;
+  }
+
+  return p_rd;
+}
+
+/***********************************************************************
+ * @fn      acq_reader_read
+ *
+ * @brief   Any block, by its position in the file. The records stay
+ *          valid until the next read.
+ *
+ * @param   p_rd
+ *          index - 0 to num_blocks - 1
+ *          p_block
+ *
+ * @return  0, -1 if the block is missing or damaged
+ **/
+int acq_reader_read(acq_reader_t *p_rd, uint32_t index, acq_block_t *p_block)
+{
+  uint32_t streams = (p_rd->fmt.num_streams > 1) ? p_rd->fmt.num_streams : 1;
+  uint32_t stream_bytes = 0;
+  acq_file_block_t header;
+  uint32_t a = 0;
+
+  if ( index >= p_rd->num_blocks || fseeko(p_rd->fp, p_rd->p_offset[index], SEEK_SET) != 0 ||
+       fread(&header, sizeof(header), 1, p_rd->fp) != 1 || header.magic != ACQ_FILE_BLOCK )
+  {
+    return -1;
+  }
+  stream_bytes = header.num_records * p_rd->fmt.record_size;
+
+  if ( header.bytes > p_rd->buf_size )
+  {
+    free(p_rd->p_buf);
+    p_rd->p_buf    = malloc(header.bytes);
+    p_rd->buf_size = (p_rd->p_buf != NULL) ? header.bytes : 0;
+  }
+  if ( header.num_records > p_rd->max_records )
+  {
+    for ( a = 0; a < ACQ_MAX_STREAMS; a++ )
+    {
+      free(p_rd->p_records[a]);
+      p_rd->p_records[a] = (a < streams) ? malloc(stream_bytes) : NULL;
+      if ( a < streams && p_rd->p_records[a] == NULL )
+      {
+        p_rd->max_records = 0;
+        return -1;
+      }
+    }
+    p_rd->max_records = header.num_records;
+  }
+  if ( header.bytes != 0 && (p_rd->p_buf == NULL || fread(p_rd->p_buf, header.bytes, 1, p_rd->fp) != 1) )
+  {
+    return -1;
+  }
+
+  if ( header.flags & ACQ_FILE_RAW )
+  {
+    if ( header.bytes != streams * stream_bytes )
+    {
+      return -1;
+    }
+    for ( a = 0; a < streams; a++ )
+    {
+      memcpy(p_rd->p_records[a], p_rd->p_buf + a * stream_bytes, stream_bytes);
+    }
+  }
+  else if ( acq_codec_decode(&p_rd->fmt, p_rd->p_buf, header.bytes, header.num_records, p_rd->p_records) < 0 )
+  {
+    return -1;
+  }
+
+  memset(p_block, 0, sizeof(acq_block_t));
+  for ( a = 0; a < streams; a++ )
+  {
+    p_block->p_data[a] = p_rd->p_records[a];
+  }
+  p_block->num_records  = header.num_records;
+  p_block->seq          = header.seq;
+  p_block->flags        = header.flags & ~ACQ_FILE_RAW;
+  p_block->status       = header.status;
+  p_block->trig_index   = header.trig_index;
+  p_block->cycles       = header.cycles;
+  p_block->real.tv_sec  = header.real_sec;
+  p_block->real.tv_nsec = header.real_nsec;
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      acq_reader_close
+ *
+ * @brief
+ *
+ * @param   p_rd
+ *
+ * @return  void
+ **/
+void acq_reader_close(acq_reader_t *p_rd)
+{
+  uint32_t a = 0;
+
+  if ( p_rd == NULL )
+  {
+    return;
+  }
+
+  if ( p_rd->fp != NULL )
+  {
+    fclose(p_rd->fp);
+  }
+  for ( a = 0; a < ACQ_MAX_STREAMS; a++ )
+  {
+    free(p_rd->p_records[a]);
+  }
+  free(p_rd->p_offset);
+  free(p_rd->p_buf);
+  free(p_rd);
+}
+
+/***********************************************************************
+ * @fn      reader_load_index
+ *
+ * @brief   Block offsets from the index at the end of the file.
+ *
+ * @param   p_rd
+ *
+ * @return  0, -1 if there's no valid index
+ **/
+static int reader_load_index(acq_reader_t *p_rd)
+{
+  acq_file_index_t index;
+  off_t end = 0;
+
+  if ( fseeko(p_rd->fp, 0, SEEK_END) != 0 )
+  {
+    return -1;
+  }
+  end = ftello(p_rd->fp);
+
+  if ( end < (off_t)(sizeof(acq_file_header_t) + sizeof(index)) ||
+       fseeko(p_rd->fp, end - sizeof(index), SEEK_SET) != 0 || fread(&index, sizeof(index), 1, p_rd->fp) != 1 ||
+       index.magic != ACQ_FILE_INDEX ||
+       index.offset + (uint64_t)index.num_blocks * sizeof(uint64_t) + sizeof(index) != (uint64_t)end )
+  {
+    return -1;
+  }
+
+  p_rd->p_offset = malloc(((index.num_blocks != 0) ? index.num_blocks : 1) * sizeof(uint64_t));
+  if ( p_rd->p_offset == NULL || fseeko(p_rd->fp, index.offset, SEEK_SET) != 0 ||
+       (index.num_blocks != 0 && fread(p_rd->p_offset, index.num_blocks * sizeof(uint64_t), 1, p_rd->fp) != 1) )
+  {
+    free(p_rd->p_offset);
+    p_rd->p_offset = NULL;
+    return -1;
+  }
+  p_rd->num_blocks = index.num_blocks;
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      reader_scan
+ *
+ * @brief   Block offsets from the block headers, up to the first one
+ *          that isn't whole.
+ *
+ * @param   p_rd
+ *
+ * @return  0, -1 out of memory
+ **/
+static int reader_scan(acq_reader_t *p_rd)
+{
+  acq_file_block_t header;
+  uint64_t pos = sizeof(acq_file_header_t);
+  uint32_t size = 0;
+  off_t end = 0;
+
+  if ( fseeko(p_rd->fp, 0, SEEK_END) != 0 )
+  {
+    return -1;
+  }
+  end = ftello(p_rd->fp);
+
+  for ( ;; )
+  {
+    if ( fseeko(p_rd->fp, pos, SEEK_SET) != 0 || fread(&header, sizeof(header), 1, p_rd->fp) != 1 ||
+         header.magic != ACQ_FILE_BLOCK || pos + sizeof(header) + header.bytes > (uint64_t)end )
+    {
+      break;
+    }
+
+    if ( p_rd->num_blocks == size )
+    {
+      uint64_t *p_offset = NULL;
+
+      size = (size != 0) ? 2 * size : INDEX_MIN_BLOCKS;
+      p_offset = realloc(p_rd->p_offset, size * sizeof(uint64_t));
+      if ( p_offset == NULL )
+      {
+        return -1;
+      }
+      p_rd->p_offset = p_offset;
+    }
+    p_rd->p_offset[p_rd->num_blocks++] = pos;
+    pos += sizeof(header) + header.bytes;
+  }
+
+  return 0;
+}
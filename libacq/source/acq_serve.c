@@ -0,0 +1,164 @@
+/***********************************************************************
+ * INCLUDES
+ **/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <signal.h>
+#include "acq.h"
+#include "acq_net.h"
+#include "trace.h"
+#include "metrics.h"
+
+/***********************************************************************
+ * DEFINES
+ **/
+#define DEF_SHM_NAME      "acq"
+
+/***********************************************************************
+ * GLOBALS
+ **/
+static volatile int STOP = 0;
+
+/***********************************************************************
+ * LOCAL FUNCTIONS PROTOTYPES
+ **/
+void signal_handler(int signal);
+int  install_signal(void *signal_handler);
+void usage(const char *name);
+
+/***********************************************************************
+ * MAIN
+ **/
+int main(int argc, char *argv[])
+{
+  acq_server_t *p_srv = NULL;
+  const char *shm_name = DEF_SHM_NAME;
+  const char *unix_path = ACQ_NET_SOCKET;
+  const char *metrics_addr = NULL;
+  int tcp_port = ACQ_NET_PORT;
+  int waiting = 0;
+  int c = 0;
+
+  while ( (c = getopt(argc, argv, "P:u:t:m:")) != -1 )
+  {
+    switch ( c )
+    {
+      case 'P':
+        shm_name = optarg;
+        break;
+      case 'u':
+        unix_path = (strcmp(optarg, "-") == 0) ? NULL : optarg;
+        break;
+      case 't':
+        tcp_port = atoi(optarg);
+        break;
+      case 'm':
+        metrics_addr = optarg;
+        break;
+      default:
+        usage(argv[0]);
+        return -1;
+    }
+  }
+
+  p_srv = acq_server_open(shm_name, unix_path, tcp_port);
+  if ( p_srv == NULL )
+  {
+    return -1;
+  }
+
+  install_signal(&signal_handler);
+  signal(SIGPIPE, SIG_IGN);
+  TRACE_SETUP("acq_serve_trace.json");
+  if ( metrics_addr != NULL && metrics_serve(metrics_addr) < 0 )
+  {
+    acq_server_close(p_srv);
+    return -1;
+  }
+
+  /* One capture after the other, until Ctrl-C */
+  while ( !STOP )
+  {
+    if ( acq_server_run(p_srv, &STOP) < 0 )
+    {
+      if ( !waiting )
+      {
+        printf("Waiting for a capture published as %s...\n", shm_name);
+      }
+      waiting = 1;
+      sleep(1);
+      continue;
+    }
+    waiting = 0;
+    printf("Capture over.\n\n");
+  }
+
+  acq_server_close(p_srv);
+
+  return 0;
+}
+
+/***********************************************************************
+ * LOCAL FUNCTIONS
+ **/
+/***********************************************************************
+ * @fn      signal_handler
+ *
+ * @brief   SIGINT closes the subscribers and ends the server.
+ *
+ * @param   signal
+ *
+ * @return  void
+ **/
+void signal_handler(int signal)
+{
+  if ( signal == SIGINT )
+  {
+    STOP = 1;
+  }
+}
+
+/***********************************************************************
+ * @fn      install_signal
+ *
+ * @brief
+ *
+ * @param   void
+ *
+ * @return  void
+ **/
+int install_signal(void *signal_handler)
+{
+  struct sigaction sig_cb;
+
+  memset(&sig_cb, 0, sizeof(sig_cb));
+  sig_cb.sa_handler = signal_handler;
+  if ( sigaction(SIGINT, &sig_cb, NULL) )
+  {
+    perror("sigaction(SIGINT)");
+    return -1;
+  }
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      usage
+ *
+ * @brief
+ *
+ * @param   name
+ *
+ * @return  void
+ **/
+void usage(const char *name)
+{
+  printf("Usage: %s [-P NAME] [-u PATH] [-t PORT] [-m ADDR]\n\n", name);
+  printf("\t-P: Capture published with 'acq_capture -P NAME' (default %s)\n", DEF_SHM_NAME);
+  printf("\t-u: Unix socket (default %s, '-': none)\n", ACQ_NET_SOCKET);
+  printf("\t-t: TCP port (default %d, 0: none)\n", ACQ_NET_PORT);
+  printf("\t-m: Metrics for Prometheus on [HOST:]PORT (host 127.0.0.1) or a Unix socket path\n\n");
+}
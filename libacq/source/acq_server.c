@@ -0,0 +1,1160 @@
+/***********************************************************************
+ * INCLUDES
+ **/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <linux/futex.h>
+#include "acq.h"
+#include "acq_net.h"
+#include "acq_shm.h"
+#include "trace.h"
+#include "metrics.h"
+
+/***********************************************************************
+ * DEFINES
+ **/
+#define SERVER_MAX_SUBS     32
+#define SERVER_WATCH_MS     100       /* Watcher checks the stop flag */
+#define SERVER_DRAIN_MS     1000      /* For subscribers at the end of a capture */
+#define SHM_NAME_LEN        64
+#define FILTER_CHUNK        256
+#define MAX_CHANNELS        (ACQ_MAX_STREAMS * ACQ_MAX_CHANNELS)
+
+/* Subscriber states */
+#define SUB_FREE            0
+#define SUB_OPTIONS         1         /* Reading the options line */
+#define SUB_STREAM          2
+#define SUB_CLOSING         3         /* Error reply pending, then closed */
+
+/***********************************************************************
+ * TYPEDEFS
+ **/
+/* Each subscriber reads the ring with a source of its own: one that
+ * falls behind is lapped and told how many blocks it missed, nobody
+ * else waits for it. */
+typedef struct sub_t
+{
+  int             fd;
+  int             state;
+  char            line[ACQ_NET_LINE_LEN];
+  uint32_t        line_len;
+  acq_source_t   *p_src;
+  int             filtered;
+  uint32_t        chan_mask;      /* Kept channels, 0: all */
+  uint32_t        decimate;
+  uint32_t        count[MAX_CHANNELS];
+  uint64_t        pos;            /* Values of each stream, for untagged channels */
+  uint32_t        lost_sent;
+  acq_net_frame_t frame;
+  uint8_t        *p_buf;          /* Filtered records, or a send cut short */
+  uint32_t        buf_size;
+  struct iovec    iov[1 + ACQ_MAX_STREAMS];
+  uint32_t        iov_first;
+  uint32_t        iov_count;      /* Left to send, 0: none */
+  int             in_ring;        /* Frame data still points into the ring */
+  uint64_t        frames;
+  uint64_t        bytes;
+} sub_t;
+
+struct acq_server_t
+{
+  char              shm_name[SHM_NAME_LEN];
+  int               unix_fd;
+  int               tcp_fd;
+  char              unix_path[108];
+  int               event_fd;
+  const acq_shm_header_t *p_hdr;
+  pthread_t         watcher;
+  int               quit;
+  sub_t             sub[SERVER_MAX_SUBS];
+};
+
+/***********************************************************************
+ * GLOBALS
+ **/
+static uint32_t CLIENTS = 0;
+
+METRIC_GAUGE(SERVER_CLIENTS, "acq_server_clients", "Clients connected");
+METRIC_COUNTER(SERVER_REFUSED, "acq_server_refused_total", "Clients refused, every place taken");
+METRIC_COUNTER(SERVER_FRAMES, "acq_server_frames_total", "Frames sent to subscribers");
+METRIC_COUNTER(SERVER_BYTES, "acq_server_bytes_total", "Bytes sent to clients");
+
+/***********************************************************************
+ * PRIVATE FUNCTIONS PROTOTYPES
+ **/
+static int   server_listen_unix(const char *path);
+static int   server_listen_tcp(int port);
+static void *server_watch(void *p_arg);
+static void  server_accept(acq_server_t *p_srv, int listen_fd);
+static int   sub_options(acq_server_t *p_srv, sub_t *p_sub);
+static int   sub_parse(sub_t *p_sub, char *line, int *p_oldest);
+static int   sub_pump(sub_t *p_sub);
+static void  sub_frame(sub_t *p_sub, const acq_block_t *p_block);
+static uint32_t sub_filter(sub_t *p_sub, const acq_block_t *p_block);
+static int   sub_reserve(sub_t *p_sub, uint32_t bytes);
+static void  sub_reply(sub_t *p_sub, const void *p_data, uint32_t len);
+static void  sub_close(sub_t *p_sub);
+static int   read_full(int fd, void *p_data, uint32_t len);
+
+/***********************************************************************
+ * FUNCTIONS
+ **/
+/***********************************************************************
+ * @fn      acq_server_open
+ *
+ * @brief   Server of the blocks published by sink_shm_create(), on a
+ *          Unix socket, a TCP port or both (acq_net.h).
+ *
+ * @param   shm_name - Segment
+ *          unix_path - NULL: none
+ *          tcp_port - 0: none
+ *
+ * @return  Server or NULL
+ **/
+acq_server_t *acq_server_open(const char *shm_name, const char *unix_path, int tcp_port)
+{
+  acq_server_t *p_srv = NULL;
+  uint32_t i = 0;
+
+  if ( strlen(shm_name) + 2 > SHM_NAME_LEN || (unix_path != NULL && strlen(unix_path) >= 108) )
+  {
+    return NULL;
+  }
+
+  p_srv = calloc(1, sizeof(acq_server_t));
+  if ( p_srv == NULL )
+  {
+    return NULL;
+  }
+  snprintf(p_srv->shm_name, SHM_NAME_LEN, "%s%s", (shm_name[0] == '/') ? "" : "/", shm_name);
+  p_srv->unix_fd = -1;
+  p_srv->tcp_fd  = -1;
+  for ( i = 0; i < SERVER_MAX_SUBS; i++ )
+  {
+    p_srv->sub[i].fd = -1;
+  }
+
+  p_srv->event_fd = eventfd(0, EFD_NONBLOCK);
+  if ( p_srv->event_fd < 0 )
+  {
+    perror("eventfd()");
+    free(p_srv);
+    return NULL;
+  }
+
+  if ( unix_path != NULL )
+  {
+    strcpy(p_srv->unix_path, unix_path);
+    p_srv->unix_fd = server_listen_unix(unix_path);
+  }
+  if ( tcp_port > 0 )
+  {
+    p_srv->tcp_fd = server_listen_tcp(tcp_port);
+  }
+  if ( (unix_path != NULL && p_srv->unix_fd < 0) || (tcp_port > 0 && p_srv->tcp_fd < 0) ||
+       (unix_path == NULL && tcp_port <= 0) )
+  {
+    acq_server_close(p_srv);
+    return NULL;
+  }
+
+  return p_srv;
+}
+
+/***********************************************************************
+ * @fn      acq_server_run
+ *
+ * @brief   Serve the capture being published until it ends. Sockets
+ *          are non-blocking: a subscriber whose socket is full keeps
+ *          its frame until it drains and is lapped meanwhile, the
+ *          others and the capture go on. Frames are sent from the ring
+ *          (sendmsg() of the header and the records in place), only
+ *          filtered records and sends cut short are copied.
+ *
+ * @param   p_srv
+ *          p_stop - Set to end early
+ *
+ * @return  0 at the end of the capture, -1 if none is published
+ **/
+int acq_server_run(acq_server_t *p_srv, volatile int *p_stop)
+{
+  struct pollfd fds[3 + SERVER_MAX_SUBS];
+  sub_t *p_map[3 + SERVER_MAX_SUBS];
+  struct timespec end_time;
+  struct timespec now;
+  uint64_t count = 0;
+  uint32_t num_fds = 0;
+  uint32_t i = 0;
+  int listening = 0;
+  int ended = 0;
+  int active = 0;
+  int fd = shm_open(p_srv->shm_name, O_RDONLY, 0);
+
+  if ( fd < 0 )
+  {
+    return -1;
+  }
+  p_srv->p_hdr = mmap(NULL, sizeof(acq_shm_header_t), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if ( p_srv->p_hdr == MAP_FAILED || __atomic_load_n(&p_srv->p_hdr->magic, __ATOMIC_ACQUIRE) != ACQ_SHM_MAGIC ||
+       p_srv->p_hdr->state != ACQ_SHM_RUNNING )
+  {
+    if ( p_srv->p_hdr != MAP_FAILED )
+    {
+      munmap((void *)p_srv->p_hdr, sizeof(acq_shm_header_t));
+    }
+    p_srv->p_hdr = NULL;
+    return -1;
+  }
+
+  p_srv->quit = 0;
+  if ( pthread_create(&p_srv->watcher, NULL, server_watch, p_srv) != 0 )
+  {
+    perror("pthread_create(watcher)");
+    munmap((void *)p_srv->p_hdr, sizeof(acq_shm_header_t));
+    p_srv->p_hdr = NULL;
+    return -1;
+  }
+  printf("Serving %s\n", p_srv->shm_name);
+
+  for ( ;; )
+  {
+    if ( !ended && (__atomic_load_n(&p_srv->p_hdr->state, __ATOMIC_ACQUIRE) != ACQ_SHM_RUNNING ||
+                    (p_stop != NULL && *p_stop)) )
+    {
+      ended = 1;
+      clock_gettime(CLOCK_MONOTONIC, &end_time);
+    }
+
+    /* Subscribers take what they can, end when their source does */
+    active = 0;
+    for ( i = 0; i < SERVER_MAX_SUBS; i++ )
+    {
+      sub_t *p_sub = &p_srv->sub[i];
+
+      if ( p_sub->state == SUB_STREAM || p_sub->state == SUB_CLOSING )
+      {
+        int res = 0;
+
+        TRACE_BEGIN("sub_pump");
+        res = sub_pump(p_sub);
+        TRACE_END();
+
+        if ( res < 0 || (res > 0 && p_sub->iov_count == 0) || (p_stop != NULL && *p_stop) )
+        {
+          sub_close(p_sub);
+        }
+      }
+      if ( p_sub->state == SUB_OPTIONS && ended )
+      {
+        sub_close(p_sub);
+      }
+      active += (p_sub->state != SUB_FREE);
+    }
+
+    if ( ended )
+    {
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      if ( active == 0 || timespec_diff(&now, &end_time) * 1000 > SERVER_DRAIN_MS )
+      {
+        break;
+      }
+    }
+
+    num_fds = 0;
+    fds[num_fds].fd     = p_srv->event_fd;
+    fds[num_fds].events = POLLIN;
+    p_map[num_fds++]    = NULL;
+    listening = (!ended && active < SERVER_MAX_SUBS);
+    if ( listening && p_srv->unix_fd >= 0 )
+    {
+      fds[num_fds].fd     = p_srv->unix_fd;
+      fds[num_fds].events = POLLIN;
+      p_map[num_fds++]    = NULL;
+    }
+    if ( listening && p_srv->tcp_fd >= 0 )
+    {
+      fds[num_fds].fd     = p_srv->tcp_fd;
+      fds[num_fds].events = POLLIN;
+      p_map[num_fds++]    = NULL;
+    }
+    for ( i = 0; i < SERVER_MAX_SUBS; i++ )
+    {
+      if ( p_srv->sub[i].state != SUB_FREE )
+      {
+        fds[num_fds].fd     = p_srv->sub[i].fd;
+        fds[num_fds].events = POLLIN | ((p_srv->sub[i].iov_count != 0) ? POLLOUT : 0);
+        p_map[num_fds++]    = &p_srv->sub[i];
+      }
+    }
+
+    if ( poll(fds, num_fds, ended ? 10 : -1) < 0 && errno != EINTR )
+    {
+      perror("poll(server)");
+      break;
+    }
+
+    for ( i = 0; i < num_fds; i++ )
+    {
+      if ( fds[i].revents == 0 )
+      {
+        continue;
+      }
+      if ( fds[i].fd == p_srv->event_fd )
+      {
+        while ( read(p_srv->event_fd, &count, sizeof(count)) > 0 );
+      }
+      else if ( p_map[i] == NULL )
+      {
+        server_accept(p_srv, fds[i].fd);
+      }
+      else if ( (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) && sub_options(p_srv, p_map[i]) < 0 )
+      {
+        sub_close(p_map[i]);
+      }
+    }
+  }
+
+  for ( i = 0; i < SERVER_MAX_SUBS; i++ )
+  {
+    sub_close(&p_srv->sub[i]);
+  }
+  __atomic_store_n(&p_srv->quit, 1, __ATOMIC_RELEASE);
+  pthread_join(p_srv->watcher, NULL);
+  munmap((void *)p_srv->p_hdr, sizeof(acq_shm_header_t));
+  p_srv->p_hdr = NULL;
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      acq_server_close
+ *
+ * @brief
+ *
+ * @param   p_srv
+ *
+ * @return  void
+ **/
+void acq_server_close(acq_server_t *p_srv)
+{
+  uint32_t i = 0;
+
+  for ( i = 0; i < SERVER_MAX_SUBS; i++ )
+  {
+    sub_close(&p_srv->sub[i]);
+  }
+  if ( p_srv->unix_fd >= 0 )
+  {
+    close(p_srv->unix_fd);
+    unlink(p_srv->unix_path);
+  }
+  if ( p_srv->tcp_fd >= 0 )
+  {
+    close(p_srv->tcp_fd);
+  }
+  close(p_srv->event_fd);
+  free(p_srv);
+}
+
+/***********************************************************************
+ * @fn      acq_net_connect
+ *
+ * @brief   Client side: connect to a server.
+ *
+ * @param   unix_path - Or NULL for TCP
+ *          host
+ *          tcp_port
+ *
+ * @return  Socket, -1 on error
+ **/
+int acq_net_connect(const char *unix_path, const char *host, int tcp_port)
+{
+  struct addrinfo hints;
+  struct addrinfo *p_ai = NULL;
+  struct sockaddr_un addr;
+  char port[16];
+  int one = 1;
+  int fd = -1;
+
+  if ( unix_path != NULL )
+  {
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, unix_path, sizeof(addr.sun_path) - 1);
+    if ( fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 )
+    {
+      perror("connect(server)");
+      if ( fd >= 0 )
+      {
+        close(fd);
+      }
+      return -1;
+    }
+    return fd;
+  }
+
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family   = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  snprintf(port, sizeof(port), "%d", tcp_port);
+  if ( getaddrinfo(host, port, &hints, &p_ai) != 0 )
+  {
+    printf("Unknown host %s.\n", host);
+    return -1;
+  }
+  fd = socket(p_ai->ai_family, p_ai->ai_socktype, p_ai->ai_protocol);
+  if ( fd < 0 || connect(fd, p_ai->ai_addr, p_ai->ai_addrlen) < 0 )
+  {
+    perror("connect(server)");
+    if ( fd >= 0 )
+    {
+      close(fd);
+    }
+    freeaddrinfo(p_ai);
+    return -1;
+  }
+  freeaddrinfo(p_ai);
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+  return fd;
+}
+
+/***********************************************************************
+ * @fn      acq_net_subscribe
+ *
+ * @brief   Client side: send the options, take the answer and hello.
+ *
+ * @param   fd
+ *          options - Line without the '\n', "" for the blocks as published
+ *          p_hello
+ *
+ * @return  0, -1 if refused
+ **/
+int acq_net_subscribe(int fd, const char *options, acq_net_hello_t *p_hello)
+{
+  char line[ACQ_NET_LINE_LEN];
+
+  snprintf(line, sizeof(line), "%s\n", options);
+  if ( write(fd, line, strlen(line)) != (ssize_t)strlen(line) || read_line(fd, line, sizeof(line)) < 0 )
+  {
+    return -1;
+  }
+  if ( strcmp(line, "ok") != 0 )
+  {
+    printf("Server: %s\n", line);
+    return -1;
+  }
+  if ( read_full(fd, p_hello, sizeof(acq_net_hello_t)) < 0 || p_hello->magic != ACQ_NET_MAGIC ||
+       p_hello->version != ACQ_NET_VERSION )
+  {
+    return -1;
+  }
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      acq_net_read_frame
+ *
+ * @brief   Client side: next frame, waiting for it.
+ *
+ * @param   fd
+ *          p_frame
+ *          p_data - Records
+ *          max_bytes
+ *
+ * @return  1, 0 at the end of the capture, -1 on error
+ **/
+int acq_net_read_frame(int fd, acq_net_frame_t *p_frame, uint8_t *p_data, uint32_t max_bytes)
+{
+  int res = read_full(fd, p_frame, sizeof(acq_net_frame_t));
+
+  if ( res <= 0 )
+  {
+    return res;
+  }
+  if ( p_frame->magic != ACQ_NET_FRAME || p_frame->bytes > max_bytes ||
+       read_full(fd, p_data, p_frame->bytes) <= 0 )
+  {
+    return -1;
+  }
+
+  return 1;
+}
+
+/***********************************************************************
+ * @fn      server_listen_unix
+ *
+ * @brief
+ *
+ * @param   path
+ *
+ * @return  Listening descriptor, -1 on error
+ **/
+static int server_listen_unix(const char *path)
+{
+  struct sockaddr_un addr;
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+  if ( fd < 0 )
+  {
+    perror("socket()");
+    return -1;
+  }
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+  unlink(path);
+  if ( bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 8) < 0 )
+  {
+    perror("bind(unix)");
+    close(fd);
+    return -1;
+  }
+  printf("Streaming on %s\n", path);
+
+  return fd;
+}
+
+/***********************************************************************
+ * @fn      server_listen_tcp
+ *
+ * @brief
+ *
+ * @param   port
+ *
+ * @return  Listening descriptor, -1 on error
+ **/
+static int server_listen_tcp(int port)
+{
+  struct sockaddr_in addr;
+  int one = 1;
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+  if ( fd < 0 )
+  {
+    perror("socket()");
+    return -1;
+  }
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family      = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port        = htons(port);
+  if ( bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 8) < 0 )
+  {
+    perror("bind(tcp)");
+    close(fd);
+    return -1;
+  }
+  printf("Streaming on port %d\n", port);
+
+  return fd;
+}
+
+/***********************************************************************
+ * @fn      server_watch
+ *
+ * @brief   Watcher thread: waits on the ring's futex and wakes the
+ *          server loop through its eventfd.
+ *
+ * @param   p_arg - Server
+ *
+ * @return  NULL
+ **/
+static void *server_watch(void *p_arg)
+{
+  acq_server_t *p_srv = (acq_server_t *)p_arg;
+  struct timespec ts = {0, SERVER_WATCH_MS * 1000000};
+  uint32_t last = __atomic_load_n(&p_srv->p_hdr->futex, __ATOMIC_ACQUIRE);
+  uint32_t futex = 0;
+  uint64_t one = 1;
+
+  while ( !__atomic_load_n(&p_srv->quit, __ATOMIC_ACQUIRE) )
+  {
+    futex = __atomic_load_n(&p_srv->p_hdr->futex, __ATOMIC_ACQUIRE);
+    if ( futex != last )
+    {
+      last = futex;
+      if ( write(p_srv->event_fd, &one, sizeof(one)) < 0 && errno != EAGAIN )
+      {
+        break;
+      }
+      continue;
+    }
+    syscall(SYS_futex, &p_srv->p_hdr->futex, FUTEX_WAIT, futex, &ts, NULL, 0);
+  }
+
+  return NULL;
+}
+
+/***********************************************************************
+ * @fn      server_accept
+ *
+ * @brief   New subscriber, its options come next.
+ *
+ * @param   p_srv
+ *          listen_fd
+ *
+ * @return  void
+ **/
+static void server_accept(acq_server_t *p_srv, int listen_fd)
+{
+  int one = 1;
+  uint32_t i = 0;
+  int fd = accept(listen_fd, NULL, NULL);
+
+  if ( fd < 0 )
+  {
+    return;
+  }
+
+  for ( i = 0; i < SERVER_MAX_SUBS && p_srv->sub[i].state != SUB_FREE; i++ );
+  if ( i == SERVER_MAX_SUBS )
+  {
+    close(fd);
+    metric_inc(&SERVER_REFUSED);
+    return;
+  }
+
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+  if ( listen_fd == p_srv->tcp_fd )
+  {
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  }
+  memset(&p_srv->sub[i], 0, sizeof(sub_t));
+  p_srv->sub[i].fd    = fd;
+  p_srv->sub[i].state = SUB_OPTIONS;
+  metric_set(&SERVER_CLIENTS, ++CLIENTS);
+}
+
+/***********************************************************************
+ * @fn      sub_options
+ *
+ * @brief   Data from a subscriber: its options line, then nothing but
+ *          the end of the connection.
+ *
+ * @param   p_srv
+ *          p_sub
+ *
+ * @return  0, -1 to close it
+ **/
+static int sub_options(acq_server_t *p_srv, sub_t *p_sub)
+{
+  acq_option_t opt[2];
+  acq_net_hello_t hello;
+  const acq_format_t *p_fmt = NULL;
+  char buf[ACQ_NET_LINE_LEN];
+  char *p_nl = NULL;
+  int oldest = 0;
+  uint32_t a = 0;
+  uint32_t c = 0;
+  ssize_t n = 0;
+
+  if ( p_sub->state != SUB_OPTIONS )
+  {
+    n = read(p_sub->fd, buf, sizeof(buf));
+    return (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) ? -1 : 0;
+  }
+
+  n = read(p_sub->fd, p_sub->line + p_sub->line_len, sizeof(p_sub->line) - 1 - p_sub->line_len);
+  if ( n <= 0 )
+  {
+    return (n < 0 && (errno == EAGAIN || errno == EINTR)) ? 0 : -1;
+  }
+  p_sub->line_len += n;
+  p_sub->line[p_sub->line_len] = '\0';
+  p_nl = strchr(p_sub->line, '\n');
+  if ( p_nl == NULL )
+  {
+    return (p_sub->line_len == sizeof(p_sub->line) - 1) ? -1 : 0;
+  }
+  *p_nl = '\0';
+  if ( p_nl > p_sub->line && p_nl[-1] == '\r' )
+  {
+    p_nl[-1] = '\0';
+  }
+
+  if ( sub_parse(p_sub, p_sub->line, &oldest) < 0 )
+  {
+    p_sub->state = SUB_CLOSING;
+    sub_reply(p_sub, "error wrong options\n", 20);
+    return 0;
+  }
+
+  p_sub->p_src = src_shm_create();
+  opt[0].key   = "name";
+  opt[0].value = p_srv->shm_name;
+  opt[1].key   = "from";
+  opt[1].value = oldest ? "oldest" : "now";
+  if ( p_sub->p_src == NULL || acq_configure(p_sub->p_src, opt, 2) < 0 || acq_open(p_sub->p_src) < 0 ||
+       acq_start(p_sub->p_src, 0, 0) < 0 )
+  {
+    p_sub->state = SUB_CLOSING;
+    sub_reply(p_sub, "error no capture\n", 17);
+    return 0;
+  }
+
+  p_fmt = &p_sub->p_src->fmt;
+  memset(&hello, 0, sizeof(hello));
+  hello.magic   = ACQ_NET_MAGIC;
+  hello.version = ACQ_NET_VERSION;
+  hello.fmt     = *p_fmt;
+  if ( p_sub->filtered )
+  {
+    uint32_t streams = (p_fmt->num_streams > 1) ? p_fmt->num_streams : 1;
+    uint32_t chan_base = (p_fmt->num_channels[0] > 1) ? p_fmt->num_channels[0] : 1;
+
+    memset(hello.fmt.lsb, 0, sizeof(hello.fmt.lsb));
+    memset(hello.fmt.num_channels, 0, sizeof(hello.fmt.num_channels));
+    hello.fmt.encoding      = ACQ_ENC_S24_TAGGED;
+    hello.fmt.record_size   = sizeof(uint32_t);
+    hello.fmt.record_values = 1;
+    hello.fmt.decimation    = p_fmt->decimation * p_sub->decimate;
+    hello.fmt.num_streams   = 1;
+    hello.fmt.sample_rate   = p_fmt->sample_rate / p_sub->decimate;
+    for ( a = 0; a < streams; a++ )
+    {
+      uint32_t channels = (p_fmt->num_channels[a] > 1) ? p_fmt->num_channels[a] : 1;
+
+      for ( c = 0; c < channels && a * chan_base + c < ACQ_MAX_CHANNELS; c++ )
+      {
+        hello.fmt.lsb[0][a * chan_base + c] = p_fmt->lsb[a][c];
+        hello.fmt.num_channels[0] = a * chan_base + c + 1;
+      }
+    }
+  }
+
+  p_sub->state = SUB_STREAM;
+  sub_reply(p_sub, "ok\n", 3);
+  memcpy(p_sub->p_buf + 3, &hello, sizeof(hello));
+  p_sub->iov[0].iov_len += sizeof(hello);
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      sub_parse
+ *
+ * @brief
+ *
+ * @param   p_sub
+ *          line
+ *          p_oldest
+ *
+ * @return  0, -1 on a wrong option
+ **/
+static int sub_parse(sub_t *p_sub, char *line, int *p_oldest)
+{
+  acq_option_t opt;
+  char *p_save = NULL;
+  char *p_tok = NULL;
+  char *p_end = NULL;
+  unsigned long first = 0;
+  unsigned long last = 0;
+
+  p_sub->decimate  = 1;
+  p_sub->chan_mask = 0;
+  for ( p_tok = strtok_r(line, " \t", &p_save); p_tok != NULL; p_tok = strtok_r(NULL, " \t", &p_save) )
+  {
+    if ( acq_parse_option(p_tok, &opt) < 0 )
+    {
+      return -1;
+    }
+    if ( strcmp(opt.key, "channels") == 0 )
+    {
+      for ( p_end = (char *)opt.value; *p_end != '\0'; )
+      {
+        first = strtoul(p_end, &p_end, 10);
+        last  = (*p_end == '-') ? strtoul(p_end + 1, &p_end, 10) : first;
+        if ( last < first || last >= MAX_CHANNELS || (*p_end != ',' && *p_end != '\0') )
+        {
+          return -1;
+        }
+        for ( ; first <= last; first++ )
+        {
+          p_sub->chan_mask |= 1u << first;
+        }
+        p_end += (*p_end == ',');
+      }
+      p_sub->filtered = 1;
+    }
+    else if ( strcmp(opt.key, "decimate") == 0 && strtoul(opt.value, NULL, 10) >= 1 )
+    {
+      p_sub->decimate = strtoul(opt.value, NULL, 10);
+      p_sub->filtered = 1;
+    }
+    else if ( strcmp(opt.key, "from") == 0 && (strcmp(opt.value, "now") == 0 || strcmp(opt.value, "oldest") == 0) )
+    {
+      *p_oldest = (strcmp(opt.value, "oldest") == 0);
+    }
+    else
+    {
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      sub_pump
+ *
+ * @brief   Send the pending frame, then frames of the next blocks, as
+ *          long as the socket takes them. A frame cut short by a full
+ *          socket is copied out of the ring, the producer may reuse it
+ *          before the rest goes.
+ *
+ * @param   p_sub
+ *
+ * @return  0, 1 at the end of the capture, -1 to close it
+ **/
+static int sub_pump(sub_t *p_sub)
+{
+  struct msghdr msg;
+  acq_block_t block;
+  ssize_t n = 0;
+  uint32_t left = 0;
+  uint32_t i = 0;
+  int res = 0;
+
+  for ( ;; )
+  {
+    if ( p_sub->iov_count != 0 )
+    {
+      memset(&msg, 0, sizeof(msg));
+      msg.msg_iov    = &p_sub->iov[p_sub->iov_first];
+      msg.msg_iovlen = p_sub->iov_count;
+      TRACE_BEGIN("sendmsg");
+      n = sendmsg(p_sub->fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+      TRACE_END();
+      if ( n < 0 && errno == EINTR )
+      {
+        continue;
+      }
+      if ( n < 0 && errno != EAGAIN )
+      {
+        return -1;
+      }
+
+      n = (n < 0) ? 0 : n;
+      p_sub->bytes += n;
+      metric_add(&SERVER_BYTES, n);
+      while ( p_sub->iov_count != 0 && (size_t)n >= p_sub->iov[p_sub->iov_first].iov_len )
+      {
+        n -= p_sub->iov[p_sub->iov_first].iov_len;
+        p_sub->iov_first++;
+        p_sub->iov_count--;
+      }
+      if ( p_sub->iov_count == 0 )
+      {
+        if ( p_sub->state == SUB_CLOSING )
+        {
+          return -1;
+        }
+        continue;
+      }
+      p_sub->iov[p_sub->iov_first].iov_base = (uint8_t *)p_sub->iov[p_sub->iov_first].iov_base + n;
+      p_sub->iov[p_sub->iov_first].iov_len -= n;
+
+      /* Socket full: the rest out of the ring, then wait for POLLOUT */
+      if ( p_sub->in_ring )
+      {
+        for ( i = 0; i < p_sub->iov_count; i++ )
+        {
+          left += p_sub->iov[p_sub->iov_first + i].iov_len;
+        }
+        if ( sub_reserve(p_sub, left) < 0 )
+        {
+          return -1;
+        }
+        for ( i = 0, left = 0; i < p_sub->iov_count; i++ )
+        {
+          memcpy(p_sub->p_buf + left, p_sub->iov[p_sub->iov_first + i].iov_base,
+                 p_sub->iov[p_sub->iov_first + i].iov_len);
+          left += p_sub->iov[p_sub->iov_first + i].iov_len;
+        }
+        p_sub->iov[0].iov_base = p_sub->p_buf;
+        p_sub->iov[0].iov_len  = left;
+        p_sub->iov_first = 0;
+        p_sub->iov_count = 1;
+        p_sub->in_ring   = 0;
+      }
+      return 0;
+    }
+
+    if ( p_sub->state != SUB_STREAM )
+    {
+      return 0;
+    }
+
+    res = acq_read_block(p_sub->p_src, &block, 0);
+    if ( res == ACQ_READ_BLOCK )
+    {
+      sub_frame(p_sub, &block);
+    }
+    else
+    {
+      return (res == ACQ_READ_AGAIN) ? 0 : (res == ACQ_READ_END) ? 1 : -1;
+    }
+  }
+}
+
+/***********************************************************************
+ * @fn      sub_frame
+ *
+ * @brief   Frame of a block: header and records in place, or the kept
+ *          values of the kept channels.
+ *
+ * @param   p_sub
+ *          p_block
+ *
+ * @return  void
+ **/
+static void sub_frame(sub_t *p_sub, const acq_block_t *p_block)
+{
+  const acq_format_t *p_fmt = &p_sub->p_src->fmt;
+  uint32_t streams = (p_fmt->num_streams > 1) ? p_fmt->num_streams : 1;
+  uint32_t lost = p_sub->p_src->stats.lost_blocks - p_sub->lost_sent;
+  acq_net_frame_t *p_frame = &p_sub->frame;
+  uint32_t a = 0;
+
+  p_sub->lost_sent = p_sub->p_src->stats.lost_blocks;
+  p_sub->frames++;
+  metric_inc(&SERVER_FRAMES);
+
+  p_frame->magic       = ACQ_NET_FRAME;
+  p_frame->num_records = p_block->num_records;
+  p_frame->seq         = p_block->seq;
+  p_frame->flags       = p_block->flags;
+  p_frame->status      = p_block->status;
+  p_frame->trig_index  = p_block->trig_index;
+  p_frame->lost        = lost;
+  p_frame->cycles      = p_block->cycles;
+  p_frame->real_sec    = p_block->real.tv_sec;
+  p_frame->real_nsec   = p_block->real.tv_nsec;
+
+  p_sub->iov[0].iov_base = p_frame;
+  p_sub->iov[0].iov_len  = sizeof(acq_net_frame_t);
+  p_sub->iov_first = 0;
+
+  if ( p_sub->filtered )
+  {
+    /* Channel order of untagged records goes on across missed blocks */
+    p_sub->pos += (uint64_t)lost * p_block->num_records * p_fmt->record_values;
+    TRACE_BEGIN("sub_filter");
+    p_frame->num_records   = sub_filter(p_sub, p_block);
+    TRACE_END();
+    p_frame->bytes         = p_frame->num_records * sizeof(uint32_t);
+    p_sub->iov[1].iov_base = p_sub->p_buf;
+    p_sub->iov[1].iov_len  = p_frame->bytes;
+    p_sub->iov_count = 2;
+    p_sub->in_ring   = 0;
+    return;
+  }
+
+  p_frame->bytes = 0;
+  for ( a = 0; a < streams; a++ )
+  {
+    p_sub->iov[1 + a].iov_base = (void *)p_block->p_data[a];
+    p_sub->iov[1 + a].iov_len  = p_block->num_records * p_fmt->record_size;
+    p_frame->bytes += p_sub->iov[1 + a].iov_len;
+  }
+  p_sub->iov_count = 1 + streams;
+  p_sub->in_ring   = 1;
+}
+
+/***********************************************************************
+ * @fn      sub_filter
+ *
+ * @brief   Kept values of the block as tagged records, the streams in
+ *          turn. Every kept channel keeps one value in 'decimate'.
+ *
+ * @param   p_sub
+ *          p_block
+ *
+ * @return  Records
+ **/
+static uint32_t sub_filter(sub_t *p_sub, const acq_block_t *p_block)
+{
+  const acq_format_t *p_fmt = &p_sub->p_src->fmt;
+  uint32_t streams = (p_fmt->num_streams > 1) ? p_fmt->num_streams : 1;
+  uint32_t chan_base = (p_fmt->num_channels[0] > 1) ? p_fmt->num_channels[0] : 1;
+  uint32_t num_values = p_block->num_records * p_fmt->record_values;
+  int32_t code[FILTER_CHUNK];
+  uint8_t chan[FILTER_CHUNK];
+  uint32_t out = 0;
+  uint32_t a = 0;
+  uint32_t n = 0;
+  uint32_t i = 0;
+
+  if ( sub_reserve(p_sub, streams * num_values * sizeof(uint32_t)) < 0 )
+  {
+    return 0;
+  }
+
+  for ( a = 0; a < streams; a++ )
+  {
+    for ( n = 0; n < num_values; n += FILTER_CHUNK )
+    {
+      uint32_t len = (num_values - n > FILTER_CHUNK) ? FILTER_CHUNK : num_values - n;
+
+      acq_decode(p_fmt, a, p_block->p_data[a] + n / p_fmt->record_values * p_fmt->record_size, p_sub->pos + n,
+                 len, code, chan);
+      for ( i = 0; i < len; i++ )
+      {
+        uint32_t c = chan[i] + a * chan_base;
+        uint32_t word = 0;
+
+        if ( c >= MAX_CHANNELS || (p_sub->chan_mask != 0 && !(p_sub->chan_mask & (1u << c))) ||
+             p_sub->count[c]++ % p_sub->decimate != 0 )
+        {
+          continue;
+        }
+        word = ((uint32_t)code[i] & 0xFFFFFF) | (c << 24);
+        memcpy(p_sub->p_buf + out * sizeof(uint32_t), &word, sizeof(word));
+        out++;
+      }
+    }
+  }
+  p_sub->pos += num_values;
+
+  return out;
+}
+
+/***********************************************************************
+ * @fn      sub_reserve
+ *
+ * @brief
+ *
+ * @param   p_sub
+ *          bytes
+ *
+ * @return  0, -1 out of memory
+ **/
+static int sub_reserve(sub_t *p_sub, uint32_t bytes)
+{
+  if ( bytes > p_sub->buf_size )
+  {
+    uint8_t *p_buf = realloc(p_sub->p_buf, bytes);
+
+    if ( p_buf == NULL )
+    {
+      return -1;
+    }
+    p_sub->p_buf    = p_buf;
+    p_sub->buf_size = bytes;
+  }
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      sub_reply
+ *
+ * @brief   Queue an answer line.
+ *
+ * @param   p_sub
+ *          p_data
+ *          len
+ *
+ * @return  void
+ **/
+static void sub_reply(sub_t *p_sub, const void *p_data, uint32_t len)
+{
+  if ( sub_reserve(p_sub, len + sizeof(acq_net_hello_t)) < 0 )
+  {
+    p_sub->state = SUB_CLOSING;
+    return;
+  }
+  memcpy(p_sub->p_buf, p_data, len);
+  p_sub->iov[0].iov_base = p_sub->p_buf;
+  p_sub->iov[0].iov_len  = len;
+  p_sub->iov_first = 0;
+  p_sub->iov_count = 1;
+  p_sub->in_ring   = 0;
+}
+
+/***********************************************************************
+ * @fn      sub_close
+ *
+ * @brief
+ *
+ * @param   p_sub
+ *
+ * @return  void
+ **/
+static void sub_close(sub_t *p_sub)
+{
+  if ( p_sub->state == SUB_FREE )
+  {
+    return;
+  }
+
+  if ( p_sub->p_src != NULL )
+  {
+    printf("Subscriber %d: %llu frames, %.2f MB, %u blocks missed\n", p_sub->fd,
+           (unsigned long long)p_sub->frames, p_sub->bytes / 1e6, p_sub->p_src->stats.lost_blocks);
+    acq_close(p_sub->p_src);
+  }
+  close(p_sub->fd);
+  free(p_sub->p_buf);
+  memset(p_sub, 0, sizeof(sub_t));
+  p_sub->fd    = -1;
+  p_sub->state = SUB_FREE;
+  metric_set(&SERVER_CLIENTS, --CLIENTS);
+}
+
+/***********************************************************************
+ * @fn      read_full
+ *
+ * @brief
+ *
+ * @param   fd
+ *          p_data
+ *          len
+ *
+ * @return  1, 0 if the connection ended first, -1 on error
+ **/
+static int read_full(int fd, void *p_data, uint32_t len)
+{
+  uint8_t *p = p_data;
+  ssize_t n = 0;
+
+  while ( len > 0 )
+  {
+    n = read(fd, p, len);
+    if ( n < 0 && errno == EINTR )
+    {
+      continue;
+    }
+    if ( n <= 0 )
+    {
+      return (n == 0 && p == p_data) ? 0 : -1;
+    }
+    p   += n;
+    len -= n;
+  }
+
+  return 1;
+}
@@ -0,0 +1,500 @@
+/***********************************************************************
+ * INCLUDES
+ **/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include "acq.h"
+
+/***********************************************************************
+ * DEFINES
+ **/
+#define BENCH_RECORDS     (1 << 20)
+#define BENCH_BLOCK       1000
+#define BENCH_TIME        1.0
+#define ADC_TOP_RATE      1600000
+#define NUM_CONFIGS       4
+
+/***********************************************************************
+ * TYPEDEFS
+ **/
+typedef struct bench_data_t
+{
+  const char  *name;
+  acq_format_t fmt;
+  uint8_t     *p_data[ACQ_MAX_STREAMS];
+  uint32_t     num_records;
+} bench_data_t;
+
+/* Window settings, as given to -W */
+typedef struct bench_config_t
+{
+  const char  *name;
+  acq_option_t opt[2];
+  uint32_t     num_opts;
+} bench_config_t;
+
+/***********************************************************************
+ * GLOBALS
+ **/
+static uint32_t SEED = 2463534242u;
+
+static const bench_config_t CONFIGS[NUM_CONFIGS] =
+{
+  {"1 s",          {{"window", "1"}, {NULL, NULL}}, 1},
+  {"1 s / 0.1 s",  {{"window", "1"}, {"hop", "0.1"}}, 2},
+  {"10 s / 0.1 s", {{"window", "10"}, {"hop", "0.1"}}, 2},
+  {"10 ms / 1 ms", {{"window", "0.01"}, {"hop", "0.001"}}, 2},
+};
+
+/***********************************************************************
+ * LOCAL FUNCTIONS PROTOTYPES
+ **/
+int    bench_reduce(void);
+int    bench_sink(bench_data_t *p_data);
+double bench_config(bench_data_t *p_data, const bench_config_t *p_config);
+int    bench_alloc(bench_data_t *p_data);
+void   bench_free(bench_data_t *p_data);
+void   make_adc(bench_data_t *p_data, const char *name, uint32_t encoding);
+void   make_ads(bench_data_t *p_data, const char *name, uint32_t encoding, uint32_t streams, uint32_t channels);
+int32_t noise(int32_t amplitude);
+void   put_le(uint8_t *p, uint32_t value, uint32_t bytes);
+double now_seconds(void);
+
+/***********************************************************************
+ * MAIN
+ **/
+int main(int argc, char *argv[])
+{
+  bench_data_t data;
+  uint32_t i = 0;
+  int res = 0;
+
+  if ( argc >= 2 )
+  {
+    printf("Usage: %s\n\n", argv[0]);
+    printf("\tWindow statistics: the reduction against a value by value Welford\n");
+    printf("\tupdate, then the stats sink on synthetic captures of each source,\n");
+    printf("\tin millions of samples per second, per window / hop\n\n");
+    return -1;
+  }
+
+  res |= bench_reduce();
+
+  printf("\n%-18s", "Msmp/s");
+  for ( i = 0; i < NUM_CONFIGS; i++ )
+  {
+    printf(" %13s", CONFIGS[i].name);
+  }
+  printf("\n");
+
+  make_adc(&data, "pru_adc", ACQ_ENC_U16);
+  res |= bench_sink(&data);
+  make_adc(&data, "pru_adc packed", ACQ_ENC_U12_PAIR);
+  res |= bench_sink(&data);
+  make_ads(&data, "ads1256", ACQ_ENC_S24_PACKED, 1, 1);
+  res |= bench_sink(&data);
+  make_ads(&data, "ads1256 8 ch", ACQ_ENC_S24_PACKED, 1, 8);
+  res |= bench_sink(&data);
+  make_ads(&data, "ads1256 dual 4 ch", ACQ_ENC_S24_TAGGED, 2, 4);
+  res |= bench_sink(&data);
+
+  return (res < 0) ? -1 : 0;
+}
+
+/***********************************************************************
+ * LOCAL FUNCTIONS
+ **/
+/***********************************************************************
+ * @fn      bench_reduce
+ *
+ * @brief   acq_summary_add() against Welford's update value by value,
+ *          on 24-bit codes far from zero (where a running sum of
+ *          squares would lose the deviation): speed, and error of the
+ *          standard deviation against an exact one.
+ *
+ * @param   void
+ *
+ * @return  0, -1 if the reduction is off
+ **/
+int bench_reduce(void)
+{
+  int32_t *p_code = malloc(BENCH_RECORDS * sizeof(int32_t));
+  acq_summary_t sum;
+  int64_t total = 0;
+  double mean = 0;
+  double m2 = 0;
+  double delta = 0;
+  double exact = 0;
+  double welford = 0;
+  double t0 = 0;
+  double t_welford = 0;
+  double t_reduce = 0;
+  uint32_t rounds = 0;
+  uint32_t r = 0;
+  uint32_t i = 0;
+
+  if ( p_code == NULL )
+  {
+    perror("malloc(bench)");
+    return -1;
+  }
+  for ( i = 0; i < BENCH_RECORDS; i++ )
+  {
+    p_code[i] = 8000000 + 200 * sin(2 * M_PI * i / 320.0) + noise(50);
+    total    += p_code[i];
+  }
+
+  /* Exact: integer mean, deviations summed in long double */
+  for ( i = 0; i < BENCH_RECORDS; i++ )
+  {
+    long double d = p_code[i] - (long double)total / BENCH_RECORDS;
+    exact += d * d;
+  }
+  exact = sqrt(exact / BENCH_RECORDS);
+
+  t0 = now_seconds();
+  for ( rounds = 0; now_seconds() - t0 < BENCH_TIME; rounds++ )
+  {
+    mean = 0;
+    m2   = 0;
+    for ( i = 0; i < BENCH_RECORDS; i++ )
+    {
+      delta = p_code[i] - mean;
+      mean += delta / (i + 1);
+      m2   += delta * (p_code[i] - mean);
+    }
+  }
+  t_welford = (now_seconds() - t0) / rounds;
+  welford   = sqrt(m2 / BENCH_RECORDS);
+
+  t0 = now_seconds();
+  for ( r = 0; r < rounds; r++ )
+  {
+    acq_summary_reset(&sum);
+    acq_summary_add(&sum, p_code, BENCH_RECORDS);
+  }
+  t_reduce = (now_seconds() - t0) / rounds;
+  free(p_code);
+
+  printf("%-18s %9s %12s\n", "std of 24-bit", "Msmp/s", "rel. error");
+  printf("%-18s %9.1f %12.2e\n", "Welford", BENCH_RECORDS / t_welford / 1e6, fabs(welford - exact) / exact);
+  printf("%-18s %9.1f %12.2e\n", "acq_summary_add", BENCH_RECORDS / t_reduce / 1e6,
+         fabs(acq_summary_std(&sum) - exact) / exact);
+
+  return (sum.n == BENCH_RECORDS && fabs(acq_summary_std(&sum) - exact) / exact < 1e-9) ? 0 : -1;
+}
+
+/***********************************************************************
+ * @fn      bench_sink
+ *
+ * @brief   The capture through the stats sink with each window setting.
+ *
+ * @param   p_data - Records, freed on return
+ *
+ * @return  0 if every setting keeps up with the source, -1 otherwise
+ **/
+int bench_sink(bench_data_t *p_data)
+{
+  uint32_t streams = (p_data->fmt.num_streams > 1) ? p_data->fmt.num_streams : 1;
+  double rate = 0;
+  uint32_t i = 0;
+  int res = 0;
+
+  if ( p_data->num_records == 0 )
+  {
+    return -1;
+  }
+
+  printf("%-18s", p_data->name);
+  for ( i = 0; i < NUM_CONFIGS; i++ )
+  {
+    rate = bench_config(p_data, &CONFIGS[i]);
+    printf(" %13.1f", rate / 1e6);
+    if ( rate < p_data->fmt.sample_rate * streams )
+    {
+      res = -1;
+    }
+  }
+  printf("%s\n", (res < 0) ? "  slower than the source" : "");
+  bench_free(p_data);
+
+  return res;
+}
+
+/***********************************************************************
+ * @fn      bench_config
+ *
+ * @brief   Blocks of the records to the sink, again and again for about
+ *          BENCH_TIME. Samples count every stream.
+ *
+ * @param   p_data
+ *          p_config
+ *
+ * @return  Samples per second, 0 on error
+ **/
+double bench_config(bench_data_t *p_data, const bench_config_t *p_config)
+{
+  acq_format_t *p_fmt = &p_data->fmt;
+  uint32_t streams = (p_fmt->num_streams > 1) ? p_fmt->num_streams : 1;
+  acq_sink_t *p_sink = sink_stats_create("/dev/null", 0);
+  acq_block_t block;
+  uint64_t samples = 0;
+  double t0 = 0;
+  double t = 0;
+  uint32_t n = 0;
+  uint32_t a = 0;
+
+  if ( p_sink == NULL || sink_stats_configure(p_sink, p_config->opt, p_config->num_opts) < 0 ||
+       acq_sink_open(&p_sink, 1, p_fmt) < 0 )
+  {
+    acq_sink_destroy(p_sink);
+    return 0;
+  }
+
+  memset(&block, 0, sizeof(block));
+  t0 = now_seconds();
+  do
+  {
+    for ( n = 0; n < p_data->num_records; n += BENCH_BLOCK )
+    {
+      block.num_records = (p_data->num_records - n > BENCH_BLOCK) ? BENCH_BLOCK : p_data->num_records - n;
+      for ( a = 0; a < streams; a++ )
+      {
+        block.p_data[a] = p_data->p_data[a] + (size_t)n * p_fmt->record_size;
+      }
+      acq_sink_write(&p_sink, 1, &block);
+      block.seq++;
+    }
+    samples += (uint64_t)p_data->num_records * p_fmt->record_values * streams;
+    t = now_seconds() - t0;
+  } while ( t < BENCH_TIME );
+
+  acq_sink_close(&p_sink, 1);
+  acq_sink_destroy(p_sink);
+
+  return samples / t;
+}
+
+/***********************************************************************
+ * @fn      bench_alloc
+ *
+ * @brief
+ *
+ * @param   p_data - Format set
+ *
+ * @return  0, -1 on error
+ **/
+int bench_alloc(bench_data_t *p_data)
+{
+  uint32_t streams = (p_data->fmt.num_streams > 1) ? p_data->fmt.num_streams : 1;
+  uint32_t a = 0;
+
+  p_data->num_records = BENCH_RECORDS;
+  for ( a = 0; a < streams; a++ )
+  {
+    p_data->p_data[a] = calloc(BENCH_RECORDS, p_data->fmt.record_size);
+    if ( p_data->p_data[a] == NULL )
+    {
+      perror("malloc(bench)");
+      bench_free(p_data);
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      bench_free
+ *
+ * @brief
+ *
+ * @param   p_data
+ *
+ * @return  void
+ **/
+void bench_free(bench_data_t *p_data)
+{
+  uint32_t a = 0;
+
+  for ( a = 0; a < ACQ_MAX_STREAMS; a++ )
+  {
+    free(p_data->p_data[a]);
+    p_data->p_data[a] = NULL;
+  }
+  p_data->num_records = 0;
+}
+
+/***********************************************************************
+ * @fn      make_adc
+ *
+ * @brief   AM335x ADC at 1600000 Hz: a 1 kHz tone over most of the
+ *          12-bit range with a few codes of noise.
+ *
+ * @param   p_data
+ *          name
+ *          encoding - ACQ_ENC_U16 or ACQ_ENC_U12_PAIR
+ *
+ * @return  void
+ **/
+void make_adc(bench_data_t *p_data, const char *name, uint32_t encoding)
+{
+  uint32_t code[2];
+  uint32_t n = 0;
+  uint32_t i = 0;
+
+  memset(p_data, 0, sizeof(bench_data_t));
+  p_data->name              = name;
+  p_data->fmt.encoding      = encoding;
+  p_data->fmt.record_size   = (encoding == ACQ_ENC_U12_PAIR) ? 3 : sizeof(uint16_t);
+  p_data->fmt.record_values = (encoding == ACQ_ENC_U12_PAIR) ? 2 : 1;
+  p_data->fmt.decimation    = 1;
+  p_data->fmt.num_streams   = 1;
+  p_data->fmt.sample_rate   = ADC_TOP_RATE;
+
+  if ( bench_alloc(p_data) < 0 )
+  {
+    return;
+  }
+
+  for ( n = 0; n < BENCH_RECORDS; n++ )
+  {
+    for ( i = 0; i < p_data->fmt.record_values; i++ )
+    {
+      uint32_t v = n * p_data->fmt.record_values + i;
+
+      code[i] = 2048 + 1500 * sin(2 * M_PI * 1000.0 * v / ADC_TOP_RATE) + noise(3);
+    }
+    if ( encoding == ACQ_ENC_U12_PAIR )
+    {
+      put_le(p_data->p_data[0] + n * 3, code[0] | (code[1] << 12), 3);
+    }
+    else
+    {
+      put_le(p_data->p_data[0] + n * sizeof(uint16_t), code[0], 2);
+    }
+  }
+}
+
+/***********************************************************************
+ * @fn      make_ads
+ *
+ * @brief   ADS1256 at 30000 SPS cycled through its channels: a 50 Hz
+ *          harmonic per channel with noise.
+ *
+ * @param   p_data
+ *          name
+ *          encoding - ACQ_ENC_S24_PACKED or ACQ_ENC_S24_TAGGED
+ *          streams
+ *          channels
+ *
+ * @return  void
+ **/
+void make_ads(bench_data_t *p_data, const char *name, uint32_t encoding, uint32_t streams, uint32_t channels)
+{
+  uint32_t a = 0;
+  uint32_t n = 0;
+
+  memset(p_data, 0, sizeof(bench_data_t));
+  p_data->name              = name;
+  p_data->fmt.encoding      = encoding;
+  p_data->fmt.record_size   = (encoding == ACQ_ENC_S24_PACKED) ? 3 : sizeof(uint32_t);
+  p_data->fmt.record_values = 1;
+  p_data->fmt.decimation    = 1;
+  p_data->fmt.num_streams   = streams;
+  p_data->fmt.sample_rate   = 30000.0;
+  for ( a = 0; a < streams; a++ )
+  {
+    p_data->fmt.num_channels[a] = channels;
+  }
+
+  if ( bench_alloc(p_data) < 0 )
+  {
+    return;
+  }
+
+  for ( a = 0; a < streams; a++ )
+  {
+    for ( n = 0; n < BENCH_RECORDS; n++ )
+    {
+      uint32_t chan = n % channels;
+      double t = (double)(n / channels) / (p_data->fmt.sample_rate / channels);
+      int32_t code = 400000 * (chan + 1) * sin(2 * M_PI * 50 * (chan + a + 1) * t) + noise(40);
+      uint8_t *p = p_data->p_data[a] + n * p_data->fmt.record_size;
+
+      put_le(p, code & 0xFFFFFF, 3);
+      if ( encoding == ACQ_ENC_S24_TAGGED )
+      {
+        p[3] = chan;
+      }
+    }
+  }
+}
+
+/***********************************************************************
+ * @fn      noise
+ *
+ * @brief   Triangular noise, xorshift32.
+ *
+ * @param   amplitude
+ *
+ * @return  -amplitude to amplitude
+ **/
+int32_t noise(int32_t amplitude)
+{
+  int32_t sum = 0;
+  int i = 0;
+
+  for ( i = 0; i < 2; i++ )
+  {
+    SEED ^= SEED << 13;
+    SEED ^= SEED >> 17;
+    SEED ^= SEED << 5;
+    sum += (int32_t)(SEED % (amplitude + 1));
+  }
+
+  return sum - amplitude;
+}
+
+/***********************************************************************
+ * @fn      put_le
+ *
+ * @brief
+ *
+ * @param   p
+ *          value
+ *          bytes
+ *
+ * @return  void
+ **/
+void put_le(uint8_t *p, uint32_t value, uint32_t bytes)
+{
+  uint32_t i = 0;
+
+  for ( i = 0; i < bytes; i++ )
+  {
+    p[i] = value >> (8 * i);
+  }
+}
+
+/***********************************************************************
+ * @fn      now_seconds
+ *
+ * @brief
+ *
+ * @param   void
+ *
+ * @return  CLOCK_MONOTONIC, s
+ **/
+double now_seconds(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
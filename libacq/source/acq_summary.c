@@ -0,0 +1,192 @@
+/***********************************************************************
+ * INCLUDES
+ **/
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+#include "acq.h"
+
+/***********************************************************************
+ * DEFINES
+ **/
+/* Sums of a chunk are exact in 64 bits: codes up to 24 bits signed,
+ * n * sum of squares < 2^62 */
+#define SUMMARY_CHUNK       256
+
+/***********************************************************************
+ * PRIVATE FUNCTIONS PROTOTYPES
+ **/
+static void summary_chunk(const int32_t *p_code, uint32_t num_values, acq_summary_t *p_sum);
+
+/***********************************************************************
+ * FUNCTIONS
+ **/
+/***********************************************************************
+ * @fn      acq_summary_reset
+ *
+ * @brief
+ *
+ * @param   p_sum
+ *
+ * @return  void
+ **/
+void acq_summary_reset(acq_summary_t *p_sum)
+{
+  memset(p_sum, 0, sizeof(acq_summary_t));
+}
+
+/***********************************************************************
+ * @fn      acq_summary_add
+ *
+ * @brief   Take in codes: each chunk is reduced exactly with integer
+ *          sums (NEON on the BeagleBone), then merged in.
+ *
+ * @param   p_sum
+ *          p_code
+ *          num_values
+ *
+ * @return  void
+ **/
+void acq_summary_add(acq_summary_t *p_sum, const int32_t *p_code, uint32_t num_values)
+{
+  acq_summary_t chunk;
+  uint32_t n = 0;
+
+  for ( n = 0; n < num_values; n += SUMMARY_CHUNK )
+  {
+    summary_chunk(p_code + n, (num_values - n > SUMMARY_CHUNK) ? SUMMARY_CHUNK : num_values - n, &chunk);
+    acq_summary_merge(p_sum, &chunk);
+  }
+}
+
+/***********************************************************************
+ * @fn      acq_summary_merge
+ *
+ * @brief   dst += src, by the pairwise update of Chan et al.: the
+ *          generalization of Welford's to groups, as stable.
+ *
+ * @param   p_dst
+ *          p_src
+ *
+ * @return  void
+ **/
+void acq_summary_merge(acq_summary_t *p_dst, const acq_summary_t *p_src)
+{
+  double n = 0;
+  double delta = 0;
+
+  if ( p_src->n == 0 )
+  {
+    return;
+  }
+  if ( p_dst->n == 0 )
+  {
+    *p_dst = *p_src;
+    return;
+  }
+
+  n     = (double)p_dst->n + p_src->n;
+  delta = p_src->mean - p_dst->mean;
+  p_dst->mean += delta * p_src->n / n;
+  p_dst->m2   += p_src->m2 + delta * delta * ((double)p_dst->n * p_src->n / n);
+  p_dst->n    += p_src->n;
+  p_dst->min   = (p_src->min < p_dst->min) ? p_src->min : p_dst->min;
+  p_dst->max   = (p_src->max > p_dst->max) ? p_src->max : p_dst->max;
+}
+
+/***********************************************************************
+ * @fn      acq_summary_std
+ *
+ * @brief
+ *
+ * @param   p_sum
+ *
+ * @return  Standard deviation of the values (population)
+ **/
+double acq_summary_std(const acq_summary_t *p_sum)
+{
+  return (p_sum->n > 0) ? sqrt(p_sum->m2 / p_sum->n) : 0;
+}
+
+/***********************************************************************
+ * @fn      acq_summary_rms
+ *
+ * @brief
+ *
+ * @param   p_sum
+ *
+ * @return  Root mean square of the values
+ **/
+double acq_summary_rms(const acq_summary_t *p_sum)
+{
+  return (p_sum->n > 0) ? sqrt(p_sum->mean * p_sum->mean + p_sum->m2 / p_sum->n) : 0;
+}
+
+/***********************************************************************
+ * @fn      summary_chunk
+ *
+ * @brief   Up to SUMMARY_CHUNK codes. With NEON 4 codes per round:
+ *          pairwise widening sums, squares multiplied-accumulated into
+ *          64-bit lanes, and lane minimum and maximum.
+ *
+ * @param   p_code
+ *          num_values - 1 to SUMMARY_CHUNK
+ *          p_sum
+ *
+ * @return  void
+ **/
+static void summary_chunk(const int32_t *p_code, uint32_t num_values, acq_summary_t *p_sum)
+{
+  int64_t sum = 0;
+  int64_t sum_sq = 0;
+  int32_t min = p_code[0];
+  int32_t max = p_code[0];
+  uint32_t i = 0;
+
+#if defined(__ARM_NEON)
+  if ( num_values >= 4 )
+  {
+    int64x2_t v_sum = vdupq_n_s64(0);
+    int64x2_t v_sq = vdupq_n_s64(0);
+    int32x4_t v_min = vld1q_s32(p_code);
+    int32x4_t v_max = v_min;
+    int32x2_t m = vdup_n_s32(0);
+
+    for ( ; i + 4 <= num_values; i += 4 )
+    {
+      int32x4_t v = vld1q_s32(p_code + i);
+
+      v_sum = vpadalq_s32(v_sum, v);
+      v_sq  = vmlal_s32(v_sq, vget_low_s32(v), vget_low_s32(v));
+      v_sq  = vmlal_s32(v_sq, vget_high_s32(v), vget_high_s32(v));
+      v_min = vminq_s32(v_min, v);
+      v_max = vmaxq_s32(v_max, v);
+    }
+    sum    = vgetq_lane_s64(v_sum, 0) + vgetq_lane_s64(v_sum, 1);
+    sum_sq = vgetq_lane_s64(v_sq, 0) + vgetq_lane_s64(v_sq, 1);
+    m      = vpmin_s32(vget_low_s32(v_min), vget_high_s32(v_min));
+    min    = vget_lane_s32(vpmin_s32(m, m), 0);
+    m      = vpmax_s32(vget_low_s32(v_max), vget_high_s32(v_max));
+    max    = vget_lane_s32(vpmax_s32(m, m), 0);
+  }
+#endif
+
+  for ( ; i < num_values; i++ )
+  {
+    sum    += p_code[i];
+    sum_sq += (int64_t)p_code[i] * p_code[i];
+    min     = (p_code[i] < min) ? p_code[i] : min;
+    max     = (p_code[i] > max) ? p_code[i] : max;
+  }
+
+  /* n * m2 = n * sum_sq - sum^2, exact before the division */
+  p_sum->n    = num_values;
+  p_sum->mean = (double)sum / num_values;
+  p_sum->m2   = (double)((int64_t)num_values * sum_sq - sum * sum) / num_values;
+  p_sum->min  = min;
+  p_sum->max  = max;
+}
@@ -0,0 +1,720 @@
+/***********************************************************************
+ * INCLUDES
+ **/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include "acq_writer.h"
+#include "trace.h"
+#include "metrics.h"
+
+/* io_uring through its system calls: kernel 5.1 and newer headers */
+#if defined(__NR_io_uring_setup) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define WRITER_URING
+#endif
+#endif
+
+/***********************************************************************
+ * DEFINES
+ **/
+#define BUF_FREE            0
+#define BUF_QUEUED          1
+
+/***********************************************************************
+ * TYPEDEFS
+ **/
+/* Buffers are filled one after the other and written whole at their
+ * place in the file, up to num_bufs of them at a time. The thread's
+ * fields ('state', 'depth', the queue and the stats) are under 'lock'. */
+struct acq_writer_t
+{
+  int             fd;
+  uint32_t        io;
+  int             direct;
+  uint8_t        *p_mem;
+  uint32_t        buf_size;
+  uint32_t        num_bufs;
+  uint32_t        state[ACQ_WRITER_MAX_BUFS];
+  uint32_t        len[ACQ_WRITER_MAX_BUFS];
+  uint64_t        off[ACQ_WRITER_MAX_BUFS];
+  struct timespec submitted[ACQ_WRITER_MAX_BUFS];
+  uint32_t        cur;            /* Buffer being filled */
+  uint32_t        fill;
+  uint64_t        offset;         /* Of the buffer being filled */
+  uint64_t        length;         /* Bytes put */
+  uint64_t        alloc_end;
+  uint32_t        prealloc;
+  uint32_t        depth;          /* Buffers in flight */
+  struct timespec first;
+  struct timespec last;
+  int             started;
+  int             failed;
+  acq_write_stats_t stats;
+  /* ACQ_IO_THREAD */
+  pthread_t       thread;
+  pthread_mutex_t lock;
+  pthread_cond_t  cond;
+  uint32_t        queue[ACQ_WRITER_MAX_BUFS];
+  uint32_t        q_head;
+  uint32_t        q_count;
+  int             quit;
+  int             running;
+#ifdef WRITER_URING
+  /* ACQ_IO_URING */
+  int             ring_fd;
+  uint8_t        *p_sq;
+  uint8_t        *p_cq;
+  size_t          sq_size;
+  size_t          cq_size;
+  struct io_uring_sqe *p_sqe;
+  size_t          sqe_size;
+  struct io_uring_cqe *p_cqe;
+  uint32_t       *p_sq_tail;
+  uint32_t       *p_sq_mask;
+  uint32_t       *p_sq_array;
+  uint32_t       *p_cq_head;
+  uint32_t       *p_cq_tail;
+  uint32_t       *p_cq_mask;
+  struct iovec    iov[ACQ_WRITER_MAX_BUFS];
+#endif
+};
+
+/***********************************************************************
+ * GLOBALS
+ **/
+METRIC_COUNTER(WRITER_BYTES, "acq_writer_bytes_total", "Bytes written to capture files");
+METRIC_COUNTER(WRITER_ERRORS, "acq_writer_errors_total", "Buffer writes failed");
+METRIC_GAUGE(WRITER_DEPTH, "acq_writer_buffers_in_flight", "Buffers queued or being written");
+METRIC_HISTOGRAM(WRITER_LATENCY, "acq_writer_write_seconds", "From queuing a buffer to its write done",
+                 1e-9, 250000, 500000, 1000000, 2500000, 5000000, 10000000, 25000000, 50000000, 100000000,
+                 250000000, 500000000, 1000000000);
+METRIC_HISTOGRAM(WRITER_STALLS, "acq_writer_stall_seconds", "Capture waits for a free buffer",
+                 1e-9, 100000, 1000000, 10000000, 100000000, 1000000000);
+
+/***********************************************************************
+ * PRIVATE FUNCTIONS PROTOTYPES
+ **/
+static int   writer_submit(acq_writer_t *p_wr, uint32_t idx, uint32_t len);
+static int   writer_wait(acq_writer_t *p_wr, uint32_t idx, int count);
+static void  writer_done(acq_writer_t *p_wr, uint32_t idx, int32_t res);
+static void *writer_main(void *p_arg);
+static int   writer_uring_init(acq_writer_t *p_wr);
+static void  writer_uring_exit(acq_writer_t *p_wr);
+static int   writer_reap(acq_writer_t *p_wr, int wait);
+
+/***********************************************************************
+ * FUNCTIONS
+ **/
+/***********************************************************************
+ * @fn      acq_writer_defaults
+ *
+ * @brief
+ *
+ * @param   p_cfg
+ *
+ * @return  void
+ **/
+void acq_writer_defaults(acq_writer_cfg_t *p_cfg)
+{
+  p_cfg->buf_size = ACQ_WRITER_BUF_SIZE;
+  p_cfg->num_bufs = ACQ_WRITER_NUM_BUFS;
+  p_cfg->io       = ACQ_IO_URING;
+  p_cfg->direct   = 1;
+  p_cfg->prealloc = ACQ_WRITER_PREALLOC;
+}
+
+/***********************************************************************
+ * @fn      acq_writer_open
+ *
+ * @brief   Create the file for writes off the capture path. O_DIRECT
+ *          keeps them out of the page cache, so there's no writeback
+ *          burst to stall on; the file is reserved with fallocate()
+ *          ahead of the writes. Without O_DIRECT (tmpfs) or io_uring
+ *          (kernel before 5.1) the writer goes on without them.
+ *
+ * @param   file_name
+ *          p_cfg
+ *
+ * @return  Writer or NULL
+ **/
+acq_writer_t *acq_writer_open(const char *file_name, const acq_writer_cfg_t *p_cfg)
+{
+  acq_writer_t *p_wr = NULL;
+
+  if ( p_cfg->buf_size == 0 || p_cfg->buf_size % ACQ_WRITER_ALIGN != 0 || p_cfg->num_bufs < 2 ||
+       p_cfg->num_bufs > ACQ_WRITER_MAX_BUFS )
+  {
+    return NULL;
+  }
+
+  p_wr = calloc(1, sizeof(acq_writer_t));
+  if ( p_wr == NULL )
+  {
+    return NULL;
+  }
+  p_wr->buf_size = p_cfg->buf_size;
+  p_wr->num_bufs = p_cfg->num_bufs;
+  p_wr->prealloc = p_cfg->prealloc;
+  p_wr->io       = p_cfg->io;
+  p_wr->direct   = p_cfg->direct;
+
+  if ( posix_memalign((void **)&p_wr->p_mem, ACQ_WRITER_ALIGN, (size_t)p_wr->buf_size * p_wr->num_bufs) != 0 )
+  {
+    perror("malloc(writer)");
+    free(p_wr);
+    return NULL;
+  }
+
+  p_wr->fd = open(file_name, O_WRONLY | O_CREAT | O_TRUNC | (p_wr->direct ? O_DIRECT : 0), 0644);
+  if ( p_wr->fd < 0 && p_wr->direct && errno == EINVAL )
+  {
+    p_wr->direct = 0;
+    p_wr->fd = open(file_name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  }
+  if ( p_wr->fd < 0 )
+  {
+    perror("open(capture_file)");
+    free(p_wr->p_mem);
+    free(p_wr);
+    return NULL;
+  }
+
+  if ( p_wr->io == ACQ_IO_URING && writer_uring_init(p_wr) < 0 )
+  {
+    p_wr->io = ACQ_IO_THREAD;
+  }
+
+  pthread_mutex_init(&p_wr->lock, NULL);
+  pthread_cond_init(&p_wr->cond, NULL);
+  if ( p_wr->io == ACQ_IO_THREAD )
+  {
+    if ( pthread_create(&p_wr->thread, NULL, writer_main, p_wr) != 0 )
+    {
+      perror("pthread_create(writer)");
+      p_wr->failed = 1;
+      acq_writer_close(p_wr, NULL);
+      return NULL;
+    }
+    p_wr->running = 1;
+  }
+
+  p_wr->stats.io       = (p_wr->io == ACQ_IO_URING) ? "io_uring" : "thread";
+  p_wr->stats.direct   = p_wr->direct;
+  p_wr->stats.num_bufs = p_wr->num_bufs;
+
+  return p_wr;
+}
+
+/***********************************************************************
+ * @fn      acq_writer_put
+ *
+ * @brief   Append to the file. Only waits when every buffer is still
+ *          being written.
+ *
+ * @param   p_wr
+ *          p_data
+ *          len
+ *
+ * @return  0, -1 if a write failed (later data is dropped)
+ **/
+int acq_writer_put(acq_writer_t *p_wr, const void *p_data, uint32_t len)
+{
+  const uint8_t *p = p_data;
+  uint32_t n = 0;
+
+  while ( len > 0 )
+  {
+    if ( p_wr->failed )
+    {
+      return -1;
+    }
+
+    if ( p_wr->fill == 0 && writer_wait(p_wr, p_wr->cur, 1) < 0 )
+    {
+      return -1;
+    }
+
+    n = p_wr->buf_size - p_wr->fill;
+    n = (len < n) ? len : n;
+    memcpy(p_wr->p_mem + (size_t)p_wr->cur * p_wr->buf_size + p_wr->fill, p, n);
+    p_wr->fill   += n;
+    p_wr->length += n;
+    p            += n;
+    len          -= n;
+
+    if ( p_wr->fill == p_wr->buf_size )
+    {
+      if ( writer_submit(p_wr, p_wr->cur, p_wr->buf_size) < 0 )
+      {
+        return -1;
+      }
+      p_wr->cur  = (p_wr->cur + 1) % p_wr->num_bufs;
+      p_wr->fill = 0;
+    }
+  }
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      acq_writer_close
+ *
+ * @brief   Write what's left, wait for every write and cut the file to
+ *          the bytes put (the last O_DIRECT write is padded, and the
+ *          reserve goes past the end).
+ *
+ * @param   p_wr
+ *          p_stats - Or NULL
+ *
+ * @return  0, -1 if the file is incomplete
+ **/
+int acq_writer_close(acq_writer_t *p_wr, acq_write_stats_t *p_stats)
+{
+  uint32_t len = p_wr->fill;
+  uint32_t i = 0;
+  int res = 0;
+
+  if ( len > 0 && !p_wr->failed )
+  {
+    if ( p_wr->direct )
+    {
+      len = (len + ACQ_WRITER_ALIGN - 1) / ACQ_WRITER_ALIGN * ACQ_WRITER_ALIGN;
+      memset(p_wr->p_mem + (size_t)p_wr->cur * p_wr->buf_size + p_wr->fill, 0, len - p_wr->fill);
+    }
+    writer_submit(p_wr, p_wr->cur, len);
+  }
+  for ( i = 0; i < p_wr->num_bufs; i++ )
+  {
+    writer_wait(p_wr, i, 0);
+  }
+
+  if ( p_wr->running )
+  {
+    pthread_mutex_lock(&p_wr->lock);
+    p_wr->quit = 1;
+    pthread_cond_broadcast(&p_wr->cond);
+    pthread_mutex_unlock(&p_wr->lock);
+    pthread_join(p_wr->thread, NULL);
+  }
+  if ( p_wr->io == ACQ_IO_URING )
+  {
+    writer_uring_exit(p_wr);
+  }
+  pthread_cond_destroy(&p_wr->cond);
+  pthread_mutex_destroy(&p_wr->lock);
+
+  if ( ftruncate(p_wr->fd, p_wr->length) < 0 || fdatasync(p_wr->fd) < 0 )
+  {
+    perror("ftruncate(capture_file)");
+    res = -1;
+  }
+  if ( close(p_wr->fd) < 0 || p_wr->failed )
+  {
+    res = -1;
+  }
+
+  p_wr->stats.bytes   = p_wr->length;
+  p_wr->stats.seconds = p_wr->started ? timespec_diff(&p_wr->last, &p_wr->first) : 0;
+  if ( p_stats != NULL )
+  {
+    *p_stats = p_wr->stats;
+  }
+
+  free(p_wr->p_mem);
+  free(p_wr);
+
+  return res;
+}
+
+/***********************************************************************
+ * @fn      writer_submit
+ *
+ * @brief   Queue a buffer for writing at its offset, reserving the file
+ *          further ahead first if needed. A capture killed before
+ *          close() leaves the reserve as zeros after the data.
+ *
+ * @param   p_wr
+ *          idx
+ *          len
+ *
+ * @return  0, -1 on error
+ **/
+static int writer_submit(acq_writer_t *p_wr, uint32_t idx, uint32_t len)
+{
+  while ( p_wr->prealloc != 0 && p_wr->offset + len > p_wr->alloc_end )
+  {
+    if ( fallocate(p_wr->fd, 0, p_wr->alloc_end, p_wr->prealloc) < 0 )
+    {
+      p_wr->prealloc = 0;
+      break;
+    }
+    p_wr->alloc_end += p_wr->prealloc;
+  }
+
+  if ( !p_wr->started )
+  {
+    clock_gettime(CLOCK_MONOTONIC, &p_wr->first);
+    p_wr->last    = p_wr->first;
+    p_wr->started = 1;
+  }
+
+  p_wr->len[idx] = len;
+  p_wr->off[idx] = p_wr->offset;
+  p_wr->offset  += len;
+  clock_gettime(CLOCK_MONOTONIC, &p_wr->submitted[idx]);
+
+  if ( p_wr->io == ACQ_IO_THREAD )
+  {
+    pthread_mutex_lock(&p_wr->lock);
+    p_wr->state[idx] = BUF_QUEUED;
+    p_wr->depth++;
+    if ( p_wr->depth > p_wr->stats.max_depth )
+    {
+      p_wr->stats.max_depth = p_wr->depth;
+    }
+    metric_set(&WRITER_DEPTH, p_wr->depth);
+    p_wr->queue[(p_wr->q_head + p_wr->q_count) % p_wr->num_bufs] = idx;
+    p_wr->q_count++;
+    pthread_cond_broadcast(&p_wr->cond);
+    pthread_mutex_unlock(&p_wr->lock);
+    return 0;
+  }
+
+#ifdef WRITER_URING
+  {
+    uint32_t tail = *p_wr->p_sq_tail;
+    uint32_t i = tail & *p_wr->p_sq_mask;
+    struct io_uring_sqe *p_sqe = &p_wr->p_sqe[i];
+    long res = 0;
+
+    p_wr->state[idx] = BUF_QUEUED;
+    p_wr->depth++;
+    if ( p_wr->depth > p_wr->stats.max_depth )
+    {
+      p_wr->stats.max_depth = p_wr->depth;
+    }
+    metric_set(&WRITER_DEPTH, p_wr->depth);
+
+    p_wr->iov[idx].iov_base = p_wr->p_mem + (size_t)idx * p_wr->buf_size;
+    p_wr->iov[idx].iov_len  = len;
+    memset(p_sqe, 0, sizeof(struct io_uring_sqe));
+    p_sqe->opcode    = IORING_OP_WRITEV;
+    p_sqe->fd        = p_wr->fd;
+    p_sqe->addr      = (uintptr_t)&p_wr->iov[idx];
+    p_sqe->len       = 1;
+    p_sqe->off       = p_wr->off[idx];
+    p_sqe->user_data = idx;
+    p_wr->p_sq_array[i] = i;
+    __atomic_store_n(p_wr->p_sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+    TRACE_BEGIN("io_uring_enter");
+    res = syscall(__NR_io_uring_enter, p_wr->ring_fd, 1, 0, 0, NULL, 0);
+    TRACE_END();
+    if ( res != 1 )
+    {
+      perror("io_uring_enter(submit)");
+      p_wr->state[idx] = BUF_FREE;
+      p_wr->depth--;
+      p_wr->failed = 1;
+      metric_set(&WRITER_DEPTH, p_wr->depth);
+      return -1;
+    }
+  }
+#endif
+
+  /* Completions so far, so the depth is current */
+  return writer_reap(p_wr, 0);
+}
+
+/***********************************************************************
+ * @fn      writer_wait
+ *
+ * @brief   Until a buffer is written.
+ *
+ * @param   p_wr
+ *          idx
+ *          count - Stall of the capture, for the stats
+ *
+ * @return  0, -1 if a write failed
+ **/
+static int writer_wait(acq_writer_t *p_wr, uint32_t idx, int count)
+{
+  struct timespec t0;
+  struct timespec t1;
+  int waited = 0;
+  int res = 0;
+
+  if ( p_wr->io == ACQ_IO_THREAD )
+  {
+    pthread_mutex_lock(&p_wr->lock);
+  }
+
+  while ( p_wr->state[idx] != BUF_FREE )
+  {
+    if ( !waited )
+    {
+      TRACE_BEGIN("writer_wait");
+      clock_gettime(CLOCK_MONOTONIC, &t0);
+      waited = 1;
+    }
+    if ( p_wr->io == ACQ_IO_THREAD )
+    {
+      pthread_cond_wait(&p_wr->cond, &p_wr->lock);
+    }
+    else if ( writer_reap(p_wr, 1) < 0 )
+    {
+      p_wr->failed = 1;
+      break;
+    }
+  }
+  res = p_wr->failed ? -1 : 0;
+  if ( waited )
+  {
+    TRACE_END();
+  }
+
+  if ( waited && count )
+  {
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    p_wr->stats.waits++;
+    p_wr->stats.wait_seconds += timespec_diff(&t1, &t0);
+    metric_observe(&WRITER_STALLS, (uint64_t)(timespec_diff(&t1, &t0) * 1e9));
+  }
+
+  if ( p_wr->io == ACQ_IO_THREAD )
+  {
+    pthread_mutex_unlock(&p_wr->lock);
+  }
+
+  return res;
+}
+
+/***********************************************************************
+ * @fn      writer_done
+ *
+ * @brief   A buffer is written, or failed. Under 'lock' for the thread.
+ *
+ * @param   p_wr
+ *          idx
+ *          res - Bytes written, -errno
+ *
+ * @return  void
+ **/
+static void writer_done(acq_writer_t *p_wr, uint32_t idx, int32_t res)
+{
+  if ( res < 0 || (uint32_t)res != p_wr->len[idx] )
+  {
+    printf("Write of %u bytes at %llu failed: %s\n", p_wr->len[idx], (unsigned long long)p_wr->off[idx],
+           (res < 0) ? strerror(-res) : "short write");
+    p_wr->failed = 1;
+    metric_inc(&WRITER_ERRORS);
+  }
+  else
+  {
+    metric_add(&WRITER_BYTES, res);
+  }
+
+  p_wr->state[idx] = BUF_FREE;
+  p_wr->depth--;
+  clock_gettime(CLOCK_MONOTONIC, &p_wr->last);
+  metric_set(&WRITER_DEPTH, p_wr->depth);
+  metric_observe(&WRITER_LATENCY, (uint64_t)(timespec_diff(&p_wr->last, &p_wr->submitted[idx]) * 1e9));
+}
+
+/***********************************************************************
+ * @fn      writer_main
+ *
+ * @brief   Writer thread: the queued buffers in order.
+ *
+ * @param   p_arg - Writer
+ *
+ * @return  NULL
+ **/
+static void *writer_main(void *p_arg)
+{
+  acq_writer_t *p_wr = (acq_writer_t *)p_arg;
+  uint32_t idx = 0;
+  uint32_t done = 0;
+  ssize_t n = 0;
+
+  pthread_mutex_lock(&p_wr->lock);
+  for ( ;; )
+  {
+    while ( p_wr->q_count == 0 && !p_wr->quit )
+    {
+      pthread_cond_wait(&p_wr->cond, &p_wr->lock);
+    }
+    if ( p_wr->q_count == 0 )
+    {
+      break;
+    }
+    idx = p_wr->queue[p_wr->q_head];
+    pthread_mutex_unlock(&p_wr->lock);
+
+    TRACE_BEGIN("pwrite");
+    for ( done = 0; done < p_wr->len[idx]; done += n )
+    {
+      n = pwrite(p_wr->fd, p_wr->p_mem + (size_t)idx * p_wr->buf_size + done, p_wr->len[idx] - done,
+                 p_wr->off[idx] + done);
+      if ( n < 0 && errno == EINTR )
+      {
+        n = 0;
+      }
+      else if ( n <= 0 )
+      {
+        break;
+      }
+    }
+    TRACE_END();
+
+    pthread_mutex_lock(&p_wr->lock);
+    p_wr->q_head = (p_wr->q_head + 1) % p_wr->num_bufs;
+    p_wr->q_count--;
+    writer_done(p_wr, idx, (n < 0) ? -errno : (int32_t)done);
+    pthread_cond_broadcast(&p_wr->cond);
+  }
+  pthread_mutex_unlock(&p_wr->lock);
+
+  return NULL;
+}
+
+/***********************************************************************
+ * @fn      writer_uring_init
+ *
+ * @brief   Ring with room for every buffer, so submissions never wait.
+ *
+ * @param   p_wr
+ *
+ * @return  0, -1 if the kernel has no io_uring
+ **/
+static int writer_uring_init(acq_writer_t *p_wr)
+{
+#ifdef WRITER_URING
+  struct io_uring_params params;
+
+  memset(&params, 0, sizeof(params));
+  p_wr->ring_fd = syscall(__NR_io_uring_setup, p_wr->num_bufs, &params);
+  if ( p_wr->ring_fd < 0 )
+  {
+    return -1;
+  }
+
+  p_wr->sq_size  = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+  p_wr->cq_size  = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  p_wr->sqe_size = params.sq_entries * sizeof(struct io_uring_sqe);
+#ifdef IORING_FEAT_SINGLE_MMAP
+  if ( params.features & IORING_FEAT_SINGLE_MMAP )
+  {
+    p_wr->sq_size = (p_wr->cq_size > p_wr->sq_size) ? p_wr->cq_size : p_wr->sq_size;
+    p_wr->cq_size = 0;
+  }
+#endif
+
+  p_wr->p_sq = mmap(NULL, p_wr->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, p_wr->ring_fd,
+                    IORING_OFF_SQ_RING);
+  p_wr->p_cq = (p_wr->cq_size == 0) ? p_wr->p_sq :
+               mmap(NULL, p_wr->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, p_wr->ring_fd,
+                    IORING_OFF_CQ_RING);
+  p_wr->p_sqe = mmap(NULL, p_wr->sqe_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, p_wr->ring_fd,
+                     IORING_OFF_SQES);
+  if ( p_wr->p_sq == MAP_FAILED || p_wr->p_cq == MAP_FAILED || p_wr->p_sqe == MAP_FAILED )
+  {
+    writer_uring_exit(p_wr);
+    return -1;
+  }
+
+  p_wr->p_sq_tail  = (uint32_t *)(p_wr->p_sq + params.sq_off.tail);
+  p_wr->p_sq_mask  = (uint32_t *)(p_wr->p_sq + params.sq_off.ring_mask);
+  p_wr->p_sq_array = (uint32_t *)(p_wr->p_sq + params.sq_off.array);
+  p_wr->p_cq_head  = (uint32_t *)(p_wr->p_cq + params.cq_off.head);
+  p_wr->p_cq_tail  = (uint32_t *)(p_wr->p_cq + params.cq_off.tail);
+  p_wr->p_cq_mask  = (uint32_t *)(p_wr->p_cq + params.cq_off.ring_mask);
+  p_wr->p_cqe      = (struct io_uring_cqe *)(p_wr->p_cq + params.cq_off.cqes);
+
+  return 0;
+#else
+  return -1;
+#endif
+}
+
+/***********************************************************************
+ * @fn      writer_uring_exit
+ *
+ * @brief
+ *
+ * @param   p_wr
+ *
+ * @return  void
+ **/
+static void writer_uring_exit(acq_writer_t *p_wr)
+{
+#ifdef WRITER_URING
+  if ( p_wr->p_sqe != NULL && p_wr->p_sqe != MAP_FAILED )
+  {
+    munmap(p_wr->p_sqe, p_wr->sqe_size);
+  }
+  if ( p_wr->cq_size != 0 && p_wr->p_cq != NULL && p_wr->p_cq != MAP_FAILED )
+  {
+    munmap(p_wr->p_cq, p_wr->cq_size);
+  }
+  if ( p_wr->p_sq != NULL && p_wr->p_sq != MAP_FAILED )
+  {
+    munmap(p_wr->p_sq, p_wr->sq_size);
+  }
+  close(p_wr->ring_fd);
+#endif
+}
+
+/***********************************************************************
+ * @fn      writer_reap
+ *
+ * @brief   Completed io_uring writes.
+ *
+ * @param   p_wr
+ *          wait - For at least one
+ *
+ * @return  0, -1 on error
+ **/
+static int writer_reap(acq_writer_t *p_wr, int wait)
+{
+#ifdef WRITER_URING
+  uint32_t head = 0;
+  uint32_t tail = 0;
+
+  if ( p_wr->io != ACQ_IO_URING )
+  {
+    return 0;
+  }
+
+  if ( wait && syscall(__NR_io_uring_enter, p_wr->ring_fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0) < 0 &&
+       errno != EINTR )
+  {
+    perror("io_uring_enter(wait)");
+    return -1;
+  }
+
+  head = *p_wr->p_cq_head;
+  tail = __atomic_load_n(p_wr->p_cq_tail, __ATOMIC_ACQUIRE);
+  while ( head != tail )
+  {
+    struct io_uring_cqe *p_cqe = &p_wr->p_cqe[head & *p_wr->p_cq_mask];
+
+    writer_done(p_wr, p_cqe->user_data, p_cqe->res);
+    head++;
+  }
+  __atomic_store_n(p_wr->p_cq_head, head, __ATOMIC_RELEASE);
+#endif
+
+  return 0;
+}
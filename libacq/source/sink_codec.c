@@ -0,0 +1,409 @@
+/***********************************************************************
+ * INCLUDES
+ **/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "acq.h"
+#include "acq_codec.h"
+#include "acq_writer.h"
+
+/***********************************************************************
+ * DEFINES
+ **/
+#define INDEX_MIN_BLOCKS    1024
+
+/***********************************************************************
+ * TYPEDEFS
+ **/
+typedef struct codec_ctx_t
+{
+  const char  *file_name;
+  acq_writer_cfg_t cfg;
+  int          code;          /* 0: every block raw */
+  acq_writer_t *p_wr;
+  acq_write_stats_t stats;
+  acq_format_t fmt;
+  uint8_t     *p_buf;
+  uint32_t     buf_size;
+  uint64_t    *p_offset;      /* Block headers, for the index */
+  uint32_t     index_size;
+  uint32_t     num_blocks;
+  uint64_t     pos;           /* File offset */
+  uint64_t     raw_bytes;     /* Records taken */
+  uint64_t     file_bytes;    /* Blocks written, headers included */
+  int          failed;
+} codec_ctx_t;
+
+/***********************************************************************
+ * PRIVATE FUNCTIONS PROTOTYPES
+ **/
+static int  codec_open(acq_sink_t *p_sink, const acq_format_t *p_fmt);
+static int  codec_write(acq_sink_t *p_sink, const acq_block_t *p_block);
+static int  codec_close(acq_sink_t *p_sink);
+static void codec_destroy(acq_sink_t *p_sink);
+static int  codec_put(codec_ctx_t *p_ctx, const void *p_data, uint32_t len);
+
+/***********************************************************************
+ * FUNCTIONS
+ **/
+/***********************************************************************
+ * @fn      sink_codec_create
+ *
+ * @brief   Compressed capture file (acq_codec.h). Every block is coded
+ *          on its own (acq_codec_encode(), or kept raw if that's not
+ *          shorter) behind a header with its stamps, so any block can
+ *          be read back alone; the index of the blocks goes at the end
+ *          when the capture closes. Read with acq_reader_open() or the
+ *          "file" source. The file is written by acq_writer_open(),
+ *          off the capture path (sink_codec_configure()).
+ *
+ * @param   file_name
+ *
+ * @return  Sink or NULL
+ */
+acq_sink_t *sink_codec_create(const char *file_name)
+{
+  acq_sink_t *p_sink = calloc(1, sizeof(acq_sink_t));
+  codec_ctx_t *p_ctx = calloc(1, sizeof(codec_ctx_t));
+
+  if ( p_sink == NULL || p_ctx == NULL )
+  {
+    free(p_sink);
+    free(p_ctx);
+    return NULL;
+  }
+
+  p_ctx->file_name = file_name;
+  p_ctx->code      = 1;
+  acq_writer_defaults(&p_ctx->cfg);
+
+  p_sink->name    = "codec";
+  p_sink->ctx     = p_ctx;
+  p_sink->open    = codec_open;
+  p_sink->write   = codec_write;
+  p_sink->close   = codec_close;
+  p_sink->destroy = codec_destroy;
+
+  return p_sink;
+}
+
+/***********************************************************************
+ * @fn      sink_codec_configure
+ *
+ * @brief   Between captures, all of the options or none:
+ *            code=0|1            Code the blocks (default), or keep them raw
+ *            buffer=KB           Write size (default 1024, 4 KB multiple)
+ *            depth=N             Buffers, writes in flight (default 4)
+ *            io=uring|thread     io_uring (default) or a writer thread
+ *            direct=0|1          O_DIRECT (default 1)
+ *            prealloc=MB         File reserved ahead (default 64, 0: none)
+ *
+ * @param   p_sink
+ *          p_opt
+ *          num_opts
+ *
+ * @return  0, -1 on error
+ **/
+int sink_codec_configure(acq_sink_t *p_sink, const acq_option_t *p_opt, uint32_t num_opts)
+{
+  codec_ctx_t *p_ctx = (codec_ctx_t *)p_sink->ctx;
+  acq_writer_cfg_t cfg = p_ctx->cfg;
+  int code = p_ctx->code;
+  uint32_t val = 0;
+  uint32_t i = 0;
+
+  if ( p_ctx->p_wr != NULL )
+  {
+    return -1;
+  }
+
+  for ( i = 0; i < num_opts; i++ )
+  {
+    val = strtoul(p_opt[i].value, NULL, 10);
+    if ( strcmp(p_opt[i].key, "code") == 0 && val <= 1 )
+    {
+      code = val;
+    }
+    else if ( strcmp(p_opt[i].key, "buffer") == 0 && val > 0 && val % (ACQ_WRITER_ALIGN / 1024) == 0 &&
+              val <= (1 << 20) )
+    {
+      cfg.buf_size = val * 1024;
+    }
+    else if ( strcmp(p_opt[i].key, "depth") == 0 && val >= 2 && val <= ACQ_WRITER_MAX_BUFS )
+    {
+      cfg.num_bufs = val;
+    }
+    else if ( strcmp(p_opt[i].key, "io") == 0 && strcmp(p_opt[i].value, "uring") == 0 )
+    {
+      cfg.io = ACQ_IO_URING;
+    }
+    else if ( strcmp(p_opt[i].key, "io") == 0 && strcmp(p_opt[i].value, "thread") == 0 )
+    {
+      cfg.io = ACQ_IO_THREAD;
+    }
+    else if ( strcmp(p_opt[i].key, "direct") == 0 && val <= 1 )
+    {
+      cfg.direct = val;
+    }
+    else if ( strcmp(p_opt[i].key, "prealloc") == 0 && val < 4096 )
+    {
+      cfg.prealloc = val << 20;
+    }
+    else
+    {
+      return -1;
+    }
+  }
+  p_ctx->cfg  = cfg;
+  p_ctx->code = code;
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      sink_codec_ratio
+ *
+ * @brief   Compression of the last capture: records taken against
+ *          bytes written for them.
+ *
+ * @param   p_sink
+ *
+ * @return  Ratio, 0 before any block
+ **/
+double sink_codec_ratio(acq_sink_t *p_sink)
+{
+  codec_ctx_t *p_ctx = (codec_ctx_t *)p_sink->ctx;
+
+  return (p_ctx->file_bytes != 0) ? (double)p_ctx->raw_bytes / p_ctx->file_bytes : 0;
+}
+
+/***********************************************************************
+ * @fn      sink_codec_stats
+ *
+ * @brief   File writes of the last capture, once it's closed.
+ *
+ * @param   p_sink
+ *          p_stats
+ *
+ * @return  void
+ **/
+void sink_codec_stats(acq_sink_t *p_sink, acq_write_stats_t *p_stats)
+{
+  codec_ctx_t *p_ctx = (codec_ctx_t *)p_sink->ctx;
+
+  *p_stats = p_ctx->stats;
+}
+
+/***********************************************************************
+ * @fn      codec_open
+ *
+ * @brief
+ *
+ * @param   p_sink
+ *          p_fmt
+ *
+ * @return  0, -1 if the file can't be created
+ **/
+static int codec_open(acq_sink_t *p_sink, const acq_format_t *p_fmt)
+{
+  codec_ctx_t *p_ctx = (codec_ctx_t *)p_sink->ctx;
+  acq_file_header_t header;
+
+  p_ctx->fmt        = *p_fmt;
+  p_ctx->num_blocks = 0;
+  p_ctx->pos        = 0;
+  p_ctx->raw_bytes  = 0;
+  p_ctx->file_bytes = 0;
+  p_ctx->failed     = 0;
+  memset(&p_ctx->stats, 0, sizeof(p_ctx->stats));
+
+  p_ctx->p_wr = acq_writer_open(p_ctx->file_name, &p_ctx->cfg);
+  if ( p_ctx->p_wr == NULL )
+  {
+    return -1;
+  }
+
+  memset(&header, 0, sizeof(header));
+  header.magic         = ACQ_FILE_MAGIC;
+  header.encoding      = p_fmt->encoding;
+  header.record_size   = p_fmt->record_size;
+  header.record_values = p_fmt->record_values;
+  header.decimation    = p_fmt->decimation;
+  header.num_streams   = p_fmt->num_streams;
+  header.sample_rate   = p_fmt->sample_rate;
+  header.clock_hz      = p_fmt->clock_hz;
+  memcpy(header.num_channels, p_fmt->num_channels, sizeof(header.num_channels));
+  memcpy(header.lsb, p_fmt->lsb, sizeof(header.lsb));
+
+  return codec_put(p_ctx, &header, sizeof(header));
+}
+
+/***********************************************************************
+ * @fn      codec_write
+ *
+ * @brief
+ *
+ * @param   p_sink
+ *          p_block
+ *
+ * @return  0, -1 on a write error (later blocks are dropped)
+ **/
+static int codec_write(acq_sink_t *p_sink, const acq_block_t *p_block)
+{
+  codec_ctx_t *p_ctx = (codec_ctx_t *)p_sink->ctx;
+  uint32_t streams = (p_ctx->fmt.num_streams > 1) ? p_ctx->fmt.num_streams : 1;
+  uint32_t stream_bytes = p_block->num_records * p_ctx->fmt.record_size;
+  uint32_t bound = acq_codec_bound(&p_ctx->fmt, p_block->num_records);
+  acq_file_block_t header;
+  uint32_t a = 0;
+
+  if ( p_ctx->failed )
+  {
+    return -1;
+  }
+
+  /* Room for the coded block and for the raw one */
+  if ( bound < streams * stream_bytes )
+  {
+    bound = streams * stream_bytes;
+  }
+  if ( bound > p_ctx->buf_size )
+  {
+    free(p_ctx->p_buf);
+    p_ctx->p_buf = malloc(bound);
+    p_ctx->buf_size = (p_ctx->p_buf != NULL) ? bound : 0;
+  }
+  if ( p_ctx->num_blocks == p_ctx->index_size )
+  {
+    uint32_t size = (p_ctx->index_size != 0) ? 2 * p_ctx->index_size : INDEX_MIN_BLOCKS;
+    uint64_t *p_offset = realloc(p_ctx->p_offset, size * sizeof(uint64_t));
+
+    if ( p_offset != NULL )
+    {
+      p_ctx->p_offset   = p_offset;
+      p_ctx->index_size = size;
+    }
+  }
+  if ( p_ctx->p_buf == NULL || p_ctx->num_blocks == p_ctx->index_size )
+  {
+    perror("malloc(codec)");
+    p_ctx->failed = 1;
+    return -1;
+  }
+
+  memset(&header, 0, sizeof(header));
+  header.magic       = ACQ_FILE_BLOCK;
+  header.num_records = p_block->num_records;
+  header.seq         = p_block->seq;
+  header.flags       = p_block->flags;
+  header.status      = p_block->status;
+  header.trig_index  = p_block->trig_index;
+  header.cycles      = p_block->cycles;
+  header.real_sec    = p_block->real.tv_sec;
+  header.real_nsec   = p_block->real.tv_nsec;
+
+  header.bytes = p_ctx->code ? acq_codec_encode(&p_ctx->fmt, p_block, p_ctx->p_buf) : 0;
+  if ( header.bytes == 0 || header.bytes >= streams * stream_bytes )
+  {
+    for ( a = 0; a < streams; a++ )
+    {
+      memcpy(p_ctx->p_buf + a * stream_bytes, p_block->p_data[a], stream_bytes);
+    }
+    header.bytes  = streams * stream_bytes;
+    header.flags |= ACQ_FILE_RAW;
+  }
+
+  p_ctx->p_offset[p_ctx->num_blocks++] = p_ctx->pos;
+  if ( codec_put(p_ctx, &header, sizeof(header)) < 0 || codec_put(p_ctx, p_ctx->p_buf, header.bytes) < 0 )
+  {
+    return -1;
+  }
+  p_ctx->raw_bytes  += streams * stream_bytes;
+  p_ctx->file_bytes += sizeof(header) + header.bytes;
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      codec_close
+ *
+ * @brief   Write the index of the blocks and close the file.
+ *
+ * @param   p_sink
+ *
+ * @return  0, -1 if the file is incomplete
+ **/
+static int codec_close(acq_sink_t *p_sink)
+{
+  codec_ctx_t *p_ctx = (codec_ctx_t *)p_sink->ctx;
+  acq_file_index_t index;
+  int res = 0;
+
+  if ( p_ctx->p_wr == NULL )
+  {
+    return 0;
+  }
+
+  index.offset     = p_ctx->pos;
+  index.num_blocks = p_ctx->num_blocks;
+  index.magic      = ACQ_FILE_INDEX;
+  if ( codec_put(p_ctx, p_ctx->p_offset, p_ctx->num_blocks * sizeof(uint64_t)) < 0 ||
+       codec_put(p_ctx, &index, sizeof(index)) < 0 )
+  {
+    res = -1;
+  }
+
+  if ( acq_writer_close(p_ctx->p_wr, &p_ctx->stats) < 0 || p_ctx->failed )
+  {
+    res = -1;
+  }
+  p_ctx->p_wr = NULL;
+
+  return res;
+}
+
+/***********************************************************************
+ * @fn      codec_destroy
+ *
+ * @brief
+ *
+ * @param   p_sink
+ *
+ * @return  void
+ **/
+static void codec_destroy(acq_sink_t *p_sink)
+{
+  codec_ctx_t *p_ctx = (codec_ctx_t *)p_sink->ctx;
+
+  if ( p_ctx->p_wr != NULL )
+  {
+    acq_writer_close(p_ctx->p_wr, NULL);
+  }
+  free(p_ctx->p_buf);
+  free(p_ctx->p_offset);
+}
+
+/***********************************************************************
+ * @fn      codec_put
+ *
+ * @brief
+ *
+ * @param   p_ctx
+ *          p_data
+ *          len
+ *
+ * @return  0, -1 on error
+ **/
+static int codec_put(codec_ctx_t *p_ctx, const void *p_data, uint32_t len)
+{
+  if ( len > 0 && acq_writer_put(p_ctx->p_wr, p_data, len) < 0 )
+  {
+    p_ctx->failed = 1;
+    return -1;
+  }
+  p_ctx->pos += len;
+
+  return 0;
+}
@@ -0,0 +1,400 @@
+/***********************************************************************
+ * INCLUDES
+ **/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "acq.h"
+#include "acq_shm.h"
+#include "metrics.h"
+
+/***********************************************************************
+ * DEFINES
+ **/
+#define SHM_NAME_LEN        64
+
+/***********************************************************************
+ * TYPEDEFS
+ **/
+typedef struct shm_ctx_t
+{
+  char              name[SHM_NAME_LEN];
+  uint32_t          num_slots;
+  uint32_t          data_size;
+  uint32_t          capture;
+  uint8_t          *p_seg;
+  size_t            seg_size;
+  acq_shm_header_t *p_hdr;
+  acq_shm_slot_t   *p_slot;
+  uint8_t          *p_area;
+  uint32_t          streams;
+  uint32_t          dropped;      /* Blocks too large for the area */
+} shm_ctx_t;
+
+/***********************************************************************
+ * GLOBALS
+ **/
+METRIC_COUNTER(SHM_PUBLISHED, "acq_shm_published_blocks_total", "Blocks published in shared memory");
+METRIC_COUNTER(SHM_DROPPED, "acq_shm_dropped_blocks_total", "Blocks too large for the shared memory area");
+
+/***********************************************************************
+ * PRIVATE FUNCTIONS PROTOTYPES
+ **/
+static int  shm_open_sink(acq_sink_t *p_sink, const acq_format_t *p_fmt);
+static int  shm_write(acq_sink_t *p_sink, const acq_block_t *p_block);
+static int  shm_close(acq_sink_t *p_sink);
+static void shm_destroy(acq_sink_t *p_sink);
+static void shm_retire(const char *name);
+static void shm_unmap(shm_ctx_t *p_ctx);
+
+/***********************************************************************
+ * FUNCTIONS
+ **/
+/***********************************************************************
+ * @fn      sink_shm_create
+ *
+ * @brief   Publish the blocks in a POSIX shared memory segment for any
+ *          number of readers ("shm" source), in the layout of acq_shm.h.
+ *          Publishing costs the same with no reader or many: a copy of
+ *          the block into the segment and a futex wake. Readers take
+ *          the records in place and find out by themselves when they
+ *          have been lapped.
+ *
+ * @param   name - Segment, in /dev/shm ('/' optional)
+ *
+ * @return  Sink or NULL
+ */
+acq_sink_t *sink_shm_create(const char *name)
+{
+  acq_sink_t *p_sink = NULL;
+  shm_ctx_t *p_ctx = NULL;
+
+  if ( strlen(name) + 2 > SHM_NAME_LEN )
+  {
+    return NULL;
+  }
+
+  p_sink = calloc(1, sizeof(acq_sink_t));
+  p_ctx = calloc(1, sizeof(shm_ctx_t));
+  if ( p_sink == NULL || p_ctx == NULL )
+  {
+    free(p_sink);
+    free(p_ctx);
+    return NULL;
+  }
+
+  snprintf(p_ctx->name, SHM_NAME_LEN, "%s%s", (name[0] == '/') ? "" : "/", name);
+  p_ctx->num_slots = ACQ_SHM_SLOTS;
+  p_ctx->data_size = ACQ_SHM_DATA_SIZE;
+
+  p_sink->name    = "shm";
+  p_sink->ctx     = p_ctx;
+  p_sink->open    = shm_open_sink;
+  p_sink->write   = shm_write;
+  p_sink->close   = shm_close;
+  p_sink->destroy = shm_destroy;
+
+  return p_sink;
+}
+
+/***********************************************************************
+ * @fn      sink_shm_configure
+ *
+ * @brief   Between captures, all of the options or none:
+ *            slots=N             Blocks kept (default 4096)
+ *            size=KB             Record area (default 8192)
+ *          A block larger than the area is dropped.
+ *
+ * @param   p_sink
+ *          p_opt
+ *          num_opts
+ *
+ * @return  0, -1 on error
+ **/
+int sink_shm_configure(acq_sink_t *p_sink, const acq_option_t *p_opt, uint32_t num_opts)
+{
+  shm_ctx_t *p_ctx = (shm_ctx_t *)p_sink->ctx;
+  uint32_t num_slots = p_ctx->num_slots;
+  uint32_t data_size = p_ctx->data_size;
+  uint32_t val = 0;
+  uint32_t i = 0;
+
+  if ( p_ctx->p_seg != NULL )
+  {
+    return -1;
+  }
+
+  for ( i = 0; i < num_opts; i++ )
+  {
+    val = strtoul(p_opt[i].value, NULL, 10);
+    if ( strcmp(p_opt[i].key, "slots") == 0 && val >= 2 && val <= (1 << 20) )
+    {
+      num_slots = val;
+    }
+    else if ( strcmp(p_opt[i].key, "size") == 0 && val >= 64 && val <= (1 << 20) )
+    {
+      data_size = val * 1024;
+    }
+    else
+    {
+      return -1;
+    }
+  }
+  p_ctx->num_slots = num_slots;
+  p_ctx->data_size = data_size;
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      sink_shm_dropped
+ *
+ * @brief
+ *
+ * @param   p_sink
+ *
+ * @return  Blocks of the last capture too large to publish
+ **/
+uint32_t sink_shm_dropped(acq_sink_t *p_sink)
+{
+  shm_ctx_t *p_ctx = (shm_ctx_t *)p_sink->ctx;
+
+  return p_ctx->dropped;
+}
+
+/***********************************************************************
+ * @fn      shm_open_sink
+ *
+ * @brief   New segment for the capture. Readers of an earlier one see it
+ *          end and have to attach again.
+ *
+ * @param   p_sink
+ *          p_fmt
+ *
+ * @return  0, -1 on error
+ **/
+static int shm_open_sink(acq_sink_t *p_sink, const acq_format_t *p_fmt)
+{
+  shm_ctx_t *p_ctx = (shm_ctx_t *)p_sink->ctx;
+  size_t slots_offset = (sizeof(acq_shm_header_t) + 63) & ~(size_t)63;
+  size_t data_offset = (slots_offset + (size_t)p_ctx->num_slots * sizeof(acq_shm_slot_t) + 4095) & ~(size_t)4095;
+  int fd = -1;
+
+  shm_unmap(p_ctx);
+  shm_retire(p_ctx->name);
+  p_ctx->capture++;
+  p_ctx->dropped  = 0;
+  p_ctx->streams  = (p_fmt->num_streams > 1) ? p_fmt->num_streams : 1;
+  p_ctx->seg_size = data_offset + p_ctx->data_size;
+
+  fd = shm_open(p_ctx->name, O_RDWR | O_CREAT | O_EXCL, 0644);
+  if ( fd < 0 )
+  {
+    perror("shm_open(sink)");
+    return -1;
+  }
+  if ( ftruncate(fd, p_ctx->seg_size) < 0 )
+  {
+    perror("ftruncate(shm)");
+    close(fd);
+    shm_unlink(p_ctx->name);
+    return -1;
+  }
+  p_ctx->p_seg = mmap(NULL, p_ctx->seg_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if ( p_ctx->p_seg == MAP_FAILED )
+  {
+    perror("mmap(shm)");
+    p_ctx->p_seg = NULL;
+    shm_unlink(p_ctx->name);
+    return -1;
+  }
+
+  p_ctx->p_hdr  = (acq_shm_header_t *)p_ctx->p_seg;
+  p_ctx->p_slot = (acq_shm_slot_t *)(p_ctx->p_seg + slots_offset);
+  p_ctx->p_area = p_ctx->p_seg + data_offset;
+
+  /* Slots start as being rewritten, zeros would pass for block 0 */
+  memset(p_ctx->p_slot, 0xFF, (size_t)p_ctx->num_slots * sizeof(acq_shm_slot_t));
+  p_ctx->p_hdr->version      = ACQ_SHM_VERSION;
+  p_ctx->p_hdr->state        = ACQ_SHM_RUNNING;
+  p_ctx->p_hdr->capture      = p_ctx->capture;
+  p_ctx->p_hdr->num_slots    = p_ctx->num_slots;
+  p_ctx->p_hdr->data_size    = p_ctx->data_size;
+  p_ctx->p_hdr->slots_offset = slots_offset;
+  p_ctx->p_hdr->data_offset  = data_offset;
+  p_ctx->p_hdr->fmt          = *p_fmt;
+  __atomic_store_n(&p_ctx->p_hdr->magic, ACQ_SHM_MAGIC, __ATOMIC_RELEASE);
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      shm_write
+ *
+ * @brief   Publish a block: mark its slot and the records it overwrites
+ *          as taken, copy it in, then move write_seq on. Readers check
+ *          the slot and write_pos again after reading, so what they
+ *          read is good if those didn't change.
+ *
+ * @param   p_sink
+ *          p_block
+ *
+ * @return  0
+ **/
+static int shm_write(acq_sink_t *p_sink, const acq_block_t *p_block)
+{
+  shm_ctx_t *p_ctx = (shm_ctx_t *)p_sink->ctx;
+  acq_shm_header_t *p_hdr = p_ctx->p_hdr;
+  uint32_t stream_bytes = p_block->num_records * p_hdr->fmt.record_size;
+  uint32_t bytes = p_ctx->streams * stream_bytes;
+  uint64_t seq = p_hdr->write_seq;
+  uint64_t pos = p_hdr->write_pos;
+  acq_shm_slot_t *p_slot = &p_ctx->p_slot[seq % p_ctx->num_slots];
+  uint32_t a = 0;
+
+  if ( bytes > p_ctx->data_size )
+  {
+    p_ctx->dropped++;
+    metric_inc(&SHM_DROPPED);
+    return 0;
+  }
+
+  /* Records are never split at the end of the area */
+  if ( pos % p_ctx->data_size + bytes > p_ctx->data_size )
+  {
+    pos += p_ctx->data_size - pos % p_ctx->data_size;
+  }
+
+  __atomic_store_n(&p_slot->seq, ACQ_SHM_REWRITING, __ATOMIC_RELAXED);
+  __atomic_store_n(&p_hdr->write_pos, pos + bytes, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  for ( a = 0; a < p_ctx->streams; a++ )
+  {
+    memcpy(p_ctx->p_area + pos % p_ctx->data_size + a * stream_bytes, p_block->p_data[a], stream_bytes);
+  }
+  p_slot->pos         = pos;
+  p_slot->bytes       = bytes;
+  p_slot->num_records = p_block->num_records;
+  p_slot->block_seq   = p_block->seq;
+  p_slot->flags       = p_block->flags;
+  p_slot->status      = p_block->status;
+  p_slot->trig_index  = p_block->trig_index;
+  p_slot->cycles      = p_block->cycles;
+  p_slot->real_sec    = p_block->real.tv_sec;
+  p_slot->real_nsec   = p_block->real.tv_nsec;
+
+  __atomic_store_n(&p_slot->seq, seq, __ATOMIC_RELEASE);
+  __atomic_store_n(&p_hdr->write_seq, seq + 1, __ATOMIC_RELEASE);
+  __atomic_store_n(&p_hdr->futex, (uint32_t)(seq + 1), __ATOMIC_RELEASE);
+  syscall(SYS_futex, &p_hdr->futex, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+  metric_inc(&SHM_PUBLISHED);
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      shm_close
+ *
+ * @brief   Capture over: readers take what's left and end. The segment
+ *          stays until the next capture or destroy.
+ *
+ * @param   p_sink
+ *
+ * @return  0
+ **/
+static int shm_close(acq_sink_t *p_sink)
+{
+  shm_ctx_t *p_ctx = (shm_ctx_t *)p_sink->ctx;
+
+  if ( p_ctx->p_hdr != NULL )
+  {
+    __atomic_store_n(&p_ctx->p_hdr->state, ACQ_SHM_DONE, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&p_ctx->p_hdr->futex, 1, __ATOMIC_RELEASE);
+    syscall(SYS_futex, &p_ctx->p_hdr->futex, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+  }
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      shm_destroy
+ *
+ * @brief
+ *
+ * @param   p_sink
+ *
+ * @return  void
+ **/
+static void shm_destroy(acq_sink_t *p_sink)
+{
+  shm_ctx_t *p_ctx = (shm_ctx_t *)p_sink->ctx;
+
+  if ( p_ctx->p_seg != NULL )
+  {
+    shm_close(p_sink);
+    shm_unmap(p_ctx);
+    shm_unlink(p_ctx->name);
+  }
+}
+
+/***********************************************************************
+ * @fn      shm_retire
+ *
+ * @brief   End a segment left by an earlier capture, or another
+ *          producer, for its readers, and remove its name.
+ *
+ * @param   name
+ *
+ * @return  void
+ **/
+static void shm_retire(const char *name)
+{
+  acq_shm_header_t *p_hdr = NULL;
+  int fd = shm_open(name, O_RDWR, 0);
+
+  if ( fd < 0 )
+  {
+    return;
+  }
+
+  p_hdr = mmap(NULL, sizeof(acq_shm_header_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if ( p_hdr != MAP_FAILED )
+  {
+    __atomic_store_n(&p_hdr->state, ACQ_SHM_DONE, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&p_hdr->futex, 1, __ATOMIC_RELEASE);
+    syscall(SYS_futex, &p_hdr->futex, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+    munmap(p_hdr, sizeof(acq_shm_header_t));
+  }
+  shm_unlink(name);
+}
+
+/***********************************************************************
+ * @fn      shm_unmap
+ *
+ * @brief
+ *
+ * @param   p_ctx
+ *
+ * @return  void
+ **/
+static void shm_unmap(shm_ctx_t *p_ctx)
+{
+  if ( p_ctx->p_seg != NULL )
+  {
+    munmap(p_ctx->p_seg, p_ctx->seg_size);
+  }
+  p_ctx->p_seg  = NULL;
+  p_ctx->p_hdr  = NULL;
+  p_ctx->p_slot = NULL;
+  p_ctx->p_area = NULL;
+}
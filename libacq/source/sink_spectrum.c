@@ -0,0 +1,747 @@
+/***********************************************************************
+ * INCLUDES
+ **/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include "acq.h"
+#include "acq_fft.h"
+
+/***********************************************************************
+ * DEFINES
+ **/
+#define SPECTRUM_CHUNK      1024      /* Values decoded at a time */
+#define SPECTRUM_MAX_TONES  16
+#define DEF_SIZE            1024
+#define DEF_OVERLAP         50        /* % */
+#define DEF_FRAME           1.0       /* s */
+#define MAX_OVERLAP         90        /* % */
+
+/***********************************************************************
+ * TYPEDEFS
+ **/
+/* A channel: the FFT segment filling up, the power of the segments of
+ * the frame (Welch), and the tones. A run of the tones ends at a gap,
+ * where their phase is lost; the frame averages the power of its runs */
+typedef struct spectrum_chan_t
+{
+  float          *p_seg;        /* size values */
+  uint32_t        fill;
+  float          *p_power;      /* size / 2 + 1 bins, summed */
+  uint32_t        segments;
+  double          rate;         /* Values/s of the channel */
+  uint64_t        values;       /* Of the frame */
+  acq_goertzel_t  tone[SPECTRUM_MAX_TONES];
+  double          tone_power[SPECTRUM_MAX_TONES];   /* Of the runs ended, n A^2 */
+  uint64_t        tone_values;                      /* Of the runs ended */
+} spectrum_chan_t;
+
+typedef struct spectrum_ctx_t
+{
+  const char      *file_name;
+  int              volts;
+  uint32_t         size;        /* FFT, 0: none */
+  uint32_t         overlap;     /* % */
+  double           frame;       /* s */
+  double           rate;        /* Values/s of a stream, 0: the source's */
+  double           tones[SPECTRUM_MAX_TONES];      /* Hz */
+  uint32_t         num_tones;
+  FILE            *fp;
+  acq_format_t     fmt;
+  uint32_t         streams;
+  uint32_t         channels[ACQ_MAX_STREAMS];      /* Analyzed, tagged: all */
+  double           chan_rate[ACQ_MAX_STREAMS];     /* Values/s of each channel */
+  uint32_t         hop;         /* Values between segments */
+  uint32_t         frame_values;                   /* Of each stream */
+  uint64_t         pos;         /* Values of each stream, plus gaps */
+  acq_fft_t       *p_fft;
+  float           *p_window;    /* Hann */
+  double           gain;        /* Sum of the window */
+  float           *p_re;
+  float           *p_im;
+  spectrum_chan_t *p_chan[ACQ_MAX_STREAMS];        /* channels[] each */
+  float            gather[ACQ_MAX_CHANNELS][SPECTRUM_CHUNK];
+} spectrum_ctx_t;
+
+/***********************************************************************
+ * PRIVATE FUNCTIONS PROTOTYPES
+ **/
+static int  spectrum_open(acq_sink_t *p_sink, const acq_format_t *p_fmt);
+static int  spectrum_write(acq_sink_t *p_sink, const acq_block_t *p_block);
+static int  spectrum_close(acq_sink_t *p_sink);
+static void spectrum_destroy(acq_sink_t *p_sink);
+static int  spectrum_alloc(spectrum_ctx_t *p_ctx);
+static void spectrum_free(spectrum_ctx_t *p_ctx);
+static void spectrum_add(spectrum_ctx_t *p_ctx, uint32_t stream, const int32_t *p_code, const uint8_t *p_chan,
+                         uint32_t num_values);
+static void spectrum_feed(spectrum_ctx_t *p_ctx, spectrum_chan_t *p_ch, const float *p_x, uint32_t num_values);
+static void spectrum_skip(spectrum_ctx_t *p_ctx, const acq_block_t *p_block, uint32_t num_values);
+static void spectrum_break(spectrum_ctx_t *p_ctx, spectrum_chan_t *p_ch);
+static void spectrum_frame(spectrum_ctx_t *p_ctx, const acq_block_t *p_block, uint32_t after);
+
+/***********************************************************************
+ * FUNCTIONS
+ **/
+/***********************************************************************
+ * @fn      sink_spectrum_create
+ *
+ * @brief   Spectra of every channel, a text line per channel and frame:
+ *          index and wall clock of the end of the frame ('-' without
+ *          stamps), channel (those of the second stream numbered after
+ *          those of the first), FFT segments averaged, the amplitude of
+ *          each FFT bin, then the amplitude at each tone. The FFT is
+ *          Hann windowed with overlap and the power of the segments
+ *          that end in the frame is averaged (Welch); the tones are
+ *          taken over the whole frame by Goertzel. A sinusoid of
+ *          amplitude A shows as A at its bin and at its tone. Samples
+ *          lost restart the segment and the tones.
+ *
+ * @param   file_name
+ *          volts - Amplitudes in volts (%.4e) where the source knows
+ *                  the LSB, codes otherwise
+ *
+ * @return  Sink or NULL
+ */
+acq_sink_t *sink_spectrum_create(const char *file_name, int volts)
+{
+  acq_sink_t *p_sink = calloc(1, sizeof(acq_sink_t));
+  spectrum_ctx_t *p_ctx = calloc(1, sizeof(spectrum_ctx_t));
+
+  if ( p_sink == NULL || p_ctx == NULL )
+  {
+    free(p_sink);
+    free(p_ctx);
+    return NULL;
+  }
+
+  p_ctx->file_name = file_name;
+  p_ctx->volts     = volts;
+  p_ctx->size      = DEF_SIZE;
+  p_ctx->overlap   = DEF_OVERLAP;
+  p_ctx->frame     = DEF_FRAME;
+
+  p_sink->name    = "spectrum";
+  p_sink->ctx     = p_ctx;
+  p_sink->open    = spectrum_open;
+  p_sink->write   = spectrum_write;
+  p_sink->close   = spectrum_close;
+  p_sink->destroy = spectrum_destroy;
+
+  return p_sink;
+}
+
+/***********************************************************************
+ * @fn      sink_spectrum_configure
+ *
+ * @brief   Between captures, all of the options or none:
+ *            size=N              Values per FFT, power of 2 from 32 to
+ *                                65536 (default 1024), 0: tones only
+ *            overlap=PERCENT     Of consecutive segments, 0 to 90
+ *                                (default 50)
+ *            frame=SECONDS       A line per channel every frame
+ *                                (default 1)
+ *            tones=HZ[,HZ]...    Goertzel frequencies, up to 16
+ *            rate=HZ             Values per second of a stream, where
+ *                                the source doesn't know it (ADS1256
+ *                                cycling channels)
+ *
+ * @param   p_sink
+ *          p_opt
+ *          num_opts
+ *
+ * @return  0, -1 on error
+ **/
+int sink_spectrum_configure(acq_sink_t *p_sink, const acq_option_t *p_opt, uint32_t num_opts)
+{
+  spectrum_ctx_t *p_ctx = (spectrum_ctx_t *)p_sink->ctx;
+  double tones[SPECTRUM_MAX_TONES];
+  uint32_t num_tones = p_ctx->num_tones;
+  uint32_t size = p_ctx->size;
+  uint32_t overlap = p_ctx->overlap;
+  double frame = p_ctx->frame;
+  double rate = p_ctx->rate;
+  const char *p = NULL;
+  char *p_end = NULL;
+  uint32_t i = 0;
+
+  if ( p_ctx->fp != NULL )
+  {
+    return -1;
+  }
+
+  memcpy(tones, p_ctx->tones, sizeof(tones));
+  for ( i = 0; i < num_opts; i++ )
+  {
+    if ( strcmp(p_opt[i].key, "size") == 0 )
+    {
+      size = strtoul(p_opt[i].value, NULL, 10);
+    }
+    else if ( strcmp(p_opt[i].key, "overlap") == 0 )
+    {
+      overlap = strtoul(p_opt[i].value, NULL, 10);
+    }
+    else if ( strcmp(p_opt[i].key, "frame") == 0 )
+    {
+      frame = strtod(p_opt[i].value, NULL);
+    }
+    else if ( strcmp(p_opt[i].key, "rate") == 0 )
+    {
+      rate = strtod(p_opt[i].value, NULL);
+    }
+    else if ( strcmp(p_opt[i].key, "tones") == 0 )
+    {
+      num_tones = 0;
+      for ( p = p_opt[i].value; *p != '\0'; p = (*p_end == ',') ? p_end + 1 : p_end )
+      {
+        if ( num_tones == SPECTRUM_MAX_TONES )
+        {
+          return -1;
+        }
+        tones[num_tones] = strtod(p, &p_end);
+        if ( p_end == p || tones[num_tones] <= 0 || (*p_end != ',' && *p_end != '\0') )
+        {
+          return -1;
+        }
+        num_tones++;
+      }
+    }
+    else
+    {
+      return -1;
+    }
+  }
+
+  if ( (size != 0 && (size < ACQ_FFT_MIN_SIZE || size > ACQ_FFT_MAX_SIZE || (size & (size - 1)) != 0)) ||
+       (size == 0 && num_tones == 0) || overlap > MAX_OVERLAP || frame <= 0 || rate < 0 )
+  {
+    return -1;
+  }
+  p_ctx->size      = size;
+  p_ctx->overlap   = overlap;
+  p_ctx->frame     = frame;
+  p_ctx->rate      = rate;
+  p_ctx->num_tones = num_tones;
+  memcpy(p_ctx->tones, tones, sizeof(tones));
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      spectrum_open
+ *
+ * @brief
+ *
+ * @param   p_sink
+ *          p_fmt
+ *
+ * @return  0, -1 if the file can't be created, the rate is unknown or
+ *          a tone is above half of it
+ **/
+static int spectrum_open(acq_sink_t *p_sink, const acq_format_t *p_fmt)
+{
+  spectrum_ctx_t *p_ctx = (spectrum_ctx_t *)p_sink->ctx;
+  double rate = 0;
+  uint32_t a = 0;
+  uint32_t i = 0;
+
+  p_ctx->fmt             = *p_fmt;
+  p_ctx->fmt.sample_rate = (p_ctx->rate > 0) ? p_ctx->rate : p_fmt->sample_rate;
+  if ( p_ctx->fmt.sample_rate <= 0 )
+  {
+    printf("Spectra need the sample rate of the source (rate=).\n");
+    return -1;
+  }
+  rate = p_ctx->fmt.sample_rate / p_fmt->decimation;
+
+  /* Channels cycled share the rate of their stream */
+  p_ctx->streams = (p_fmt->num_streams > 1) ? p_fmt->num_streams : 1;
+  for ( a = 0; a < p_ctx->streams; a++ )
+  {
+    p_ctx->channels[a]  = (p_fmt->num_channels[a] > 1) ? p_fmt->num_channels[a] : 1;
+    p_ctx->chan_rate[a] = rate / p_ctx->channels[a];
+    p_ctx->channels[a]  = (p_fmt->encoding == ACQ_ENC_S24_TAGGED) ? ACQ_MAX_CHANNELS : p_ctx->channels[a];
+    for ( i = 0; i < p_ctx->num_tones; i++ )
+    {
+      if ( p_ctx->tones[i] >= p_ctx->chan_rate[a] / 2 )
+      {
+        printf("Tone of %g Hz above half the rate of a channel, %g Hz.\n", p_ctx->tones[i], p_ctx->chan_rate[a] / 2);
+        return -1;
+      }
+    }
+  }
+  p_ctx->hop          = p_ctx->size - p_ctx->size * p_ctx->overlap / 100;
+  p_ctx->frame_values = (uint32_t)floor(p_ctx->frame * rate + 0.5);
+  p_ctx->frame_values = (p_ctx->frame_values > 0) ? p_ctx->frame_values : 1;
+  p_ctx->pos          = 0;
+  if ( spectrum_alloc(p_ctx) < 0 )
+  {
+    printf("No memory for the spectra.\n");
+    spectrum_free(p_ctx);
+    return -1;
+  }
+
+  p_ctx->fp = fopen(p_ctx->file_name, "wb");
+  if ( p_ctx->fp == NULL )
+  {
+    perror("fopen(spectrum_file)");
+    spectrum_free(p_ctx);
+    return -1;
+  }
+  fprintf(p_ctx->fp, "# FFT of %u values, Hann, overlap %u%%, bins of %.9g Hz", p_ctx->size, p_ctx->overlap,
+          (p_ctx->size > 0) ? p_ctx->chan_rate[0] / p_ctx->size : 0);
+  if ( p_ctx->streams > 1 && p_ctx->chan_rate[1] != p_ctx->chan_rate[0] )
+  {
+    fprintf(p_ctx->fp, " (%.9g Hz on the second converter)", (p_ctx->size > 0) ? p_ctx->chan_rate[1] / p_ctx->size : 0);
+  }
+  fprintf(p_ctx->fp, "; tones (Hz):");
+  for ( i = 0; i < p_ctx->num_tones; i++ )
+  {
+    fprintf(p_ctx->fp, " %.9g", p_ctx->tones[i]);
+  }
+  fprintf(p_ctx->fp, "\n# index\ttime\tchannel\tsegments\tbins (%u)\ttones (%u)\n",
+          (p_ctx->size > 0) ? p_ctx->size / 2 + 1 : 0, p_ctx->num_tones);
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      spectrum_write
+ *
+ * @brief   Decode the block a chunk at a time, cut at the frames.
+ *
+ * @param   p_sink
+ *          p_block
+ *
+ * @return  0
+ **/
+static int spectrum_write(acq_sink_t *p_sink, const acq_block_t *p_block)
+{
+  spectrum_ctx_t *p_ctx = (spectrum_ctx_t *)p_sink->ctx;
+  const acq_format_t *p_fmt = &p_ctx->fmt;
+  int32_t code[ACQ_MAX_STREAMS][SPECTRUM_CHUNK];
+  uint8_t chan[ACQ_MAX_STREAMS][SPECTRUM_CHUNK];
+  uint32_t num_values = p_block->num_records * p_fmt->record_values;
+  uint32_t lost = ACQ_STATUS_LOST(p_block->status);
+  uint64_t first = 0;
+  uint32_t len = 0;
+  uint32_t off = 0;
+  uint32_t seg = 0;
+  uint32_t n = 0;
+  uint32_t a = 0;
+
+  if ( !(p_block->flags & ACQ_BLOCK_WINDOW) && (p_block->flags & ACQ_BLOCK_STAMPED) && lost > 0 )
+  {
+    spectrum_skip(p_ctx, p_block, lost / p_fmt->decimation);
+  }
+
+  first = p_ctx->pos;
+  for ( n = 0; n < num_values; n += SPECTRUM_CHUNK )
+  {
+    len = (num_values - n > SPECTRUM_CHUNK) ? SPECTRUM_CHUNK : num_values - n;
+    for ( a = 0; a < p_ctx->streams; a++ )
+    {
+      acq_decode(p_fmt, a, p_block->p_data[a] + n / p_fmt->record_values * p_fmt->record_size, first + n, len,
+                 code[a], chan[a]);
+    }
+
+    for ( off = 0; off < len; off += seg )
+    {
+      seg = p_ctx->frame_values - p_ctx->pos % p_ctx->frame_values;
+      seg = (seg < len - off) ? seg : len - off;
+      for ( a = 0; a < p_ctx->streams; a++ )
+      {
+        spectrum_add(p_ctx, a, code[a] + off, chan[a] + off, seg);
+      }
+      p_ctx->pos += seg;
+      if ( p_ctx->pos % p_ctx->frame_values == 0 )
+      {
+        spectrum_frame(p_ctx, p_block, num_values - (n + off + seg));
+      }
+    }
+  }
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      spectrum_close
+ *
+ * @brief
+ *
+ * @param   p_sink
+ *
+ * @return  0, -1 if the file could not be flushed
+ **/
+static int spectrum_close(acq_sink_t *p_sink)
+{
+  spectrum_ctx_t *p_ctx = (spectrum_ctx_t *)p_sink->ctx;
+  int res = 0;
+
+  if ( p_ctx->fp != NULL && fclose(p_ctx->fp) != 0 )
+  {
+    res = -1;
+  }
+  p_ctx->fp = NULL;
+  spectrum_free(p_ctx);
+
+  return res;
+}
+
+/***********************************************************************
+ * @fn      spectrum_destroy
+ *
+ * @brief
+ *
+ * @param   p_sink
+ *
+ * @return  void
+ **/
+static void spectrum_destroy(acq_sink_t *p_sink)
+{
+  spectrum_close(p_sink);
+}
+
+/***********************************************************************
+ * @fn      spectrum_alloc
+ *
+ * @brief   FFT, window and the channels of the capture.
+ *
+ * @param   p_ctx
+ *
+ * @return  0, -1 on error
+ **/
+static int spectrum_alloc(spectrum_ctx_t *p_ctx)
+{
+  spectrum_chan_t *p_ch = NULL;
+  uint32_t bins = p_ctx->size / 2 + 1;
+  uint32_t a = 0;
+  uint32_t c = 0;
+  uint32_t i = 0;
+
+  for ( a = 0; a < p_ctx->streams; a++ )
+  {
+    p_ctx->p_chan[a] = calloc(p_ctx->channels[a], sizeof(spectrum_chan_t));
+    if ( p_ctx->p_chan[a] == NULL )
+    {
+      return -1;
+    }
+    for ( c = 0; c < p_ctx->channels[a]; c++ )
+    {
+      p_ch       = &p_ctx->p_chan[a][c];
+      p_ch->rate = p_ctx->chan_rate[a];
+      for ( i = 0; i < p_ctx->num_tones; i++ )
+      {
+        acq_goertzel_init(&p_ch->tone[i], p_ctx->tones[i] / p_ch->rate);
+      }
+      if ( p_ctx->size > 0 )
+      {
+        p_ch->p_seg   = malloc(p_ctx->size * sizeof(float));
+        p_ch->p_power = calloc(bins, sizeof(float));
+        if ( p_ch->p_seg == NULL || p_ch->p_power == NULL )
+        {
+          return -1;
+        }
+      }
+    }
+  }
+  if ( p_ctx->size == 0 )
+  {
+    return 0;
+  }
+
+  p_ctx->p_fft    = acq_fft_create(p_ctx->size);
+  p_ctx->p_window = malloc(p_ctx->size * sizeof(float));
+  p_ctx->p_re     = malloc(bins * sizeof(float));
+  p_ctx->p_im     = malloc(bins * sizeof(float));
+  if ( p_ctx->p_fft == NULL || p_ctx->p_window == NULL || p_ctx->p_re == NULL || p_ctx->p_im == NULL )
+  {
+    return -1;
+  }
+  p_ctx->gain = 0;
+  for ( i = 0; i < p_ctx->size; i++ )
+  {
+    p_ctx->p_window[i] = 0.5 - 0.5 * cos(2 * M_PI * i / p_ctx->size);
+    p_ctx->gain       += p_ctx->p_window[i];
+  }
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      spectrum_free
+ *
+ * @brief
+ *
+ * @param   p_ctx
+ *
+ * @return  void
+ **/
+static void spectrum_free(spectrum_ctx_t *p_ctx)
+{
+  uint32_t a = 0;
+  uint32_t c = 0;
+
+  for ( a = 0; a < ACQ_MAX_STREAMS; a++ )
+  {
+    if ( p_ctx->p_chan[a] == NULL )
+    {
+      continue;
+    }
+    for ( c = 0; c < p_ctx->channels[a]; c++ )
+    {
+      free(p_ctx->p_chan[a][c].p_seg);
+      free(p_ctx->p_chan[a][c].p_power);
+    }
+    free(p_ctx->p_chan[a]);
+    p_ctx->p_chan[a] = NULL;
+  }
+  acq_fft_destroy(p_ctx->p_fft);
+  free(p_ctx->p_window);
+  free(p_ctx->p_re);
+  free(p_ctx->p_im);
+  p_ctx->p_fft    = NULL;
+  p_ctx->p_window = NULL;
+  p_ctx->p_re     = NULL;
+  p_ctx->p_im     = NULL;
+}
+
+/***********************************************************************
+ * @fn      spectrum_add
+ *
+ * @brief   Values of a stream to their channels, as float. Channels
+ *          cycled or tagged are gathered first, so each one is fed a
+ *          run at a time.
+ *
+ * @param   p_ctx
+ *          stream
+ *          p_code
+ *          p_chan
+ *          num_values - Up to SPECTRUM_CHUNK
+ *
+ * @return  void
+ **/
+static void spectrum_add(spectrum_ctx_t *p_ctx, uint32_t stream, const int32_t *p_code, const uint8_t *p_chan,
+                         uint32_t num_values)
+{
+  uint32_t count[ACQ_MAX_CHANNELS];
+  uint32_t c = 0;
+  uint32_t i = 0;
+
+  if ( p_ctx->fmt.encoding != ACQ_ENC_S24_TAGGED && p_ctx->fmt.num_channels[stream] <= 1 )
+  {
+    for ( i = 0; i < num_values; i++ )
+    {
+      p_ctx->gather[0][i] = p_code[i];
+    }
+    spectrum_feed(p_ctx, &p_ctx->p_chan[stream][0], p_ctx->gather[0], num_values);
+    return;
+  }
+
+  memset(count, 0, sizeof(count));
+  for ( i = 0; i < num_values; i++ )
+  {
+    c = p_chan[i] % ACQ_MAX_CHANNELS;
+    p_ctx->gather[c][count[c]++] = p_code[i];
+  }
+  for ( c = 0; c < p_ctx->channels[stream]; c++ )
+  {
+    if ( count[c] > 0 )
+    {
+      spectrum_feed(p_ctx, &p_ctx->p_chan[stream][c], p_ctx->gather[c], count[c]);
+    }
+  }
+}
+
+/***********************************************************************
+ * @fn      spectrum_feed
+ *
+ * @brief   Values of a channel: into the tones, and into the segment,
+ *          transformed each time it fills up and then slid by the hop.
+ *
+ * @param   p_ctx
+ *          p_ch
+ *          p_x
+ *          num_values
+ *
+ * @return  void
+ **/
+static void spectrum_feed(spectrum_ctx_t *p_ctx, spectrum_chan_t *p_ch, const float *p_x, uint32_t num_values)
+{
+  uint32_t bins = p_ctx->size / 2 + 1;
+  uint32_t len = 0;
+  uint32_t i = 0;
+
+  for ( i = 0; i < p_ctx->num_tones; i++ )
+  {
+    acq_goertzel_add(&p_ch->tone[i], p_x, num_values);
+  }
+  p_ch->values += num_values;
+
+  while ( p_ctx->size > 0 && num_values > 0 )
+  {
+    len = p_ctx->size - p_ch->fill;
+    len = (len < num_values) ? len : num_values;
+    memcpy(p_ch->p_seg + p_ch->fill, p_x, len * sizeof(float));
+    p_ch->fill += len;
+    p_x        += len;
+    num_values -= len;
+    if ( p_ch->fill < p_ctx->size )
+    {
+      break;
+    }
+
+    acq_fft_real(p_ctx->p_fft, p_ch->p_seg, p_ctx->p_window, p_ctx->p_re, p_ctx->p_im);
+    for ( i = 0; i < bins; i++ )
+    {
+      p_ch->p_power[i] += p_ctx->p_re[i] * p_ctx->p_re[i] + p_ctx->p_im[i] * p_ctx->p_im[i];
+    }
+    p_ch->segments++;
+    memmove(p_ch->p_seg, p_ch->p_seg + p_ctx->hop, (p_ctx->size - p_ctx->hop) * sizeof(float));
+    p_ch->fill = p_ctx->size - p_ctx->hop;
+  }
+}
+
+/***********************************************************************
+ * @fn      spectrum_skip
+ *
+ * @brief   Samples lost before the block: their time still counts, and
+ *          nothing runs across them.
+ *
+ * @param   p_ctx
+ *          p_block
+ *          num_values - Of each stream
+ *
+ * @return  void
+ **/
+static void spectrum_skip(spectrum_ctx_t *p_ctx, const acq_block_t *p_block, uint32_t num_values)
+{
+  uint32_t num_block = p_block->num_records * p_ctx->fmt.record_values;
+  uint32_t seg = 0;
+  uint32_t a = 0;
+  uint32_t c = 0;
+
+  for ( a = 0; a < p_ctx->streams; a++ )
+  {
+    for ( c = 0; c < p_ctx->channels[a]; c++ )
+    {
+      spectrum_break(p_ctx, &p_ctx->p_chan[a][c]);
+      p_ctx->p_chan[a][c].fill = 0;
+    }
+  }
+
+  while ( num_values > 0 )
+  {
+    seg = p_ctx->frame_values - p_ctx->pos % p_ctx->frame_values;
+    seg = (seg < num_values) ? seg : num_values;
+    p_ctx->pos += seg;
+    num_values -= seg;
+    if ( p_ctx->pos % p_ctx->frame_values == 0 )
+    {
+      spectrum_frame(p_ctx, p_block, num_values + num_block);
+    }
+  }
+}
+
+/***********************************************************************
+ * @fn      spectrum_break
+ *
+ * @brief   End the run of the tones of a channel.
+ *
+ * @param   p_ctx
+ *          p_ch
+ *
+ * @return  void
+ **/
+static void spectrum_break(spectrum_ctx_t *p_ctx, spectrum_chan_t *p_ch)
+{
+  double amp = 0;
+  uint64_t n = 0;
+  uint32_t i = 0;
+
+  for ( i = 0; i < p_ctx->num_tones; i++ )
+  {
+    n   = p_ch->tone[i].n;
+    amp = acq_goertzel_amplitude(&p_ch->tone[i]);
+    p_ch->tone_power[i] += n * amp * amp;
+    acq_goertzel_init(&p_ch->tone[i], p_ctx->tones[i] / p_ch->rate);
+  }
+  p_ch->tone_values += n;
+}
+
+/***********************************************************************
+ * @fn      spectrum_frame
+ *
+ * @brief   A frame is complete: write the channels that had values in
+ *          it, and start the next one. The segment filling up goes on.
+ *
+ * @param   p_ctx
+ *          p_block - Holding the end of the frame
+ *          after - Values of each stream in the block after the end
+ *
+ * @return  void
+ **/
+static void spectrum_frame(spectrum_ctx_t *p_ctx, const acq_block_t *p_block, uint32_t after)
+{
+  const acq_format_t *p_fmt = &p_ctx->fmt;
+  uint32_t chan_base = (p_fmt->num_channels[0] > 1) ? p_fmt->num_channels[0] : 1;
+  uint32_t bins = p_ctx->size / 2 + 1;
+  spectrum_chan_t *p_ch = NULL;
+  char time[32] = "-";
+  double scale = 0;
+  double lsb = 0;
+  double end = 0;
+  uint32_t a = 0;
+  uint32_t c = 0;
+  uint32_t k = 0;
+
+  if ( (p_block->flags & ACQ_BLOCK_STAMPED) && !(p_block->flags & ACQ_BLOCK_WINDOW) )
+  {
+    end = p_block->real.tv_sec + p_block->real.tv_nsec * 1e-9 - (double)after * p_fmt->decimation / p_fmt->sample_rate;
+    snprintf(time, sizeof(time), "%.6f", end);
+  }
+
+  for ( a = 0; a < p_ctx->streams; a++ )
+  {
+    for ( c = 0; c < p_ctx->channels[a]; c++ )
+    {
+      p_ch = &p_ctx->p_chan[a][c];
+      if ( p_ch->values == 0 )
+      {
+        continue;
+      }
+      lsb = (p_ctx->volts && p_fmt->lsb[a][c] != 0) ? p_fmt->lsb[a][c] : 1;
+
+      fprintf(p_ctx->fp, "%llu\t%s\t%u\t%u", (unsigned long long)(p_ctx->pos * p_ctx->streams), time,
+              c + a * chan_base, p_ch->segments);
+      if ( p_ctx->size > 0 )
+      {
+        /* Amplitude of a sinusoid at the bin: 2 |X| / sum of the window */
+        for ( k = 0; k < bins; k++ )
+        {
+          scale = ((k == 0 || k == bins - 1) ? 1 : 2) / p_ctx->gain * lsb;
+          if ( p_ch->segments > 0 )
+          {
+            fprintf(p_ctx->fp, "\t%.4e", sqrt(p_ch->p_power[k] / p_ch->segments) * scale);
+          }
+          else
+          {
+            fprintf(p_ctx->fp, "\tnan");
+          }
+          p_ch->p_power[k] = 0;
+        }
+      }
+      spectrum_break(p_ctx, p_ch);
+      for ( k = 0; k < p_ctx->num_tones; k++ )
+      {
+        fprintf(p_ctx->fp, "\t%.4e", sqrt(p_ch->tone_power[k] / p_ch->tone_values) * lsb);
+        p_ch->tone_power[k] = 0;
+      }
+      fprintf(p_ctx->fp, "\n");
+      p_ch->tone_values = 0;
+      p_ch->segments    = 0;
+      p_ch->values      = 0;
+    }
+  }
+}
@@ -0,0 +1,439 @@
+/***********************************************************************
+ * INCLUDES
+ **/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include "acq.h"
+
+/***********************************************************************
+ * DEFINES
+ **/
+#define STATS_CHUNK       1024      /* Values decoded at a time */
+#define STATS_MAX_PANES   100       /* Hops in a window */
+#define DEF_WINDOW        1.0       /* s */
+
+/***********************************************************************
+ * TYPEDEFS
+ **/
+/* A window is the last 'num_panes' hops, each summarized on its own as
+ * it fills (a pane): a sliding window merges them at every hop, and
+ * nothing is taken back out of a running sum. */
+typedef struct stats_ctx_t
+{
+  const char   *file_name;
+  int           volts;
+  double        window;         /* s */
+  double        hop;            /* s, 0: the window (tumbling) */
+  double        rate;           /* Values/s of a stream, 0: the source's */
+  FILE         *fp;
+  acq_format_t  fmt;
+  uint32_t      streams;
+  uint32_t      channels[ACQ_MAX_STREAMS];  /* Summarized, tagged: all */
+  uint32_t      pane_values;    /* Values of each stream per hop */
+  uint32_t      num_panes;      /* Hops per window */
+  uint32_t      panes;          /* Hops completed */
+  uint64_t      pos;            /* Values of each stream, plus gaps */
+  acq_summary_t pane[ACQ_MAX_STREAMS][ACQ_MAX_CHANNELS][STATS_MAX_PANES];
+  int32_t       gather[ACQ_MAX_CHANNELS][STATS_CHUNK];
+} stats_ctx_t;
+
+/***********************************************************************
+ * PRIVATE FUNCTIONS PROTOTYPES
+ **/
+static int  stats_open(acq_sink_t *p_sink, const acq_format_t *p_fmt);
+static int  stats_write(acq_sink_t *p_sink, const acq_block_t *p_block);
+static int  stats_close(acq_sink_t *p_sink);
+static void stats_add(stats_ctx_t *p_ctx, uint32_t stream, const int32_t *p_code, const uint8_t *p_chan,
+                      uint32_t num_values);
+static void stats_skip(stats_ctx_t *p_ctx, const acq_block_t *p_block, uint32_t num_values);
+static void stats_hop(stats_ctx_t *p_ctx, const acq_block_t *p_block, uint32_t after);
+
+/***********************************************************************
+ * FUNCTIONS
+ **/
+/***********************************************************************
+ * @fn      sink_stats_create
+ *
+ * @brief   Statistics of every channel over windows of the capture, a
+ *          text line per channel and window: index and wall clock of
+ *          the end of the window ('-' without stamps), channel (those
+ *          of the second stream numbered after those of the first),
+ *          values, mean, standard deviation, RMS, min, max and peak to
+ *          peak. Windows are tumbling, or sliding by a hop
+ *          (sink_stats_configure()); only whole windows are written.
+ *          Samples lost leave a window with fewer values.
+ *
+ * @param   file_name
+ *          volts - Statistics in volts (%.7e) where the source knows
+ *                  the LSB, codes otherwise
+ *
+ * @return  Sink or NULL
+ */
+acq_sink_t *sink_stats_create(const char *file_name, int volts)
+{
+  acq_sink_t *p_sink = calloc(1, sizeof(acq_sink_t));
+  stats_ctx_t *p_ctx = calloc(1, sizeof(stats_ctx_t));
+
+  if ( p_sink == NULL || p_ctx == NULL )
+  {
+    free(p_sink);
+    free(p_ctx);
+    return NULL;
+  }
+
+  p_ctx->file_name = file_name;
+  p_ctx->volts     = volts;
+  p_ctx->window    = DEF_WINDOW;
+
+  p_sink->name  = "stats";
+  p_sink->ctx   = p_ctx;
+  p_sink->open  = stats_open;
+  p_sink->write = stats_write;
+  p_sink->close = stats_close;
+
+  return p_sink;
+}
+
+/***********************************************************************
+ * @fn      sink_stats_configure
+ *
+ * @brief   Between captures, all of the options or none:
+ *            window=SECONDS      Length of a window (default 1)
+ *            hop=SECONDS         A window every hop (default: the
+ *                                window); the window a multiple of it,
+ *                                up to 100 hops
+ *            rate=HZ             Values per second of a stream, where
+ *                                the source doesn't know it (ADS1256
+ *                                cycling channels)
+ *
+ * @param   p_sink
+ *          p_opt
+ *          num_opts
+ *
+ * @return  0, -1 on error
+ **/
+int sink_stats_configure(acq_sink_t *p_sink, const acq_option_t *p_opt, uint32_t num_opts)
+{
+  stats_ctx_t *p_ctx = (stats_ctx_t *)p_sink->ctx;
+  double window = p_ctx->window;
+  double hop = p_ctx->hop;
+  double rate = p_ctx->rate;
+  double ratio = 0;
+  uint32_t i = 0;
+
+  if ( p_ctx->fp != NULL )
+  {
+    return -1;
+  }
+
+  for ( i = 0; i < num_opts; i++ )
+  {
+    if ( strcmp(p_opt[i].key, "window") == 0 )
+    {
+      window = strtod(p_opt[i].value, NULL);
+    }
+    else if ( strcmp(p_opt[i].key, "hop") == 0 )
+    {
+      hop = strtod(p_opt[i].value, NULL);
+    }
+    else if ( strcmp(p_opt[i].key, "rate") == 0 )
+    {
+      rate = strtod(p_opt[i].value, NULL);
+    }
+    else
+    {
+      return -1;
+    }
+  }
+
+  ratio = (hop > 0) ? window / hop : 1;
+  if ( window <= 0 || hop < 0 || rate < 0 || ratio < 1 || ratio > STATS_MAX_PANES ||
+       fabs(ratio - floor(ratio + 0.5)) > 1e-6 * ratio )
+  {
+    return -1;
+  }
+  p_ctx->window = window;
+  p_ctx->hop    = hop;
+  p_ctx->rate   = rate;
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      stats_open
+ *
+ * @brief
+ *
+ * @param   p_sink
+ *          p_fmt
+ *
+ * @return  0, -1 if the file can't be created or the rate is unknown
+ **/
+static int stats_open(acq_sink_t *p_sink, const acq_format_t *p_fmt)
+{
+  stats_ctx_t *p_ctx = (stats_ctx_t *)p_sink->ctx;
+  double hop = (p_ctx->hop > 0) ? p_ctx->hop : p_ctx->window;
+  uint32_t a = 0;
+
+  p_ctx->fmt             = *p_fmt;
+  p_ctx->fmt.sample_rate = (p_ctx->rate > 0) ? p_ctx->rate : p_fmt->sample_rate;
+  if ( p_ctx->fmt.sample_rate <= 0 )
+  {
+    printf("Statistics need the sample rate of the source (rate=).\n");
+    return -1;
+  }
+  p_ctx->streams     = (p_fmt->num_streams > 1) ? p_fmt->num_streams : 1;
+  for ( a = 0; a < p_ctx->streams; a++ )
+  {
+    p_ctx->channels[a] = (p_fmt->num_channels[a] > 1) ? p_fmt->num_channels[a] : 1;
+    p_ctx->channels[a] = (p_fmt->encoding == ACQ_ENC_S24_TAGGED) ? ACQ_MAX_CHANNELS : p_ctx->channels[a];
+  }
+  p_ctx->pane_values = (uint32_t)floor(hop * p_ctx->fmt.sample_rate / p_fmt->decimation + 0.5);
+  p_ctx->pane_values = (p_ctx->pane_values > 0) ? p_ctx->pane_values : 1;
+  p_ctx->num_panes   = (uint32_t)floor(p_ctx->window / hop + 0.5);
+  p_ctx->panes       = 0;
+  p_ctx->pos         = 0;
+  memset(p_ctx->pane, 0, sizeof(p_ctx->pane));
+
+  p_ctx->fp = fopen(p_ctx->file_name, "wb");
+  if ( p_ctx->fp == NULL )
+  {
+    perror("fopen(stats_file)");
+    return -1;
+  }
+  fprintf(p_ctx->fp, "# index\ttime\tchannel\tvalues\tmean\tstd\trms\tmin\tmax\tp2p\n");
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      stats_write
+ *
+ * @brief   Decode the block a chunk at a time, cut at the hops.
+ *
+ * @param   p_sink
+ *          p_block
+ *
+ * @return  0
+ **/
+static int stats_write(acq_sink_t *p_sink, const acq_block_t *p_block)
+{
+  stats_ctx_t *p_ctx = (stats_ctx_t *)p_sink->ctx;
+  const acq_format_t *p_fmt = &p_ctx->fmt;
+  int32_t code[ACQ_MAX_STREAMS][STATS_CHUNK];
+  uint8_t chan[ACQ_MAX_STREAMS][STATS_CHUNK];
+  uint32_t num_values = p_block->num_records * p_fmt->record_values;
+  uint32_t lost = ACQ_STATUS_LOST(p_block->status);
+  uint64_t first = 0;
+  uint32_t len = 0;
+  uint32_t off = 0;
+  uint32_t seg = 0;
+  uint32_t n = 0;
+  uint32_t a = 0;
+
+  if ( !(p_block->flags & ACQ_BLOCK_WINDOW) && (p_block->flags & ACQ_BLOCK_STAMPED) && lost > 0 )
+  {
+    stats_skip(p_ctx, p_block, lost / p_fmt->decimation);
+  }
+
+  first = p_ctx->pos;
+  for ( n = 0; n < num_values; n += STATS_CHUNK )
+  {
+    len = (num_values - n > STATS_CHUNK) ? STATS_CHUNK : num_values - n;
+    for ( a = 0; a < p_ctx->streams; a++ )
+    {
+      acq_decode(p_fmt, a, p_block->p_data[a] + n / p_fmt->record_values * p_fmt->record_size, first + n, len,
+                 code[a], chan[a]);
+    }
+
+    for ( off = 0; off < len; off += seg )
+    {
+      seg = p_ctx->pane_values - p_ctx->pos % p_ctx->pane_values;
+      seg = (seg < len - off) ? seg : len - off;
+      for ( a = 0; a < p_ctx->streams; a++ )
+      {
+        stats_add(p_ctx, a, code[a] + off, chan[a] + off, seg);
+      }
+      p_ctx->pos += seg;
+      if ( p_ctx->pos % p_ctx->pane_values == 0 )
+      {
+        stats_hop(p_ctx, p_block, num_values - (n + off + seg));
+      }
+    }
+  }
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      stats_close
+ *
+ * @brief
+ *
+ * @param   p_sink
+ *
+ * @return  0, -1 if the file could not be flushed
+ **/
+static int stats_close(acq_sink_t *p_sink)
+{
+  stats_ctx_t *p_ctx = (stats_ctx_t *)p_sink->ctx;
+  int res = 0;
+
+  if ( p_ctx->fp != NULL && fclose(p_ctx->fp) != 0 )
+  {
+    res = -1;
+  }
+  p_ctx->fp = NULL;
+
+  return res;
+}
+
+/***********************************************************************
+ * @fn      stats_add
+ *
+ * @brief   Values of a stream into the current pane of their channels.
+ *          Channels cycled or tagged are gathered first, so each one is
+ *          summarized a run at a time.
+ *
+ * @param   p_ctx
+ *          stream
+ *          p_code
+ *          p_chan
+ *          num_values - Up to STATS_CHUNK
+ *
+ * @return  void
+ **/
+static void stats_add(stats_ctx_t *p_ctx, uint32_t stream, const int32_t *p_code, const uint8_t *p_chan,
+                      uint32_t num_values)
+{
+  uint32_t count[ACQ_MAX_CHANNELS];
+  uint32_t cur = p_ctx->panes % p_ctx->num_panes;
+  uint32_t c = 0;
+  uint32_t i = 0;
+
+  if ( p_ctx->fmt.encoding != ACQ_ENC_S24_TAGGED && p_ctx->fmt.num_channels[stream] <= 1 )
+  {
+    acq_summary_add(&p_ctx->pane[stream][0][cur], p_code, num_values);
+    return;
+  }
+
+  memset(count, 0, sizeof(count));
+  for ( i = 0; i < num_values; i++ )
+  {
+    c = p_chan[i] % ACQ_MAX_CHANNELS;
+    p_ctx->gather[c][count[c]++] = p_code[i];
+  }
+  for ( c = 0; c < p_ctx->channels[stream]; c++ )
+  {
+    if ( count[c] > 0 )
+    {
+      acq_summary_add(&p_ctx->pane[stream][c][cur], p_ctx->gather[c], count[c]);
+    }
+  }
+}
+
+/***********************************************************************
+ * @fn      stats_skip
+ *
+ * @brief   Samples lost before the block: their time still counts.
+ *
+ * @param   p_ctx
+ *          p_block
+ *          num_values - Of each stream
+ *
+ * @return  void
+ **/
+static void stats_skip(stats_ctx_t *p_ctx, const acq_block_t *p_block, uint32_t num_values)
+{
+  uint32_t num_block = p_block->num_records * p_ctx->fmt.record_values;
+  uint32_t seg = 0;
+
+  while ( num_values > 0 )
+  {
+    seg = p_ctx->pane_values - p_ctx->pos % p_ctx->pane_values;
+    seg = (seg < num_values) ? seg : num_values;
+    p_ctx->pos += seg;
+    num_values -= seg;
+    if ( p_ctx->pos % p_ctx->pane_values == 0 )
+    {
+      stats_hop(p_ctx, p_block, num_values + num_block);
+    }
+  }
+}
+
+/***********************************************************************
+ * @fn      stats_hop
+ *
+ * @brief   A pane is complete: once there are enough of them, write
+ *          the window they make, then start the next pane in place of
+ *          the oldest.
+ *
+ * @param   p_ctx
+ *          p_block - Holding the end of the pane
+ *          after - Values of each stream in the block after the end
+ *
+ * @return  void
+ **/
+static void stats_hop(stats_ctx_t *p_ctx, const acq_block_t *p_block, uint32_t after)
+{
+  const acq_format_t *p_fmt = &p_ctx->fmt;
+  uint32_t chan_base = (p_fmt->num_channels[0] > 1) ? p_fmt->num_channels[0] : 1;
+  char time[32] = "-";
+  acq_summary_t win;
+  double lsb = 0;
+  double end = 0;
+  uint32_t a = 0;
+  uint32_t c = 0;
+  uint32_t k = 0;
+
+  p_ctx->panes++;
+  if ( p_ctx->panes >= p_ctx->num_panes )
+  {
+    if ( (p_block->flags & ACQ_BLOCK_STAMPED) && !(p_block->flags & ACQ_BLOCK_WINDOW) )
+    {
+      end = p_block->real.tv_sec + p_block->real.tv_nsec * 1e-9 - (double)after * p_fmt->decimation / p_fmt->sample_rate;
+      snprintf(time, sizeof(time), "%.6f", end);
+    }
+
+    for ( a = 0; a < p_ctx->streams; a++ )
+    {
+      for ( c = 0; c < p_ctx->channels[a]; c++ )
+      {
+        acq_summary_reset(&win);
+        for ( k = 0; k < p_ctx->num_panes; k++ )
+        {
+          acq_summary_merge(&win, &p_ctx->pane[a][c][k]);
+        }
+        if ( win.n == 0 )
+        {
+          continue;
+        }
+
+        fprintf(p_ctx->fp, "%llu\t%s\t%u\t%llu\t", (unsigned long long)(p_ctx->pos * p_ctx->streams), time,
+                c + a * chan_base, (unsigned long long)win.n);
+        lsb = p_ctx->volts ? p_fmt->lsb[a][c] : 0;
+        if ( lsb != 0 )
+        {
+          fprintf(p_ctx->fp, "%.7e\t%.7e\t%.7e\t%.7e\t%.7e\t%.7e\n", win.mean * lsb, acq_summary_std(&win) * lsb,
+                  acq_summary_rms(&win) * lsb, win.min * lsb, win.max * lsb, ((double)win.max - win.min) * lsb);
+        }
+        else
+        {
+          fprintf(p_ctx->fp, "%.3f\t%.3f\t%.3f\t%d\t%d\t%d\n", win.mean, acq_summary_std(&win),
+                  acq_summary_rms(&win), win.min, win.max, win.max - win.min);
+        }
+      }
+    }
+  }
+
+  for ( a = 0; a < p_ctx->streams; a++ )
+  {
+    for ( c = 0; c < p_ctx->channels[a]; c++ )
+    {
+      acq_summary_reset(&p_ctx->pane[a][c][p_ctx->panes % p_ctx->num_panes]);
+    }
+  }
+}
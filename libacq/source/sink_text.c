@@ -0,0 +1,325 @@
+/***********************************************************************
+ * INCLUDES
+ **/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "acq.h"
+
+/***********************************************************************
+ * DEFINES
+ **/
+#define SAVE_CHUNK      1024
+
+/***********************************************************************
+ * TYPEDEFS
+ **/
+typedef struct text_ctx_t
+{
+  const char  *file_name;
+  const char  *times_name;    /* NULL: no times file */
+  int          volts;
+  FILE        *fp;
+  FILE        *fp_time;
+  acq_format_t fmt;
+  uint64_t     pos;           /* Values of each stream written, plus gaps */
+} text_ctx_t;
+
+/***********************************************************************
+ * PRIVATE FUNCTIONS PROTOTYPES
+ **/
+static int  text_open(acq_sink_t *p_sink, const acq_format_t *p_fmt);
+static int  text_write(acq_sink_t *p_sink, const acq_block_t *p_block);
+static int  text_close(acq_sink_t *p_sink);
+static void text_values(text_ctx_t *p_ctx, const acq_block_t *p_block);
+static void text_envelopes(text_ctx_t *p_ctx, const acq_block_t *p_block);
+
+/***********************************************************************
+ * FUNCTIONS
+ **/
+/***********************************************************************
+ * @fn      sink_text_create
+ *
+ * @brief   Text files sink. The data file gets one line per value:
+ *          index and value, plus the channel index between them when
+ *          cycling through channels or interleaving streams (channels
+ *          of the second stream numbered after those of the first).
+ *          Envelope records give index, min, max and mean. The times
+ *          file gets a line per stamped block: sequence, index of its
+ *          first value, records, device clock and wall clock of its
+ *          last sample, then samples lost, device events and peak; a
+ *          trigger window line has sequence, index, values, index of
+ *          the trigger, clock and wall clock of the trigger and events.
+ *          Samples lost in a block are marked with a '#' line before it
+ *          and skipped by the index, which keeps counting sample periods.
+ *
+ * @param   file_name
+ *          times_name - NULL: no times file
+ *          volts - Values in volts (%.7e) where the source knows the LSB
+ *
+ * @return  Sink or NULL
+ */
+acq_sink_t *sink_text_create(const char *file_name, const char *times_name, int volts)
+{
+  acq_sink_t *p_sink = calloc(1, sizeof(acq_sink_t));
+  text_ctx_t *p_ctx = calloc(1, sizeof(text_ctx_t));
+
+  if ( p_sink == NULL || p_ctx == NULL )
+  {
+    free(p_sink);
+    free(p_ctx);
+    return NULL;
+  }
+
+  p_ctx->file_name  = file_name;
+  p_ctx->times_name = times_name;
+  p_ctx->volts      = volts;
+
+  p_sink->name  = "text";
+  p_sink->ctx   = p_ctx;
+  p_sink->open  = text_open;
+  p_sink->write = text_write;
+  p_sink->close = text_close;
+
+  return p_sink;
+}
+
+/***********************************************************************
+ * @fn      sink_text_values
+ *
+ * @brief   Index reached by the last capture: values of every stream
+ *          written, plus the values skipped by gaps.
+ *
+ * @param   p_sink
+ *
+ * @return
+ **/
+uint64_t sink_text_values(acq_sink_t *p_sink)
+{
+  text_ctx_t *p_ctx = (text_ctx_t *)p_sink->ctx;
+
+  return p_ctx->pos * ((p_ctx->fmt.num_streams > 1) ? p_ctx->fmt.num_streams : 1);
+}
+
+/***********************************************************************
+ * @fn      text_open
+ *
+ * @brief
+ *
+ * @param   p_sink
+ *          p_fmt
+ *
+ * @return  0, -1 if a file can't be created
+ **/
+static int text_open(acq_sink_t *p_sink, const acq_format_t *p_fmt)
+{
+  text_ctx_t *p_ctx = (text_ctx_t *)p_sink->ctx;
+
+  p_ctx->fmt = *p_fmt;
+  p_ctx->pos = 0;
+
+  p_ctx->fp = fopen(p_ctx->file_name, "wb");
+  if ( p_ctx->fp == NULL )
+  {
+    perror("fopen(data_file)");
+    return -1;
+  }
+
+  if ( p_ctx->times_name != NULL )
+  {
+    p_ctx->fp_time = fopen(p_ctx->times_name, "wb");
+    if ( p_ctx->fp_time == NULL )
+    {
+      perror("fopen(times_file)");
+      fclose(p_ctx->fp);
+      p_ctx->fp = NULL;
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      text_write
+ *
+ * @brief
+ *
+ * @param   p_sink
+ *          p_block
+ *
+ * @return  0
+ **/
+static int text_write(acq_sink_t *p_sink, const acq_block_t *p_block)
+{
+  text_ctx_t *p_ctx = (text_ctx_t *)p_sink->ctx;
+  uint32_t streams = (p_ctx->fmt.num_streams > 1) ? p_ctx->fmt.num_streams : 1;
+  uint32_t lost = ACQ_STATUS_LOST(p_block->status);
+  uint64_t index = 0;
+
+  if ( p_block->flags & ACQ_BLOCK_WINDOW )
+  {
+    index = p_ctx->pos * streams;
+    if ( p_ctx->fp_time != NULL )
+    {
+      fprintf(p_ctx->fp_time, "%u\t%llu\t%u\t%llu\t%llu\t%ld.%09ld\t%u\n", p_block->seq, (unsigned long long)index,
+              p_block->num_records * p_ctx->fmt.record_values, (unsigned long long)(index + p_block->trig_index),
+              (unsigned long long)p_block->cycles, (long)p_block->real.tv_sec, p_block->real.tv_nsec,
+              ACQ_STATUS_EVENTS(p_block->status));
+    }
+  }
+  else if ( p_block->flags & ACQ_BLOCK_STAMPED )
+  {
+    if ( lost > 0 )
+    {
+      fprintf(p_ctx->fp, "# gap: %u samples lost in block %u\n", lost, p_block->seq);
+      p_ctx->pos += lost / p_ctx->fmt.decimation;
+    }
+
+    index = p_ctx->pos * streams;
+    if ( p_ctx->fp_time != NULL )
+    {
+      fprintf(p_ctx->fp_time, "%u\t%llu\t%u\t%llu\t%ld.%09ld\t%u\t%u\t%u\n", p_block->seq, (unsigned long long)index,
+              p_block->num_records * streams, (unsigned long long)p_block->cycles, (long)p_block->real.tv_sec,
+              p_block->real.tv_nsec, lost, ACQ_STATUS_EVENTS(p_block->status), ACQ_STATUS_PEAK(p_block->status));
+    }
+  }
+
+  if ( p_ctx->fmt.encoding == ACQ_ENC_U16_ENV )
+  {
+    text_envelopes(p_ctx, p_block);
+  }
+  else
+  {
+    text_values(p_ctx, p_block);
+  }
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      text_close
+ *
+ * @brief
+ *
+ * @param   p_sink
+ *
+ * @return  0, -1 if the data could not be flushed
+ **/
+static int text_close(acq_sink_t *p_sink)
+{
+  text_ctx_t *p_ctx = (text_ctx_t *)p_sink->ctx;
+  int res = 0;
+
+  if ( p_ctx->fp_time != NULL && fclose(p_ctx->fp_time) != 0 )
+  {
+    res = -1;
+  }
+  if ( p_ctx->fp != NULL && fclose(p_ctx->fp) != 0 )
+  {
+    res = -1;
+  }
+  p_ctx->fp      = NULL;
+  p_ctx->fp_time = NULL;
+
+  return res;
+}
+
+/***********************************************************************
+ * @fn      text_values
+ *
+ * @brief   Decode the block a chunk at a time and print its values,
+ *          streams interleaved value by value.
+ *
+ * @param   p_ctx
+ *          p_block
+ *
+ * @return  void
+ **/
+static void text_values(text_ctx_t *p_ctx, const acq_block_t *p_block)
+{
+  int32_t code[ACQ_MAX_STREAMS][SAVE_CHUNK];
+  uint8_t chan[ACQ_MAX_STREAMS][SAVE_CHUNK];
+  float   volts[ACQ_MAX_STREAMS][SAVE_CHUNK];
+  const acq_format_t *p_fmt = &p_ctx->fmt;
+  uint32_t streams = (p_fmt->num_streams > 1) ? p_fmt->num_streams : 1;
+  uint32_t num_values = p_block->num_records * p_fmt->record_values;
+  uint32_t tagged = (p_fmt->num_channels[0] > 1 || streams > 1);
+  uint32_t chan_base = (p_fmt->num_channels[0] > 1) ? p_fmt->num_channels[0] : 1;
+  int volts_out = (p_ctx->volts && p_fmt->lsb[0][0] != 0);
+  int is_signed = (p_fmt->encoding == ACQ_ENC_S24_TAGGED || p_fmt->encoding == ACQ_ENC_S24_PACKED);
+  uint64_t pos = p_ctx->pos;
+  uint32_t n = 0;
+  uint32_t i = 0;
+  uint32_t a = 0;
+
+  for ( n = 0; n < num_values; n += SAVE_CHUNK )
+  {
+    uint32_t len = (num_values - n > SAVE_CHUNK) ? SAVE_CHUNK : num_values - n;
+
+    for ( a = 0; a < streams; a++ )
+    {
+      acq_decode(p_fmt, a, p_block->p_data[a] + n / p_fmt->record_values * p_fmt->record_size, pos + n, len,
+                 code[a], chan[a]);
+      if ( volts_out )
+      {
+        acq_to_volts(p_fmt, a, code[a], chan[a], volts[a], len);
+      }
+    }
+
+    for ( i = 0; i < len; i++ )
+    {
+      for ( a = 0; a < streams; a++ )
+      {
+        if ( tagged )
+        {
+          fprintf(p_ctx->fp, "%llu\t%u\t", (unsigned long long)((pos + n + i) * streams + a),
+                  chan[a][i] + a * chan_base);
+        }
+        else
+        {
+          fprintf(p_ctx->fp, "%llu\t", (unsigned long long)(pos + n + i));
+        }
+
+        if ( volts_out )
+        {
+          fprintf(p_ctx->fp, "%.7e\n", volts[a][i]);
+        }
+        else if ( is_signed )
+        {
+          fprintf(p_ctx->fp, "%d\n", code[a][i]);
+        }
+        else
+        {
+          fprintf(p_ctx->fp, "%u\n", (uint32_t)code[a][i]);
+        }
+      }
+    }
+  }
+
+  p_ctx->pos += num_values;
+}
+
+/***********************************************************************
+ * @fn      text_envelopes
+ *
+ * @brief   Envelope records: index, min, max and mean.
+ *
+ * @param   p_ctx
+ *          p_block
+ *
+ * @return  void
+ **/
+static void text_envelopes(text_ctx_t *p_ctx, const acq_block_t *p_block)
+{
+  uint32_t i = 0;
+
+  for ( i = 0; i < p_block->num_records; i++ )
+  {
+    uint16_t rec[4];
+
+    memcpy(rec, p_block->p_data[0] + i * p_ctx->fmt.record_size, sizeof(rec));
+    fprintf(p_ctx->fp, "%llu\t%u\t%u\t%u\n", (unsigned long long)p_ctx->pos++, rec[0], rec[1], rec[2]);
+  }
+}
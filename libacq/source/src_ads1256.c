@@ -0,0 +1,496 @@
+/***********************************************************************
+ * INCLUDES
+ **/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include "acq.h"
+#include "acq_ads1256.h"
+#include "conf.h"
+#include "ads1256.h"
+#include "spi_interface.h"
+
+/***********************************************************************
+ * DEFINES
+ **/
+#define DEVICE_MAX_LEN      64
+#define SAMPLE_WORD_SIZE    4     /* Code and channel index, as the PRU stores them */
+#define NS_PER_S            1000000000
+
+/***********************************************************************
+ * TYPEDEFS
+ **/
+typedef struct spi_ctx_t
+{
+  ads_config_t    cfg;
+  uint32_t        chan_list[ADS_CHAN_MAX];
+  uint32_t        num_channels;
+  char            device[DEVICE_MAX_LEN];
+  int             opened;
+
+  /* Capture */
+  int             running;
+  int             stopping;
+  uint32_t        num_samples;    /* 0: until stopped */
+  uint32_t        done;
+  uint32_t        seq;
+  uint32_t        block_len;
+  uint32_t        fill;           /* Samples of the block being read */
+  uint32_t        chan;           /* List index of the next sample */
+  uint32_t       *p_buf;
+  struct timespec mono0;
+  struct timespec last;           /* CLOCK_MONOTONIC of the last sample */
+} spi_ctx_t;
+
+/***********************************************************************
+ * GLOBALS
+ **/
+/* Descriptor of the ADS1256 driver (conf.h) */
+volatile int SPI_FD = -1;
+
+/***********************************************************************
+ * PRIVATE FUNCTIONS PROTOTYPES
+ **/
+static int  spi_src_open(acq_source_t *p_src);
+static int  spi_src_configure(acq_source_t *p_src, const acq_option_t *p_opt, uint32_t num_opts);
+static int  spi_src_start(acq_source_t *p_src, uint32_t num_samples, uint32_t block_len);
+static int  spi_src_read_block(acq_source_t *p_src, acq_block_t *p_block, int timeout_ms);
+static void spi_src_stop(acq_source_t *p_src);
+static void spi_src_close(acq_source_t *p_src);
+static int  spi_src_set(spi_ctx_t *p_ctx, const char *key, const char *value);
+static void spi_src_write_config(spi_ctx_t *p_ctx);
+static void spi_src_fill_block(acq_source_t *p_src, acq_block_t *p_block);
+
+/***********************************************************************
+ * FUNCTIONS
+ **/
+/***********************************************************************
+ * @fn      src_ads1256_create
+ *
+ * @brief   ADS1256 read by the host through spidev or the McSPI backend,
+ *          DRDY polled on its GPIO. Options:
+ *            device=PATH         spidev path or "mcspi0" (default conf.h)
+ *            channels=MUX_LIST   P[-N][:GAIN],... (default AIN0 - AINCOM)
+ *            rate=SPS            2.5 - 30000 (default 30000)
+ *            buffer=0|1          Analog input buffer
+ *            calibration=CAL     none, self, offset, gain, sysoffset, sysgain
+ *          Blocks are stamped with CLOCK_MONOTONIC in ns.
+ *
+ * @param   void
+ *
+ * @return  Source or NULL
+ */
+acq_source_t *src_ads1256_create(void)
+{
+  acq_source_t *p_src = calloc(1, sizeof(acq_source_t));
+  spi_ctx_t *p_ctx = calloc(1, sizeof(spi_ctx_t));
+
+  if ( p_src == NULL || p_ctx == NULL )
+  {
+    free(p_src);
+    free(p_ctx);
+    return NULL;
+  }
+
+  p_ctx->cfg.status = 0x00;
+  p_ctx->cfg.mux    = ADS_MUX(0, ADS_AINCOM);
+  p_ctx->cfg.adcon  = 0x00;
+  p_ctx->cfg.drate  = ADS_DRATE_30K;
+  p_ctx->cfg.io     = 0xE1;
+  p_ctx->cfg.cal    = 0;
+  p_ctx->chan_list[0] = CHAN_ENTRY(ADS_MUX(0, ADS_AINCOM), 0);
+  p_ctx->num_channels = 1;
+  strcpy(p_ctx->device, SPI_DEVICE);
+
+  p_src->name       = "ads1256";
+  p_src->ctx        = p_ctx;
+  p_src->open       = spi_src_open;
+  p_src->configure  = spi_src_configure;
+  p_src->start      = spi_src_start;
+  p_src->read_block = spi_src_read_block;
+  p_src->stop       = spi_src_stop;
+  p_src->event_fd   = NULL;
+  p_src->close      = spi_src_close;
+
+  return p_src;
+}
+
+/***********************************************************************
+ * @fn      spi_src_open
+ *
+ * @brief   Open the SPI bus and write the registers.
+ *
+ * @param   p_src
+ *
+ * @return  0, -1 on error
+ **/
+static int spi_src_open(acq_source_t *p_src)
+{
+  spi_ctx_t *p_ctx = (spi_ctx_t *)p_src->ctx;
+  spi_config_t spi_config;
+  int fd = 0;
+
+  fd = spi_open(p_ctx->device);
+  if ( fd < 0 )
+  {
+    return -1;
+  }
+
+  /* SPI Settings */
+  memset(&spi_config, 0, sizeof(spi_config_t));
+  spi_config.clk_freq       = SPI_CLOCK_FREQ_HZ;
+  spi_config.clk_mode       = SPI_CLOCK_MODE;
+  spi_config.endianess      = SPI_ENDIANNESS;
+  spi_config.bits_per_word  = SPI_BITS_PER_WORD;
+  spi_config.cs_active_mode = SPI_CS_ACT_MODE;
+  if ( spi_set_config(fd, &spi_config) < 0 )
+  {
+    spi_close(fd);
+    return -1;
+  }
+  SPI_FD = fd;
+
+  if ( ads1256_wait_drdy() < 0 )
+  {
+    spi_close(fd);
+    SPI_FD = -1;
+    return -1;
+  }
+  ads1256_send_cmd(ADS1256_CMD_SDATAC);
+  spi_src_write_config(p_ctx);
+  p_ctx->opened = 1;
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      spi_src_configure
+ *
+ * @brief   Stage the options, or write the registers at once when the
+ *          bus is open. Nothing changes if one of them is invalid.
+ *
+ * @param   p_src
+ *          p_opt
+ *          num_opts
+ *
+ * @return  0, -1 on error or while capturing
+ **/
+static int spi_src_configure(acq_source_t *p_src, const acq_option_t *p_opt, uint32_t num_opts)
+{
+  spi_ctx_t *p_ctx = (spi_ctx_t *)p_src->ctx;
+  spi_ctx_t conf = *p_ctx;
+  uint32_t i = 0;
+
+  if ( p_ctx->running )
+  {
+    return -1;
+  }
+
+  for ( i = 0; i < num_opts; i++ )
+  {
+    if ( spi_src_set(&conf, p_opt[i].key, p_opt[i].value) < 0 )
+    {
+      return -1;
+    }
+  }
+  *p_ctx = conf;
+
+  if ( p_ctx->opened )
+  {
+    spi_src_write_config(p_ctx);
+  }
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      spi_src_start
+ *
+ * @brief   Restart the conversions on the first channel of the list.
+ *
+ * @param   p_src
+ *          num_samples - 0: until stopped
+ *          block_len
+ *
+ * @return  0, -1 on error
+ **/
+static int spi_src_start(acq_source_t *p_src, uint32_t num_samples, uint32_t block_len)
+{
+  spi_ctx_t *p_ctx = (spi_ctx_t *)p_src->ctx;
+  acq_format_t *p_fmt = &p_src->fmt;
+  uint8_t regs[2];
+  uint32_t c = 0;
+
+  block_len = (block_len == 0) ? 1 : block_len;
+  free(p_ctx->p_buf);
+  p_ctx->p_buf = malloc(block_len * SAMPLE_WORD_SIZE);
+  if ( p_ctx->p_buf == NULL )
+  {
+    perror("malloc(block)");
+    return -1;
+  }
+
+  /* Samples tagged with their channel, as the PRU program stores them */
+  memset(p_fmt, 0, sizeof(acq_format_t));
+  p_fmt->encoding         = ACQ_ENC_S24_TAGGED;
+  p_fmt->record_size      = SAMPLE_WORD_SIZE;
+  p_fmt->record_values    = 1;
+  p_fmt->decimation       = 1;
+  p_fmt->num_streams      = 1;
+  p_fmt->num_channels[0]  = p_ctx->num_channels;
+  p_fmt->sample_rate      = (p_ctx->num_channels > 1) ? 0 : ads_data_rate(p_ctx->cfg.drate);
+  p_fmt->clock_hz         = NS_PER_S;
+  for ( c = 0; c < ADS_CHAN_MAX && c < ACQ_MAX_CHANNELS; c++ )
+  {
+    p_fmt->lsb[0][c] = ADS_LSB(CHAN_PGA(p_ctx->chan_list[c % p_ctx->num_channels]));
+  }
+
+  regs[0] = CHAN_MUX(p_ctx->chan_list[0]);
+  regs[1] = (uint8_t)(p_ctx->chan_list[0] >> 8);
+  ads1256_write_registers(ADS1256_REG_MUX, regs, 2);
+  ads1256_send_cmd(ADS1256_CMD_SYNC);
+  ads1256_send_cmd(ADS1256_CMD_WAKEUP);
+
+  p_ctx->num_samples = num_samples;
+  p_ctx->block_len   = block_len;
+  p_ctx->done        = 0;
+  p_ctx->seq         = 0;
+  p_ctx->fill        = 0;
+  p_ctx->chan        = 0;
+  p_ctx->stopping    = 0;
+  p_ctx->running     = 1;
+  clock_gettime(CLOCK_MONOTONIC, &p_ctx->mono0);
+  p_ctx->last = p_ctx->mono0;
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      spi_src_read_block
+ *
+ * @brief   Read samples until the block is full. The reads block on
+ *          DRDY: with a timeout the block is left part full and the
+ *          call returns after it, having read at least one sample.
+ *
+ * @param   p_src
+ *          p_block
+ *          timeout_ms
+ *
+ * @return  ACQ_READ_..., -1 if DRDY timed out
+ **/
+static int spi_src_read_block(acq_source_t *p_src, acq_block_t *p_block, int timeout_ms)
+{
+  spi_ctx_t *p_ctx = (spi_ctx_t *)p_src->ctx;
+  struct timespec t0;
+  int32_t code = 0;
+  uint32_t next = 0;
+
+  if ( !p_ctx->running )
+  {
+    return ACQ_READ_END;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+
+  while ( !p_ctx->stopping && p_ctx->fill < p_ctx->block_len &&
+          (p_ctx->num_samples == 0 || p_ctx->done < p_ctx->num_samples) )
+  {
+    if ( ads1256_wait_drdy() < 0 )
+    {
+      p_ctx->running = 0;
+      return -1;
+    }
+
+    /* Cycling: the conversion read is of the channel selected before */
+    if ( p_ctx->num_channels > 1 )
+    {
+      next = (p_ctx->chan + 1) % p_ctx->num_channels;
+      code = ads1256_read_next(CHAN_MUX(p_ctx->chan_list[next]), (uint8_t)(p_ctx->chan_list[next] >> 8));
+    }
+    else
+    {
+      code = ads1256_read_data();
+    }
+    clock_gettime(CLOCK_MONOTONIC, &p_ctx->last);
+
+    p_ctx->p_buf[p_ctx->fill++] = ((uint32_t)code & 0x00FFFFFF) | (p_ctx->chan << 24);
+    p_ctx->chan = next;
+    p_ctx->done++;
+
+    if ( timeout_ms >= 0 && p_ctx->fill < p_ctx->block_len &&
+         timespec_diff(&p_ctx->last, &t0) * 1000 >= timeout_ms )
+    {
+      return ACQ_READ_AGAIN;
+    }
+  }
+
+  /* Full block, or the samples left when the capture ended */
+  if ( p_ctx->fill > 0 )
+  {
+    spi_src_fill_block(p_src, p_block);
+    return ACQ_READ_BLOCK;
+  }
+
+  p_ctx->running = 0;
+  p_src->stats.stopped = p_ctx->stopping;
+  p_src->stats.seconds = timespec_diff(&p_ctx->last, &p_ctx->mono0);
+
+  return ACQ_READ_END;
+}
+
+/***********************************************************************
+ * @fn      spi_src_stop
+ *
+ * @brief
+ *
+ * @param   p_src
+ *
+ * @return  void
+ **/
+static void spi_src_stop(acq_source_t *p_src)
+{
+  spi_ctx_t *p_ctx = (spi_ctx_t *)p_src->ctx;
+
+  p_ctx->stopping = p_ctx->running;
+}
+
+/***********************************************************************
+ * @fn      spi_src_close
+ *
+ * @brief
+ *
+ * @param   p_src
+ *
+ * @return  void
+ **/
+static void spi_src_close(acq_source_t *p_src)
+{
+  spi_ctx_t *p_ctx = (spi_ctx_t *)p_src->ctx;
+
+  if ( p_ctx->opened )
+  {
+    spi_close(SPI_FD);
+    SPI_FD = -1;
+    p_ctx->opened = 0;
+  }
+  free(p_ctx->p_buf);
+  p_ctx->p_buf = NULL;
+}
+
+/***********************************************************************
+ * @fn      spi_src_set
+ *
+ * @brief   One option into the settings.
+ *
+ * @param   p_ctx
+ *          key
+ *          value
+ *
+ * @return  0, -1 if the key is unknown or the value invalid
+ **/
+static int spi_src_set(spi_ctx_t *p_ctx, const char *key, const char *value)
+{
+  int n = 0;
+
+  if ( strcmp(key, "rate") == 0 )
+  {
+    return ads_parse_data_rate(value, &p_ctx->cfg.drate);
+  }
+  else if ( strcmp(key, "channels") == 0 )
+  {
+    n = ads_parse_channels(value, p_ctx->chan_list);
+    if ( n < 0 )
+    {
+      return -1;
+    }
+    p_ctx->num_channels = n;
+    p_ctx->cfg.mux   = CHAN_MUX(p_ctx->chan_list[0]);
+    p_ctx->cfg.adcon = (uint8_t)(p_ctx->chan_list[0] >> 8);
+    return 0;
+  }
+  else if ( strcmp(key, "buffer") == 0 )
+  {
+    p_ctx->cfg.status = atoi(value) ? (p_ctx->cfg.status | ADS_STATUS_BUFEN) : (p_ctx->cfg.status & ~ADS_STATUS_BUFEN);
+    return 0;
+  }
+  else if ( strcmp(key, "calibration") == 0 )
+  {
+    return ads_parse_calibration(value, &p_ctx->cfg.cal);
+  }
+  else if ( strcmp(key, "device") == 0 && !p_ctx->opened && strlen(value) < DEVICE_MAX_LEN )
+  {
+    strcpy(p_ctx->device, value);
+    return 0;
+  }
+
+  return -1;
+}
+
+/***********************************************************************
+ * @fn      spi_src_write_config
+ *
+ * @brief   STATUS to IO in one WREG, then the calibration if any.
+ *
+ * @param   p_ctx
+ *
+ * @return  void
+ **/
+static void spi_src_write_config(spi_ctx_t *p_ctx)
+{
+  uint8_t regs[5];
+
+  regs[0] = p_ctx->cfg.status;
+  regs[1] = p_ctx->cfg.mux;
+  regs[2] = p_ctx->cfg.adcon;
+  regs[3] = p_ctx->cfg.drate;
+  regs[4] = p_ctx->cfg.io;
+  ads1256_write_registers(ADS1256_REG_STATUS, regs, 5);
+
+  if ( p_ctx->cfg.cal != 0 )
+  {
+    ads1256_send_cmd(p_ctx->cfg.cal);
+    ads1256_wait_drdy();
+  }
+}
+
+/***********************************************************************
+ * @fn      spi_src_fill_block
+ *
+ * @brief   Hand out the samples read so far, stamped at the last one.
+ *
+ * @param   p_src
+ *          p_block
+ *
+ * @return  void
+ **/
+static void spi_src_fill_block(acq_source_t *p_src, acq_block_t *p_block)
+{
+  spi_ctx_t *p_ctx = (spi_ctx_t *)p_src->ctx;
+  struct timespec now;
+  struct timespec real;
+  double age = 0;
+
+  /* Wall clock of the last sample */
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  clock_gettime(CLOCK_REALTIME, &real);
+  age = timespec_diff(&now, &p_ctx->last);
+  real.tv_sec  -= (time_t)age;
+  real.tv_nsec -= (long)((age - (time_t)age) * NS_PER_S);
+  if ( real.tv_nsec < 0 )
+  {
+    real.tv_sec--;
+    real.tv_nsec += NS_PER_S;
+  }
+
+  p_block->p_data[0]   = (const uint8_t *)p_ctx->p_buf;
+  p_block->num_records = p_ctx->fill;
+  p_block->seq         = p_ctx->seq++;
+  p_block->flags       = ACQ_BLOCK_STAMPED;
+  p_block->status      = 0;
+  p_block->trig_index  = 0;
+  p_block->cycles      = (uint64_t)(timespec_diff(&p_ctx->last, &p_ctx->mono0) * NS_PER_S);
+  p_block->real        = real;
+  p_ctx->fill = 0;
+}
@@ -0,0 +1,238 @@
+/***********************************************************************
+ * INCLUDES
+ **/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "acq.h"
+#include "acq_codec.h"
+
+/***********************************************************************
+ * DEFINES
+ **/
+#define FILE_MAX_LEN        256
+
+/***********************************************************************
+ * TYPEDEFS
+ **/
+typedef struct file_ctx_t
+{
+  char          file_name[FILE_MAX_LEN];
+  uint32_t      first;          /* Block to start from */
+  acq_reader_t *p_rd;
+  uint32_t      next;
+  uint32_t      num_samples;    /* 0: to the end */
+  uint64_t      done;
+  int           running;
+} file_ctx_t;
+
+/***********************************************************************
+ * PRIVATE FUNCTIONS PROTOTYPES
+ **/
+static int  file_open(acq_source_t *p_src);
+static int  file_configure(acq_source_t *p_src, const acq_option_t *p_opt, uint32_t num_opts);
+static int  file_start(acq_source_t *p_src, uint32_t num_samples, uint32_t block_len);
+static int  file_read_block(acq_source_t *p_src, acq_block_t *p_block, int timeout_ms);
+static void file_stop(acq_source_t *p_src);
+static void file_close(acq_source_t *p_src);
+
+/***********************************************************************
+ * FUNCTIONS
+ **/
+/***********************************************************************
+ * @fn      src_file_create
+ *
+ * @brief   Replay of a capture recorded by sink_codec_create(), with its
+ *          format, blocks and stamps. Options:
+ *            file=PATH           Capture file
+ *            first=N             Block to start from (default 0)
+ *          The blocks are as recorded: block_len is ignored.
+ *
+ * @param   void
+ *
+ * @return  Source or NULL
+ */
+acq_source_t *src_file_create(void)
+{
+  acq_source_t *p_src = calloc(1, sizeof(acq_source_t));
+  file_ctx_t *p_ctx = calloc(1, sizeof(file_ctx_t));
+
+  if ( p_src == NULL || p_ctx == NULL )
+  {
+    free(p_src);
+    free(p_ctx);
+    return NULL;
+  }
+
+  p_src->name       = "file";
+  p_src->ctx        = p_ctx;
+  p_src->open       = file_open;
+  p_src->configure  = file_configure;
+  p_src->start      = file_start;
+  p_src->read_block = file_read_block;
+  p_src->stop       = file_stop;
+  p_src->event_fd   = NULL;
+  p_src->close      = file_close;
+
+  return p_src;
+}
+
+/***********************************************************************
+ * @fn      file_open
+ *
+ * @brief
+ *
+ * @param   p_src
+ *
+ * @return  0, -1 on error
+ **/
+static int file_open(acq_source_t *p_src)
+{
+  file_ctx_t *p_ctx = (file_ctx_t *)p_src->ctx;
+
+  p_ctx->p_rd = acq_reader_open(p_ctx->file_name);
+  if ( p_ctx->p_rd == NULL )
+  {
+    return -1;
+  }
+  p_src->fmt = p_ctx->p_rd->fmt;
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      file_configure
+ *
+ * @brief   Checked and kept, all of them or none. The file is chosen
+ *          before open().
+ *
+ * @param   p_src
+ *          p_opt
+ *          num_opts
+ *
+ * @return  0, -1 on error
+ **/
+static int file_configure(acq_source_t *p_src, const acq_option_t *p_opt, uint32_t num_opts)
+{
+  file_ctx_t *p_ctx = (file_ctx_t *)p_src->ctx;
+  file_ctx_t cfg = *p_ctx;
+  uint32_t i = 0;
+
+  if ( p_ctx->running )
+  {
+    return -1;
+  }
+
+  for ( i = 0; i < num_opts; i++ )
+  {
+    if ( strcmp(p_opt[i].key, "file") == 0 && p_ctx->p_rd == NULL && strlen(p_opt[i].value) < FILE_MAX_LEN )
+    {
+      strcpy(cfg.file_name, p_opt[i].value);
+    }
+    else if ( strcmp(p_opt[i].key, "first") == 0 )
+    {
+      cfg.first = strtoul(p_opt[i].value, NULL, 10);
+    }
+    else
+    {
+      return -1;
+    }
+  }
+  *p_ctx = cfg;
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      file_start
+ *
+ * @brief
+ *
+ * @param   p_src
+ *          num_samples - 0: every block from the first
+ *          block_len
+ *
+ * @return  0
+ **/
+static int file_start(acq_source_t *p_src, uint32_t num_samples, uint32_t block_len)
+{
+  file_ctx_t *p_ctx = (file_ctx_t *)p_src->ctx;
+
+  p_src->fmt = p_ctx->p_rd->fmt;
+  p_ctx->next        = p_ctx->first;
+  p_ctx->num_samples = num_samples;
+  p_ctx->done        = 0;
+  p_ctx->running     = 1;
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      file_read_block
+ *
+ * @brief   Next block in the file, never waits.
+ *
+ * @param   p_src
+ *          p_block
+ *          timeout_ms
+ *
+ * @return  ACQ_READ_BLOCK, ACQ_READ_END, -1 on a damaged block
+ **/
+static int file_read_block(acq_source_t *p_src, acq_block_t *p_block, int timeout_ms)
+{
+  file_ctx_t *p_ctx = (file_ctx_t *)p_src->ctx;
+  acq_format_t *p_fmt = &p_src->fmt;
+
+  if ( !p_ctx->running || p_ctx->next >= p_ctx->p_rd->num_blocks ||
+       (p_ctx->num_samples != 0 && p_ctx->done >= p_ctx->num_samples) )
+  {
+    p_ctx->running = 0;
+    return ACQ_READ_END;
+  }
+
+  if ( acq_reader_read(p_ctx->p_rd, p_ctx->next, p_block) < 0 )
+  {
+    printf("Block %u of %s is damaged.\n", p_ctx->next, p_ctx->file_name);
+    p_ctx->running = 0;
+    return -1;
+  }
+  p_ctx->next++;
+  p_ctx->done += (uint64_t)p_block->num_records * p_fmt->record_values * p_fmt->decimation;
+
+  return ACQ_READ_BLOCK;
+}
+
+/***********************************************************************
+ * @fn      file_stop
+ *
+ * @brief
+ *
+ * @param   p_src
+ *
+ * @return  void
+ **/
+static void file_stop(acq_source_t *p_src)
+{
+  file_ctx_t *p_ctx = (file_ctx_t *)p_src->ctx;
+
+  p_ctx->running = 0;
+  p_src->stats.stopped = 1;
+}
+
+/***********************************************************************
+ * @fn      file_close
+ *
+ * @brief
+ *
+ * @param   p_src
+ *
+ * @return  void
+ **/
+static void file_close(acq_source_t *p_src)
+{
+  file_ctx_t *p_ctx = (file_ctx_t *)p_src->ctx;
+
+  acq_reader_close(p_ctx->p_rd);
+  p_ctx->p_rd = NULL;
+}
@@ -0,0 +1,1222 @@
+/***********************************************************************
+ * INCLUDES
+ **/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <prussdrv.h>
+#include <pruss_intc_mapping.h>
+#include "acq.h"
+#include "acq_pru.h"
+
+/***********************************************************************
+ * DEFINES
+ **/
+#define DEF_SMP_RATE   1000
+#define SAMPLE_SIZE    2
+#define ADC_FIFO0_LEN  50
+#define ADC_LSB        (1.8 / 4095)   /* AIN 1.8 V reference, 12 bits */
+#define PRU_NUM        0
+#define PRU_WRITER_NUM 1
+
+/* PRU Data RAM layout -- must match pru_adc.p */
+#define PARAM_POOL_ADDR   0
+#define PARAM_CLK_DIV     1
+#define PARAM_NUM_LOOPS   2
+#define PARAM_CH_CFG      3
+#define PARAM_FIFO0_LEN   4
+#define PARAM_CMD         5
+#define PARAM_STATUS      6
+#define PARAM_LOOPS_DONE  7
+#define PARAM_BLOCK_LOOPS 8
+#define PARAM_RING_BLOCKS 9
+#define PARAM_BLOCK_SEQ   10
+#define PARAM_END_CYCLES  11   /* 64 bits: words 11 - 12 */
+#define PARAM_TRIG_MODE   13
+#define PARAM_TRIG_LEVEL  14
+#define PARAM_PRE_LOOPS   15
+#define PARAM_POST_LOOPS  16
+#define PARAM_PRE_BYTES   17
+#define PARAM_SLOT_BYTES  18
+#define PARAM_REDUCE_MODE 19
+#define PARAM_REDUCE_SHIFT 20
+#define PARAM_PACK        21
+#define PARAM_SAMPLE_CYCLES 22
+#define PARAM_LOST_SAMPLES 23
+#define PARAM_FIFO_EVENTS 24
+#define PARAM_END_STATUS  25
+#define PARAM_SPLIT       29
+#define PARAM_STAMP_RING  64   /* 0x100 */
+
+/* PRU shared RAM, split captures: ring peak fill (0x1200C) */
+#define SHR_SPLIT_PEAK    0x803
+#define SPLIT_RING_SIZE   8192
+
+/* Block status events */
+#define FIFO0_OVERRUN     0x08
+#define FIFO0_UNDERFLOW   0x10
+
+/* Trigger modes */
+#define TRIG_OFF          0
+#define TRIG_RISING       1
+#define TRIG_FALLING      2
+#define TRIG_WINDOW       3
+
+/* Reduction modes */
+#define REDUCE_OFF        0
+#define REDUCE_MEAN       1
+#define REDUCE_ENVELOPE   2
+#define REDUCE_MAX_SHIFT  16
+
+/* Packing: two 12-bit samples in 3 bytes */
+#define PACKED_PAIR_SIZE  3
+
+/* Envelope record {min, max, mean, reserved} */
+#define ENV_RECORD_SIZE   8
+
+/* Window slot header: {trigger cycles lo, hi, oldest pre loop, trigger sample} */
+#define WIN_HEADER_LEN    16
+#define WIN_CYC_LO        0
+#define WIN_CYC_HI        1
+#define WIN_OLDEST        2
+#define WIN_TRIG_SAMPLE   3
+
+/* Trigger captures check their duration at least this often */
+#define TRIG_POLL_MS      100
+
+/* PRU commands */
+#define CMD_NONE          0
+#define CMD_START         1
+#define CMD_STOP          2
+#define CMD_EXIT          3
+
+/* PRU status */
+#define STATUS_IDLE       0
+#define STATUS_RUNNING    1
+#define STATUS_DONE       2
+#define STATUS_STOPPED    3
+
+/* Capture states on the host side */
+#define STATE_IDLE        0
+#define STATE_RUNNING     1
+#define STATE_TAIL        2   /* Last partial block delivered */
+#define STATE_END         3
+
+#define FIRMWARE_MAX_LEN  128
+
+/***********************************************************************
+ * TYPEDEFS
+ **/
+typedef struct capture_t
+{
+  uint32_t channel;
+  uint32_t sample_rate;
+  float    acquisition_time;
+  uint32_t num_samples;
+  uint32_t num_loops;
+  uint32_t clk_div;
+  uint32_t ch_cfg_code;
+  uint32_t trig_mode;     /* TRIG_OFF: plain capture */
+  uint32_t trig_lo;
+  uint32_t trig_hi;
+  uint32_t pre_loops;     /* FIFO0 reads before and with the trigger */
+  uint32_t post_loops;    /* FIFO0 reads after the trigger */
+  uint32_t reduce_mode;   /* REDUCE_OFF: every sample */
+  uint32_t reduce_shift;  /* 2^shift samples per record */
+  uint32_t packed;        /* Pairs of samples in 3 bytes */
+  uint32_t split;         /* PRU1 moves the samples to the pool */
+} capture_t;
+
+typedef struct adc_ctx_t
+{
+  capture_t          cap;
+  char               firmware[FIRMWARE_MAX_LEN];  /* Directory of the .bin files */
+  int                opened;
+  volatile uint32_t *p_ram;
+  volatile uint32_t *p_shr_ram;
+  uint8_t           *p_pool;
+  uint32_t           shr_mem_addr;
+  uint32_t           shr_mem_size;
+
+  /* Capture */
+  int                state;
+  int                finished;
+  int                stopping;
+  uint32_t           block_len;
+  uint32_t           block_recs;
+  uint32_t           block_bytes;
+  uint32_t           fifo_blocks;   /* Blocks with FIFO0 events */
+  pru_ring_t         ring;
+
+  /* Trigger windows, put back in time order */
+  uint32_t           slot_bytes;
+  uint32_t           pre_bytes;
+  uint32_t           win_len;
+  uint16_t          *p_win;
+} adc_ctx_t;
+
+/***********************************************************************
+ * PRIVATE FUNCTIONS PROTOTYPES
+ **/
+static int  adc_open(acq_source_t *p_src);
+static int  adc_configure(acq_source_t *p_src, const acq_option_t *p_opt, uint32_t num_opts);
+static int  adc_start(acq_source_t *p_src, uint32_t num_samples, uint32_t block_len);
+static int  adc_read_block(acq_source_t *p_src, acq_block_t *p_block, int timeout_ms);
+static void adc_stop(acq_source_t *p_src);
+static int  adc_event_fd(acq_source_t *p_src);
+static void adc_close(acq_source_t *p_src);
+static int  adc_set(adc_ctx_t *p_ctx, capture_t *p_cap, const char *key, const char *value);
+static int  adc_read_stream(acq_source_t *p_src, acq_block_t *p_block, int timeout_ms);
+static int  adc_read_window(acq_source_t *p_src, acq_block_t *p_block, int timeout_ms);
+static void adc_end(acq_source_t *p_src);
+static int  check_sample_rate(uint32_t smps);
+static int  parse_trigger(const char *spec, capture_t *p_cap);
+static int  parse_reduce(const char *spec, capture_t *p_cap);
+static uint32_t record_samples(const capture_t *p_cap);
+static uint32_t record_size(const capture_t *p_cap);
+static float capture_max_time(const capture_t *p_cap, uint32_t pool_size);
+static void print_capture(const capture_t *p_cap, uint32_t pool_size);
+static int  pru_setup(adc_ctx_t *p_ctx);
+static void pru_start_capture(adc_ctx_t *p_ctx, uint32_t block_loops, uint32_t ring_blocks);
+static void pru_stop_capture(adc_ctx_t *p_ctx);
+static int  pru_capture_finished(adc_ctx_t *p_ctx);
+static void pru_shutdown(adc_ctx_t *p_ctx);
+static uint64_t pru_end_cycles(adc_ctx_t *p_ctx);
+static const char *fifo_events_name(uint32_t events);
+
+/***********************************************************************
+ * FUNCTIONS
+ **/
+/***********************************************************************
+ * @fn      src_pru_adc_create
+ *
+ * @brief   AM335x ADC sampled by the PRU (pru_adc.p). Options:
+ *            channel=N           0 - 6
+ *            rate=HZ             100 - 1600000 (default 1000)
+ *            trigger=SPEC        rise:LEVEL:PRE:POST, fall:LEVEL:PRE:POST,
+ *                                window:LOW:HIGH:PRE:POST or off
+ *            reduce=SPEC         mean:N, env:N or off
+ *            packed=0|1          2 samples in 3 bytes
+ *            split=0|1           PRU1 moves the samples to the pool
+ *            firmware=DIR        Directory of the PRU programs (default .)
+ *          A trigger capture delivers windows for the length of the
+ *          capture (num_samples / rate).
+ *
+ * @param   void
+ *
+ * @return  Source or NULL
+ */
+acq_source_t *src_pru_adc_create(void)
+{
+  acq_source_t *p_src = calloc(1, sizeof(acq_source_t));
+  adc_ctx_t *p_ctx = calloc(1, sizeof(adc_ctx_t));
+
+  if ( p_src == NULL || p_ctx == NULL )
+  {
+    free(p_src);
+    free(p_ctx);
+    return NULL;
+  }
+
+  p_ctx->cap.sample_rate = DEF_SMP_RATE;
+  p_ctx->cap.clk_div     = (1600000 / DEF_SMP_RATE) - 1;
+  p_ctx->cap.ch_cfg_code = 0x00000001;
+  strcpy(p_ctx->firmware, ".");
+
+  p_src->fmt.sample_rate = DEF_SMP_RATE;
+  p_src->name       = "pru_adc";
+  p_src->ctx        = p_ctx;
+  p_src->open       = adc_open;
+  p_src->configure  = adc_configure;
+  p_src->start      = adc_start;
+  p_src->read_block = adc_read_block;
+  p_src->stop       = adc_stop;
+  p_src->event_fd   = adc_event_fd;
+  p_src->close      = adc_close;
+
+  return p_src;
+}
+
+/***********************************************************************
+ * @fn      adc_open
+ *
+ * @brief   Find the pool and load the PRU programs, they wait for
+ *          commands.
+ *
+ * @param   p_src
+ *
+ * @return  0, -1 on error
+ **/
+static int adc_open(acq_source_t *p_src)
+{
+  adc_ctx_t *p_ctx = (adc_ctx_t *)p_src->ctx;
+
+  if ( get_pru_shared_mem_info(&p_ctx->shr_mem_addr, &p_ctx->shr_mem_size) < 0 )
+  {
+    return -1;
+  }
+
+  if ( pru_setup(p_ctx) < 0 )
+  {
+    return -1;
+  }
+  p_ctx->opened = 1;
+  p_ctx->state  = STATE_IDLE;
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      adc_configure
+ *
+ * @brief   Settings are written with each capture: they are checked and
+ *          kept, all of them or none.
+ *
+ * @param   p_src
+ *          p_opt
+ *          num_opts
+ *
+ * @return  0, -1 on error or while capturing
+ **/
+static int adc_configure(acq_source_t *p_src, const acq_option_t *p_opt, uint32_t num_opts)
+{
+  adc_ctx_t *p_ctx = (adc_ctx_t *)p_src->ctx;
+  capture_t cap = p_ctx->cap;
+  uint32_t i = 0;
+
+  if ( p_ctx->state != STATE_IDLE && p_ctx->state != STATE_END )
+  {
+    return -1;
+  }
+
+  for ( i = 0; i < num_opts; i++ )
+  {
+    if ( adc_set(p_ctx, &cap, p_opt[i].key, p_opt[i].value) < 0 )
+    {
+      return -1;
+    }
+  }
+  p_ctx->cap = cap;
+  p_src->fmt.sample_rate = cap.sample_rate;
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      adc_start
+ *
+ * @brief   Start a capture with the pool as a ring of blocks, or of
+ *          window slots with a trigger.
+ *
+ * @param   p_src
+ *          num_samples - Any length, the ring is read while capturing;
+ *                        a trigger capture runs for as long as these take
+ *          block_len - Samples per block, rounded to FIFO0 reads holding
+ *                      whole records
+ *
+ * @return  0, -1 if a block or window doesn't fit twice in the pool
+ **/
+static int adc_start(acq_source_t *p_src, uint32_t num_samples, uint32_t block_len)
+{
+  adc_ctx_t *p_ctx = (adc_ctx_t *)p_src->ctx;
+  capture_t *p_cap = &p_ctx->cap;
+  acq_format_t *p_fmt = &p_src->fmt;
+  uint32_t block_loops = (block_len < ADC_FIFO0_LEN) ? 1 : block_len / ADC_FIFO0_LEN;
+  uint32_t rec_samples = record_samples(p_cap);
+  uint32_t ring_blocks = 0;
+  uint32_t loops_step = 1;
+
+  p_cap->acquisition_time = (float)num_samples / p_cap->sample_rate;
+  p_cap->num_samples = num_samples;
+  p_cap->num_loops   = (p_cap->trig_mode == TRIG_OFF) ? p_cap->num_samples / ADC_FIFO0_LEN : 0;
+  print_capture(p_cap, p_ctx->shr_mem_size);
+
+  /* Records as the PRU stores them */
+  memset(p_fmt, 0, sizeof(acq_format_t));
+  p_fmt->encoding      = ACQ_ENC_U16;
+  p_fmt->record_size   = record_size(p_cap);
+  p_fmt->record_values = 1;
+  p_fmt->decimation    = 1;
+  if ( p_cap->packed )
+  {
+    p_fmt->encoding      = ACQ_ENC_U12_PAIR;
+    p_fmt->record_values = 2;
+  }
+  else if ( p_cap->reduce_mode != REDUCE_OFF )
+  {
+    p_fmt->encoding   = (p_cap->reduce_mode == REDUCE_ENVELOPE) ? ACQ_ENC_U16_ENV : ACQ_ENC_U16;
+    p_fmt->decimation = rec_samples;
+  }
+  p_fmt->num_streams = 1;
+  p_fmt->lsb[0][0]   = ADC_LSB;
+  p_fmt->sample_rate = p_cap->sample_rate;
+  p_fmt->clock_hz    = PRU_CLK_HZ;
+
+  p_ctx->finished    = 0;
+  p_ctx->stopping    = 0;
+  p_ctx->fifo_blocks = 0;
+
+  /* Slots go round the pool, the firmware only needs the ring length */
+  if ( p_cap->trig_mode != TRIG_OFF )
+  {
+    p_ctx->pre_bytes  = WIN_HEADER_LEN + p_cap->pre_loops * ADC_FIFO0_LEN * SAMPLE_SIZE;
+    p_ctx->slot_bytes = p_ctx->pre_bytes + p_cap->post_loops * ADC_FIFO0_LEN * SAMPLE_SIZE;
+    p_ctx->win_len    = (p_cap->pre_loops + p_cap->post_loops) * ADC_FIFO0_LEN;
+    ring_blocks = p_ctx->shr_mem_size / p_ctx->slot_bytes;
+    if ( ring_blocks < 2 )
+    {
+      printf("Trigger window doesn't fit twice in the pool.\n");
+      return -1;
+    }
+
+    free(p_ctx->p_win);
+    p_ctx->p_win = malloc(p_ctx->win_len * SAMPLE_SIZE);
+    if ( p_ctx->p_win == NULL )
+    {
+      perror("malloc(window)");
+      return -1;
+    }
+
+    pru_ring_init(&p_ctx->ring, &p_ctx->p_ram[PARAM_STAMP_RING], ring_blocks, p_ctx->win_len, 0);
+    pru_start_capture(p_ctx, 0, ring_blocks);
+    p_ctx->state = STATE_RUNNING;
+    return 0;
+  }
+
+  /* Blocks hold whole records: FIFO0 reads in steps of records / gcd(records, FIFO0) */
+  while ( (loops_step * ADC_FIFO0_LEN) % rec_samples != 0 )
+  {
+    loops_step++;
+  }
+  block_loops = ((block_loops + loops_step - 1) / loops_step) * loops_step;
+
+  p_ctx->block_len   = block_loops * ADC_FIFO0_LEN;
+  p_ctx->block_recs  = p_ctx->block_len / rec_samples;
+  p_ctx->block_bytes = p_ctx->block_recs * record_size(p_cap);
+  ring_blocks = p_ctx->shr_mem_size / p_ctx->block_bytes;
+  if ( ring_blocks < 2 )
+  {
+    printf("Block of %u samples doesn't fit twice in the pool.\n", p_ctx->block_len);
+    return -1;
+  }
+
+  pru_ring_init(&p_ctx->ring, &p_ctx->p_ram[PARAM_STAMP_RING], ring_blocks, p_ctx->block_len,
+                (double)p_ctx->block_len * PRU_CLK_HZ / p_cap->sample_rate);
+  pru_start_capture(p_ctx, block_loops, ring_blocks);
+  p_ctx->state = STATE_RUNNING;
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      adc_read_block
+ *
+ * @brief
+ *
+ * @param   p_src
+ *          p_block
+ *          timeout_ms
+ *
+ * @return  ACQ_READ_...
+ **/
+static int adc_read_block(acq_source_t *p_src, acq_block_t *p_block, int timeout_ms)
+{
+  adc_ctx_t *p_ctx = (adc_ctx_t *)p_src->ctx;
+
+  if ( p_ctx->state == STATE_IDLE || p_ctx->state == STATE_END )
+  {
+    return ACQ_READ_END;
+  }
+
+  if ( p_ctx->cap.trig_mode != TRIG_OFF )
+  {
+    return adc_read_window(p_src, p_block, timeout_ms);
+  }
+
+  return adc_read_stream(p_src, p_block, timeout_ms);
+}
+
+/***********************************************************************
+ * @fn      adc_stop
+ *
+ * @brief
+ *
+ * @param   p_src
+ *
+ * @return  void
+ **/
+static void adc_stop(acq_source_t *p_src)
+{
+  adc_ctx_t *p_ctx = (adc_ctx_t *)p_src->ctx;
+
+  if ( p_ctx->state == STATE_RUNNING && !p_ctx->finished && !p_ctx->stopping )
+  {
+    pru_stop_capture(p_ctx);
+    p_ctx->stopping = 1;
+  }
+}
+
+/***********************************************************************
+ * @fn      adc_event_fd
+ *
+ * @brief   A trigger capture may see no event for its whole length, it
+ *          has to be polled to end on time.
+ *
+ * @param   p_src
+ *
+ * @return
+ **/
+static int adc_event_fd(acq_source_t *p_src)
+{
+  adc_ctx_t *p_ctx = (adc_ctx_t *)p_src->ctx;
+
+  return (p_ctx->cap.trig_mode != TRIG_OFF) ? -1 : prussdrv_pru_event_fd(PRU_EVTOUT_0);
+}
+
+/***********************************************************************
+ * @fn      adc_close
+ *
+ * @brief
+ *
+ * @param   p_src
+ *
+ * @return  void
+ **/
+static void adc_close(acq_source_t *p_src)
+{
+  adc_ctx_t *p_ctx = (adc_ctx_t *)p_src->ctx;
+
+  if ( p_ctx->opened )
+  {
+    pru_shutdown(p_ctx);
+    p_ctx->opened = 0;
+  }
+  free(p_ctx->p_win);
+  p_ctx->p_win = NULL;
+}
+
+/***********************************************************************
+ * @fn      adc_set
+ *
+ * @brief   One option into the settings. Channels and rates out of range
+ *          fall back to the defaults, as they always did.
+ *
+ * @param   p_ctx
+ *          p_cap
+ *          key
+ *          value
+ *
+ * @return  0, -1 if the key is unknown or the value invalid
+ **/
+static int adc_set(adc_ctx_t *p_ctx, capture_t *p_cap, const char *key, const char *value)
+{
+  if ( strcmp(key, "channel") == 0 )
+  {
+    p_cap->channel = atoi(value);
+    if ( p_cap->channel > 6 )
+    {
+      printf("Channel doesn't exist. Sampling CH0 (Default)\n");
+      p_cap->channel = 0;
+    }
+    p_cap->ch_cfg_code = (p_cap->channel << 19) | (p_cap->channel << 15) | 0x00000001;
+    return 0;
+  }
+  else if ( strcmp(key, "rate") == 0 )
+  {
+    p_cap->sample_rate = atoi(value);
+    if ( check_sample_rate(p_cap->sample_rate) < 0 )
+    {
+      printf("Sample rate not supported. Sampling at %d Hz (Default)\n\n", DEF_SMP_RATE);
+      p_cap->sample_rate = DEF_SMP_RATE;
+    }
+    p_cap->clk_div = (1600000 / p_cap->sample_rate) - 1;
+    return 0;
+  }
+  else if ( strcmp(key, "trigger") == 0 )
+  {
+    if ( strcmp(value, "off") == 0 )
+    {
+      p_cap->trig_mode = TRIG_OFF;
+      return 0;
+    }
+    return parse_trigger(value, p_cap);
+  }
+  else if ( strcmp(key, "reduce") == 0 )
+  {
+    if ( strcmp(value, "off") == 0 )
+    {
+      p_cap->reduce_mode = REDUCE_OFF;
+      return 0;
+    }
+    return parse_reduce(value, p_cap);
+  }
+  else if ( strcmp(key, "packed") == 0 )
+  {
+    p_cap->packed = (atoi(value) != 0);
+    return 0;
+  }
+  else if ( strcmp(key, "split") == 0 )
+  {
+    p_cap->split = (atoi(value) != 0);
+    return 0;
+  }
+  else if ( strcmp(key, "firmware") == 0 && !p_ctx->opened && strlen(value) < FIRMWARE_MAX_LEN )
+  {
+    strcpy(p_ctx->firmware, value);
+    return 0;
+  }
+
+  return -1;
+}
+
+/***********************************************************************
+ * @fn      adc_read_stream
+ *
+ * @brief   Next block of the ring, in place in the pool. The last
+ *          partial block is stamped at the end of capture.
+ *
+ * @param   p_src
+ *          p_block
+ *          timeout_ms
+ *
+ * @return  ACQ_READ_...
+ **/
+static int adc_read_stream(acq_source_t *p_src, acq_block_t *p_block, int timeout_ms)
+{
+  adc_ctx_t *p_ctx = (adc_ctx_t *)p_src->ctx;
+  pru_ring_t *p_ring = &p_ctx->ring;
+  uint32_t total = 0;
+  uint32_t last = 0;
+
+  for ( ;; )
+  {
+    if ( p_ctx->state == STATE_RUNNING && pru_ring_next(p_ring, p_block) )
+    {
+      /* FIFO0 fell behind: the PRU counted the samples it dropped */
+      if ( ACQ_STATUS_EVENTS(p_block->status) != 0 )
+      {
+        printf("FIFO0 %s in block %u: %u samples lost, FIFO0 peak %u\n",
+               fifo_events_name(ACQ_STATUS_EVENTS(p_block->status)), p_block->seq,
+               ACQ_STATUS_LOST(p_block->status), ACQ_STATUS_PEAK(p_block->status));
+        p_ctx->fifo_blocks++;
+      }
+
+      p_block->p_data[0]   = p_ctx->p_pool + (p_block->seq % p_ring->ring_blocks) * p_ctx->block_bytes;
+      p_block->num_records = p_ctx->block_recs;
+      p_block->trig_index  = 0;
+      return ACQ_READ_BLOCK;
+    }
+
+    if ( p_ctx->state == STATE_RUNNING && p_ctx->finished )
+    {
+      p_ctx->state = STATE_TAIL;
+      last  = p_ring->last;
+      total = p_ctx->p_ram[PARAM_LOOPS_DONE] * ADC_FIFO0_LEN;
+      if ( total > last * p_ctx->block_len )
+      {
+        p_block->p_data[0]   = p_ctx->p_pool + (last % p_ring->ring_blocks) * p_ctx->block_bytes;
+        p_block->num_records = (total - last * p_ctx->block_len) / record_samples(&p_ctx->cap);
+        p_block->seq         = last;
+        p_block->flags       = ACQ_BLOCK_STAMPED;
+        p_block->status      = p_ctx->p_ram[PARAM_END_STATUS];
+        p_block->trig_index  = 0;
+        p_block->cycles      = pru_end_cycles(p_ctx);
+        clock_fit_realtime(&p_ring->fit, p_block->cycles, &p_block->real);
+        return ACQ_READ_BLOCK;
+      }
+    }
+
+    if ( p_ctx->state == STATE_TAIL )
+    {
+      adc_end(p_src);
+      return ACQ_READ_END;
+    }
+
+    if ( !pru_wait_event(timeout_ms) )
+    {
+      return ACQ_READ_AGAIN;
+    }
+    p_ctx->finished = pru_capture_finished(p_ctx);
+    pru_ring_update(p_ring, p_ctx->p_ram[PARAM_BLOCK_SEQ]);
+  }
+}
+
+/***********************************************************************
+ * @fn      adc_read_window
+ *
+ * @brief   Next trigger window. Its pre-trigger reads went round the
+ *          slot: they are put back in time order in a buffer of the
+ *          source. The capture stops itself when its time is over.
+ *
+ * @param   p_src
+ *          p_block
+ *          timeout_ms
+ *
+ * @return  ACQ_READ_...
+ **/
+static int adc_read_window(acq_source_t *p_src, acq_block_t *p_block, int timeout_ms)
+{
+  const uint32_t loop_bytes = ADC_FIFO0_LEN * SAMPLE_SIZE;
+  adc_ctx_t *p_ctx = (adc_ctx_t *)p_src->ctx;
+  capture_t *p_cap = &p_ctx->cap;
+  pru_ring_t *p_ring = &p_ctx->ring;
+  const uint8_t *p_slot = NULL;
+  volatile const uint32_t *p_head = NULL;
+  uint64_t after_trig = 0;
+  uint64_t cycles = 0;
+  uint32_t status = 0;
+  uint32_t seq = 0;
+  uint32_t i = 0;
+  struct timespec now;
+  int wait_ms = 0;
+
+  for ( ;; )
+  {
+    if ( p_ring->seq != p_ring->last )
+    {
+      seq = p_ring->seq++;
+      p_slot = p_ctx->p_pool + (seq % p_ring->ring_blocks) * p_ctx->slot_bytes;
+      p_head = (volatile const uint32_t *)p_slot;
+
+      /* Pre-trigger reads from the oldest one, then post-trigger reads */
+      for ( i = 0; i < p_cap->pre_loops; i++ )
+      {
+        memcpy(&p_ctx->p_win[i * ADC_FIFO0_LEN],
+               p_slot + WIN_HEADER_LEN + ((p_head[WIN_OLDEST] + i) % p_cap->pre_loops) * loop_bytes, loop_bytes);
+      }
+      memcpy(&p_ctx->p_win[p_cap->pre_loops * ADC_FIFO0_LEN], p_slot + p_ctx->pre_bytes,
+             p_cap->post_loops * loop_bytes);
+
+      /* Header cycles are taken at the end of the trigger read */
+      cycles     = ((uint64_t)p_head[WIN_CYC_HI] << 32) | p_head[WIN_CYC_LO];
+      after_trig = (uint64_t)(ADC_FIFO0_LEN - 1 - p_head[WIN_TRIG_SAMPLE]) * PRU_CLK_HZ / p_cap->sample_rate;
+      p_block->cycles = (cycles > after_trig) ? cycles - after_trig : 0;
+      clock_fit_realtime(&p_ring->fit, p_block->cycles, &p_block->real);
+
+      /* FIFO0 events since the previous window, from the window stamp.
+       * Samples may be missing but none are counted as lost. */
+      p_block->status = 0;
+      if ( pru_read_stamp(p_ring->p_stamps, seq, &cycles, &status) == 0 && ACQ_STATUS_EVENTS(status) != 0 )
+      {
+        printf("FIFO0 %s before window %u: samples missing, FIFO0 peak %u\n",
+               fifo_events_name(ACQ_STATUS_EVENTS(status)), seq, ACQ_STATUS_PEAK(status));
+        p_block->status = status & 0xFFFF0000;
+      }
+
+      p_block->p_data[0]   = (const uint8_t *)p_ctx->p_win;
+      p_block->num_records = p_ctx->win_len;
+      p_block->seq         = seq;
+      p_block->flags       = ACQ_BLOCK_WINDOW;
+      p_block->trig_index  = (p_cap->pre_loops - 1) * ADC_FIFO0_LEN + p_head[WIN_TRIG_SAMPLE];
+      return ACQ_READ_BLOCK;
+    }
+
+    if ( p_ctx->finished )
+    {
+      adc_end(p_src);
+      return ACQ_READ_END;
+    }
+
+    /* Stop when the acquisition time is over */
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if ( !p_ctx->stopping && timespec_diff(&now, &p_ring->fit.mono0) >= p_cap->acquisition_time )
+    {
+      pru_stop_capture(p_ctx);
+      p_ctx->stopping = 1;
+    }
+
+    wait_ms = (timeout_ms < 0 || timeout_ms > TRIG_POLL_MS) ? TRIG_POLL_MS : timeout_ms;
+    if ( !pru_wait_event(wait_ms) )
+    {
+      if ( timeout_ms < 0 )
+      {
+        continue;
+      }
+      return ACQ_READ_AGAIN;
+    }
+    p_ctx->finished = pru_capture_finished(p_ctx);
+    pru_ring_update(p_ring, p_ctx->p_ram[PARAM_BLOCK_SEQ]);
+  }
+}
+
+/***********************************************************************
+ * @fn      adc_end
+ *
+ * @brief   Capture over: statistics and reports.
+ *
+ * @param   p_src
+ *
+ * @return  void
+ **/
+static void adc_end(acq_source_t *p_src)
+{
+  adc_ctx_t *p_ctx = (adc_ctx_t *)p_src->ctx;
+  pru_ring_t *p_ring = &p_ctx->ring;
+  volatile uint32_t *p_ram = p_ctx->p_ram;
+
+  p_ctx->state = STATE_END;
+  p_src->stats.lost_blocks = p_ring->lost;
+  p_src->stats.gaps        = p_ring->gaps;
+  p_src->stats.stopped     = (p_ram[PARAM_STATUS] == STATUS_STOPPED);
+  p_src->stats.seconds     = (double)pru_end_cycles(p_ctx) / PRU_CLK_HZ;
+
+  if ( p_ctx->cap.trig_mode != TRIG_OFF )
+  {
+    if ( p_ring->lost > 0 )
+    {
+      printf("Host too slow: %u windows overwritten before being read.\n", p_ring->lost);
+    }
+    if ( p_ram[PARAM_FIFO_EVENTS] != 0 )
+    {
+      printf("PRU too slow: FIFO0 %s during the capture.\n", fifo_events_name(p_ram[PARAM_FIFO_EVENTS]));
+    }
+    return;
+  }
+
+  if ( p_ram[PARAM_FIFO_EVENTS] != 0 )
+  {
+    printf("PRU too slow: FIFO0 %s, %u samples lost in %u blocks.\n", fifo_events_name(p_ram[PARAM_FIFO_EVENTS]),
+           p_ram[PARAM_LOST_SAMPLES], p_ctx->fifo_blocks);
+  }
+  if ( p_ctx->cap.split )
+  {
+    printf("PRU1 shared ring peak: %u of %u bytes\n", p_ctx->p_shr_ram[SHR_SPLIT_PEAK] & 0xFFFF, SPLIT_RING_SIZE);
+  }
+  pru_ring_report(p_ring, p_ctx->cap.sample_rate);
+}
+
+/***********************************************************************
+ * @fn      check_sample_rate
+ *
+ * @brief
+ *
+ * @param   smps
+ *
+ * @return
+ **/
+static int check_sample_rate(uint32_t smps)
+{
+  if ( smps == 100    || smps == 200    || smps == 500    ||
+       smps == 1000   || smps == 2000   || smps == 5000   ||
+       smps == 10000  || smps == 20000  || smps == 50000  ||
+       smps == 100000 || smps == 200000 || smps == 400000 ||
+       smps == 800000 || smps == 1600000
+     )
+  {
+    return 0;
+  }
+
+  return -1;
+}
+
+/***********************************************************************
+ * @fn      parse_trigger
+ *
+ * @brief   Fill the trigger settings: rise:LEVEL:PRE:POST,
+ *          fall:LEVEL:PRE:POST or window:LOW:HIGH:PRE:POST. PRE and
+ *          POST in samples, rounded up to FIFO0 reads.
+ *
+ * @param   spec
+ *          p_cap
+ *
+ * @return  0 on success, -1 on error
+ **/
+static int parse_trigger(const char *spec, capture_t *p_cap)
+{
+  uint32_t v[4] = {0, 0, 0, 0};
+  char name[8] = "";
+  int n = 0;
+
+  n = sscanf(spec, "%7[a-z]:%u:%u:%u:%u", name, &v[0], &v[1], &v[2], &v[3]);
+
+  if ( n == 4 && strcmp(name, "rise") == 0 )
+  {
+    p_cap->trig_mode = TRIG_RISING;
+  }
+  else if ( n == 4 && strcmp(name, "fall") == 0 )
+  {
+    p_cap->trig_mode = TRIG_FALLING;
+  }
+  else if ( n == 5 && strcmp(name, "window") == 0 && v[0] <= v[1] )
+  {
+    p_cap->trig_mode = TRIG_WINDOW;
+  }
+  else
+  {
+    printf("Wrong trigger '%s'.\n", spec);
+    return -1;
+  }
+
+  /* Rise/fall: LEVEL:PRE:POST, window: LOW:HIGH:PRE:POST */
+  if ( p_cap->trig_mode != TRIG_WINDOW )
+  {
+    v[3] = v[2];
+    v[2] = v[1];
+    v[1] = v[0];
+  }
+  if ( v[1] > 4095 )
+  {
+    printf("Trigger levels go from 0 to 4095.\n");
+    p_cap->trig_mode = TRIG_OFF;
+    return -1;
+  }
+
+  p_cap->trig_lo    = v[0];
+  p_cap->trig_hi    = v[1];
+  p_cap->pre_loops  = (v[2] + ADC_FIFO0_LEN - 1) / ADC_FIFO0_LEN;
+  p_cap->post_loops = (v[3] + ADC_FIFO0_LEN - 1) / ADC_FIFO0_LEN;
+
+  /* The read holding the trigger is the last pre-trigger one */
+  if ( p_cap->pre_loops == 0 )
+  {
+    p_cap->pre_loops = 1;
+  }
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      parse_reduce
+ *
+ * @brief   Fill the reduction settings: mean:N or env:N, N a power of 2.
+ *
+ * @param   spec
+ *          p_cap
+ *
+ * @return  0 on success, -1 on error
+ **/
+static int parse_reduce(const char *spec, capture_t *p_cap)
+{
+  uint32_t len = 0;
+  char name[8] = "";
+
+  if ( sscanf(spec, "%7[a-z]:%u", name, &len) != 2 )
+  {
+    len = 0;
+  }
+
+  p_cap->reduce_mode = REDUCE_OFF;
+  if ( strcmp(name, "mean") == 0 )
+  {
+    p_cap->reduce_mode = REDUCE_MEAN;
+  }
+  else if ( strcmp(name, "env") == 0 )
+  {
+    p_cap->reduce_mode = REDUCE_ENVELOPE;
+  }
+
+  for ( p_cap->reduce_shift = 1; p_cap->reduce_shift <= REDUCE_MAX_SHIFT; p_cap->reduce_shift++ )
+  {
+    if ( len == (1u << p_cap->reduce_shift) )
+    {
+      break;
+    }
+  }
+
+  if ( p_cap->reduce_mode == REDUCE_OFF || p_cap->reduce_shift > REDUCE_MAX_SHIFT )
+  {
+    printf("Wrong reduction '%s'.\n", spec);
+    p_cap->reduce_mode = REDUCE_OFF;
+    return -1;
+  }
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      record_samples
+ *
+ * @brief
+ *
+ * @param   p_cap
+ *
+ * @return  Samples per stored record
+ **/
+static uint32_t record_samples(const capture_t *p_cap)
+{
+  if ( p_cap->packed )
+  {
+    return 2;
+  }
+
+  return (p_cap->reduce_mode == REDUCE_OFF) ? 1 : (1u << p_cap->reduce_shift);
+}
+
+/***********************************************************************
+ * @fn      record_size
+ *
+ * @brief
+ *
+ * @param   p_cap
+ *
+ * @return  Bytes per stored record
+ **/
+static uint32_t record_size(const capture_t *p_cap)
+{
+  if ( p_cap->packed )
+  {
+    return PACKED_PAIR_SIZE;
+  }
+
+  return (p_cap->reduce_mode == REDUCE_ENVELOPE) ? ENV_RECORD_SIZE : SAMPLE_SIZE;
+}
+
+/***********************************************************************
+ * @fn      capture_max_time
+ *
+ * @brief   Longest capture the pool holds at the capture rate, with the
+ *          record size of the packing or reduction mode.
+ *
+ * @param   p_cap
+ *          pool_size
+ *
+ * @return  Seconds
+ **/
+static float capture_max_time(const capture_t *p_cap, uint32_t pool_size)
+{
+  return (float)(pool_size / record_size(p_cap)) * record_samples(p_cap) / p_cap->sample_rate;
+}
+
+/***********************************************************************
+ * @fn      print_capture
+ *
+ * @brief
+ *
+ * @param   p_cap
+ *          pool_size
+ *
+ * @return  void
+ **/
+static void print_capture(const capture_t *p_cap, uint32_t pool_size)
+{
+  printf("Sampling settings:\n");
+  printf("\tSample rate:   %d Hz\n", p_cap->sample_rate);
+  printf("\tTime:          %f seg\n", p_cap->acquisition_time);
+  if ( p_cap->packed )
+  {
+    printf("\tSample size:   %.1f bytes (packed)\n", (float)PACKED_PAIR_SIZE / 2);
+  }
+  else
+  {
+    printf("\tSample size:   %d bytes\n", SAMPLE_SIZE);
+  }
+  if ( p_cap->split )
+  {
+    printf("\tPool writes:   PRU1 (split)\n");
+  }
+  printf("\tTotal samples: %d\n", p_cap->num_samples);
+  printf("\tPool holds:    %.2f seg\n", capture_max_time(p_cap, pool_size));
+
+  if ( p_cap->trig_mode != TRIG_OFF )
+  {
+    printf("\tTrigger:       %s %u", (p_cap->trig_mode == TRIG_RISING) ? "rising" :
+           (p_cap->trig_mode == TRIG_FALLING) ? "falling" : "window", p_cap->trig_lo);
+    if ( p_cap->trig_mode == TRIG_WINDOW )
+    {
+      printf(" - %u", p_cap->trig_hi);
+    }
+    printf(", %u samples before, %u after\n", p_cap->pre_loops * ADC_FIFO0_LEN, p_cap->post_loops * ADC_FIFO0_LEN);
+  }
+
+  if ( p_cap->reduce_mode != REDUCE_OFF )
+  {
+    printf("\tReduction:     %s of %u samples\n", (p_cap->reduce_mode == REDUCE_MEAN) ? "mean" : "envelope",
+           record_samples(p_cap));
+  }
+}
+
+/***********************************************************************
+ * @fn      pru_setup
+ *
+ * @brief   Open the PRU driver and load the programs. The PRU0 program
+ *          idles until a command is written in its Data RAM, the PRU1
+ *          program until PRU0 starts a split capture.
+ *
+ * @param   p_ctx
+ *
+ * @return
+ **/
+static int pru_setup(adc_ctx_t *p_ctx)
+{
+  tpruss_intc_initdata pruss_intc_initdata = PRUSS_INTC_INITDATA;
+  char path[FIRMWARE_MAX_LEN + 32];
+  void *p_ram = NULL;
+
+  /* Allocate and initialize memory */
+  prussdrv_init();
+  if ( prussdrv_open(PRU_EVTOUT_0) )
+  {
+    printf("prussdrv_open() failed\n");
+    return -1;
+  }
+
+  /* Map PRU's interrupts */
+  prussdrv_pruintc_init(&pruss_intc_initdata);
+
+  /* Map PRU0 Data RAM: parameters and command word */
+  prussdrv_map_prumem(PRUSS0_PRU0_DATARAM, &p_ram);
+  p_ctx->p_ram = (volatile uint32_t *)p_ram;
+  p_ctx->p_ram[PARAM_CMD] = CMD_NONE;
+
+  /* Map PRU shared RAM: split captures ring */
+  prussdrv_map_prumem(PRUSS0_SHARED_DATARAM, &p_ram);
+  p_ctx->p_shr_ram = (volatile uint32_t *)p_ram;
+
+  /* Map the pool: blocks are handed to the host in place */
+  prussdrv_map_extmem((void **)&p_ctx->p_pool);
+  p_ctx->p_ram[PARAM_STATUS] = STATUS_IDLE;
+  p_ctx->p_ram[PARAM_SPLIT]  = 0;
+
+  /* PRU1 first, it clears the shared ring before any capture */
+  snprintf(path, sizeof(path), "%s/pru_adc_writer.bin", p_ctx->firmware);
+  if ( prussdrv_exec_program(PRU_WRITER_NUM, path) < 0 )
+  {
+    printf("prussdrv_exec_program(\"%s\") failed\n", path);
+    prussdrv_exit();
+    return -1;
+  }
+
+  /* Load and execute the PRU program on the PRU */
+  snprintf(path, sizeof(path), "%s/pru_adc.bin", p_ctx->firmware);
+  if ( prussdrv_exec_program(PRU_NUM, path) < 0 )
+  {
+    printf("prussdrv_exec_program(\"%s\") failed\n", path);
+    prussdrv_pru_disable(PRU_WRITER_NUM);
+    prussdrv_exit();
+    return -1;
+  }
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      pru_start_capture
+ *
+ * @brief   Write the capture parameters and then the START command.
+ *
+ * @param   p_ctx
+ *          block_loops - FIFO0 reads per block event (0: no block events)
+ *          ring_blocks - Pool used as a ring of blocks or window slots
+ *
+ * @return  void
+ **/
+static void pru_start_capture(adc_ctx_t *p_ctx, uint32_t block_loops, uint32_t ring_blocks)
+{
+  const capture_t *p_cap = &p_ctx->cap;
+  volatile uint32_t *p_ram = p_ctx->p_ram;
+
+  p_ram[PARAM_POOL_ADDR]    = p_ctx->shr_mem_addr;
+  p_ram[PARAM_CLK_DIV]      = p_cap->clk_div;
+  p_ram[PARAM_NUM_LOOPS]    = p_cap->num_loops;
+  p_ram[PARAM_CH_CFG]       = p_cap->ch_cfg_code;
+  p_ram[PARAM_FIFO0_LEN]    = ADC_FIFO0_LEN;
+  p_ram[PARAM_STATUS]       = STATUS_IDLE;
+  p_ram[PARAM_LOOPS_DONE]   = 0;
+  p_ram[PARAM_BLOCK_LOOPS]  = block_loops;
+  p_ram[PARAM_RING_BLOCKS]  = ring_blocks;
+  p_ram[PARAM_BLOCK_SEQ]    = 0;
+  p_ram[PARAM_TRIG_MODE]    = p_cap->trig_mode;
+  p_ram[PARAM_TRIG_LEVEL]   = p_cap->trig_lo | (p_cap->trig_hi << 16);
+  p_ram[PARAM_PRE_LOOPS]    = p_cap->pre_loops;
+  p_ram[PARAM_POST_LOOPS]   = p_cap->post_loops;
+  p_ram[PARAM_PRE_BYTES]    = WIN_HEADER_LEN + p_cap->pre_loops * ADC_FIFO0_LEN * SAMPLE_SIZE;
+  p_ram[PARAM_SLOT_BYTES]   = p_ram[PARAM_PRE_BYTES] + p_cap->post_loops * ADC_FIFO0_LEN * SAMPLE_SIZE;
+  p_ram[PARAM_REDUCE_MODE]  = p_cap->reduce_mode;
+  p_ram[PARAM_REDUCE_SHIFT] = p_cap->reduce_shift;
+  p_ram[PARAM_PACK]         = p_cap->packed;
+  p_ram[PARAM_SPLIT]        = p_cap->split;
+  p_ram[PARAM_SAMPLE_CYCLES] = PRU_CLK_HZ / p_cap->sample_rate;
+
+  /* Parameters must land before the command */
+  __sync_synchronize();
+  p_ram[PARAM_CMD] = CMD_START;
+}
+
+/***********************************************************************
+ * @fn      pru_stop_capture
+ *
+ * @brief   Ask the PRU to end the running capture.
+ *
+ * @param   p_ctx
+ *
+ * @return  void
+ **/
+static void pru_stop_capture(adc_ctx_t *p_ctx)
+{
+  /* The PRU clears the command word when it accepts START */
+  while ( p_ctx->p_ram[PARAM_CMD] == CMD_START );
+  p_ctx->p_ram[PARAM_CMD] = CMD_STOP;
+}
+
+/***********************************************************************
+ * @fn      pru_capture_finished
+ *
+ * @brief   Events may be merged or left over, the status word tells
+ *          whether the capture is over.
+ *
+ * @param   p_ctx
+ *
+ * @return  1 if finished
+ **/
+static int pru_capture_finished(adc_ctx_t *p_ctx)
+{
+  return (p_ctx->p_ram[PARAM_STATUS] == STATUS_DONE || p_ctx->p_ram[PARAM_STATUS] == STATUS_STOPPED);
+}
+
+/***********************************************************************
+ * @fn      pru_shutdown
+ *
+ * @brief   Stop the PRU program and release the driver.
+ *
+ * @param   p_ctx
+ *
+ * @return  void
+ **/
+static void pru_shutdown(adc_ctx_t *p_ctx)
+{
+  p_ctx->p_ram[PARAM_CMD] = CMD_EXIT;
+  while ( p_ctx->p_ram[PARAM_CMD] == CMD_EXIT )
+  {
+    pru_ack_event();
+  }
+
+  /* Disable PRUs and close memory mappings */
+  prussdrv_pru_disable(PRU_NUM);
+  prussdrv_pru_disable(PRU_WRITER_NUM);
+  prussdrv_exit();
+}
+
+/***********************************************************************
+ * @fn      pru_end_cycles
+ *
+ * @brief   PRU cycles from START to the end of the last capture.
+ *
+ * @param   p_ctx
+ *
+ * @return  Cycles
+ **/
+static uint64_t pru_end_cycles(adc_ctx_t *p_ctx)
+{
+  return ((uint64_t)p_ctx->p_ram[PARAM_END_CYCLES + 1] << 32) | p_ctx->p_ram[PARAM_END_CYCLES];
+}
+
+/***********************************************************************
+ * @fn      fifo_events_name
+ *
+ * @brief   Name of the FIFO0 events in a status.
+ *
+ * @param   events - FIFO0_OVERRUN | FIFO0_UNDERFLOW
+ *
+ * @return  Name
+ **/
+static const char *fifo_events_name(uint32_t events)
+{
+  if ( (events & FIFO0_OVERRUN) && (events & FIFO0_UNDERFLOW) )
+  {
+    return "overrun and underflow";
+  }
+
+  return (events & FIFO0_OVERRUN) ? "overrun" : "underflow";
+}
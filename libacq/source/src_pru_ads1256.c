@@ -0,0 +1,967 @@
+/***********************************************************************
+ * INCLUDES
+ **/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <prussdrv.h>
+#include <pruss_intc_mapping.h>
+#include "acq.h"
+#include "acq_pru.h"
+#include "acq_ads1256.h"
+
+/***********************************************************************
+ * DEFINES
+ **/
+#define PRU_NUM     0
+#define PRU1_NUM    1       /* Second converter of a dual capture */
+
+/* ADS1256 SPI timing, in CLKIN periods (datasheet Table 3) */
+#define ADS_CLKIN_HZ   7680000
+#define ADS_SCLK_HALF  2       /* SCLK at CLKIN/4 */
+#define ADS_T6         50      /* RDATA to the first data bit */
+#define ADS_T10        8       /* Last SCLK to CS high */
+#define ADS_T11        24      /* Command to command (SYNC, RDATAC) */
+#define ADS_CYCLES(n)  (((uint64_t)(n) * PRU_CLK_HZ + ADS_CLKIN_HZ - 1) / ADS_CLKIN_HZ)
+
+/* RDATAC for the whole capture, READ_SINGLE to compare */
+#define ADS_READ_MODE  READ_CONTINUOUS
+
+/* Channel list of a converter: the second one uses the first's list
+ * unless it has its own. PGA of a list entry, or of ADCON without a list */
+#define ADS_LIST(p, a)          (((a) && (p)->num_channels[1]) ? (p)->chan_list[1] : (p)->chan_list[0])
+#define ADS_NUM_CHANNELS(p, a)  (((a) && (p)->num_channels[1]) ? (p)->num_channels[1] : (p)->num_channels[0])
+#define ADS_PGA(p, a, c)        ((ADS_NUM_CHANNELS(p, a) ? ADS_LIST(p, a)[(c) % ADS_NUM_CHANNELS(p, a)] >> 8 : \
+                                  (p)->cfg.adcon) & 0x07)
+
+/* Register block */
+#define CFG_VERSION         1
+#define CFG_TIMEOUT_MS      2000  /* Self calibration at 2.5 SPS: ~1.1 s */
+
+/* Sample as stored by the PRU: one word, code sign extended to 24 bits
+ * and channel index in the top byte, or packed in 3 bytes (code only) */
+#define SAMPLE_WORD_SIZE    4
+#define SAMPLE_PACKED_SIZE  3
+
+/* Pool split for a dual capture: whole samples of either size */
+#define ADS_POOL_ALIGN  12
+
+/* PRU0 Data RAM parameters (32-bit words), see pru_ads1256.p */
+#define PARAM_NUM_SAMPLES   0
+#define PARAM_POOL_ADDR     1
+#define PARAM_POOL_SIZE     2
+#define PARAM_CMD           3
+#define PARAM_STATUS        4
+#define PARAM_SAMPLES_DONE  5
+#define PARAM_BLOCK_LEN     6
+#define PARAM_RING_BLOCKS   7
+#define PARAM_BLOCK_SEQ     8
+#define PARAM_END_CYCLES    9   /* 64 bits: words 9 - 10 */
+#define PARAM_SCLK_HALF     11
+#define PARAM_T6_CYCLES     12
+#define PARAM_T10_CYCLES    13
+#define PARAM_T11_CYCLES    14
+#define PARAM_READ_MODE     15
+#define PARAM_NUM_CHANNELS  16
+#define PARAM_CHAN_LIST     17  /* ADS_CHAN_MAX words */
+#define PARAM_CFG_VERSION   33
+#define PARAM_CFG_REGS      34  /* STATUS, MUX, ADCON, DRATE */
+#define PARAM_CFG_IO_CAL    35  /* IO, calibration command */
+#define PARAM_CFG_STATUS    36
+#define PARAM_PACK          37
+#define PARAM_DUAL          38
+#define PARAM_STAMP_RING    64  /* 0x100 */
+
+/* PRU shared RAM words of a dual capture */
+#define SHR_DUAL_READY      0
+#define SHR_DUAL_GO         1
+
+/* Read modes */
+#define READ_SINGLE         0   /* RDATA per sample */
+#define READ_CONTINUOUS     1   /* RDATAC for the whole capture */
+
+/* Commands */
+#define CMD_NONE            0
+#define CMD_START           1
+#define CMD_STOP            2
+#define CMD_EXIT            3
+#define CMD_CONFIG          4
+
+/* Register block status */
+#define CFG_PENDING         0
+#define CFG_OK              1
+#define CFG_REJECTED        2
+
+/* Capture status */
+#define STATUS_IDLE         0
+#define STATUS_RUNNING      1
+#define STATUS_DONE         2
+#define STATUS_STOPPED      3
+
+/* Capture states on the host side */
+#define STATE_IDLE          0
+#define STATE_RUNNING       1   /* Blocks come from the ring */
+#define STATE_TAIL          2   /* Last partial block delivered */
+#define STATE_END           3
+
+#define FIRMWARE_MAX_LEN    128
+
+/***********************************************************************
+ * TYPEDEFS
+ **/
+/* Settings, staged before open() and applied as a whole */
+typedef struct pads_config_t
+{
+  ads_config_t cfg;
+  uint32_t     chan_list[2][ADS_CHAN_MAX];
+  uint32_t     num_channels[2];
+  uint32_t     num_ads;
+  uint32_t     sample_size;
+  char         firmware[FIRMWARE_MAX_LEN];  /* Directory of the .bin files */
+} pads_config_t;
+
+typedef struct pads_ctx_t
+{
+  pads_config_t      conf;
+  int                opened;
+  volatile uint32_t *p_ram[2];
+  volatile uint32_t *p_shr_ram;
+  uint8_t           *p_pool;
+  uint32_t           shr_mem_addr;
+  uint32_t           shr_mem_size;
+  uint32_t           ads_pool_size;   /* Pool bytes of each converter */
+
+  /* Capture */
+  int                state;
+  int                finished;
+  int                stopping;
+  uint32_t           block_len;
+  uint32_t           block_bytes;
+  pru_ring_t         ring;
+} pads_ctx_t;
+
+/***********************************************************************
+ * PRIVATE FUNCTIONS PROTOTYPES
+ **/
+static int  pads_open(acq_source_t *p_src);
+static int  pads_configure(acq_source_t *p_src, const acq_option_t *p_opt, uint32_t num_opts);
+static int  pads_start(acq_source_t *p_src, uint32_t num_samples, uint32_t block_len);
+static int  pads_read_block(acq_source_t *p_src, acq_block_t *p_block, int timeout_ms);
+static void pads_stop(acq_source_t *p_src);
+static int  pads_event_fd(acq_source_t *p_src);
+static void pads_close(acq_source_t *p_src);
+static int  pads_set(pads_config_t *p_conf, const char *key, const char *value, int opened);
+static int  dual_lists_valid(const pads_config_t *p_conf);
+static int  pru_setup(pads_ctx_t *p_ctx);
+static void pru_write_config(pads_ctx_t *p_ctx);
+static int  pru_wait_config(pads_ctx_t *p_ctx);
+static void pru_start_capture(pads_ctx_t *p_ctx, uint32_t num_samples, uint32_t block_len, uint32_t ring_blocks);
+static void pru_stop_capture(pads_ctx_t *p_ctx);
+static int  pru_capture_finished(pads_ctx_t *p_ctx);
+static uint32_t pru_samples_done(pads_ctx_t *p_ctx);
+static uint64_t pru_end_cycles(pads_ctx_t *p_ctx);
+static void pru_shutdown(pads_ctx_t *p_ctx);
+
+/***********************************************************************
+ * FUNCTIONS
+ **/
+/***********************************************************************
+ * @fn      src_pru_ads1256_create
+ *
+ * @brief   ADS1256 sampled by the PRU (pru_ads1256.p), or two of them
+ *          in lockstep on both PRUs. Options:
+ *            rate=SPS            2.5 - 30000 (default 30000)
+ *            channels=MUX_LIST   P[-N][:GAIN],... (default AIN0 - AINCOM)
+ *            channels2=MUX_LIST  Second converter (default: 'channels')
+ *            buffer=0|1          Analog input buffer
+ *            calibration=CAL     none, self, offset, gain, sysoffset, sysgain
+ *            packed=0|1          3 byte samples
+ *            dual=0|1            Second converter on PRU1, before open()
+ *            firmware=DIR        Directory of the PRU programs (default .)
+ *
+ * @param   void
+ *
+ * @return  Source or NULL
+ */
+acq_source_t *src_pru_ads1256_create(void)
+{
+  acq_source_t *p_src = calloc(1, sizeof(acq_source_t));
+  pads_ctx_t *p_ctx = calloc(1, sizeof(pads_ctx_t));
+
+  if ( p_src == NULL || p_ctx == NULL )
+  {
+    free(p_src);
+    free(p_ctx);
+    return NULL;
+  }
+
+  p_ctx->conf.cfg.status = 0x00;
+  p_ctx->conf.cfg.mux    = ADS_MUX(0, ADS_AINCOM);
+  p_ctx->conf.cfg.adcon  = 0x00;
+  p_ctx->conf.cfg.drate  = ADS_DRATE_30K;
+  p_ctx->conf.cfg.io     = 0xE1;
+  p_ctx->conf.cfg.cal    = 0;
+  p_ctx->conf.num_ads     = 1;
+  p_ctx->conf.sample_size = SAMPLE_WORD_SIZE;
+  strcpy(p_ctx->conf.firmware, ".");
+
+  p_src->name       = "pru_ads1256";
+  p_src->ctx        = p_ctx;
+  p_src->open       = pads_open;
+  p_src->configure  = pads_configure;
+  p_src->start      = pads_start;
+  p_src->read_block = pads_read_block;
+  p_src->stop       = pads_stop;
+  p_src->event_fd   = pads_event_fd;
+  p_src->close      = pads_close;
+
+  return p_src;
+}
+
+/***********************************************************************
+ * @fn      pads_open
+ *
+ * @brief   Find the pool and load the PRU program, it configures the
+ *          ADS1256 and waits for commands. A dual capture gives each
+ *          converter half of the pool.
+ *
+ * @param   p_src
+ *
+ * @return  0, -1 on error
+ **/
+static int pads_open(acq_source_t *p_src)
+{
+  pads_ctx_t *p_ctx = (pads_ctx_t *)p_src->ctx;
+
+  if ( get_pru_shared_mem_info(&p_ctx->shr_mem_addr, &p_ctx->shr_mem_size) < 0 )
+  {
+    return -1;
+  }
+  printf("The DDR External Memory Pool\n");
+  printf("Address: 0x%x\n", p_ctx->shr_mem_addr);
+  printf("Size:    %u bytes (0x%x)\n\n", p_ctx->shr_mem_size, p_ctx->shr_mem_size);
+
+  p_ctx->ads_pool_size = p_ctx->shr_mem_size;
+  if ( p_ctx->conf.num_ads > 1 )
+  {
+    p_ctx->ads_pool_size = p_ctx->shr_mem_size / p_ctx->conf.num_ads / ADS_POOL_ALIGN * ADS_POOL_ALIGN;
+    if ( !dual_lists_valid(&p_ctx->conf) )
+    {
+      printf("Dual capture: both channel lists must have the same length\n");
+      return -1;
+    }
+  }
+
+  if ( pru_setup(p_ctx) < 0 )
+  {
+    return -1;
+  }
+  p_ctx->opened = 1;
+  p_ctx->state  = STATE_IDLE;
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      pads_configure
+ *
+ * @brief   Stage the options, or apply them at once when the program
+ *          is loaded. Nothing changes if one of them is invalid or the
+ *          PRU rejects the registers.
+ *
+ * @param   p_src
+ *          p_opt
+ *          num_opts
+ *
+ * @return  0, -1 on error
+ **/
+static int pads_configure(acq_source_t *p_src, const acq_option_t *p_opt, uint32_t num_opts)
+{
+  pads_ctx_t *p_ctx = (pads_ctx_t *)p_src->ctx;
+  pads_config_t old = p_ctx->conf;
+  pads_config_t conf = p_ctx->conf;
+  uint32_t i = 0;
+
+  if ( p_ctx->opened && p_ctx->state != STATE_IDLE && p_ctx->state != STATE_END )
+  {
+    return -1;
+  }
+
+  for ( i = 0; i < num_opts; i++ )
+  {
+    if ( pads_set(&conf, p_opt[i].key, p_opt[i].value, p_ctx->opened) < 0 )
+    {
+      return -1;
+    }
+  }
+
+  if ( !p_ctx->opened )
+  {
+    p_ctx->conf = conf;
+    return 0;
+  }
+
+  if ( !dual_lists_valid(&conf) )
+  {
+    return -1;
+  }
+
+  /* The program applies the register block while idle */
+  p_ctx->conf = conf;
+  pru_write_config(p_ctx);
+  __sync_synchronize();
+  for ( i = 0; i < p_ctx->conf.num_ads; i++ )
+  {
+    p_ctx->p_ram[i][PARAM_CMD] = CMD_CONFIG;
+  }
+  if ( pru_wait_config(p_ctx) < 0 )
+  {
+    p_ctx->conf = old;
+    return -1;
+  }
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      pads_start
+ *
+ * @brief   Start a capture with the pool as a ring of blocks.
+ *
+ * @param   p_src
+ *          num_samples - Of each converter, limited by its pool, 0:
+ *                        until stopped
+ *          block_len - Samples per block
+ *
+ * @return  0, -1 if the block doesn't fit twice in the pool
+ **/
+static int pads_start(acq_source_t *p_src, uint32_t num_samples, uint32_t block_len)
+{
+  pads_ctx_t *p_ctx = (pads_ctx_t *)p_src->ctx;
+  pads_config_t *p_conf = &p_ctx->conf;
+  acq_format_t *p_fmt = &p_src->fmt;
+  uint32_t ring_blocks = 0;
+  uint32_t a = 0;
+  uint32_t c = 0;
+
+  if ( (uint64_t)num_samples * p_conf->sample_size >= p_ctx->ads_pool_size )
+  {
+    num_samples = p_ctx->ads_pool_size / p_conf->sample_size;
+    printf("Number of samples too large.\nCollecting %u samples (max)\n", num_samples);
+  }
+
+  block_len = (block_len == 0) ? 1 : block_len;
+  p_ctx->block_len   = block_len;
+  p_ctx->block_bytes = block_len * p_conf->sample_size;
+  ring_blocks = p_ctx->ads_pool_size / p_ctx->block_bytes;
+  if ( ring_blocks < 2 )
+  {
+    printf("Block of %u samples doesn't fit twice in the pool.\n", block_len);
+    return -1;
+  }
+
+  /* Records as the PRU stores them */
+  memset(p_fmt, 0, sizeof(acq_format_t));
+  p_fmt->encoding      = (p_conf->sample_size == SAMPLE_PACKED_SIZE) ? ACQ_ENC_S24_PACKED : ACQ_ENC_S24_TAGGED;
+  p_fmt->record_size   = p_conf->sample_size;
+  p_fmt->record_values = 1;
+  p_fmt->decimation    = 1;
+  p_fmt->num_streams   = p_conf->num_ads;
+  p_fmt->clock_hz      = PRU_CLK_HZ;
+  p_fmt->sample_rate   = (ADS_NUM_CHANNELS(p_conf, 0) > 1) ? 0 : ads_data_rate(p_conf->cfg.drate);
+  for ( a = 0; a < p_conf->num_ads; a++ )
+  {
+    p_fmt->num_channels[a] = ADS_NUM_CHANNELS(p_conf, a);
+    for ( c = 0; c < ADS_CHAN_MAX && c < ACQ_MAX_CHANNELS; c++ )
+    {
+      p_fmt->lsb[a][c] = ADS_LSB(ADS_PGA(p_conf, a, c));
+    }
+  }
+
+  /* The PRU loop may not keep up with the programmed data rate, so gaps
+   * are checked against the average block period measured so far */
+  pru_ring_init(&p_ctx->ring, &p_ctx->p_ram[0][PARAM_STAMP_RING], ring_blocks, block_len, 0);
+  pru_start_capture(p_ctx, num_samples, block_len, ring_blocks);
+  p_ctx->finished = 0;
+  p_ctx->stopping = 0;
+  p_ctx->state    = STATE_RUNNING;
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      pads_read_block
+ *
+ * @brief   Next block of the ring, in place in the pool. In a dual
+ *          capture a block is complete once both PRUs completed it, and
+ *          PRU0's stamps time both halves. The last partial block is
+ *          stamped at the end of capture.
+ *
+ * @param   p_src
+ *          p_block
+ *          timeout_ms
+ *
+ * @return  ACQ_READ_...
+ **/
+static int pads_read_block(acq_source_t *p_src, acq_block_t *p_block, int timeout_ms)
+{
+  pads_ctx_t *p_ctx = (pads_ctx_t *)p_src->ctx;
+  pru_ring_t *p_ring = &p_ctx->ring;
+  uint32_t total = 0;
+  uint32_t last = 0;
+  uint32_t a = 0;
+
+  for ( ;; )
+  {
+    if ( p_ctx->state == STATE_IDLE || p_ctx->state == STATE_END )
+    {
+      return ACQ_READ_END;
+    }
+
+    if ( p_ctx->state == STATE_RUNNING && pru_ring_next(p_ring, p_block) )
+    {
+      for ( a = 0; a < p_ctx->conf.num_ads; a++ )
+      {
+        p_block->p_data[a] = p_ctx->p_pool + a * p_ctx->ads_pool_size +
+                             (p_block->seq % p_ring->ring_blocks) * p_ctx->block_bytes;
+      }
+      p_block->num_records = p_ctx->block_len;
+      p_block->trig_index  = 0;
+      return ACQ_READ_BLOCK;
+    }
+
+    if ( p_ctx->state == STATE_RUNNING && p_ctx->finished )
+    {
+      p_ctx->state = STATE_TAIL;
+      last  = p_ring->last;
+      total = pru_samples_done(p_ctx);
+      if ( total > last * p_ctx->block_len )
+      {
+        for ( a = 0; a < p_ctx->conf.num_ads; a++ )
+        {
+          p_block->p_data[a] = p_ctx->p_pool + a * p_ctx->ads_pool_size +
+                               (last % p_ring->ring_blocks) * p_ctx->block_bytes;
+        }
+        p_block->num_records = total - last * p_ctx->block_len;
+        p_block->seq         = last;
+        p_block->flags       = ACQ_BLOCK_STAMPED;
+        p_block->status      = 0;
+        p_block->trig_index  = 0;
+        p_block->cycles      = pru_end_cycles(p_ctx);
+        clock_fit_realtime(&p_ring->fit, p_block->cycles, &p_block->real);
+        return ACQ_READ_BLOCK;
+      }
+    }
+
+    if ( p_ctx->state == STATE_TAIL )
+    {
+      p_ctx->state = STATE_END;
+      p_src->stats.lost_blocks = p_ring->lost;
+      p_src->stats.gaps        = p_ring->gaps;
+      p_src->stats.stopped     = (p_ctx->p_ram[0][PARAM_STATUS] == STATUS_STOPPED);
+      p_src->stats.seconds     = (double)pru_end_cycles(p_ctx) / PRU_CLK_HZ;
+      pru_ring_report(p_ring, 0);
+      return ACQ_READ_END;
+    }
+
+    if ( !pru_wait_event(timeout_ms) )
+    {
+      return ACQ_READ_AGAIN;
+    }
+    p_ctx->finished = pru_capture_finished(p_ctx);
+    last = p_ctx->p_ram[0][PARAM_BLOCK_SEQ];
+    if ( p_ctx->conf.num_ads > 1 && p_ctx->p_ram[1][PARAM_BLOCK_SEQ] - p_ring->seq < last - p_ring->seq )
+    {
+      last = p_ctx->p_ram[1][PARAM_BLOCK_SEQ];
+    }
+    pru_ring_update(p_ring, last);
+  }
+}
+
+/***********************************************************************
+ * @fn      pads_stop
+ *
+ * @brief
+ *
+ * @param   p_src
+ *
+ * @return  void
+ **/
+static void pads_stop(acq_source_t *p_src)
+{
+  pads_ctx_t *p_ctx = (pads_ctx_t *)p_src->ctx;
+
+  if ( p_ctx->state == STATE_RUNNING && !p_ctx->finished && !p_ctx->stopping )
+  {
+    pru_stop_capture(p_ctx);
+    p_ctx->stopping = 1;
+  }
+}
+
+/***********************************************************************
+ * @fn      pads_event_fd
+ *
+ * @brief
+ *
+ * @param   p_src
+ *
+ * @return
+ **/
+static int pads_event_fd(acq_source_t *p_src)
+{
+  return prussdrv_pru_event_fd(PRU_EVTOUT_0);
+}
+
+/***********************************************************************
+ * @fn      pads_close
+ *
+ * @brief
+ *
+ * @param   p_src
+ *
+ * @return  void
+ **/
+static void pads_close(acq_source_t *p_src)
+{
+  pads_ctx_t *p_ctx = (pads_ctx_t *)p_src->ctx;
+
+  if ( p_ctx->opened )
+  {
+    pru_shutdown(p_ctx);
+    p_ctx->opened = 0;
+  }
+}
+
+/***********************************************************************
+ * @fn      pads_set
+ *
+ * @brief   One option into the settings.
+ *
+ * @param   p_conf
+ *          key
+ *          value
+ *          opened - The program is loaded: the converters are fixed
+ *
+ * @return  0, -1 if the key is unknown or the value invalid
+ **/
+static int pads_set(pads_config_t *p_conf, const char *key, const char *value, int opened)
+{
+  int n = 0;
+
+  if ( strcmp(key, "rate") == 0 )
+  {
+    return ads_parse_data_rate(value, &p_conf->cfg.drate);
+  }
+  else if ( strcmp(key, "channels") == 0 || strcmp(key, "channels2") == 0 )
+  {
+    uint32_t ads = (key[8] == '2');
+
+    n = ads_parse_channels(value, p_conf->chan_list[ads]);
+    if ( n < 0 )
+    {
+      return -1;
+    }
+    p_conf->num_channels[ads] = n;
+
+    /* Startup channel */
+    if ( ads == 0 )
+    {
+      p_conf->cfg.mux   = CHAN_MUX(p_conf->chan_list[0][0]);
+      p_conf->cfg.adcon = (uint8_t)(p_conf->chan_list[0][0] >> 8);
+    }
+    return 0;
+  }
+  else if ( strcmp(key, "buffer") == 0 )
+  {
+    p_conf->cfg.status = atoi(value) ? (p_conf->cfg.status | ADS_STATUS_BUFEN) : (p_conf->cfg.status & ~ADS_STATUS_BUFEN);
+    return 0;
+  }
+  else if ( strcmp(key, "calibration") == 0 )
+  {
+    return ads_parse_calibration(value, &p_conf->cfg.cal);
+  }
+  else if ( strcmp(key, "packed") == 0 )
+  {
+    p_conf->sample_size = atoi(value) ? SAMPLE_PACKED_SIZE : SAMPLE_WORD_SIZE;
+    return 0;
+  }
+  else if ( strcmp(key, "dual") == 0 && !opened )
+  {
+    p_conf->num_ads = atoi(value) ? 2 : 1;
+    return 0;
+  }
+  else if ( strcmp(key, "firmware") == 0 && !opened && strlen(value) < FIRMWARE_MAX_LEN )
+  {
+    strcpy(p_conf->firmware, value);
+    return 0;
+  }
+
+  return -1;
+}
+
+/***********************************************************************
+ * @fn      dual_lists_valid
+ *
+ * @brief   Both converters of a dual capture spend the same time per
+ *          sample only if they both cycle through as many channels, or
+ *          neither cycles.
+ *
+ * @param   p_conf
+ *
+ * @return  1 if the lists keep the converters in lockstep
+ **/
+static int dual_lists_valid(const pads_config_t *p_conf)
+{
+  uint32_t n0 = ADS_NUM_CHANNELS(p_conf, 0);
+  uint32_t n1 = ADS_NUM_CHANNELS(p_conf, 1);
+
+  return (p_conf->num_ads == 1 || (n0 <= 1 && n1 <= 1) || n0 == n1);
+}
+
+/***********************************************************************
+ * @fn      pru_setup
+ *
+ * @brief   Open the PRU driver and load the program. The program sets
+ *          the ADS1256 up and idles until a command is written in its
+ *          Data RAM. A dual capture loads the PRU1 build first: it waits
+ *          for DRDY, which its converter raises once PRU0 sets SYNC.
+ *
+ * @param   p_ctx
+ *
+ * @return
+ **/
+static int pru_setup(pads_ctx_t *p_ctx)
+{
+  tpruss_intc_initdata pruss_intc_initdata = PRUSS_INTC_INITDATA;
+  char path[FIRMWARE_MAX_LEN + 32];
+  void *p_ram = NULL;
+  uint32_t a = 0;
+
+  /* Allocate and initialize memory */
+  prussdrv_init();
+  if ( prussdrv_open(PRU_EVTOUT_0) )
+  {
+    printf("prussdrv_open() failed\n");
+    return -1;
+  }
+
+  /* Map PRU's interrupts */
+  prussdrv_pruintc_init(&pruss_intc_initdata);
+
+  /* Map PRU0 Data RAM: parameters and command word */
+  prussdrv_map_prumem(PRUSS0_PRU0_DATARAM, &p_ram);
+  p_ctx->p_ram[0] = (volatile uint32_t *)p_ram;
+
+  /* Dual capture: PRU1 Data RAM and the handshake in PRU shared RAM */
+  if ( p_ctx->conf.num_ads > 1 )
+  {
+    prussdrv_map_prumem(PRUSS0_PRU1_DATARAM, &p_ram);
+    p_ctx->p_ram[1] = (volatile uint32_t *)p_ram;
+    prussdrv_map_prumem(PRUSS0_SHARED_DATARAM, &p_ram);
+    p_ctx->p_shr_ram = (volatile uint32_t *)p_ram;
+  }
+
+  /* Map the pool: blocks are handed to the host in place */
+  prussdrv_map_extmem((void **)&p_ctx->p_pool);
+
+  /* SPI timing in PRU cycles, read by the program at startup */
+  for ( a = 0; a < p_ctx->conf.num_ads; a++ )
+  {
+    volatile uint32_t *p_param = p_ctx->p_ram[a];
+
+    p_param[PARAM_CMD]        = CMD_NONE;
+    p_param[PARAM_STATUS]     = STATUS_IDLE;
+    p_param[PARAM_SCLK_HALF]  = ADS_CYCLES(ADS_SCLK_HALF);
+    p_param[PARAM_T6_CYCLES]  = ADS_CYCLES(ADS_T6);
+    p_param[PARAM_T10_CYCLES] = ADS_CYCLES(ADS_T10);
+    p_param[PARAM_T11_CYCLES] = ADS_CYCLES(ADS_T11);
+  }
+  pru_write_config(p_ctx);
+
+  /* Load and execute the PRU program on the PRU */
+  if ( p_ctx->conf.num_ads > 1 )
+  {
+    snprintf(path, sizeof(path), "%s/pru_ads1256_pru1.bin", p_ctx->conf.firmware);
+    if ( prussdrv_exec_program(PRU1_NUM, path) < 0 )
+    {
+      printf("prussdrv_exec_program(\"%s\") failed\n", path);
+      prussdrv_exit();
+      return -1;
+    }
+  }
+  snprintf(path, sizeof(path), "%s/pru_ads1256.bin", p_ctx->conf.firmware);
+  if ( prussdrv_exec_program(PRU_NUM, path) < 0 )
+  {
+    printf("prussdrv_exec_program(\"%s\") failed\n", path);
+    prussdrv_pru_disable(PRU1_NUM);
+    prussdrv_exit();
+    return -1;
+  }
+
+  /* The program applies the register block before idling */
+  if ( pru_wait_config(p_ctx) < 0 )
+  {
+    prussdrv_pru_disable(PRU_NUM);
+    prussdrv_pru_disable(PRU1_NUM);
+    prussdrv_exit();
+    return -1;
+  }
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      pru_write_config
+ *
+ * @brief   Write the registers to the register block in PRU Data RAM.
+ *          The second converter starts on the first channel of its own
+ *          list.
+ *
+ * @param   p_ctx
+ *
+ * @return  void
+ **/
+static void pru_write_config(pads_ctx_t *p_ctx)
+{
+  const ads_config_t *p_cfg = &p_ctx->conf.cfg;
+  uint32_t a = 0;
+
+  for ( a = 0; a < p_ctx->conf.num_ads; a++ )
+  {
+    volatile uint32_t *p_param = p_ctx->p_ram[a];
+    uint8_t mux   = p_cfg->mux;
+    uint8_t adcon = p_cfg->adcon;
+
+    if ( a > 0 && p_ctx->conf.num_channels[a] > 0 )
+    {
+      mux   = CHAN_MUX(p_ctx->conf.chan_list[a][0]);
+      adcon = (uint8_t)(p_ctx->conf.chan_list[a][0] >> 8);
+    }
+
+    p_param[PARAM_CFG_STATUS]  = CFG_PENDING;
+    p_param[PARAM_CFG_VERSION] = CFG_VERSION;
+    p_param[PARAM_CFG_REGS]    = p_cfg->status | (mux << 8) | (adcon << 16) | ((uint32_t)p_cfg->drate << 24);
+    p_param[PARAM_CFG_IO_CAL]  = p_cfg->io | (p_cfg->cal << 8);
+  }
+}
+
+/***********************************************************************
+ * @fn      pru_wait_config
+ *
+ * @brief   Wait for the PRU to apply the register block.
+ *
+ * @param   p_ctx
+ *
+ * @return  0, -1 on timeout or if the block was rejected
+ **/
+static int pru_wait_config(pads_ctx_t *p_ctx)
+{
+  uint32_t a = 0;
+  int ms = 0;
+
+  for ( a = 0; a < p_ctx->conf.num_ads; a++ )
+  {
+    volatile uint32_t *p_param = p_ctx->p_ram[a];
+
+    while ( p_param[PARAM_CFG_STATUS] == CFG_PENDING && ms < CFG_TIMEOUT_MS )
+    {
+      usleep(1000);
+      ms++;
+    }
+
+    if ( p_param[PARAM_CFG_STATUS] != CFG_OK )
+    {
+      printf("ADS1256%s setup %s\n", (a > 0) ? " (PRU1)" : "",
+             (p_param[PARAM_CFG_STATUS] == CFG_REJECTED) ? "rejected" : "timed out");
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      pru_start_capture
+ *
+ * @brief   Write the capture parameters and then the START command.
+ *          A dual capture starts PRU1 first: it sets up and waits for
+ *          PRU0 to pulse the common SYNC line. Each converter writes its
+ *          half of the pool.
+ *
+ * @param   p_ctx
+ *          num_samples - 0: until STOP
+ *          block_len - Samples per block event
+ *          ring_blocks - Pool used as a ring of blocks
+ *
+ * @return  void
+ **/
+static void pru_start_capture(pads_ctx_t *p_ctx, uint32_t num_samples, uint32_t block_len, uint32_t ring_blocks)
+{
+  const pads_config_t *p_conf = &p_ctx->conf;
+  uint32_t i = 0;
+  uint32_t a = 0;
+
+  for ( a = 0; a < p_conf->num_ads; a++ )
+  {
+    volatile uint32_t *p_param = p_ctx->p_ram[a];
+
+    p_param[PARAM_NUM_SAMPLES]  = num_samples;
+    p_param[PARAM_POOL_ADDR]    = p_ctx->shr_mem_addr + a * p_ctx->ads_pool_size;
+    p_param[PARAM_POOL_SIZE]    = p_ctx->ads_pool_size;
+    p_param[PARAM_STATUS]       = STATUS_IDLE;
+    p_param[PARAM_SAMPLES_DONE] = 0;
+    p_param[PARAM_BLOCK_LEN]    = block_len;
+    p_param[PARAM_RING_BLOCKS]  = ring_blocks;
+    p_param[PARAM_BLOCK_SEQ]    = 0;
+    p_param[PARAM_READ_MODE]    = ADS_READ_MODE;
+    p_param[PARAM_PACK]         = (p_conf->sample_size == SAMPLE_PACKED_SIZE);
+    p_param[PARAM_DUAL]         = (p_conf->num_ads > 1);
+    p_param[PARAM_NUM_CHANNELS] = ADS_NUM_CHANNELS(p_conf, a);
+    for ( i = 0; i < ADS_NUM_CHANNELS(p_conf, a); i++ )
+    {
+      p_param[PARAM_CHAN_LIST + i] = ADS_LIST(p_conf, a)[i];
+    }
+  }
+  if ( p_conf->num_ads > 1 )
+  {
+    p_ctx->p_shr_ram[SHR_DUAL_READY] = 0;
+    p_ctx->p_shr_ram[SHR_DUAL_GO]    = 0;
+  }
+
+  /* Parameters must land before the command */
+  __sync_synchronize();
+  for ( a = p_conf->num_ads; a > 0; a-- )
+  {
+    p_ctx->p_ram[a - 1][PARAM_CMD] = CMD_START;
+  }
+}
+
+/***********************************************************************
+ * @fn      pru_stop_capture
+ *
+ * @brief   Ask the PRU to end the running capture.
+ *
+ * @param   p_ctx
+ *
+ * @return  void
+ **/
+static void pru_stop_capture(pads_ctx_t *p_ctx)
+{
+  uint32_t a = 0;
+
+  /* The PRU clears the command word when it accepts START */
+  for ( a = 0; a < p_ctx->conf.num_ads; a++ )
+  {
+    while ( p_ctx->p_ram[a][PARAM_CMD] == CMD_START );
+    p_ctx->p_ram[a][PARAM_CMD] = CMD_STOP;
+  }
+}
+
+/***********************************************************************
+ * @fn      pru_capture_finished
+ *
+ * @brief   Events may be merged or left over, the status word tells
+ *          whether the capture is over. PRU1 raises no events: once PRU0
+ *          is over it is polled, it ends within a sample of PRU0.
+ *
+ * @param   p_ctx
+ *
+ * @return  1 if finished
+ **/
+static int pru_capture_finished(pads_ctx_t *p_ctx)
+{
+  volatile uint32_t *p_ram0 = p_ctx->p_ram[0];
+  volatile uint32_t *p_ram1 = p_ctx->p_ram[1];
+  int ms = 0;
+
+  if ( p_ram0[PARAM_STATUS] != STATUS_DONE && p_ram0[PARAM_STATUS] != STATUS_STOPPED )
+  {
+    return 0;
+  }
+
+  while ( p_ctx->conf.num_ads > 1 && p_ram1[PARAM_STATUS] != STATUS_DONE && p_ram1[PARAM_STATUS] != STATUS_STOPPED &&
+          ms < CFG_TIMEOUT_MS )
+  {
+    usleep(1000);
+    ms++;
+  }
+
+  return 1;
+}
+
+/***********************************************************************
+ * @fn      pru_samples_done
+ *
+ * @brief   Samples of the last capture, those both converters took in a
+ *          dual capture (a STOP may land a sample apart on each PRU).
+ *
+ * @param   p_ctx
+ *
+ * @return
+ **/
+static uint32_t pru_samples_done(pads_ctx_t *p_ctx)
+{
+  uint32_t done = p_ctx->p_ram[0][PARAM_SAMPLES_DONE];
+
+  if ( p_ctx->conf.num_ads > 1 && p_ctx->p_ram[1][PARAM_SAMPLES_DONE] < done )
+  {
+    done = p_ctx->p_ram[1][PARAM_SAMPLES_DONE];
+  }
+
+  return done;
+}
+
+/***********************************************************************
+ * @fn      pru_end_cycles
+ *
+ * @brief   PRU cycles from START to the end of the last capture.
+ *
+ * @param   p_ctx
+ *
+ * @return  Cycles
+ **/
+static uint64_t pru_end_cycles(pads_ctx_t *p_ctx)
+{
+  return ((uint64_t)p_ctx->p_ram[0][PARAM_END_CYCLES + 1] << 32) | p_ctx->p_ram[0][PARAM_END_CYCLES];
+}
+
+/***********************************************************************
+ * @fn      pru_shutdown
+ *
+ * @brief   Stop the PRU program and release the driver.
+ *
+ * @param   p_ctx
+ *
+ * @return  void
+ **/
+static void pru_shutdown(pads_ctx_t *p_ctx)
+{
+  volatile uint32_t *p_ram0 = p_ctx->p_ram[0];
+  volatile uint32_t *p_ram1 = p_ctx->p_ram[1];
+  int ms = 0;
+
+  if ( p_ctx->conf.num_ads > 1 )
+  {
+    p_ram1[PARAM_CMD] = CMD_EXIT;
+  }
+  p_ram0[PARAM_CMD] = CMD_EXIT;
+  while ( p_ram0[PARAM_CMD] == CMD_EXIT )
+  {
+    pru_ack_event();
+  }
+  while ( p_ctx->conf.num_ads > 1 && p_ram1[PARAM_CMD] == CMD_EXIT && ms < CFG_TIMEOUT_MS )
+  {
+    usleep(1000);
+    ms++;
+  }
+
+  /* Disable PRU and close memory mappings */
+  prussdrv_pru_disable(PRU_NUM);
+  if ( p_ctx->conf.num_ads > 1 )
+  {
+    prussdrv_pru_disable(PRU1_NUM);
+  }
+  prussdrv_exit();
+}
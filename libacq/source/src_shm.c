@@ -0,0 +1,397 @@
+/***********************************************************************
+ * INCLUDES
+ **/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "acq.h"
+#include "acq_shm.h"
+
+/***********************************************************************
+ * DEFINES
+ **/
+#define SHM_NAME_LEN        64
+
+/***********************************************************************
+ * TYPEDEFS
+ **/
+typedef struct shm_src_ctx_t
+{
+  char              name[SHM_NAME_LEN];
+  int               oldest;         /* Start from the oldest block kept */
+  uint8_t          *p_seg;
+  size_t            seg_size;
+  const acq_shm_header_t *p_hdr;
+  const acq_shm_slot_t   *p_slot;
+  const uint8_t    *p_area;
+  uint32_t          num_slots;
+  uint32_t          data_size;
+  uint64_t          next;           /* Block to read */
+  uint64_t          prev_pos;       /* Of the block handed out last */
+  int               prev_valid;
+  uint32_t          num_samples;    /* 0: to the end of the capture */
+  uint64_t          done;
+  int               running;
+} shm_src_ctx_t;
+
+/***********************************************************************
+ * PRIVATE FUNCTIONS PROTOTYPES
+ **/
+static int  shm_src_open(acq_source_t *p_src);
+static int  shm_src_configure(acq_source_t *p_src, const acq_option_t *p_opt, uint32_t num_opts);
+static int  shm_src_start(acq_source_t *p_src, uint32_t num_samples, uint32_t block_len);
+static int  shm_src_read_block(acq_source_t *p_src, acq_block_t *p_block, int timeout_ms);
+static void shm_src_stop(acq_source_t *p_src);
+static void shm_src_close(acq_source_t *p_src);
+
+/***********************************************************************
+ * FUNCTIONS
+ **/
+/***********************************************************************
+ * @fn      src_shm_create
+ *
+ * @brief   Reader of the blocks published by sink_shm_create() in
+ *          another process. Records are handed out in place in the
+ *          segment, with no locks; blocks overwritten before they were
+ *          read, or while they were in use, count as lost blocks.
+ *          Options:
+ *            name=NAME           Segment (before open)
+ *            from=now|oldest     Start from the next block (default) or
+ *                                from the oldest one still kept
+ *          Ends when the capture does, or with the samples asked for.
+ *
+ * @param   void
+ *
+ * @return  Source or NULL
+ */
+acq_source_t *src_shm_create(void)
+{
+  acq_source_t *p_src = calloc(1, sizeof(acq_source_t));
+  shm_src_ctx_t *p_ctx = calloc(1, sizeof(shm_src_ctx_t));
+
+  if ( p_src == NULL || p_ctx == NULL )
+  {
+    free(p_src);
+    free(p_ctx);
+    return NULL;
+  }
+
+  strcpy(p_ctx->name, "/acq");
+
+  p_src->name       = "shm";
+  p_src->ctx        = p_ctx;
+  p_src->open       = shm_src_open;
+  p_src->configure  = shm_src_configure;
+  p_src->start      = shm_src_start;
+  p_src->read_block = shm_src_read_block;
+  p_src->stop       = shm_src_stop;
+  p_src->event_fd   = NULL;
+  p_src->close      = shm_src_close;
+
+  return p_src;
+}
+
+/***********************************************************************
+ * @fn      shm_src_open
+ *
+ * @brief   Attach to the segment, read-only.
+ *
+ * @param   p_src
+ *
+ * @return  0, -1 if there's no capture published
+ **/
+static int shm_src_open(acq_source_t *p_src)
+{
+  shm_src_ctx_t *p_ctx = (shm_src_ctx_t *)p_src->ctx;
+  struct stat st;
+  int fd = shm_open(p_ctx->name, O_RDONLY, 0);
+
+  if ( fd < 0 )
+  {
+    perror("shm_open(source)");
+    return -1;
+  }
+  if ( fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(acq_shm_header_t) )
+  {
+    printf("%s is not a published capture.\n", p_ctx->name);
+    close(fd);
+    return -1;
+  }
+
+  p_ctx->seg_size = st.st_size;
+  p_ctx->p_seg = mmap(NULL, p_ctx->seg_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if ( p_ctx->p_seg == MAP_FAILED )
+  {
+    perror("mmap(shm)");
+    p_ctx->p_seg = NULL;
+    return -1;
+  }
+
+  p_ctx->p_hdr = (const acq_shm_header_t *)p_ctx->p_seg;
+  if ( __atomic_load_n(&p_ctx->p_hdr->magic, __ATOMIC_ACQUIRE) != ACQ_SHM_MAGIC ||
+       p_ctx->p_hdr->version != ACQ_SHM_VERSION ||
+       p_ctx->p_hdr->data_offset + (uint64_t)p_ctx->p_hdr->data_size > p_ctx->seg_size ||
+       p_ctx->p_hdr->slots_offset + (uint64_t)p_ctx->p_hdr->num_slots * sizeof(acq_shm_slot_t) >
+       p_ctx->p_hdr->data_offset )
+  {
+    printf("%s is not a published capture.\n", p_ctx->name);
+    shm_src_close(p_src);
+    return -1;
+  }
+
+  p_ctx->num_slots = p_ctx->p_hdr->num_slots;
+  p_ctx->data_size = p_ctx->p_hdr->data_size;
+  p_ctx->p_slot    = (const acq_shm_slot_t *)(p_ctx->p_seg + p_ctx->p_hdr->slots_offset);
+  p_ctx->p_area    = p_ctx->p_seg + p_ctx->p_hdr->data_offset;
+  p_src->fmt       = p_ctx->p_hdr->fmt;
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      shm_src_configure
+ *
+ * @brief   Checked and kept, all of them or none.
+ *
+ * @param   p_src
+ *          p_opt
+ *          num_opts
+ *
+ * @return  0, -1 on error
+ **/
+static int shm_src_configure(acq_source_t *p_src, const acq_option_t *p_opt, uint32_t num_opts)
+{
+  shm_src_ctx_t *p_ctx = (shm_src_ctx_t *)p_src->ctx;
+  shm_src_ctx_t cfg = *p_ctx;
+  uint32_t i = 0;
+
+  if ( p_ctx->running )
+  {
+    return -1;
+  }
+
+  for ( i = 0; i < num_opts; i++ )
+  {
+    if ( strcmp(p_opt[i].key, "name") == 0 && p_ctx->p_seg == NULL && strlen(p_opt[i].value) + 2 <= SHM_NAME_LEN )
+    {
+      snprintf(cfg.name, SHM_NAME_LEN, "%s%s", (p_opt[i].value[0] == '/') ? "" : "/", p_opt[i].value);
+    }
+    else if ( strcmp(p_opt[i].key, "from") == 0 && strcmp(p_opt[i].value, "now") == 0 )
+    {
+      cfg.oldest = 0;
+    }
+    else if ( strcmp(p_opt[i].key, "from") == 0 && strcmp(p_opt[i].value, "oldest") == 0 )
+    {
+      cfg.oldest = 1;
+    }
+    else
+    {
+      return -1;
+    }
+  }
+  *p_ctx = cfg;
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      shm_src_start
+ *
+ * @brief
+ *
+ * @param   p_src
+ *          num_samples - 0: until the capture ends
+ *          block_len - Ignored, blocks are as published
+ *
+ * @return  0
+ **/
+static int shm_src_start(acq_source_t *p_src, uint32_t num_samples, uint32_t block_len)
+{
+  shm_src_ctx_t *p_ctx = (shm_src_ctx_t *)p_src->ctx;
+  uint64_t write_seq = __atomic_load_n(&p_ctx->p_hdr->write_seq, __ATOMIC_ACQUIRE);
+
+  p_ctx->next = write_seq;
+  if ( p_ctx->oldest )
+  {
+    p_ctx->next = (write_seq > p_ctx->num_slots) ? write_seq - p_ctx->num_slots : 0;
+  }
+  p_ctx->prev_valid  = 0;
+  p_ctx->num_samples = num_samples;
+  p_ctx->done        = 0;
+  p_ctx->running     = 1;
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      shm_src_read_block
+ *
+ * @brief   Next block published. The slot and write_pos are read again
+ *          after the block: if the producer got there meanwhile, the
+ *          block is skipped as lost.
+ *
+ * @param   p_src
+ *          p_block
+ *          timeout_ms
+ *
+ * @return  ACQ_READ_...
+ **/
+static int shm_src_read_block(acq_source_t *p_src, acq_block_t *p_block, int timeout_ms)
+{
+  shm_src_ctx_t *p_ctx = (shm_src_ctx_t *)p_src->ctx;
+  const acq_shm_header_t *p_hdr = p_ctx->p_hdr;
+  uint32_t streams = (p_src->fmt.num_streams > 1) ? p_src->fmt.num_streams : 1;
+  struct timespec ts;
+  acq_shm_slot_t slot;
+  uint64_t write_seq = 0;
+  uint64_t write_pos = 0;
+  uint32_t futex = 0;
+  uint32_t a = 0;
+  int waited = 0;
+
+  /* The block handed out last, overwritten while it was in use */
+  if ( p_ctx->prev_valid )
+  {
+    write_pos = __atomic_load_n(&p_hdr->write_pos, __ATOMIC_ACQUIRE);
+    if ( write_pos - p_ctx->prev_pos > p_ctx->data_size )
+    {
+      p_src->stats.lost_blocks++;
+    }
+    p_ctx->prev_valid = 0;
+  }
+
+  for ( ;; )
+  {
+    if ( !p_ctx->running || (p_ctx->num_samples != 0 && p_ctx->done >= p_ctx->num_samples) )
+    {
+      p_ctx->running = 0;
+      return ACQ_READ_END;
+    }
+
+    futex     = __atomic_load_n(&p_hdr->futex, __ATOMIC_ACQUIRE);
+    write_seq = __atomic_load_n(&p_hdr->write_seq, __ATOMIC_ACQUIRE);
+
+    if ( p_ctx->next < write_seq )
+    {
+      const acq_shm_slot_t *p_slot = NULL;
+
+      /* Lapped: on to the oldest block kept */
+      if ( write_seq - p_ctx->next > p_ctx->num_slots )
+      {
+        p_src->stats.lost_blocks += write_seq - p_ctx->num_slots - p_ctx->next;
+        p_ctx->next = write_seq - p_ctx->num_slots;
+      }
+
+      p_slot = &p_ctx->p_slot[p_ctx->next % p_ctx->num_slots];
+      if ( __atomic_load_n(&p_slot->seq, __ATOMIC_ACQUIRE) != p_ctx->next )
+      {
+        p_src->stats.lost_blocks++;
+        p_ctx->next++;
+        continue;
+      }
+      memcpy(&slot, p_slot, sizeof(slot));
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+      write_pos = __atomic_load_n(&p_hdr->write_pos, __ATOMIC_RELAXED);
+      if ( __atomic_load_n(&p_slot->seq, __ATOMIC_RELAXED) != p_ctx->next ||
+           write_pos - slot.pos > p_ctx->data_size || slot.bytes > p_ctx->data_size )
+      {
+        p_src->stats.lost_blocks++;
+        p_ctx->next++;
+        continue;
+      }
+
+      memset(p_block, 0, sizeof(acq_block_t));
+      for ( a = 0; a < streams; a++ )
+      {
+        p_block->p_data[a] = p_ctx->p_area + slot.pos % p_ctx->data_size + a * (slot.bytes / streams);
+      }
+      p_block->num_records  = slot.num_records;
+      p_block->seq          = slot.block_seq;
+      p_block->flags        = slot.flags;
+      p_block->status       = slot.status;
+      p_block->trig_index   = slot.trig_index;
+      p_block->cycles       = slot.cycles;
+      p_block->real.tv_sec  = slot.real_sec;
+      p_block->real.tv_nsec = slot.real_nsec;
+
+      p_ctx->prev_pos   = slot.pos;
+      p_ctx->prev_valid = 1;
+      p_ctx->next++;
+      p_ctx->done += (uint64_t)slot.num_records * p_src->fmt.record_values * p_src->fmt.decimation;
+      return ACQ_READ_BLOCK;
+    }
+
+    if ( __atomic_load_n(&p_hdr->state, __ATOMIC_ACQUIRE) != ACQ_SHM_RUNNING )
+    {
+      /* Blocks published just before the end */
+      if ( p_ctx->next < __atomic_load_n(&p_hdr->write_seq, __ATOMIC_ACQUIRE) )
+      {
+        continue;
+      }
+      p_ctx->running = 0;
+      return ACQ_READ_END;
+    }
+
+    if ( timeout_ms == 0 || (waited && timeout_ms > 0) )
+    {
+      return ACQ_READ_AGAIN;
+    }
+    ts.tv_sec  = timeout_ms / 1000;
+    ts.tv_nsec = (timeout_ms % 1000) * 1000000;
+    if ( syscall(SYS_futex, &p_hdr->futex, FUTEX_WAIT, futex, (timeout_ms > 0) ? &ts : NULL, NULL, 0) < 0 &&
+         errno != EAGAIN && errno != EINTR && errno != ETIMEDOUT )
+    {
+      perror("futex(shm)");
+      return -1;
+    }
+    waited = 1;
+  }
+}
+
+/***********************************************************************
+ * @fn      shm_src_stop
+ *
+ * @brief   Detach at the next read, the producer isn't told.
+ *
+ * @param   p_src
+ *
+ * @return  void
+ **/
+static void shm_src_stop(acq_source_t *p_src)
+{
+  shm_src_ctx_t *p_ctx = (shm_src_ctx_t *)p_src->ctx;
+
+  p_ctx->running = 0;
+  p_src->stats.stopped = 1;
+}
+
+/***********************************************************************
+ * @fn      shm_src_close
+ *
+ * @brief
+ *
+ * @param   p_src
+ *
+ * @return  void
+ **/
+static void shm_src_close(acq_source_t *p_src)
+{
+  shm_src_ctx_t *p_ctx = (shm_src_ctx_t *)p_src->ctx;
+
+  if ( p_ctx->p_seg != NULL )
+  {
+    munmap(p_ctx->p_seg, p_ctx->seg_size);
+  }
+  p_ctx->p_seg   = NULL;
+  p_ctx->p_hdr   = NULL;
+  p_ctx->running = 0;
+}
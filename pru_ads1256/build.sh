@@ -1,6 +1,15 @@
 #!/bin/bash
 echo "Building the PRU code"
 pasm -b pru_ads1256.p
+pasm -b -DPRU1 pru_ads1256.p pru_ads1256_pru1   # second converter (dual capture)
+
+echo "Building the capture library"
+make -C ../libacq libacq.a || exit 1
 
 echo "Building the Host application"
-gcc host_ads1256.c -o host_ads1256 -lprussdrv
+# NEON sample unpacker on the BeagleBone (Cortex-A8)
+CFLAGS="-O2"
+case "$(uname -m)" in
+  arm*) CFLAGS="$CFLAGS -mfpu=neon" ;;
+esac
+gcc $CFLAGS -I../libacq/include host_ads1256.c ../libacq/libacq.a -o host_ads1256 -lprussdrv -lpthread -lm
@@ -5,6 +5,7 @@ modprobe uio_pruss extram_pool_sz=0x1E8480
 
 echo "Checking pins"
 cat /sys/kernel/debug/pinctrl/44e10800.pinmux/pins | grep '107\|103\|105\|101\|102'
+cat /sys/kernel/debug/pinctrl/44e10800.pinmux/pins | grep 'pin 12 \|pin 41 \|pin 42 \|pin 43 \|pin 45 \|pin 47 '
 
 echo "Compiling the overlay from .dts to .dtbo"
 dtc -O dtb -o PRU-SPI-ADS1256-00A0.dtbo -b 0 -@ PRU-SPI-ADS1256.dts
@@ -6,103 +6,188 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
-#include <prussdrv.h>
-#include <pruss_intc_mapping.h>
-#include <fcntl.h>
-#include <sys/types.h>
-#include <sys/mman.h>
+#include "acq.h"
+#include "acq_ads1256.h"
 
 /***********************************************************************
  * DEFINES
  **/
-#define PRU_NUM     0
+#define DEF_BLOCK_LEN  1000
+#define DEF_NUM_SAMPLES 10
 
-#define MMAP1_ADDR_FILE_DIR   "/sys/class/uio/uio0/maps/map1/addr"
-#define MMAP1_SIZE_FILE_DIR   "/sys/class/uio/uio0/maps/map1/size"
-
-#define MAP_SIZE 0x0FFFFFFF
-#define MAP_MASK (MAP_SIZE - 1)
-#define MMAP_LOC   "/sys/class/uio/uio0/maps/map1/"
+/* Daemon */
+#define DAEMON_SOCKET  "/tmp/host_ads1256.sock"
+#define MSG_MAX_LEN    256
 
 /***********************************************************************
- * PROTOTYPES
+ * LOCAL FUNCTIONS PROTOTYPES
  **/
-int parse_rcv_data_to_file(char *file_name, uint32_t shr_mem_addr, uint32_t num_samples);
-int get_pru_shared_mem_info(uint32_t *p_addr, uint32_t *p_size);
+/* Daemon */
+int  daemon_run(acq_source_t *p_src, int volts);
+int  daemon_capture(acq_source_t *p_src, int client_fd, int listen_fd, uint32_t num_samples, char *file_name,
+                    int volts, char *reply, size_t len);
+int  daemon_configure(acq_source_t *p_src, char **arg, int n, char *reply, size_t len);
 
 /***********************************************************************
  * MAIN
  **/
 int main (int argc, char *argv[])
 {
-  uint32_t shr_mem_addr = 0;
-  uint32_t shr_mem_size = 0;
+  acq_source_t *p_src = NULL;
+  acq_sink_t *p_sink = NULL;
   uint32_t num_samples = 0;
-  
+  int volts = 0;
+  int res = 0;
+  int n = 0;
+
+  /* Client mode: talk to a running daemon, no PRU access needed */
+  if ( argc >= 3 && strcmp(argv[1], "-c") == 0 )
+  {
+    return (acq_client_run(DAEMON_SOCKET, argc - 2, &argv[2]) < 0) ? -1 : 0;
+  }
+
+  p_src = src_pru_ads1256_create();
+  if ( p_src == NULL )
+  {
+    perror("src_pru_ads1256_create()");
+    return -1;
+  }
+
+  /* ADS1256 setup and channel list, for a capture or the daemon */
+  for ( ;; )
+  {
+    n = 0;
+    if ( argc >= 2 && strcmp(argv[1], "-b") == 0 )
+    {
+      acq_set(p_src, "buffer", "1");
+      n = 1;
+    }
+    else if ( argc >= 2 && strcmp(argv[1], "-p") == 0 )
+    {
+      acq_set(p_src, "packed", "1");
+      n = 1;
+    }
+    else if ( argc >= 2 && strcmp(argv[1], "-V") == 0 )
+    {
+      volts = 1;
+      n = 1;
+    }
+    else if ( argc >= 2 && strcmp(argv[1], "-2") == 0 )
+    {
+      acq_set(p_src, "dual", "1");
+      n = 1;
+    }
+    else if ( argc >= 3 && (strcmp(argv[1], "-m") == 0 || strcmp(argv[1], "-M") == 0) )
+    {
+      if ( acq_set(p_src, (argv[1][1] == 'M') ? "channels2" : "channels", argv[2]) < 0 )
+      {
+        printf("Invalid channel list '%s'\n", argv[2]);
+        exit(EXIT_FAILURE);
+      }
+      n = 2;
+    }
+    else if ( argc >= 3 && strcmp(argv[1], "-r") == 0 )
+    {
+      if ( acq_set(p_src, "rate", argv[2]) < 0 )
+      {
+        printf("Invalid data rate '%s'\n", argv[2]);
+        exit(EXIT_FAILURE);
+      }
+      n = 2;
+    }
+    else if ( argc >= 3 && strcmp(argv[1], "-k") == 0 )
+    {
+      if ( acq_set(p_src, "calibration", argv[2]) < 0 )
+      {
+        printf("Invalid calibration '%s'\n", argv[2]);
+        exit(EXIT_FAILURE);
+      }
+      n = 2;
+    }
+    else
+    {
+      break;
+    }
+    argv[n] = argv[0];
+    argv += n;
+    argc -= n;
+  }
+
+  if ( argc >= 2 && argv[1][0] == '-' && strcmp(argv[1], "-d") != 0 )
+  {
+    printf("Usage: %s [OPTIONS] [NUM_SAMPLES [BLOCK_SAMPLES]]\n", argv[0]);
+    printf("       %s [OPTIONS] -d\n", argv[0]);
+    printf("       %s -c <start NUM_SAMPLES [FILE] | config SPS [MUX_LIST [MUX_LIST2]] | stop | status | quit>\n\n", argv[0]);
+    printf("\t-r SPS: Data rate, 2.5 - 30000 (default 30000)\n");
+    printf("\t-b: Analog input buffer on\n");
+    printf("\t-k CAL: Calibration after setup: none, self, offset, gain, sysoffset, sysgain\n");
+    printf("\t-p: Packed samples, 3 bytes: the pool holds 33%% more samples\n");
+    printf("\t-V: Samples saved in volts (VREF %.1f V, PGA applied) instead of codes\n", ADS_VREF);
+    printf("\t-m MUX_LIST: Channels to cycle through, up to %d: P[-N][:GAIN],...\n", ADS_CHAN_MAX);
+    printf("\t    P, N: AIN0 - AIN7 or 'c' (AINCOM, default N), GAIN: 1 - 64 (default 1)\n");
+    printf("\t    e.g. '0,1-2:8' reads AIN0 - AINCOM and AIN1 - AIN2 with PGA 8\n");
+    printf("\t    samples are saved as 'index channel value' (default: AIN0 - AINCOM)\n");
+    printf("\t-2: Dual capture, a second ADS1256 on PRU1 in lockstep (common SYNC, same CLKIN)\n");
+    printf("\t    NUM_SAMPLES per converter, saved interleaved: the second converter's\n");
+    printf("\t    channels are numbered after the first's\n");
+    printf("\t-M MUX_LIST: Channels of the second converter (default: the -m list),\n");
+    printf("\t    as many as the -m list when cycling\n");
+    printf("\t-d: Daemon, keeps the PRU program loaded and waits commands on %s\n", DAEMON_SOCKET);
+    printf("\t-c: Send a command to the daemon\n");
+    printf("\tBLOCK_SAMPLES: samples written to file per PRU event (default %d)\n", DEF_BLOCK_LEN);
+    printf("\t               block times go to data_out_times\n\n");
+    exit(EXIT_FAILURE);
+  }
+
   /* Test user */
   if ( getuid() != 0 )
   {
     printf("You must run this program as root. Exiting.\n");
     exit(EXIT_FAILURE);
   }
-  
-  /* Get shared memory info */
-  if ( get_pru_shared_mem_info(&shr_mem_addr, &shr_mem_size) < 0 )
+
+  /* Load the PRU program, it configures the ADS1256 and waits for commands */
+  if ( acq_open(p_src) < 0 )
   {
+    acq_close(p_src);
     return -1;
   }
-  printf("The DDR External Memory Pool\n");
-  printf("Address: 0x%x\n", shr_mem_addr);
-  printf("Size:    %u bytes (0x%x)\n\n", shr_mem_size);
-  
+
+  /* Daemon mode */
+  if ( argc >= 2 && strcmp(argv[1], "-d") == 0 )
+  {
+    res = daemon_run(p_src, volts);
+    acq_close(p_src);
+    return res;
+  }
+
   /* Parse sample number */
   if ( argc < 2 )
   {
-    printf("User didn't entered the number of samples to collect.\nCollecting 10 samples (default)\n");
-    num_samples = 10;
+    printf("User didn't entered the number of samples to collect.\nCollecting %d samples (default)\n",
+           DEF_NUM_SAMPLES);
+    num_samples = DEF_NUM_SAMPLES;
   }
   else
   {
     num_samples = atoi(argv[1]);
-    if ( num_samples * sizeof(uint32_t) >= shr_mem_size )
-    {
-      num_samples = shr_mem_size / sizeof(uint32_t);
-      printf("Number of samples too large.\nCollecting %u samples (max)\n", num_samples);
-    }
   }
 
-  /* Initialize structure used by prussdrv_pruintc_intc */
-  tpruss_intc_initdata pruss_intc_initdata = PRUSS_INTC_INITDATA;
-
-  /* Data to pass to PRU0 */
-  uint32_t pru0_data[3] = {0, 0, 0};
-  pru0_data[0] = num_samples;
-  pru0_data[1] = shr_mem_addr;
-  pru0_data[2] = shr_mem_size;
-
-  /* Allocate and initialize memory */
-  prussdrv_init();
-  prussdrv_open(PRU_EVTOUT_0);
-
-  /* Write the samples number, address and size into PRU0 Data RAM0 */
-  prussdrv_pru_write_memory(PRUSS0_PRU0_DATARAM, 0, pru0_data, 3 * sizeof(uint32_t));
-
-  /* Map PRU's interrupts */
-  prussdrv_pruintc_init(&pruss_intc_initdata);
-
-  /* Load and execute the PRU program on the PRU */
-  prussdrv_exec_program (PRU_NUM, "./pru_ads1256.bin");
+  /* Single capture, saved block by block while sampling */
+  p_sink = sink_text_create("data_out", "data_out_times", volts);
+  if ( p_sink == NULL )
+  {
+    perror("sink_text_create()");
+    acq_close(p_src);
+    return -1;
+  }
 
-  /* Wait for event completion from PRU, returns the PRU_EVTOUT_0 number */
-  int n = prussdrv_pru_wait_event(PRU_EVTOUT_0);
-  printf("EBB PRU program completed, event number %d.\n", n);
+  res = acq_run(p_src, &p_sink, 1, num_samples, (argc >= 3) ? atoi(argv[2]) : DEF_BLOCK_LEN, NULL);
+  printf("EBB PRU program completed, %d samples.\n", res);
 
-  /* Save received data into a file */
-  parse_rcv_data_to_file("data_out", shr_mem_addr, num_samples);
-  
-  /* Disable PRU and close memory mappings */
-  prussdrv_pru_disable(PRU_NUM);
-  prussdrv_exit();
+  /* Stop PRU program and close memory mappings */
+  acq_close(p_src);
+  acq_sink_destroy(p_sink);
 
   return 0;
 }
@@ -111,113 +196,149 @@ int main (int argc, char *argv[])
  * FUNCTIONS
  **/
 /***********************************************************************
- * @fn      parse_rcv_data_to_file
+ * @fn      daemon_run
  *
- * @brief
+ * @brief   Serve capture commands from a local socket. One command per
+ *          connection, one text line, answered with "ok ..." or "error ...".
  *
- * @param   file_name
- *          shr_mem_addr
- *          num_samples
+ * @param   p_src
+ *          volts - Samples saved in volts
  *
  * @return
  **/
-int parse_rcv_data_to_file(char *file_name, uint32_t shr_mem_addr, uint32_t num_samples)
+int daemon_run(acq_source_t *p_src, int volts)
 {
-  uint32_t sample = 0;
-  off_t offset = shr_mem_addr;
-  void *p_addr_idx = NULL;
-  void *p_map_addr = NULL;
-  int fd = 0;
+  char msg[MSG_MAX_LEN];
+  char reply[MSG_MAX_LEN];
+  char *arg[6];
+  int listen_fd = 0;
+  int client_fd = 0;
+  int quit = 0;
+  int n = 0;
 
-  /* Open mem device */
-  fd = open("/dev/mem", O_RDWR | O_SYNC);
-  if ( fd < 0 )
+  listen_fd = acq_daemon_listen(DAEMON_SOCKET);
+  if ( listen_fd < 0 )
   {
-    perror("open(\"/dev/mem\")");
     return -1;
   }
 
-  p_map_addr = mmap(0, MAP_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, offset & ~MAP_MASK);
-  if( p_map_addr == (void *) - 1 )
+  while ( !quit )
   {
-    perror("mmap()");
-    close(fd);
-    return -1;
-  }
+    client_fd = acq_daemon_accept(listen_fd, msg, sizeof(msg), arg, 6, &n);
+    if ( client_fd < 0 )
+    {
+      continue;
+    }
 
-  /* Open data file */
-  FILE *fp = NULL;
-  fp = fopen(file_name, "wb");
-  if ( fp != NULL )
-  {
-    /* Store data into file */
-    int i = 0;
-    for ( i = 0; i < num_samples; i++ )
+    if ( n >= 2 && strcmp(arg[0], "start") == 0 )
+    {
+      daemon_capture(p_src, client_fd, listen_fd, atoi(arg[1]), (n >= 3) ? arg[2] : "data_out", volts,
+                     reply, sizeof(reply));
+    }
+    else if ( n >= 2 && strcmp(arg[0], "config") == 0 )
+    {
+      daemon_configure(p_src, arg, n, reply, sizeof(reply));
+    }
+    else if ( n >= 1 && (strcmp(arg[0], "stop") == 0 || strcmp(arg[0], "status") == 0) )
+    {
+      snprintf(reply, sizeof(reply), "ok idle\n");
+    }
+    else if ( n >= 1 && strcmp(arg[0], "quit") == 0 )
     {
-      p_addr_idx = p_map_addr + (offset & MAP_MASK);
-      sample = *((uint32_t *)p_addr_idx);
-      fprintf(fp, "%u\t%u\n", i, sample);
-      offset += sizeof(uint32_t);
+      snprintf(reply, sizeof(reply), "ok\n");
+      quit = 1;
     }
-    
-    /* Close file */
-    fclose(fp);
+    else
+    {
+      snprintf(reply, sizeof(reply), "error unknown command\n");
+    }
+
+    acq_daemon_reply(client_fd, reply);
   }
-  else
+
+  acq_daemon_close(listen_fd, DAEMON_SOCKET);
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      daemon_capture
+ *
+ * @brief   Run one capture, saved block by block while sampling. While
+ *          it runs, 'stop' from the requesting client (or its hang up)
+ *          or from a new connection ends it early.
+ *
+ * @param   p_src
+ *          client_fd
+ *          listen_fd
+ *          num_samples
+ *          file_name
+ *          volts
+ *          reply
+ *          len
+ *
+ * @return
+ **/
+int daemon_capture(acq_source_t *p_src, int client_fd, int listen_fd, uint32_t num_samples, char *file_name,
+                   int volts, char *reply, size_t len)
+{
+  acq_sink_t *p_sink = sink_text_create(file_name, NULL, volts);
+  int samples = -1;
+
+  printf("Collecting %u samples...\n", num_samples);
+  if ( p_sink != NULL )
   {
-    perror("fopen(data_file)");
+    samples = acq_daemon_capture(p_src, &p_sink, 1, num_samples, DEF_BLOCK_LEN, listen_fd, client_fd);
+    acq_sink_destroy(p_sink);
   }
 
-  /* Unmap memory */
-  if ( munmap(p_map_addr, MAP_SIZE) == -1 )
+  if ( samples < 0 )
   {
-    perror("munmap()");
-    close(fd);
+    snprintf(reply, len, "error saving %s\n", file_name);
     return -1;
   }
 
-  /* Close descriptor */
-  close(fd);
+  snprintf(reply, len, "ok %s %d %s\n", p_src->stats.stopped ? "stopped" : "done", samples, file_name);
 
   return 0;
 }
 
 /***********************************************************************
- * @fn      get_pru_shared_mem_info
+ * @fn      daemon_configure
  *
- * @brief   Read map1 files and loads size and address of shared mem.
+ * @brief   'config SPS [MUX_LIST [MUX_LIST2]]': new data rate and channel
+ *          lists, applied by the PRU while idle. All of them or none.
  *
- * @param   p_addr
- *          p_size
+ * @param   p_src
+ *          arg
+ *          n
+ *          reply
+ *          len
  *
  * @return
  **/
-int get_pru_shared_mem_info(uint32_t *p_addr, uint32_t *p_size)
+int daemon_configure(acq_source_t *p_src, char **arg, int n, char *reply, size_t len)
 {
-  unsigned int val = 0;
-  FILE *fp = NULL;
+  acq_option_t opt[3] = {{"rate", arg[1]}, {"channels", NULL}, {"channels2", NULL}};
+  uint32_t list[ADS_CHAN_MAX];
+  uint8_t drate = 0;
 
-  /* Read addr file */
-  fp = fopen(MMAP1_ADDR_FILE_DIR, "rt");
-  if ( fscanf(fp, "%x", &val) < 0 )
+  opt[1].value = (n >= 3) ? arg[2] : NULL;
+  opt[2].value = (n >= 4) ? arg[3] : NULL;
+  if ( ads_parse_data_rate(arg[1], &drate) < 0 || (n >= 3 && ads_parse_channels(arg[2], list) < 0) ||
+       (n >= 4 && ads_parse_channels(arg[3], list) < 0) )
   {
-    perror("fscanf(\"/sys/class/uio/uio0/maps/map1/addr)\"");
-    fclose(fp);
+    snprintf(reply, len, "error invalid config\n");
     return -1;
   }
-  fclose(fp);
-  *p_addr = val;
 
-  /* Read size file */
-  fp = fopen(MMAP1_SIZE_FILE_DIR, "rt");
-  if ( fscanf(fp, "%x", &val) < 0 )
+  if ( acq_configure(p_src, opt, (n >= 4) ? 3 : (n >= 3) ? 2 : 1) < 0 )
   {
-    perror("fscanf(/sys/class/uio/uio0/maps/map1/size)");
-    fclose(fp);
+    snprintf(reply, len, "error config failed\n");
     return -1;
   }
-  fclose(fp);
-  *p_size = val;
+
+  snprintf(reply, len, "ok config\n");
 
   return 0;
 }
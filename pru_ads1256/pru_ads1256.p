@@ -7,11 +7,115 @@
 ;   MOSI   :   P9_27    pr1_pru0_pru_r30_5  r30.t5
 ;   MISO   :   P9_28    pr1_pru0_pru_r31_3  r31.t3
 ;   DRDY   :   P9_25    pr1_pru0_pru_r31_7  r31.t7
+;   SYNC   :   P8_12    pr1_pru0_pru_r30_14 r30.t14  (both converters)
+;
+; Built with -DPRU1 (pru_ads1256_pru1.bin) it drives a second converter
+; from PRU1, on the same R30/R31 bits:
+;   CS     :   P8_46    pr1_pru1_pru_r30_1  r30.t1
+;   CLK    :   P8_43    pr1_pru1_pru_r30_2  r30.t2
+;   MOSI   :   P8_42    pr1_pru1_pru_r30_5  r30.t5
+;   MISO   :   P8_44    pr1_pru1_pru_r31_3  r31.t3
+;   DRDY   :   P8_40    pr1_pru1_pru_r31_7  r31.t7
 
 ; Registers:
+;   Read mode/command, channel index/count: r0
+;   Dual capture: r29.b1
 ;   Delay/Counters Registers: r1, r2, r3, r4, r5
+;   Command/RAM Data Address: r10, r11
+;   Block/Ring counters: r12 - r17
+;   Time stamps: r6, r7, r18 - r25
+;   Sample size: r29.b0
+;   SCLK half period loops: r26
 ;   SPI Tx Buf: r27
 ;   SPI Rx Buf: r28
+;
+; The SPI timing comes from the host in PRU cycles, computed from the
+; ADS1256 CLKIN: the SCLK half period (SCLK at CLKIN/4), t6 (RDATA to
+; the first data bit, 50 CLKIN periods), t10 (last SCLK to CS high) and
+; t11 (command to command). The host writes it before loading the
+; program. Bytes go back to back, with no hold between them.
+;
+; The ADS1256 registers come from a versioned block the host fills in
+; Data RAM: STATUS, MUX, ADCON, DRATE and IO, plus an optional
+; calibration command. It is applied at startup and again on a CONFIG
+; command while idle, so the data rate or PGA changes between captures
+; without reloading the program. A block of another version is rejected
+; and the registers are left untouched.
+;
+; The ADS1256 converts continuously on the configured MUX until the host
+; sets a channel list. Each list entry is a {MUX, ADCON} pair
+; (ADCON carries the PGA). The first entry is set at START. With two or
+; more entries the capture cycles through them as the datasheet suggests:
+; at each DRDY the next MUX/ADCON is written, then SYNC and WAKEUP, and
+; then RDATA reads the conversion of the previous channel while the next
+; one settles. Cycling needs RDATA, so it overrides the read mode.
+;
+; Samples are stored as words: the 24-bit two's complement conversion in
+; bits 23 - 0 and the channel index in bits 31 - 24. With packing set they
+; take 3 bytes (little endian, no channel index: the channels follow the
+; list order), so the pool holds a third more samples.
+;
+; The host picks the read mode per capture:
+;   0: each sample is one RDATA after DRDY (command, t6, 24 bits)
+;   1: RDATAC is issued once, with the first sample, and each following
+;      DRDY falling edge just clocks out the 24 bits. CS stays low for
+;      the whole capture and SDATAC is sent at its end (done or STOP),
+;      inside the next data window, so the ADS1256 is left in command
+;      mode.
+;
+; The program stays resident: after the ADS1256 setup it idles polling a
+; command word in PRU Data RAM. Each capture ends with PRU_EVTOUT_0.
+;
+; With a block length set, PRU_EVTOUT_0 is also raised after each block of
+; samples and the block sequence counter is published. With 'Ring blocks'
+; set the pool is used as a ring of that many blocks. A number of samples
+; of 0 runs until a STOP command.
+;
+; With 'Dual' set, the capture runs in lockstep with the other core's
+; converter: PRU1 sets up its capture, flags it ready in PRU shared RAM
+; and waits; PRU0 then pulses the common SYNC line, which restarts both
+; converters on the same CLKIN edge, and releases PRU1. With both
+; converters on one CLKIN, the same data rate and channel list length,
+; their DRDY edges stay aligned for the whole capture. Each core writes
+; its own pool (the host gives them the two halves) and PRU0's block
+; stamps time both. PRU1 raises no events: the host polls it.
+;
+; Each block is stamped with the PRU cycle counter value latched at the
+; DRDY falling edge of its last sample. The counter is restarted at START
+; and extended to 64 bits: it saturates, so once it passes 2^31 it is
+; folded into a 64-bit base and restarted. The stamps go to a ring of 32
+; entries {cycles lo, cycles hi, block seq, status} in Data RAM, written
+; with a single SBBO.
+;
+; PRU Data RAM:
+;   0x00  Number of samples      (host)
+;   0x04  Pool RAM address       (host)
+;   0x08  Pool RAM size          (host)
+;   0x0C  Command                (host writes, PRU clears when accepted)
+;   0x10  Status                 (PRU)
+;   0x14  Samples done           (PRU)
+;   0x18  Block length           (host, samples; 0: no block events)
+;   0x1C  Ring blocks            (host, 0: linear pool)
+;   0x20  Block sequence         (PRU)
+;   0x24  End of capture cycles  (PRU, 64 bits)
+;   0x2C  SCLK half period       (host, PRU cycles)
+;   0x30  t6                     (host, PRU cycles)
+;   0x34  t10                    (host, PRU cycles)
+;   0x38  t11                    (host, PRU cycles)
+;   0x3C  Read mode              (host, 0: RDATA, 1: RDATAC)
+;   0x40  Number of channels     (host, 0: keep the current channel)
+;   0x44  Channel list           (host, 16 x {MUX, ADCON, 0, 0})
+;   0x84  Config block version   (host)
+;   0x88  STATUS, MUX, ADCON, DRATE registers (host)
+;   0x8C  IO register, calibration command (host, 0: none)
+;   0x90  Config status          (PRU, 0: pending, 1: applied, 2: rejected)
+;   0x94  Packed samples         (host, 0: 4 bytes, 1: 3 bytes)
+;   0x98  Dual                   (host, 0: single, 1: lockstep with the other core)
+;   0x100 Block stamps ring      (PRU, 32 x 16 bytes)
+;
+; PRU shared RAM (dual capture, cleared by the host before START):
+;   0x10000 PRU1 ready           (PRU1 sets, PRU0 clears)
+;   0x10004 SYNC pulsed          (PRU0 sets, PRU1 clears)
 
 // --------------------------------------------------------------------
 // Defines
@@ -22,21 +126,154 @@
 #define ADS1256_MOSI    r30.t5
 #define ADS1256_CLK     r30.t2
 #define ADS1256_CS      r30.t1
+#define ADS1256_SYNC    r30.t14   ; PRU0 only
 
 ; Registers
+#define READ_CMD        r0.b0 ; Command sent before each sample (0: none)
+#define READ_MODE       r0.b1
+#define CHAN_CUR        r0.b2 ; Channel of the conversion being read
+#define CHAN_COUNT      r0.b3
+#define PARAM_BASE      r10
+#define CMD_REG         r11
+#define BLOCK_LEN       r12
+#define BLOCK_CNT       r13
+#define BLOCK_SEQ       r14
+#define RING_BLOCKS     r15
+#define RING_CNT        r16
+#define POOL_BASE       r17
+#define DRDY_CYCLES     r6
+#define CTRL_BASE       r18
+#define CYC_BASE_LO     r19
+#define CYC_BASE_HI     r20
+#define STAMP_RING      r21
+#define STAMP_LO        r22   ; Block stamp entry: r22 - r25
+#define STAMP_HI        r23
+#define STAMP_SEQ       r24
+#define STAMP_STATUS    r25
+#define SPI_HALF        r26   ; Delay loops in each SCLK phase
 #define SPI_TX_REG      r27
 #define SPI_RX_REG      r28
-
-; Delays
-#define DELAY_1_US      100
-#define DELAY_250_NS    25
+#define SAMPLE_BYTES    r29.b0 ; r29.w2 is the call register
+#define DUAL_MODE       r29.b1
 
 #define PRU0_R31_VEC_VALID  32  ; allows notification of programs end
 #define PRU_EVTOUT_0        3   ; the event number that is sent back
 
+; PRU Data RAM offsets
+#define PRU_DATA_RAM        0x00000000
+#define PARAM_NUM_SAMPLES   0x00
+#define PARAM_POOL_ADDR     0x04
+#define PARAM_POOL_SIZE     0x08
+#define PARAM_CMD           0x0C
+#define PARAM_STATUS        0x10
+#define PARAM_SAMPLES_DONE  0x14
+#define PARAM_BLOCK_LEN     0x18
+#define PARAM_RING_BLOCKS   0x1C
+#define PARAM_BLOCK_SEQ     0x20
+#define PARAM_END_CYCLES    0x24
+#define PARAM_SCLK_HALF     0x2C
+#define PARAM_T6_CYCLES     0x30
+#define PARAM_T10_CYCLES    0x34
+#define PARAM_T11_CYCLES    0x38
+#define PARAM_READ_MODE     0x3C
+#define PARAM_NUM_CHANNELS  0x40
+#define PARAM_CHAN_LIST     0x44
+#define PARAM_CFG_VERSION   0x84
+#define PARAM_CFG_REGS      0x88
+#define PARAM_CFG_IO_CAL    0x8C
+#define PARAM_CFG_STATUS    0x90
+#define PARAM_PACK          0x94
+#define PARAM_DUAL          0x98
+#define STAMP_RING_ADDR     0x100
+#define STAMP_RING_MASK     31
+
+; PRU shared RAM, dual capture handshake
+#define DUAL_CTRL_ADDR      0x00010000
+#define DUAL_READY          0x00
+#define DUAL_GO             0x04
+
+; Control Registers of this PRU
+#ifdef PRU1
+#define PRU_CTRL_ADDR       0x00024000
+#else
+#define PRU_CTRL_ADDR       0x00022000
+#endif
+#define PRU_CTRL            0x00
+#define PRU_CYCLE           0x0C
+#define CTRL_CTR_EN         3
+
+; Cycle counter bit that triggers the fold into the 64-bit base, and the
+; cycles the counter misses while it is stopped to be restarted
+#ifndef CYCLE_FOLD_BIT
+#define CYCLE_FOLD_BIT      31
+#endif
+#define CYCLE_FOLD_LOST     13
+
+; Host commands
+#define CMD_NONE            0
+#define CMD_START           1
+#define CMD_STOP            2
+#define CMD_EXIT            3
+#define CMD_CONFIG          4
+
+; Configuration block
+#define CFG_VERSION         1
+#define CFG_PENDING         0
+#define CFG_OK              1
+#define CFG_REJECTED        2
+
+; Read modes
+#define READ_SINGLE         0
+#define READ_CONTINUOUS     1
+
+; ADS1256 commands
+#define ADS_RDATA           0x01
+#define ADS_RDATAC          0x03
+#define ADS_WREG_MUX        0x51010000  ; WREG MUX and ADCON
+#define ADS_SYNC            0xFC000000
+#define ADS_WAKEUP          0x00000000
+
+; Status
+#define STATUS_IDLE         0
+#define STATUS_RUNNING      1
+#define STATUS_DONE         2
+#define STATUS_STOPPED      3
+
 // --------------------------------------------------------------------
 // Macros
 // --------------------------------------------------------------------
+; PRU_EVTOUT_0 to the host, which polls PRU1 instead
+.macro NOTIFY_HOST
+#ifndef PRU1
+  MOV   r31.b0, PRU0_R31_VEC_VALID | PRU_EVTOUT_0
+#endif
+.endm
+
+; Channel list entry r2: write its MUX/ADCON, then SYNC and WAKEUP.
+; CS must be low. Ends t11 after WAKEUP, ready for the next command.
+.macro SET_CHANNEL
+  LSL   r1, r2, 2
+  ADD   r1, r1, PARAM_CHAN_LIST
+  LBBO  r1, PARAM_BASE, r1, 4
+  MOV   SPI_TX_REG,    ADS_WREG_MUX
+  MOV   SPI_TX_REG.b1, r1.b0              ; MUX
+  MOV   SPI_TX_REG.b0, r1.b1              ; ADCON
+  CALL  SPI_TRANSFER_BYTE
+  CALL  SPI_TRANSFER_BYTE
+  CALL  SPI_TRANSFER_BYTE
+  CALL  SPI_TRANSFER_BYTE
+  LBBO  r1, PARAM_BASE, PARAM_T11_CYCLES, 4
+  CALL  DELAY_CYCLES
+  MOV   SPI_TX_REG, ADS_SYNC
+  CALL  SPI_TRANSFER_BYTE
+  LBBO  r1, PARAM_BASE, PARAM_T11_CYCLES, 4
+  CALL  DELAY_CYCLES
+  MOV   SPI_TX_REG, ADS_WAKEUP
+  CALL  SPI_TRANSFER_BYTE
+  LBBO  r1, PARAM_BASE, PARAM_T11_CYCLES, 4
+  CALL  DELAY_CYCLES
+.endm
+
 .setcallreg     r29.w2
 .origin         0         ; start of program in PRU memory
 .entrypoint     START     ; program entry point
@@ -50,109 +287,253 @@ START:
 	CLR   r0, r0, 4       ; clear bit 4 (STANDBY_INIT)
 	SBCO  r0, C4, 4, 4    ; store the modified r0 back at the load addr
 
-  MOV   r1, 0x00000000  ; RAM Data Address
-  LBBO  r9, r1, 0, 4    ; r9 is samples number
-  LBBO  r8, r1, 4, 4    ; r8 points to data ram addr
+#ifndef PRU1
+  ; Common SYNC/PDWN line high: both converters out of power down
+  SET   ADS1256_SYNC
+#endif
+
+  MOV   PARAM_BASE, PRU_DATA_RAM  ; RAM Data Address
+  MOV   r1, STATUS_IDLE
+  SBBO  r1, PARAM_BASE, PARAM_STATUS, 4
+
+  ; SCLK phase loops: a phase takes 5 - 7 cycles plus 2 per loop
+  LBBO  SPI_HALF, PARAM_BASE, PARAM_SCLK_HALF, 4
+  SUB   SPI_HALF, SPI_HALF, 4
+  LSR   SPI_HALF, SPI_HALF, 1
+  MAX   SPI_HALF, SPI_HALF, 1
 
 ; ---------------------------------------------------------------------
 ; ADS1256 Initial Configuration
 ; ---------------------------------------------------------------------
-  ; Wait DRDY goes Low
+  ; Wait DRDY goes Low, the ADS1256 may still be in RDATAC
   WBC   ADS1256_DRDY
 
-  ; Send setting data
-  MOV SPI_TX_REG, 0x50030001  ; 0x50 -> Write Reg, address 0x00 
-                              ; 0x03 -> 4 registers to write (N-1)
-                              ; 0x00 -> Status: MSB | ACAL_DIS | BUF_DIS
-                              ; 0x08 -> Mux: Pos: AIN0, Neg: AINCOM
-                              ; 0x00 -> ADCon: CLKOUT_OFF | PGA_GAIN_1
-                              ; 0xF0 -> Rate: 30k SMPS
+  ; Send Stop Read Data Continous command
+SDATAC:
+  MOV   SPI_TX_REG, 0x0F000000
+  CLR   ADS1256_CS          ; Set CS line LOW 
+  CALL  SPI_TRANSFER_BYTE   ; Send byte
 
-  ; Starts SPI transfer
-  CLR   ADS1256_CS  ; Set CS line LOW 
+  ; Wait before finish spi transfer -- Datasheet: t10 (min 8 tclk)
+  LBBO  r1, PARAM_BASE, PARAM_T10_CYCLES, 4
+  CALL  DELAY_CYCLES
+
+  ; Finish SPI transfer
+  SET ADS1256_CS    ; Set CS line HIGH
 
-  ; Transfer the first 4 bytes 0x50030001
+  ; Wait before the next command -- Datasheet: t11
+  LBBO  r1, PARAM_BASE, PARAM_T11_CYCLES, 4
+  CALL  DELAY_CYCLES
+
+; ---------------------------------------------------------------------
+; Configure -- registers from the host block, at startup and on CONFIG
+; ---------------------------------------------------------------------
+CONFIGURE:
+  MOV   r1, CFG_PENDING
+  SBBO  r1, PARAM_BASE, PARAM_CFG_STATUS, 4
+  LBBO  r1, PARAM_BASE, PARAM_CFG_VERSION, 4
+  QBNE  CFG_REJECT, r1, CFG_VERSION
+
+  ; WREG 0x50, 5 registers: STATUS, MUX, ADCON, DRATE, IO
+  LBBO  r2, PARAM_BASE, PARAM_CFG_REGS, 4
+  MOV   SPI_TX_REG.w2, 0x5004
+  MOV   SPI_TX_REG.b1, r2.b0      ; STATUS
+  MOV   SPI_TX_REG.b0, r2.b1      ; MUX
+
+  CLR   ADS1256_CS  ; Set CS line LOW 
   CALL  SPI_TRANSFER_BYTE
   CALL  SPI_TRANSFER_BYTE
   CALL  SPI_TRANSFER_BYTE
   CALL  SPI_TRANSFER_BYTE
 
-  ; Transfer the last 2 bytes 0x00F0
-  MOV SPI_TX_REG, 0x00F00000
+  MOV   SPI_TX_REG.b3, r2.b2      ; ADCON
+  MOV   SPI_TX_REG.b2, r2.b3      ; DRATE
+  LBBO  r2, PARAM_BASE, PARAM_CFG_IO_CAL, 4
+  MOV   SPI_TX_REG.b1, r2.b0      ; IO
+  CALL  SPI_TRANSFER_BYTE
   CALL  SPI_TRANSFER_BYTE
   CALL  SPI_TRANSFER_BYTE
 
-  ; Wait 1us before finish spi transfer -- Datasheet: t10 (min 8 tclk = 1us)
-  MOV   r1, DELAY_1_US
-  CALL  DELAY_REG1
+  ; Wait before finish spi transfer -- Datasheet: t10 (min 8 tclk)
+  LBBO  r1, PARAM_BASE, PARAM_T10_CYCLES, 4
+  CALL  DELAY_CYCLES
+  SET   ADS1256_CS    ; Set CS line HIGH
+  LBBO  r1, PARAM_BASE, PARAM_T11_CYCLES, 4
+  CALL  DELAY_CYCLES
+
+  ; Calibration command, if any: DRDY goes low when it is over
+  QBEQ  CFG_APPLIED, r2.b1, 0
+  MOV   SPI_TX_REG.b3, r2.b1
+  CLR   ADS1256_CS
+  CALL  SPI_TRANSFER_BYTE
+  LBBO  r1, PARAM_BASE, PARAM_T10_CYCLES, 4
+  CALL  DELAY_CYCLES
+  SET   ADS1256_CS
+  LBBO  r1, PARAM_BASE, PARAM_T11_CYCLES, 4
+  CALL  DELAY_CYCLES
+  WBC   ADS1256_DRDY
 
-  ; Finish SPI transfer
-  SET ADS1256_CS    ; Set CS line HIGH
+CFG_APPLIED:
+  MOV   r1, CFG_OK
+  SBBO  r1, PARAM_BASE, PARAM_CFG_STATUS, 4
+  QBA   IDLE
 
-  ; Send Stop Read Data Continous command
-SDATAC:
-  MOV   SPI_TX_REG, 0x0F000000
-  CLR   ADS1256_CS          ; Set CS line LOW 
-  CALL  SPI_TRANSFER_BYTE   ; Send byte
+  ; Unknown block version: the registers are left as they were
+CFG_REJECT:
+  MOV   r1, CFG_REJECTED
+  SBBO  r1, PARAM_BASE, PARAM_CFG_STATUS, 4
 
-  ; Wait 1us before finish spi transfer -- Datasheet: t10 (min 8 tclk = 1us)
-  MOV   r1, DELAY_1_US
-  CALL  DELAY_REG1
-
-  ; Finish SPI transfer
-  SET ADS1256_CS    ; Set CS line HIGH
+; ---------------------------------------------------------------------
+; Idle -- Wait for a host command
+; ---------------------------------------------------------------------
+IDLE:
+  LBBO  CMD_REG, PARAM_BASE, PARAM_CMD, 4 ; Poll command word
+  QBEQ  IDLE,    CMD_REG, CMD_NONE
+  QBEQ  EXIT,    CMD_REG, CMD_EXIT
+
+  ; Accept the command
+  MOV   r1,   CMD_NONE
+  SBBO  r1,   PARAM_BASE, PARAM_CMD, 4
+  QBEQ  CONFIGURE, CMD_REG, CMD_CONFIG
+  QBNE  IDLE, CMD_REG, CMD_START          ; STOP while idle: nothing to do
+
+  MOV   r1,   STATUS_RUNNING
+  SBBO  r1,   PARAM_BASE, PARAM_STATUS, 4
+
+  LBBO  r9, PARAM_BASE, PARAM_NUM_SAMPLES, 4  ; r9 is samples number
+  LBBO  r8, PARAM_BASE, PARAM_POOL_ADDR, 4    ; r8 points to data ram addr
+  LBBO  BLOCK_LEN,   PARAM_BASE, PARAM_BLOCK_LEN, 4
+  LBBO  RING_BLOCKS, PARAM_BASE, PARAM_RING_BLOCKS, 4
+
+  MOV   POOL_BASE, r8
+  MOV   BLOCK_CNT, BLOCK_LEN
+  MOV   BLOCK_SEQ, 0
+  MOV   RING_CNT,  RING_BLOCKS
+  SBBO  BLOCK_SEQ, PARAM_BASE, PARAM_BLOCK_SEQ, 4
+
+  ; Restart the cycle counter (CYCLE is writable only while disabled)
+  MOV   CTRL_BASE, PRU_CTRL_ADDR
+  LBBO  r1, CTRL_BASE, PRU_CTRL, 4
+  CLR   r1, r1, CTRL_CTR_EN
+  SBBO  r1, CTRL_BASE, PRU_CTRL, 4
+  MOV   r2, 0
+  SBBO  r2, CTRL_BASE, PRU_CYCLE, 4
+  SET   r1, r1, CTRL_CTR_EN
+  SBBO  r1, CTRL_BASE, PRU_CTRL, 4
+  MOV   CYC_BASE_LO,  0
+  MOV   CYC_BASE_HI,  0
+  MOV   STAMP_RING,   STAMP_RING_ADDR
+  MOV   STAMP_STATUS, 0
+
+  ; RDATA before each sample, or RDATAC once before the first
+  LBBO  r1, PARAM_BASE, PARAM_READ_MODE, 4
+  MOV   READ_MODE, r1.b0
+  MOV   READ_CMD,  ADS_RDATA
+  QBEQ  READ_SET,  READ_MODE, READ_SINGLE
+  MOV   READ_CMD,  ADS_RDATAC
+READ_SET:
+
+  ; Stored sample size
+  LBBO  r1, PARAM_BASE, PARAM_PACK, 4
+  MOV   SAMPLE_BYTES, 4
+  QBEQ  PACK_SET, r1, 0
+  MOV   SAMPLE_BYTES, 3
+PACK_SET:
+
+  ; Channel list: set its first entry, cycling forces RDATA
+  LBBO  r1, PARAM_BASE, PARAM_NUM_CHANNELS, 4
+  MOV   CHAN_COUNT, r1.b0
+  MOV   CHAN_CUR,   0
+  QBEQ  CHAN_READY, CHAN_COUNT, 0
+  MOV   r2, 0
+  CLR   ADS1256_CS
+  SET_CHANNEL
+  SET   ADS1256_CS
+  QBGT  CHAN_READY, CHAN_COUNT, 2
+  MOV   READ_MODE,  READ_SINGLE
+  MOV   READ_CMD,   ADS_RDATA
+CHAN_READY:
+
+  ; Dual capture: restart both converters together on the SYNC line. A
+  ; host command while waiting for the other core ends the capture.
+  LBBO  r1, PARAM_BASE, PARAM_DUAL, 4
+  MOV   DUAL_MODE, r1.b0
+  QBEQ  DUAL_DONE, DUAL_MODE, 0
+  MOV   r4, DUAL_CTRL_ADDR
+#ifdef PRU1
+  MOV   r1, 1
+  SBBO  r1, r4, DUAL_READY, 4
+DUAL_WAIT:
+  LBBO  CMD_REG,    PARAM_BASE, PARAM_CMD, 4
+  QBNE  DUAL_ABORT, CMD_REG, CMD_NONE
+  LBBO  r1, r4, DUAL_GO, 4
+  QBEQ  DUAL_WAIT, r1, 0
+  MOV   r1, 0
+  SBBO  r1, r4, DUAL_GO, 4
+#else
+DUAL_WAIT:
+  LBBO  CMD_REG,    PARAM_BASE, PARAM_CMD, 4
+  QBNE  DUAL_ABORT, CMD_REG, CMD_NONE
+  LBBO  r1, r4, DUAL_READY, 4
+  QBEQ  DUAL_WAIT, r1, 0
+  MOV   r1, 0
+  SBBO  r1, r4, DUAL_READY, 4
+
+  ; SYNC low for t10 (the datasheet asks for 4 tclk), WAKEUP on the rise
+  CLR   ADS1256_SYNC
+  LBBO  r1, PARAM_BASE, PARAM_T10_CYCLES, 4
+  CALL  DELAY_CYCLES
+  SET   ADS1256_SYNC
+  MOV   r1, 1
+  SBBO  r1, r4, DUAL_GO, 4
+#endif
+  QBA   DUAL_DONE
+
+DUAL_ABORT:
+  MOV   r3, 0
+  MOV   r2, STATUS_STOPPED
+  MOV   READ_MODE, READ_SINGLE  ; RDATAC not sent yet
+  QBA   CAPTURE_END
+DUAL_DONE:
 
 ; ---------------------------------------------------------------------
 ; ADS1256 Read Channel 0 -- 'r9' samples
 ; ---------------------------------------------------------------------
-  MOV   r3, r9  ; number of samples
+  MOV   r3, 0   ; samples done
 LOOP_SAMPLE:
   ; Wait DRDY goes Low
   WBC   ADS1256_DRDY
+  LBBO  DRDY_CYCLES, CTRL_BASE, PRU_CYCLE, 4  ; Conversion time
 
-  ; Set channel
-SET_CHANNEL:
-  MOV   SPI_TX_REG, 0x51000800
-  CLR   ADS1256_CS          ; Set CS line LOW 
-  CALL  SPI_TRANSFER_BYTE   ; Send 1st byte
-  CALL  SPI_TRANSFER_BYTE   ; Send 2nd byte
-  CALL  SPI_TRANSFER_BYTE   ; Send 3rd byte
-  SET   ADS1256_CS          ; Set CS line LOW, finish SPI transfer
-
-  ; Send Sync Command
-SYNC_CMD:
-  MOV   SPI_TX_REG, 0xFC000000
-  CLR   ADS1256_CS          ; Set CS line LOW 
-  CALL  SPI_TRANSFER_BYTE   ; Send byte
-  SET   ADS1256_CS          ; Set CS line LOW, finish SPI transfer
+  ; Cycling: start the next channel before reading this one
+  QBGT  CHAN_NEXT_DONE, CHAN_COUNT, 2
+  ADD   r2, CHAN_CUR, 1
+  QBLT  CHAN_NEXT_SET,  CHAN_COUNT, r2
+  MOV   r2, 0
+CHAN_NEXT_SET:
+  CLR   ADS1256_CS
+  SET_CHANNEL
+CHAN_NEXT_DONE:
 
-  ; Send Wake Up Command
-WAKE_CMD:
-  MOV   SPI_TX_REG, 0x00000000
-  CLR   ADS1256_CS          ; Set CS line LOW 
-  CALL  SPI_TRANSFER_BYTE   ; Send byte
-  SET   ADS1256_CS          ; Set CS line HIGH, finish SPI transfer
-
-  ; Wait 25 ns before next cmd (dummy instructions) - 
-  ADD r1, r1, 1
-  ADD r1, r1, 1
-  ADD r1, r1, 1
-  ADD r1, r1, 1
-  ADD r1, r1, 1
+  ; RDATAC running: the data comes out with the first SCLK
+  QBEQ  READ_DATA, READ_CMD, 0
 
   ; Read data command
-READ_CMD:
-  MOV   SPI_TX_REG, 0x01000000
+SEND_READ_CMD:
+  LSL   SPI_TX_REG, READ_CMD, 24
   CLR   ADS1256_CS          ; Set CS line LOW 
   CALL  SPI_TRANSFER_BYTE   ; Send byte
 
-  ; Wait 30us before receive data
-  MOV   r1, 30*DELAY_1_US
+  ; Wait before receive data -- Datasheet: t6 (min 50 tclk)
 DATA_WAIT:
-  SUB   r1,        r1, 1
-  QBNE  DATA_WAIT, r1, 0
-
-  ; Data stored in SPI_RX_REG
+  LBBO  r1, PARAM_BASE, PARAM_T6_CYCLES, 4
+  CALL  DELAY_CYCLES
+  QBEQ  READ_DATA, READ_CMD, ADS_RDATA
+  MOV   READ_CMD,  0        ; RDATAC sent, no more commands
+
+  ; Data stored in SPI_RX_REG, DIN held low
+READ_DATA:
+  MOV   SPI_TX_REG, 0
   MOV   SPI_RX_REG, 0x00000000
 
   MOV   r2, 3
@@ -161,84 +542,166 @@ GET_SAMPLE:
   SUB   r2,         r2, 1
   QBNE  GET_SAMPLE, r2, 0
 
+  ; RDATAC keeps CS low between samples
+  QBEQ  STORE_DATA, READ_CMD, 0
+
+  ; Wait before finish spi transfer -- Datasheet: t10 (min 8 tclk)
+  LBBO  r1, PARAM_BASE, PARAM_T10_CYCLES, 4
+  CALL  DELAY_CYCLES
   SET   ADS1256_CS          ; Set CS line HIGH, finish SPI transfer
 
   ; Store data in RAM
 STORE_DATA:
-  LSR	  SPI_RX_REG, SPI_RX_REG, 1
-  MOV   r1, 0x00FFFFFF
-  AND	  SPI_RX_REG, SPI_RX_REG, r1
+  QBEQ  STORE_PACKED, SAMPLE_BYTES, 3
+  MOV   SPI_RX_REG.b3, CHAN_CUR   ; Channel tag
 	SBBO	SPI_RX_REG, r8, 0, 4
-	ADD	  r8,         r8, 4
+  QBA   STORE_NEXT
+STORE_PACKED:
+  SBBO  SPI_RX_REG, r8, 0, 3
+STORE_NEXT:
+	ADD	  r8,         r8, SAMPLE_BYTES
+
+  ; Channel of the next conversion
+  ADD   CHAN_CUR, CHAN_CUR, 1
+  QBLT  CHAN_NEXT_READ, CHAN_COUNT, CHAN_CUR
+  MOV   CHAN_CUR, 0
+CHAN_NEXT_READ:
 
   WBS   ADS1256_DRDY
   
-  SUB   r3,          r3, 1
-  QBNE  LOOP_SAMPLE, r3, 0
-
-END:
-	MOV	r31.b0, PRU0_R31_VEC_VALID | PRU_EVTOUT_0
+  ADD   r3, r3, 1
+
+  ; Block completed: publish its sequence number and notify host
+  QBEQ  BLOCK_END, BLOCK_LEN, 0
+  SUB   BLOCK_CNT, BLOCK_CNT, 1
+  QBNE  BLOCK_END, BLOCK_CNT, 0
+  MOV   BLOCK_CNT, BLOCK_LEN
+
+  ; Block stamp: 64-bit cycles, one store into the stamps ring
+  ADD   STAMP_LO,  CYC_BASE_LO, DRDY_CYCLES
+  ADC   STAMP_HI,  CYC_BASE_HI, 0
+  MOV   STAMP_SEQ, BLOCK_SEQ
+  AND   r1, BLOCK_SEQ, STAMP_RING_MASK
+  LSL   r1, r1, 4
+  ADD   r1, r1, STAMP_RING
+  SBBO  STAMP_LO,  r1, 0, 16
+
+  ADD   BLOCK_SEQ, BLOCK_SEQ, 1
+  SBBO  BLOCK_SEQ, PARAM_BASE, PARAM_BLOCK_SEQ, 4
+  NOTIFY_HOST
+
+  ; Fold the counter into the 64-bit base before it saturates
+  QBBC  RING_WRAP, DRDY_CYCLES, CYCLE_FOLD_BIT
+  LBBO  r7, CTRL_BASE, PRU_CTRL, 4
+  CLR   r7, r7, CTRL_CTR_EN
+  SBBO  r7, CTRL_BASE, PRU_CTRL, 4          ; Counter stopped
+  LBBO  r1, CTRL_BASE, PRU_CYCLE, 4
+  ADD   r1, r1, CYCLE_FOLD_LOST
+  ADD   CYC_BASE_LO, CYC_BASE_LO, r1
+  ADC   CYC_BASE_HI, CYC_BASE_HI, 0
+  MOV   r1, 0
+  SBBO  r1, CTRL_BASE, PRU_CYCLE, 4
+  SET   r7, r7, CTRL_CTR_EN
+  SBBO  r7, CTRL_BASE, PRU_CTRL, 4          ; Counter running
+
+RING_WRAP:
+
+  ; Pool used as a ring of blocks
+  QBEQ  BLOCK_END, RING_BLOCKS, 0
+  SUB   RING_CNT,  RING_CNT, 1
+  QBNE  BLOCK_END, RING_CNT, 0
+  MOV   RING_CNT,  RING_BLOCKS
+  MOV   r8,        POOL_BASE
+BLOCK_END:
+
+  QBEQ  CAPTURE_DONE, r3, r9
+
+  ; Any host command (STOP/EXIT) ends the capture early
+  LBBO  CMD_REG,     PARAM_BASE, PARAM_CMD, 4
+  QBEQ  LOOP_SAMPLE, CMD_REG, CMD_NONE
+  MOV   r2, STATUS_STOPPED
+  QBA   CAPTURE_END
+
+CAPTURE_DONE:
+  MOV   r2, STATUS_DONE
+
+CAPTURE_END:
+  ; Publish samples done, end stamp and status, then notify host
+  LBBO  r1, CTRL_BASE, PRU_CYCLE, 4
+  ADD   STAMP_LO, CYC_BASE_LO, r1
+  ADC   STAMP_HI, CYC_BASE_HI, 0
+  SBBO  STAMP_LO, PARAM_BASE, PARAM_END_CYCLES, 8
+
+  ; Leave RDATAC: SDATAC once DRDY goes low, then t10 and t11
+  QBEQ  CAPTURE_NOTIFY, READ_MODE, READ_SINGLE
+  WBC   ADS1256_DRDY
+  MOV   SPI_TX_REG, 0x0F000000  ; SDATAC
+  CALL  SPI_TRANSFER_BYTE
+  LBBO  r1, PARAM_BASE, PARAM_T10_CYCLES, 4
+  CALL  DELAY_CYCLES
+  SET   ADS1256_CS
+  LBBO  r1, PARAM_BASE, PARAM_T11_CYCLES, 4
+  CALL  DELAY_CYCLES
+
+CAPTURE_NOTIFY:
+  SBBO  r3, PARAM_BASE, PARAM_SAMPLES_DONE, 4
+  SBBO  r2, PARAM_BASE, PARAM_STATUS, 4
+  NOTIFY_HOST
+  QBA   IDLE
+
+EXIT:
+  MOV   r1, CMD_NONE
+  SBBO  r1, PARAM_BASE, PARAM_CMD, 4
+  NOTIFY_HOST
 	HALT
 
 // --------------------------------------------------------------------
 // Procedures
 // -------------------------------------------------------------------- 
 ; ---------------------------------------------------------------------
-; SPI_TRANSFER_BYTE
+; SPI_TRANSFER_BYTE -- CLK starts and ends LOW. High phase: 5 - 6 cycles,
+; low phase: 6 - 7 cycles (CALL/RET add 2 around the byte), each plus
+; 2 * SPI_HALF.
 ; ---------------------------------------------------------------------
 SPI_TRANSFER_BYTE:
-
-  ; Ensure CLK begins LOW
-  CLR ADS1256_CLK
-
-  ; Wait 1us before shift bits
-  MOV   r5, DELAY_1_US
-HOLD_CS:
-  SUB   r5,      r5,  1
-  QBNE  HOLD_CS, r5,  0
-
   ; Execute 8 times (8 bits)
   MOV   r5, 8
 TX_BYTE:
   SET     ADS1256_CLK               ; Starts with CLK High
-  QBBC    MOSI_LOW, SPI_TX_REG.t31  ; Branch to MOSI_LOW if MSB bit is Clear
-MOSI_HIGH:
-  SET     ADS1256_MOSI      ; Set MOSI line High
-  QBA     CLK_HOLD          ; Branch to CLK_HOLD
-MOSI_LOW:
-  CLR     ADS1256_MOSI      ; Set MOSI line Low
-; Wait 250 ns with CLK High
+  CLR     ADS1256_MOSI              ; MOSI follows the MSB
+  QBBC    CLK_HOLD, SPI_TX_REG.t31  ;
+  SET     ADS1256_MOSI              ;
 CLK_HOLD:
-  MOV     r4, DELAY_250_NS
+  LSL     SPI_TX_REG, SPI_TX_REG, 1 ; Next bit
+  MOV     r4, SPI_HALF
 CLK_HIGH:
   SUB     r4,       r4, 1
   QBNE    CLK_HIGH, r4, 0
   CLR     ADS1256_CLK
 
   ; Read bit MISO
-  QBBC    MISO_LOW,   ADS1256_MISO            ; Branch if MISO bit is 0
-  OR      SPI_RX_REG, SPI_RX_REG, 0x00000001  ; If bit = 1, put in reg LSB 
-MISO_LOW:
-  LSL     SPI_RX_REG, SPI_RX_REG, 1 ; Left shift received bit
-
-; Wait 250 ns with CLK Low
-  MOV     r4, DELAY_250_NS
+  LSL     SPI_RX_REG, SPI_RX_REG, 1               ; Room for the bit
+  QBBC    CLK_LOW_HOLD, ADS1256_MISO              ; Branch if MISO bit is 0
+  OR      SPI_RX_REG, SPI_RX_REG, 0x00000001      ; If bit = 1, put in reg LSB
+CLK_LOW_HOLD:
+  MOV     r4, SPI_HALF
 CLK_LOW:
   SUB     r4,       r4, 1
   QBNE    CLK_LOW,  r4, 0
 
-  ; Left shift in SPI_TX_REG
-  LSL	    SPI_TX_REG, SPI_TX_REG, 1
   SUB     r5,       r5, 1   ; Decrement Bit counter
   QBNE    TX_BYTE,  r5, 0   ; Repeat until the 8 bits transf finish
   RET
 
 ; ---------------------------------------------------------------------
-; DELAY_REG1
+; DELAY_CYCLES -- r1: PRU cycles, 2 per loop
 ; ---------------------------------------------------------------------
-DELAY_REG1:
+DELAY_CYCLES:
+  LSR     r1,      r1, 1
+  QBEQ    D_END,   r1, 0
 D_LABEL:
   SUB     r1,      r1, 1
   QBNE    D_LABEL, r1, 0
+D_END:
   RET
 
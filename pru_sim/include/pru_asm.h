@@ -0,0 +1,89 @@
+#ifndef _PRU_ASM_H
+#define _PRU_ASM_H
+/***********************************************************************
+ * INCLUDES
+ **/
+#include <stdint.h>
+
+/***********************************************************************
+ * DEFINES
+ **/
+#define ASM_MAX_INSN      8192  /* PRU IRAM: 8 KB = 2048 instructions */
+#define ASM_MAX_LABELS    2048
+#define ASM_MAX_DEFINES   1024
+#define ASM_MAX_NAME      64
+#define ASM_MAX_LINE      512
+
+/* Operand kinds */
+#define OPND_NONE         0
+#define OPND_REG          1     /* Register field: r1, r1.w1, r1.b2 */
+#define OPND_BIT          2     /* Register bit: r1.t3 */
+#define OPND_IMM          3     /* Immediate value */
+#define OPND_LABEL        4     /* Resolved code address */
+#define OPND_CONST        5     /* Constant table entry: C0..C31 */
+
+/***********************************************************************
+ * TYPEDEFS
+ **/
+typedef enum asm_op_t
+{
+  OP_ADD, OP_ADC, OP_SUB, OP_SUC, OP_RSB, OP_RSC,
+  OP_LSL, OP_LSR, OP_AND, OP_OR,  OP_XOR, OP_NOT,
+  OP_MIN, OP_MAX, OP_CLR, OP_SET, OP_LMBD,
+  OP_MOV, OP_LDI, OP_ZERO, OP_FILL,
+  OP_LBBO, OP_SBBO, OP_LBCO, OP_SBCO,
+  OP_XIN,  OP_XOUT, OP_XCHG,
+  OP_QBA,  OP_QBGT, OP_QBGE, OP_QBLT, OP_QBLE, OP_QBEQ, OP_QBNE,
+  OP_QBBS, OP_QBBC, OP_WBS,  OP_WBC,
+  OP_JMP,  OP_JAL,  OP_CALL, OP_RET,
+  OP_HALT, OP_SLP,  OP_NOP,
+  OP_COUNT
+} asm_op_t;
+
+typedef struct asm_operand_t
+{
+  uint8_t  kind;
+  uint8_t  reg;       /* Register number (OPND_REG/OPND_BIT) */
+  uint8_t  shift;     /* Field bit offset inside the register */
+  uint8_t  width;     /* Field width in bits (OPND_REG) or bit index (OPND_BIT) */
+  uint8_t  indirect;  /* '&' prefix */
+  uint32_t value;     /* Immediate, label address or constant index */
+} asm_operand_t;
+
+typedef struct asm_insn_t
+{
+  asm_op_t      op;
+  uint8_t       num_opnds;
+  asm_operand_t opnd[4];
+  uint16_t      line;
+  uint16_t      file;
+} asm_insn_t;
+
+typedef struct asm_label_t
+{
+  char     name[ASM_MAX_NAME];
+  uint32_t addr;
+} asm_label_t;
+
+typedef struct asm_program_t
+{
+  asm_insn_t   insn[ASM_MAX_INSN];
+  uint32_t     num_insn;
+  asm_label_t  label[ASM_MAX_LABELS];
+  uint32_t     num_labels;
+  uint32_t     entry;
+  asm_operand_t callreg;
+  char         file_name[16][256];
+  uint32_t     num_files;
+} asm_program_t;
+
+/***********************************************************************
+ * FUNCTIONS
+ **/
+void asm_add_define(const char *name, const char *value);
+int  asm_load(asm_program_t *p_prog, const char *file_name);
+int  asm_find_label(const asm_program_t *p_prog, const char *name, uint32_t *p_addr);
+const char *asm_label_at(const asm_program_t *p_prog, uint32_t addr);
+const char *asm_op_name(asm_op_t op);
+
+#endif
@@ -0,0 +1,164 @@
+#ifndef _PRU_SIM_H
+#define _PRU_SIM_H
+/***********************************************************************
+ * INCLUDES
+ **/
+#include <stdio.h>
+#include <stdint.h>
+#include "pru_asm.h"
+
+/***********************************************************************
+ * DEFINES
+ **/
+#define PRU_CLOCK_HZ        200000000   /* 5 ns per cycle */
+#define PRU_NUM_CORES       2
+#define PRU_MAX_PERIPHS     8
+#define PRU_MAX_EVENTS      65536
+
+/* PRU-ICSS local address map (seen from PRU0; PRU1 swaps the data RAMs) */
+#define PRU_DRAM0_ADDR      0x00000000
+#define PRU_DRAM1_ADDR      0x00002000
+#define PRU_DRAM_SIZE       0x2000
+#define PRU_SHRAM_ADDR      0x00010000
+#define PRU_SHRAM_SIZE      0x3000
+#define PRU_INTC_ADDR       0x00020000
+#define PRU_CTRL0_ADDR      0x00022000
+#define PRU_CTRL1_ADDR      0x00024000
+#define PRU_CFG_ADDR        0x00026000
+#define PRU_IEP_ADDR        0x0002E000
+#define PRU_LOCAL_END       0x00080000
+
+/* PRU CTRL registers */
+#define PRU_CTRL_CTRL       0x00
+#define PRU_CTRL_CYCLE      0x0C
+#define PRU_CTRL_STALL      0x10
+#define PRU_CTRL_CTBIR0     0x20
+#define PRU_CTRL_CTBIR1     0x24
+#define PRU_CTRL_CTPPR0     0x28
+#define PRU_CTRL_CTPPR1     0x2C
+#define PRU_CTRL_CNT_EN     (1 << 3)
+
+/* Memory access latency model (PRU cycles) */
+#define LAT_LOCAL_READ      3
+#define LAT_LOCAL_WRITE     1
+#define LAT_L4_READ         40
+#define LAT_L4_WRITE        8
+#define LAT_DDR_READ        60
+#define LAT_DDR_WRITE       4
+
+/* Input signal shapes */
+#define SIG_RAMP            0   /* Sample index (checks data continuity) */
+#define SIG_SINE            1   /* sine:FREQ_HZ[:AMP[:OFFSET]] */
+#define SIG_CONST           2   /* const:LEVEL */
+#define SIG_PULSE           3   /* pulse:PERIOD_S:WIDTH_S[:LOW:HIGH] */
+#define SIG_NOISE           4   /* noise[:AMP] */
+
+/***********************************************************************
+ * TYPEDEFS
+ **/
+struct pru_sim_t;
+
+typedef struct sim_signal_t
+{
+  int    type;
+  double freq;      /* Hz (sine), 1/period (pulse) */
+  double amp;       /* Fraction of full scale */
+  double offset;    /* Fraction of full scale */
+  double width;     /* Pulse width, seconds */
+  double high;      /* Pulse high level */
+} sim_signal_t;
+
+typedef struct pru_periph_t
+{
+  const char *name;
+  uint32_t    base;       /* Global MMIO/memory window (size 0: pins only) */
+  uint32_t    size;
+  uint32_t    read_lat;
+  uint32_t    write_lat;
+  int         core;       /* PRU core owning the pins */
+  void       *ctx;
+
+  void     (*advance)(struct pru_periph_t *p_dev, uint64_t now);
+  int      (*read)(struct pru_periph_t *p_dev, uint32_t off, uint8_t *buf, uint32_t len, uint64_t now);
+  int      (*write)(struct pru_periph_t *p_dev, uint32_t off, const uint8_t *buf, uint32_t len, uint64_t now);
+  void     (*pins_out)(struct pru_periph_t *p_dev, uint32_t r30, uint64_t now);
+  uint32_t (*pins_in)(struct pru_periph_t *p_dev, uint64_t now);
+  void     (*pins_watch)(struct pru_periph_t *p_dev, int core, uint32_t r30, uint64_t now);  /* R30 of the other core */
+  void     (*report)(struct pru_periph_t *p_dev, FILE *fp, uint64_t now);
+  int      (*check)(struct pru_periph_t *p_dev, FILE *fp, double min_rate);    /* -x: failures */
+} pru_periph_t;
+
+typedef struct pru_core_t
+{
+  asm_program_t *p_prog;
+  uint8_t   reg[128];           /* r0..r31, little endian bytes */
+  uint32_t  pc;
+  int       enabled;
+  int       halted;
+  int       carry;
+  uint64_t  ready_at;           /* Cycle the next instruction issues */
+  uint64_t  insn_count;
+  uint64_t  stall_cycles;       /* WBS/WBC and memory wait cycles */
+  uint64_t  idle_cycles;        /* Cycles spent in idle labels */
+  uint32_t  ctrl;
+  uint32_t  cycle_base;         /* CYCLE register at cycle_start */
+  uint64_t  cycle_start;
+  uint32_t  ctbir[2];
+  uint32_t  ctppr[2];
+  uint32_t  idle_addr[16];
+  int       num_idle;
+  uint32_t  r30_last;
+  uint64_t *p_pc_hist;          /* Cycles per instruction address (optional) */
+} pru_core_t;
+
+typedef struct pru_event_t
+{
+  uint64_t cycle;
+  int      core;
+  uint8_t  event;
+} pru_event_t;
+
+typedef struct pru_sim_t
+{
+  uint64_t      now;
+  pru_core_t    core[PRU_NUM_CORES];
+  uint8_t       dram[2][PRU_DRAM_SIZE];
+  uint8_t       shram[PRU_SHRAM_SIZE];
+  uint8_t       scratch[3][120];   /* XFER banks 10..12 (r0..r29) */
+  pru_periph_t *p_periph[PRU_MAX_PERIPHS];
+  int           num_periphs;
+  pru_event_t   event[PRU_MAX_EVENTS];
+  uint32_t      num_events;
+  uint64_t      iep_start;
+  uint32_t      iep_base;
+  int           iep_enabled;
+  int           trace;
+  int           error;
+} pru_sim_t;
+
+/***********************************************************************
+ * FUNCTIONS
+ **/
+/* Core */
+void     pru_sim_init(pru_sim_t *p_sim);
+void     pru_sim_attach(pru_sim_t *p_sim, pru_periph_t *p_dev);
+void     pru_sim_start(pru_sim_t *p_sim, int core, asm_program_t *p_prog);
+int      pru_sim_run(pru_sim_t *p_sim, uint64_t until);
+uint32_t pru_sim_read32(pru_sim_t *p_sim, int core, uint32_t addr);
+void     pru_sim_write32(pru_sim_t *p_sim, int core, uint32_t addr, uint32_t val);
+
+/* Input signals */
+int     signal_parse(sim_signal_t *p_sig, const char *spec);
+int32_t signal_code(const sim_signal_t *p_sig, double t, uint64_t index, int channel, int bits, int is_signed);
+
+/* Peripheral models */
+pru_periph_t *periph_ddr_create(uint32_t base, uint32_t size);
+int           periph_ddr_dump(pru_periph_t *p_dev, const char *file_name, uint32_t len);
+
+pru_periph_t *periph_tsc_adc_create(const char *signal);
+
+pru_periph_t *periph_ads1256_create(int core, double clkin_hz, const char *signal);
+void          periph_ads1256_pins(pru_periph_t *p_dev, int cs, int sclk, int din, int dout, int drdy, int sync);
+void          periph_ads1256_sync(pru_periph_t *p_dev, int core, int sync);
+
+#endif
@@ -0,0 +1,562 @@
+/***********************************************************************
+ * INCLUDES
+ **/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include "pru_sim.h"
+
+/***********************************************************************
+ * DEFINES
+ **/
+#define DEF_POOL_ADDR     0x9C940000
+#define DEF_POOL_SIZE     0x1E8480    /* config_pru_pool_ram.sh */
+#define DEF_CLKIN_HZ      7680000.0
+#define DEF_TIME_S        1.0
+#define MAX_POKES         64
+#define MAX_IDLE          16
+#define SLICE_CYCLES      1000
+
+/***********************************************************************
+ * TYPEDEFS
+ **/
+typedef struct poke_t
+{
+  int      core;
+  uint32_t addr;
+  uint32_t val;
+  uint64_t cycle;     /* Apply at this cycle ... */
+  uint32_t event;     /* ... or after this many host events (if != 0) */
+  int      done;
+} poke_t;
+
+/***********************************************************************
+ * GLOBALS
+ **/
+static pru_sim_t     SIM;
+static asm_program_t PROG[PRU_NUM_CORES];
+
+/***********************************************************************
+ * PROTOTYPES
+ **/
+void usage(const char *name);
+void add_define(const char *arg);
+int  parse_poke(const char *s, poke_t *p_poke);
+void apply_pokes(poke_t *p_poke, int num);
+void print_report(FILE *fp, pru_periph_t **p_dev, int num_dev, int profile);
+
+/***********************************************************************
+ * MAIN
+ **/
+int main(int argc, char *argv[])
+{
+  const char *pru1_file = NULL;
+  const char *pru1_define[MAX_POKES];
+  int         num_pru1_defines = 0;
+  int         sync_core = 0;
+  int         sync_bit  = -1;
+  const char *dump_file = NULL;
+  const char *idle_label[PRU_NUM_CORES][MAX_IDLE];
+  int         num_idle[PRU_NUM_CORES] = {0, 0};
+  poke_t      poke[MAX_POKES];
+  int         num_pokes = 0;
+  uint32_t    pool_addr = DEF_POOL_ADDR;
+  uint32_t    pool_size = DEF_POOL_SIZE;
+  uint32_t    dump_len  = 0;
+  uint32_t    max_events = 0;
+  const char *watch[MAX_POKES];
+  int         num_watch = 0;
+  double      clkin = DEF_CLKIN_HZ;
+  double      sim_time = DEF_TIME_S;
+  double      min_rate = -1;
+  int         failures = 0;
+  int         profile = 0;
+  pru_periph_t *p_dev[PRU_MAX_PERIPHS];
+  int         num_dev = 0;
+  uint64_t    until = 0;
+  int         opt = 0;
+  int         res = 0;
+  int         c = 0;
+
+  while ( (opt = getopt(argc, argv, "D:1:a:s:S:y:k:p:m:w:t:e:i:o:n:x:rvh")) != -1 )
+  {
+    switch ( opt )
+    {
+      case 'D':
+        /* 1:NAME - PRU1 program only */
+        if ( optarg[0] == '1' && optarg[1] == ':' )
+        {
+          if ( num_pru1_defines < MAX_POKES )
+          {
+            pru1_define[num_pru1_defines++] = optarg + 2;
+          }
+        }
+        else
+        {
+          add_define(optarg);
+        }
+        break;
+
+      case '1':
+        pru1_file = optarg;
+        break;
+
+      case 'a':
+        p_dev[num_dev] = periph_tsc_adc_create(optarg);
+        if ( p_dev[num_dev] == NULL )
+        {
+          exit(EXIT_FAILURE);
+        }
+        num_dev++;
+        break;
+
+      case 's':
+      case 'S':
+        /* -s: ADS1256 on PRU0 pins, -S: on PRU1 pins */
+        p_dev[num_dev] = periph_ads1256_create(opt == 's' ? 0 : 1, clkin, optarg);
+        if ( p_dev[num_dev] == NULL )
+        {
+          exit(EXIT_FAILURE);
+        }
+        num_dev++;
+        break;
+
+      case 'y':
+        sync_core = (optarg[0] == '1' && optarg[1] == ':') ? 1 : 0;
+        sync_bit  = atoi((optarg[1] == ':') ? optarg + 2 : optarg);
+        break;
+
+      case 'k':
+        clkin = atof(optarg);
+        break;
+
+      case 'p':
+        if ( sscanf(optarg, "%x:%x", &pool_addr, &pool_size) != 2 )
+        {
+          usage(argv[0]);
+        }
+        break;
+
+      case 'm':
+        if ( num_pokes >= MAX_POKES || parse_poke(optarg, &poke[num_pokes]) < 0 )
+        {
+          usage(argv[0]);
+        }
+        num_pokes++;
+        break;
+
+      case 'w':
+        if ( num_watch < MAX_POKES )
+        {
+          watch[num_watch++] = optarg;
+        }
+        break;
+
+      case 't':
+        sim_time = atof(optarg);
+        break;
+
+      case 'e':
+        max_events = (uint32_t)atoi(optarg);
+        break;
+
+      case 'i':
+        c = (optarg[0] == '1' && optarg[1] == ':') ? 1 : 0;
+        if ( num_idle[c] < MAX_IDLE )
+        {
+          idle_label[c][num_idle[c]++] = (optarg[1] == ':') ? optarg + 2 : optarg;
+        }
+        break;
+
+      case 'o':
+        dump_file = optarg;
+        break;
+
+      case 'n':
+        dump_len = (uint32_t)strtoul(optarg, NULL, 0);
+        break;
+
+      case 'x':
+        min_rate = atof(optarg);
+        break;
+
+      case 'r':
+        profile = 1;
+        break;
+
+      case 'v':
+        SIM.trace = 1;
+        break;
+
+      default:
+        usage(argv[0]);
+        break;
+    }
+  }
+
+  if ( optind != argc - 1 )
+  {
+    usage(argv[0]);
+  }
+
+  /* Assemble */
+  if ( asm_load(&PROG[0], argv[optind]) < 0 )
+  {
+    exit(EXIT_FAILURE);
+  }
+  for ( c = 0; c < num_pru1_defines; c++ )
+  {
+    add_define(pru1_define[c]);
+  }
+  if ( pru1_file != NULL && asm_load(&PROG[1], pru1_file) < 0 )
+  {
+    exit(EXIT_FAILURE);
+  }
+
+  /* Common SYNC/PDWN line of all converters */
+  for ( c = 0; c < num_dev && sync_bit >= 0; c++ )
+  {
+    if ( strcmp(p_dev[c]->name, "ads1256") == 0 )
+    {
+      periph_ads1256_sync(p_dev[c], sync_core, sync_bit);
+    }
+  }
+
+  /* Build the system */
+  {
+    int trace = SIM.trace;
+    pru_sim_init(&SIM);
+    SIM.trace = trace;
+  }
+  p_dev[num_dev] = periph_ddr_create(pool_addr, pool_size);
+  if ( p_dev[num_dev] == NULL )
+  {
+    fprintf(stderr, "Cannot allocate a %u bytes pool\n", pool_size);
+    exit(EXIT_FAILURE);
+  }
+  num_dev++;
+  for ( c = 0; c < num_dev; c++ )
+  {
+    pru_sim_attach(&SIM, p_dev[c]);
+  }
+
+  /* Host writes at cycle 0 go in before the cores start */
+  apply_pokes(poke, num_pokes);
+
+  for ( c = 0; c < PRU_NUM_CORES; c++ )
+  {
+    int i = 0;
+    if ( c == 1 && pru1_file == NULL )
+    {
+      continue;
+    }
+    pru_sim_start(&SIM, c, &PROG[c]);
+    SIM.core[c].p_pc_hist = profile ? calloc(ASM_MAX_INSN, sizeof(uint64_t)) : NULL;
+    for ( i = 0; i < num_idle[c]; i++ )
+    {
+      uint32_t addr = 0;
+      uint32_t end = 0;
+      uint32_t k = 0;
+      if ( asm_find_label(&PROG[c], idle_label[c][i], &addr) < 0 )
+      {
+        fprintf(stderr, "Unknown idle label '%s'\n", idle_label[c][i]);
+        exit(EXIT_FAILURE);
+      }
+      /* Idle region: from the label up to the next label */
+      end = PROG[c].num_insn;
+      for ( k = 0; k < PROG[c].num_labels; k++ )
+      {
+        if ( PROG[c].label[k].addr > addr && PROG[c].label[k].addr < end &&
+             strstr(PROG[c].label[k].name, "__m") == NULL )
+        {
+          end = PROG[c].label[k].addr;
+        }
+      }
+      for ( k = addr; k < end && SIM.core[c].num_idle < 16; k++ )
+      {
+        SIM.core[c].idle_addr[SIM.core[c].num_idle++] = k;
+      }
+    }
+  }
+
+  /* Run */
+  until = (uint64_t)(sim_time * PRU_CLOCK_HZ);
+  for ( ;; )
+  {
+    uint64_t slice = SIM.now + SLICE_CYCLES;
+    if ( slice > until )
+    {
+      slice = until;
+    }
+
+    res = pru_sim_run(&SIM, slice);
+    if ( res != 0 )
+    {
+      break;
+    }
+    apply_pokes(poke, num_pokes);
+
+    if ( (max_events != 0 && SIM.num_events >= max_events) || SIM.now >= until )
+    {
+      break;
+    }
+  }
+
+  print_report(stdout, p_dev, num_dev, profile);
+
+  /* Memory words requested with -w [C:]ADDR[:COUNT] */
+  for ( c = 0; c < num_watch; c++ )
+  {
+    const char *s = watch[c];
+    int core = 0;
+    uint32_t addr = 0;
+    uint32_t count = 1;
+    uint32_t i = 0;
+    char *end = NULL;
+
+    if ( s[1] == ':' && (s[0] == '0' || s[0] == '1') )
+    {
+      core = s[0] - '0';
+      s += 2;
+    }
+    addr = (uint32_t)strtoul(s, &end, 0);
+    if ( *end == ':' )
+    {
+      count = (uint32_t)strtoul(end + 1, NULL, 0);
+    }
+    for ( i = 0; i < count; i++ )
+    {
+      printf("PRU%d [0x%08x] = 0x%08x (%u)\n", core, addr + 4 * i,
+             pru_sim_read32(&SIM, core, addr + 4 * i), pru_sim_read32(&SIM, core, addr + 4 * i));
+    }
+  }
+
+  if ( dump_file != NULL )
+  {
+    periph_ddr_dump(p_dev[num_dev - 1], dump_file, dump_len);
+  }
+
+  /* Regression checks requested with -x MIN_SPS */
+  for ( c = 0; c < num_dev && min_rate >= 0; c++ )
+  {
+    if ( p_dev[c]->check != NULL )
+    {
+      failures += p_dev[c]->check(p_dev[c], stdout, min_rate);
+    }
+  }
+
+  return (res < 0 || failures > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/***********************************************************************
+ * FUNCTIONS
+ **/
+/***********************************************************************
+ * @fn      usage
+ *
+ * @brief
+ *
+ * @param   name
+ *
+ * @return  void
+ **/
+void usage(const char *name)
+{
+  printf("Usage: %s [options] <PRU0_PROGRAM.p>\n\n", name);
+  printf("\t-D [1:]NAME[=VAL]   Define a symbol (as 'pasm -D'), 1: PRU1 program only\n");
+  printf("\t-1 PROGRAM.p        Program for PRU1\n");
+  printf("\t-a SIGNAL           Attach the TSC_ADC model\n");
+  printf("\t-s SIGNAL           Attach an ADS1256 on the PRU0 pins (-S: PRU1 pins)\n");
+  printf("\t-y [C:]BIT          SYNC/PDWN of all ADS1256 on R30 bit BIT of PRU C\n");
+  printf("\t-k CLKIN_HZ         ADS1256 master clock (default 7680000)\n");
+  printf("\t-p ADDR:SIZE        DDR pool, hex (default %x:%x)\n", DEF_POOL_ADDR, DEF_POOL_SIZE);
+  printf("\t-m [C:]ADDR=VAL[@N] Host write of a 32-bit word through PRU C map,\n");
+  printf("\t                    at cycle N (or after N host events: @eN)\n");
+  printf("\t-w [C:]ADDR[:N]     Print N words through PRU C map at the end\n");
+  printf("\t-t SECONDS          Simulated time (default %.1f)\n", DEF_TIME_S);
+  printf("\t-e N                Stop after N host events\n");
+  printf("\t-i [C:]LABEL        Count cycles in LABEL as idle (busy-wait loops)\n");
+  printf("\t-o FILE [-n BYTES]  Dump the DDR pool\n");
+  printf("\t-x MIN_SPS          Fail on ADS1256 timing violations, TSC_ADC FIFO overrun,\n");
+  printf("\t                    or a converter below MIN_SPS\n");
+  printf("\t-r                  Cycle profile per label\n");
+  printf("\t-v                  Instruction trace (stderr)\n\n");
+  printf("\tSIGNAL: ramp | sine:F[:A[:O]] | const:L | pulse:PERIOD:WIDTH[:LOW:HIGH] | noise[:A]\n\n");
+  exit(EXIT_FAILURE);
+}
+
+/***********************************************************************
+ * @fn      add_define
+ *
+ * @brief   NAME[=VAL]
+ *
+ * @param   arg
+ *
+ * @return  void
+ **/
+void add_define(const char *arg)
+{
+  char name[ASM_MAX_NAME];
+  const char *eq = strchr(arg, '=');
+
+  snprintf(name, sizeof(name), "%.*s", eq ? (int)(eq - arg) : (int)strlen(arg), arg);
+  asm_add_define(name, eq ? eq + 1 : "1");
+}
+
+/***********************************************************************
+ * @fn      parse_poke
+ *
+ * @brief   [C:]ADDR=VAL[@CYCLE|@eEVENTS]
+ *
+ * @param   s
+ *          p_poke
+ *
+ * @return  0 on success, -1 on error
+ **/
+int parse_poke(const char *s, poke_t *p_poke)
+{
+  const char *at = strchr(s, '@');
+  char *end = NULL;
+
+  memset(p_poke, 0, sizeof(poke_t));
+
+  if ( s[1] == ':' && (s[0] == '0' || s[0] == '1') )
+  {
+    p_poke->core = s[0] - '0';
+    s += 2;
+  }
+
+  p_poke->addr = (uint32_t)strtoul(s, &end, 0);
+  if ( *end != '=' )
+  {
+    return -1;
+  }
+  p_poke->val = (uint32_t)strtoul(end + 1, &end, 0);
+
+  if ( at != NULL )
+  {
+    if ( at[1] == 'e' )
+    {
+      p_poke->event = (uint32_t)strtoul(at + 2, NULL, 0);
+    }
+    else
+    {
+      p_poke->cycle = strtoull(at + 1, NULL, 0);
+    }
+  }
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      apply_pokes
+ *
+ * @brief   Perform the host writes that are due
+ *
+ * @param   p_poke
+ *          num
+ *
+ * @return  void
+ **/
+void apply_pokes(poke_t *p_poke, int num)
+{
+  int i = 0;
+
+  for ( i = 0; i < num; i++ )
+  {
+    int due = (p_poke[i].event != 0) ? (SIM.num_events >= p_poke[i].event)
+                                     : (SIM.now >= p_poke[i].cycle);
+    if ( !p_poke[i].done && due )
+    {
+      pru_sim_write32(&SIM, p_poke[i].core, p_poke[i].addr, p_poke[i].val);
+      p_poke[i].done = 1;
+    }
+  }
+}
+
+/***********************************************************************
+ * @fn      print_report
+ *
+ * @brief
+ *
+ * @param   fp
+ *          p_dev
+ *          num_dev
+ *          profile
+ *
+ * @return  void
+ **/
+void print_report(FILE *fp, pru_periph_t **p_dev, int num_dev, int profile)
+{
+  uint32_t i = 0;
+  int c = 0;
+
+  fprintf(fp, "Simulated:       %.6f s (%llu cycles)\n",
+          (double)SIM.now / PRU_CLOCK_HZ, (unsigned long long)SIM.now);
+
+  for ( c = 0; c < PRU_NUM_CORES; c++ )
+  {
+    pru_core_t *p_core = &SIM.core[c];
+    if ( !p_core->enabled )
+    {
+      continue;
+    }
+    fprintf(fp, "PRU%d:%s\n", c, p_core->halted ? " (halted)" : "");
+    fprintf(fp, "\tInstructions:  %llu\n", (unsigned long long)p_core->insn_count);
+    fprintf(fp, "\tStall cycles:  %llu (%.1f%%)\n", (unsigned long long)p_core->stall_cycles,
+            SIM.now ? 100.0 * p_core->stall_cycles / SIM.now : 0.0);
+    if ( p_core->num_idle > 0 )
+    {
+      fprintf(fp, "\tIdle headroom: %.1f%% (%llu cycles in idle labels)\n",
+              SIM.now ? 100.0 * p_core->idle_cycles / SIM.now : 0.0,
+              (unsigned long long)p_core->idle_cycles);
+    }
+    if ( profile && p_core->p_pc_hist != NULL )
+    {
+      const char *last = NULL;
+      uint64_t sum = 0;
+      fprintf(fp, "\tProfile (cycles per label):\n");
+      for ( i = 0; i <= p_core->p_prog->num_insn; i++ )
+      {
+        const char *name = (i < p_core->p_prog->num_insn) ? asm_label_at(p_core->p_prog, i) : NULL;
+        if ( name != last && last != NULL && sum > 0 )
+        {
+          fprintf(fp, "\t\t%-20s %12llu  %5.1f%%\n", last, (unsigned long long)sum, 100.0 * sum / SIM.now);
+          sum = 0;
+        }
+        if ( i < p_core->p_prog->num_insn )
+        {
+          sum += p_core->p_pc_hist[i];
+        }
+        last = name;
+      }
+    }
+  }
+
+  fprintf(fp, "Host events:     %u\n", SIM.num_events);
+  for ( i = 0; i < SIM.num_events && i < 8; i++ )
+  {
+    fprintf(fp, "\t#%u PRU%d event %u at %.6f s\n", i, SIM.event[i].core, SIM.event[i].event,
+            (double)SIM.event[i].cycle / PRU_CLOCK_HZ);
+  }
+  if ( SIM.num_events > 1 )
+  {
+    fprintf(fp, "\tMean interval: %.3f us\n",
+            (double)(SIM.event[SIM.num_events - 1].cycle - SIM.event[0].cycle) /
+            (SIM.num_events - 1) / PRU_CLOCK_HZ * 1e6);
+  }
+
+  for ( c = 0; c < num_dev; c++ )
+  {
+    if ( p_dev[c]->advance != NULL )
+    {
+      p_dev[c]->advance(p_dev[c], SIM.now);
+    }
+    if ( p_dev[c]->report != NULL )
+    {
+      p_dev[c]->report(p_dev[c], fp, SIM.now);
+    }
+  }
+}
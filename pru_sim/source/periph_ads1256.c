@@ -0,0 +1,825 @@
+/***********************************************************************
+ * INCLUDES
+ **/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "pru_sim.h"
+
+/***********************************************************************
+ * DEFINES
+ **/
+/* Default pin map: pru_ads1256.p on PRU0 */
+#define PIN_CS          1   /* r30.t1 */
+#define PIN_SCLK        2   /* r30.t2 */
+#define PIN_DIN         5   /* r30.t5 (MOSI) */
+#define PIN_DOUT        3   /* r31.t3 (MISO) */
+#define PIN_DRDY        7   /* r31.t7 */
+
+/* Commands */
+#define CMD_WAKEUP      0x00
+#define CMD_RDATA       0x01
+#define CMD_RDATAC      0x03
+#define CMD_SDATAC      0x0F
+#define CMD_RREG        0x10
+#define CMD_WREG        0x50
+#define CMD_SELFCAL     0xF0
+#define CMD_SYNC        0xFC
+#define CMD_STANDBY     0xFD
+#define CMD_RESET       0xFE
+
+/* Timing violations */
+#define VIO_T1          0   /* SCLK period < 4 tCLKIN */
+#define VIO_T2          1   /* SCLK pulse width < 200 ns */
+#define VIO_T3          2   /* DIN setup < 50 ns */
+#define VIO_T4          3   /* DIN hold < 50 ns */
+#define VIO_T6          4   /* RDATA/RREG to first read clock < 50 tCLKIN */
+#define VIO_T10         5   /* Last SCLK to CS high < 8 tCLKIN */
+#define VIO_T11         6   /* Command to next command */
+#define VIO_COUNT       7
+
+/***********************************************************************
+ * TYPEDEFS
+ **/
+typedef struct ads_ctx_t
+{
+  double       tclk;            /* CLKIN period in PRU cycles */
+  uint8_t      reg[11];
+  int          pin_cs, pin_sclk, pin_din, pin_dout, pin_drdy, pin_sync;
+  int          sync_core;       /* PRU driving SYNC/PDWN (-1: none) */
+  int          sync_level;
+  uint32_t     r30;
+
+  /* Converter */
+  int          converting;
+  double       next_conv;       /* PRU cycle the next data is ready */
+  int          data_ready;      /* Unread data (DRDY low) */
+  int32_t      data;
+  uint64_t     index[16];
+  uint64_t     conversions;
+  uint64_t     overwritten;     /* Conversions never read */
+  uint64_t     retrieved;
+  uint64_t     first_read;
+  uint64_t     last_read;
+  int          rdatac;
+  uint64_t     cal_until;
+
+  /* SPI shift registers */
+  uint8_t      in_byte;
+  int          in_bits;
+  uint8_t      cmd[4];
+  int          cmd_len;
+  int          wreg_left;
+  uint8_t      out[16];
+  int          out_len;         /* Bytes */
+  int          out_bit;         /* Bits already shifted */
+  double       out_ready;       /* t6 */
+  int          dout;
+  int          sclk;
+
+  /* Timing */
+  uint64_t     last_rise;
+  uint64_t     last_fall;
+  uint64_t     last_din;
+  double       next_cmd_min;
+  uint64_t     sclk_periods;
+  uint64_t     sclk_sum;
+  uint64_t     sclk_min;
+  uint64_t     bytes;
+  uint64_t     violations[VIO_COUNT];
+  sim_signal_t signal;
+} ads_ctx_t;
+
+/***********************************************************************
+ * GLOBALS
+ **/
+static const struct { uint8_t code; double sps; double settle_ms; } DRATES[] =
+{
+  {0xF0, 30000, 0.21}, {0xE0, 15000, 0.25}, {0xD0, 7500, 0.31}, {0xC0, 3750, 0.44},
+  {0xB0, 2000, 0.68},  {0xA1, 1000, 1.18},  {0x92, 500, 2.18},  {0x82, 100, 10.18},
+  {0x72, 60, 16.84},   {0x63, 50, 20.18},   {0x53, 30, 33.51},  {0x43, 25, 40.18},
+  {0x33, 15, 66.84},   {0x23, 10, 100.18},  {0x13, 5, 200.18},  {0x03, 2.5, 400.18}
+};
+
+static const char *VIO_NAME[VIO_COUNT] =
+{
+  "t1  SCLK period", "t2  SCLK pulse width", "t3  DIN setup", "t4  DIN hold",
+  "t6  DIN to DOUT delay", "t10 SCLK to CS high", "t11 command to command"
+};
+
+/***********************************************************************
+ * PRIVATE FUNCTIONS PROTOTYPES
+ **/
+static void     ads_advance(pru_periph_t *p_dev, uint64_t now);
+static void     ads_pins_out(pru_periph_t *p_dev, uint32_t r30, uint64_t now);
+static uint32_t ads_pins_in(pru_periph_t *p_dev, uint64_t now);
+static void     ads_pins_watch(pru_periph_t *p_dev, int core, uint32_t r30, uint64_t now);
+static void     ads_sync_pin(ads_ctx_t *p_ctx, int level, uint64_t now);
+static void     ads_report(pru_periph_t *p_dev, FILE *fp, uint64_t now);
+static int      ads_check(pru_periph_t *p_dev, FILE *fp, double min_rate);
+static void     ads_reset(ads_ctx_t *p_ctx, uint64_t now);
+static double   ads_period(ads_ctx_t *p_ctx);
+static double   ads_settle(ads_ctx_t *p_ctx);
+static void     ads_byte(ads_ctx_t *p_ctx, uint8_t byte, uint64_t now);
+static void     ads_start_output(ads_ctx_t *p_ctx, const uint8_t *data, int len, uint64_t now);
+
+/***********************************************************************
+ * FUNCTIONS
+ **/
+/***********************************************************************
+ * @fn      periph_ads1256_create
+ *
+ * @brief   ADS1256 SPI slave model driven by bit-banged PRU pins
+ *
+ * @param   core - PRU core driving the pins
+ *          clkin_hz - Master clock (7.68 MHz on the usual boards)
+ *          signal - Input signal spec (NULL: ramp)
+ *
+ * @return  Peripheral or NULL
+ */
+pru_periph_t *periph_ads1256_create(int core, double clkin_hz, const char *signal)
+{
+  pru_periph_t *p_dev = calloc(1, sizeof(pru_periph_t));
+  ads_ctx_t *p_ctx = calloc(1, sizeof(ads_ctx_t));
+
+  if ( p_dev == NULL || p_ctx == NULL || signal_parse(&p_ctx->signal, signal) < 0 )
+  {
+    free(p_dev);
+    free(p_ctx);
+    return NULL;
+  }
+
+  p_ctx->tclk     = PRU_CLOCK_HZ / clkin_hz;
+  p_ctx->pin_cs   = PIN_CS;
+  p_ctx->pin_sclk = PIN_SCLK;
+  p_ctx->pin_din  = PIN_DIN;
+  p_ctx->pin_dout = PIN_DOUT;
+  p_ctx->pin_drdy = PIN_DRDY;
+  p_ctx->pin_sync = -1;
+  p_ctx->sync_core = -1;
+  p_ctx->sync_level = 1;
+  p_ctx->r30      = 1u << PIN_CS;
+  p_ctx->sclk_min = UINT64_MAX;
+  ads_reset(p_ctx, 0);
+
+  p_dev->name     = "ads1256";
+  p_dev->core     = core;
+  p_dev->ctx      = p_ctx;
+  p_dev->advance  = ads_advance;
+  p_dev->pins_out = ads_pins_out;
+  p_dev->pins_in  = ads_pins_in;
+  p_dev->pins_watch = ads_pins_watch;
+  p_dev->report   = ads_report;
+  p_dev->check    = ads_check;
+
+  return p_dev;
+}
+
+/***********************************************************************
+ * @fn      periph_ads1256_pins
+ *
+ * @brief   Override the pin map (R30/R31 bit numbers, sync: -1 = none)
+ *
+ * @param   p_dev
+ *          cs, sclk, din - R30 bits
+ *          dout, drdy - R31 bits
+ *          sync - R30 bit driving SYNC/PDWN
+ *
+ * @return  none
+ */
+void periph_ads1256_pins(pru_periph_t *p_dev, int cs, int sclk, int din, int dout, int drdy, int sync)
+{
+  ads_ctx_t *p_ctx = p_dev->ctx;
+
+  p_ctx->pin_cs   = cs;
+  p_ctx->pin_sclk = sclk;
+  p_ctx->pin_din  = din;
+  p_ctx->pin_dout = dout;
+  p_ctx->pin_drdy = drdy;
+  p_ctx->pin_sync = sync;
+  p_ctx->sync_core = sync >= 0 ? p_dev->core : -1;
+  p_ctx->r30      = (1u << cs) | (sync >= 0 ? (1u << sync) : 0);
+}
+
+/***********************************************************************
+ * @fn      periph_ads1256_sync
+ *
+ * @brief   Drive SYNC/PDWN from an R30 bit of any PRU, e.g. one pin
+ *          shared by the converters of both cores
+ *
+ * @param   p_dev
+ *          core - PRU driving the pin
+ *          sync - R30 bit
+ *
+ * @return  none
+ */
+void periph_ads1256_sync(pru_periph_t *p_dev, int core, int sync)
+{
+  ads_ctx_t *p_ctx = p_dev->ctx;
+
+  p_ctx->pin_sync   = sync;
+  p_ctx->sync_core  = core;
+  p_ctx->sync_level = 1;
+  if ( core == p_dev->core )
+  {
+    p_ctx->r30 |= 1u << sync;
+  }
+}
+
+/***********************************************************************
+ * PRIVATE FUNCTIONS
+ **/
+/***********************************************************************
+ * @fn      ads_reset
+ *
+ * @brief   Power-up register values, conversions restart
+ *
+ * @param   p_ctx
+ *          now
+ *
+ * @return  none
+ */
+static void ads_reset(ads_ctx_t *p_ctx, uint64_t now)
+{
+  static const uint8_t DEFAULTS[11] = {0x31, 0x01, 0x20, 0xF0, 0xE0, 0, 0, 0, 0, 0, 0x40};
+
+  memcpy(p_ctx->reg, DEFAULTS, sizeof(DEFAULTS));
+  p_ctx->rdatac     = 0;
+  p_ctx->converting = 1;
+  p_ctx->data_ready = 0;
+  p_ctx->next_conv  = now + ads_settle(p_ctx);
+  p_ctx->out_len    = 0;
+  p_ctx->cmd_len    = 0;
+  p_ctx->wreg_left  = 0;
+}
+
+/***********************************************************************
+ * @fn      ads_period
+ *
+ * @brief   Conversion period in PRU cycles
+ *
+ * @param   p_ctx
+ *
+ * @return
+ */
+static double ads_period(ads_ctx_t *p_ctx)
+{
+  size_t i = 0;
+
+  for ( i = 0; i < sizeof(DRATES) / sizeof(DRATES[0]); i++ )
+  {
+    if ( DRATES[i].code == p_ctx->reg[3] )
+    {
+      return PRU_CLOCK_HZ / DRATES[i].sps;
+    }
+  }
+
+  return PRU_CLOCK_HZ / 30000.0;
+}
+
+/***********************************************************************
+ * @fn      ads_settle
+ *
+ * @brief   Settling time after SYNC/WAKEUP or a register change (cycles)
+ *
+ * @param   p_ctx
+ *
+ * @return
+ */
+static double ads_settle(ads_ctx_t *p_ctx)
+{
+  size_t i = 0;
+
+  for ( i = 0; i < sizeof(DRATES) / sizeof(DRATES[0]); i++ )
+  {
+    if ( DRATES[i].code == p_ctx->reg[3] )
+    {
+      return DRATES[i].settle_ms * 1e-3 * PRU_CLOCK_HZ;
+    }
+  }
+
+  return 0.21e-3 * PRU_CLOCK_HZ;
+}
+
+/***********************************************************************
+ * @fn      ads_advance
+ *
+ * @brief   Produce the conversions completed up to 'now'
+ *
+ * @param   p_dev
+ *          now
+ *
+ * @return  none
+ */
+static void ads_advance(pru_periph_t *p_dev, uint64_t now)
+{
+  ads_ctx_t *p_ctx = p_dev->ctx;
+
+  while ( p_ctx->converting && p_ctx->next_conv <= (double)now )
+  {
+    int ch = (p_ctx->reg[1] >> 4) & 0xF;
+    int gain = 1 << (p_ctx->reg[2] & 0x7);
+    int64_t code = signal_code(&p_ctx->signal, p_ctx->next_conv / PRU_CLOCK_HZ,
+                               p_ctx->index[ch]++, ch, 24, 1);
+
+    if ( p_ctx->signal.type != SIG_RAMP )
+    {
+      code *= gain;
+      if ( code > 0x7FFFFF )
+      {
+        code = 0x7FFFFF;
+      }
+      if ( code < -0x800000 )
+      {
+        code = -0x800000;
+      }
+    }
+
+    if ( p_ctx->data_ready )
+    {
+      p_ctx->overwritten++;
+    }
+    p_ctx->data       = (int32_t)code;
+    p_ctx->data_ready = 1;
+    p_ctx->conversions++;
+    p_ctx->next_conv += ads_period(p_ctx);
+  }
+}
+
+/***********************************************************************
+ * @fn      ads_start_output
+ *
+ * @brief   Load DOUT shift register
+ *
+ * @param   p_ctx
+ *          data
+ *          len
+ *          now
+ *
+ * @return  none
+ */
+static void ads_start_output(ads_ctx_t *p_ctx, const uint8_t *data, int len, uint64_t now)
+{
+  memcpy(p_ctx->out, data, len);
+  p_ctx->out_len   = len;
+  p_ctx->out_bit   = 0;
+  p_ctx->out_ready = now + 50 * p_ctx->tclk;
+}
+
+/***********************************************************************
+ * @fn      ads_retrieve
+ *
+ * @brief   Latch the conversion result into DOUT (DRDY goes high)
+ *
+ * @param   p_ctx
+ *          now
+ *
+ * @return  none
+ */
+static void ads_retrieve(ads_ctx_t *p_ctx, uint64_t now)
+{
+  uint8_t buf[3];
+
+  buf[0] = (uint8_t)(p_ctx->data >> 16);
+  buf[1] = (uint8_t)(p_ctx->data >> 8);
+  buf[2] = (uint8_t)p_ctx->data;
+  ads_start_output(p_ctx, buf, 3, now);
+
+  p_ctx->data_ready = 0;
+  if ( p_ctx->retrieved == 0 )
+  {
+    p_ctx->first_read = now;
+  }
+  p_ctx->last_read = now;
+  p_ctx->retrieved++;
+}
+
+/***********************************************************************
+ * @fn      ads_byte
+ *
+ * @brief   A full byte was shifted in on DIN
+ *
+ * @param   p_ctx
+ *          byte
+ *          now
+ *
+ * @return  none
+ */
+static void ads_byte(ads_ctx_t *p_ctx, uint8_t byte, uint64_t now)
+{
+  double t11 = 4 * p_ctx->tclk;
+
+  p_ctx->bytes++;
+
+  /* WREG data bytes */
+  if ( p_ctx->wreg_left > 0 )
+  {
+    uint8_t reg = p_ctx->cmd[0] & 0x0F;
+    reg += (uint8_t)(p_ctx->cmd[1] + 1 - p_ctx->wreg_left);
+    if ( reg == 0 )
+    {
+      p_ctx->reg[0] = (p_ctx->reg[0] & 0xF1) | (byte & 0x0E);
+    }
+    else if ( reg < sizeof(p_ctx->reg) )
+    {
+      p_ctx->reg[reg] = byte;
+    }
+    if ( reg >= 1 && reg <= 3 && p_ctx->converting )
+    {
+      /* MUX/ADCON/DRATE writes restart the conversion in progress */
+      p_ctx->next_conv = now + ads_settle(p_ctx);
+    }
+    /* t11 runs from the last data byte, the bytes of a WREG go back to back */
+    p_ctx->wreg_left--;
+    if ( p_ctx->wreg_left == 0 )
+    {
+      p_ctx->next_cmd_min = now + t11;
+    }
+    return;
+  }
+
+  /* Two byte commands */
+  if ( p_ctx->cmd_len == 1 )
+  {
+    p_ctx->cmd[1] = byte;
+    p_ctx->cmd_len = 0;
+    if ( (p_ctx->cmd[0] & 0xF0) == CMD_WREG )
+    {
+      p_ctx->wreg_left = byte + 1;
+    }
+    else
+    {
+      uint8_t buf[16];
+      int i = 0;
+      for ( i = 0; i <= byte && i < 16; i++ )
+      {
+        int reg = (p_ctx->cmd[0] & 0x0F) + i;
+        buf[i] = (reg < (int)sizeof(p_ctx->reg)) ? p_ctx->reg[reg] : 0;
+      }
+      ads_start_output(p_ctx, buf, i, now);
+      p_ctx->next_cmd_min = now + t11;
+    }
+    return;
+  }
+
+  /* In RDATAC mode only SDATAC and RESET are decoded */
+  if ( p_ctx->rdatac && byte != CMD_SDATAC && byte != CMD_RESET )
+  {
+    return;
+  }
+
+  switch ( byte )
+  {
+    case CMD_WAKEUP: case 0xFF:
+      if ( !p_ctx->converting )
+      {
+        p_ctx->converting = 1;
+        p_ctx->next_conv  = now + ads_settle(p_ctx);
+      }
+      break;
+
+    case CMD_RDATA:
+      ads_retrieve(p_ctx, now);
+      break;
+
+    case CMD_RDATAC:
+      p_ctx->rdatac = 1;
+      ads_retrieve(p_ctx, now);
+      break;
+
+    case CMD_SDATAC:
+      p_ctx->rdatac  = 0;
+      p_ctx->out_len = 0;
+      break;
+
+    case CMD_SYNC:
+      p_ctx->converting = 0;
+      t11 = 24 * p_ctx->tclk;
+      break;
+
+    case CMD_STANDBY:
+      p_ctx->converting = 0;
+      break;
+
+    case CMD_RESET:
+      ads_reset(p_ctx, now);
+      break;
+
+    case CMD_SELFCAL: case 0xF1: case 0xF2: case 0xF3: case 0xF4:
+      /* DRDY stays high during calibration */
+      p_ctx->data_ready = 0;
+      p_ctx->cal_until  = now + (uint64_t)(2.8 * ads_settle(p_ctx));
+      p_ctx->next_conv  = p_ctx->cal_until + ads_period(p_ctx);
+      break;
+
+    default:
+      if ( (byte & 0xF0) == CMD_RREG || (byte & 0xF0) == CMD_WREG )
+      {
+        p_ctx->cmd[0]  = byte;
+        p_ctx->cmd_len = 1;
+        return;
+      }
+      break;
+  }
+
+  p_ctx->next_cmd_min = now + t11;
+}
+
+/***********************************************************************
+ * @fn      ads_pins_out
+ *
+ * @brief   CS/SCLK/DIN/SYNC driven by R30
+ *
+ * @param   p_dev
+ *          r30
+ *          now
+ *
+ * @return  none
+ */
+static void ads_pins_out(pru_periph_t *p_dev, uint32_t r30, uint64_t now)
+{
+  ads_ctx_t *p_ctx = p_dev->ctx;
+  uint32_t changed = r30 ^ p_ctx->r30;
+  int cs   = (r30 >> p_ctx->pin_cs) & 1;
+  int sclk = (r30 >> p_ctx->pin_sclk) & 1;
+  int din  = (r30 >> p_ctx->pin_din) & 1;
+
+  p_ctx->r30 = r30;
+
+  if ( p_ctx->sync_core == p_dev->core && (changed & (1u << p_ctx->pin_sync)) )
+  {
+    ads_sync_pin(p_ctx, (r30 >> p_ctx->pin_sync) & 1, now);
+  }
+
+  if ( changed & (1u << p_ctx->pin_din) )
+  {
+    if ( !cs && now - p_ctx->last_fall < 10 && p_ctx->last_fall != 0 && !sclk )
+    {
+      p_ctx->violations[VIO_T4]++;
+    }
+    p_ctx->last_din = now;
+  }
+
+  if ( changed & (1u << p_ctx->pin_cs) )
+  {
+    if ( cs )
+    {
+      /* CS released: t10 and shift register reset */
+      if ( p_ctx->last_fall != 0 && (double)(now - p_ctx->last_fall) < 8 * p_ctx->tclk )
+      {
+        p_ctx->violations[VIO_T10]++;
+      }
+      p_ctx->in_bits = 0;
+    }
+  }
+
+  if ( cs || !(changed & (1u << p_ctx->pin_sclk)) )
+  {
+    p_ctx->sclk = sclk;
+    return;
+  }
+
+  if ( sclk )
+  {
+    /* Rising edge: next DOUT bit */
+    if ( p_ctx->last_rise != 0 && p_ctx->in_bits != 0 )
+    {
+      uint64_t period = now - p_ctx->last_rise;
+      if ( (double)period < 4 * p_ctx->tclk )
+      {
+        p_ctx->violations[VIO_T1]++;
+      }
+      p_ctx->sclk_periods++;
+      p_ctx->sclk_sum += period;
+      if ( period < p_ctx->sclk_min )
+      {
+        p_ctx->sclk_min = period;
+      }
+    }
+    if ( p_ctx->last_fall != 0 && now - p_ctx->last_fall < 40 && p_ctx->in_bits != 0 )
+    {
+      p_ctx->violations[VIO_T2]++;
+    }
+
+    if ( p_ctx->in_bits == 0 && p_ctx->out_len == 0 )
+    {
+      if ( (double)now < p_ctx->next_cmd_min )
+      {
+        p_ctx->violations[VIO_T11]++;
+      }
+      /* RDATAC: the read starts with the first clock after DRDY */
+      if ( p_ctx->rdatac && p_ctx->data_ready )
+      {
+        ads_retrieve(p_ctx, now);
+        p_ctx->out_ready = 0;
+      }
+    }
+
+    if ( p_ctx->out_len > 0 )
+    {
+      if ( p_ctx->out_bit == 0 && (double)now < p_ctx->out_ready )
+      {
+        p_ctx->violations[VIO_T6]++;
+      }
+      p_ctx->dout = (p_ctx->out[p_ctx->out_bit / 8] >> (7 - (p_ctx->out_bit % 8))) & 1;
+      p_ctx->out_bit++;
+    }
+    else
+    {
+      p_ctx->dout = 0;
+    }
+    p_ctx->last_rise = now;
+  }
+  else
+  {
+    /* Falling edge: DIN is latched */
+    if ( now - p_ctx->last_rise < 40 )
+    {
+      p_ctx->violations[VIO_T2]++;
+    }
+    if ( now - p_ctx->last_din < 10 )
+    {
+      p_ctx->violations[VIO_T3]++;
+    }
+    p_ctx->in_byte = (uint8_t)((p_ctx->in_byte << 1) | din);
+    p_ctx->in_bits++;
+    p_ctx->last_fall = now;
+
+    if ( p_ctx->out_len > 0 && p_ctx->out_bit >= p_ctx->out_len * 8 )
+    {
+      p_ctx->out_len = 0;
+    }
+
+    if ( p_ctx->in_bits == 8 )
+    {
+      p_ctx->in_bits = 0;
+      ads_byte(p_ctx, p_ctx->in_byte, now);
+    }
+  }
+
+  p_ctx->sclk = sclk;
+}
+
+/***********************************************************************
+ * @fn      ads_pins_watch
+ *
+ * @brief   SYNC/PDWN driven by the other PRU
+ *
+ * @param   p_dev
+ *          core
+ *          r30
+ *          now
+ *
+ * @return  none
+ */
+static void ads_pins_watch(pru_periph_t *p_dev, int core, uint32_t r30, uint64_t now)
+{
+  ads_ctx_t *p_ctx = p_dev->ctx;
+  int level = (r30 >> p_ctx->pin_sync) & 1;
+
+  if ( p_ctx->sync_core == core && level != p_ctx->sync_level )
+  {
+    ads_sync_pin(p_ctx, level, now);
+  }
+}
+
+/***********************************************************************
+ * @fn      ads_sync_pin
+ *
+ * @brief   SYNC/PDWN pin: falling edge = SYNC (conversions stop, DRDY
+ *          high), rising edge = WAKEUP
+ *
+ * @param   p_ctx
+ *          level
+ *          now
+ *
+ * @return  none
+ */
+static void ads_sync_pin(ads_ctx_t *p_ctx, int level, uint64_t now)
+{
+  p_ctx->sync_level = level;
+  if ( level )
+  {
+    p_ctx->converting = 1;
+    p_ctx->next_conv  = now + ads_settle(p_ctx);
+  }
+  else
+  {
+    p_ctx->converting = 0;
+    p_ctx->data_ready = 0;
+  }
+}
+
+/***********************************************************************
+ * @fn      ads_pins_in
+ *
+ * @brief   DRDY and DOUT seen on R31
+ *
+ * @param   p_dev
+ *          now
+ *
+ * @return  R31 bits
+ */
+static uint32_t ads_pins_in(pru_periph_t *p_dev, uint64_t now)
+{
+  ads_ctx_t *p_ctx = p_dev->ctx;
+  uint32_t val = 0;
+  int drdy = 1;
+
+  /* DRDY low while unread data is available; it pulses high before an update */
+  if ( p_ctx->data_ready && now >= p_ctx->cal_until &&
+       !(p_ctx->converting && (double)now >= p_ctx->next_conv - 4 * p_ctx->tclk) )
+  {
+    drdy = 0;
+  }
+
+  if ( drdy )
+  {
+    val |= 1u << p_ctx->pin_drdy;
+  }
+
+  /* DOUT is high-Z (pulled up) with CS high */
+  if ( ((p_ctx->r30 >> p_ctx->pin_cs) & 1) || p_ctx->dout )
+  {
+    val |= 1u << p_ctx->pin_dout;
+  }
+
+  return val;
+}
+
+/***********************************************************************
+ * @fn      ads_report
+ *
+ * @brief
+ *
+ * @return  none
+ */
+static void ads_report(pru_periph_t *p_dev, FILE *fp, uint64_t now)
+{
+  ads_ctx_t *p_ctx = p_dev->ctx;
+  double span = (double)(p_ctx->last_read - p_ctx->first_read) / PRU_CLOCK_HZ;
+  int i = 0;
+
+  fprintf(fp, "ADS1256 (PRU%d pins):\n", p_dev->core);
+  fprintf(fp, "\tRegisters:     STATUS 0x%02x MUX 0x%02x ADCON 0x%02x DRATE 0x%02x\n",
+          p_ctx->reg[0], p_ctx->reg[1], p_ctx->reg[2], p_ctx->reg[3]);
+  fprintf(fp, "\tConversions:   %llu (%llu never read)\n",
+          (unsigned long long)p_ctx->conversions, (unsigned long long)p_ctx->overwritten);
+  fprintf(fp, "\tSamples read:  %llu\n", (unsigned long long)p_ctx->retrieved);
+  if ( span > 0 && p_ctx->retrieved > 1 )
+  {
+    fprintf(fp, "\tSample rate:   %.1f SPS (achieved)\n", (p_ctx->retrieved - 1) / span);
+  }
+  fprintf(fp, "\tSPI bytes:     %llu\n", (unsigned long long)p_ctx->bytes);
+  if ( p_ctx->sclk_periods > 0 )
+  {
+    fprintf(fp, "\tSCLK:          %.3f MHz mean, %.3f MHz max (limit %.3f MHz)\n",
+            PRU_CLOCK_HZ / ((double)p_ctx->sclk_sum / p_ctx->sclk_periods) / 1e6,
+            PRU_CLOCK_HZ / (double)p_ctx->sclk_min / 1e6,
+            PRU_CLOCK_HZ / (4 * p_ctx->tclk) / 1e6);
+  }
+  for ( i = 0; i < VIO_COUNT; i++ )
+  {
+    if ( p_ctx->violations[i] > 0 )
+    {
+      fprintf(fp, "\tViolation:     %s (%llu)\n", VIO_NAME[i], (unsigned long long)p_ctx->violations[i]);
+    }
+  }
+}
+
+/***********************************************************************
+ * @fn      ads_check
+ *
+ * @brief   No datasheet timing violated and the sample rate reached.
+ *          Conversions never read are not failures: the converter keeps
+ *          running after the capture.
+ *
+ * @return  Number of failures
+ */
+static int ads_check(pru_periph_t *p_dev, FILE *fp, double min_rate)
+{
+  ads_ctx_t *p_ctx = p_dev->ctx;
+  double span = (double)(p_ctx->last_read - p_ctx->first_read) / PRU_CLOCK_HZ;
+  double rate = (span > 0 && p_ctx->retrieved > 1) ? (p_ctx->retrieved - 1) / span : 0;
+  int failures = 0;
+  int i = 0;
+
+  for ( i = 0; i < VIO_COUNT; i++ )
+  {
+    if ( p_ctx->violations[i] > 0 )
+    {
+      fprintf(fp, "FAIL: ADS1256 (PRU%d pins) %s violated %llu times\n",
+              p_dev->core, VIO_NAME[i], (unsigned long long)p_ctx->violations[i]);
+      failures++;
+    }
+  }
+  if ( p_ctx->retrieved == 0 || rate < min_rate )
+  {
+    fprintf(fp, "FAIL: ADS1256 (PRU%d pins) %.1f SPS, %llu read, expected %.1f SPS\n",
+            p_dev->core, rate, (unsigned long long)p_ctx->retrieved, min_rate);
+    failures++;
+  }
+
+  return failures;
+}
@@ -0,0 +1,174 @@
+/***********************************************************************
+ * INCLUDES
+ **/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "pru_sim.h"
+
+/***********************************************************************
+ * TYPEDEFS
+ **/
+typedef struct ddr_ctx_t
+{
+  uint8_t *p_mem;
+  uint64_t bytes_written;
+  uint64_t bytes_read;
+  uint64_t writes;
+  uint64_t first_write;
+  uint64_t last_write;
+} ddr_ctx_t;
+
+/***********************************************************************
+ * PRIVATE FUNCTIONS PROTOTYPES
+ **/
+static int  ddr_read(pru_periph_t *p_dev, uint32_t off, uint8_t *buf, uint32_t len, uint64_t now);
+static int  ddr_write(pru_periph_t *p_dev, uint32_t off, const uint8_t *buf, uint32_t len, uint64_t now);
+static void ddr_report(pru_periph_t *p_dev, FILE *fp, uint64_t now);
+
+/***********************************************************************
+ * FUNCTIONS
+ **/
+/***********************************************************************
+ * @fn      periph_ddr_create
+ *
+ * @brief   DDR external memory pool (uio_pruss extram_pool)
+ *
+ * @param   base - Physical address
+ *          size - Pool size in bytes
+ *
+ * @return  Peripheral or NULL
+ */
+pru_periph_t *periph_ddr_create(uint32_t base, uint32_t size)
+{
+  pru_periph_t *p_dev = calloc(1, sizeof(pru_periph_t));
+  ddr_ctx_t *p_ctx = calloc(1, sizeof(ddr_ctx_t));
+
+  if ( p_dev == NULL || p_ctx == NULL )
+  {
+    free(p_dev);
+    free(p_ctx);
+    return NULL;
+  }
+
+  p_ctx->p_mem = calloc(1, size);
+  if ( p_ctx->p_mem == NULL )
+  {
+    free(p_dev);
+    free(p_ctx);
+    return NULL;
+  }
+
+  p_dev->name      = "ddr";
+  p_dev->base      = base;
+  p_dev->size      = size;
+  p_dev->read_lat  = LAT_DDR_READ;
+  p_dev->write_lat = LAT_DDR_WRITE;
+  p_dev->core      = -1;
+  p_dev->ctx       = p_ctx;
+  p_dev->read      = ddr_read;
+  p_dev->write     = ddr_write;
+  p_dev->report    = ddr_report;
+
+  return p_dev;
+}
+
+/***********************************************************************
+ * @fn      periph_ddr_dump
+ *
+ * @brief   Write the pool contents to a file
+ *
+ * @param   p_dev
+ *          file_name
+ *          len - Bytes to dump (0: whole pool)
+ *
+ * @return  0 on success, -1 on error
+ */
+int periph_ddr_dump(pru_periph_t *p_dev, const char *file_name, uint32_t len)
+{
+  ddr_ctx_t *p_ctx = p_dev->ctx;
+  FILE *fp = NULL;
+
+  if ( len == 0 || len > p_dev->size )
+  {
+    len = p_dev->size;
+  }
+
+  fp = fopen(file_name, "wb");
+  if ( fp == NULL )
+  {
+    perror("fopen(dump_file)");
+    return -1;
+  }
+  fwrite(p_ctx->p_mem, 1, len, fp);
+  fclose(fp);
+
+  return 0;
+}
+
+/***********************************************************************
+ * PRIVATE FUNCTIONS
+ **/
+/***********************************************************************
+ * @fn      ddr_read
+ *
+ * @brief
+ *
+ * @return  0
+ */
+static int ddr_read(pru_periph_t *p_dev, uint32_t off, uint8_t *buf, uint32_t len, uint64_t now)
+{
+  ddr_ctx_t *p_ctx = p_dev->ctx;
+
+  memcpy(buf, &p_ctx->p_mem[off], len);
+  p_ctx->bytes_read += len;
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      ddr_write
+ *
+ * @brief
+ *
+ * @return  0
+ */
+static int ddr_write(pru_periph_t *p_dev, uint32_t off, const uint8_t *buf, uint32_t len, uint64_t now)
+{
+  ddr_ctx_t *p_ctx = p_dev->ctx;
+
+  memcpy(&p_ctx->p_mem[off], buf, len);
+  if ( p_ctx->writes == 0 )
+  {
+    p_ctx->first_write = now;
+  }
+  p_ctx->last_write = now;
+  p_ctx->bytes_written += len;
+  p_ctx->writes++;
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      ddr_report
+ *
+ * @brief
+ *
+ * @return  none
+ */
+static void ddr_report(pru_periph_t *p_dev, FILE *fp, uint64_t now)
+{
+  ddr_ctx_t *p_ctx = p_dev->ctx;
+  double span = (double)(p_ctx->last_write - p_ctx->first_write) / PRU_CLOCK_HZ;
+
+  fprintf(fp, "DDR pool 0x%08x (%u bytes):\n", p_dev->base, p_dev->size);
+  fprintf(fp, "\tWrites:        %llu (%llu bytes, %.1f bytes/store)\n",
+          (unsigned long long)p_ctx->writes, (unsigned long long)p_ctx->bytes_written,
+          p_ctx->writes ? (double)p_ctx->bytes_written / p_ctx->writes : 0.0);
+  fprintf(fp, "\tReads:         %llu bytes\n", (unsigned long long)p_ctx->bytes_read);
+  if ( span > 0 )
+  {
+    fprintf(fp, "\tWrite rate:    %.3f MB/s\n", p_ctx->bytes_written / span / 1e6);
+  }
+}
@@ -0,0 +1,463 @@
+/***********************************************************************
+ * INCLUDES
+ **/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "pru_sim.h"
+
+/***********************************************************************
+ * DEFINES
+ **/
+/* AM335x TRM, Chapter: 'Touchscreen Controller' */
+#define TSC_ADC_BASE        0x44E0D000
+#define TSC_ADC_SIZE        0x300
+#define TSC_ADC_CLK_HZ      24000000.0
+#define TSC_ADC_CLKS        15          /* ADC clocks per conversion */
+#define TSC_FIFO_DEPTH      64
+
+#define REG_IRQSTATUS_RAW   0x24
+#define REG_IRQSTATUS       0x28
+#define REG_IRQENABLE_SET   0x2C
+#define REG_IRQENABLE_CLR   0x30
+#define REG_CTRL            0x40
+#define REG_ADCSTAT         0x44
+#define REG_CLKDIV          0x4C
+#define REG_STEPENABLE      0x54
+#define REG_STEPCONFIG1     0x64
+#define REG_FIFO0COUNT      0xE4
+#define REG_FIFO0THRESHOLD  0xE8
+#define REG_FIFO1COUNT      0xF0
+#define REG_FIFO0DATA       0x100
+#define REG_FIFO1DATA       0x200
+
+#define IRQ_END_OF_SEQUENCE 0x02
+#define IRQ_FIFO0_THRESHOLD 0x04
+#define IRQ_FIFO0_OVERRUN   0x08
+#define IRQ_FIFO0_UNDERFLOW 0x10
+
+/***********************************************************************
+ * TYPEDEFS
+ **/
+typedef struct tsc_ctx_t
+{
+  uint32_t     reg[TSC_ADC_SIZE / 4];
+  uint32_t     fifo[TSC_FIFO_DEPTH];
+  uint32_t     fifo_head;
+  uint32_t     fifo_count;
+  double       next_conv;       /* PRU cycle of the next conversion */
+  int          step;            /* Current step (0..15) */
+  int          running;
+  uint64_t     index[8];        /* Conversions per channel */
+  uint64_t     conversions;
+  uint64_t     dropped;
+  uint64_t     popped;
+  uint64_t     underflows;
+  uint64_t     max_fill;
+  double       first_conv;
+  double       last_conv;
+  sim_signal_t signal;
+} tsc_ctx_t;
+
+/***********************************************************************
+ * PRIVATE FUNCTIONS PROTOTYPES
+ **/
+static void   tsc_advance(pru_periph_t *p_dev, uint64_t now);
+static int    tsc_read(pru_periph_t *p_dev, uint32_t off, uint8_t *buf, uint32_t len, uint64_t now);
+static int    tsc_write(pru_periph_t *p_dev, uint32_t off, const uint8_t *buf, uint32_t len, uint64_t now);
+static void   tsc_report(pru_periph_t *p_dev, FILE *fp, uint64_t now);
+static int    tsc_check(pru_periph_t *p_dev, FILE *fp, double min_rate);
+static double tsc_step_cycles(tsc_ctx_t *p_ctx, int step);
+static int    tsc_next_step(tsc_ctx_t *p_ctx, int step);
+
+/***********************************************************************
+ * FUNCTIONS
+ **/
+/***********************************************************************
+ * @fn      periph_tsc_adc_create
+ *
+ * @brief   AM335x TSC_ADC_SS model (steps, FIFO0/1, IRQ status)
+ *
+ * @param   signal - Input signal spec (NULL: ramp)
+ *
+ * @return  Peripheral or NULL
+ */
+pru_periph_t *periph_tsc_adc_create(const char *signal)
+{
+  pru_periph_t *p_dev = calloc(1, sizeof(pru_periph_t));
+  tsc_ctx_t *p_ctx = calloc(1, sizeof(tsc_ctx_t));
+
+  if ( p_dev == NULL || p_ctx == NULL || signal_parse(&p_ctx->signal, signal) < 0 )
+  {
+    free(p_dev);
+    free(p_ctx);
+    return NULL;
+  }
+
+  p_dev->name      = "tsc_adc";
+  p_dev->base      = TSC_ADC_BASE;
+  p_dev->size      = TSC_ADC_SIZE;
+  p_dev->read_lat  = LAT_L4_READ;
+  p_dev->write_lat = LAT_L4_WRITE;
+  p_dev->core      = -1;
+  p_dev->ctx       = p_ctx;
+  p_dev->advance   = tsc_advance;
+  p_dev->read      = tsc_read;
+  p_dev->write     = tsc_write;
+  p_dev->report    = tsc_report;
+  p_dev->check     = tsc_check;
+
+  return p_dev;
+}
+
+/***********************************************************************
+ * PRIVATE FUNCTIONS
+ **/
+/***********************************************************************
+ * @fn      tsc_step_cycles
+ *
+ * @brief   PRU cycles taken by one step (open + sample delay, averaging)
+ *
+ * @param   p_ctx
+ *          step
+ *
+ * @return
+ */
+static double tsc_step_cycles(tsc_ctx_t *p_ctx, int step)
+{
+  uint32_t cfg   = p_ctx->reg[(REG_STEPCONFIG1 + 8 * step) / 4];
+  uint32_t delay = p_ctx->reg[(REG_STEPCONFIG1 + 4 + 8 * step) / 4];
+  uint32_t avg   = 1u << ((cfg >> 2) & 0x7);
+  double clks    = (TSC_ADC_CLKS + (delay & 0x3FFFF) + (delay >> 24)) * avg;
+
+  return clks * (p_ctx->reg[REG_CLKDIV / 4] + 1) * PRU_CLOCK_HZ / TSC_ADC_CLK_HZ;
+}
+
+/***********************************************************************
+ * @fn      tsc_next_step
+ *
+ * @brief   Next enabled step after 'step' (-1 if none)
+ *
+ * @param   p_ctx
+ *          step
+ *
+ * @return
+ */
+static int tsc_next_step(tsc_ctx_t *p_ctx, int step)
+{
+  uint32_t enable = (p_ctx->reg[REG_STEPENABLE / 4] >> 1) & 0xFFFF;
+  int i = 0;
+
+  for ( i = 1; i <= 16; i++ )
+  {
+    int s = (step + i) & 15;
+    if ( enable & (1u << s) )
+    {
+      return s;
+    }
+  }
+
+  return -1;
+}
+
+/***********************************************************************
+ * @fn      tsc_advance
+ *
+ * @brief   Run conversions up to 'now'
+ *
+ * @param   p_dev
+ *          now
+ *
+ * @return  none
+ */
+static void tsc_advance(pru_periph_t *p_dev, uint64_t now)
+{
+  tsc_ctx_t *p_ctx = p_dev->ctx;
+
+  while ( p_ctx->running && p_ctx->next_conv <= (double)now )
+  {
+    uint32_t cfg = p_ctx->reg[(REG_STEPCONFIG1 + 8 * p_ctx->step) / 4];
+    int ch = (cfg >> 19) & 0xF;
+    int32_t code = signal_code(&p_ctx->signal, p_ctx->next_conv / PRU_CLOCK_HZ,
+                               p_ctx->index[ch & 7]++, ch, 12, 0);
+    uint32_t word = (uint32_t)code & 0xFFF;
+    int next = 0;
+
+    if ( p_ctx->reg[REG_CTRL / 4] & 0x02 )
+    {
+      word |= (uint32_t)p_ctx->step << 16;
+    }
+
+    /* FIFO1 is not modelled: every step feeds FIFO0 */
+    if ( p_ctx->fifo_count < TSC_FIFO_DEPTH )
+    {
+      p_ctx->fifo[(p_ctx->fifo_head + p_ctx->fifo_count) % TSC_FIFO_DEPTH] = word;
+      p_ctx->fifo_count++;
+      if ( p_ctx->fifo_count > p_ctx->max_fill )
+      {
+        p_ctx->max_fill = p_ctx->fifo_count;
+      }
+    }
+    else
+    {
+      p_ctx->reg[REG_IRQSTATUS_RAW / 4] |= IRQ_FIFO0_OVERRUN;
+      p_ctx->dropped++;
+    }
+    if ( p_ctx->fifo_count > p_ctx->reg[REG_FIFO0THRESHOLD / 4] )
+    {
+      p_ctx->reg[REG_IRQSTATUS_RAW / 4] |= IRQ_FIFO0_THRESHOLD;
+    }
+    if ( p_ctx->conversions == 0 )
+    {
+      p_ctx->first_conv = p_ctx->next_conv;
+    }
+    p_ctx->last_conv = p_ctx->next_conv;
+    p_ctx->conversions++;
+
+    /* One-shot steps disable themselves */
+    if ( (cfg & 0x3) == 0 || (cfg & 0x3) == 2 )
+    {
+      p_ctx->reg[REG_STEPENABLE / 4] &= ~(1u << (p_ctx->step + 1));
+    }
+
+    next = tsc_next_step(p_ctx, p_ctx->step);
+    if ( next <= p_ctx->step )
+    {
+      p_ctx->reg[REG_IRQSTATUS_RAW / 4] |= IRQ_END_OF_SEQUENCE;
+    }
+    if ( next < 0 )
+    {
+      p_ctx->running = 0;
+      break;
+    }
+    p_ctx->step = next;
+    p_ctx->next_conv += tsc_step_cycles(p_ctx, next);
+  }
+}
+
+/***********************************************************************
+ * @fn      tsc_start
+ *
+ * @brief   (Re)start the sequencer if the module is enabled
+ *
+ * @param   p_ctx
+ *          now
+ *
+ * @return  none
+ */
+static void tsc_start(tsc_ctx_t *p_ctx, uint64_t now)
+{
+  int step = 0;
+
+  if ( p_ctx->running || !(p_ctx->reg[REG_CTRL / 4] & 0x01) )
+  {
+    return;
+  }
+
+  step = tsc_next_step(p_ctx, 15);
+  if ( step < 0 )
+  {
+    return;
+  }
+
+  p_ctx->running   = 1;
+  p_ctx->step      = step;
+  p_ctx->next_conv = (double)now + tsc_step_cycles(p_ctx, step);
+}
+
+/***********************************************************************
+ * @fn      tsc_read
+ *
+ * @brief
+ *
+ * @return  0 on success, -1 on bad access
+ */
+static int tsc_read(pru_periph_t *p_dev, uint32_t off, uint8_t *buf, uint32_t len, uint64_t now)
+{
+  tsc_ctx_t *p_ctx = p_dev->ctx;
+  uint32_t val = 0;
+  uint32_t i = 0;
+
+  if ( (off & 3) != 0 || len > 4 )
+  {
+    return -1;
+  }
+
+  if ( off >= REG_FIFO0DATA && off < REG_FIFO1DATA )
+  {
+    if ( p_ctx->fifo_count > 0 )
+    {
+      val = p_ctx->fifo[p_ctx->fifo_head];
+      p_ctx->fifo_head = (p_ctx->fifo_head + 1) % TSC_FIFO_DEPTH;
+      p_ctx->fifo_count--;
+      p_ctx->popped++;
+    }
+    else
+    {
+      p_ctx->reg[REG_IRQSTATUS_RAW / 4] |= IRQ_FIFO0_UNDERFLOW;
+      p_ctx->underflows++;
+    }
+    if ( p_ctx->fifo_count <= p_ctx->reg[REG_FIFO0THRESHOLD / 4] )
+    {
+      p_ctx->reg[REG_IRQSTATUS_RAW / 4] &= ~IRQ_FIFO0_THRESHOLD;
+    }
+  }
+  else if ( off == REG_IRQSTATUS )
+  {
+    val = p_ctx->reg[REG_IRQSTATUS_RAW / 4] & p_ctx->reg[REG_IRQENABLE_SET / 4];
+  }
+  else if ( off == REG_IRQENABLE_CLR )
+  {
+    val = p_ctx->reg[REG_IRQENABLE_SET / 4];
+  }
+  else if ( off == REG_FIFO0COUNT )
+  {
+    val = p_ctx->fifo_count;
+  }
+  else if ( off == REG_FIFO1COUNT )
+  {
+    val = 0;
+  }
+  else if ( off == REG_ADCSTAT )
+  {
+    val = p_ctx->running ? (0x20 | (uint32_t)p_ctx->step) : 0x10;
+  }
+  else if ( off < REG_FIFO0DATA )
+  {
+    val = p_ctx->reg[off / 4];
+  }
+
+  for ( i = 0; i < len; i++ )
+  {
+    buf[i] = (uint8_t)(val >> (8 * i));
+  }
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      tsc_write
+ *
+ * @brief
+ *
+ * @return  0 on success, -1 on bad access
+ */
+static int tsc_write(pru_periph_t *p_dev, uint32_t off, const uint8_t *buf, uint32_t len, uint64_t now)
+{
+  tsc_ctx_t *p_ctx = p_dev->ctx;
+  uint32_t val = 0;
+  uint32_t i = 0;
+
+  if ( (off & 3) != 0 || len > 4 || off >= REG_FIFO0DATA )
+  {
+    return -1;
+  }
+
+  for ( i = 0; i < len; i++ )
+  {
+    val |= (uint32_t)buf[i] << (8 * i);
+  }
+
+  switch ( off )
+  {
+    case REG_IRQSTATUS:
+      /* Write 1 to clear; level conditions are re-evaluated */
+      p_ctx->reg[REG_IRQSTATUS_RAW / 4] &= ~val;
+      if ( p_ctx->fifo_count > p_ctx->reg[REG_FIFO0THRESHOLD / 4] )
+      {
+        p_ctx->reg[REG_IRQSTATUS_RAW / 4] |= IRQ_FIFO0_THRESHOLD;
+      }
+      break;
+
+    case REG_IRQSTATUS_RAW:
+      p_ctx->reg[REG_IRQSTATUS_RAW / 4] |= val;
+      break;
+
+    case REG_IRQENABLE_SET:
+      p_ctx->reg[REG_IRQENABLE_SET / 4] |= val;
+      break;
+
+    case REG_IRQENABLE_CLR:
+      p_ctx->reg[REG_IRQENABLE_SET / 4] &= ~val;
+      break;
+
+    case REG_CTRL:
+      p_ctx->reg[REG_CTRL / 4] = val;
+      if ( !(val & 0x01) )
+      {
+        /* Disabling the module stops the sequencer and flushes the FIFO */
+        p_ctx->running    = 0;
+        p_ctx->fifo_count = 0;
+      }
+      else
+      {
+        tsc_start(p_ctx, now);
+      }
+      break;
+
+    case REG_STEPENABLE:
+      p_ctx->reg[REG_STEPENABLE / 4] = val;
+      tsc_start(p_ctx, now);
+      break;
+
+    default:
+      p_ctx->reg[off / 4] = val;
+      break;
+  }
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      tsc_report
+ *
+ * @brief
+ *
+ * @return  none
+ */
+static void tsc_report(pru_periph_t *p_dev, FILE *fp, uint64_t now)
+{
+  tsc_ctx_t *p_ctx = p_dev->ctx;
+  double span = (p_ctx->last_conv - p_ctx->first_conv) / PRU_CLOCK_HZ;
+
+  fprintf(fp, "TSC_ADC:\n");
+  fprintf(fp, "\tConversions:   %llu\n", (unsigned long long)p_ctx->conversions);
+  fprintf(fp, "\tRead by PRU:   %llu\n", (unsigned long long)p_ctx->popped);
+  fprintf(fp, "\tFIFO overrun:  %llu samples lost\n", (unsigned long long)p_ctx->dropped);
+  fprintf(fp, "\tFIFO underrun: %llu reads\n", (unsigned long long)p_ctx->underflows);
+  fprintf(fp, "\tFIFO max fill: %llu / %d\n", (unsigned long long)p_ctx->max_fill, TSC_FIFO_DEPTH);
+  if ( span > 0 && p_ctx->conversions > 1 )
+  {
+    fprintf(fp, "\tSample rate:   %.1f SPS\n", (p_ctx->conversions - 1) / span);
+  }
+}
+
+/***********************************************************************
+ * @fn      tsc_check
+ *
+ * @brief   FIFO0 kept up with and the sampling rate reached
+ *
+ * @return  Number of failures
+ */
+static int tsc_check(pru_periph_t *p_dev, FILE *fp, double min_rate)
+{
+  tsc_ctx_t *p_ctx = p_dev->ctx;
+  double span = (p_ctx->last_conv - p_ctx->first_conv) / PRU_CLOCK_HZ;
+  double rate = (span > 0 && p_ctx->conversions > 1) ? (p_ctx->conversions - 1) / span : 0;
+  int failures = 0;
+
+  if ( p_ctx->dropped > 0 )
+  {
+    fprintf(fp, "FAIL: TSC_ADC FIFO overrun, %llu samples lost\n", (unsigned long long)p_ctx->dropped);
+    failures++;
+  }
+  if ( p_ctx->popped == 0 || rate < min_rate )
+  {
+    fprintf(fp, "FAIL: TSC_ADC %.1f SPS, %llu read, expected %.1f SPS\n",
+            rate, (unsigned long long)p_ctx->popped, min_rate);
+    failures++;
+  }
+
+  return failures;
+}
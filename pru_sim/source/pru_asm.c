@@ -0,0 +1,1632 @@
+/***********************************************************************
+ * INCLUDES
+ **/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <stdint.h>
+#include "pru_asm.h"
+
+/***********************************************************************
+ * DEFINES
+ **/
+#define MAX_SRC_LINES     16384
+#define MAX_MACROS        64
+#define MAX_MACRO_LINES   128
+#define MAX_MACRO_PARAMS  8
+#define MAX_IF_DEPTH      16
+#define MAX_INCLUDE_DEPTH 8
+
+/***********************************************************************
+ * TYPEDEFS
+ **/
+typedef struct src_line_t
+{
+  char     text[ASM_MAX_LINE];
+  uint16_t file;
+  uint16_t line;
+} src_line_t;
+
+typedef struct define_t
+{
+  char name[ASM_MAX_NAME];
+  char value[ASM_MAX_LINE];
+} define_t;
+
+typedef struct macro_t
+{
+  char       name[ASM_MAX_NAME];
+  char       param[MAX_MACRO_PARAMS][ASM_MAX_NAME];
+  int        num_params;
+  src_line_t body[MAX_MACRO_LINES];
+  int        num_lines;
+} macro_t;
+
+typedef struct mnemonic_t
+{
+  const char *name;
+  asm_op_t    op;
+} mnemonic_t;
+
+/***********************************************************************
+ * GLOBALS
+ **/
+static define_t   DEFINES[ASM_MAX_DEFINES];
+static int        NUM_DEFINES = 0;
+
+static src_line_t SRC[MAX_SRC_LINES];
+static int        NUM_SRC = 0;
+
+static src_line_t EXP[MAX_SRC_LINES];
+static int        NUM_EXP = 0;
+
+static macro_t    MACROS[MAX_MACROS];
+static int        NUM_MACROS = 0;
+
+static asm_program_t *PROG = NULL;
+
+static const mnemonic_t MNEMONICS[] =
+{
+  {"ADD", OP_ADD},   {"ADC", OP_ADC},   {"SUB", OP_SUB},   {"SUC", OP_SUC},
+  {"RSB", OP_RSB},   {"RSC", OP_RSC},   {"LSL", OP_LSL},   {"LSR", OP_LSR},
+  {"AND", OP_AND},   {"OR",  OP_OR},    {"XOR", OP_XOR},   {"NOT", OP_NOT},
+  {"MIN", OP_MIN},   {"MAX", OP_MAX},   {"CLR", OP_CLR},   {"SET", OP_SET},
+  {"LMBD", OP_LMBD}, {"MOV", OP_MOV},   {"LDI", OP_LDI},   {"ZERO", OP_ZERO},
+  {"FILL", OP_FILL}, {"LBBO", OP_LBBO}, {"SBBO", OP_SBBO}, {"LBCO", OP_LBCO},
+  {"SBCO", OP_SBCO}, {"XIN", OP_XIN},   {"XOUT", OP_XOUT}, {"XCHG", OP_XCHG},
+  {"QBA", OP_QBA},   {"QBGT", OP_QBGT}, {"QBGE", OP_QBGE}, {"QBLT", OP_QBLT},
+  {"QBLE", OP_QBLE}, {"QBEQ", OP_QBEQ}, {"QBNE", OP_QBNE}, {"QBBS", OP_QBBS},
+  {"QBBC", OP_QBBC}, {"WBS", OP_WBS},   {"WBC", OP_WBC},   {"JMP", OP_JMP},
+  {"JAL", OP_JAL},   {"CALL", OP_CALL}, {"RET", OP_RET},   {"HALT", OP_HALT},
+  {"SLP", OP_SLP},   {"NOP", OP_NOP},
+  {NULL, OP_COUNT}
+};
+
+/***********************************************************************
+ * PRIVATE FUNCTIONS PROTOTYPES
+ **/
+static int  asm_error(uint16_t file, uint16_t line, const char *msg, const char *arg);
+static void asm_strip(char *s);
+static void asm_strip_comment(char *s);
+static int  asm_is_ident_char(char c);
+static const char *asm_get_define(const char *name);
+static int  asm_substitute(char *s);
+static int  asm_read_file(const char *file_name, int depth);
+static int  asm_expand_macros(void);
+static int  asm_expand_line(const src_line_t *p_src, int depth);
+static int  asm_parse_reg(const char *s, asm_operand_t *p_opnd);
+static int  asm_eval(const char *s, uint32_t *p_val);
+static int  asm_parse_operand(const char *s, asm_operand_t *p_opnd);
+static int  asm_split_operands(char *s, char out[][ASM_MAX_LINE], int max);
+static int  asm_assemble(int pass);
+static asm_op_t asm_find_mnemonic(const char *s);
+
+/***********************************************************************
+ * FUNCTIONS
+ **/
+/***********************************************************************
+ * @fn      asm_add_define
+ *
+ * @brief   Add (or replace) a preprocessor symbol, like 'pasm -D'
+ *
+ * @param   name
+ *          value
+ *
+ * @return  none
+ */
+void asm_add_define(const char *name, const char *value)
+{
+  int i = 0;
+
+  for ( i = 0; i < NUM_DEFINES; i++ )
+  {
+    if ( strcmp(DEFINES[i].name, name) == 0 )
+    {
+      break;
+    }
+  }
+  if ( i == NUM_DEFINES )
+  {
+    if ( NUM_DEFINES >= ASM_MAX_DEFINES )
+    {
+      return;
+    }
+    NUM_DEFINES++;
+  }
+
+  snprintf(DEFINES[i].name, ASM_MAX_NAME, "%s", name);
+  snprintf(DEFINES[i].value, ASM_MAX_LINE, "%s", value ? value : "");
+}
+
+/***********************************************************************
+ * @fn      asm_load
+ *
+ * @brief   Preprocess and assemble a PASM source file
+ *
+ * @param   p_prog - Output program
+ *          file_name
+ *
+ * @return  0 on success, -1 on error
+ */
+int asm_load(asm_program_t *p_prog, const char *file_name)
+{
+  int num_defines = NUM_DEFINES;
+  int res = 0;
+
+  memset(p_prog, 0, sizeof(asm_program_t));
+  p_prog->callreg.kind  = OPND_REG;
+  p_prog->callreg.reg   = 30;
+  p_prog->callreg.shift = 0;
+  p_prog->callreg.width = 16;
+  PROG = p_prog;
+
+  NUM_SRC = 0;
+  NUM_EXP = 0;
+  NUM_MACROS = 0;
+
+  /* Pass 1: labels, Pass 2: operands */
+  if ( asm_read_file(file_name, 0) < 0 || asm_expand_macros() < 0 || asm_assemble(1) < 0 || asm_assemble(2) < 0 )
+  {
+    res = -1;
+  }
+
+  /* The file's own #defines don't leak into the next program */
+  NUM_DEFINES = num_defines;
+
+  return res;
+}
+
+/***********************************************************************
+ * @fn      asm_find_label
+ *
+ * @brief
+ *
+ * @param   p_prog
+ *          name
+ *          p_addr
+ *
+ * @return  0 if found, -1 otherwise
+ */
+int asm_find_label(const asm_program_t *p_prog, const char *name, uint32_t *p_addr)
+{
+  uint32_t i = 0;
+
+  for ( i = 0; i < p_prog->num_labels; i++ )
+  {
+    if ( strcmp(p_prog->label[i].name, name) == 0 )
+    {
+      *p_addr = p_prog->label[i].addr;
+      return 0;
+    }
+  }
+
+  return -1;
+}
+
+/***********************************************************************
+ * @fn      asm_label_at
+ *
+ * @brief   Closest label at or before a code address
+ *
+ * @param   p_prog
+ *          addr
+ *
+ * @return  Label name or "?"
+ */
+const char *asm_label_at(const asm_program_t *p_prog, uint32_t addr)
+{
+  const char *name = "?";
+  uint32_t best = 0;
+  uint32_t i = 0;
+
+  for ( i = 0; i < p_prog->num_labels; i++ )
+  {
+    if ( p_prog->label[i].addr <= addr && p_prog->label[i].addr >= best &&
+         strstr(p_prog->label[i].name, "__m") == NULL )
+    {
+      best = p_prog->label[i].addr;
+      name = p_prog->label[i].name;
+    }
+  }
+
+  return name;
+}
+
+/***********************************************************************
+ * @fn      asm_op_name
+ *
+ * @brief
+ *
+ * @param   op
+ *
+ * @return  Mnemonic string
+ */
+const char *asm_op_name(asm_op_t op)
+{
+  int i = 0;
+
+  for ( i = 0; MNEMONICS[i].name != NULL; i++ )
+  {
+    if ( MNEMONICS[i].op == op )
+    {
+      return MNEMONICS[i].name;
+    }
+  }
+
+  return "???";
+}
+
+/***********************************************************************
+ * PRIVATE FUNCTIONS
+ **/
+/***********************************************************************
+ * @fn      asm_error
+ *
+ * @brief
+ *
+ * @param   file
+ *          line
+ *          msg
+ *          arg
+ *
+ * @return  -1
+ */
+static int asm_error(uint16_t file, uint16_t line, const char *msg, const char *arg)
+{
+  fprintf(stderr, "%s:%u: error: %s%s%s\n",
+          PROG->file_name[file], line, msg, arg ? ": " : "", arg ? arg : "");
+  return -1;
+}
+
+/***********************************************************************
+ * @fn      asm_strip
+ *
+ * @brief   Remove leading and trailing white spaces
+ *
+ * @param   s
+ *
+ * @return  none
+ */
+static void asm_strip(char *s)
+{
+  char *p = s;
+  size_t len = 0;
+
+  while ( *p && isspace((unsigned char)*p) )
+  {
+    p++;
+  }
+  memmove(s, p, strlen(p) + 1);
+
+  len = strlen(s);
+  while ( len > 0 && isspace((unsigned char)s[len - 1]) )
+  {
+    s[--len] = '\0';
+  }
+}
+
+/***********************************************************************
+ * @fn      asm_strip_comment
+ *
+ * @brief   Remove ';' and '//' comments
+ *
+ * @param   s
+ *
+ * @return  none
+ */
+static void asm_strip_comment(char *s)
+{
+  char *p = NULL;
+
+  p = strchr(s, ';');
+  if ( p != NULL )
+  {
+    *p = '\0';
+  }
+
+  p = strstr(s, "//");
+  if ( p != NULL )
+  {
+    *p = '\0';
+  }
+
+  asm_strip(s);
+}
+
+/***********************************************************************
+ * @fn      asm_is_ident_char
+ *
+ * @brief
+ *
+ * @param   c
+ *
+ * @return
+ */
+static int asm_is_ident_char(char c)
+{
+  return isalnum((unsigned char)c) || c == '_';
+}
+
+/***********************************************************************
+ * @fn      asm_get_define
+ *
+ * @brief
+ *
+ * @param   name
+ *
+ * @return  Define value or NULL
+ */
+static const char *asm_get_define(const char *name)
+{
+  int i = 0;
+
+  for ( i = 0; i < NUM_DEFINES; i++ )
+  {
+    if ( strcmp(DEFINES[i].name, name) == 0 )
+    {
+      return DEFINES[i].value;
+    }
+  }
+
+  return NULL;
+}
+
+/***********************************************************************
+ * @fn      asm_substitute
+ *
+ * @brief   Replace defined identifiers (whole tokens) by their values
+ *
+ * @param   s - Line (modified in place, ASM_MAX_LINE bytes)
+ *
+ * @return  0 on success, -1 on recursion/overflow
+ */
+static int asm_substitute(char *s)
+{
+  char out[ASM_MAX_LINE];
+  char name[ASM_MAX_NAME];
+  int pass = 0;
+  int changed = 1;
+
+  for ( pass = 0; changed && pass < 16; pass++ )
+  {
+    const char *p = s;
+    size_t o = 0;
+
+    changed = 0;
+    while ( *p )
+    {
+      if ( (isalpha((unsigned char)*p) || *p == '_') &&
+           (p == s || !(asm_is_ident_char(p[-1]) || p[-1] == '.')) )
+      {
+        size_t n = 0;
+        const char *value = NULL;
+
+        while ( asm_is_ident_char(p[n]) && n < ASM_MAX_NAME - 1 )
+        {
+          name[n] = p[n];
+          n++;
+        }
+        name[n] = '\0';
+
+        value = asm_get_define(name);
+        if ( value != NULL )
+        {
+          size_t len = strlen(value);
+          if ( o + len >= ASM_MAX_LINE )
+          {
+            return -1;
+          }
+          memcpy(&out[o], value, len);
+          o += len;
+          changed = 1;
+        }
+        else
+        {
+          if ( o + n >= ASM_MAX_LINE )
+          {
+            return -1;
+          }
+          memcpy(&out[o], name, n);
+          o += n;
+        }
+        p += n;
+        while ( asm_is_ident_char(*p) )
+        {
+          p++;
+        }
+      }
+      else
+      {
+        if ( o + 1 >= ASM_MAX_LINE )
+        {
+          return -1;
+        }
+        out[o++] = *p++;
+      }
+    }
+    out[o] = '\0';
+    strcpy(s, out);
+  }
+
+  return changed ? -1 : 0;
+}
+
+/***********************************************************************
+ * @fn      asm_read_file
+ *
+ * @brief   Read a source file handling the '#' preprocessor directives
+ *
+ * @param   file_name
+ *          depth - Include depth
+ *
+ * @return  0 on success, -1 on error
+ */
+static int asm_read_file(const char *file_name, int depth)
+{
+  char buf[ASM_MAX_LINE];
+  int  active[MAX_IF_DEPTH];
+  int  if_depth = 0;
+  uint16_t file = 0;
+  uint16_t line = 0;
+  FILE *fp = NULL;
+
+  if ( depth > MAX_INCLUDE_DEPTH || PROG->num_files >= 16 )
+  {
+    fprintf(stderr, "%s: too many nested includes\n", file_name);
+    return -1;
+  }
+
+  fp = fopen(file_name, "rt");
+  if ( fp == NULL )
+  {
+    fprintf(stderr, "fopen(%s):", file_name);
+    perror("");
+    return -1;
+  }
+
+  file = PROG->num_files++;
+  snprintf(PROG->file_name[file], sizeof(PROG->file_name[file]), "%s", file_name);
+
+  while ( fgets(buf, sizeof(buf), fp) != NULL )
+  {
+    int enabled = 1;
+    int i = 0;
+
+    line++;
+    asm_strip_comment(buf);
+    if ( buf[0] == '\0' )
+    {
+      continue;
+    }
+
+    for ( i = 0; i < if_depth; i++ )
+    {
+      enabled &= active[i];
+    }
+
+    if ( buf[0] == '#' )
+    {
+      char directive[ASM_MAX_NAME] = "";
+      char name[ASM_MAX_NAME] = "";
+      char *rest = NULL;
+
+      sscanf(buf + 1, "%63s %63s", directive, name);
+
+      if ( strcmp(directive, "ifdef") == 0 || strcmp(directive, "ifndef") == 0 )
+      {
+        int defined = (asm_get_define(name) != NULL);
+        if ( if_depth >= MAX_IF_DEPTH )
+        {
+          fclose(fp);
+          return asm_error(file, line, "#if nesting too deep", NULL);
+        }
+        active[if_depth++] = (directive[2] == 'd') ? defined : !defined;
+      }
+      else if ( strcmp(directive, "else") == 0 )
+      {
+        if ( if_depth == 0 )
+        {
+          fclose(fp);
+          return asm_error(file, line, "#else without #if", NULL);
+        }
+        active[if_depth - 1] = !active[if_depth - 1];
+      }
+      else if ( strcmp(directive, "endif") == 0 )
+      {
+        if ( if_depth == 0 )
+        {
+          fclose(fp);
+          return asm_error(file, line, "#endif without #if", NULL);
+        }
+        if_depth--;
+      }
+      else if ( !enabled )
+      {
+        continue;
+      }
+      else if ( strcmp(directive, "define") == 0 )
+      {
+        rest = strstr(buf, name) + strlen(name);
+        asm_strip(rest);
+        asm_add_define(name, rest);
+      }
+      else if ( strcmp(directive, "undef") == 0 )
+      {
+        int j = 0;
+        for ( j = 0; j < NUM_DEFINES; j++ )
+        {
+          if ( strcmp(DEFINES[j].name, name) == 0 )
+          {
+            DEFINES[j] = DEFINES[--NUM_DEFINES];
+            break;
+          }
+        }
+      }
+      else if ( strcmp(directive, "include") == 0 )
+      {
+        char path[512];
+        const char *slash = strrchr(file_name, '/');
+        char *q = strchr(buf, '"');
+        char *e = (q != NULL) ? strchr(q + 1, '"') : NULL;
+
+        if ( q == NULL || e == NULL )
+        {
+          fclose(fp);
+          return asm_error(file, line, "bad #include", buf);
+        }
+        *e = '\0';
+        if ( slash != NULL && q[1] != '/' )
+        {
+          snprintf(path, sizeof(path), "%.*s/%s", (int)(slash - file_name), file_name, q + 1);
+        }
+        else
+        {
+          snprintf(path, sizeof(path), "%s", q + 1);
+        }
+        if ( asm_read_file(path, depth + 1) < 0 )
+        {
+          fclose(fp);
+          return -1;
+        }
+      }
+      else
+      {
+        fclose(fp);
+        return asm_error(file, line, "unknown directive", buf);
+      }
+      continue;
+    }
+
+    if ( !enabled )
+    {
+      continue;
+    }
+
+    if ( NUM_SRC >= MAX_SRC_LINES )
+    {
+      fclose(fp);
+      return asm_error(file, line, "source too long", NULL);
+    }
+
+    if ( asm_substitute(buf) < 0 )
+    {
+      fclose(fp);
+      return asm_error(file, line, "recursive #define", buf);
+    }
+    snprintf(SRC[NUM_SRC].text, ASM_MAX_LINE, "%s", buf);
+    SRC[NUM_SRC].file = file;
+    SRC[NUM_SRC].line = line;
+    NUM_SRC++;
+  }
+
+  fclose(fp);
+
+  if ( if_depth != 0 )
+  {
+    return asm_error(file, line, "missing #endif", NULL);
+  }
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      asm_expand_macros
+ *
+ * @brief   Collect '.macro' blocks and expand their invocations
+ *
+ * @param   none
+ *
+ * @return  0 on success, -1 on error
+ */
+static int asm_expand_macros(void)
+{
+  macro_t *p_macro = NULL;
+  int i = 0;
+
+  for ( i = 0; i < NUM_SRC; i++ )
+  {
+    const char *s = SRC[i].text;
+
+    if ( strncasecmp(s, ".macro", 6) == 0 && isspace((unsigned char)s[6]) )
+    {
+      if ( NUM_MACROS >= MAX_MACROS )
+      {
+        return asm_error(SRC[i].file, SRC[i].line, "too many macros", NULL);
+      }
+      p_macro = &MACROS[NUM_MACROS++];
+      memset(p_macro, 0, sizeof(macro_t));
+      sscanf(s + 6, "%63s", p_macro->name);
+    }
+    else if ( strncasecmp(s, ".mparam", 7) == 0 && p_macro != NULL )
+    {
+      char params[ASM_MAX_LINE];
+      char *tok = NULL;
+
+      snprintf(params, sizeof(params), "%s", s + 7);
+      for ( tok = strtok(params, ", \t"); tok != NULL; tok = strtok(NULL, ", \t") )
+      {
+        if ( p_macro->num_params < MAX_MACRO_PARAMS )
+        {
+          char *eq = strchr(tok, '=');
+          if ( eq != NULL )
+          {
+            *eq = '\0';
+          }
+          snprintf(p_macro->param[p_macro->num_params++], ASM_MAX_NAME, "%s", tok);
+        }
+      }
+    }
+    else if ( strncasecmp(s, ".endm", 5) == 0 )
+    {
+      p_macro = NULL;
+    }
+    else if ( p_macro != NULL )
+    {
+      if ( p_macro->num_lines >= MAX_MACRO_LINES )
+      {
+        return asm_error(SRC[i].file, SRC[i].line, "macro too long", p_macro->name);
+      }
+      p_macro->body[p_macro->num_lines++] = SRC[i];
+    }
+    else if ( asm_expand_line(&SRC[i], 0) < 0 )
+    {
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      asm_expand_line
+ *
+ * @brief   Copy a line to the expanded source, expanding macro calls.
+ *          Labels declared inside a macro get a unique suffix per call.
+ *
+ * @param   p_src
+ *          depth
+ *
+ * @return  0 on success, -1 on error
+ */
+static int asm_expand_line(const src_line_t *p_src, int depth)
+{
+  static int expansion = 0;
+  char word[ASM_MAX_NAME] = "";
+  int m = 0;
+
+  sscanf(p_src->text, "%63[A-Za-z0-9_]", word);
+
+  for ( m = 0; m < NUM_MACROS; m++ )
+  {
+    if ( strcasecmp(MACROS[m].name, word) == 0 )
+    {
+      break;
+    }
+  }
+
+  if ( m == NUM_MACROS || p_src->text[strlen(word)] == ':' )
+  {
+    if ( NUM_EXP >= MAX_SRC_LINES )
+    {
+      return asm_error(p_src->file, p_src->line, "source too long", NULL);
+    }
+    EXP[NUM_EXP++] = *p_src;
+    return 0;
+  }
+
+  if ( depth > 8 )
+  {
+    return asm_error(p_src->file, p_src->line, "macro recursion", word);
+  }
+
+  {
+    macro_t *p_macro = &MACROS[m];
+    char args[ASM_MAX_LINE];
+    char arg[MAX_MACRO_PARAMS][ASM_MAX_LINE];
+    char labels[32][ASM_MAX_NAME];
+    int num_labels = 0;
+    int num_args = 0;
+    int i = 0;
+    int id = expansion++;
+
+    snprintf(args, sizeof(args), "%s", p_src->text + strlen(word));
+    num_args = asm_split_operands(args, arg, MAX_MACRO_PARAMS);
+
+    /* Labels declared by the macro body */
+    for ( i = 0; i < p_macro->num_lines && num_labels < 32; i++ )
+    {
+      char name[ASM_MAX_NAME] = "";
+      if ( sscanf(p_macro->body[i].text, "%63[A-Za-z0-9_]", name) == 1 &&
+           p_macro->body[i].text[strlen(name)] == ':' )
+      {
+        snprintf(labels[num_labels++], ASM_MAX_NAME, "%s", name);
+      }
+    }
+
+    for ( i = 0; i < p_macro->num_lines; i++ )
+    {
+      src_line_t out = p_macro->body[i];
+      char buf[ASM_MAX_LINE];
+      const char *p = p_macro->body[i].text;
+      size_t o = 0;
+
+      /* Replace parameters and local labels, token by token */
+      while ( *p && o < ASM_MAX_LINE - 1 )
+      {
+        if ( isalpha((unsigned char)*p) || *p == '_' )
+        {
+          char name[ASM_MAX_NAME];
+          size_t n = 0;
+          int j = 0;
+          int done = 0;
+
+          while ( asm_is_ident_char(p[n]) && n < ASM_MAX_NAME - 1 )
+          {
+            name[n] = p[n];
+            n++;
+          }
+          name[n] = '\0';
+          p += n;
+
+          for ( j = 0; j < p_macro->num_params && !done; j++ )
+          {
+            if ( strcmp(p_macro->param[j], name) == 0 && j < num_args )
+            {
+              o += snprintf(&buf[o], ASM_MAX_LINE - o, "%s", arg[j]);
+              done = 1;
+            }
+          }
+          for ( j = 0; j < num_labels && !done; j++ )
+          {
+            if ( strcmp(labels[j], name) == 0 )
+            {
+              o += snprintf(&buf[o], ASM_MAX_LINE - o, "%s__m%d", name, id);
+              done = 1;
+            }
+          }
+          if ( !done )
+          {
+            o += snprintf(&buf[o], ASM_MAX_LINE - o, "%s", name);
+          }
+        }
+        else
+        {
+          buf[o++] = *p++;
+        }
+      }
+      buf[o] = '\0';
+
+      snprintf(out.text, ASM_MAX_LINE, "%s", buf);
+      if ( asm_expand_line(&out, depth + 1) < 0 )
+      {
+        return -1;
+      }
+    }
+  }
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      asm_split_operands
+ *
+ * @brief   Split a comma separated list (commas inside '()' are kept)
+ *
+ * @param   s
+ *          out
+ *          max
+ *
+ * @return  Number of operands
+ */
+static int asm_split_operands(char *s, char out[][ASM_MAX_LINE], int max)
+{
+  int n = 0;
+  int level = 0;
+  size_t o = 0;
+  char *p = s;
+
+  asm_strip(s);
+  if ( *s == '\0' )
+  {
+    return 0;
+  }
+
+  for ( p = s; ; p++ )
+  {
+    if ( *p == '(' )
+    {
+      level++;
+    }
+    else if ( *p == ')' )
+    {
+      level--;
+    }
+
+    if ( *p == '\0' || (*p == ',' && level == 0) )
+    {
+      if ( n < max )
+      {
+        out[n][o] = '\0';
+        asm_strip(out[n]);
+        n++;
+      }
+      o = 0;
+      if ( *p == '\0' )
+      {
+        break;
+      }
+      continue;
+    }
+
+    if ( n < max && o < ASM_MAX_LINE - 1 )
+    {
+      out[n][o++] = *p;
+    }
+  }
+
+  return n;
+}
+
+/***********************************************************************
+ * @fn      asm_parse_reg
+ *
+ * @brief   Parse r<N>[.w<0-2>|.b<0-3>]*[.t<0-31>]
+ *
+ * @param   s
+ *          p_opnd
+ *
+ * @return  0 if s is a register, -1 otherwise
+ */
+static int asm_parse_reg(const char *s, asm_operand_t *p_opnd)
+{
+  const char *p = s;
+  char *end = NULL;
+  long reg = 0;
+  int shift = 0;
+  int width = 32;
+
+  memset(p_opnd, 0, sizeof(asm_operand_t));
+  if ( *p == '&' )
+  {
+    p_opnd->indirect = 1;
+    p++;
+  }
+
+  /* 'b0'..'b3' alone: r0.bN (used as byte count) */
+  if ( (p[0] == 'b' || p[0] == 'B') && p[1] >= '0' && p[1] <= '3' && p[2] == '\0' )
+  {
+    p_opnd->kind  = OPND_REG;
+    p_opnd->reg   = 0;
+    p_opnd->shift = (p[1] - '0') * 8;
+    p_opnd->width = 8;
+    return 0;
+  }
+
+  if ( (p[0] != 'r' && p[0] != 'R') || !isdigit((unsigned char)p[1]) )
+  {
+    return -1;
+  }
+
+  reg = strtol(p + 1, &end, 10);
+  if ( reg < 0 || reg > 31 )
+  {
+    return -1;
+  }
+  p = end;
+
+  p_opnd->kind = OPND_REG;
+  p_opnd->reg  = (uint8_t)reg;
+
+  while ( *p == '.' )
+  {
+    char sel = tolower((unsigned char)p[1]);
+    long idx = strtol(p + 2, &end, 10);
+
+    if ( end == p + 2 )
+    {
+      return -1;
+    }
+
+    if ( sel == 'w' && idx >= 0 && idx <= 2 && width >= 16 + idx * 8 )
+    {
+      shift += idx * 8;
+      width  = 16;
+    }
+    else if ( sel == 'b' && idx >= 0 && idx <= 3 && width >= 8 + idx * 8 )
+    {
+      shift += idx * 8;
+      width  = 8;
+    }
+    else if ( sel == 't' && idx >= 0 && idx < width )
+    {
+      p_opnd->kind  = OPND_BIT;
+      p_opnd->shift = shift;
+      p_opnd->width = (uint8_t)(shift + idx);
+      if ( *end != '\0' )
+      {
+        return -1;
+      }
+      return 0;
+    }
+    else
+    {
+      return -1;
+    }
+    p = end;
+  }
+
+  if ( *p != '\0' )
+  {
+    return -1;
+  }
+
+  p_opnd->shift = shift;
+  p_opnd->width = width;
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      asm_eval
+ *
+ * @brief   Evaluate a constant expression (C operators and precedence)
+ *
+ * @param   s
+ *          p_val
+ *
+ * @return  0 on success, -1 on syntax error
+ */
+typedef struct eval_t
+{
+  const char *p;
+  int error;
+} eval_t;
+
+static int64_t eval_expr(eval_t *e, int prec);
+
+static void eval_skip(eval_t *e)
+{
+  while ( isspace((unsigned char)*e->p) )
+  {
+    e->p++;
+  }
+}
+
+static int64_t eval_unary(eval_t *e)
+{
+  int64_t val = 0;
+
+  eval_skip(e);
+  if ( *e->p == '(' )
+  {
+    e->p++;
+    val = eval_expr(e, 0);
+    eval_skip(e);
+    if ( *e->p != ')' )
+    {
+      e->error = 1;
+      return 0;
+    }
+    e->p++;
+    return val;
+  }
+  if ( *e->p == '-' )
+  {
+    e->p++;
+    return -eval_unary(e);
+  }
+  if ( *e->p == '~' )
+  {
+    e->p++;
+    return ~eval_unary(e);
+  }
+  if ( *e->p == '+' )
+  {
+    e->p++;
+    return eval_unary(e);
+  }
+  if ( isdigit((unsigned char)*e->p) )
+  {
+    char *end = NULL;
+    if ( e->p[0] == '0' && (e->p[1] == 'b' || e->p[1] == 'B') )
+    {
+      val = strtoll(e->p + 2, &end, 2);
+    }
+    else
+    {
+      val = strtoll(e->p, &end, 0);
+    }
+    e->p = end;
+    return val;
+  }
+  if ( isalpha((unsigned char)*e->p) || *e->p == '_' )
+  {
+    char name[ASM_MAX_NAME];
+    size_t n = 0;
+    uint32_t addr = 0;
+
+    while ( asm_is_ident_char(e->p[n]) && n < ASM_MAX_NAME - 1 )
+    {
+      name[n] = e->p[n];
+      n++;
+    }
+    name[n] = '\0';
+    e->p += n;
+    if ( asm_find_label(PROG, name, &addr) == 0 )
+    {
+      return addr;
+    }
+  }
+
+  e->error = 1;
+  return 0;
+}
+
+static int eval_binop(eval_t *e, int *p_prec, int *p_len)
+{
+  static const struct { const char *s; int prec; } OPS[] =
+  {
+    {"<<", 5}, {">>", 5}, {"*", 7}, {"/", 7}, {"%", 7},
+    {"+", 6}, {"-", 6}, {"&", 3}, {"^", 2}, {"|", 1},
+    {NULL, 0}
+  };
+  int i = 0;
+
+  eval_skip(e);
+  for ( i = 0; OPS[i].s != NULL; i++ )
+  {
+    size_t len = strlen(OPS[i].s);
+    if ( strncmp(e->p, OPS[i].s, len) == 0 )
+    {
+      *p_prec = OPS[i].prec;
+      *p_len  = (int)len;
+      return OPS[i].s[0] + (len > 1 ? 256 : 0);
+    }
+  }
+
+  return 0;
+}
+
+static int64_t eval_expr(eval_t *e, int min_prec)
+{
+  int64_t lhs = eval_unary(e);
+
+  while ( !e->error )
+  {
+    int prec = 0;
+    int len = 0;
+    int op = eval_binop(e, &prec, &len);
+    int64_t rhs = 0;
+
+    if ( op == 0 || prec < min_prec )
+    {
+      break;
+    }
+    e->p += len;
+    rhs = eval_expr(e, prec + 1);
+
+    switch ( op )
+    {
+      case '<' + 256: lhs <<= rhs; break;
+      case '>' + 256: lhs = (int64_t)((uint64_t)lhs >> rhs); break;
+      case '*': lhs *= rhs; break;
+      case '/': lhs = rhs ? lhs / rhs : 0; e->error |= (rhs == 0); break;
+      case '%': lhs = rhs ? lhs % rhs : 0; e->error |= (rhs == 0); break;
+      case '+': lhs += rhs; break;
+      case '-': lhs -= rhs; break;
+      case '&': lhs &= rhs; break;
+      case '^': lhs ^= rhs; break;
+      case '|': lhs |= rhs; break;
+      default: e->error = 1; break;
+    }
+  }
+
+  return lhs;
+}
+
+static int asm_eval(const char *s, uint32_t *p_val)
+{
+  eval_t e;
+  int64_t val = 0;
+
+  e.p = s;
+  e.error = 0;
+  val = eval_expr(&e, 0);
+  eval_skip(&e);
+  if ( e.error || *e.p != '\0' )
+  {
+    return -1;
+  }
+
+  *p_val = (uint32_t)val;
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      asm_parse_operand
+ *
+ * @brief   Register, constant table entry, label or immediate
+ *
+ * @param   s
+ *          p_opnd
+ *
+ * @return  0 on success, -1 on error
+ */
+static int asm_parse_operand(const char *s, asm_operand_t *p_opnd)
+{
+  uint32_t val = 0;
+
+  if ( asm_parse_reg(s, p_opnd) == 0 )
+  {
+    return 0;
+  }
+
+  memset(p_opnd, 0, sizeof(asm_operand_t));
+
+  if ( (s[0] == 'c' || s[0] == 'C') && isdigit((unsigned char)s[1]) )
+  {
+    char *end = NULL;
+    long idx = strtol(s + 1, &end, 10);
+    if ( *end == '\0' && idx >= 0 && idx <= 31 )
+    {
+      p_opnd->kind  = OPND_CONST;
+      p_opnd->value = (uint32_t)idx;
+      return 0;
+    }
+  }
+
+  if ( asm_find_label(PROG, s, &val) == 0 )
+  {
+    p_opnd->kind  = OPND_LABEL;
+    p_opnd->value = val;
+    return 0;
+  }
+
+  if ( asm_eval(s, &val) == 0 )
+  {
+    p_opnd->kind  = OPND_IMM;
+    p_opnd->value = val;
+    return 0;
+  }
+
+  return -1;
+}
+
+/***********************************************************************
+ * @fn      asm_find_mnemonic
+ *
+ * @brief
+ *
+ * @param   s
+ *
+ * @return  Opcode or OP_COUNT
+ */
+static asm_op_t asm_find_mnemonic(const char *s)
+{
+  int i = 0;
+
+  for ( i = 0; MNEMONICS[i].name != NULL; i++ )
+  {
+    if ( strcasecmp(MNEMONICS[i].name, s) == 0 )
+    {
+      return MNEMONICS[i].op;
+    }
+  }
+
+  return OP_COUNT;
+}
+
+/***********************************************************************
+ * @fn      asm_check_op255
+ *
+ * @brief   ALU/branch second operand: register field or immediate 0..255
+ *
+ * @param   p_opnd
+ *
+ * @return  0 if valid
+ */
+static int asm_check_op255(const asm_operand_t *p_opnd)
+{
+  if ( p_opnd->kind == OPND_REG )
+  {
+    return 0;
+  }
+  if ( p_opnd->kind == OPND_IMM && p_opnd->value <= 255 )
+  {
+    return 0;
+  }
+
+  return -1;
+}
+
+/***********************************************************************
+ * @fn      asm_assemble
+ *
+ * @brief   Pass 1 collects labels and instruction addresses, pass 2
+ *          parses and validates operands
+ *
+ * @param   pass
+ *
+ * @return  0 on success, -1 on error
+ */
+static int asm_assemble(int pass)
+{
+  uint32_t addr = 0;
+  int i = 0;
+
+  for ( i = 0; i < NUM_EXP; i++ )
+  {
+    char text[ASM_MAX_LINE];
+    char mnem[ASM_MAX_NAME] = "";
+    char opnd_str[4][ASM_MAX_LINE];
+    char *p = text;
+    uint16_t file = EXP[i].file;
+    uint16_t line = EXP[i].line;
+    asm_insn_t insn;
+    int num = 0;
+    int k = 0;
+
+    snprintf(text, sizeof(text), "%.*s", (int)sizeof(text) - 1, EXP[i].text);
+
+    /* Labels */
+    for ( ;; )
+    {
+      char name[ASM_MAX_NAME] = "";
+      size_t n = 0;
+
+      while ( isspace((unsigned char)*p) )
+      {
+        p++;
+      }
+      while ( asm_is_ident_char(p[n]) && n < ASM_MAX_NAME - 1 )
+      {
+        name[n] = p[n];
+        n++;
+      }
+      name[n] = '\0';
+      if ( n == 0 || p[n] != ':' )
+      {
+        break;
+      }
+
+      if ( pass == 1 )
+      {
+        uint32_t dummy = 0;
+        if ( asm_find_label(PROG, name, &dummy) == 0 )
+        {
+          return asm_error(file, line, "duplicated label", name);
+        }
+        if ( PROG->num_labels >= ASM_MAX_LABELS )
+        {
+          return asm_error(file, line, "too many labels", NULL);
+        }
+        snprintf(PROG->label[PROG->num_labels].name, ASM_MAX_NAME, "%s", name);
+        PROG->label[PROG->num_labels].addr = addr;
+        PROG->num_labels++;
+      }
+      p += n + 1;
+    }
+
+    while ( isspace((unsigned char)*p) )
+    {
+      p++;
+    }
+    if ( *p == '\0' )
+    {
+      continue;
+    }
+
+    /* Directives */
+    if ( *p == '.' )
+    {
+      char arg[ASM_MAX_LINE] = "";
+      sscanf(p, "%63s %511[^\n]", mnem, arg);
+      asm_strip(arg);
+
+      if ( strcasecmp(mnem, ".origin") == 0 )
+      {
+        uint32_t val = 0;
+        if ( asm_eval(arg, &val) < 0 )
+        {
+          return asm_error(file, line, "bad .origin", arg);
+        }
+        addr = val;
+      }
+      else if ( strcasecmp(mnem, ".entrypoint") == 0 )
+      {
+        if ( pass == 2 && asm_find_label(PROG, arg, &PROG->entry) < 0 )
+        {
+          return asm_error(file, line, "undefined entry point", arg);
+        }
+      }
+      else if ( strcasecmp(mnem, ".setcallreg") == 0 )
+      {
+        if ( asm_parse_reg(arg, &PROG->callreg) < 0 || PROG->callreg.width != 16 )
+        {
+          return asm_error(file, line, "bad call register", arg);
+        }
+      }
+      else
+      {
+        return asm_error(file, line, "unsupported directive", mnem);
+      }
+      continue;
+    }
+
+    /* Instruction */
+    {
+      size_t n = 0;
+      while ( p[n] && !isspace((unsigned char)p[n]) && n < ASM_MAX_NAME - 1 )
+      {
+        mnem[n] = p[n];
+        n++;
+      }
+      mnem[n] = '\0';
+      p += n;
+    }
+
+    memset(&insn, 0, sizeof(insn));
+    insn.op   = asm_find_mnemonic(mnem);
+    insn.file = file;
+    insn.line = line;
+    if ( insn.op == OP_COUNT )
+    {
+      return asm_error(file, line, "unknown instruction", mnem);
+    }
+
+    num = asm_split_operands(p, opnd_str, 4);
+    insn.num_opnds = (uint8_t)num;
+
+    if ( pass == 1 )
+    {
+      /* MOV with a 32-bit immediate takes two instruction words */
+      uint32_t val = 0;
+      if ( insn.op == OP_MOV && num == 2 && asm_eval(opnd_str[1], &val) == 0 && val > 0xFFFF )
+      {
+        addr += 2;
+      }
+      else
+      {
+        addr += 1;
+      }
+      continue;
+    }
+
+    for ( k = 0; k < num; k++ )
+    {
+      if ( asm_parse_operand(opnd_str[k], &insn.opnd[k]) < 0 )
+      {
+        return asm_error(file, line, "bad operand", opnd_str[k]);
+      }
+    }
+
+    /* Operand validation */
+    switch ( insn.op )
+    {
+      case OP_ADD: case OP_ADC: case OP_SUB: case OP_SUC: case OP_RSB: case OP_RSC:
+      case OP_LSL: case OP_LSR: case OP_AND: case OP_OR:  case OP_XOR:
+      case OP_MIN: case OP_MAX:
+        if ( num != 3 || insn.opnd[0].kind != OPND_REG || insn.opnd[1].kind != OPND_REG ||
+             asm_check_op255(&insn.opnd[2]) < 0 )
+        {
+          return asm_error(file, line, "expected REG, REG, OP(255)", mnem);
+        }
+        break;
+
+      case OP_NOT:
+        if ( num != 2 || insn.opnd[0].kind != OPND_REG || insn.opnd[1].kind != OPND_REG )
+        {
+          return asm_error(file, line, "expected REG, REG", mnem);
+        }
+        break;
+
+      case OP_LMBD:
+        if ( num != 3 || insn.opnd[0].kind != OPND_REG || insn.opnd[1].kind != OPND_REG ||
+             asm_check_op255(&insn.opnd[2]) < 0 )
+        {
+          return asm_error(file, line, "expected REG, REG, OP(255)", mnem);
+        }
+        break;
+
+      case OP_CLR: case OP_SET:
+        /* CLR r.tN | CLR r, OP(31) | CLR r, r, OP(31) | CLR r, r.tN */
+        if ( num == 1 && insn.opnd[0].kind == OPND_BIT )
+        {
+          break;
+        }
+        if ( num == 2 && insn.opnd[0].kind == OPND_REG &&
+             (insn.opnd[1].kind == OPND_BIT || asm_check_op255(&insn.opnd[1]) == 0) )
+        {
+          break;
+        }
+        if ( num == 3 && insn.opnd[0].kind == OPND_REG && insn.opnd[1].kind == OPND_REG &&
+             asm_check_op255(&insn.opnd[2]) == 0 )
+        {
+          break;
+        }
+        return asm_error(file, line, "bad bit operands", mnem);
+
+      case OP_MOV:
+        if ( num != 2 || insn.opnd[0].kind != OPND_REG ||
+             (insn.opnd[1].kind != OPND_REG && insn.opnd[1].kind != OPND_IMM &&
+              insn.opnd[1].kind != OPND_LABEL) )
+        {
+          return asm_error(file, line, "expected REG, REG|IMM", mnem);
+        }
+        if ( insn.opnd[1].kind == OPND_LABEL )
+        {
+          insn.opnd[1].kind = OPND_IMM;
+        }
+        if ( insn.opnd[1].kind == OPND_IMM && insn.opnd[1].value > 0xFFFF )
+        {
+          /* Two LDI: lower and upper half words */
+          asm_insn_t hi = insn;
+
+          if ( insn.opnd[0].width != 32 )
+          {
+            return asm_error(file, line, "32-bit immediate needs a 32-bit register", mnem);
+          }
+          insn.op = OP_LDI;
+          insn.opnd[0].width = 16;
+          insn.opnd[1].value &= 0xFFFF;
+          PROG->insn[addr++] = insn;
+
+          hi.op = OP_LDI;
+          hi.opnd[0].shift = 16;
+          hi.opnd[0].width = 16;
+          hi.opnd[1].value >>= 16;
+          insn = hi;
+        }
+        break;
+
+      case OP_LDI:
+        if ( num != 2 || insn.opnd[0].kind != OPND_REG || insn.opnd[1].kind != OPND_IMM ||
+             insn.opnd[1].value > 0xFFFF )
+        {
+          return asm_error(file, line, "expected REG, IMM(65535)", mnem);
+        }
+        break;
+
+      case OP_ZERO: case OP_FILL:
+        if ( num != 2 || insn.opnd[0].kind != OPND_REG || insn.opnd[1].kind != OPND_IMM ||
+             insn.opnd[1].value == 0 || insn.opnd[1].value > 124 )
+        {
+          return asm_error(file, line, "expected &REG, IMM(124)", mnem);
+        }
+        break;
+
+      case OP_LBBO: case OP_SBBO:
+        if ( num != 4 || insn.opnd[0].kind != OPND_REG || insn.opnd[1].kind != OPND_REG ||
+             asm_check_op255(&insn.opnd[2]) < 0 ||
+             !((insn.opnd[3].kind == OPND_IMM && insn.opnd[3].value >= 1 && insn.opnd[3].value <= 124) ||
+               (insn.opnd[3].kind == OPND_REG && insn.opnd[3].reg == 0 && insn.opnd[3].width == 8)) )
+        {
+          return asm_error(file, line, "expected &REG, REG, OP(255), IMM(124)|bN", mnem);
+        }
+        break;
+
+      case OP_LBCO: case OP_SBCO:
+        if ( num != 4 || insn.opnd[0].kind != OPND_REG || insn.opnd[1].kind != OPND_CONST ||
+             asm_check_op255(&insn.opnd[2]) < 0 ||
+             !((insn.opnd[3].kind == OPND_IMM && insn.opnd[3].value >= 1 && insn.opnd[3].value <= 124) ||
+               (insn.opnd[3].kind == OPND_REG && insn.opnd[3].reg == 0 && insn.opnd[3].width == 8)) )
+        {
+          return asm_error(file, line, "expected &REG, Cn, OP(255), IMM(124)|bN", mnem);
+        }
+        break;
+
+      case OP_XIN: case OP_XOUT: case OP_XCHG:
+        if ( num != 3 || insn.opnd[0].kind != OPND_IMM || insn.opnd[0].value > 253 ||
+             insn.opnd[1].kind != OPND_REG ||
+             insn.opnd[2].kind != OPND_IMM || insn.opnd[2].value < 1 || insn.opnd[2].value > 124 )
+        {
+          return asm_error(file, line, "expected IMM(253), &REG, IMM(124)", mnem);
+        }
+        break;
+
+      case OP_QBA: case OP_CALL:
+        if ( num != 1 || insn.opnd[0].kind != OPND_LABEL )
+        {
+          return asm_error(file, line, "expected LABEL", mnem);
+        }
+        break;
+
+      case OP_QBGT: case OP_QBGE: case OP_QBLT: case OP_QBLE: case OP_QBEQ: case OP_QBNE:
+        if ( num != 3 || insn.opnd[0].kind != OPND_LABEL || insn.opnd[1].kind != OPND_REG ||
+             asm_check_op255(&insn.opnd[2]) < 0 )
+        {
+          return asm_error(file, line, "expected LABEL, REG, OP(255)", mnem);
+        }
+        break;
+
+      case OP_QBBS: case OP_QBBC:
+        if ( !(num == 2 && insn.opnd[0].kind == OPND_LABEL && insn.opnd[1].kind == OPND_BIT) &&
+             !(num == 3 && insn.opnd[0].kind == OPND_LABEL && insn.opnd[1].kind == OPND_REG &&
+               asm_check_op255(&insn.opnd[2]) == 0) )
+        {
+          return asm_error(file, line, "expected LABEL, REG.tN | LABEL, REG, OP(31)", mnem);
+        }
+        break;
+
+      case OP_WBS: case OP_WBC:
+        if ( !(num == 1 && insn.opnd[0].kind == OPND_BIT) &&
+             !(num == 2 && insn.opnd[0].kind == OPND_REG && asm_check_op255(&insn.opnd[1]) == 0) )
+        {
+          return asm_error(file, line, "expected REG.tN | REG, OP(31)", mnem);
+        }
+        break;
+
+      case OP_JMP:
+        if ( num != 1 || (insn.opnd[0].kind != OPND_LABEL && insn.opnd[0].kind != OPND_REG) )
+        {
+          return asm_error(file, line, "expected LABEL|REG", mnem);
+        }
+        break;
+
+      case OP_JAL:
+        if ( num != 2 || insn.opnd[0].kind != OPND_REG ||
+             (insn.opnd[1].kind != OPND_LABEL && insn.opnd[1].kind != OPND_REG) )
+        {
+          return asm_error(file, line, "expected REG, LABEL|REG", mnem);
+        }
+        break;
+
+      case OP_RET: case OP_HALT: case OP_NOP:
+        if ( num != 0 )
+        {
+          return asm_error(file, line, "unexpected operands", mnem);
+        }
+        break;
+
+      case OP_SLP:
+        if ( num != 1 || insn.opnd[0].kind != OPND_IMM || insn.opnd[0].value > 1 )
+        {
+          return asm_error(file, line, "expected IMM(1)", mnem);
+        }
+        break;
+
+      default:
+        return asm_error(file, line, "unsupported instruction", mnem);
+    }
+
+    if ( addr >= ASM_MAX_INSN )
+    {
+      return asm_error(file, line, "program too large", NULL);
+    }
+    PROG->insn[addr++] = insn;
+    if ( addr > PROG->num_insn )
+    {
+      PROG->num_insn = addr;
+    }
+  }
+
+  if ( pass == 2 && PROG->num_insn > 2048 )
+  {
+    fprintf(stderr, "warning: %u instructions exceed the 8 KB PRU IRAM\n", PROG->num_insn);
+  }
+
+  return 0;
+}
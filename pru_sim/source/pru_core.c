@@ -0,0 +1,1076 @@
+/***********************************************************************
+ * INCLUDES
+ **/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "pru_sim.h"
+
+/***********************************************************************
+ * DEFINES
+ **/
+#define CTRL_READ_LAT   LAT_LOCAL_READ
+#define R30_BYTE        (30 * 4)
+#define R31_BYTE        (31 * 4)
+
+/***********************************************************************
+ * MACROS
+ **/
+#define FIELD_MASK(w)   ((w) >= 32 ? 0xFFFFFFFFu : ((1u << (w)) - 1u))
+
+/***********************************************************************
+ * PRIVATE FUNCTIONS PROTOTYPES
+ **/
+static uint32_t reg_read32(pru_core_t *p_core, int reg);
+static uint32_t opnd_read(pru_sim_t *p_sim, int c, const asm_operand_t *p_opnd);
+static void     opnd_write(pru_sim_t *p_sim, int c, const asm_operand_t *p_opnd, uint32_t val);
+static uint32_t r31_read(pru_sim_t *p_sim, int c);
+static void     r30_update(pru_sim_t *p_sim, int c);
+static uint32_t cycle_read(pru_sim_t *p_sim, pru_core_t *p_core);
+static int      mem_access(pru_sim_t *p_sim, int c, uint32_t addr, uint8_t *buf, uint32_t len, int write);
+static uint32_t const_addr(pru_sim_t *p_sim, int c, uint32_t idx);
+static uint32_t exec_insn(pru_sim_t *p_sim, int c);
+static void     sim_fault(pru_sim_t *p_sim, int c, const char *msg, uint32_t arg);
+
+/***********************************************************************
+ * FUNCTIONS
+ **/
+/***********************************************************************
+ * @fn      pru_sim_init
+ *
+ * @brief
+ *
+ * @param   p_sim
+ *
+ * @return  none
+ */
+void pru_sim_init(pru_sim_t *p_sim)
+{
+  memset(p_sim, 0, sizeof(pru_sim_t));
+}
+
+/***********************************************************************
+ * @fn      pru_sim_attach
+ *
+ * @brief   Attach a peripheral model to the simulated bus/pins
+ *
+ * @param   p_sim
+ *          p_dev
+ *
+ * @return  none
+ */
+void pru_sim_attach(pru_sim_t *p_sim, pru_periph_t *p_dev)
+{
+  if ( p_dev != NULL && p_sim->num_periphs < PRU_MAX_PERIPHS )
+  {
+    p_sim->p_periph[p_sim->num_periphs++] = p_dev;
+  }
+}
+
+/***********************************************************************
+ * @fn      pru_sim_start
+ *
+ * @brief   Load a program into a core and enable it
+ *
+ * @param   p_sim
+ *          core
+ *          p_prog
+ *
+ * @return  none
+ */
+void pru_sim_start(pru_sim_t *p_sim, int core, asm_program_t *p_prog)
+{
+  pru_core_t *p_core = &p_sim->core[core];
+
+  p_core->p_prog   = p_prog;
+  p_core->pc       = p_prog->entry;
+  p_core->enabled  = 1;
+  p_core->halted   = 0;
+  p_core->ready_at = p_sim->now;
+  p_core->ctrl     = 0x0000000B & ~PRU_CTRL_CNT_EN;
+}
+
+/***********************************************************************
+ * @fn      pru_sim_run
+ *
+ * @brief   Run the enabled cores until all halt or 'until' is reached
+ *
+ * @param   p_sim
+ *          until - Cycle limit
+ *
+ * @return  0: stopped at limit, 1: all cores halted, -1: fault
+ */
+int pru_sim_run(pru_sim_t *p_sim, uint64_t until)
+{
+  for ( ;; )
+  {
+    int c = -1;
+    int i = 0;
+
+    for ( i = 0; i < PRU_NUM_CORES; i++ )
+    {
+      pru_core_t *p_core = &p_sim->core[i];
+      if ( p_core->enabled && !p_core->halted &&
+           (c < 0 || p_core->ready_at < p_sim->core[c].ready_at) )
+      {
+        c = i;
+      }
+    }
+
+    if ( c < 0 )
+    {
+      return 1;
+    }
+    if ( p_sim->core[c].ready_at >= until )
+    {
+      p_sim->now = until;
+      return 0;
+    }
+
+    p_sim->now = p_sim->core[c].ready_at;
+    {
+      pru_core_t *p_core = &p_sim->core[c];
+      uint32_t pc = p_core->pc;
+      uint32_t cost = exec_insn(p_sim, c);
+      int k = 0;
+
+      if ( p_sim->error )
+      {
+        return -1;
+      }
+
+      p_core->ready_at += cost;
+      p_core->insn_count++;
+      for ( k = 0; k < p_core->num_idle; k++ )
+      {
+        if ( pc == p_core->idle_addr[k] )
+        {
+          p_core->idle_cycles += cost;
+          break;
+        }
+      }
+      if ( p_core->p_pc_hist != NULL && pc < ASM_MAX_INSN )
+      {
+        p_core->p_pc_hist[pc] += cost;
+      }
+    }
+  }
+}
+
+/***********************************************************************
+ * @fn      pru_sim_read32
+ *
+ * @brief   Host side access through a core's address map
+ *
+ * @param   p_sim
+ *          core
+ *          addr
+ *
+ * @return  value
+ */
+uint32_t pru_sim_read32(pru_sim_t *p_sim, int core, uint32_t addr)
+{
+  uint8_t buf[4] = {0,0,0,0};
+
+  mem_access(p_sim, core, addr, buf, 4, 0);
+
+  return (uint32_t)buf[0] | ((uint32_t)buf[1] << 8) | ((uint32_t)buf[2] << 16) | ((uint32_t)buf[3] << 24);
+}
+
+/***********************************************************************
+ * @fn      pru_sim_write32
+ *
+ * @brief   Host side access through a core's address map
+ *
+ * @param   p_sim
+ *          core
+ *          addr
+ *          val
+ *
+ * @return  none
+ */
+void pru_sim_write32(pru_sim_t *p_sim, int core, uint32_t addr, uint32_t val)
+{
+  uint8_t buf[4];
+
+  buf[0] = (uint8_t)val;
+  buf[1] = (uint8_t)(val >> 8);
+  buf[2] = (uint8_t)(val >> 16);
+  buf[3] = (uint8_t)(val >> 24);
+  mem_access(p_sim, core, addr, buf, 4, 1);
+}
+
+/***********************************************************************
+ * PRIVATE FUNCTIONS
+ **/
+/***********************************************************************
+ * @fn      sim_fault
+ *
+ * @brief
+ *
+ * @param   p_sim
+ *          c
+ *          msg
+ *          arg
+ *
+ * @return  none
+ */
+static void sim_fault(pru_sim_t *p_sim, int c, const char *msg, uint32_t arg)
+{
+  pru_core_t *p_core = &p_sim->core[c];
+  const asm_insn_t *p_insn = NULL;
+
+  if ( p_core->p_prog != NULL && p_core->pc < ASM_MAX_INSN )
+  {
+    p_insn = &p_core->p_prog->insn[p_core->pc];
+    fprintf(stderr, "PRU%d fault at %s:%u (pc 0x%04x, %s): %s 0x%08x\n", c,
+            p_core->p_prog->file_name[p_insn->file], p_insn->line, p_core->pc,
+            asm_label_at(p_core->p_prog, p_core->pc), msg, arg);
+  }
+  else
+  {
+    fprintf(stderr, "PRU%d fault: %s 0x%08x\n", c, msg, arg);
+  }
+  p_sim->error = 1;
+}
+
+/***********************************************************************
+ * @fn      reg_read32
+ *
+ * @brief
+ *
+ * @param   p_core
+ *          reg
+ *
+ * @return
+ */
+static uint32_t reg_read32(pru_core_t *p_core, int reg)
+{
+  const uint8_t *p = &p_core->reg[reg * 4];
+
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/***********************************************************************
+ * @fn      r31_read
+ *
+ * @brief   R31 inputs come from the pin models of this core
+ *
+ * @param   p_sim
+ *          c
+ *
+ * @return  R31 value
+ */
+static uint32_t r31_read(pru_sim_t *p_sim, int c)
+{
+  uint32_t val = 0;
+  int i = 0;
+
+  for ( i = 0; i < p_sim->num_periphs; i++ )
+  {
+    pru_periph_t *p_dev = p_sim->p_periph[i];
+    if ( p_dev->core == c && p_dev->pins_in != NULL )
+    {
+      if ( p_dev->advance != NULL )
+      {
+        p_dev->advance(p_dev, p_sim->now);
+      }
+      val |= p_dev->pins_in(p_dev, p_sim->now);
+    }
+  }
+
+  return val;
+}
+
+/***********************************************************************
+ * @fn      r30_update
+ *
+ * @brief   Propagate R30 changes to the pin models of this core, and to
+ *          the models of the other core watching its pins
+ *
+ * @param   p_sim
+ *          c
+ *
+ * @return  none
+ */
+static void r30_update(pru_sim_t *p_sim, int c)
+{
+  pru_core_t *p_core = &p_sim->core[c];
+  uint32_t r30 = reg_read32(p_core, 30);
+  int i = 0;
+
+  if ( r30 == p_core->r30_last )
+  {
+    return;
+  }
+  p_core->r30_last = r30;
+
+  for ( i = 0; i < p_sim->num_periphs; i++ )
+  {
+    pru_periph_t *p_dev = p_sim->p_periph[i];
+    if ( p_dev->core == c && p_dev->pins_out != NULL )
+    {
+      if ( p_dev->advance != NULL )
+      {
+        p_dev->advance(p_dev, p_sim->now);
+      }
+      p_dev->pins_out(p_dev, r30, p_sim->now);
+    }
+    else if ( p_dev->core != c && p_dev->pins_watch != NULL )
+    {
+      if ( p_dev->advance != NULL )
+      {
+        p_dev->advance(p_dev, p_sim->now);
+      }
+      p_dev->pins_watch(p_dev, c, r30, p_sim->now);
+    }
+  }
+}
+
+/***********************************************************************
+ * @fn      opnd_read
+ *
+ * @brief   Value of a register field or immediate operand
+ *
+ * @param   p_sim
+ *          c
+ *          p_opnd
+ *
+ * @return
+ */
+static uint32_t opnd_read(pru_sim_t *p_sim, int c, const asm_operand_t *p_opnd)
+{
+  pru_core_t *p_core = &p_sim->core[c];
+  uint32_t val = 0;
+
+  if ( p_opnd->kind == OPND_IMM || p_opnd->kind == OPND_LABEL )
+  {
+    return p_opnd->value;
+  }
+
+  val = (p_opnd->reg == 31) ? r31_read(p_sim, c) : reg_read32(p_core, p_opnd->reg);
+
+  if ( p_opnd->kind == OPND_BIT )
+  {
+    return (val >> p_opnd->width) & 1;
+  }
+
+  return (val >> p_opnd->shift) & FIELD_MASK(p_opnd->width);
+}
+
+/***********************************************************************
+ * @fn      opnd_write
+ *
+ * @brief   Write a register field (other bits are kept)
+ *
+ * @param   p_sim
+ *          c
+ *          p_opnd
+ *          val
+ *
+ * @return  none
+ */
+static void opnd_write(pru_sim_t *p_sim, int c, const asm_operand_t *p_opnd, uint32_t val)
+{
+  pru_core_t *p_core = &p_sim->core[c];
+  uint32_t mask = FIELD_MASK(p_opnd->width) << p_opnd->shift;
+  uint32_t reg = reg_read32(p_core, p_opnd->reg);
+  uint8_t *p = &p_core->reg[p_opnd->reg * 4];
+
+  reg = (reg & ~mask) | ((val << p_opnd->shift) & mask);
+
+  if ( p_opnd->reg == 31 )
+  {
+    /* R31 write: bit 5 strobes the event in bits 3..0 to the INTC */
+    if ( (val & 0x20) && p_sim->num_events < PRU_MAX_EVENTS )
+    {
+      p_sim->event[p_sim->num_events].cycle = p_sim->now;
+      p_sim->event[p_sim->num_events].core  = c;
+      p_sim->event[p_sim->num_events].event = (uint8_t)(val & 0x0F);
+      p_sim->num_events++;
+    }
+    return;
+  }
+
+  p[0] = (uint8_t)reg;
+  p[1] = (uint8_t)(reg >> 8);
+  p[2] = (uint8_t)(reg >> 16);
+  p[3] = (uint8_t)(reg >> 24);
+
+  if ( p_opnd->reg == 30 )
+  {
+    r30_update(p_sim, c);
+  }
+}
+
+/***********************************************************************
+ * @fn      cycle_read
+ *
+ * @brief   PRU CTRL CYCLE register (saturates at 0xFFFFFFFF)
+ *
+ * @param   p_sim
+ *          p_core
+ *
+ * @return
+ */
+static uint32_t cycle_read(pru_sim_t *p_sim, pru_core_t *p_core)
+{
+  uint64_t val = p_core->cycle_base;
+
+  if ( p_core->ctrl & PRU_CTRL_CNT_EN )
+  {
+    val += p_sim->now - p_core->cycle_start;
+  }
+
+  return (val > 0xFFFFFFFFull) ? 0xFFFFFFFFu : (uint32_t)val;
+}
+
+/***********************************************************************
+ * @fn      ctrl_access
+ *
+ * @brief   PRU CTRL register block
+ *
+ * @param   p_sim
+ *          p_core - Core owning the block
+ *          off
+ *          p_val
+ *          write
+ *
+ * @return  none
+ */
+static void ctrl_access(pru_sim_t *p_sim, pru_core_t *p_core, uint32_t off, uint32_t *p_val, int write)
+{
+  switch ( off )
+  {
+    case PRU_CTRL_CTRL:
+      if ( write )
+      {
+        uint32_t old = p_core->ctrl;
+        if ( (old & PRU_CTRL_CNT_EN) && !(*p_val & PRU_CTRL_CNT_EN) )
+        {
+          p_core->cycle_base = cycle_read(p_sim, p_core);
+        }
+        else if ( !(old & PRU_CTRL_CNT_EN) && (*p_val & PRU_CTRL_CNT_EN) )
+        {
+          p_core->cycle_start = p_sim->now;
+        }
+        p_core->ctrl = *p_val;
+      }
+      else
+      {
+        *p_val = p_core->ctrl | (p_core->halted ? 0 : (1 << 15));
+      }
+      break;
+
+    case PRU_CTRL_CYCLE:
+      if ( write )
+      {
+        /* Only writable while the counter is disabled */
+        if ( !(p_core->ctrl & PRU_CTRL_CNT_EN) )
+        {
+          p_core->cycle_base = *p_val;
+        }
+      }
+      else
+      {
+        *p_val = cycle_read(p_sim, p_core);
+      }
+      break;
+
+    case PRU_CTRL_CTBIR0:
+    case PRU_CTRL_CTBIR1:
+      if ( write )
+      {
+        p_core->ctbir[(off - PRU_CTRL_CTBIR0) / 4] = *p_val;
+      }
+      else
+      {
+        *p_val = p_core->ctbir[(off - PRU_CTRL_CTBIR0) / 4];
+      }
+      break;
+
+    case PRU_CTRL_CTPPR0:
+    case PRU_CTRL_CTPPR1:
+      if ( write )
+      {
+        p_core->ctppr[(off - PRU_CTRL_CTPPR0) / 4] = *p_val;
+      }
+      else
+      {
+        *p_val = p_core->ctppr[(off - PRU_CTRL_CTPPR0) / 4];
+      }
+      break;
+
+    default:
+      if ( !write )
+      {
+        *p_val = 0;
+      }
+      break;
+  }
+}
+
+/***********************************************************************
+ * @fn      iep_access
+ *
+ * @brief   IEP timer: GLOBAL_CFG (enable, DEFAULT_INC) and COUNT
+ *
+ * @param   p_sim
+ *          off
+ *          p_val
+ *          write
+ *
+ * @return  none
+ */
+static void iep_access(pru_sim_t *p_sim, uint32_t off, uint32_t *p_val, int write)
+{
+  uint32_t count = p_sim->iep_base;
+
+  if ( p_sim->iep_enabled )
+  {
+    count += (uint32_t)((p_sim->now - p_sim->iep_start) * 5);
+  }
+
+  if ( off == 0x00 )
+  {
+    if ( write )
+    {
+      if ( (*p_val & 1) && !p_sim->iep_enabled )
+      {
+        p_sim->iep_start = p_sim->now;
+      }
+      else if ( !(*p_val & 1) && p_sim->iep_enabled )
+      {
+        p_sim->iep_base = count;
+      }
+      p_sim->iep_enabled = *p_val & 1;
+    }
+    else
+    {
+      *p_val = 0x50 | (uint32_t)p_sim->iep_enabled;
+    }
+  }
+  else if ( off == 0x0C )
+  {
+    if ( write )
+    {
+      p_sim->iep_base  = *p_val;
+      p_sim->iep_start = p_sim->now;
+    }
+    else
+    {
+      *p_val = count;
+    }
+  }
+  else if ( !write )
+  {
+    *p_val = 0;
+  }
+}
+
+/***********************************************************************
+ * @fn      mem_access
+ *
+ * @brief   Access the address map seen by core 'c'
+ *
+ * @param   p_sim
+ *          c
+ *          addr
+ *          buf
+ *          len
+ *          write
+ *
+ * @return  Access latency in cycles, -1 on bus error
+ */
+static int mem_access(pru_sim_t *p_sim, int c, uint32_t addr, uint8_t *buf, uint32_t len, int write)
+{
+  uint8_t *p_mem = NULL;
+  uint32_t off = 0;
+  int i = 0;
+
+  if ( addr < PRU_DRAM1_ADDR + PRU_DRAM_SIZE )
+  {
+    int bank = (addr < PRU_DRAM1_ADDR) ? c : !c;
+    off = addr & (PRU_DRAM_SIZE - 1);
+    if ( off + len > PRU_DRAM_SIZE )
+    {
+      return -1;
+    }
+    p_mem = &p_sim->dram[bank][off];
+  }
+  else if ( addr >= PRU_SHRAM_ADDR && addr + len <= PRU_SHRAM_ADDR + PRU_SHRAM_SIZE )
+  {
+    p_mem = &p_sim->shram[addr - PRU_SHRAM_ADDR];
+  }
+
+  if ( p_mem != NULL )
+  {
+    if ( write )
+    {
+      memcpy(p_mem, buf, len);
+    }
+    else
+    {
+      memcpy(buf, p_mem, len);
+    }
+    return write ? LAT_LOCAL_WRITE : LAT_LOCAL_READ;
+  }
+
+  if ( (addr >= PRU_CTRL0_ADDR && addr < PRU_CTRL0_ADDR + 0x100) ||
+       (addr >= PRU_CTRL1_ADDR && addr < PRU_CTRL1_ADDR + 0x100) ||
+       (addr >= PRU_IEP_ADDR && addr < PRU_IEP_ADDR + 0x100) )
+  {
+    uint32_t base = addr & ~0xFFu;
+    for ( off = addr & 0xFF; off < (addr & 0xFF) + len; off += 4 )
+    {
+      uint32_t val = 0;
+      uint32_t k = off - (addr & 0xFF);
+      if ( write )
+      {
+        val = buf[k] | (k + 1 < len ? buf[k + 1] << 8 : 0) |
+              (k + 2 < len ? buf[k + 2] << 16 : 0) | (k + 3 < len ? (uint32_t)buf[k + 3] << 24 : 0);
+      }
+      if ( base == PRU_IEP_ADDR )
+      {
+        iep_access(p_sim, off & ~3u, &val, write);
+      }
+      else
+      {
+        ctrl_access(p_sim, &p_sim->core[base == PRU_CTRL0_ADDR ? 0 : 1], off & ~3u, &val, write);
+      }
+      if ( !write )
+      {
+        uint32_t j = 0;
+        for ( j = 0; j < 4 && k + j < len; j++ )
+        {
+          buf[k + j] = (uint8_t)(val >> (8 * j));
+        }
+      }
+    }
+    return write ? LAT_LOCAL_WRITE : CTRL_READ_LAT;
+  }
+
+  if ( addr >= PRU_INTC_ADDR && addr < PRU_LOCAL_END )
+  {
+    /* INTC, CFG and the remaining local blocks: accepted, read as zero */
+    if ( !write )
+    {
+      memset(buf, 0, len);
+    }
+    return write ? LAT_LOCAL_WRITE : LAT_LOCAL_READ;
+  }
+
+  for ( i = 0; i < p_sim->num_periphs; i++ )
+  {
+    pru_periph_t *p_dev = p_sim->p_periph[i];
+    if ( p_dev->size != 0 && addr >= p_dev->base && addr - p_dev->base + len <= p_dev->size )
+    {
+      int res = 0;
+      if ( p_dev->advance != NULL )
+      {
+        p_dev->advance(p_dev, p_sim->now);
+      }
+      res = write ? p_dev->write(p_dev, addr - p_dev->base, buf, len, p_sim->now)
+                  : p_dev->read(p_dev, addr - p_dev->base, buf, len, p_sim->now);
+      if ( res < 0 )
+      {
+        return -1;
+      }
+      return (int)(write ? p_dev->write_lat : p_dev->read_lat);
+    }
+  }
+
+  return -1;
+}
+
+/***********************************************************************
+ * @fn      const_addr
+ *
+ * @brief   Constant table entry as seen from core 'c'
+ *
+ * @param   p_sim
+ *          c
+ *          idx
+ *
+ * @return  Address
+ */
+static uint32_t const_addr(pru_sim_t *p_sim, int c, uint32_t idx)
+{
+  static const uint32_t TABLE[32] =
+  {
+    0x00020000, 0x48040000, 0x4802A000, 0x00030000, 0x00026000, 0x48060000, 0x48030000, 0x00028000,
+    0x46000000, 0x4A100000, 0x48318000, 0x48022000, 0x48024000, 0x48310000, 0x481CC000, 0x481D0000,
+    0x481A0000, 0x4819C000, 0x48300000, 0x48302000, 0x48304000, 0x00032400, 0x480C8000, 0x480CA000,
+    0, 0, 0x0002E000, 0x00032000, 0, 0, 0, 0
+  };
+  pru_core_t *p_core = &p_sim->core[c];
+
+  switch ( idx )
+  {
+    case 24: return (p_core->ctbir[0] & 0xFF) << 8;
+    case 25: return PRU_DRAM1_ADDR | (((p_core->ctbir[0] >> 16) & 0xFF) << 8);
+    case 28: return (p_core->ctppr[0] & 0xFFFF) << 8;
+    case 29: return 0x49000000 | ((p_core->ctppr[0] >> 16) << 8);
+    case 30: return 0x40000000 | ((p_core->ctppr[1] & 0xFFFF) << 8);
+    case 31: return 0x80000000 | ((p_core->ctppr[1] >> 16) << 8);
+    default: return TABLE[idx & 31];
+  }
+}
+
+/***********************************************************************
+ * @fn      exec_insn
+ *
+ * @brief   Execute the instruction at the core PC
+ *
+ * @param   p_sim
+ *          c
+ *
+ * @return  Instruction cost in cycles
+ */
+static uint32_t exec_insn(pru_sim_t *p_sim, int c)
+{
+  pru_core_t *p_core = &p_sim->core[c];
+  const asm_insn_t *p_insn = NULL;
+  const asm_operand_t *o = NULL;
+  uint32_t next = p_core->pc + 1;
+  uint32_t cost = 1;
+  uint32_t a = 0;
+  uint32_t b = 0;
+  uint64_t r = 0;
+  int taken = 0;
+
+  if ( p_core->pc >= p_core->p_prog->num_insn )
+  {
+    sim_fault(p_sim, c, "PC outside program", p_core->pc);
+    return 1;
+  }
+
+  p_insn = &p_core->p_prog->insn[p_core->pc];
+  o = p_insn->opnd;
+
+  if ( p_sim->trace )
+  {
+    fprintf(stderr, "%10llu PRU%d %04x %-16s %s\n", (unsigned long long)p_sim->now, c,
+            p_core->pc, asm_label_at(p_core->p_prog, p_core->pc), asm_op_name(p_insn->op));
+  }
+
+  switch ( p_insn->op )
+  {
+    case OP_ADD: case OP_ADC:
+      a = opnd_read(p_sim, c, &o[1]);
+      b = opnd_read(p_sim, c, &o[2]);
+      r = (uint64_t)a + b + ((p_insn->op == OP_ADC) ? p_core->carry : 0);
+      p_core->carry = (int)((r >> o[0].width) & 1);
+      opnd_write(p_sim, c, &o[0], (uint32_t)r);
+      break;
+
+    case OP_SUB: case OP_SUC: case OP_RSB: case OP_RSC:
+      a = opnd_read(p_sim, c, &o[1]);
+      b = opnd_read(p_sim, c, &o[2]);
+      if ( p_insn->op == OP_RSB || p_insn->op == OP_RSC )
+      {
+        uint32_t t = a;
+        a = b;
+        b = t;
+      }
+      r = (uint64_t)b + ((p_insn->op == OP_SUC || p_insn->op == OP_RSC) ? p_core->carry : 0);
+      p_core->carry = ((uint64_t)a < r);
+      opnd_write(p_sim, c, &o[0], (uint32_t)(a - r));
+      break;
+
+    case OP_LSL:
+      opnd_write(p_sim, c, &o[0], opnd_read(p_sim, c, &o[1]) << (opnd_read(p_sim, c, &o[2]) & 0x1F));
+      break;
+
+    case OP_LSR:
+      opnd_write(p_sim, c, &o[0], opnd_read(p_sim, c, &o[1]) >> (opnd_read(p_sim, c, &o[2]) & 0x1F));
+      break;
+
+    case OP_AND:
+      opnd_write(p_sim, c, &o[0], opnd_read(p_sim, c, &o[1]) & opnd_read(p_sim, c, &o[2]));
+      break;
+
+    case OP_OR:
+      opnd_write(p_sim, c, &o[0], opnd_read(p_sim, c, &o[1]) | opnd_read(p_sim, c, &o[2]));
+      break;
+
+    case OP_XOR:
+      opnd_write(p_sim, c, &o[0], opnd_read(p_sim, c, &o[1]) ^ opnd_read(p_sim, c, &o[2]));
+      break;
+
+    case OP_NOT:
+      opnd_write(p_sim, c, &o[0], ~opnd_read(p_sim, c, &o[1]));
+      break;
+
+    case OP_MIN:
+      a = opnd_read(p_sim, c, &o[1]);
+      b = opnd_read(p_sim, c, &o[2]);
+      opnd_write(p_sim, c, &o[0], (a < b) ? a : b);
+      break;
+
+    case OP_MAX:
+      a = opnd_read(p_sim, c, &o[1]);
+      b = opnd_read(p_sim, c, &o[2]);
+      opnd_write(p_sim, c, &o[0], (a > b) ? a : b);
+      break;
+
+    case OP_LMBD:
+    {
+      int bit = 0;
+      a = opnd_read(p_sim, c, &o[1]);
+      b = opnd_read(p_sim, c, &o[2]) & 1;
+      r = 32;
+      for ( bit = o[1].width - 1; bit >= 0; bit-- )
+      {
+        if ( ((a >> bit) & 1) == b )
+        {
+          r = (uint64_t)bit;
+          break;
+        }
+      }
+      opnd_write(p_sim, c, &o[0], (uint32_t)r);
+      break;
+    }
+
+    case OP_CLR: case OP_SET:
+    {
+      asm_operand_t dst = o[0];
+      uint32_t bit = 0;
+
+      if ( p_insn->num_opnds == 1 )
+      {
+        dst.kind  = OPND_REG;
+        dst.shift = 0;
+        dst.width = 32;
+        bit = o[0].width;
+        a = opnd_read(p_sim, c, &dst);
+      }
+      else if ( p_insn->num_opnds == 2 && o[1].kind == OPND_BIT )
+      {
+        asm_operand_t src = o[1];
+        src.kind  = OPND_REG;
+        src.shift = 0;
+        src.width = 32;
+        dst.shift = 0;
+        dst.width = 32;
+        a = opnd_read(p_sim, c, &src);
+        bit = o[1].width;
+      }
+      else if ( p_insn->num_opnds == 2 )
+      {
+        a = opnd_read(p_sim, c, &o[0]);
+        bit = opnd_read(p_sim, c, &o[1]) & 0x1F;
+      }
+      else
+      {
+        a = opnd_read(p_sim, c, &o[1]);
+        bit = opnd_read(p_sim, c, &o[2]) & 0x1F;
+      }
+
+      if ( p_insn->op == OP_SET )
+      {
+        a |= (1u << bit);
+      }
+      else
+      {
+        a &= ~(1u << bit);
+      }
+      opnd_write(p_sim, c, &dst, a);
+      break;
+    }
+
+    case OP_MOV: case OP_LDI:
+      opnd_write(p_sim, c, &o[0], opnd_read(p_sim, c, &o[1]));
+      break;
+
+    case OP_ZERO: case OP_FILL:
+    {
+      uint32_t start = o[0].reg * 4 + o[0].shift / 8;
+      if ( start + o[1].value > 128 )
+      {
+        sim_fault(p_sim, c, "register file overflow", start);
+        break;
+      }
+      memset(&p_core->reg[start], (p_insn->op == OP_ZERO) ? 0x00 : 0xFF, o[1].value);
+      if ( start + o[1].value > R30_BYTE )
+      {
+        r30_update(p_sim, c);
+      }
+      break;
+    }
+
+    case OP_LBBO: case OP_SBBO: case OP_LBCO: case OP_SBCO:
+    {
+      int write = (p_insn->op == OP_SBBO || p_insn->op == OP_SBCO);
+      uint32_t start = o[0].reg * 4 + o[0].shift / 8;
+      uint32_t len = opnd_read(p_sim, c, &o[3]);
+      uint32_t addr = 0;
+      int lat = 0;
+
+      if ( p_insn->op == OP_LBCO || p_insn->op == OP_SBCO )
+      {
+        addr = const_addr(p_sim, c, o[1].value);
+      }
+      else
+      {
+        addr = opnd_read(p_sim, c, &o[1]);
+      }
+      addr += opnd_read(p_sim, c, &o[2]);
+
+      if ( len == 0 )
+      {
+        break;
+      }
+      if ( start + len > 128 )
+      {
+        sim_fault(p_sim, c, "register file overflow", start);
+        break;
+      }
+
+      if ( write && start + len > R31_BYTE )
+      {
+        uint32_t r31 = r31_read(p_sim, c);
+        memcpy(&p_core->reg[R31_BYTE], &r31, 4);
+      }
+
+      lat = mem_access(p_sim, c, addr, &p_core->reg[start], len, write);
+      if ( lat < 0 )
+      {
+        sim_fault(p_sim, c, write ? "bus error writing" : "bus error reading", addr);
+        break;
+      }
+      cost = (uint32_t)lat + (len + 3) / 4;
+      p_core->stall_cycles += cost - 1;
+
+      if ( !write && start + len > R30_BYTE )
+      {
+        r30_update(p_sim, c);
+      }
+      break;
+    }
+
+    case OP_XIN: case OP_XOUT: case OP_XCHG:
+    {
+      uint32_t dev = o[0].value;
+      uint32_t start = o[1].reg * 4 + o[1].shift / 8;
+      uint32_t len = o[2].value;
+
+      if ( dev < 10 || dev > 12 || start + len > 120 )
+      {
+        sim_fault(p_sim, c, "unsupported XFER", dev);
+        break;
+      }
+      if ( p_insn->op == OP_XIN )
+      {
+        memcpy(&p_core->reg[start], &p_sim->scratch[dev - 10][start], len);
+      }
+      else if ( p_insn->op == OP_XOUT )
+      {
+        memcpy(&p_sim->scratch[dev - 10][start], &p_core->reg[start], len);
+      }
+      else
+      {
+        uint8_t tmp[120];
+        memcpy(tmp, &p_core->reg[start], len);
+        memcpy(&p_core->reg[start], &p_sim->scratch[dev - 10][start], len);
+        memcpy(&p_sim->scratch[dev - 10][start], tmp, len);
+      }
+      break;
+    }
+
+    case OP_QBA:
+      next = o[0].value;
+      break;
+
+    case OP_QBGT: case OP_QBGE: case OP_QBLT: case OP_QBLE: case OP_QBEQ: case OP_QBNE:
+      /* 'QBxx label, REG, OP': the comparison reads 'OP xx REG' */
+      a = opnd_read(p_sim, c, &o[1]);
+      b = opnd_read(p_sim, c, &o[2]);
+      switch ( p_insn->op )
+      {
+        case OP_QBGT: taken = (b >  a); break;
+        case OP_QBGE: taken = (b >= a); break;
+        case OP_QBLT: taken = (b <  a); break;
+        case OP_QBLE: taken = (b <= a); break;
+        case OP_QBEQ: taken = (b == a); break;
+        default:      taken = (b != a); break;
+      }
+      if ( taken )
+      {
+        next = o[0].value;
+      }
+      break;
+
+    case OP_QBBS: case OP_QBBC:
+      if ( p_insn->num_opnds == 2 )
+      {
+        a = opnd_read(p_sim, c, &o[1]);
+      }
+      else
+      {
+        asm_operand_t src = o[1];
+        src.shift = 0;
+        src.width = 32;
+        a = (opnd_read(p_sim, c, &src) >> (opnd_read(p_sim, c, &o[2]) & 0x1F)) & 1;
+      }
+      if ( (p_insn->op == OP_QBBS) ? a : !a )
+      {
+        next = o[0].value;
+      }
+      break;
+
+    case OP_WBS: case OP_WBC:
+      if ( p_insn->num_opnds == 1 )
+      {
+        a = opnd_read(p_sim, c, &o[0]);
+      }
+      else
+      {
+        asm_operand_t src = o[0];
+        src.shift = 0;
+        src.width = 32;
+        a = (opnd_read(p_sim, c, &src) >> (opnd_read(p_sim, c, &o[1]) & 0x1F)) & 1;
+      }
+      if ( (p_insn->op == OP_WBS) ? !a : a )
+      {
+        next = p_core->pc;
+        p_core->stall_cycles++;
+      }
+      break;
+
+    case OP_JMP:
+      next = opnd_read(p_sim, c, &o[0]) & 0xFFFF;
+      break;
+
+    case OP_JAL:
+      opnd_write(p_sim, c, &o[0], p_core->pc + 1);
+      next = opnd_read(p_sim, c, &o[1]) & 0xFFFF;
+      break;
+
+    case OP_CALL:
+      opnd_write(p_sim, c, &p_core->p_prog->callreg, p_core->pc + 1);
+      next = o[0].value;
+      break;
+
+    case OP_RET:
+      next = opnd_read(p_sim, c, &p_core->p_prog->callreg);
+      break;
+
+    case OP_HALT:
+      p_core->halted = 1;
+      next = p_core->pc;
+      break;
+
+    case OP_SLP: case OP_NOP:
+      break;
+
+    default:
+      sim_fault(p_sim, c, "unsupported instruction", p_insn->op);
+      break;
+  }
+
+  p_core->pc = next;
+
+  return cost;
+}
@@ -0,0 +1,141 @@
+/***********************************************************************
+ * INCLUDES
+ **/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include "pru_sim.h"
+
+/***********************************************************************
+ * FUNCTIONS
+ **/
+/***********************************************************************
+ * @fn      signal_parse
+ *
+ * @brief   Parse an input signal description
+ *
+ * @param   p_sig
+ *          spec - ramp | sine:F[:A[:O]] | const:L | pulse:P:W[:L:H] | noise[:A]
+ *
+ * @return  0 on success, -1 on error
+ */
+int signal_parse(sim_signal_t *p_sig, const char *spec)
+{
+  double v[4] = {0, 0, 0, 0};
+  char name[16] = "";
+  int n = 0;
+
+  memset(p_sig, 0, sizeof(sim_signal_t));
+  if ( spec == NULL )
+  {
+    p_sig->type = SIG_RAMP;
+    return 0;
+  }
+
+  n = sscanf(spec, "%15[a-z]:%lf:%lf:%lf:%lf", name, &v[0], &v[1], &v[2], &v[3]);
+
+  if ( strcmp(name, "ramp") == 0 )
+  {
+    p_sig->type = SIG_RAMP;
+  }
+  else if ( strcmp(name, "sine") == 0 && n >= 2 )
+  {
+    p_sig->type   = SIG_SINE;
+    p_sig->freq   = v[0];
+    p_sig->amp    = (n >= 3) ? v[1] : 0.9;
+    p_sig->offset = (n >= 4) ? v[2] : 0.0;
+  }
+  else if ( strcmp(name, "const") == 0 && n >= 2 )
+  {
+    p_sig->type   = SIG_CONST;
+    p_sig->offset = v[0];
+  }
+  else if ( strcmp(name, "pulse") == 0 && n >= 3 && v[0] > 0 )
+  {
+    p_sig->type   = SIG_PULSE;
+    p_sig->freq   = 1.0 / v[0];
+    p_sig->width  = v[1];
+    p_sig->offset = (n >= 4) ? v[2] : -0.5;
+    p_sig->high   = (n >= 5) ? v[3] : 0.5;
+  }
+  else if ( strcmp(name, "noise") == 0 )
+  {
+    p_sig->type = SIG_NOISE;
+    p_sig->amp  = (n >= 2) ? v[0] : 0.1;
+  }
+  else
+  {
+    fprintf(stderr, "Unknown signal '%s'\n", spec);
+    return -1;
+  }
+
+  return 0;
+}
+
+/***********************************************************************
+ * @fn      signal_code
+ *
+ * @brief   Converter output code for a signal
+ *
+ * @param   p_sig
+ *          t - Conversion time in seconds
+ *          index - Conversion number of this channel
+ *          channel - Differences channels (phase/offset)
+ *          bits - Converter resolution
+ *          is_signed - Two's complement (bipolar) output
+ *
+ * @return  Code
+ */
+int32_t signal_code(const sim_signal_t *p_sig, double t, uint64_t index, int channel, int bits, int is_signed)
+{
+  const double full = (double)((1u << (bits - 1)) - 1);
+  double v = 0;
+
+  switch ( p_sig->type )
+  {
+    case SIG_RAMP:
+      if ( is_signed )
+      {
+        /* Channel in the upper bits, sample index below */
+        return (int32_t)(((uint32_t)channel << (bits - 4)) | (uint32_t)(index & ((1u << (bits - 4)) - 1)));
+      }
+      return (int32_t)(index & ((1u << bits) - 1));
+
+    case SIG_SINE:
+      v = p_sig->offset + p_sig->amp * sin(2 * M_PI * p_sig->freq * t + channel * M_PI / 4);
+      break;
+
+    case SIG_CONST:
+      v = p_sig->offset + channel * 0.05;
+      break;
+
+    case SIG_PULSE:
+      v = (fmod(t, 1.0 / p_sig->freq) < p_sig->width) ? p_sig->high : p_sig->offset;
+      break;
+
+    case SIG_NOISE:
+      v = p_sig->amp * ((double)rand() / RAND_MAX * 2.0 - 1.0);
+      break;
+
+    default:
+      break;
+  }
+
+  if ( v > 1.0 )
+  {
+    v = 1.0;
+  }
+  if ( v < -1.0 )
+  {
+    v = -1.0;
+  }
+
+  if ( is_signed )
+  {
+    return (int32_t)lround(v * full);
+  }
+
+  return (int32_t)lround((v + 1.0) / 2.0 * (double)((1u << bits) - 1));
+}
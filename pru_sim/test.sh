@@ -0,0 +1,42 @@
+#!/bin/bash
+# Firmware regression: the README scenarios must run without ADS1256 timing
+# violations or TSC_ADC FIFO overrun, at the expected rate ('-x MIN_SPS')
+ADC=../bbb_read_adc_from_pru
+ADS=../pru_ads1256/pru_ads1256.p
+
+A="-a sine:1000 -m 0x0=0x9C940000 -m 4=0 -m 8=200 -m 12=1 -m 16=50 -m 0x20=20 -m 0x58=125 -m 0x14=1@1000 -t 0.01"
+C="-m 0x0=3000 -m 8=0x100000 -m 0x2C=53 -m 0x30=1303 -m 0x34=209 -m 0x38=625 -m 0x84=1 -m 0x88=0xF0000800 -m 0xC=1@1000"
+B="$C -m 0x98=1"
+
+FAILED=0
+
+run()
+{
+  local name="$1"
+  shift
+  if ./pru_sim "$@" > test.log 2>&1
+  then
+    echo "PASS: $name"
+  else
+    echo "FAIL: $name"
+    grep "^FAIL\|rror" test.log
+    FAILED=$((FAILED + 1))
+  fi
+}
+
+run "TSC_ADC 1.6 MSPS"       -x 1600000 $A $ADC/pru_adc.p
+run "TSC_ADC split"          -x 1600000 $A -m 0x74=1 -1 $ADC/pru_adc_writer.p $ADC/pru_adc.p
+run "ADS1256 RDATA"          -x 29900 -s sine:50 $C -m 4=0x9C940000 -t 0.12 $ADS
+run "ADS1256 RDATAC"         -x 29900 -s sine:50 $C -m 4=0x9C940000 -m 0x3C=1 -t 0.12 $ADS
+run "ADS1256 channel list"   -x 4000 -s sine:50 $C -m 4=0x9C940000 -m 0x40=3 -m 0x44=0x08 \
+                             -m 0x48=0x0118 -m 0x4C=0x0623 -t 0.8 $ADS
+run "ADS1256 dual"           -x 29900 -s sine:50 -S ramp -y 14 $B -m 4=0x9C940000 \
+                             $(echo $B | sed 's/-m /-m 1:/g') -m 1:4=0x9C9C0000 -D 1:PRU1 -1 $ADS -t 0.12 $ADS
+rm -f test.log
+
+if [ $FAILED -ne 0 ]
+then
+  echo "$FAILED scenario(s) failed"
+  exit 1
+fi
+echo "All scenarios passed"